@@ -101,12 +101,19 @@ if(NOT VCPKG_TOOLCHAIN)
     )
 
     set(CMAKE_PROGRAM_PATH ${CMAKE_PROGRAM_PATH} ${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}/tools)
-    file(GLOB _VCPKG_TOOLS_DIRS ${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}/tools/*)
-    foreach(_VCPKG_TOOLS_DIR ${_VCPKG_TOOLS_DIRS})
-        if(IS_DIRECTORY ${_VCPKG_TOOLS_DIR})
-            set(CMAKE_PROGRAM_PATH ${CMAKE_PROGRAM_PATH} ${_VCPKG_TOOLS_DIR})
-        endif()
-    endforeach()
+    # Written by vcpkg install and vcpkg remove, so that the installed tree need not be enumerated here
+    set(_VCPKG_SNAPSHOT_FILE ${_VCPKG_INSTALLED_DIR}/vcpkg/toolchain/${VCPKG_TARGET_TRIPLET}.cmake)
+    if(EXISTS ${_VCPKG_SNAPSHOT_FILE})
+        include(${_VCPKG_SNAPSHOT_FILE})
+        set(CMAKE_PROGRAM_PATH ${CMAKE_PROGRAM_PATH} ${_VCPKG_SNAPSHOT_TOOLS_DIRS})
+    else()
+        file(GLOB _VCPKG_TOOLS_DIRS ${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}/tools/*)
+        foreach(_VCPKG_TOOLS_DIR ${_VCPKG_TOOLS_DIRS})
+            if(IS_DIRECTORY ${_VCPKG_TOOLS_DIR})
+                set(CMAKE_PROGRAM_PATH ${CMAKE_PROGRAM_PATH} ${_VCPKG_TOOLS_DIR})
+            endif()
+        endforeach()
+    endif()
 
     option(VCPKG_APPLOCAL_DEPS "Automatically copy dependencies into the output directory for executables." ON)
     function(add_executable name)
@@ -114,7 +121,13 @@ if(NOT VCPKG_TOOLCHAIN)
         list(FIND ARGV "IMPORTED" IMPORTED_IDX)
         list(FIND ARGV "ALIAS" ALIAS_IDX)
         if(IMPORTED_IDX EQUAL -1 AND ALIAS_IDX EQUAL -1)
-            if(VCPKG_APPLOCAL_DEPS)
+            if(VCPKG_APPLOCAL_DEPS AND EXISTS "${_VCPKG_ROOT_DIR}/vcpkg.exe")
+                add_custom_command(TARGET ${name} POST_BUILD
+                    COMMAND "${_VCPKG_ROOT_DIR}/vcpkg.exe" applocal
+                        $<TARGET_FILE:${name}>
+                        "${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}$<$<CONFIG:Debug>:/debug>/bin"
+                )
+            elseif(VCPKG_APPLOCAL_DEPS)
                 add_custom_command(TARGET ${name} POST_BUILD
                     COMMAND powershell -noprofile -executionpolicy Bypass -file ${_VCPKG_TOOLCHAIN_DIR}/msbuild/applocal.ps1
                         -targetBinary $<TARGET_FILE:${name}>
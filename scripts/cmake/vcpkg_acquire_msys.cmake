@@ -4,17 +4,20 @@
 ##
 ## ## Usage
 ## ```cmake
-## vcpkg_acquire_msys(<MSYS_ROOT_VAR>)
+## vcpkg_acquire_msys(<MSYS_ROOT_VAR> [PACKAGES <package>...])
 ## ```
 ##
 ## ## Parameters
 ## ### MSYS_ROOT_VAR
 ## An out-variable that will be set to the path to MSYS2.
 ##
+## ### PACKAGES
+## A list of packages to install into MSYS2 with pacman, unless they already are.
+##
 ## ## Notes
 ## A call to `vcpkg_acquire_msys` will usually be followed by a call to `bash.exe`:
 ## ```cmake
-## vcpkg_acquire_msys(MSYS_ROOT)
+## vcpkg_acquire_msys(MSYS_ROOT PACKAGES make)
 ## set(BASH ${MSYS_ROOT}/usr/bin/bash.exe)
 ##
 ## vcpkg_execute_required_process(
@@ -23,19 +26,8 @@
 ##     LOGNAME build-${TARGET_TRIPLET}-rel
 ## )
 ## ```
-## To ensure a package is available:
-## ```cmake
-## vcpkg_acquire_msys(MSYS_ROOT)
-## set(BASH ${MSYS_ROOT}/usr/bin/bash.exe)
 ##
-## message(STATUS "Installing MSYS Packages")
-## vcpkg_execute_required_process(
-##     COMMAND
-##         ${BASH} --noprofile --norc -c
-##             'PATH=/usr/bin:\$PATH pacman -Sy --noconfirm --needed make'
-##     WORKING_DIRECTORY ${MSYS_ROOT}
-##     LOGNAME pacman-${TARGET_TRIPLET})
-## ```
+## All port builds share one MSYS2 instance, so packages must be installed through `PACKAGES` rather than by running pacman directly: only one build at a time initializes MSYS2 or runs pacman, and pacman does not run at all once the packages are installed. vcpkg remembers the packages each port asked for and installs those of all the ports in an install plan before it starts building them.
 ##
 ## ## Examples
 ##
@@ -44,6 +36,7 @@
 ## * [libvpx](https://github.com/Microsoft/vcpkg/blob/master/ports/libvpx/portfile.cmake)
 
 function(vcpkg_acquire_msys PATH_TO_ROOT_OUT)
+  cmake_parse_arguments(_am "" "" "PACKAGES" ${ARGN})
   set(TOOLPATH ${DOWNLOADS}/tools/msys2)
 
   # detect host architecture
@@ -69,13 +62,23 @@ function(vcpkg_acquire_msys PATH_TO_ROOT_OUT)
 
   set(PATH_TO_ROOT ${TOOLPATH}/${TOOLSUBPATH})
 
+  # Lets vcpkg install the packages before later builds of the port start
+  if(DEFINED VCPKG_MSYS_PACKAGES_MANIFEST)
+    foreach(_package IN LISTS _am_PACKAGES)
+      file(APPEND ${VCPKG_MSYS_PACKAGES_MANIFEST} "${_package}\n")
+    endforeach()
+  endif()
+
+  # Other builds wait while MSYS2 is initialized or pacman runs
+  file(MAKE_DIRECTORY ${TOOLPATH})
+  file(LOCK ${TOOLPATH}/${TOOLSUBPATH}.lock GUARD FUNCTION)
+
   if(NOT EXISTS "${TOOLPATH}/${STAMP}")
     message(STATUS "Acquiring MSYS2...")
     file(DOWNLOAD ${URL} ${DOWNLOADS}/${ARCHIVE}
       EXPECTED_HASH SHA512=${HASH}
     )
     file(REMOVE_RECURSE ${TOOLPATH}/${TOOLSUBPATH})
-    file(MAKE_DIRECTORY ${TOOLPATH})
     execute_process(
       COMMAND ${CMAKE_COMMAND} -E tar xzf ${DOWNLOADS}/${ARCHIVE}
       WORKING_DIRECTORY ${TOOLPATH}
@@ -88,9 +91,36 @@ function(vcpkg_acquire_msys PATH_TO_ROOT_OUT)
       COMMAND ${PATH_TO_ROOT}/usr/bin/bash.exe --noprofile --norc -c "PATH=/usr/bin:\$PATH;pacman -Syu --noconfirm"
       WORKING_DIRECTORY ${TOOLPATH}
     )
-    file(WRITE "${TOOLPATH}/${STAMP}" "0")
+    # The stamp lists the packages which were installed since
+    file(WRITE "${TOOLPATH}/${STAMP}" "")
     message(STATUS "Acquiring MSYS2... OK")
   endif()
 
+  file(STRINGS "${TOOLPATH}/${STAMP}" _installed)
+  set(_missing)
+  foreach(_package IN LISTS _am_PACKAGES)
+    list(FIND _installed "${_package}" _index)
+    if(_index EQUAL -1)
+      list(APPEND _missing ${_package})
+    endif()
+  endforeach()
+
+  if(_missing)
+    list(REMOVE_DUPLICATES _missing)
+    string(REPLACE ";" " " _missing_args "${_missing}")
+    message(STATUS "Installing MSYS packages: ${_missing_args}")
+    execute_process(
+      COMMAND ${PATH_TO_ROOT}/usr/bin/bash.exe --noprofile --norc -c "PATH=/usr/bin:\$PATH;pacman -Sy --noconfirm --needed ${_missing_args}"
+      WORKING_DIRECTORY ${TOOLPATH}
+      RESULT_VARIABLE error_code
+    )
+    if(error_code)
+      message(FATAL_ERROR "Failed to install the MSYS packages: ${_missing_args}")
+    endif()
+    foreach(_package IN LISTS _missing)
+      file(APPEND "${TOOLPATH}/${STAMP}" "${_package}\n")
+    endforeach()
+  endif()
+
   set(${PATH_TO_ROOT_OUT} ${PATH_TO_ROOT} PARENT_SCOPE)
 endfunction()
@@ -25,6 +25,11 @@
 ##
 ## This should only be used for edge cases, such as patches that are known to fail even on a clean source tree.
 ##
+## ## Notes
+## The hashes of the patches which applied are recorded in `.vcpkg-applied-patches` in the source tree, so that the builds of other triplets, which share the source tree, skip them instead of trying to apply them again.
+##
+## vcpkg applies the whole series itself, in one pass over the files the patches change, with the semantics of `git apply --ignore-whitespace`: a hunk may be found away from its line numbers, but all of its context has to match, and a patch which does not apply leaves every file alone. `git apply` is run for each patch only when the script runs without vcpkg.
+##
 ## ## Examples
 ##
 ## * [boost](https://github.com/Microsoft/vcpkg/blob/master/ports/boost/portfile.cmake)
@@ -34,24 +39,63 @@
 function(vcpkg_apply_patches)
     cmake_parse_arguments(_ap "QUIET" "SOURCE_PATH" "PATCHES" ${ARGN})
 
+    set(_ap_OPTIONS)
+    if(_ap_QUIET)
+        list(APPEND _ap_OPTIONS --quiet)
+    endif()
+
+    # vcpkg applies the series in one process, instead of a git process per patch which scans the whole source tree
+    if(DEFINED VCPKG_EXE AND EXISTS ${VCPKG_EXE})
+        execute_process(COMMAND ${VCPKG_EXE} apply-patches ${_ap_SOURCE_PATH} ${_ap_PATCHES} ${_ap_OPTIONS}
+            OUTPUT_VARIABLE _ap_OUTPUT
+            ERROR_VARIABLE _ap_OUTPUT
+            RESULT_VARIABLE error_code
+        )
+        if(error_code)
+            message(FATAL_ERROR "Could not apply the patches:\n${_ap_OUTPUT}")
+        endif()
+        string(REGEX REPLACE "\n$" "" _ap_OUTPUT "${_ap_OUTPUT}")
+        string(REPLACE "\n" ";" _ap_OUTPUT_LINES "${_ap_OUTPUT}")
+        foreach(_ap_LINE ${_ap_OUTPUT_LINES})
+            message(STATUS "${_ap_LINE}")
+        endforeach()
+        return()
+    endif()
+
     find_program(GIT NAMES git git.cmd)
+
+    # Extracting the sources again removes this file along with the patched files
+    set(_ap_APPLIED_PATCHES_FILE ${_ap_SOURCE_PATH}/.vcpkg-applied-patches)
+    set(_ap_APPLIED_PATCHES)
+    if(EXISTS ${_ap_APPLIED_PATCHES_FILE})
+        file(STRINGS ${_ap_APPLIED_PATCHES_FILE} _ap_APPLIED_PATCHES)
+    endif()
+
     set(PATCHNUM 0)
     foreach(PATCH ${_ap_PATCHES})
-        message(STATUS "Applying patch ${PATCH}")
-        set(LOGNAME patch-${TARGET_TRIPLET}-${PATCHNUM})
-        execute_process(
-            COMMAND ${GIT} --work-tree=. --git-dir=.git apply "${PATCH}" --ignore-whitespace --whitespace=nowarn --verbose
-            OUTPUT_FILE ${CURRENT_BUILDTREES_DIR}/${LOGNAME}-out.log
-            ERROR_FILE ${CURRENT_BUILDTREES_DIR}/${LOGNAME}-err.log
-            WORKING_DIRECTORY ${_ap_SOURCE_PATH}
-            RESULT_VARIABLE error_code
-        )
+        file(SHA1 "${PATCH}" _ap_PATCH_HASH)
+        list(FIND _ap_APPLIED_PATCHES ${_ap_PATCH_HASH} _ap_APPLIED_INDEX)
+        if(NOT _ap_APPLIED_INDEX EQUAL -1)
+            message(STATUS "Skipping patch ${PATCH}, which was already applied")
+        else()
+            message(STATUS "Applying patch ${PATCH}")
+            set(LOGNAME patch-${TARGET_TRIPLET}-${PATCHNUM})
+            execute_process(
+                COMMAND ${GIT} --work-tree=. --git-dir=.git apply "${PATCH}" --ignore-whitespace --whitespace=nowarn --verbose
+                OUTPUT_FILE ${CURRENT_BUILDTREES_DIR}/${LOGNAME}-out.log
+                ERROR_FILE ${CURRENT_BUILDTREES_DIR}/${LOGNAME}-err.log
+                WORKING_DIRECTORY ${_ap_SOURCE_PATH}
+                RESULT_VARIABLE error_code
+            )
 
-        if(error_code AND NOT ${_ap_QUIET})
-            message(STATUS "Applying patch failed. This is expected if this patch was previously applied.")
-        endif()
+            if(error_code AND NOT ${_ap_QUIET})
+                message(STATUS "Applying patch failed. This is expected if this patch was previously applied.")
+            elseif(NOT error_code)
+                file(APPEND ${_ap_APPLIED_PATCHES_FILE} "${_ap_PATCH_HASH}\n")
+            endif()
 
-        message(STATUS "Applying patch ${PATCH} done")
+            message(STATUS "Applying patch ${PATCH} done")
+        endif()
         math(EXPR PATCHNUM "${PATCHNUM}+1")
     endforeach()
 endfunction()
@@ -84,9 +84,18 @@ function(vcpkg_build_msbuild)
         /p:VCPkgLocalAppDataDisabled=true
         /p:UseIntelMKL=No
         /p:WindowsTargetPlatformVersion=${_csc_TARGET_PLATFORM_VERSION}
-        /m
     )
 
+    vcpkg_get_compiler_cache_msbuild_options(_csc_COMPILER_CACHE_OPTIONS)
+    list(APPEND _csc_OPTIONS ${_csc_COMPILER_CACHE_OPTIONS})
+
+    # vcpkg sets VCPKG_CONCURRENCY when it builds several ports at once, so that they share the cores
+    if(VCPKG_CONCURRENCY)
+        list(APPEND _csc_OPTIONS /m:${VCPKG_CONCURRENCY} /p:CL_MPCount=${VCPKG_CONCURRENCY})
+    else()
+        list(APPEND _csc_OPTIONS /m)
+    endif()
+
     message(STATUS "Building ${_csc_PROJECT_PATH} for Release")
     file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel)
     vcpkg_execute_required_process(
@@ -0,0 +1,125 @@
+## # vcpkg_checkout_head
+##
+## Check out the head of a git repository for `--head` builds.
+##
+## ## Usage:
+## ```cmake
+## vcpkg_checkout_head(
+##     OUT_SOURCE_PATH <SOURCE_PATH>
+##     OUT_VERSION <_version>
+##     URL <https://github.com/Microsoft/cpprestsdk.git>
+##     REF <master>
+## )
+## ```
+##
+## ## Parameters:
+## ### OUT_SOURCE_PATH
+## Specifies the out-variable that will contain the checked out location.
+##
+## ### OUT_VERSION
+## Specifies the out-variable that will contain the full commit id which was checked out.
+##
+## ### URL
+## The URL of the git repository.
+##
+## ### REF
+## The unstable git commit-ish (ideally a branch) to check out.
+##
+## ## Notes:
+## The objects are kept in a bare repository under `downloads/git`, which all ports and triplets share, so each build only fetches what changed upstream since the last one. The sources are a worktree of that repository which later head builds move to the new commit in place, so the files that did not change keep their timestamps.
+##
+## With `--no-downloads` nothing is fetched, and the commit which was fetched last is checked out.
+##
+## [`vcpkg_from_github`](vcpkg_from_github.md) and `vcpkg_from_bitbucket` use this for head builds.
+function(vcpkg_checkout_head)
+    set(oneValueArgs OUT_SOURCE_PATH OUT_VERSION URL REF)
+    cmake_parse_arguments(_vch "" "${oneValueArgs}" "" ${ARGN})
+
+    if(NOT _vch_OUT_SOURCE_PATH OR NOT _vch_OUT_VERSION)
+        message(FATAL_ERROR "OUT_SOURCE_PATH and OUT_VERSION must be specified.")
+    endif()
+
+    if(NOT _vch_URL OR NOT _vch_REF)
+        message(FATAL_ERROR "URL and REF must be specified.")
+    endif()
+
+    string(REGEX REPLACE "^[a-z]+://" "" _repo_name "${_vch_URL}")
+    string(REGEX REPLACE "\\.git$" "" _repo_name "${_repo_name}")
+    string(REGEX REPLACE "[^A-Za-z0-9._-]+" "-" _repo_name "${_repo_name}")
+    string(REGEX REPLACE "^-" "" _repo_name "${_repo_name}")
+    string(REGEX REPLACE "[^A-Za-z0-9._-]" "-" _ref_name "${_vch_REF}")
+    set(_repo "${DOWNLOADS}/git/${_repo_name}.git")
+    set(_fetched_ref "refs/vcpkg/${_vch_REF}")
+    set(_source_path "${CURRENT_BUILDTREES_DIR}/src/head/${_ref_name}")
+
+    # Builds of other triplets, and of other ports from the same repository, wait for this one
+    file(MAKE_DIRECTORY "${DOWNLOADS}/git")
+    file(LOCK "${_repo}.lock" GUARD FUNCTION)
+
+    if(NOT EXISTS "${_repo}/HEAD")
+        if(_VCPKG_NO_DOWNLOADS)
+            message(FATAL_ERROR "Downloads are disabled, but '${_repo}' does not exist.")
+        endif()
+        file(REMOVE_RECURSE "${_repo}")
+        vcpkg_execute_required_process(
+            COMMAND ${GIT} init --bare "${_repo}"
+            WORKING_DIRECTORY "${DOWNLOADS}/git"
+            LOGNAME git-init-${TARGET_TRIPLET}
+        )
+    endif()
+
+    if(_VCPKG_NO_DOWNLOADS)
+        message(STATUS "Using the last fetched ${_vch_REF} of ${_vch_URL}")
+    else()
+        message(STATUS "Fetching ${_vch_REF} of ${_vch_URL}...")
+        vcpkg_execute_required_process(
+            COMMAND ${GIT} --git-dir "${_repo}" fetch --quiet "${_vch_URL}" "+${_vch_REF}:${_fetched_ref}"
+            WORKING_DIRECTORY "${DOWNLOADS}/git"
+            LOGNAME git-fetch-${TARGET_TRIPLET}
+        )
+    endif()
+
+    execute_process(
+        COMMAND ${GIT} --git-dir "${_repo}" rev-parse --verify --quiet "${_fetched_ref}^{commit}"
+        OUTPUT_VARIABLE _version
+        OUTPUT_STRIP_TRAILING_WHITESPACE
+        RESULT_VARIABLE error_code
+    )
+    if(error_code)
+        message(FATAL_ERROR "${_vch_REF} of ${_vch_URL} was never fetched into '${_repo}'.")
+    endif()
+
+    # A worktree has a .git file rather than a directory, so a directory which merely lies inside another
+    # repository is never mistaken for one
+    if(EXISTS "${_source_path}/.git" AND NOT IS_DIRECTORY "${_source_path}/.git")
+        message(STATUS "Updating ${_source_path} to ${_version}")
+        vcpkg_execute_required_process(
+            COMMAND ${GIT} checkout --quiet --force --detach ${_version}
+            WORKING_DIRECTORY "${_source_path}"
+            LOGNAME git-checkout-${TARGET_TRIPLET}
+        )
+        # Removes what earlier builds patched in, which the patches add back
+        vcpkg_execute_required_process(
+            COMMAND ${GIT} clean --quiet -ffdx
+            WORKING_DIRECTORY "${_source_path}"
+            LOGNAME git-clean-${TARGET_TRIPLET}
+        )
+    else()
+        message(STATUS "Checking out ${_version} to ${_source_path}")
+        file(REMOVE_RECURSE "${_source_path}")
+        # Forgets the worktrees of removed buildtrees
+        vcpkg_execute_required_process(
+            COMMAND ${GIT} --git-dir "${_repo}" worktree prune
+            WORKING_DIRECTORY "${DOWNLOADS}/git"
+            LOGNAME git-worktree-prune-${TARGET_TRIPLET}
+        )
+        vcpkg_execute_required_process(
+            COMMAND ${GIT} --git-dir "${_repo}" worktree add --detach "${_source_path}" ${_version}
+            WORKING_DIRECTORY "${DOWNLOADS}/git"
+            LOGNAME git-worktree-add-${TARGET_TRIPLET}
+        )
+    endif()
+
+    set(${_vch_OUT_SOURCE_PATH} "${_source_path}" PARENT_SCOPE)
+    set(${_vch_OUT_VERSION} "${_version}" PARENT_SCOPE)
+endfunction()
@@ -1,10 +1,17 @@
+# ports.cmake includes these from the bundle which vcpkg writes, if there is one
+if(_VCPKG_COMMON_FUNCTIONS_BUNDLED)
+    return()
+endif()
+
 include(vcpkg_acquire_msys)
 include(vcpkg_download_distfile)
 include(vcpkg_extract_source_archive)
 include(vcpkg_execute_required_process)
 include(vcpkg_execute_required_process_repeat)
+include(vcpkg_execute_required_process_parallel)
 include(vcpkg_find_acquire_program)
 include(vcpkg_fixup_cmake_targets)
+include(vcpkg_checkout_head)
 include(vcpkg_from_github)
 include(vcpkg_from_bitbucket)
 include(vcpkg_build_cmake)
@@ -0,0 +1,92 @@
+# Routes the compiler through the clcache or sccache executable which the triplet sets in VCPKG_COMPILER_CACHE.
+# ports.cmake calls vcpkg_start_compiler_cache() and vcpkg_report_compiler_cache() around the portfile; the build
+# helpers add the options from vcpkg_get_compiler_cache_cmake_options() and vcpkg_get_compiler_cache_msbuild_options().
+
+function(_vcpkg_get_compiler_cache_kind OUT_VAR)
+    get_filename_component(_vgcck_NAME "${VCPKG_COMPILER_CACHE}" NAME_WE)
+    string(TOLOWER "${_vgcck_NAME}" _vgcck_NAME)
+    if(NOT _vgcck_NAME STREQUAL "clcache" AND NOT _vgcck_NAME STREQUAL "sccache")
+        message(FATAL_ERROR "VCPKG_COMPILER_CACHE must be the path to clcache.exe or sccache.exe, but was '${VCPKG_COMPILER_CACHE}'")
+    endif()
+    set(${OUT_VAR} ${_vgcck_NAME} PARENT_SCOPE)
+endfunction()
+
+function(vcpkg_start_compiler_cache)
+    if(NOT VCPKG_COMPILER_CACHE)
+        return()
+    endif()
+    if(NOT EXISTS "${VCPKG_COMPILER_CACHE}")
+        message(FATAL_ERROR "The compiler cache set in VCPKG_COMPILER_CACHE does not exist: ${VCPKG_COMPILER_CACHE}")
+    endif()
+    _vcpkg_get_compiler_cache_kind(_vscc_KIND)
+
+    # The cache is shared by all ports and triplets unless the environment already points somewhere else, for
+    # example to a directory shared between CI agents
+    if(NOT DEFINED ENV{CLCACHE_DIR})
+        set(ENV{CLCACHE_DIR} ${DOWNLOADS}/compiler-cache/clcache)
+    endif()
+    if(NOT DEFINED ENV{SCCACHE_DIR})
+        set(ENV{SCCACHE_DIR} ${DOWNLOADS}/compiler-cache/sccache)
+    endif()
+
+    if(_vscc_KIND STREQUAL "clcache")
+        execute_process(COMMAND ${VCPKG_COMPILER_CACHE} -z OUTPUT_QUIET ERROR_QUIET)
+    else()
+        execute_process(COMMAND ${VCPKG_COMPILER_CACHE} --zero-stats OUTPUT_QUIET ERROR_QUIET)
+    endif()
+endfunction()
+
+# The statistics are those of the whole cache, so they include any ports which were built at the same time
+function(vcpkg_report_compiler_cache)
+    if(NOT VCPKG_COMPILER_CACHE)
+        return()
+    endif()
+    _vcpkg_get_compiler_cache_kind(_vrcc_KIND)
+
+    if(_vrcc_KIND STREQUAL "clcache")
+        set(_vrcc_STATS_ARG -s)
+    else()
+        set(_vrcc_STATS_ARG --show-stats)
+    endif()
+    set(_vrcc_LOG ${CURRENT_BUILDTREES_DIR}/compiler-cache-${TARGET_TRIPLET}.log)
+    execute_process(
+        COMMAND ${VCPKG_COMPILER_CACHE} ${_vrcc_STATS_ARG}
+        OUTPUT_FILE ${_vrcc_LOG}
+        ERROR_QUIET
+    )
+
+    file(READ ${_vrcc_LOG} _vrcc_STATS)
+    string(REGEX MATCH "[Cc]ache hits[^0-9\n]*([0-9]+)" _vrcc_MATCH "${_vrcc_STATS}")
+    set(_vrcc_HITS "${CMAKE_MATCH_1}")
+    string(REGEX MATCH "[Cc]ache misses[^0-9\n]*([0-9]+)" _vrcc_MATCH "${_vrcc_STATS}")
+    set(_vrcc_MISSES "${CMAKE_MATCH_1}")
+    file(TO_NATIVE_PATH "${_vrcc_LOG}" _vrcc_NATIVE_LOG)
+    message(STATUS "Compiler cache: ${_vrcc_HITS} hits, ${_vrcc_MISSES} misses (see ${_vrcc_NATIVE_LOG})")
+endfunction()
+
+# Ninja and Makefile generators launch the compiler through the cache
+function(vcpkg_get_compiler_cache_cmake_options OUT_VAR)
+    set(_vgccco_OPTIONS)
+    if(VCPKG_COMPILER_CACHE)
+        list(APPEND _vgccco_OPTIONS
+            "-DCMAKE_C_COMPILER_LAUNCHER=${VCPKG_COMPILER_CACHE}"
+            "-DCMAKE_CXX_COMPILER_LAUNCHER=${VCPKG_COMPILER_CACHE}"
+        )
+    endif()
+    set(${OUT_VAR} ${_vgccco_OPTIONS} PARENT_SCOPE)
+endfunction()
+
+# MSBuild can replace cl.exe with clcache, which accepts the same command line; sccache cannot be used this way
+function(vcpkg_get_compiler_cache_msbuild_options OUT_VAR)
+    set(_vgccmo_OPTIONS)
+    if(VCPKG_COMPILER_CACHE)
+        _vcpkg_get_compiler_cache_kind(_vgccmo_KIND)
+        if(_vgccmo_KIND STREQUAL "clcache")
+            get_filename_component(_vgccmo_NAME "${VCPKG_COMPILER_CACHE}" NAME)
+            get_filename_component(_vgccmo_DIR "${VCPKG_COMPILER_CACHE}" DIRECTORY)
+            file(TO_NATIVE_PATH "${_vgccmo_DIR}" _vgccmo_DIR)
+            list(APPEND _vgccmo_OPTIONS "/p:CLToolExe=${_vgccmo_NAME}" "/p:CLToolPath=${_vgccmo_DIR}")
+        endif()
+    endif()
+    set(${OUT_VAR} ${_vgccmo_OPTIONS} PARENT_SCOPE)
+endfunction()
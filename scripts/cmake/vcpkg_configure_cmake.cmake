@@ -7,6 +7,7 @@
 ## vcpkg_configure_cmake(
 ##     SOURCE_PATH <${SOURCE_PATH}>
 ##     [PREFER_NINJA]
+##     [PARALLEL_CONFIGURE]
 ##     [GENERATOR <"NMake Makefiles">]
 ##     [OPTIONS <-DUSE_THIS_IN_ALL_BUILDS=1>...]
 ##     [OPTIONS_RELEASE <-DOPTIMIZE=1>...]
@@ -21,6 +22,9 @@
 ## ### PREFER_NINJA
 ## Indicates that, when available, Vcpkg should use Ninja to perform the build. This should be specified unless the port is known to not work under Ninja.
 ##
+## ### PARALLEL_CONFIGURE
+## Configures the Release and Debug builds at the same time. This should only be specified once the project's configure step is known not to write to the source directory, for example with `configure_file` or `file(RENAME)`, since both configure steps would then race on the same files.
+##
 ## ### GENERATOR
 ## Specifies the precise generator to use.
 ##
@@ -38,6 +42,10 @@
 ## ## Notes
 ## This command supplies many common arguments to CMake. To see the full list, examine the source.
 ##
+## When the triplet sets `VCPKG_BUILD_TYPE` to `release`, only the Release build is configured, and `vcpkg_build_cmake` and `vcpkg_install_cmake` only build and install it.
+##
+## When building with `vcpkg build --incremental`, the build trees of the previous build are reused if they were configured with the same arguments, so only the build and install steps run again.
+##
 ## ## Examples
 ##
 ## * [zlib](https://github.com/Microsoft/vcpkg/blob/master/ports/zlib/portfile.cmake)
@@ -45,7 +53,7 @@
 ## * [poco](https://github.com/Microsoft/vcpkg/blob/master/ports/poco/portfile.cmake)
 ## * [opencv](https://github.com/Microsoft/vcpkg/blob/master/ports/opencv/portfile.cmake)
 function(vcpkg_configure_cmake)
-    cmake_parse_arguments(_csc "PREFER_NINJA" "SOURCE_PATH;GENERATOR" "OPTIONS;OPTIONS_DEBUG;OPTIONS_RELEASE" ${ARGN})
+    cmake_parse_arguments(_csc "PREFER_NINJA;PARALLEL_CONFIGURE" "SOURCE_PATH;GENERATOR" "OPTIONS;OPTIONS_DEBUG;OPTIONS_RELEASE" ${ARGN})
 
     if(NOT VCPKG_PLATFORM_TOOLSET)
         message(FATAL_ERROR "Vcpkg has been updated with VS2017 support, however you need to rebuild vcpkg.exe by re-running bootstrap-vcpkg.bat\n")
@@ -95,8 +103,6 @@ function(vcpkg_configure_cmake)
         set(ENV{PATH} "$ENV{PATH};${NINJA_PATH}")
     endif()
 
-    file(REMOVE_RECURSE ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg)
-
     if(DEFINED VCPKG_CMAKE_SYSTEM_NAME)
         list(APPEND _csc_OPTIONS -DCMAKE_SYSTEM_NAME=${VCPKG_CMAKE_SYSTEM_NAME})
     endif()
@@ -125,10 +131,22 @@ function(vcpkg_configure_cmake)
         message(FATAL_ERROR "You must set both the VCPKG_CXX_FLAGS and VCPKG_C_FLAGS")
     endif()
 
+    if(NOT GENERATOR MATCHES "^Visual Studio")
+        vcpkg_get_compiler_cache_cmake_options(_csc_COMPILER_CACHE_OPTIONS)
+        list(APPEND _csc_OPTIONS ${_csc_COMPILER_CACHE_OPTIONS})
+    endif()
+
+    # Limits the compiler processes of each project when vcpkg builds several ports at once
+    if(VCPKG_CONCURRENCY)
+        set(_csc_MP_FLAG /MP${VCPKG_CONCURRENCY})
+    else()
+        set(_csc_MP_FLAG /MP)
+    endif()
+
     list(APPEND _csc_OPTIONS
         "-DVCPKG_TARGET_TRIPLET=${TARGET_TRIPLET}"
-        "-DCMAKE_CXX_FLAGS= /DWIN32 /D_WINDOWS /W3 /utf-8 /GR /EHsc /MP ${VCPKG_CXX_FLAGS}"
-        "-DCMAKE_C_FLAGS= /DWIN32 /D_WINDOWS /W3 /utf-8 /MP ${VCPKG_C_FLAGS}"
+        "-DCMAKE_CXX_FLAGS= /DWIN32 /D_WINDOWS /W3 /utf-8 /GR /EHsc ${_csc_MP_FLAG} ${VCPKG_CXX_FLAGS}"
+        "-DCMAKE_C_FLAGS= /DWIN32 /D_WINDOWS /W3 /utf-8 ${_csc_MP_FLAG} ${VCPKG_C_FLAGS}"
         "-DCMAKE_EXPORT_NO_PACKAGE_REGISTRY=ON"
         "-DCMAKE_FIND_PACKAGE_NO_PACKAGE_REGISTRY=ON"
         "-DCMAKE_FIND_PACKAGE_NO_SYSTEM_PACKAGE_REGISTRY=ON"
@@ -165,27 +183,82 @@ function(vcpkg_configure_cmake)
         "-DCMAKE_EXE_LINKER_FLAGS_RELEASE=/DEBUG /INCREMENTAL:NO /OPT:REF /OPT:ICF ${VCPKG_LINKER_FLAGS}"
     )
 
-    message(STATUS "Configuring ${TARGET_TRIPLET}-rel")
-    file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel)
-    vcpkg_execute_required_process(
-        COMMAND ${CMAKE_COMMAND} ${_csc_SOURCE_PATH} ${_csc_OPTIONS} ${_csc_OPTIONS_RELEASE}
-            -G ${GENERATOR}
-            -DCMAKE_BUILD_TYPE=Release
-            -DCMAKE_INSTALL_PREFIX=${CURRENT_PACKAGES_DIR}
-        WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel
-        LOGNAME config-${TARGET_TRIPLET}-rel
+    # Records the arguments which the build trees were configured with, for incremental builds
+    set(_csc_CONFIGURE_STAMP ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}.vcpkg_configure.txt)
+    set(_csc_CONFIGURE_ARGS "${CMAKE_COMMAND};${_csc_SOURCE_PATH};${GENERATOR};${_csc_OPTIONS};${_csc_OPTIONS_RELEASE};${_csc_OPTIONS_DEBUG};${CURRENT_PACKAGES_DIR}")
+    if(VCPKG_INCREMENTAL_BUILD AND EXISTS ${_csc_CONFIGURE_STAMP}
+        AND EXISTS ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel/CMakeCache.txt
+        AND (VCPKG_BUILD_TYPE STREQUAL "release" OR EXISTS ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg/CMakeCache.txt))
+        file(READ ${_csc_CONFIGURE_STAMP} _csc_PREVIOUS_CONFIGURE_ARGS)
+        if("${_csc_PREVIOUS_CONFIGURE_ARGS}" STREQUAL "${_csc_CONFIGURE_ARGS}")
+            message(STATUS "Reusing the configured build trees of ${TARGET_TRIPLET}")
+            return()
+        endif()
+    endif()
+
+    file(REMOVE_RECURSE ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg ${_csc_CONFIGURE_STAMP})
+
+    set(_csc_COMMAND_RELEASE ${CMAKE_COMMAND} ${_csc_SOURCE_PATH} ${_csc_OPTIONS} ${_csc_OPTIONS_RELEASE}
+        -G ${GENERATOR}
+        -DCMAKE_BUILD_TYPE=Release
+        -DCMAKE_INSTALL_PREFIX=${CURRENT_PACKAGES_DIR}
     )
-    message(STATUS "Configuring ${TARGET_TRIPLET}-rel done")
-
-    message(STATUS "Configuring ${TARGET_TRIPLET}-dbg")
-    file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg)
-    vcpkg_execute_required_process(
-        COMMAND ${CMAKE_COMMAND} ${_csc_SOURCE_PATH} ${_csc_OPTIONS} ${_csc_OPTIONS_DEBUG}
-            -G ${GENERATOR}
-            -DCMAKE_BUILD_TYPE=Debug
-            -DCMAKE_INSTALL_PREFIX=${CURRENT_PACKAGES_DIR}/debug
-        WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg
-        LOGNAME config-${TARGET_TRIPLET}-dbg
+    set(_csc_COMMAND_DEBUG ${CMAKE_COMMAND} ${_csc_SOURCE_PATH} ${_csc_OPTIONS} ${_csc_OPTIONS_DEBUG}
+        -G ${GENERATOR}
+        -DCMAKE_BUILD_TYPE=Debug
+        -DCMAKE_INSTALL_PREFIX=${CURRENT_PACKAGES_DIR}/debug
     )
-    message(STATUS "Configuring ${TARGET_TRIPLET}-dbg done")
+    file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel)
+
+    if(VCPKG_BUILD_TYPE STREQUAL "release")
+        message(STATUS "Configuring ${TARGET_TRIPLET}-rel")
+        vcpkg_mark_phase(begin configure-rel)
+        vcpkg_execute_required_process(
+            COMMAND ${_csc_COMMAND_RELEASE}
+            WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel
+            LOGNAME config-${TARGET_TRIPLET}-rel
+        )
+        vcpkg_mark_phase(end configure-rel)
+        message(STATUS "Configuring ${TARGET_TRIPLET}-rel done")
+    elseif(_csc_PARALLEL_CONFIGURE)
+        file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg)
+        # Configuring is mostly single-threaded, so both configurations run at once
+        message(STATUS "Configuring ${TARGET_TRIPLET}-rel and ${TARGET_TRIPLET}-dbg")
+        vcpkg_mark_phase(begin configure-rel)
+        vcpkg_mark_phase(begin configure-dbg)
+        vcpkg_execute_required_process_parallel(
+            COMMAND_RELEASE ${_csc_COMMAND_RELEASE}
+            WORKING_DIRECTORY_RELEASE ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel
+            LOGNAME_RELEASE config-${TARGET_TRIPLET}-rel
+            COMMAND_DEBUG ${_csc_COMMAND_DEBUG}
+            WORKING_DIRECTORY_DEBUG ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg
+            LOGNAME_DEBUG config-${TARGET_TRIPLET}-dbg
+        )
+        vcpkg_mark_phase(end configure-rel)
+        vcpkg_mark_phase(end configure-dbg)
+        message(STATUS "Configuring ${TARGET_TRIPLET}-rel and ${TARGET_TRIPLET}-dbg done")
+    else()
+        file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg)
+        message(STATUS "Configuring ${TARGET_TRIPLET}-rel")
+        vcpkg_mark_phase(begin configure-rel)
+        vcpkg_execute_required_process(
+            COMMAND ${_csc_COMMAND_RELEASE}
+            WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel
+            LOGNAME config-${TARGET_TRIPLET}-rel
+        )
+        vcpkg_mark_phase(end configure-rel)
+        message(STATUS "Configuring ${TARGET_TRIPLET}-rel done")
+
+        message(STATUS "Configuring ${TARGET_TRIPLET}-dbg")
+        vcpkg_mark_phase(begin configure-dbg)
+        vcpkg_execute_required_process(
+            COMMAND ${_csc_COMMAND_DEBUG}
+            WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg
+            LOGNAME config-${TARGET_TRIPLET}-dbg
+        )
+        vcpkg_mark_phase(end configure-dbg)
+        message(STATUS "Configuring ${TARGET_TRIPLET}-dbg done")
+    endif()
+
+    file(WRITE ${_csc_CONFIGURE_STAMP} "${_csc_CONFIGURE_ARGS}")
 endfunction()
\ No newline at end of file
@@ -10,6 +10,8 @@
 ## ## Notes
 ## This command should always be called by portfiles after they have finished rearranging the binary output.
 ##
+## When the build is run by vcpkg, the PDB paths of all the DLLs are read by a single `vcpkg pdbpaths` call. Otherwise `dumpbin /PDBPATH` is run for each DLL.
+##
 ## ## Examples
 ##
 ## * [zlib](https://github.com/Microsoft/vcpkg/blob/master/ports/zlib/portfile.cmake)
@@ -29,6 +31,38 @@ function(vcpkg_copy_pdbs)
 
         set(DLLS_WITHOUT_MATCHING_PDBS)
 
+        if(DLLS AND DEFINED VCPKG_EXE AND EXISTS ${VCPKG_EXE})
+            set(BIN_DIRS)
+            foreach(BIN_DIR ${CURRENT_PACKAGES_DIR}/bin ${CURRENT_PACKAGES_DIR}/debug/bin)
+                if(IS_DIRECTORY ${BIN_DIR})
+                    list(APPEND BIN_DIRS ${BIN_DIR})
+                endif()
+            endforeach()
+            execute_process(COMMAND ${VCPKG_EXE} pdbpaths ${BIN_DIRS}
+                OUTPUT_VARIABLE PDB_LINES
+                RESULT_VARIABLE error_code
+            )
+            if(error_code)
+                message(FATAL_ERROR "Could not read the PDB paths of the DLLs:\n${PDB_LINES}")
+            endif()
+
+            # Each line is <dll>|<pdb>, and the PDB is empty for a DLL without one
+            string(REGEX MATCHALL "[^\r\n]+" PDB_LINES "${PDB_LINES}")
+            foreach(PDB_LINE ${PDB_LINES})
+                string(FIND "${PDB_LINE}" "|" SEPARATOR_INDEX)
+                string(SUBSTRING "${PDB_LINE}" 0 ${SEPARATOR_INDEX} DLL)
+                math(EXPR SEPARATOR_INDEX "${SEPARATOR_INDEX} + 1")
+                string(SUBSTRING "${PDB_LINE}" ${SEPARATOR_INDEX} -1 PDB_PATH)
+                if(PDB_PATH AND EXISTS "${PDB_PATH}")
+                    get_filename_component(DLL_DIR ${DLL} DIRECTORY)
+                    file(COPY ${PDB_PATH} DESTINATION ${DLL_DIR})
+                else()
+                    list(APPEND DLLS_WITHOUT_MATCHING_PDBS ${DLL})
+                endif()
+            endforeach()
+            set(DLLS)
+        endif()
+
         set(PREVIOUS_VSLANG $ENV{VSLANG})
         set(ENV{VSLANG} 1033)
 
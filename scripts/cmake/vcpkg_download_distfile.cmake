@@ -29,6 +29,8 @@
 ## ## Notes
 ## The command [`vcpkg_from_github`](vcpkg_from_github.md) should be used instead of this for downloading the main archive for GitHub projects.
 ##
+## When the build is run by vcpkg, the file is fetched by `vcpkg download`. It splits large files between several connections when the server accepts ranged requests, checks the SHA512 as the data arrives, and resumes an interrupted download from the `.partial` file it leaves in the downloads directory, even from another of the URLS.
+##
 ## ## Examples
 ##
 ## * [boost](https://github.com/Microsoft/vcpkg/blob/master/ports/boost/portfile.cmake)
@@ -40,6 +42,12 @@ function(vcpkg_download_distfile VAR)
     cmake_parse_arguments(vcpkg_download_distfile "" "${oneValueArgs}" "${multipleValuesArgs}" ${ARGN})
     set(downloaded_file_path ${DOWNLOADS}/${vcpkg_download_distfile_FILENAME})
 
+    # Lets vcpkg prefetch this file the next time the port is part of an install plan
+    if(DEFINED VCPKG_DISTFILES_MANIFEST)
+        file(APPEND ${VCPKG_DISTFILES_MANIFEST}
+            "${vcpkg_download_distfile_SHA512};${vcpkg_download_distfile_FILENAME};${vcpkg_download_distfile_URLS}\n")
+    endif()
+
     function(test_hash FILE_KIND CUSTOM_ERROR_ADVICE)
         message(STATUS "Testing integrity of ${FILE_KIND}...")
         file(SHA512 ${downloaded_file_path} FILE_HASH)
@@ -63,6 +71,26 @@ function(vcpkg_download_distfile VAR)
         endif()
 
         # Tries to download the file.
+        vcpkg_mark_phase(begin download)
+        if(DEFINED VCPKG_EXE AND EXISTS ${VCPKG_EXE})
+            # vcpkg tries the URLs in order and verifies the hash itself
+            message(STATUS "Downloading ${vcpkg_download_distfile_FILENAME}...")
+            execute_process(
+                COMMAND ${VCPKG_EXE} download ${downloaded_file_path} ${vcpkg_download_distfile_SHA512} ${vcpkg_download_distfile_URLS}
+                RESULT_VARIABLE download_result
+            )
+            vcpkg_mark_phase(end download)
+            if(NOT download_result EQUAL 0)
+                message(FATAL_ERROR
+                "\n"
+                "    Failed to download file.\n"
+                "    Add mirrors or submit an issue at https://github.com/Microsoft/vcpkg/issues\n")
+            endif()
+            message(STATUS "Downloading ${vcpkg_download_distfile_FILENAME}... OK")
+            set(${VAR} ${downloaded_file_path} PARENT_SCOPE)
+            return()
+        endif()
+
         foreach(url IN LISTS vcpkg_download_distfile_URLS)
             message(STATUS "Downloading ${url}...")
             file(DOWNLOAD ${url} ${downloaded_file_path} STATUS download_status)
@@ -77,6 +105,7 @@ function(vcpkg_download_distfile VAR)
                 break()
             endif()
         endforeach(url)
+        vcpkg_mark_phase(end download)
 
         if (NOT ${download_success})
             message(FATAL_ERROR
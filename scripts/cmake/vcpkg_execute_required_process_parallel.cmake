@@ -0,0 +1,93 @@
+## # vcpkg_execute_required_process_parallel
+##
+## Execute the release and debug variants of a process at the same time with logging, and fail the build if either command fails.
+##
+## ## Usage
+## ```cmake
+## vcpkg_execute_required_process_parallel(
+##     COMMAND_RELEASE <${CMAKE_COMMAND}> [<arguments>...]
+##     WORKING_DIRECTORY_RELEASE <${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel>
+##     LOGNAME_RELEASE <build-${TARGET_TRIPLET}-rel>
+##     COMMAND_DEBUG <${CMAKE_COMMAND}> [<arguments>...]
+##     WORKING_DIRECTORY_DEBUG <${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg>
+##     LOGNAME_DEBUG <build-${TARGET_TRIPLET}-dbg>
+## )
+## ```
+## ## Parameters
+## ### COMMAND_RELEASE, COMMAND_DEBUG
+## The commands to be executed, along with their arguments.
+##
+## ### WORKING_DIRECTORY_RELEASE, WORKING_DIRECTORY_DEBUG
+## The directories to execute the commands in.
+##
+## ### LOGNAME_RELEASE, LOGNAME_DEBUG
+## The prefixes to use for the log files, as for [`vcpkg_execute_required_process`](vcpkg_execute_required_process.md).
+##
+## ## Notes
+## The commands must not write to the same files, for example in the source directory. The commands do not receive any input.
+##
+## ## Examples
+##
+## * [vcpkg_configure_cmake](https://github.com/Microsoft/vcpkg/blob/master/scripts/cmake/vcpkg_configure_cmake.cmake)
+## * [vcpkg_build_cmake](https://github.com/Microsoft/vcpkg/blob/master/scripts/cmake/vcpkg_build_cmake.cmake)
+include(vcpkg_execute_required_process)
+
+# Writes a script which runs the command with logging and records its result next to the script
+function(_vcpkg_write_logged_process_script SCRIPT WORKING_DIRECTORY LOGNAME)
+    set(_vwlps_COMMAND)
+    foreach(_vwlps_ARG ${ARGN})
+        string(APPEND _vwlps_COMMAND " [==[${_vwlps_ARG}]==]")
+    endforeach()
+    file(WRITE ${SCRIPT}
+        "execute_process(\n"
+        "    COMMAND${_vwlps_COMMAND}\n"
+        "    OUTPUT_FILE [==[${CURRENT_BUILDTREES_DIR}/${LOGNAME}-out.log]==]\n"
+        "    ERROR_FILE [==[${CURRENT_BUILDTREES_DIR}/${LOGNAME}-err.log]==]\n"
+        "    RESULT_VARIABLE error_code\n"
+        "    WORKING_DIRECTORY [==[${WORKING_DIRECTORY}]==])\n"
+        "file(WRITE [==[${SCRIPT}.result]==] \"\${error_code}\")\n"
+    )
+    file(REMOVE ${SCRIPT}.result)
+endfunction()
+
+function(vcpkg_execute_required_process_parallel)
+    cmake_parse_arguments(_verpp
+        ""
+        "WORKING_DIRECTORY_RELEASE;LOGNAME_RELEASE;WORKING_DIRECTORY_DEBUG;LOGNAME_DEBUG"
+        "COMMAND_RELEASE;COMMAND_DEBUG"
+        ${ARGN}
+    )
+
+    foreach(_verpp_CONFIG RELEASE DEBUG)
+        set(_verpp_SCRIPT_${_verpp_CONFIG} ${CURRENT_BUILDTREES_DIR}/${_verpp_LOGNAME_${_verpp_CONFIG}}.vcpkg_process.cmake)
+        _vcpkg_write_logged_process_script(
+            ${_verpp_SCRIPT_${_verpp_CONFIG}}
+            ${_verpp_WORKING_DIRECTORY_${_verpp_CONFIG}}
+            ${_verpp_LOGNAME_${_verpp_CONFIG}}
+            ${_verpp_COMMAND_${_verpp_CONFIG}}
+        )
+    endforeach()
+
+    # execute_process starts all of its commands at once as a pipeline. Nothing is written to the pipe, since each
+    # script sends the output of its command to the log files.
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -P ${_verpp_SCRIPT_RELEASE}
+        COMMAND ${CMAKE_COMMAND} -P ${_verpp_SCRIPT_DEBUG}
+    )
+
+    file(TO_NATIVE_PATH "${CURRENT_BUILDTREES_DIR}" NATIVE_BUILDTREES_DIR)
+    foreach(_verpp_CONFIG RELEASE DEBUG)
+        set(error_code "no result")
+        if(EXISTS ${_verpp_SCRIPT_${_verpp_CONFIG}}.result)
+            file(READ ${_verpp_SCRIPT_${_verpp_CONFIG}}.result error_code)
+        endif()
+        if(error_code)
+            message(FATAL_ERROR
+                "  Command failed: ${_verpp_COMMAND_${_verpp_CONFIG}}\n"
+                "  Working Directory: ${_verpp_WORKING_DIRECTORY_${_verpp_CONFIG}}\n"
+                "  See logs for more information:\n"
+                "    ${NATIVE_BUILDTREES_DIR}\\${_verpp_LOGNAME_${_verpp_CONFIG}}-out.log\n"
+                "    ${NATIVE_BUILDTREES_DIR}\\${_verpp_LOGNAME_${_verpp_CONFIG}}-err.log\n")
+        endif()
+    endforeach()
+endfunction()
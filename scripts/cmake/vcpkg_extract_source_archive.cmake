@@ -20,7 +20,11 @@
 ## This can be used to mimic git submodules, by extracting into a subdirectory of another archive.
 ##
 ## ## Notes
-## This command will also create a tracking file named <FILENAME>.extracted in the TARGET_DIRECTORY. This file, when present, will suppress the extraction of the archive.
+## This command will also create a tracking file named <FILENAME>.extracted in the TARGET_DIRECTORY. This file, when present, will suppress the extraction of the archive. The file records the timestamp of the archive, so an archive which was downloaded again is extracted again, replacing the previously extracted directories.
+##
+## All triplets of a port share the extracted sources.
+##
+## Archives compressed with bzip2 or xz are decompressed and unpacked by two 7-Zip processes connected by a pipe, which is much faster than `cmake -E tar` for large sources. 7-Zip is used when it is installed, or was already acquired by [`vcpkg_find_acquire_program`](vcpkg_find_acquire_program.md); it is never downloaded for this, so builds without network access keep working. Otherwise, or if 7-Zip fails, the archive is extracted with `cmake -E tar`.
 ##
 ## ## Examples
 ##
@@ -28,6 +32,49 @@
 ## * [protobuf](https://github.com/Microsoft/vcpkg/blob/master/ports/protobuf/portfile.cmake)
 ## * [msgpack](https://github.com/Microsoft/vcpkg/blob/master/ports/msgpack/portfile.cmake)
 include(vcpkg_execute_required_process)
+include(vcpkg_get_program_files_32_bit)
+include(vcpkg_get_program_files_platform_bitness)
+
+# Decompresses with multi-threaded 7-Zip while a second 7-Zip unpacks the tar stream, so neither waits for the other
+function(_vcpkg_extract_with_7z ARCHIVE WORKING_DIRECTORY OUT_SUCCEEDED)
+    set(${OUT_SUCCEEDED} OFF PARENT_SCOPE)
+    string(TOLOWER "${ARCHIVE}" _vew7_ARCHIVE_LOWER)
+    if(NOT _vew7_ARCHIVE_LOWER MATCHES "(\\.tar\\.bz2|\\.tbz2|\\.tar\\.xz|\\.txz)$")
+        return()
+    endif()
+
+    # vcpkg_find_acquire_program() would download the installer when 7-Zip is missing, and fail the build when it
+    # cannot, so 7-Zip is only looked for where it is installed or where an earlier acquisition left it
+    if(NOT "${7Z}" STREQUAL "" AND NOT "${7Z}" MATCHES "-NOTFOUND")
+        set(_vew7_7Z ${7Z})
+    elseif(DEFINED _VCPKG_ACQUIRED_7Z)
+        set(_vew7_7Z ${_VCPKG_ACQUIRED_7Z})
+    else()
+        vcpkg_get_program_files_platform_bitness(_vew7_PROGRAM_FILES_PLATFORM_BITNESS)
+        vcpkg_get_program_files_32_bit(_vew7_PROGRAM_FILES_32_BIT)
+        find_program(_vew7_7Z 7z
+            PATHS "${_vew7_PROGRAM_FILES_PLATFORM_BITNESS}/7-Zip" "${_vew7_PROGRAM_FILES_32_BIT}/7-Zip" ${DOWNLOADS}/tools/7z/Files/7-Zip
+        )
+    endif()
+    if(NOT _vew7_7Z OR NOT EXISTS "${_vew7_7Z}")
+        return()
+    endif()
+
+    # The result is that of the unpacking, which fails when the decompressed stream is cut short
+    execute_process(
+        COMMAND ${_vew7_7Z} x ${ARCHIVE} -so -mmt=on -bd
+        COMMAND ${_vew7_7Z} x -si -ttar -y -bd
+        OUTPUT_FILE ${CURRENT_BUILDTREES_DIR}/extract-out.log
+        ERROR_FILE ${CURRENT_BUILDTREES_DIR}/extract-err.log
+        RESULT_VARIABLE error_code
+        WORKING_DIRECTORY ${WORKING_DIRECTORY}
+    )
+    if(error_code)
+        message(STATUS "Extracting with 7-Zip failed, falling back to cmake -E tar")
+        return()
+    endif()
+    set(${OUT_SUCCEEDED} ON PARENT_SCOPE)
+endfunction()
 
 function(vcpkg_extract_source_archive_ex)
     cmake_parse_arguments(_vesae "" "ARCHIVE;WORKING_DIRECTORY" "" ${ARGN})
@@ -43,15 +90,40 @@ function(vcpkg_extract_source_archive_ex)
     endif()
 
     get_filename_component(ARCHIVE_FILENAME ${_vesae_ARCHIVE} NAME)
-    if(NOT EXISTS ${WORKING_DIRECTORY}/${ARCHIVE_FILENAME}.extracted)
+    set(_vesae_MARKER ${WORKING_DIRECTORY}/${ARCHIVE_FILENAME}.extracted)
+    file(TIMESTAMP ${_vesae_ARCHIVE} _vesae_ARCHIVE_TIMESTAMP "%Y-%m-%dT%H:%M:%S" UTC)
+    set(_vesae_EXTRACTED_TIMESTAMP)
+    if(EXISTS ${_vesae_MARKER})
+        file(READ ${_vesae_MARKER} _vesae_EXTRACTED_TIMESTAMP)
+    endif()
+
+    if(NOT "${_vesae_EXTRACTED_TIMESTAMP}" STREQUAL "${_vesae_ARCHIVE_TIMESTAMP}")
         message(STATUS "Extracting source ${_vesae_ARCHIVE}")
-        file(MAKE_DIRECTORY ${WORKING_DIRECTORY})
-        vcpkg_execute_required_process(
-            COMMAND ${CMAKE_COMMAND} -E tar xjf ${_vesae_ARCHIVE}
-            WORKING_DIRECTORY ${WORKING_DIRECTORY}
-            LOGNAME extract
-        )
-        file(WRITE ${WORKING_DIRECTORY}/${ARCHIVE_FILENAME}.extracted)
+        vcpkg_mark_phase(begin extract)
+        set(_vesae_EXTRACT_DIR ${WORKING_DIRECTORY}/${ARCHIVE_FILENAME}.tmp)
+        file(REMOVE_RECURSE ${_vesae_EXTRACT_DIR})
+        file(MAKE_DIRECTORY ${_vesae_EXTRACT_DIR})
+        _vcpkg_extract_with_7z(${_vesae_ARCHIVE} ${_vesae_EXTRACT_DIR} _vesae_EXTRACTED)
+        if(NOT _vesae_EXTRACTED)
+            file(REMOVE_RECURSE ${_vesae_EXTRACT_DIR})
+            file(MAKE_DIRECTORY ${_vesae_EXTRACT_DIR})
+            vcpkg_execute_required_process(
+                COMMAND ${CMAKE_COMMAND} -E tar xjf ${_vesae_ARCHIVE}
+                WORKING_DIRECTORY ${_vesae_EXTRACT_DIR}
+                LOGNAME extract
+            )
+        endif()
+
+        # Replacing the previous directories whole drops any files which patches added to them
+        file(GLOB _vesae_ENTRIES RELATIVE ${_vesae_EXTRACT_DIR} ${_vesae_EXTRACT_DIR}/*)
+        foreach(_vesae_ENTRY ${_vesae_ENTRIES})
+            file(REMOVE_RECURSE ${WORKING_DIRECTORY}/${_vesae_ENTRY})
+            file(RENAME ${_vesae_EXTRACT_DIR}/${_vesae_ENTRY} ${WORKING_DIRECTORY}/${_vesae_ENTRY})
+        endforeach()
+        file(REMOVE_RECURSE ${_vesae_EXTRACT_DIR})
+
+        file(WRITE ${_vesae_MARKER} "${_vesae_ARCHIVE_TIMESTAMP}")
+        vcpkg_mark_phase(end extract)
     endif()
     message(STATUS "Extracting done")
 endfunction()
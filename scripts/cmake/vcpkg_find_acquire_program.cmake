@@ -26,6 +26,8 @@
 ## - NINJA
 ## - YASM
 ##
+## A program is searched for and acquired only once: vcpkg passes what earlier builds found to every build, until the version of the program in this script changes.
+##
 ## Note that msys2 has a dedicated helper function: [`vcpkg_acquire_msys`](vcpkg_acquire_msys.md).
 ##
 ## ## Examples
@@ -156,6 +158,12 @@ function(vcpkg_find_acquire_program VAR)
     message(FATAL "unknown tool ${VAR} -- unable to acquire.")
   endif()
 
+  # A program which an earlier build found is reused, as long as it is the version this script asks for
+  if(NOT DEFINED REQUIRED_INTERPRETER AND DEFINED _VCPKG_ACQUIRED_${VAR} AND "${_VCPKG_ACQUIRED_${VAR}_HASH}" STREQUAL "${HASH}")
+    set(${VAR} "${_VCPKG_ACQUIRED_${VAR}}" PARENT_SCOPE)
+    return()
+  endif()
+
   macro(do_find)
     if(NOT DEFINED REQUIRED_INTERPRETER)
       find_program(${VAR} ${PROGNAME} PATHS ${PATHS})
@@ -196,5 +204,11 @@ function(vcpkg_find_acquire_program VAR)
     do_find()
   endif()
 
+  # Scripts run through an interpreter are cheap to find once the interpreter is known
+  if(DEFINED _VCPKG_ACQUIRED_PROGRAMS_FILE AND NOT DEFINED REQUIRED_INTERPRETER AND NOT ${VAR} MATCHES "-NOTFOUND")
+    file(LOCK "${_VCPKG_ACQUIRED_PROGRAMS_FILE}.lock" GUARD FUNCTION)
+    file(APPEND "${_VCPKG_ACQUIRED_PROGRAMS_FILE}" "${VAR}|${HASH}|${${VAR}}\n")
+  endif()
+
   set(${VAR} ${${VAR}} PARENT_SCOPE)
 endfunction()
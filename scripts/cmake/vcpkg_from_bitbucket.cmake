@@ -45,6 +45,8 @@
 ##
 ## This exports the `VCPKG_HEAD_VERSION` variable during head builds.
 ##
+## Head builds check out `HEAD_REF` with [`vcpkg_checkout_head`](vcpkg_checkout_head.md), from a git repository which is shared by all triplets and only fetches what changed since the last head build.
+##
 ## ## Examples:
 ##
 ## * [blaze](https://github.com/Microsoft/vcpkg/blob/master/ports/blaze/portfile.cmake)
@@ -129,62 +131,15 @@ function(vcpkg_from_bitbucket)
     endif()
 
     # The following is for --head scenarios
-    set(URL "https://bitbucket.com/${ORG_NAME}/${REPO_NAME}/get/${_vdud_HEAD_REF}.tar.gz")
-    set(downloaded_file_path "${DOWNLOADS}/${ORG_NAME}-${REPO_NAME}-${_vdud_HEAD_REF}.tar.gz")
-
-    if(_VCPKG_NO_DOWNLOADS)
-        if(NOT EXISTS ${downloaded_file_path} OR NOT EXISTS ${downloaded_file_path}.version)
-            message(FATAL_ERROR "Downloads are disabled, but '${downloaded_file_path}' does not exist.")
-        endif()
-        message(STATUS "Using cached ${downloaded_file_path}")
-    else()
-        if(EXISTS ${downloaded_file_path})
-            message(STATUS "Purging cached ${downloaded_file_path} to fetch latest (use --no-downloads to suppress)")
-            file(REMOVE ${downloaded_file_path})
-        endif()
-        if(EXISTS ${downloaded_file_path}.version)
-            file(REMOVE ${downloaded_file_path}.version)
-        endif()
-        if(EXISTS ${CURRENT_BUILDTREES_DIR}/src/head)
-            file(REMOVE_RECURSE ${CURRENT_BUILDTREES_DIR}/src/head)
-        endif()
-
-        # Try to download the file and version information from bitbucket.
-        message(STATUS "Downloading ${URL}...")
-        file(DOWNLOAD "https://api.bitbucket.com/2.0/repositories/${ORG_NAME}/${REPO_NAME}/refs/branches/${_vdud_HEAD_REF}"
-            ${downloaded_file_path}.version
-            STATUS download_status
-        )
-        list(GET download_status 0 status_code)
-        if (NOT "${status_code}" STREQUAL "0")
-            file(REMOVE ${downloaded_file_path}.version)
-            message(FATAL_ERROR "Downloading version info for ${URL}... Failed. Status: ${download_status}")
-        endif()
-
-        file(DOWNLOAD ${URL} ${downloaded_file_path} STATUS download_status)
-        list(GET download_status 0 status_code)
-        if (NOT "${status_code}" STREQUAL "0")
-            file(REMOVE ${downloaded_file_path})
-            message(FATAL_ERROR "Downloading ${URL}... Failed. Status: ${download_status}")
-        else()
-            message(STATUS "Downloading ${URL}... OK")
-        endif()
-    endif()
-
-    vcpkg_extract_source_archive_ex(
-        ARCHIVE "${downloaded_file_path}"
-        WORKING_DIRECTORY "${CURRENT_BUILDTREES_DIR}/src/head"
+    vcpkg_checkout_head(
+        OUT_SOURCE_PATH SOURCE_PATH
+        OUT_VERSION _version
+        URL "https://bitbucket.org/${ORG_NAME}/${REPO_NAME}.git"
+        REF "${_vdud_HEAD_REF}"
     )
 
-    # Parse the github refs response with regex.
-    # TODO: use some JSON swiss-army-knife utility instead.
-    file(READ "${downloaded_file_path}.version" _contents)
-    string(REGEX MATCH "\"hash\": \"[a-f0-9]+\"" x "${_contents}")
-    string(REGEX REPLACE "\"hash\": \"([a-f0-9]+)\"" "\\1" _version ${x})
-    string(SUBSTRING ${_version} 0 12 _vdud_HEAD_REF) # Get the 12 first numbers from commit hash
-    
     # exports VCPKG_HEAD_VERSION to the caller. This will get picked up by ports.cmake after the build.
     set(VCPKG_HEAD_VERSION ${_version} PARENT_SCOPE)
 
-    set_SOURCE_PATH(${CURRENT_BUILDTREES_DIR}/src/head ${_vdud_HEAD_REF})
+    set(${_vdud_OUT_SOURCE_PATH} "${SOURCE_PATH}" PARENT_SCOPE)
 endfunction()
@@ -1,5 +1,11 @@
 # Returns Windows SDK number via out variable "ret"
 function(vcpkg_get_windows_sdk ret)
+    # vcpkg passes the SDK it found when it launched the build
+    if(DEFINED _VCPKG_WINDOWS_SDK)
+        set(${ret} ${_VCPKG_WINDOWS_SDK} PARENT_SCOPE)
+        return()
+    endif()
+
     execute_process(
         COMMAND powershell.exe -NoProfile -ExecutionPolicy Bypass -Command "& {& '${VCPKG_ROOT_DIR}/scripts/getWindowsSDK.ps1'}" 2>&1
         INPUT_FILE NUL
@@ -14,6 +14,8 @@
 ## ## Notes:
 ## This command should be preceeded by a call to [`vcpkg_configure_cmake()`](vcpkg_configure_cmake.md).
 ##
+## If the triplet sets `VCPKG_PARALLEL_CONFIGURATIONS`, the Release and Debug builds run at the same time, each using half of the cores. If it sets `VCPKG_BUILD_TYPE` to `release`, only the Release build is installed.
+##
 ## ## Examples:
 ##
 ## * [zlib](https://github.com/Microsoft/vcpkg/blob/master/ports/zlib/portfile.cmake)
@@ -35,29 +37,71 @@ function(vcpkg_install_cmake)
         list(APPEND MSVC_EXTRA_ARGS "/p:PreferredToolArchitecture=x64")
     endif()
 
+    vcpkg_get_compiler_cache_msbuild_options(_bc_COMPILER_CACHE_OPTIONS)
+    list(APPEND MSVC_EXTRA_ARGS ${_bc_COMPILER_CACHE_OPTIONS})
+
+    # vcpkg sets VCPKG_CONCURRENCY when it builds several ports at once, so that they share the cores
+    if(VCPKG_CONCURRENCY)
+        set(_bc_JOBS ${VCPKG_CONCURRENCY})
+    else()
+        cmake_host_system_information(RESULT _bc_JOBS QUERY NUMBER_OF_LOGICAL_CORES)
+    endif()
+    # A release-only triplet has a single configuration, which gets all of the processes
+    set(_bc_PARALLEL_CONFIGURATIONS OFF)
+    if(VCPKG_PARALLEL_CONFIGURATIONS AND NOT _bc_DISABLE_PARALLEL AND NOT VCPKG_BUILD_TYPE STREQUAL "release")
+        set(_bc_PARALLEL_CONFIGURATIONS ON)
+    endif()
+    if(_bc_PARALLEL_CONFIGURATIONS)
+        # Both configurations build at once, so each gets half of the processes
+        math(EXPR _bc_JOBS "(${_bc_JOBS} + 1) / 2")
+    endif()
+
     if (NOT _bc_DISABLE_PARALLEL)
-        list(APPEND MSVC_EXTRA_ARGS "/m")
+        list(APPEND MSVC_EXTRA_ARGS "/m:${_bc_JOBS}")
     endif()
-    
+
     if(EXISTS ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel/build.ninja)
-        set(BUILD_ARGS -v) # verbose output
+        set(BUILD_ARGS -v -j${_bc_JOBS}) # verbose output
     else()
         set(BUILD_ARGS ${MSVC_EXTRA_ARGS})
     endif()
 
-    message(STATUS "Package ${TARGET_TRIPLET}-rel")
-    vcpkg_execute_required_process(
-        COMMAND ${CMAKE_COMMAND} --build . --config Release --target install -- ${BUILD_ARGS}
-        WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel
-        LOGNAME package-${TARGET_TRIPLET}-rel
-    )
-    message(STATUS "Package ${TARGET_TRIPLET}-rel done")
+    if(_bc_PARALLEL_CONFIGURATIONS)
+        message(STATUS "Package ${TARGET_TRIPLET}-rel and ${TARGET_TRIPLET}-dbg")
+        vcpkg_mark_phase(begin package-rel)
+        vcpkg_mark_phase(begin package-dbg)
+        vcpkg_execute_required_process_parallel(
+            COMMAND_RELEASE ${CMAKE_COMMAND} --build . --config Release --target install -- ${BUILD_ARGS}
+            WORKING_DIRECTORY_RELEASE ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel
+            LOGNAME_RELEASE package-${TARGET_TRIPLET}-rel
+            COMMAND_DEBUG ${CMAKE_COMMAND} --build . --config Debug --target install -- ${BUILD_ARGS}
+            WORKING_DIRECTORY_DEBUG ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg
+            LOGNAME_DEBUG package-${TARGET_TRIPLET}-dbg
+        )
+        vcpkg_mark_phase(end package-rel)
+        vcpkg_mark_phase(end package-dbg)
+        message(STATUS "Package ${TARGET_TRIPLET}-rel and ${TARGET_TRIPLET}-dbg done")
+    else()
+        message(STATUS "Package ${TARGET_TRIPLET}-rel")
+        vcpkg_mark_phase(begin package-rel)
+        vcpkg_execute_required_process(
+            COMMAND ${CMAKE_COMMAND} --build . --config Release --target install -- ${BUILD_ARGS}
+            WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel
+            LOGNAME package-${TARGET_TRIPLET}-rel
+        )
+        vcpkg_mark_phase(end package-rel)
+        message(STATUS "Package ${TARGET_TRIPLET}-rel done")
 
-    message(STATUS "Package ${TARGET_TRIPLET}-dbg")
-    vcpkg_execute_required_process(
-        COMMAND ${CMAKE_COMMAND} --build . --config Debug --target install -- ${BUILD_ARGS}
-        WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg
-        LOGNAME package-${TARGET_TRIPLET}-dbg
-    )
-    message(STATUS "Package ${TARGET_TRIPLET}-dbg done")
+        if(NOT VCPKG_BUILD_TYPE STREQUAL "release")
+            message(STATUS "Package ${TARGET_TRIPLET}-dbg")
+            vcpkg_mark_phase(begin package-dbg)
+            vcpkg_execute_required_process(
+                COMMAND ${CMAKE_COMMAND} --build . --config Debug --target install -- ${BUILD_ARGS}
+                WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg
+                LOGNAME package-${TARGET_TRIPLET}-dbg
+            )
+            vcpkg_mark_phase(end package-dbg)
+            message(STATUS "Package ${TARGET_TRIPLET}-dbg done")
+        endif()
+    endif()
 endfunction()
@@ -1,6 +1,7 @@
 [CmdletBinding()]
 param(
-    [string]$Dependency
+    [string]$Dependency,
+    [string]$downloadsDir = ""
 )
 
 if ($PSVersionTable.PSEdition -ne "Core") {
@@ -12,7 +13,10 @@ Write-Verbose "Fetching dependency: $Dependency"
 $scriptsDir = split-path -parent $MyInvocation.MyCommand.Definition
 $vcpkgRootDir = & $scriptsDir\findFileRecursivelyUp.ps1 $scriptsDir .vcpkg-root
 
-$downloadsDir = "$vcpkgRootDir\downloads"
+if ($downloadsDir -eq "")
+{
+    $downloadsDir = "$vcpkgRootDir\downloads"
+}
 
 function SelectProgram([Parameter(Mandatory=$true)][string]$Dependency)
 {
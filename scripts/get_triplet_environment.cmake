@@ -1,8 +1,25 @@
-include(${CMAKE_TRIPLET_FILE})
+# Prints the variables of each triplet file in CMAKE_TRIPLET_FILES, after a TRIPLET=<name> line. Each file is
+# included in its own function scope, so that no triplet sees the variables of another.
+function(capture_triplet_environment triplet_file)
+    include(${triplet_file})
+    get_filename_component(triplet_name ${triplet_file} NAME)
+    string(REGEX REPLACE "\\.cmake$" "" triplet_name "${triplet_name}")
+    set(_captured "${_captured}TRIPLET=${triplet_name}\n")
+    set(_captured "${_captured}VCPKG_TARGET_ARCHITECTURE=${VCPKG_TARGET_ARCHITECTURE}\n")
+    set(_captured "${_captured}VCPKG_CMAKE_SYSTEM_NAME=${VCPKG_CMAKE_SYSTEM_NAME}\n")
+    set(_captured "${_captured}VCPKG_CMAKE_SYSTEM_VERSION=${VCPKG_CMAKE_SYSTEM_VERSION}\n")
+    set(_captured "${_captured}VCPKG_PLATFORM_TOOLSET=${VCPKG_PLATFORM_TOOLSET}\n")
+    set(_captured "${_captured}VCPKG_BUILD_TYPE=${VCPKG_BUILD_TYPE}\n")
+    set(_captured "${_captured}" PARENT_SCOPE)
+endfunction()
+
+# Anything the triplet files print comes before the cut
+set(_captured "")
+foreach(triplet_file IN LISTS CMAKE_TRIPLET_FILES)
+    capture_triplet_environment(${triplet_file})
+endforeach()
 
 # GUID used as a flag - "cut here line"
 message("c35112b6-d1ba-415b-aa5d-81de856ef8eb")
-message("VCPKG_TARGET_ARCHITECTURE=${VCPKG_TARGET_ARCHITECTURE}")
-message("VCPKG_CMAKE_SYSTEM_NAME=${VCPKG_CMAKE_SYSTEM_NAME}")
-message("VCPKG_CMAKE_SYSTEM_VERSION=${VCPKG_CMAKE_SYSTEM_VERSION}")
-message("VCPKG_PLATFORM_TOOLSET=${VCPKG_PLATFORM_TOOLSET}")
\ No newline at end of file
+string(REGEX REPLACE "\n$" "" _captured "${_captured}")
+message("${_captured}")
@@ -21,6 +21,11 @@ set(VCPKG_ROOT_DIR ${VCPKG_ROOT_DIR_CANDIDATE})
 
 list(APPEND CMAKE_MODULE_PATH ${VCPKG_ROOT_DIR}/scripts/cmake)
 set(CURRENT_INSTALLED_DIR ${VCPKG_ROOT_DIR}/installed/${TARGET_TRIPLET} CACHE PATH "Location to install final packages")
+if(NOT DEFINED VCPKG_HOST_TRIPLET)
+    set(VCPKG_HOST_TRIPLET ${TARGET_TRIPLET})
+endif()
+set(CURRENT_HOST_INSTALLED_DIR ${VCPKG_ROOT_DIR}/installed/${VCPKG_HOST_TRIPLET} CACHE PATH "Location of the ports whose tools the build runs")
+# vcpkg passes the locations it was configured with, which may be outside of the root; these are the defaults
 set(DOWNLOADS ${VCPKG_ROOT_DIR}/downloads CACHE PATH "Location to download sources and tools")
 set(PACKAGES_DIR ${VCPKG_ROOT_DIR}/packages CACHE PATH "Location to store package images")
 set(BUILDTREES_DIR ${VCPKG_ROOT_DIR}/buildtrees CACHE PATH "Location to perform actual extract+config+build")
@@ -30,6 +35,13 @@ if(PORT)
     set(CURRENT_PACKAGES_DIR ${PACKAGES_DIR}/${PORT}_${TARGET_TRIPLET})
 endif()
 
+# Records the start or end of a build phase when vcpkg collects timings
+function(vcpkg_mark_phase EVENT PHASE)
+    if(DEFINED VCPKG_PHASE_MARKERS_FILE)
+        string(TIMESTAMP _vmp_NOW "%s" UTC)
+        file(APPEND ${VCPKG_PHASE_MARKERS_FILE} "${_vmp_NOW} ${EVENT} ${PHASE}\n")
+    endif()
+endfunction()
 
 if(CMD MATCHES "^BUILD$")
     set(CMAKE_TRIPLET_FILE ${VCPKG_ROOT_DIR}/triplets/${TARGET_TRIPLET}.cmake)
@@ -52,6 +64,7 @@ if(CMD MATCHES "^BUILD$")
     endif()
 
     message(STATUS "CURRENT_INSTALLED_DIR=${CURRENT_INSTALLED_DIR}")
+    message(STATUS "CURRENT_HOST_INSTALLED_DIR=${CURRENT_HOST_INSTALLED_DIR}")
     message(STATUS "DOWNLOADS=${DOWNLOADS}")
 
     message(STATUS "CURRENT_PACKAGES_DIR=${CURRENT_PACKAGES_DIR}")
@@ -69,7 +82,14 @@ if(CMD MATCHES "^BUILD$")
 
     include(${CMAKE_TRIPLET_FILE})
     set(TRIPLET_SYSTEM_ARCH ${VCPKG_TARGET_ARCHITECTURE})
+    include(vcpkg_compiler_cache)
+    vcpkg_start_compiler_cache()
+    # vcpkg passes the helpers of vcpkg_common_functions in a single file, which loads faster than the modules do
+    if(DEFINED VCPKG_HELPERS_BUNDLE AND EXISTS ${VCPKG_HELPERS_BUNDLE})
+        include(${VCPKG_HELPERS_BUNDLE})
+    endif()
     include(${CURRENT_PORT_DIR}/portfile.cmake)
+    vcpkg_report_compiler_cache()
 
     set(BUILD_INFO_FILE_PATH ${CURRENT_PACKAGES_DIR}/BUILD_INFO)
     file(WRITE  ${BUILD_INFO_FILE_PATH} "CRTLinkage: ${VCPKG_CRT_LINKAGE}\n")
@@ -93,6 +113,16 @@ if(CMD MATCHES "^BUILD$")
     if (DEFINED VCPKG_HEAD_VERSION)
         file(APPEND ${BUILD_INFO_FILE_PATH} "Version: ${VCPKG_HEAD_VERSION}\n")
     endif()
+elseif(CMD MATCHES "^DOWNLOAD$")
+    include(vcpkg_download_distfile)
+    vcpkg_download_distfile(ARCHIVE
+        URLS ${URLS}
+        FILENAME ${FILENAME}
+        SHA512 ${SHA512}
+    )
+elseif(CMD MATCHES "^ACQUIRE_MSYS$")
+    include(vcpkg_acquire_msys)
+    vcpkg_acquire_msys(MSYS_ROOT PACKAGES ${MSYS_PACKAGES})
 elseif(CMD MATCHES "^CREATE$")
     file(TO_NATIVE_PATH ${VCPKG_ROOT_DIR} NATIVE_VCPKG_ROOT_DIR)
     file(TO_NATIVE_PATH ${DOWNLOADS} NATIVE_DOWNLOADS)
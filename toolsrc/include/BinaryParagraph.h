@@ -13,6 +13,7 @@ namespace vcpkg
     {
         BinaryParagraph();
         explicit BinaryParagraph(std::unordered_map<std::string, std::string> fields);
+        explicit BinaryParagraph(const Parse::ParagraphView& fields);
         BinaryParagraph(const SourceParagraph& spgh, const Triplet& triplet);
         BinaryParagraph(const SourceParagraph& spgh, const FeatureParagraph& fpgh, const Triplet& triplet);
 
@@ -29,6 +30,7 @@ namespace vcpkg
         std::string feature;
         std::vector<std::string> default_features;
         std::vector<std::string> depends;
+        std::string abi;
     };
 
     struct BinaryControlFile
@@ -37,5 +39,14 @@ namespace vcpkg
         std::vector<BinaryParagraph> features;
     };
 
+    /// <summary>
+    /// The exact size of the text serialize() appends, so that a caller can allocate all of it at once
+    /// </summary>
+    size_t serialized_size(const BinaryParagraph& pgh);
     void serialize(const BinaryParagraph& pgh, std::string& out_str);
+
+    /// <summary>
+    /// The paragraphs of a CONTROL file, separated by blank lines
+    /// </summary>
+    void serialize(const BinaryControlFile& bcf, std::string& out_str);
 }
\ No newline at end of file
@@ -15,8 +15,16 @@ namespace vcpkg
         static ExpectedT<ParsedSpecifier, PackageSpecParseResult> from_string(const std::string& input);
     };
 
+    struct PackageNameInstance;
+
+    /// <summary>
+    /// Package names are interned like triplets, so a PackageSpec is a pair of pointers that compares and hashes in
+    /// constant time
+    /// </summary>
     struct PackageSpec
     {
+        constexpr PackageSpec() : m_name(&DEFAULT_NAME_INSTANCE) {}
+
         static ExpectedT<PackageSpec, PackageSpecParseResult> from_name_and_triplet(const std::string& name,
                                                                                     const Triplet& triplet);
 
@@ -28,8 +36,12 @@ namespace vcpkg
 
         std::string to_string() const;
 
+        size_t hash_code() const;
+
     private:
-        std::string m_name;
+        static const PackageNameInstance DEFAULT_NAME_INSTANCE;
+
+        const PackageNameInstance* m_name;
         Triplet m_triplet;
     };
 
@@ -79,13 +91,7 @@ namespace vcpkg
 template<>
 struct std::hash<vcpkg::PackageSpec>
 {
-    size_t operator()(const vcpkg::PackageSpec& value) const
-    {
-        size_t hash = 17;
-        hash = hash * 31 + std::hash<std::string>()(value.name());
-        hash = hash * 31 + std::hash<vcpkg::Triplet>()(value.triplet());
-        return hash;
-    }
+    size_t operator()(const vcpkg::PackageSpec& value) const { return value.hash_code(); }
 };
 
 template<>
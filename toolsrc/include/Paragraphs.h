@@ -1,13 +1,16 @@
 #pragma once
 
 #include <map>
+#include <memory>
 
 #include "BinaryParagraph.h"
+#include "Span.h"
 #include "VcpkgPaths.h"
 #include "VersionT.h"
 #include "filesystem_fs.h"
 #include "vcpkg_Parse.h"
 #include "vcpkg_expected.h"
+#include "vcpkg_optional.h"
 
 namespace vcpkg::Paragraphs
 {
@@ -18,6 +21,21 @@ namespace vcpkg::Paragraphs
     Expected<RawParagraph> parse_single_paragraph(const std::string& str);
     Expected<std::vector<RawParagraph>> parse_paragraphs(const std::string& str);
 
+    /// <summary>
+    /// Paragraphs parsed without copying their fields. Every view points into `buffer`, which is shared so that the
+    /// views remain valid for as long as this object (or a copy of it) is alive.
+    /// </summary>
+    struct ParagraphViews
+    {
+        std::shared_ptr<const char> buffer;
+        std::vector<Parse::ParagraphView> paragraphs;
+    };
+
+    ParagraphViews parse_paragraph_views(std::string&& str);
+    ParagraphViews parse_paragraph_views(const Files::MappedFile& file);
+    Expected<ParagraphViews> get_paragraph_views(const Files::Filesystem& fs, const fs::path& control_path);
+
+    Parse::ParseExpected<SourceControlFile> parse_port(const ParagraphViews& pghs);
     Parse::ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& control_path);
 
     Expected<BinaryControlFile> try_load_cached_control_package(const VcpkgPaths& paths, const PackageSpec& spec);
@@ -35,4 +53,23 @@ namespace vcpkg::Paragraphs
 
     std::map<std::string, VersionT> load_all_port_names_and_versions(const Files::Filesystem& fs,
                                                                      const fs::path& ports_dir);
+
+    /// <summary>
+    /// Loads all ports from paths.ports. The raw CONTROL paragraphs are cached in an index in paths.vcpkg_dir, keyed
+    /// by the size and modification time of each CONTROL file, so only added or changed ports are read and parsed.
+    /// </summary>
+    LoadResults try_load_all_ports(const VcpkgPaths& paths);
+
+    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Loads the name and version of all ports from paths.ports. Instead of parsing each CONTROL file completely,
+    /// this takes the Source and Version fields from the port index, or reads the first paragraph of the file.
+    /// </summary>
+    std::map<std::string, VersionT> load_all_port_names_and_versions(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Finds the Source and Version fields in the first paragraph of a CONTROL file without parsing the rest
+    /// </summary>
+    Optional<std::pair<std::string, VersionT>> scan_port_name_and_version(span<const char> control_file);
 }
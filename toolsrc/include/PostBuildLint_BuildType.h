@@ -6,11 +6,7 @@
 
 namespace vcpkg::PostBuildLint
 {
-    enum class ConfigurationType
-    {
-        DEBUG,
-        RELEASE,
-    };
+    using Build::ConfigurationType;
 
     struct BuildType
     {
@@ -0,0 +1,59 @@
+#pragma once
+#include "coff_file_reader.h"
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_optional.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::PostBuildLint
+{
+    /// <summary>
+    /// What was read from a binary of the package, and which file it was read from
+    /// </summary>
+    struct InspectedBinary
+    {
+        fs::path path;
+        uintmax_t size = 0;
+        std::string last_write_time;
+        std::string sha1;
+        Optional<CoffFileReader::DllInfo> dll;
+        Optional<CoffFileReader::LibInfo> lib;
+    };
+
+    /// <summary>
+    /// The binaries which the last lint of a port read, so that the next lint only reads the new and the changed
+    /// ones. The checks only see what was read from each binary, so running them again on what the cache holds gives
+    /// the same diagnostics as reading the binaries again, whatever the policies and the triplet.
+    /// </summary>
+    class InspectionCache
+    {
+    public:
+        static InspectionCache load(const Files::Filesystem& fs, const fs::path& cache_file);
+
+        /// <summary>
+        /// An empty cache if the text is not one
+        /// </summary>
+        static InspectionCache parse(const std::string& text);
+
+        /// <summary>
+        /// The binaries read through this cache, which are all that the next lint can use
+        /// </summary>
+        std::string serialize() const;
+
+        void save(Files::Filesystem& fs, const fs::path& cache_file) const;
+
+        /// <summary>
+        /// Reads the DLLs concurrently, in the order of the paths. A DLL with the size and the time of the last write
+        /// of the last lint, or with the same contents as a DLL of it, is not read.
+        /// </summary>
+        std::vector<CoffFileReader::DllInfo> read_dlls(const Files::Filesystem& fs, const std::vector<fs::path>& paths);
+
+        std::vector<CoffFileReader::LibInfo> read_libs(const Files::Filesystem& fs, const std::vector<fs::path>& paths);
+
+    private:
+        std::vector<InspectedBinary> m_loaded;
+        std::vector<InspectedBinary> m_inspected;
+    };
+}
@@ -1,11 +1,63 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
+#include <iterator>
 #include <vector>
 
 // Add more forwarding functions to the m_data std::vector as needed.
 namespace vcpkg
 {
+    /// <summary>
+    /// The first position in [first, last) whose element is not less than value, found by doubling the step from
+    /// first. Costs O(log d) for a result at distance d, so walking a large range with it for each of k sorted values
+    /// costs O(k log(n/k)) rather than the O(k log n) of std::lower_bound.
+    /// </summary>
+    template<class RandomIt, class U, class Compare>
+    RandomIt gallop_lower_bound(RandomIt first, const RandomIt last, const U& value, Compare comp)
+    {
+        using Distance = typename std::iterator_traits<RandomIt>::difference_type;
+        Distance step = 1;
+        while (step < last - first && comp(first[step - 1], value))
+        {
+            first += step;
+            step *= 2;
+        }
+        return std::lower_bound(first, first + std::min(step, last - first), value, comp);
+    }
+
+    /// <summary>
+    /// Merges runs which are each sorted by comp, by merging pairs of runs until one is left: O(n log k) for n
+    /// elements in k runs, instead of sorting their concatenation
+    /// </summary>
+    template<class T, class Compare>
+    std::vector<T> merge_sorted_runs(std::vector<std::vector<T>> runs, Compare comp)
+    {
+        if (runs.empty()) return {};
+
+        while (runs.size() > 1)
+        {
+            std::vector<std::vector<T>> merged;
+            merged.reserve((runs.size() + 1) / 2);
+            for (size_t i = 0; i + 1 < runs.size(); i += 2)
+            {
+                std::vector<T> both;
+                both.reserve(runs[i].size() + runs[i + 1].size());
+                std::merge(std::make_move_iterator(runs[i].begin()),
+                           std::make_move_iterator(runs[i].end()),
+                           std::make_move_iterator(runs[i + 1].begin()),
+                           std::make_move_iterator(runs[i + 1].end()),
+                           std::back_inserter(both),
+                           comp);
+                merged.push_back(std::move(both));
+            }
+            if (runs.size() % 2 != 0) merged.push_back(std::move(runs.back()));
+            runs = std::move(merged);
+        }
+
+        return std::move(runs.front());
+    }
+
     template<class T>
     class SortedVector
     {
@@ -32,6 +84,36 @@ namespace vcpkg
             }
         }
 
+        static SortedVector merge(std::vector<SortedVector> runs)
+        {
+            std::vector<std::vector<T>> data;
+            data.reserve(runs.size());
+            for (auto&& run : runs)
+            {
+                data.push_back(std::move(run.m_data));
+            }
+
+            SortedVector merged;
+            merged.m_data = merge_sorted_runs(std::move(data), std::less<>());
+            return merged;
+        }
+
+        /// <summary>
+        /// Looks up anything which compares with T, such as a std::string_view in a SortedVector of std::string
+        /// </summary>
+        template<class U>
+        iterator find(const U& value) const
+        {
+            const auto it = std::lower_bound(m_data.cbegin(), m_data.cend(), value, std::less<>());
+            return it != m_data.cend() && !std::less<>()(value, *it) ? it : m_data.cend();
+        }
+
+        template<class U>
+        bool contains(const U& value) const
+        {
+            return find(value) != m_data.cend();
+        }
+
         iterator begin() const { return this->m_data.cbegin(); }
 
         iterator end() const { return this->m_data.cend(); }
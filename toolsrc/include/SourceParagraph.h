@@ -7,6 +7,7 @@
 #include "vcpkg_expected.h"
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace vcpkg
@@ -17,10 +18,25 @@ namespace vcpkg
         std::string qualifier;
 
         std::string name() const;
+
+        /// <summary>Whether the qualifier, if any, selects the triplet. Never true for a host dependency.</summary>
+        bool applies_to(const Triplet& t) const;
+
+        /// <summary>
+        /// Whether the qualifier is "host": a port whose tools the build runs, which is built for Triplet::host()
+        /// whatever the triplet of the dependent is. It is not a dependency of the installed package.
+        /// </summary>
+        bool is_host() const;
+
         static Dependency parse_dependency(std::string name, std::string qualifier);
     };
 
     std::vector<std::string> filter_dependencies(const std::vector<Dependency>& deps, const Triplet& t);
+    std::vector<PackageSpec> filter_host_dependencies(const std::vector<Dependency>& deps);
+
+    /// <summary>
+    /// The dependencies which apply to the triplet, and the host dependencies for the host triplet
+    /// </summary>
     std::vector<FeatureSpec> filter_dependencies_to_specs(const std::vector<Dependency>& deps, const Triplet& t);
 
     // zlib[uwp] becomes Dependency{"zlib", "uwp"}
@@ -33,6 +49,12 @@ namespace vcpkg
         std::string name;
         std::string description;
         std::vector<Dependency> depends;
+
+        /// <summary>
+        /// Whether adding the feature to an installed package changes what the packages which depend on it were built
+        /// against, so that they have to be rebuilt along with it
+        /// </summary>
+        bool changes_abi = false;
     };
 
     /// <summary>
@@ -47,14 +69,41 @@ namespace vcpkg
         std::vector<std::string> supports;
         std::vector<Dependency> depends;
         std::vector<std::string> default_features;
+
+        /// <summary>
+        /// The peak memory in MiB which a build of the port is expected to take, or 0 when it is not given
+        /// </summary>
+        size_t build_memory_mib = 0;
+    };
+    /// <summary>
+    /// The dependencies of a port for one triplet, with the qualifiers already applied
+    /// </summary>
+    struct ResolvedDependencies
+    {
+        std::vector<FeatureSpec> core;
+
+        /// <summary>By feature name</summary>
+        std::unordered_map<std::string, std::vector<FeatureSpec>> features;
     };
+
     struct SourceControlFile
     {
         static Parse::ParseExpected<SourceControlFile> parse_control_file(
             std::vector<Parse::RawParagraph>&& control_paragraphs);
+        static Parse::ParseExpected<SourceControlFile> parse_control_file(
+            const std::vector<Parse::ParagraphView>& control_paragraphs);
+
+        /// <summary>
+        /// Resolved on the first call for each triplet and kept for the life of the file, which must not have its
+        /// paragraphs changed afterwards. Not synchronized, as the planners which use it run on one thread.
+        /// </summary>
+        const ResolvedDependencies& resolve_dependencies(const Triplet& triplet) const;
 
         std::unique_ptr<SourceParagraph> core_paragraph;
         std::vector<std::unique_ptr<FeatureParagraph>> feature_paragraphs;
+
+    private:
+        mutable std::unordered_map<Triplet, ResolvedDependencies> m_resolved_dependencies;
     };
 
     void print_error_message(span<const std::unique_ptr<Parse::ParseControlErrorInfo>> error_info_list);
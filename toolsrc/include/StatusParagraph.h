@@ -2,6 +2,7 @@
 
 #include "BinaryParagraph.h"
 #include <unordered_map>
+#include <utility>
 
 namespace vcpkg
 {
@@ -30,14 +31,21 @@ namespace vcpkg
     {
         StatusParagraph();
         explicit StatusParagraph(std::unordered_map<std::string, std::string>&& fields);
+        explicit StatusParagraph(const Parse::ParagraphView& fields);
 
         BinaryParagraph package;
         Want want;
         InstallState state;
     };
 
+    size_t serialized_size(const StatusParagraph& pgh);
     void serialize(const StatusParagraph& pgh, std::string& out_str);
 
+    /// <summary>
+    /// Parses the value of a "Status" field, "&lt;want&gt; ok &lt;state&gt;"
+    /// </summary>
+    std::pair<Want, InstallState> parse_status_field(const std::string& status_field);
+
     std::string to_string(InstallState f);
 
     std::string to_string(Want f);
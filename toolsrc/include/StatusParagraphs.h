@@ -1,23 +1,79 @@
 #pragma once
+#include "Paragraphs.h"
 #include "StatusParagraph.h"
+#include "vcpkg_optional.h"
 #include <iterator>
 #include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace vcpkg
 {
     struct StatusParagraphs
     {
         StatusParagraphs();
+
+        /// <summary>
+        /// Indexes the paragraphs by their package, feature and status only. Each paragraph is parsed the first time
+        /// an iterator to it is dereferenced, so a command which looks up a few packages parses only those.
+        /// </summary>
+        explicit StatusParagraphs(Paragraphs::ParagraphViews&& views);
+
+        /// <summary>
+        /// Takes the storage of the paragraphs along with them, so the paragraphs stay one block of memory
+        /// </summary>
+        explicit StatusParagraphs(std::vector<StatusParagraph>&& ps);
         explicit StatusParagraphs(std::vector<std::unique_ptr<StatusParagraph>>&& ps);
 
-        using container = std::vector<std::unique_ptr<StatusParagraph>>;
-        using iterator = container::reverse_iterator;
-        using const_iterator = container::const_reverse_iterator;
+        StatusParagraphs(const StatusParagraphs&) = delete;
+        StatusParagraphs(StatusParagraphs&&) = default;
+        StatusParagraphs& operator=(const StatusParagraphs&) = delete;
+        StatusParagraphs& operator=(StatusParagraphs&&) = default;
+
+        /// <summary>
+        /// Visits the paragraphs from the last one, which takes precedence, to the first
+        /// </summary>
+        struct iterator
+        {
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = StatusParagraph*;
+            using difference_type = std::ptrdiff_t;
+            using pointer = StatusParagraph* const*;
+            using reference = StatusParagraph*;
+
+            iterator() = default;
+            iterator(const StatusParagraphs* db, const size_t remaining) : m_db(db), m_remaining(remaining) {}
+
+            StatusParagraph* operator*() const { return m_db->at(m_remaining - 1); }
+
+            iterator& operator++()
+            {
+                --m_remaining;
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator it = *this;
+                --m_remaining;
+                return it;
+            }
+
+            bool operator==(const iterator& other) const { return m_remaining == other.m_remaining; }
+            bool operator!=(const iterator& other) const { return m_remaining != other.m_remaining; }
+
+        private:
+            const StatusParagraphs* m_db = nullptr;
+            size_t m_remaining = 0;
+        };
+
+        using const_iterator = iterator;
 
         const_iterator find(const PackageSpec& spec) const { return find(spec.name(), spec.triplet()); }
         const_iterator find(const std::string& name, const Triplet& triplet) const;
         iterator find(const std::string& name, const Triplet& triplet);
-        std::vector<std::unique_ptr<StatusParagraph>*> find_all(const std::string& name, const Triplet& triplet);
+        std::vector<StatusParagraph*> find_all(const std::string& name, const Triplet& triplet);
         iterator find(const std::string& name, const Triplet& triplet, const std::string& feature);
 
         const_iterator find_installed(const PackageSpec& spec) const
@@ -26,20 +82,57 @@ namespace vcpkg
         }
         const_iterator find_installed(const std::string& name, const Triplet& triplet) const;
 
-        iterator insert(std::unique_ptr<StatusParagraph>);
+        iterator insert(StatusParagraph pgh);
+        iterator insert(std::unique_ptr<StatusParagraph> pgh);
 
         friend void serialize(const StatusParagraphs& pgh, std::string& out_str);
 
-        iterator end() { return paragraphs.rend(); }
+        iterator end() { return iterator(this, 0); }
 
-        const_iterator end() const { return paragraphs.rend(); }
+        const_iterator end() const { return iterator(this, 0); }
 
-        iterator begin() { return paragraphs.rbegin(); }
+        iterator begin() { return iterator(this, paragraphs.size()); }
 
-        const_iterator begin() const { return paragraphs.rbegin(); }
+        const_iterator begin() const { return iterator(this, paragraphs.size()); }
 
     private:
-        std::vector<std::unique_ptr<StatusParagraph>> paragraphs;
+        using IndexEntries = std::vector<size_t>;
+
+        /// <summary>
+        /// What lookups need of a paragraph which was not parsed yet
+        /// </summary>
+        struct PendingParagraph
+        {
+            Parse::ParagraphView view;
+            std::string_view feature;
+            Want want;
+            InstallState state;
+        };
+
+        const IndexEntries* find_index_entries(const std::string& name, const Triplet& triplet) const;
+        Optional<size_t> find_position(const std::string& name,
+                                       const Triplet& triplet,
+                                       const std::string& feature) const;
+        void add_to_index(const size_t position, const PackageSpec& spec);
+        bool is_installed(const size_t position) const;
+
+        StatusParagraph* at(const size_t position) const;
+        StatusParagraph* allocate(StatusParagraph&& pgh) const;
+
+        iterator to_iterator(const size_t position) const { return iterator(this, position + 1); }
+
+        // Blocks which are never grown past their capacity, so the paragraphs in them never move. `paragraphs`
+        // points into these in the order the paragraphs were inserted, or is null where one is still pending.
+        mutable std::vector<std::vector<StatusParagraph>> storage;
+        mutable std::vector<StatusParagraph*> paragraphs;
+
+        // For the positions of the loaded paragraphs, which point into `pending_buffer`
+        std::vector<PendingParagraph> pending;
+        std::shared_ptr<const char> pending_buffer;
+
+        // Positions in `paragraphs` of every paragraph for a given triplet and name, in ascending order. Lookups
+        // search these from the back, which preserves the "last writer wins" semantics of iterating in reverse.
+        std::unordered_map<Triplet, std::unordered_map<std::string, IndexEntries>> index;
     };
 
     void serialize(const StatusParagraphs& pgh, std::string& out_str);
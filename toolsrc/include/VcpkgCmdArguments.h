@@ -19,11 +19,27 @@ namespace vcpkg
         static VcpkgCmdArguments create_from_command_line(const int argc, const wchar_t* const* const argv);
         static VcpkgCmdArguments create_from_arg_sequence(const std::string* arg_begin, const std::string* arg_end);
 
+        /// <summary>
+        /// Splits the contents of a response file, or what was read from stdin, into arguments. They are separated by
+        /// whitespace, and a line starting with '#' is a comment.
+        /// </summary>
+        static std::vector<std::string> split_argument_list(const std::string& text);
+
         std::unique_ptr<std::string> vcpkg_root_dir;
+        std::unique_ptr<std::string> buildtrees_root_dir;
+        std::unique_ptr<std::string> packages_root_dir;
+        std::unique_ptr<std::string> downloads_root_dir;
         std::unique_ptr<std::string> triplet;
+        std::unique_ptr<std::string> timings_trace_file;
+        std::unique_ptr<std::string> background_affinity;
+        std::unique_ptr<std::string> background_free_cores;
         Optional<bool> debug = nullopt;
         Optional<bool> sendmetrics = nullopt;
         Optional<bool> printmetrics = nullopt;
+        Optional<bool> timings = nullopt;
+        Optional<bool> trace_processes = nullopt;
+        Optional<bool> memstats = nullopt;
+        Optional<bool> background = nullopt;
 
         std::string command;
         std::vector<std::string> command_arguments;
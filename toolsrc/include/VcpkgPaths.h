@@ -24,18 +24,61 @@ namespace vcpkg
         std::vector<ToolsetArchOption> supported_architectures;
     };
 
+    /// <summary>
+    /// What the machine has to build with, found once and kept in installed/vcpkg/toolsets
+    /// </summary>
+    struct ToolsetDiscovery
+    {
+        std::vector<Toolset> toolsets;
+
+        /// <summary>Empty when no Windows SDK was found, in which case the port scripts look for one</summary>
+        std::string windows_sdk_version;
+    };
+
+    /// <summary>
+    /// What VcpkgPaths finds on first use and can be asked to find ahead of time
+    /// </summary>
+    enum class LazyTool
+    {
+        CMAKE,
+        GIT,
+        NUGET,
+        TOOLSETS
+    };
+
     struct VcpkgPaths
     {
         static Expected<VcpkgPaths> create(const fs::path& vcpkg_root_dir);
 
+        /// <summary>
+        /// Paths for a root inside another filesystem, such as a generated one held in memory. The filesystem must
+        /// outlive the paths, and the root is used as given rather than resolved against the disk.
+        /// </summary>
+        static Expected<VcpkgPaths> create(const fs::path& vcpkg_root_dir, Files::Filesystem& filesystem);
+
         fs::path package_dir(const PackageSpec& spec) const;
         fs::path port_dir(const PackageSpec& spec) const;
         fs::path port_dir(const std::string& name) const;
         fs::path build_info_file_path(const PackageSpec& spec) const;
         fs::path listfile_path(const BinaryParagraph& pgh) const;
+        fs::path file_owners_path(const Triplet& triplet) const;
+        fs::path pre_build_info_path(const Triplet& triplet) const;
+
+        /// <summary>
+        /// What vcpkg.cmake would otherwise find out on every configure, written whenever the triplet's packages change
+        /// </summary>
+        fs::path toolchain_snapshot_path(const Triplet& triplet) const;
+
+        /// <summary>
+        /// The libraries the MSBuild integration links for a package: its own and those of its dependencies
+        /// </summary>
+        fs::path link_manifest_path(const PackageSpec& spec, const bool debug) const;
 
         bool is_valid_triplet(const Triplet& t) const;
 
+        /// <summary>The names of the triplet files, listed once per session</summary>
+        const std::vector<std::string>& get_available_triplets() const;
+
         fs::path root;
         fs::path packages;
         fs::path buildtrees;
@@ -52,6 +95,7 @@ namespace vcpkg
         fs::path vcpkg_dir_status_file;
         fs::path vcpkg_dir_info;
         fs::path vcpkg_dir_updates;
+        fs::path vcpkg_dir_status_journal;
 
         fs::path ports_cmake;
 
@@ -65,13 +109,32 @@ namespace vcpkg
         /// </remarks>
         const Toolset& get_toolset(const std::string& toolset_version) const;
 
+        /// <summary>The Windows SDK which the port scripts would select, or the empty string</summary>
+        const std::string& get_windows_sdk_version() const;
+
+        /// <summary>
+        /// Finds the tools ahead of their first use, typically on a thread of its own while the caller plans what to
+        /// build. A tool which is not on the machine is not downloaded: the first call which needs it does that, so a
+        /// command which turns out not to need it downloads nothing. Returns whether every tool was found.
+        /// </summary>
+        bool warm_up(const std::vector<LazyTool>& tools) const;
+
+        /// <summary>
+        /// The helpers of vcpkg_common_functions.cmake in a single file under scripts/bundles, written on first use.
+        /// Empty if it could not be written, in which case ports.cmake includes the helpers one at a time.
+        /// </summary>
+        const fs::path& get_helpers_bundle() const;
+
         Files::Filesystem& get_filesystem() const;
 
     private:
+        Files::Filesystem* filesystem = nullptr;
+        Lazy<std::vector<std::string>> available_triplets;
         Lazy<fs::path> cmake_exe;
         Lazy<fs::path> git_exe;
         Lazy<fs::path> nuget_exe;
-        Lazy<std::vector<Toolset>> toolsets;
+        Lazy<ToolsetDiscovery> toolset_discovery;
         Lazy<std::vector<Toolset>> toolsets_vs2017_v140;
+        Lazy<fs::path> helpers_bundle;
     };
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "MachineType.h"
 #include "filesystem_fs.h"
+#include <string>
 #include <vector>
 
 namespace vcpkg::CoffFileReader
@@ -8,11 +9,36 @@ namespace vcpkg::CoffFileReader
     struct DllInfo
     {
         MachineType machine_type;
+
+        /// <summary>
+        /// True if the export table lists at least one function
+        /// </summary>
+        bool has_exports;
+
+        /// <summary>
+        /// True if IMAGE_DLLCHARACTERISTICS_APPCONTAINER is set in the optional header
+        /// </summary>
+        bool is_app_container;
+
+        /// <summary>
+        /// Names of the DLLs in the import and delay-load import tables, in file order
+        /// </summary>
+        std::vector<std::string> dependents;
+
+        /// <summary>
+        /// The PDB path from the CodeView entry of the debug directory, as the linker wrote it; empty if there is none
+        /// </summary>
+        std::string pdb_path;
     };
 
     struct LibInfo
     {
         std::vector<MachineType> machine_types;
+
+        /// <summary>
+        /// Linker directives from the .drectve sections of the object members, split like dumpbin /directives
+        /// </summary>
+        std::vector<std::string> linker_directives;
     };
 
     DllInfo read_dll(const fs::path& path);
@@ -9,6 +9,7 @@ namespace fs
     using stdfs::path;
     using stdfs::copy_options;
     using stdfs::file_status;
+    using stdfs::file_time_type;
 
     inline bool is_regular_file(file_status s) { return stdfs::is_regular_file(s); }
     inline bool is_directory(file_status s) { return stdfs::is_directory(s); }
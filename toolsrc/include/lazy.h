@@ -1,26 +1,75 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 namespace vcpkg
 {
+    /// <summary>
+    /// A value computed on first use. Any number of threads may ask for it at once: the first computes it while the
+    /// others wait, and once it is there, asking costs a single load.
+    /// </summary>
     template<typename T>
     class Lazy
     {
     public:
         Lazy() : value(T()), initialized(false) {}
 
+        /// <summary>
+        /// Copies the value if it was computed. The other must not be computing it meanwhile.
+        /// </summary>
+        Lazy(const Lazy& other) : value(other.value), initialized(other.initialized.load(std::memory_order_acquire))
+        {
+        }
+
+        Lazy& operator=(const Lazy& other)
+        {
+            value = other.value;
+            initialized.store(other.initialized.load(std::memory_order_acquire), std::memory_order_release);
+            return *this;
+        }
+
         template<class F>
         T const& get_lazy(const F& f) const
         {
-            if (!initialized)
+            // The value never changes once the flag is set, so readers need no lock
+            if (!initialized.load(std::memory_order_acquire))
             {
-                value = f();
-                initialized = true;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!initialized.load(std::memory_order_relaxed))
+                {
+                    value = f();
+                    initialized.store(true, std::memory_order_release);
+                }
             }
             return value;
         }
 
+        /// <summary>
+        /// Computes the value as get_lazy() does, except that when f() returns nullopt nothing is kept and the next
+        /// call computes it again. Returns whether the value is there.
+        /// </summary>
+        template<class F>
+        bool try_get_lazy(const F& f) const
+        {
+            if (!initialized.load(std::memory_order_acquire))
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!initialized.load(std::memory_order_relaxed))
+                {
+                    auto maybe_value = f();
+                    const auto v = maybe_value.get();
+                    if (!v) return false;
+                    value = std::move(*v);
+                    initialized.store(true, std::memory_order_release);
+                }
+            }
+            return true;
+        }
+
     private:
         mutable T value;
-        mutable bool initialized;
+        mutable std::atomic<bool> initialized;
+        mutable std::mutex mutex;
     };
 }
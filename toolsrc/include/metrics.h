@@ -2,6 +2,7 @@
 
 #include <string>
 
+#include "filesystem_fs.h"
 #include "vcpkg_Util.h"
 
 namespace vcpkg::Metrics
@@ -14,15 +15,34 @@ namespace vcpkg::Metrics
         void init_user_information(std::string& user_id, std::string& first_use_time);
 
         void track_metric(const std::string& name, double value);
+
+        /// <summary>
+        /// Adds to a measurement which accumulates over the whole invocation, like the number of files installed
+        /// </summary>
+        void track_counter(const std::string& name, double increment);
         void track_property(const std::string& name, const std::string& value);
         void track_property(const std::string& name, const std::wstring& value);
 
-        void upload(const std::string& payload);
+        /// <summary>
+        /// Sends the payload and returns whether the server accepted it
+        /// </summary>
+        bool upload(const std::string& payload);
+
+        /// <summary>
+        /// Appends the metrics of this invocation to the file named by VCPKG_METRICS_FILE, if it is set. Then spools
+        /// them and starts the uploader in the background if it is not running.
+        /// </summary>
         void flush();
     };
 
     extern Util::LockGuarded<Metrics> g_metrics;
 
+    /// <summary>
+    /// Uploads the payloads spooled in the directory in batches until none are left, or until the server cannot be
+    /// reached. Returns immediately if another uploader is running.
+    /// </summary>
+    void upload_spooled_metrics(const fs::path& spool_dir);
+
     std::wstring get_SQM_user();
     bool get_compiled_metrics_enabled();
 }
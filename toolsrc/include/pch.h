@@ -31,6 +31,7 @@
 #include <shlobj.h>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <sys/timeb.h>
 #include <system_error>
 #include <time.h>
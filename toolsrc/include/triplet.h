@@ -19,6 +19,11 @@ namespace vcpkg
         static const Triplet X64_UWP;
         static const Triplet ARM_UWP;
 
+        /// <summary>
+        /// The triplet whose build tools the other triplets run: VCPKG_DEFAULT_HOST_TRIPLET, or x86-windows
+        /// </summary>
+        static Triplet host();
+
         const std::string& canonical_name() const;
         const std::string& to_string() const;
         size_t hash_code() const;
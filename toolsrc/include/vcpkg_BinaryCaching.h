@@ -0,0 +1,109 @@
+#pragma once
+
+#include "PackageSpec.h"
+#include "VcpkgPaths.h"
+#include "vcpkg_expected.h"
+#include "vcpkg_optional.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vcpkg::BinaryCaching
+{
+    /// <summary>
+    /// A store shared between machines, from which built packages are restored and to which they are uploaded. A
+    /// package is stored as the package archive of the local binary cache, keyed by its ABI tag.
+    /// </summary>
+    struct BinaryProvider
+    {
+        virtual ~BinaryProvider() = default;
+
+        virtual std::string describe() const = 0;
+
+        /// <summary>
+        /// Fetches the package archive for the ABI tag into archive; false if the provider does not have it or cannot
+        /// be reached
+        /// </summary>
+        virtual bool download(const VcpkgPaths& paths,
+                              const PackageSpec& spec,
+                              const std::string& abi_tag,
+                              const fs::path& archive) const = 0;
+
+        virtual bool upload(const VcpkgPaths& paths,
+                            const PackageSpec& spec,
+                            const std::string& abi_tag,
+                            const fs::path& archive) const = 0;
+
+        /// <summary>
+        /// Asks whether the provider has each ABI tag, in as few round trips as it can. An empty value means that it
+        /// cannot tell without downloading.
+        /// </summary>
+        virtual std::vector<Optional<bool>> check_archives(const std::vector<std::string>& abi_tags) const = 0;
+    };
+
+    struct BinarySource
+    {
+        std::shared_ptr<const BinaryProvider> provider;
+        bool read;
+        bool write;
+    };
+
+    /// <summary>
+    /// Parses sources separated by semicolons or new lines. Each is a comma separated list which names the kind of
+    /// source, its location and optionally ends with read, write or readwrite (the default):
+    ///     http,&lt;url&gt;                         GET and PUT &lt;url&gt;/&lt;abi&gt;.vpkg
+    ///     azblob,&lt;container url&gt;,&lt;sas&gt;     the same for the blobs of an Azure Storage container
+    ///     nuget,&lt;feed&gt;                       a NuGet package per ABI, through nuget.exe and its configuration
+    /// Lines starting with # are comments.
+    /// </summary>
+    ExpectedT<std::vector<BinarySource>, std::string> parse_binary_sources(const std::string& text);
+
+    /// <summary>
+    /// The sources in VCPKG_BINARY_SOURCES, or else in binarysources.txt in the vcpkg root
+    /// </summary>
+    const std::vector<BinarySource>& get_binary_sources(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Tries each source which can be read, in order, and stores the first valid archive found as archive, the entry
+    /// of the local binary cache. Returns whether one was found.
+    /// </summary>
+    bool try_restore_from_sources(const VcpkgPaths& paths,
+                                  const PackageSpec& spec,
+                                  const std::string& abi_tag,
+                                  const fs::path& archive);
+
+    /// <summary>
+    /// Asks the sources which can be read whether they have each ABI tag, without downloading anything: true if one
+    /// of them has it, false if none has it, and empty if none has it as far as it can be told without downloading
+    /// </summary>
+    std::vector<Optional<bool>> check_sources(const VcpkgPaths& paths, const std::vector<std::string>& abi_tags);
+
+    struct PrefetchRequest
+    {
+        PackageSpec spec;
+        std::string abi_tag;
+        fs::path archive;
+    };
+
+    /// <summary>
+    /// Starts restoring the packages from the sources on a background thread. Every source is first asked which of
+    /// them it has, so that the builds of the others can start at once, and then the ones found are downloaded
+    /// concurrently. try_restore_from_sources() waits for a package which is being prefetched instead of fetching it
+    /// again.
+    /// </summary>
+    void prefetch_from_sources(const VcpkgPaths& paths, std::vector<PrefetchRequest> requests);
+
+    /// <summary>
+    /// Uploads archive to every source which can be written, on background threads
+    /// </summary>
+    void queue_upload(const VcpkgPaths& paths,
+                      const PackageSpec& spec,
+                      const std::string& abi_tag,
+                      const fs::path& archive);
+
+    /// <summary>
+    /// Waits until the uploads queued so far have finished
+    /// </summary>
+    void wait_for_uploads();
+}
@@ -5,6 +5,7 @@
 #include "StatusParagraphs.h"
 #include "VcpkgPaths.h"
 #include "vcpkg_Files.h"
+#include "vcpkg_System.h"
 #include "vcpkg_optional.h"
 
 #include <array>
@@ -39,10 +40,33 @@ namespace vcpkg::Build
 
     inline bool to_bool(const AllowDownloads value) { return value == AllowDownloads::YES; }
 
+    enum class IncrementalBuild
+    {
+        NO = 0,
+        YES
+    };
+
+    inline IncrementalBuild to_incremental_build(const bool value)
+    {
+        return value ? IncrementalBuild::YES : IncrementalBuild::NO;
+    }
+
+    inline bool to_bool(const IncrementalBuild value) { return value == IncrementalBuild::YES; }
+
     struct BuildPackageOptions
     {
         UseHeadVersion use_head_version;
         AllowDownloads allow_downloads;
+
+        /// <summary>
+        /// Reuses the configured build trees of the previous build instead of configuring from scratch
+        /// </summary>
+        IncrementalBuild incremental_build;
+
+        /// <summary>
+        /// The number of processes which the build tools of one port may run at once, or 0 for one per core
+        /// </summary>
+        size_t concurrency;
     };
 
     enum class BuildResult
@@ -66,6 +90,12 @@ namespace vcpkg::Build
     std::string create_error_message(const BuildResult build_result, const PackageSpec& spec);
     std::string create_user_troubleshooting_message(const PackageSpec& spec);
 
+    enum class ConfigurationType
+    {
+        DEBUG,
+        RELEASE,
+    };
+
     /// <summary>
     /// Settings from the triplet file which impact the build environment and post-build checks
     /// </summary>
@@ -80,14 +110,60 @@ namespace vcpkg::Build
         std::string cmake_system_name;
         std::string cmake_system_version;
         std::string platform_toolset;
+
+        /// <summary>
+        /// The only configuration which the ports are built for, or nullopt when they are built for both
+        /// </summary>
+        Optional<ConfigurationType> build_type;
     };
 
     std::wstring make_build_env_cmd(const PreBuildInfo& pre_build_info, const Toolset& toolset);
 
+    /// <summary>
+    /// The environment vcvarsall.bat sets up for this toolset, architecture and target. It is captured once and kept
+    /// in installed/vcpkg/build_environments, keyed by the vcvarsall command line, the timestamp of vcvarsall.bat
+    /// and the clean environment it starts from. Returns nullopt if the environment could not be captured.
+    /// </summary>
+    Optional<std::wstring> get_build_environment(const VcpkgPaths& paths,
+                                                 const PreBuildInfo& pre_build_info,
+                                                 const Toolset& toolset);
+
+    /// <summary>
+    /// Starts finding the tools and toolsets and capturing the triplets on a thread of its own, so that probing them
+    /// overlaps with whatever the caller does next, such as loading the status database and planning. Nothing waits
+    /// for the thread: the first use of each either finds it ready or waits for it to be.
+    /// </summary>
+    void start_warm_up(const VcpkgPaths& paths, std::vector<LazyTool> tools, std::vector<Triplet> triplets);
+
+    enum class BinaryCacheStatus
+    {
+        NOT_USED = 0,
+        HIT,
+        MISS
+    };
+
+    const std::string& to_string(const BinaryCacheStatus binary_cache_status);
+
+    /// <summary>
+    /// The wall time spent in one phase of building or installing a package
+    /// </summary>
+    struct PhaseTiming
+    {
+        std::string phase;
+        double microseconds;
+    };
+
     struct ExtendedBuildResult
     {
         BuildResult code;
         std::vector<PackageSpec> unmet_dependencies;
+        BinaryCacheStatus binary_cache_status = BinaryCacheStatus::NOT_USED;
+        std::vector<PhaseTiming> phase_timings;
+
+        /// <summary>
+        /// What the portfile and every process it started used, when the portfile ran
+        /// </summary>
+        Optional<System::ResourceUsage> resource_usage;
     };
 
     struct BuildPackageConfig
@@ -127,10 +203,147 @@ namespace vcpkg::Build
         const std::unordered_set<std::string>* feature_list;
     };
 
+    struct AbiEntry
+    {
+        std::string key;
+        std::string value;
+    };
+
+    /// <summary>
+    /// The dependencies of the core paragraph and of the features which are being built
+    /// </summary>
+    std::vector<Dependency> get_build_dependencies(const BuildPackageConfig& config);
+
+    std::vector<PackageSpec> find_missing_dependencies(const BuildPackageConfig& config,
+                                                       const StatusParagraphs& status_db);
+
+    /// <summary>
+    /// The ABI tags of the installed dependencies. A dependency which was built without binary caching has an empty
+    /// value, which disables binary caching for this package.
+    /// </summary>
+    std::vector<AbiEntry> get_dependency_abis(const BuildPackageConfig& config, const StatusParagraphs& status_db);
+
+    /// <summary>
+    /// The ABI tag under which build_package() would cache the package, or nullopt if it would not cache it
+    /// </summary>
+    Optional<std::string> compute_abi_tag(const VcpkgPaths& paths,
+                                          const BuildPackageConfig& config,
+                                          const std::vector<AbiEntry>& dependency_abis);
+
+    /// <summary>
+    /// The local binary cache: VCPKG_BINARY_CACHE if it is set, and the archives directory of the root otherwise
+    /// </summary>
+    fs::path get_binary_cache_dir(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// The package archive in the local binary cache which holds the package with the ABI tag
+    /// </summary>
+    fs::path get_archive_path(const VcpkgPaths& paths, const std::string& abi_tag);
+
     ExtendedBuildResult build_package(const VcpkgPaths& paths,
                                       const BuildPackageConfig& config,
                                       const StatusParagraphs& status_db);
 
+    /// <summary>
+    /// Builds the package without consulting the status database. The caller is responsible for ensuring that all
+    /// dependencies are installed, for example with find_missing_dependencies().
+    /// </summary>
+    ExtendedBuildResult build_package(const VcpkgPaths& paths,
+                                      const BuildPackageConfig& config,
+                                      const std::vector<AbiEntry>& dependency_abis);
+
+    /// <summary>
+    /// A package whose portfile has run, but whose output has not been checked yet. It keeps other builds of the
+    /// package out of its packages directory until finish_build() is done with it.
+    /// </summary>
+    struct StartedBuild
+    {
+        ExtendedBuildResult result;
+
+        /// <summary>
+        /// Whether there is nothing left to check, because the build failed or was restored from the binary cache
+        /// </summary>
+        bool is_finished;
+        PreBuildInfo pre_build_info;
+        Optional<std::string> abi_tag;
+        Optional<fs::path> archive;
+        Files::FileLock build_lock;
+    };
+
+    /// <summary>
+    /// The first half of build_package(): restores the package from the binary cache or runs its portfile. The
+    /// post-build checks are left to finish_build(), so that another build can run while they do.
+    /// </summary>
+    StartedBuild start_build(const VcpkgPaths& paths,
+                             const BuildPackageConfig& config,
+                             const std::vector<AbiEntry>& dependency_abis);
+
+    /// <summary>
+    /// The second half of build_package(): runs the post-build checks and writes the control file of the package
+    /// </summary>
+    ExtendedBuildResult finish_build(const VcpkgPaths& paths, const BuildPackageConfig& config, StartedBuild started);
+
+    /// <summary>
+    /// A file which a port downloads with vcpkg_download_distfile
+    /// </summary>
+    struct Distfile
+    {
+        std::string sha512;
+        std::string filename;
+        std::vector<std::string> urls;
+        /// <summary>
+        /// The size of the file when the port was last built; empty for distfiles recorded without it
+        /// </summary>
+        Optional<uintmax_t> size;
+    };
+
+    /// <summary>
+    /// The distfiles which the last build of this version of the port downloaded, or none if it was not built yet
+    /// </summary>
+    std::vector<Distfile> load_distfiles(const VcpkgPaths& paths, const SourceParagraph& source);
+
+    /// <summary>
+    /// The distfiles which the last build of the port downloaded, whichever version it was
+    /// </summary>
+    std::vector<Distfile> load_recorded_distfiles(const VcpkgPaths& paths, const std::string& port_name);
+
+    /// <summary>
+    /// The MSYS2 packages which the last build of this version of the port asked vcpkg_acquire_msys for
+    /// </summary>
+    std::vector<std::string> load_msys_packages(const VcpkgPaths& paths, const SourceParagraph& source);
+
+    /// <summary>
+    /// How long the last build of each port took for each triplet, which plans the order of parallel builds, and how
+    /// much memory it took at its peak, which admits them
+    /// </summary>
+    struct BuildTimes
+    {
+        static BuildTimes load(const VcpkgPaths& paths);
+
+        /// <summary>
+        /// The duration of the cmake build of the spec, in microseconds, if it was built before
+        /// </summary>
+        Optional<double> find(const PackageSpec& spec) const;
+
+        /// <summary>
+        /// The mean of all known durations, or nullopt if nothing was built yet
+        /// </summary>
+        Optional<double> mean() const;
+
+        /// <summary>
+        /// The peak memory of the processes of the last build of the spec, in MiB, if it was measured
+        /// </summary>
+        Optional<size_t> find_peak_memory_mib(const PackageSpec& spec) const;
+
+        void record(const PackageSpec& spec, const double microseconds);
+        void record_peak_memory(const PackageSpec& spec, const size_t mib);
+        void save(const VcpkgPaths& paths) const;
+
+    private:
+        std::map<std::string, double> m_microseconds;
+        std::map<std::string, size_t> m_peak_memory_mib;
+    };
+
     enum class BuildPolicy
     {
         EMPTY_PACKAGE,
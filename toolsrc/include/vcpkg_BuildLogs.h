@@ -0,0 +1,37 @@
+#pragma once
+
+#include "PackageSpec.h"
+#include "VcpkgPaths.h"
+#include "filesystem_fs.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::BuildLogs
+{
+    /// <summary>
+    /// The logs of the last build of the package, compressed into a package archive:
+    /// buildtrees/&lt;port&gt;/&lt;triplet&gt;.vcpkg_logs
+    /// </summary>
+    fs::path get_archive_path(const VcpkgPaths& paths, const PackageSpec& spec);
+
+    /// <summary>
+    /// Whether the log is one of a build for the triplet. The port scripts name the logs &lt;phase&gt;-&lt;triplet&gt;
+    /// followed by .log or by a dash and more, so a log of x64-windows-static also looks like one of x64-windows;
+    /// it belongs to the longest of the triplets which it could be for.
+    /// </summary>
+    bool is_log_of_triplet(const std::string& file_name,
+                           const std::string& triplet,
+                           const std::vector<std::string>& triplets);
+
+    /// <summary>
+    /// Archives the logs which the build of the package wrote in buildtrees/&lt;port&gt; since it started. The logs
+    /// themselves stay, as the port scripts point at them when a build fails.
+    /// </summary>
+    void archive_logs(const VcpkgPaths& paths, const PackageSpec& spec, const fs::file_time_type& build_start);
+
+    /// <summary>
+    /// Removes the logs which are in the archive as they are there, which is all a successful build needs to keep
+    /// </summary>
+    void remove_archived_logs(const VcpkgPaths& paths, const PackageSpec& spec);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "PackageSpec.h"
+#include "VcpkgPaths.h"
+#include "filesystem_fs.h"
+#include "vcpkg_Build.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_optional.h"
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// A directory shared between machines, through which the builds of an install plan are handed to other machines. A
+/// coordinator puts the builds whose dependencies are done in the queue, and the workers which run x-build-worker take
+/// them and publish the packages they build to the binary sources, from which the coordinator restores them:
+///     pending/&lt;abi&gt;.job     a build which waits for a worker
+///     claimed/&lt;abi&gt;.job     moved there by the worker which builds it
+///     claimed/&lt;abi&gt;.lock    locked by that worker for as long as it builds
+///     done/&lt;abi&gt;.result    written by the worker once the package is in the binary sources
+/// Both sides need the same ports and triplets, and must share a binary source they can both read and write.
+/// </summary>
+namespace vcpkg::BuildQueue
+{
+    /// <summary>
+    /// A build of a package, named by the ABI tag it must have
+    /// </summary>
+    struct Job
+    {
+        PackageSpec spec;
+        std::string abi_tag;
+        std::vector<std::string> features;
+    };
+
+    std::string serialize_job(const Job& job);
+    Optional<Job> parse_job(const std::string& text);
+
+    /// <summary>
+    /// The queue in VCPKG_BUILD_QUEUE, if it is set
+    /// </summary>
+    Optional<fs::path> get_queue_dir();
+
+    /// <summary>
+    /// Hands the build to a worker and waits until it is done, unless the binary sources already have the package.
+    /// Returns nullopt if the package is to be built here: when there is no queue or the package will not have an ABI
+    /// tag, and when no worker took the build in time, the worker died or it computed another ABI tag for it.
+    /// SUCCEEDED means that build_package() will restore the package from the binary sources.
+    /// </summary>
+    Optional<Build::BuildResult> try_build_remotely(const VcpkgPaths& paths,
+                                                    const Build::BuildPackageConfig& config,
+                                                    const std::vector<Build::AbiEntry>& dependency_abis);
+
+    /// <summary>
+    /// A job which a worker took out of the queue. Its lock tells the coordinator that the worker is alive.
+    /// </summary>
+    struct ClaimedJob
+    {
+        Job job;
+        Files::FileLock lock;
+    };
+
+    /// <summary>
+    /// Takes the oldest pending job which no other worker took first
+    /// </summary>
+    Optional<ClaimedJob> try_claim(Files::Filesystem& fs, const fs::path& queue_dir);
+
+    /// <summary>
+    /// Tells the coordinator the result of the job: the name of a BuildResult, or ABI_MISMATCH when the worker would
+    /// have built the package with another ABI tag
+    /// </summary>
+    void complete(Files::Filesystem& fs,
+                  const fs::path& queue_dir,
+                  const ClaimedJob& claimed,
+                  const std::string& result);
+
+    static const std::string ABI_MISMATCH = "ABI_MISMATCH";
+}
@@ -25,4 +25,9 @@ namespace vcpkg
     private:
         std::chrono::high_resolution_clock::time_point m_start_tick;
     };
+
+    /// <summary>
+    /// Formats a duration the way ElapsedTime::to_string does
+    /// </summary>
+    std::string format_time_userfriendly(const std::chrono::nanoseconds& nanos);
 }
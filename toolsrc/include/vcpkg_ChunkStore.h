@@ -0,0 +1,76 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_expected.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vcpkg::ChunkStore
+{
+    /// <summary>
+    /// A piece of a package archive, cut where the contents say rather than at fixed offsets, so that the parts of
+    /// two versions of a package which are the same give the same chunks
+    /// </summary>
+    struct Chunk
+    {
+        /// <summary>
+        /// The SHA256 of the chunk as lowercase hexadecimal
+        /// </summary>
+        std::string sha256;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static constexpr size_t MIN_CHUNK_SIZE = 128 * 1024;
+    static constexpr size_t MAX_CHUNK_SIZE = 2 * 1024 * 1024;
+
+    /// <summary>
+    /// The size of the chunk which starts at data: where a rolling hash of the last bytes matches, but at least
+    /// MIN_CHUNK_SIZE and at most MAX_CHUNK_SIZE. All of size if there is no cut before it.
+    /// </summary>
+    size_t find_cut(const char* data, const size_t size);
+
+    /// <summary>
+    /// Cuts the file into chunks and hashes each
+    /// </summary>
+    ExpectedT<std::vector<Chunk>, std::string> split_file(const fs::path& file);
+
+    /// <summary>
+    /// The index of the archive, which lists its chunks in order; it is kept next to the archive as .vpkgi
+    /// </summary>
+    fs::path get_index_path(const fs::path& archive);
+
+    std::string format_index(const std::vector<Chunk>& chunks);
+
+    ExpectedT<std::vector<Chunk>, std::string> parse_index(const std::string& text);
+
+    /// <summary>
+    /// Splits an archive of the local binary cache and writes its index next to it, which makes its chunks available
+    /// to assemble() for other archives of the cache
+    /// </summary>
+    ExpectedT<std::vector<Chunk>, std::string> index_archive(Files::Filesystem& fs, const fs::path& archive);
+
+    /// <summary>
+    /// Fetches the chunk from a remote store into data; false if it could not
+    /// </summary>
+    using FetchChunk = std::function<bool(const Chunk& chunk, std::string& data)>;
+
+    /// <summary>
+    /// Writes the archive at output from the chunks of its index. Each chunk is read from an archive of the local
+    /// binary cache in cache_dir which has it, and fetched otherwise; every chunk is checked against its hash. The
+    /// index is written next to output once it is complete. Returns the number of bytes fetched.
+    /// </summary>
+    ExpectedT<uint64_t, std::string> assemble(Files::Filesystem& fs,
+                                              const fs::path& cache_dir,
+                                              const std::vector<Chunk>& chunks,
+                                              const fs::path& output,
+                                              const FetchChunk& fetch);
+
+    /// <summary>
+    /// Reads the chunk of the archive which it was split from
+    /// </summary>
+    bool read_chunk(const fs::path& archive, const Chunk& chunk, std::string& data);
+}
@@ -6,6 +6,7 @@
 #include "VersionT.h"
 #include "vcpkg_Build.h"
 #include "vcpkg_Dependencies.h"
+#include "vcpkg_Listfile.h"
 #include <array>
 
 namespace vcpkg::Commands
@@ -41,6 +42,22 @@ namespace vcpkg::Commands
 
         inline KeepGoing to_keep_going(const bool value) { return value ? KeepGoing::YES : KeepGoing::NO; }
 
+        /// <summary>
+        /// Which ready action the parallel scheduler starts first: the one on the longest chain, which finishes the
+        /// whole plan soonest, or the one whose requested package comes first on the command line, which makes the
+        /// requested packages usable one after another while the rest still builds
+        /// </summary>
+        enum class PlanOrder
+        {
+            CRITICAL_PATH = 0,
+            REQUESTED_FIRST
+        };
+
+        inline PlanOrder to_plan_order(const bool requested_first)
+        {
+            return requested_first ? PlanOrder::REQUESTED_FIRST : PlanOrder::CRITICAL_PATH;
+        }
+
         enum class PrintSummary
         {
             NO = 0,
@@ -49,6 +66,18 @@ namespace vcpkg::Commands
 
         inline PrintSummary to_print_summary(const bool value) { return value ? PrintSummary::YES : PrintSummary::NO; }
 
+        /// <summary>
+        /// Whether files may be hard linked into the destination instead of copied. Links share their contents with
+        /// the source, so this is only safe when neither side is modified afterwards. TO_STORE links every file to
+        /// the entry of the content store with the same contents, so that identical files are kept once.
+        /// </summary>
+        enum class LinkFiles
+        {
+            NO = 0,
+            YES,
+            TO_STORE
+        };
+
         struct InstallDir
         {
             static InstallDir from_destination_root(const fs::path& destination_root,
@@ -59,11 +88,17 @@ namespace vcpkg::Commands
             fs::path m_destination;
             std::string m_destination_subdirectory;
             fs::path m_listfile;
+            fs::path m_store_dir;
 
         public:
             const fs::path& destination() const;
             const std::string& destination_subdirectory() const;
             const fs::path& listfile() const;
+
+            /// <summary>
+            /// The content store which files installed with LinkFiles::TO_STORE are linked to
+            /// </summary>
+            const fs::path& store_dir() const;
         };
 
         Build::BuildResult perform_install_plan_action(const VcpkgPaths& paths,
@@ -79,15 +114,118 @@ namespace vcpkg::Commands
 
         void install_files_and_write_listfile(Files::Filesystem& fs,
                                               const fs::path& source_dir,
-                                              const InstallDir& dirs);
+                                              const InstallDir& dirs,
+                                              const LinkFiles link_files = LinkFiles::NO);
+
+        /// <summary>
+        /// Installs a new version of a package over the files of the previous one, which are given by that version's
+        /// listfile entries. Files with the same contents are left untouched, keeping their timestamps; changed files
+        /// are overwritten and the files the new version no longer has are removed.
+        /// </summary>
+        void replace_files_and_write_listfile(Files::Filesystem& fs,
+                                              const fs::path& source_dir,
+                                              const InstallDir& dirs,
+                                              const std::vector<Listfile::Entry>& previous_entries,
+                                              const LinkFiles link_files = LinkFiles::NO);
+
+        /// <summary>
+        /// Installs a built package. If another version of it is installed, that version is replaced in place.
+        /// </summary>
         InstallResult install_package(const VcpkgPaths& paths,
                                       const BinaryControlFile& binary_paragraph,
                                       StatusParagraphs* status_db);
 
+        struct SpecSummary
+        {
+            PackageSpec spec;
+            Build::ExtendedBuildResult build_result;
+            std::string timing;
+            double microseconds;
+        };
+
+        struct InstallSummary
+        {
+            std::vector<SpecSummary> results;
+            std::string total_elapsed_time;
+            double total_microseconds;
+
+            void print() const;
+
+            /// <summary>
+            /// A machine-readable report with the result, wall times and binary cache status of every package
+            /// </summary>
+            std::string to_json() const;
+        };
+
+        /// <summary>
+        /// The packages which must be installed before the package of the action is built
+        /// </summary>
+        std::vector<PackageSpec> get_install_plan_dependencies(const Dependencies::InstallPlanAction& action);
+
+        /// <summary>
+        /// The ABI tag which each package the plan builds will have, computed from the tags which the packages planned
+        /// before it will have; nullopt for the actions which build nothing or will not be cached
+        /// </summary>
+        std::vector<Optional<std::string>> compute_planned_abis(
+            const std::vector<Dependencies::AnyAction>& action_plan,
+            const Build::BuildPackageOptions& install_plan_options,
+            const VcpkgPaths& paths,
+            const StatusParagraphs& status_db);
+
+        /// <summary>
+        /// How many microseconds each action is expected to take, from the recorded build times. Only builds take
+        /// time; a build which was never recorded is expected to take as long as the average one.
+        /// </summary>
+        std::vector<double> estimate_durations(const std::vector<Dependencies::AnyAction>& action_plan,
+                                               const Build::BuildTimes& build_times);
+
+        /// <summary>
+        /// Parses the value of the jobs option, or returns 1 if it was not passed. A value which was passed also caps the
+        /// shared thread pool.
+        /// </summary>
+        size_t parse_jobs(const ParsedArguments& parsed_arguments, const std::string& option_jobs);
+
+        /// <summary>
+        /// The order of the plan in which each requested action, taken in the order given, comes right after those of
+        /// its dependencies which are not placed yet; the actions which were not needed by any of them follow in plan
+        /// order. `dependencies` holds for each action the indices of the earlier actions it waits for.
+        /// </summary>
+        std::vector<size_t> order_by_requests(const std::vector<std::vector<size_t>>& dependencies,
+                                              const std::vector<size_t>& requested);
+
+        /// <summary>
+        /// Prints what performing the plan is expected to cost: for each package to be built, how long its last build
+        /// took, whether the local or a remote binary cache already has it, and the size of its distfiles which are not
+        /// downloaded yet; then the totals and the time the plan takes with `jobs` builds at once
+        /// </summary>
+        void print_plan_estimate(const std::vector<Dependencies::AnyAction>& action_plan,
+                                 const Build::BuildPackageOptions& install_plan_options,
+                                 const PlanOrder plan_order,
+                                 const size_t jobs,
+                                 const VcpkgPaths& paths,
+                                 const StatusParagraphs& status_db);
+
+        /// <summary>
+        /// Writes summary.to_json() to the file passed with the report option, if it was passed
+        /// </summary>
+        void write_json_report_if_requested(const VcpkgPaths& paths,
+                                            const ParsedArguments& parsed_arguments,
+                                            const std::string& option_json_report,
+                                            const InstallSummary& summary);
+
+        InstallSummary perform(const std::vector<Dependencies::AnyAction>& action_plan,
+                               const Build::BuildPackageOptions& install_plan_options,
+                               const KeepGoing keep_going,
+                               const size_t jobs,
+                               const VcpkgPaths& paths,
+                               StatusParagraphs& status_db,
+                               const PlanOrder plan_order = PlanOrder::CRITICAL_PATH);
+
         void perform_and_exit(const std::vector<Dependencies::AnyAction>& action_plan,
                               const Build::BuildPackageOptions& install_plan_options,
                               const KeepGoing keep_going,
                               const PrintSummary print_summary,
+                              const size_t jobs,
                               const VcpkgPaths& paths,
                               StatusParagraphs& status_db);
 
@@ -101,6 +239,17 @@ namespace vcpkg::Commands
 
     namespace CI
     {
+        /// <summary>
+        /// The indices, in plan order, of the actions which shard `shard` of `shard_count` performs. Every action is in
+        /// some shard, and a shard has the dependencies of each of its actions, so that it can run on its own and take
+        /// what another shard already built from the binary cache. The shards are balanced by the duration of what
+        /// each performs, and the same inputs always give the same shards.
+        /// </summary>
+        std::vector<size_t> select_shard(const std::vector<std::vector<size_t>>& dependencies,
+                                         const std::vector<double>& durations,
+                                         const size_t shard,
+                                         const size_t shard_count);
+
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
     }
 
@@ -114,6 +263,15 @@ namespace vcpkg::Commands
 
         inline Purge to_purge(const bool value) { return value ? Purge::YES : Purge::NO; }
 
+        /// <summary>
+        /// Deletes the files named in the listfile lines, which are relative to installed_dir, concurrently. Then
+        /// removes the directories which became empty in a single bottom-up pass. Problems are collected and reported
+        /// once at the end.
+        /// </summary>
+        void remove_listed_files(Files::Filesystem& fs,
+                                 const fs::path& installed_dir,
+                                 const std::vector<std::string>& listfile_lines);
+
         void perform_remove_plan_action(const VcpkgPaths& paths,
                                         const Dependencies::RemovePlanAction& action,
                                         const Purge purge,
@@ -121,6 +279,13 @@ namespace vcpkg::Commands
 
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
         void remove_package(const VcpkgPaths& paths, const PackageSpec& spec, StatusParagraphs* status_db);
+
+        /// <summary>
+        /// Removes several installed packages at once, deleting the files of all of them in a single batch.
+        /// </summary>
+        void remove_packages(const VcpkgPaths& paths,
+                             const std::vector<PackageSpec>& specs,
+                             StatusParagraphs* status_db);
     }
 
     namespace Update
@@ -137,6 +302,11 @@ namespace vcpkg::Commands
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
     }
 
+    namespace Upgrade
+    {
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
+    }
+
     namespace Env
     {
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
@@ -174,6 +344,123 @@ namespace vcpkg::Commands
 
     namespace Cache
     {
+        /// <summary>
+        /// A package directory in packages/, as recorded in the index of the cache
+        /// </summary>
+        struct CachedPackage
+        {
+            /// <summary>The name of the directory, which is the dir() of the spec for anything vcpkg built</summary>
+            std::string dir;
+            /// <summary>The size and modification time of its CONTROL file</summary>
+            std::string stamp;
+            PackageSpec spec;
+            std::string version;
+            std::string abi;
+            std::vector<std::string> features;
+
+            std::string displayname() const;
+        };
+
+        fs::path get_index_path(const VcpkgPaths& paths);
+
+        /// <summary>
+        /// The package directories, sorted by name. The index in packages/ records the stamp of each CONTROL file, so
+        /// only the directories which were built, restored or replaced since it was written are parsed again; it is
+        /// rewritten whenever a directory was added, changed or removed.
+        /// </summary>
+        std::vector<CachedPackage> load_cached_packages(const VcpkgPaths& paths);
+
+        void save_index(Files::Filesystem& fs, const fs::path& index_path, const std::vector<CachedPackage>& packages);
+
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
+    }
+
+    namespace BuildWorker
+    {
+        /// <summary>
+        /// Takes builds out of the queue of a coordinator until it is stopped; see BuildQueue
+        /// </summary>
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
+    }
+
+    namespace GarbageCollect
+    {
+        /// <summary>
+        /// Parses a size like "512M" or "20GB", whose suffixes are powers of 1024
+        /// </summary>
+        Optional<uint64_t> parse_size(const std::string& text);
+
+        /// <summary>
+        /// Formats a size in bytes, or in the largest unit of 1024 which keeps it at least 1
+        /// </summary>
+        std::string format_size(const uint64_t size);
+
+        /// <summary>
+        /// Evicts the least recently used downloads, package directories and build trees until the rest fit in the
+        /// budget. The package directories of the specs and of the installed packages are kept, along with the
+        /// distfiles of their ports. Returns the number of bytes evicted.
+        /// </summary>
+        uint64_t collect(const VcpkgPaths& paths,
+                         const uint64_t budget,
+                         const std::vector<PackageSpec>& referenced_specs,
+                         const bool dry_run);
+
+        /// <summary>
+        /// Collects after an install plan when VCPKG_CACHE_BUDGET is set, keeping whatever the plan referenced
+        /// </summary>
+        void collect_if_over_budget(const VcpkgPaths& paths, const std::vector<Dependencies::AnyAction>& action_plan);
+
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
+    }
+
+    namespace Verify
+    {
+        enum class FileState
+        {
+            INTACT,
+            MISSING,
+            WRONG_SIZE,
+            WRONG_CONTENTS
+        };
+
+        struct DamagedFile
+        {
+            /// <summary>Relative to installed, like the lines of the listfile</summary>
+            std::string path;
+            FileState state;
+        };
+
+        struct PackageDrift
+        {
+            PackageSpec spec;
+            /// <summary>Whether packages/ still has the build which was installed, to repair the files from</summary>
+            bool has_package_dir;
+            std::vector<DamagedFile> files;
+        };
+
+        /// <summary>
+        /// Where the package directory has the file which the listfile lists at listed_path
+        /// </summary>
+        fs::path get_package_file_path(const VcpkgPaths& paths,
+                                       const PackageSpec& spec,
+                                       const std::string& listed_path);
+
+        /// <summary>
+        /// Checks that the files in the listfiles of the installed packages exist and, where the listfile recorded
+        /// it, have the size they were installed with. With check_contents, the files linked to the content store are
+        /// hashed and compared with their key, and the others with the package directory if it still has the build
+        /// which was installed. The files of all packages are checked in parallel. Returns the packages with damaged files, in the order of the status
+        /// database.
+        /// </summary>
+        std::vector<PackageDrift> verify(const VcpkgPaths& paths,
+                                         const StatusParagraphs& status_db,
+                                         const bool check_contents);
+
+        /// <summary>
+        /// Copies the damaged files back from the package directories. Returns how many could not be repaired.
+        /// </summary>
+        size_t repair(const VcpkgPaths& paths, const std::vector<PackageDrift>& drift);
+
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
     }
 
@@ -186,6 +473,14 @@ namespace vcpkg::Commands
     {
         extern const char* const INTEGRATE_COMMAND_HELPSTRING;
 
+        /// <summary>
+        /// Writes the triplet's tool directories and installed packages to its toolchain snapshot, so that vcpkg.cmake
+        /// includes one file instead of enumerating the installed tree on every configure
+        /// </summary>
+        void write_toolchain_snapshot(const VcpkgPaths& paths,
+                                      const StatusParagraphs& status_db,
+                                      const Triplet& triplet);
+
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
     }
 
@@ -220,8 +515,125 @@ namespace vcpkg::Commands
         void perform_and_exit(const VcpkgCmdArguments& args);
     }
 
+    namespace AppLocal
+    {
+        /// <summary>
+        /// Forgets the imports of the triplet's DLLs which earlier deployments recorded
+        /// </summary>
+        void invalidate_dependents_cache(const VcpkgPaths& paths, const Triplet& triplet);
+
+        void perform_and_exit(const VcpkgCmdArguments& args);
+    }
+
     namespace Hash
     {
+        /// <summary>
+        /// An in-process BCrypt hash which data can be fed to in chunks
+        /// </summary>
+        struct Hasher : Util::ResourceBase
+        {
+            explicit Hasher(const std::string& hash_type);
+            ~Hasher();
+
+            void add(const char* data, const size_t size);
+
+            /// <summary>
+            /// The hash as lowercase hexadecimal, like CertUtil and CMake print it
+            /// </summary>
+            std::string finish();
+
+        private:
+            // BCRYPT_ALG_HANDLE and BCRYPT_HASH_HANDLE, which keeps bcrypt.h out of this header
+            void* m_algorithm = nullptr;
+            void* m_hash = nullptr;
+            size_t m_hash_length = 0;
+        };
+
+        /// <summary>
+        /// Hashes the file in-process. hash_type is one of the algorithms CertUtil accepts, like SHA1 or SHA512.
+        /// </summary>
+        std::string get_file_hash(const fs::path& path, const std::string& hash_type);
+        std::string get_string_hash(const std::string& data, const std::string& hash_type);
+        void perform_and_exit(const VcpkgCmdArguments& args);
+    }
+
+    namespace Download
+    {
+        void perform_and_exit(const VcpkgCmdArguments& args);
+    }
+
+    namespace Logs
+    {
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
+    }
+
+    namespace Watch
+    {
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
+    }
+
+    namespace PdbPaths
+    {
+        void perform_and_exit(const VcpkgCmdArguments& args);
+    }
+
+    namespace FixupCmakeTargets
+    {
+        /// <summary>
+        /// Points the references to executables in bin/ at tools/<port>/, where vcpkg puts them
+        /// </summary>
+        std::string relocate_executables(const std::string& contents, const std::string& port);
+
+        /// <summary>
+        /// relocate_executables(), and the references to lib/ and bin/ to debug/lib/ and debug/bin/
+        /// </summary>
+        std::string relocate_debug_targets(const std::string& contents, const std::string& port);
+
+        /// <summary>
+        /// Finds _IMPORT_PREFIX two directories up, from share/<port>
+        /// </summary>
+        std::string fix_import_prefix(const std::string& contents);
+
+        /// <summary>
+        /// Finds PACKAGE_PREFIX_DIR two directories up, from share/<port>
+        /// </summary>
+        std::string fix_package_prefix(const std::string& contents);
+
+        void perform_and_exit(const VcpkgCmdArguments& args);
+    }
+
+    namespace ApplyPatches
+    {
+        struct Hunk
+        {
+            size_t old_start;
+
+            /// <summary>
+            /// Each line keeps its ' ', '-' or '+' and its line ending, which is missing after
+            /// "\ No newline at end of file"
+            /// </summary>
+            std::vector<std::string> lines;
+        };
+
+        /// <summary>
+        /// The paths are relative to the source tree, with the first directory stripped like git apply -p1 does.
+        /// old_path is empty for a file the patch creates, and new_path for a file it deletes.
+        /// </summary>
+        struct FilePatch
+        {
+            std::string old_path;
+            std::string new_path;
+            std::vector<Hunk> hunks;
+        };
+
+        ExpectedT<std::vector<FilePatch>, std::string> parse_patch(const std::string& text);
+
+        /// <summary>
+        /// Applies the hunks like git apply --ignore-whitespace: the context has to match but for whitespace, and a
+        /// hunk may be found away from its line number, but never with less context
+        /// </summary>
+        Optional<std::string> apply_hunks(const std::string& contents, const std::vector<Hunk>& hunks);
+
         void perform_and_exit(const VcpkgCmdArguments& args);
     }
 
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_optional.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::ContentStore
+{
+    /// <summary>
+    /// An installed file which is a hard link to the store entry with its contents
+    /// </summary>
+    struct Link
+    {
+        /// <summary>
+        /// The SHA256 of the contents, which names the store entry
+        /// </summary>
+        std::string key;
+
+        /// <summary>
+        /// Relative to installed, like the lines of the listfile
+        /// </summary>
+        std::string path;
+    };
+
+    /// <summary>
+    /// The store of the installed tree, which is on the same volume so that its entries can be hard linked
+    /// </summary>
+    fs::path store_dir(const fs::path& installed_dir);
+
+    /// <summary>
+    /// Where the links of the files installed with a listfile are recorded
+    /// </summary>
+    fs::path links_path(const fs::path& listfile_path);
+
+    std::vector<Link> read_links(const Files::Filesystem& fs, const fs::path& listfile_path);
+
+    /// <summary>
+    /// Records the links next to the listfile, or removes the record if there are none
+    /// </summary>
+    void write_links(Files::Filesystem& fs, const fs::path& listfile_path, const std::vector<Link>& links);
+
+    /// <summary>
+    /// Hard links target to the store entry with the contents of source, adding the entry if the store has none.
+    /// Returns the key of the entry, or nullopt if target could not be linked and has to be copied instead.
+    /// </summary>
+    Optional<std::string> link(Files::Filesystem& fs,
+                               const fs::path& store_dir,
+                               const fs::path& source,
+                               const fs::path& target,
+                               const std::uintmax_t size);
+
+    /// <summary>
+    /// The key of the store entry with the contents of the file, if the store has one
+    /// </summary>
+    Optional<std::string> find(const Files::Filesystem& fs, const fs::path& store_dir, const fs::path& file);
+
+    /// <summary>
+    /// Removes those of the entries which no installed file links to any more. The store itself is one of the hard
+    /// links of each entry, so an entry is unused when that is the only one left.
+    /// </summary>
+    void release(Files::Filesystem& fs, const fs::path& store_dir, const std::vector<std::string>& keys);
+}
@@ -3,8 +3,12 @@
 #include "StatusParagraphs.h"
 #include "VcpkgPaths.h"
 #include "vcpkg_Graphs.h"
+#include "vcpkg_PortIndex.h"
 #include "vcpkg_Util.h"
 #include "vcpkg_optional.h"
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 #include <vector>
 
 namespace vcpkg::Dependencies
@@ -18,13 +22,16 @@ namespace vcpkg::Dependencies
 
     std::string to_output_string(RequestType request_type, const CStringView s);
 
+    /// <summary>
+    /// The port paragraphs point into the PortFileProvider which the plan was made from, which must outlive the plan
+    /// </summary>
     struct AnyParagraph
     {
         std::vector<PackageSpec> dependencies(const Triplet& triplet) const;
 
         Optional<StatusParagraph> status_paragraph;
         Optional<BinaryControlFile> binary_control_file;
-        Optional<SourceParagraph> source_paragraph;
+        Optional<const SourceParagraph*> source_paragraph;
         Optional<const SourceControlFile*> source_control_file;
     };
 }
@@ -80,6 +87,18 @@ namespace vcpkg::Dependencies
         PackageSpec spec;
         RemovePlanType plan_type;
         RequestType request_type;
+
+        /// <summary>
+        /// The package which this one is rebuilt against, when it is only rebuilt because a feature which changes the
+        /// ABI is added to that dependency
+        /// </summary>
+        Optional<PackageSpec> cascaded_from;
+
+        /// <summary>
+        /// The installed packages which depend on this one and stay installed through its rebuild, because the
+        /// features added to it do not change its ABI
+        /// </summary>
+        std::vector<PackageSpec> kept_dependents;
     };
 
     struct AnyAction
@@ -113,21 +132,48 @@ namespace vcpkg::Dependencies
         RequestType request_type;
     };
 
-    __interface PortFileProvider { virtual const SourceControlFile& get_control_file(const std::string& spec) const; };
+    __interface PortFileProvider
+    {
+        virtual const SourceControlFile& get_control_file(const std::string& spec) const;
+
+        /// <summary>
+        /// Like get_control_file(), but returns nullopt instead of exiting when there is no port with that name or
+        /// its CONTROL file cannot be parsed
+        /// </summary>
+        virtual Optional<const SourceControlFile*> try_get_control_file(const std::string& spec) const;
+    };
 
     struct MapPortFile : Util::ResourceBase, PortFileProvider
     {
         const std::unordered_map<std::string, SourceControlFile>& ports;
         explicit MapPortFile(const std::unordered_map<std::string, SourceControlFile>& map);
         const SourceControlFile& get_control_file(const std::string& spec) const override;
+        Optional<const SourceControlFile*> try_get_control_file(const std::string& spec) const override;
     };
 
     struct PathsPortFile : Util::ResourceBase, PortFileProvider
     {
         const VcpkgPaths& ports;
+
+        /// <summary>
+        /// The ports loaded so far. Entries are never removed, and the nodes of the map do not move, so the references
+        /// handed out stay valid while other threads add ports.
+        /// </summary>
         mutable std::unordered_map<std::string, SourceControlFile> cache;
+        mutable std::mutex cache_mutex;
+
+        /// <summary>
+        /// The ports whose CONTROL files could not be parsed, guarded by cache_mutex as well
+        /// </summary>
+        mutable std::unordered_set<std::string> unparsable;
+
+        /// <summary>
+        /// The port index, from which the ports whose CONTROL files did not change are parsed
+        /// </summary>
+        Lazy<PortIndex::Table> index;
         explicit PathsPortFile(const VcpkgPaths& paths);
         const SourceControlFile& get_control_file(const std::string& spec) const override;
+        Optional<const SourceControlFile*> try_get_control_file(const std::string& spec) const override;
     };
 
     std::vector<InstallPlanAction> create_install_plan(const PortFileProvider& port_file_provider,
@@ -137,11 +183,48 @@ namespace vcpkg::Dependencies
     std::vector<RemovePlanAction> create_remove_plan(const std::vector<PackageSpec>& specs,
                                                      const StatusParagraphs& status_db);
 
+    /// <summary>
+    /// The graph of the port names, with an edge to every dependency of the core and of each feature. The qualifiers
+    /// are applied for the triplet, or ignored without one. Dependencies which are not ports are vertices as well.
+    /// </summary>
+    Graphs::Graph<std::string> create_port_graph(const std::vector<std::unique_ptr<SourceControlFile>>& ports,
+                                                 const Optional<Triplet>& triplet);
+
     std::vector<ExportPlanAction> create_export_plan(const VcpkgPaths& paths,
+                                                     const PortFileProvider& port_file_provider,
                                                      const std::vector<PackageSpec>& specs,
                                                      const StatusParagraphs& status_db);
 
+    std::vector<AnyAction> create_feature_install_plan(const PortFileProvider& port_file_provider,
+                                                       const std::vector<FeatureSpec>& specs,
+                                                       const StatusParagraphs& status_db);
+
     std::vector<AnyAction> create_feature_install_plan(const std::unordered_map<std::string, SourceControlFile>& map,
                                                        const std::vector<FeatureSpec>& specs,
                                                        const StatusParagraphs& status_db);
+
+    struct FeatureInstallPlannerState;
+
+    /// <summary>
+    /// Plans feature installs against a cluster graph which is built once and kept between requests. Adding a feature
+    /// spec extends the current plan. Removing one resets only the clusters the previous requests reached and replays
+    /// the remaining requests. Ports are loaded from the provider only when a cluster is first reached, so the
+    /// provider and the status database must outlive the planner.
+    /// </summary>
+    struct FeatureInstallPlanner : Util::ResourceBase
+    {
+        FeatureInstallPlanner(const PortFileProvider& port_file_provider, const StatusParagraphs& status_db);
+        ~FeatureInstallPlanner();
+
+        void add(const FeatureSpec& spec);
+        void remove(const FeatureSpec& spec);
+
+        /// <summary>
+        /// The plan for the current requests, the same as create_feature_install_plan() returns for them
+        /// </summary>
+        std::vector<AnyAction> plan() const;
+
+    private:
+        std::unique_ptr<FeatureInstallPlannerState> m_state;
+    };
 }
@@ -1,21 +1,79 @@
 #pragma once
 
+#include "Span.h"
 #include "filesystem_fs.h"
 #include "vcpkg_expected.h"
 
+#include <memory>
+
 namespace vcpkg::Files
 {
+    /// <summary>
+    /// Read-only view of the contents of a file. The view remains valid for as long as any copy of `data` is alive.
+    /// </summary>
+    struct MappedFile
+    {
+        std::shared_ptr<const char> data;
+        size_t size = 0;
+
+        span<const char> contents() const { return span<const char>(data.get(), size); }
+    };
+
+    enum class LockMode
+    {
+        SHARED,
+        EXCLUSIVE,
+    };
+
+    /// <summary>
+    /// A lock on a file which other processes can see. The lock is released when the last copy is destroyed; a
+    /// default constructed lock holds nothing.
+    /// </summary>
+    struct FileLock
+    {
+        FileLock() = default;
+        explicit FileLock(std::shared_ptr<void> handle) : m_handle(std::move(handle)) {}
+
+        bool is_held() const { return m_handle != nullptr; }
+
+    private:
+        std::shared_ptr<void> m_handle;
+    };
+
+    /// <summary>
+    /// A file or directory found by enumerating a directory, with the attributes which the enumeration reports
+    /// </summary>
+    struct DirectoryEntry
+    {
+        fs::path path;
+        fs::file_status status;
+        /// <summary>
+        /// 0 for directories
+        /// </summary>
+        std::uintmax_t size;
+        fs::file_time_type last_write_time;
+    };
+
     __interface Filesystem
     {
         virtual Expected<std::string> read_contents(const fs::path& file_path) const = 0;
+        virtual Expected<MappedFile> map_contents(const fs::path& file_path) const = 0;
         virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const = 0;
         virtual fs::path find_file_recursively_up(const fs::path& starting_dir, const std::string& filename) const = 0;
         virtual std::vector<fs::path> get_files_recursive(const fs::path& dir) const = 0;
         virtual std::vector<fs::path> get_files_non_recursive(const fs::path& dir) const = 0;
 
+        /// <summary>
+        /// Like get_files_recursive(), without a system call per entry to find out what each one is
+        /// </summary>
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const = 0;
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const = 0;
+
         virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) = 0;
         virtual void write_contents(const fs::path& file_path, const std::string& data) = 0;
+        virtual void append_contents(const fs::path& file_path, const std::string& data) = 0;
         virtual void rename(const fs::path& oldpath, const fs::path& newpath) = 0;
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) = 0;
         virtual bool remove(const fs::path& path) = 0;
         virtual bool remove(const fs::path& path, std::error_code& ec) = 0;
         virtual std::uintmax_t remove_all(const fs::path& path, std::error_code& ec) = 0;
@@ -23,20 +81,59 @@ namespace vcpkg::Files
         virtual bool is_directory(const fs::path& path) const = 0;
         virtual bool is_regular_file(const fs::path& path) const = 0;
         virtual bool is_empty(const fs::path& path) const = 0;
+        virtual std::uintmax_t file_size(const fs::path& path, std::error_code& ec) const = 0;
+        virtual fs::file_time_type last_write_time(const fs::path& path, std::error_code& ec) const = 0;
+        virtual std::uintmax_t hard_link_count(const fs::path& path, std::error_code& ec) const = 0;
         virtual bool create_directory(const fs::path& path, std::error_code& ec) = 0;
         virtual bool create_directories(const fs::path& path, std::error_code& ec) = 0;
         virtual void copy(const fs::path& oldpath, const fs::path& newpath, fs::copy_options opts) = 0;
         virtual bool copy_file(
             const fs::path& oldpath, const fs::path& newpath, fs::copy_options opts, std::error_code& ec) = 0;
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) = 0;
         virtual fs::file_status status(const fs::path& path, std::error_code& ec) const = 0;
+
+        /// <summary>
+        /// Locks the whole of a file, creating it if needed, without waiting for other processes to release it.
+        /// Returns a lock which holds nothing if another process holds a conflicting lock.
+        /// </summary>
+        virtual FileLock try_lock_file(const fs::path& path, LockMode mode) = 0;
     };
 
     Filesystem& get_real_filesystem();
 
+    /// <summary>
+    /// An empty filesystem held in memory, for tests and benchmarks which need large trees without touching the disk.
+    /// Paths compare case-insensitively, as on NTFS, and must be absolute; hard links are copies.
+    /// </summary>
+    std::shared_ptr<Filesystem> make_memory_filesystem();
+
+    /// <summary>
+    /// A memory filesystem which starts out with the contents of lower and never writes to it. Files copied from
+    /// lower are only read again when their contents are needed. lower must outlive the overlay.
+    /// </summary>
+    std::shared_ptr<Filesystem> make_overlay_filesystem(const Filesystem& lower);
+
+    /// <summary>
+    /// Waits until the lock is granted, telling the user which file it is waiting for
+    /// </summary>
+    FileLock wait_for_lock(Filesystem& fs, const fs::path& path, LockMode mode);
+
     static const char* FILESYSTEM_INVALID_CHARACTERS = R"(\/:*?"<>|)";
 
     bool has_invalid_chars_for_filesystem(const std::string& s);
 
+    /// <summary>
+    /// The part of path after its first prefix_length native characters and the separator which follows them, as
+    /// UTF-8 with forward slashes like the lines of a listfile. Only that part is converted, and only once.
+    /// </summary>
+    std::string generic_u8_suffix(const fs::path& path, const size_t prefix_length);
+
+    /// <summary>
+    /// Whether the file name of path is CONTROL or BUILD_INFO, in any case; these describe a package and are not
+    /// installed with it
+    /// </summary>
+    bool is_package_metadata_file(const fs::path& path);
+
     void print_paths(const std::vector<fs::path>& paths);
 
     std::vector<fs::path> find_from_PATH(const std::wstring& name);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "BinaryParagraph.h"
+#include "VcpkgPaths.h"
+#include "triplet.h"
+#include "vcpkg_Files.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace vcpkg::Fixtures
+{
+    /// <summary>
+    /// The shape of a synthetic vcpkg root, for scale testing the parser, the planner and the status database
+    /// </summary>
+    struct Parameters
+    {
+        size_t port_count;
+        size_t feature_count;
+        size_t dependency_depth;
+        size_t installed_file_count;
+        std::vector<Triplet> triplets;
+    };
+
+    std::string port_name(const size_t i);
+    std::string feature_name(const size_t i);
+
+    /// <summary>
+    /// The ports are split into dependency_depth layers; each port depends on two ports of the layer below it, and
+    /// each of its features on a feature of one of them, so the longest dependency chain is dependency_depth long.
+    /// </summary>
+    std::vector<std::string> get_dependencies(const Parameters& parameters, const size_t i);
+
+    std::string generate_control_file(const Parameters& parameters, const size_t i);
+    std::string generate_status_file(const Parameters& parameters);
+
+    /// <summary>
+    /// The CONTROL file of the built package: the paragraphs of the status file without their status
+    /// </summary>
+    std::string generate_package_control_file(const Parameters& parameters, const size_t i, const Triplet& triplet);
+    std::vector<std::string> generate_listfile(const Parameters& parameters, const size_t i, const Triplet& triplet);
+
+    /// <summary>
+    /// Writes a vcpkg root with a CONTROL file for every port, all of them installed with every feature for each
+    /// triplet. Anything already at root is removed first.
+    /// </summary>
+    VcpkgPaths create_root(Files::Filesystem& fs, const fs::path& root, const Parameters& parameters);
+
+    /// <summary>
+    /// Writes a vcpkg root with a CONTROL file for every port and nothing installed. Every port is built for each
+    /// triplet in packages/, with installed_file_count headers, as vcpkg build would leave it.
+    /// </summary>
+    VcpkgPaths create_prebuilt_root(Files::Filesystem& fs, const fs::path& root, const Parameters& parameters);
+
+    /// <summary>
+    /// The root the unit tests start from: a single port without features, installed for x86-windows
+    /// </summary>
+    VcpkgPaths create_small_root(Files::Filesystem& fs, const fs::path& root);
+
+    /// <summary>
+    /// Writes the package of a port without dependencies to packages/, with the given headers, as vcpkg build would
+    /// leave it, and returns its control file. The CONTROL file has no Abi field when abi is empty.
+    /// </summary>
+    BinaryControlFile write_built_package(const VcpkgPaths& paths,
+                                          const PackageSpec& spec,
+                                          const std::string& abi,
+                                          const std::map<std::string, std::string>& headers);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 
 #include "vcpkg_Chrono.h"
 #include "vcpkg_Util.h"
@@ -12,6 +13,18 @@ namespace vcpkg
         static Util::LockGuarded<ElapsedTime> timer;
         static std::atomic<bool> debugging;
         static std::atomic<bool> feature_packages;
+        static std::atomic<bool> binary_caching;
+        static std::atomic<bool> deduplicate;
+        static std::atomic<bool> timings;
+        static std::atomic<bool> trace_processes;
+        static std::atomic<bool> memstats;
+
+        /// <summary>
+        /// Whether the builds run at idle priority on the cores of background_affinity, leaving the others to
+        /// interactive work
+        /// </summary>
+        static std::atomic<bool> background;
+        static std::atomic<uint64_t> background_affinity;
 
         static std::atomic<int> g_init_console_cp;
         static std::atomic<int> g_init_console_output_cp;
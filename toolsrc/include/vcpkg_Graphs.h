@@ -1,7 +1,14 @@
 #pragma once
 
+#include "vcpkg_Checks.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+#include "vcpkg_optional.h"
+
+#include <bitset>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace vcpkg::Graphs
 {
@@ -25,135 +32,333 @@ namespace vcpkg::Graphs
         U load_vertex_data(const V& vertex) const;
     };
 
-    template<class V, class U>
-    static void topological_sort_internal(const V& vertex,
-                                          const AdjacencyProvider<V, U>& f,
-                                          std::unordered_map<V, ExplorationStatus>& exploration_status,
-                                          std::vector<U>& sorted)
+    namespace details
     {
-        ExplorationStatus& status = exploration_status[vertex];
-        switch (status)
+        template<class T>
+        std::string to_display_string(const T& vertex)
         {
-            case ExplorationStatus::FULLY_EXPLORED: return;
-            case ExplorationStatus::PARTIALLY_EXPLORED: Checks::exit_with_message(VCPKG_LINE_INFO, "cycle in graph");
-            case ExplorationStatus::NOT_EXPLORED:
+            return vertex.to_string();
+        }
+
+        inline std::string to_display_string(const std::string& vertex) { return vertex; }
+
+        /// <summary>
+        /// Exits with the cycle formed by the vertices on the exploration stack, starting with the vertex that was
+        /// reached again. Vertices are printed with their to_string().
+        /// </summary>
+        template<class Stack, class Projection>
+        [[noreturn]] void exit_with_cycle(const Stack& stack, const size_t first, Projection vertex_of)
+        {
+            std::vector<std::string> cycle;
+            for (size_t i = first; i < stack.size(); ++i)
             {
-                status = ExplorationStatus::PARTIALLY_EXPLORED;
-                U vertex_data = f.load_vertex_data(vertex);
-                for (const V& neighbour : f.adjacency_list(vertex_data))
-                    topological_sort_internal(neighbour, f, exploration_status, sorted);
-
-                sorted.push_back(std::move(vertex_data));
-                status = ExplorationStatus::FULLY_EXPLORED;
-                return;
+                cycle.push_back(to_display_string(vertex_of(stack[i])));
             }
-            default: Checks::unreachable(VCPKG_LINE_INFO);
+            cycle.push_back(to_display_string(vertex_of(stack[first])));
+
+            Checks::exit_with_message(VCPKG_LINE_INFO, "Cycle in graph: %s", Strings::join(" -> ", cycle));
         }
     }
 
+    /// <summary>
+    /// Sorts the vertices reachable from starting_vertices so that every vertex comes after its adjacent vertices.
+    /// The exploration is iterative, so deep dependency chains cannot overflow the stack.
+    /// </summary>
     template<class V, class U>
     std::vector<U> topological_sort(const std::vector<V>& starting_vertices, const AdjacencyProvider<V, U>& f)
     {
+        struct Frame
+        {
+            V vertex;
+            size_t id;
+            U vertex_data;
+            std::vector<V> neighbours;
+            size_t next_neighbour;
+        };
+
         std::vector<U> sorted;
-        std::unordered_map<V, ExplorationStatus> exploration_status;
 
-        for (auto& vertex : starting_vertices)
+        // Vertices are interned into dense ids the first time they are reached
+        std::unordered_map<V, size_t> ids;
+        std::vector<ExplorationStatus> exploration_status;
+        std::vector<Frame> stack;
+
+        const auto intern = [&](const V& vertex) {
+            const auto it = ids.emplace(vertex, exploration_status.size());
+            if (it.second) exploration_status.push_back(ExplorationStatus::NOT_EXPLORED);
+            return it.first->second;
+        };
+
+        const auto explore = [&](const V& vertex, const size_t id) {
+            exploration_status[id] = ExplorationStatus::PARTIALLY_EXPLORED;
+            U vertex_data = f.load_vertex_data(vertex);
+            std::vector<V> neighbours = f.adjacency_list(vertex_data);
+            stack.push_back(Frame{vertex, id, std::move(vertex_data), std::move(neighbours), 0});
+        };
+
+        for (const V& start : starting_vertices)
         {
-            topological_sort_internal(vertex, f, exploration_status, sorted);
+            const size_t start_id = intern(start);
+            if (exploration_status[start_id] == ExplorationStatus::FULLY_EXPLORED) continue;
+            explore(start, start_id);
+
+            while (!stack.empty())
+            {
+                Frame& top = stack.back();
+                if (top.next_neighbour == top.neighbours.size())
+                {
+                    exploration_status[top.id] = ExplorationStatus::FULLY_EXPLORED;
+                    sorted.push_back(std::move(top.vertex_data));
+                    stack.pop_back();
+                    continue;
+                }
+
+                // Copied because exploring it may reallocate the stack
+                const V neighbour = top.neighbours[top.next_neighbour++];
+                const size_t id = intern(neighbour);
+                switch (exploration_status[id])
+                {
+                    case ExplorationStatus::FULLY_EXPLORED: break;
+                    case ExplorationStatus::PARTIALLY_EXPLORED:
+                    {
+                        const auto it = Util::find_if(stack, [id](const Frame& frame) { return frame.id == id; });
+                        details::exit_with_cycle(
+                            stack, it - stack.cbegin(), [](const Frame& frame) -> const V& { return frame.vertex; });
+                    }
+                    case ExplorationStatus::NOT_EXPLORED: explore(neighbour, id); break;
+                    default: Checks::unreachable(VCPKG_LINE_INFO);
+                }
+            }
         }
 
         return sorted;
     }
 
-    template<class V>
-    struct GraphAdjacencyProvider final : AdjacencyProvider<V, V>
+    /// <summary>
+    /// A set of dense vertex ids, kept as bits in 64-bit words so that unions and intersections take a word at a time
+    /// </summary>
+    struct VertexSet
     {
-        const std::unordered_map<V, std::unordered_set<V>>& vertices;
+        VertexSet() = default;
+        explicit VertexSet(const size_t vertex_count) : words((vertex_count + 63) / 64, 0) {}
+
+        void insert(const size_t id) { this->words[id / 64] |= uint64_t(1) << (id % 64); }
+        bool contains(const size_t id) const { return (this->words[id / 64] >> (id % 64) & 1) != 0; }
+
+        VertexSet& operator|=(const VertexSet& other)
+        {
+            for (size_t i = 0; i < this->words.size(); ++i)
+                this->words[i] |= other.words[i];
+            return *this;
+        }
+
+        VertexSet& operator&=(const VertexSet& other)
+        {
+            for (size_t i = 0; i < this->words.size(); ++i)
+                this->words[i] &= other.words[i];
+            return *this;
+        }
 
-        GraphAdjacencyProvider(const std::unordered_map<V, std::unordered_set<V>>& vertices) : vertices(vertices) {}
+        bool intersects(const VertexSet& other) const
+        {
+            for (size_t i = 0; i < this->words.size(); ++i)
+                if ((this->words[i] & other.words[i]) != 0) return true;
+            return false;
+        }
 
-        std::vector<V> adjacency_list(const V& vertex) const override
+        size_t size() const
         {
-            const std::unordered_set<V>& as_set = this->vertices.at(vertex);
-            return std::vector<V>(as_set.cbegin(), as_set.cend()); // TODO: Avoid redundant copy
+            size_t count = 0;
+            for (const uint64_t word : this->words)
+                count += std::bitset<64>(word).count();
+            return count;
+        }
+
+        /// <summary>
+        /// Calls f with each id in the set, in increasing order
+        /// </summary>
+        template<class F>
+        void for_each(F f) const
+        {
+            for (size_t i = 0; i < this->words.size(); ++i)
+            {
+                size_t id = i * 64;
+                for (uint64_t word = this->words[i]; word != 0; word >>= 1, ++id)
+                {
+                    if ((word & 1) != 0) f(id);
+                }
+            }
         }
 
-        V load_vertex_data(const V& vertex) const override { return vertex; }
+        std::vector<uint64_t> words;
     };
 
+    /// <summary>
+    /// For each vertex, the vertices which reach it, given what each vertex reaches
+    /// </summary>
+    inline std::vector<VertexSet> transpose(const std::vector<VertexSet>& reachable)
+    {
+        std::vector<VertexSet> reached_from(reachable.size(), VertexSet(reachable.size()));
+        for (size_t from = 0; from < reachable.size(); ++from)
+        {
+            reachable[from].for_each([&](const size_t to) { reached_from[to].insert(from); });
+        }
+        return reached_from;
+    }
+
+    /// <summary>
+    /// A directed graph whose vertices are interned into dense ids in insertion order
+    /// </summary>
     template<class V>
     struct Graph
     {
     public:
-        void add_vertex(V v) { this->vertices[v]; }
+        void add_vertex(V v) { this->intern(v); }
 
-        // TODO: Change with iterators
         void add_vertices(const std::vector<V>& vs)
         {
             for (const V& v : vs)
             {
-                this->vertices[v];
+                this->intern(v);
             }
         }
 
         void add_edge(V u, V v)
         {
-            this->vertices[v];
-            this->vertices[u].insert(v);
+            const size_t from = this->intern(u);
+            const size_t to = this->intern(v);
+            this->edges.emplace_back(from, to);
         }
 
+        /// <summary>
+        /// Sorts all vertices so that every vertex comes after the targets of its edges
+        /// </summary>
         std::vector<V> topological_sort() const
         {
-            GraphAdjacencyProvider<V> adjacency_provider{this->vertices};
-            std::unordered_map<V, int> indegrees = count_indegrees();
-
-            std::vector<V> sorted;
-            sorted.reserve(indegrees.size());
+            return Util::fmap(this->sorted_ids(), [this](const size_t id) { return this->vertices[id]; });
+        }
 
-            std::unordered_map<V, ExplorationStatus> exploration_status;
-            exploration_status.reserve(indegrees.size());
+        /// <summary>
+        /// For each vertex id, the ids of the vertices it reaches through one or more edges
+        /// </summary>
+        std::vector<VertexSet> transitive_closure() const
+        {
+            const size_t vertex_count = this->vertices.size();
+            std::vector<VertexSet> reachable(vertex_count, VertexSet(vertex_count));
 
-            for (auto& pair : indegrees)
+            // The targets of every edge are complete by the time the vertex is reached in sorted order
+            std::vector<std::vector<size_t>> targets(vertex_count);
+            for (auto&& edge : this->edges)
             {
-                if (pair.second == 0) // Starting from vertices with indegree == 0. Not required.
+                targets[edge.first].push_back(edge.second);
+            }
+            for (const size_t id : this->sorted_ids())
+            {
+                for (const size_t target : targets[id])
                 {
-                    V vertex = pair.first;
-                    topological_sort_internal(vertex, adjacency_provider, exploration_status, sorted);
+                    reachable[id].insert(target);
+                    reachable[id] |= reachable[target];
                 }
             }
+            return reachable;
+        }
 
-            return sorted;
+        size_t vertex_count() const { return this->vertices.size(); }
+
+        const V& vertex(const size_t id) const { return this->vertices[id]; }
+
+        Optional<size_t> id_of(const V& v) const
+        {
+            const auto it = this->ids.find(v);
+            if (it == this->ids.cend()) return nullopt;
+            return it->second;
         }
 
-        std::unordered_map<V, int> count_indegrees() const
+        const std::vector<V>& vertex_list() const { return this->vertices; }
+
+    private:
+        std::vector<size_t> sorted_ids() const
         {
-            std::unordered_map<V, int> indegrees;
+            const size_t vertex_count = this->vertices.size();
 
-            for (auto& pair : this->vertices)
+            // Compressed sparse rows: the targets of the edges from vertex i are targets[offsets[i], offsets[i + 1])
+            std::vector<size_t> offsets(vertex_count + 1, 0);
+            for (auto&& edge : this->edges)
             {
-                indegrees[pair.first];
-                for (V neighbour : pair.second)
+                ++offsets[edge.first + 1];
+            }
+            for (size_t i = 0; i < vertex_count; ++i)
+            {
+                offsets[i + 1] += offsets[i];
+            }
+
+            std::vector<size_t> targets(this->edges.size());
+            std::vector<size_t> next_target(offsets.cbegin(), offsets.cend() - 1);
+            for (auto&& edge : this->edges)
+            {
+                targets[next_target[edge.first]++] = edge.second;
+            }
+
+            std::vector<size_t> sorted;
+            sorted.reserve(vertex_count);
+
+            std::vector<ExplorationStatus> exploration_status(vertex_count, ExplorationStatus::NOT_EXPLORED);
+
+            // Each entry is a vertex and the position of its next unexplored edge in targets
+            std::vector<std::pair<size_t, size_t>> stack;
+
+            for (size_t start = 0; start < vertex_count; ++start)
+            {
+                if (exploration_status[start] != ExplorationStatus::NOT_EXPLORED) continue;
+
+                exploration_status[start] = ExplorationStatus::PARTIALLY_EXPLORED;
+                stack.emplace_back(start, offsets[start]);
+
+                while (!stack.empty())
                 {
-                    ++indegrees[neighbour];
+                    auto& top = stack.back();
+                    if (top.second == offsets[top.first + 1])
+                    {
+                        exploration_status[top.first] = ExplorationStatus::FULLY_EXPLORED;
+                        sorted.push_back(top.first);
+                        stack.pop_back();
+                        continue;
+                    }
+
+                    const size_t neighbour = targets[top.second++];
+                    switch (exploration_status[neighbour])
+                    {
+                        case ExplorationStatus::FULLY_EXPLORED: break;
+                        case ExplorationStatus::PARTIALLY_EXPLORED:
+                        {
+                            const auto it = Util::find_if(stack, [neighbour](auto&& entry) {
+                                return entry.first == neighbour;
+                            });
+                            details::exit_with_cycle(stack, it - stack.cbegin(), [this](auto&& entry) -> const V& {
+                                return this->vertices[entry.first];
+                            });
+                        }
+                        case ExplorationStatus::NOT_EXPLORED:
+                            exploration_status[neighbour] = ExplorationStatus::PARTIALLY_EXPLORED;
+                            stack.emplace_back(neighbour, offsets[neighbour]);
+                            break;
+                        default: Checks::unreachable(VCPKG_LINE_INFO);
+                    }
                 }
             }
 
-            return indegrees;
+            return sorted;
         }
 
-        const std::unordered_map<V, std::unordered_set<V>>& adjacency_list() const { return this->vertices; }
-        std::vector<V> vertex_list() const
+        size_t intern(const V& v)
         {
-            // why no &? it returns 0
-            std::vector<V> vertex_list;
-            for (const auto& vertex : this->vertices)
-            {
-                vertex_list.emplace_back(vertex.first);
-            }
-            return vertex_list;
+            const auto it = this->ids.emplace(v, this->vertices.size());
+            if (it.second) this->vertices.push_back(v);
+            return it.first->second;
         }
 
-    private:
-        std::unordered_map<V, std::unordered_set<V>> vertices;
+        std::vector<V> vertices;
+        std::unordered_map<V, size_t> ids;
+        std::vector<std::pair<size_t, size_t>> edges;
     };
 }
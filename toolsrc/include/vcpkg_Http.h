@@ -0,0 +1,80 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Util.h"
+#include "vcpkg_optional.h"
+
+#include <Windows.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <winhttp.h>
+
+namespace vcpkg::Http
+{
+    struct ParsedUrl
+    {
+        std::wstring host;
+        INTERNET_PORT port;
+        std::wstring path;
+        bool secure;
+    };
+
+    Optional<ParsedUrl> parse_url(const std::string& url);
+
+    struct Request : Util::ResourceBase
+    {
+        Request() = default;
+        ~Request();
+
+        HINTERNET connect = nullptr;
+        HINTERNET request = nullptr;
+        DWORD status_code = 0;
+    };
+
+    /// <summary>
+    /// Sends the request and waits for the response headers; null if the server could not be reached
+    /// </summary>
+    std::unique_ptr<Request> send_request(const HINTERNET session,
+                                          const ParsedUrl& url,
+                                          const wchar_t* verb,
+                                          const std::wstring& headers);
+
+    /// <summary>
+    /// Sends body with the request and waits for the response headers; null if the server could not be reached
+    /// </summary>
+    std::unique_ptr<Request> send_data(const HINTERNET session,
+                                       const ParsedUrl& url,
+                                       const wchar_t* verb,
+                                       const std::wstring& headers,
+                                       const std::string& body);
+
+    /// <summary>
+    /// Sends the contents of the file as the body of the request and waits for the response headers; null if the
+    /// file could not be read or the server could not be reached
+    /// </summary>
+    std::unique_ptr<Request> send_file(const HINTERNET session,
+                                       const ParsedUrl& url,
+                                       const wchar_t* verb,
+                                       const std::wstring& headers,
+                                       const fs::path& file);
+
+    Optional<std::wstring> query_header(const HINTERNET request, const DWORD info_level);
+
+    /// <summary>
+    /// Passes the body of the response to on_data as it arrives; false if the connection failed before the end
+    /// </summary>
+    template<class Func>
+    bool read_body(const HINTERNET request, Func&& on_data)
+    {
+        std::vector<char> buffer(64 * 1024);
+        for (;;)
+        {
+            DWORD bytes_read = 0;
+            if (!WinHttpReadData(request, buffer.data(), static_cast<DWORD>(buffer.size()), &bytes_read)) return false;
+            if (bytes_read == 0) return true;
+            if (!on_data(buffer.data(), static_cast<size_t>(bytes_read))) return false;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_optional.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::Listfile
+{
+    /// <summary>
+    /// A line of a listfile
+    /// </summary>
+    struct Entry
+    {
+        /// <summary>
+        /// Relative to installed, without the trailing slash which marks a directory in the text listfile
+        /// </summary>
+        std::string path;
+        bool is_directory;
+
+        /// <summary>
+        /// The size of a file, if it was known when the file was installed
+        /// </summary>
+        Optional<uint64_t> size;
+
+        /// <summary>
+        /// The line of the text listfile
+        /// </summary>
+        std::string to_line() const { return is_directory ? path + '/' : path; }
+    };
+
+    /// <summary>
+    /// The compact form of a listfile, viewed in place. The entries are sorted like the lines of the text listfile
+    /// and front coded: each stores how much of the previous path it shares, except for a full path every few
+    /// entries, which a lookup binary searches before decoding the entries up to the next one.
+    /// </summary>
+    struct BinaryListfile
+    {
+        static Optional<BinaryListfile> parse(Files::MappedFile file);
+
+        /// <summary>
+        /// The entries must be sorted by their lines
+        /// </summary>
+        static std::string serialize(const std::vector<Entry>& sorted_entries, const std::string& stamp);
+
+        /// <summary>
+        /// The stamp of the text listfile this was built from
+        /// </summary>
+        const std::string& stamp() const { return m_stamp; }
+
+        size_t size() const { return m_entry_count; }
+
+        /// <summary>
+        /// Decodes every entry; nullopt if the file is damaged
+        /// </summary>
+        Optional<std::vector<Entry>> entries() const;
+
+        /// <summary>
+        /// Whether the listfile has the line, which ends with a slash for a directory
+        /// </summary>
+        bool contains(const std::string& line) const;
+
+    private:
+        Files::MappedFile m_file;
+        std::string m_stamp;
+        size_t m_entry_count = 0;
+        size_t m_restart_count = 0;
+        const char* m_restarts = nullptr;
+        const char* m_data = nullptr;
+    };
+
+    /// <summary>
+    /// The size and modification time of a file, which change whenever it is rewritten; empty if it does not exist
+    /// </summary>
+    std::string get_stamp(const Files::Filesystem& fs, const fs::path& path);
+
+    /// <summary>
+    /// Where the binary form of the text listfile is kept
+    /// </summary>
+    fs::path binary_listfile_path(const fs::path& listfile_path);
+
+    /// <summary>
+    /// Sorts the entries and writes both forms of the listfile
+    /// </summary>
+    void write(Files::Filesystem& fs, const fs::path& listfile_path, std::vector<Entry> entries);
+
+    /// <summary>
+    /// Reads the binary form of the listfile if it was built from the current text listfile; nullopt otherwise
+    /// </summary>
+    Optional<std::vector<Entry>> try_read_binary(const Files::Filesystem& fs, const fs::path& listfile_path);
+
+    /// <summary>
+    /// Writes the binary form of the entries of the current text listfile, so that the next read can skip parsing
+    /// the text. Several processes may do this at once.
+    /// </summary>
+    void write_binary(Files::Filesystem& fs, const fs::path& listfile_path, std::vector<Entry> entries);
+}
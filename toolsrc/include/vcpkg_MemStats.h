@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+/// <summary>
+/// Counts what the global operator new allocates, for --x-memstats. The counters always run; the flag only decides
+/// whether they are reported.
+/// </summary>
+namespace vcpkg::MemStats
+{
+    struct Counters
+    {
+        uint64_t allocations = 0;
+        uint64_t allocated_bytes = 0;
+    };
+
+    /// <summary>
+    /// Everything allocated since the process started, including what was freed again
+    /// </summary>
+    Counters get_counters();
+
+    /// <summary>
+    /// The most the heap held at once
+    /// </summary>
+    uint64_t get_peak_heap_bytes();
+
+    /// <summary>
+    /// The most physical memory the process used at once, including what is not on the heap
+    /// </summary>
+    uint64_t get_peak_working_set_bytes();
+}
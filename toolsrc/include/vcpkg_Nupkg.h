@@ -0,0 +1,34 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Zip.h"
+#include "vcpkg_expected.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::Nupkg
+{
+    struct Metadata
+    {
+        std::string id;
+        std::string version;
+        std::string description;
+    };
+
+    /// <summary>
+    /// The name of a file in a package, percent-encoded as Open Packaging Conventions part names are
+    /// </summary>
+    std::string encode_part_name(const std::string& name);
+
+    /// <summary>
+    /// Writes a NuGet package of the files, whose names are paths in the package separated by forward slashes. The
+    /// manifest and the parts which the Open Packaging Conventions require are added, so nuget.exe is not needed.
+    /// Returns the size of the package.
+    /// </summary>
+    ExpectedT<uint64_t, std::string> write(const Files::Filesystem& fs,
+                                           const fs::path& nupkg,
+                                           const Metadata& metadata,
+                                           std::vector<Zip::Entry> files);
+}
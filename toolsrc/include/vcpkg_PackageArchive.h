@@ -0,0 +1,64 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_expected.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::PackageArchive
+{
+    /// <summary>
+    /// A file or directory of a package archive
+    /// </summary>
+    struct Entry
+    {
+        /// <summary>
+        /// Relative to the packages directory, separated by forward slashes
+        /// </summary>
+        std::string path;
+        bool is_directory;
+        uint64_t size;
+
+        /// <summary>
+        /// The SHA256 of the contents as lowercase hexadecimal; empty for directories
+        /// </summary>
+        std::string sha256;
+    };
+
+    /// <summary>
+    /// Writes the contents of a packages directory to a single file: a table of every entry, then the contents of
+    /// the files in the order of the table. The table comes first so that an archive can be listed from its start
+    /// and extracted as it is read; see vcpkg_PackageArchive.cpp for the layout. Returns the table.
+    /// </summary>
+    ExpectedT<std::vector<Entry>, std::string> create(Files::Filesystem& fs,
+                                                      const fs::path& dir,
+                                                      const fs::path& archive);
+
+    /// <summary>
+    /// Writes the files, which are named in the archive by their file names, in the same layout
+    /// </summary>
+    ExpectedT<std::vector<Entry>, std::string> create(Files::Filesystem& fs,
+                                                      const std::vector<fs::path>& files,
+                                                      const fs::path& archive);
+
+    /// <summary>
+    /// Reads the table at the start of the archive without touching the contents
+    /// </summary>
+    ExpectedT<std::vector<Entry>, std::string> read_table(const fs::path& archive);
+
+    /// <summary>
+    /// Recreates the packages directory in dir, checking the size and the hash of every file. On failure dir may hold
+    /// part of the package.
+    /// </summary>
+    ExpectedT<std::vector<Entry>, std::string> extract(Files::Filesystem& fs,
+                                                       const fs::path& archive,
+                                                       const fs::path& dir);
+
+    /// <summary>
+    /// Reads the contents of a single file of the archive, checking its hash; the files before it are skipped without
+    /// being decompressed
+    /// </summary>
+    ExpectedT<std::string, std::string> read_file(const fs::path& archive, const std::string& path);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <memory>
+#include <string_view>
 #include <unordered_map>
 
 #include "vcpkg_expected.h"
@@ -21,16 +23,138 @@ namespace vcpkg::Parse
 
     using RawParagraph = std::unordered_map<std::string, std::string>;
 
+    /// <summary>
+    /// A paragraph whose field names and values point into a buffer owned by someone else. Values are kept exactly as
+    /// they appear in the buffer; normalize_field_value() converts them to the form stored in a RawParagraph.
+    /// </summary>
+    struct ParagraphView
+    {
+        struct Field
+        {
+            std::string_view name;
+            std::string_view value;
+        };
+
+        std::vector<Field> fields;
+    };
+
+    std::string normalize_field_value(const std::string_view raw_value);
+
+    ParagraphView to_paragraph_view(const RawParagraph& fields);
+    RawParagraph to_raw_paragraph(const ParagraphView& view);
+
+    /// <summary>
+    /// The names of the fields which a kind of paragraph has, fixed at compile time. Names are found with a perfect
+    /// hash whose seed is searched for when the table is built, so a lookup hashes the name once and compares it with
+    /// a single candidate.
+    /// </summary>
+    class FieldTable
+    {
+    public:
+        static constexpr size_t MAX_FIELDS = 16;
+        static constexpr size_t NOT_FOUND = MAX_FIELDS;
+
+        template<size_t N>
+        constexpr explicit FieldTable(const std::string_view (&names)[N]) : m_size(N)
+        {
+            static_assert(N <= MAX_FIELDS, "A field table holds at most MAX_FIELDS names");
+            for (size_t i = 0; i < N; ++i)
+                m_names[i] = names[i];
+
+            for (uint32_t seed = 0; seed < MAX_SEEDS; ++seed)
+            {
+                if (try_seed(seed))
+                {
+                    m_seed = seed;
+                    return;
+                }
+            }
+
+            // Every name is still found, by comparing it with each one
+            m_seed = MAX_SEEDS;
+        }
+
+        constexpr size_t size() const { return m_size; }
+
+        constexpr std::string_view name(const size_t slot) const { return m_names[slot]; }
+
+        /// <summary>
+        /// The slot of the field, or NOT_FOUND if the table does not have it
+        /// </summary>
+        constexpr size_t find(const std::string_view name) const
+        {
+            if (m_seed == MAX_SEEDS)
+            {
+                for (size_t slot = 0; slot < m_size; ++slot)
+                {
+                    if (m_names[slot] == name) return slot;
+                }
+                return NOT_FOUND;
+            }
+
+            const size_t candidate = m_buckets[bucket_of(name, m_seed)];
+            return candidate != NOT_FOUND && m_names[candidate] == name ? candidate : NOT_FOUND;
+        }
+
+    private:
+        static constexpr size_t BUCKETS = 4 * MAX_FIELDS;
+        static constexpr uint32_t MAX_SEEDS = 4096;
+
+        // FNV-1a, starting from the seed
+        static constexpr size_t bucket_of(const std::string_view name, const uint32_t seed)
+        {
+            uint32_t value = 2166136261u ^ (seed * 16777619u);
+            for (const char c : name)
+            {
+                value ^= static_cast<unsigned char>(c);
+                value *= 16777619u;
+            }
+            return (value ^ (value >> 16)) % BUCKETS;
+        }
+
+        constexpr bool try_seed(const uint32_t seed)
+        {
+            for (auto&& bucket : m_buckets)
+                bucket = NOT_FOUND;
+
+            for (size_t slot = 0; slot < m_size; ++slot)
+            {
+                size_t& bucket = m_buckets[bucket_of(m_names[slot], seed)];
+                if (bucket != NOT_FOUND) return false;
+                bucket = slot;
+            }
+            return true;
+        }
+
+        std::array<std::string_view, MAX_FIELDS> m_names{};
+        std::array<size_t, BUCKETS> m_buckets{};
+        size_t m_size;
+        uint32_t m_seed = 0;
+    };
+
     struct ParagraphParser
     {
-        ParagraphParser(RawParagraph&& fields) : fields(std::move(fields)) {}
+        explicit ParagraphParser(const ParagraphView& view) : fields(view.fields) {}
+        ParagraphParser(const RawParagraph& fields) : ParagraphParser(to_paragraph_view(fields)) {}
 
-        void required_field(const std::string& fieldname, std::string& out);
-        std::string optional_field(const std::string& fieldname) const;
+        /// <summary>
+        /// Puts each field of the table in its slot as the paragraph is read; only the fields which the table does not
+        /// have are searched for by name
+        /// </summary>
+        ParagraphParser(const ParagraphView& view, const FieldTable& table);
+
+        void required_field(const std::string_view fieldname, std::string& out);
+        std::string optional_field(const std::string_view fieldname);
         std::unique_ptr<ParseControlErrorInfo> error_info(const std::string& name) const;
 
     private:
-        RawParagraph&& fields;
+        Optional<std::string> remove_field(const std::string_view fieldname);
+
+        const FieldTable* table = nullptr;
+        std::array<const ParagraphView::Field*, FieldTable::MAX_FIELDS> slots{};
+
+        // The fields which are not in the table, or every field when there is no table
+        std::vector<ParagraphView::Field> fields;
         std::vector<std::string> missing_fields;
     };
 
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Paragraphs.h"
+#include "VcpkgPaths.h"
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_optional.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// The raw CONTROL paragraphs of all ports, in a file which is used where it is mapped instead of being read:
+///     header          magic, version and the number of records in each table below
+///     seeds           one per bucket of the minimal perfect hash over the port names
+///     slots           the port record of each value of the hash
+///     ports           name, stamp and range of paragraphs; the first paragraph is the core, the others the features
+///     paragraphs      range of fields
+///     fields          name and value
+///     strings         the pool which the names, stamps and values are offsets into
+/// Every number is 32-bit little-endian, and every string is an offset into the pool followed by its size.
+/// </summary>
+namespace vcpkg::PortIndex
+{
+    fs::path get_index_path(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// The size and modification time of a CONTROL file, or empty when it cannot be read
+    /// </summary>
+    std::string get_control_file_stamp(const Files::Filesystem& fs, const fs::path& control_path);
+
+    struct PortEntry
+    {
+        std::string name;
+        std::string stamp;
+        Paragraphs::ParagraphViews paragraphs;
+    };
+
+    /// <summary>
+    /// The bytes of the index of the ports, whose names must be unique. nullopt if the index would not fit in 4 GiB.
+    /// </summary>
+    Optional<std::string> serialize(const std::vector<PortEntry>& ports);
+
+    /// <summary>
+    /// Replaces the index through a temporary file, so a concurrent or interrupted invocation never sees half of it
+    /// </summary>
+    void write(Files::Filesystem& fs, const fs::path& index_path, const std::string& bytes);
+
+    struct Table
+    {
+        /// <summary>
+        /// Empty when the file is missing, damaged, or was written for another version of the index
+        /// </summary>
+        static Table load(const Files::Filesystem& fs, const fs::path& index_path);
+        static Table from_file(Files::MappedFile file);
+
+        struct Entry
+        {
+            std::string_view stamp;
+            Paragraphs::ParagraphViews paragraphs;
+        };
+
+        /// <summary>
+        /// Looks the port up through the hash, without reading the records of any other port. The views share the
+        /// mapping of the file, so they remain valid after the table is gone.
+        /// </summary>
+        Optional<Entry> find(std::string_view name) const;
+
+        size_t size() const { return m_port_count; }
+
+    private:
+        const char* at(size_t offset) const { return m_file.data.get() + offset; }
+        bool string_at(const char* ref, std::string_view& out) const;
+
+        Files::MappedFile m_file;
+        uint32_t m_port_count = 0;
+        uint32_t m_bucket_count = 0;
+        uint32_t m_paragraph_count = 0;
+        uint32_t m_field_count = 0;
+        uint32_t m_strings_size = 0;
+        size_t m_seeds = 0;
+        size_t m_slots = 0;
+        size_t m_ports = 0;
+        size_t m_paragraphs = 0;
+        size_t m_fields = 0;
+        size_t m_strings = 0;
+    };
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CStringView.h"
+#include "VcpkgCmdArguments.h"
+#include "vcpkg_optional.h"
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace vcpkg
+{
+    static const std::string OPTION_FORMAT = "--format";
+
+    /// <summary>
+    /// Prints records for other programs to read as they are produced: with --format=json an array of objects, and
+    /// with --format=tsv a line of column names followed by one line per record, in which tabs and line breaks are
+    /// replaced by spaces. The output is collected and written in large chunks rather than line by line.
+    /// </summary>
+    struct RecordWriter
+    {
+        enum class Format
+        {
+            JSON,
+            TSV
+        };
+
+        /// <summary>
+        /// nullopt when --format was not passed; exits when it names another format
+        /// </summary>
+        static Optional<Format> get_format(const ParsedArguments& parsed_arguments);
+
+        RecordWriter(const Format format, std::vector<std::string> columns);
+
+        /// <summary>
+        /// Takes one value for each column
+        /// </summary>
+        void write(std::initializer_list<CStringView> values);
+
+        /// <summary>
+        /// Ends the output and writes what is still collected. Exiting skips the destructors, so this must come first.
+        /// </summary>
+        void finish();
+
+    private:
+        void flush_if_full();
+
+        Format m_format;
+        std::vector<std::string> m_columns;
+        std::string m_buffer;
+        size_t m_record_count = 0;
+    };
+}
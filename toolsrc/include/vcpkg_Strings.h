@@ -3,6 +3,14 @@
 #include "CStringView.h"
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <sal.h>
+// Lets /analyze check the arguments which format() converts and passes on to append_format_internal()
+#define VCPKG_PRINTF_FORMAT_STRING _Printf_format_string_
+#else
+#define VCPKG_PRINTF_FORMAT_STRING
+#endif
+
 namespace vcpkg::Strings::details
 {
     template<class T>
@@ -25,13 +33,13 @@ namespace vcpkg::Strings::details
 
     inline double to_printf_arg(const double s) { return s; }
 
-    std::string format_internal(const char* fmtstr, ...);
+    void append_format_internal(std::string& output, VCPKG_PRINTF_FORMAT_STRING const char* fmtstr, ...);
 
     inline const wchar_t* to_wprintf_arg(const std::wstring& s) { return s.c_str(); }
 
     inline const wchar_t* to_wprintf_arg(const wchar_t* s) { return s; }
 
-    std::wstring wformat_internal(const wchar_t* fmtstr, ...);
+    void append_wformat_internal(std::wstring& output, VCPKG_PRINTF_FORMAT_STRING const wchar_t* fmtstr, ...);
 }
 
 namespace vcpkg::Strings
@@ -39,24 +47,64 @@ namespace vcpkg::Strings
     static constexpr const char* EMPTY = "";
     static constexpr const wchar_t* WEMPTY = L"";
 
+    /// <summary>
+    /// Formats onto the end of output, in place, so that a buffer which is reused allocates nothing
+    /// </summary>
     template<class... Args>
-    std::string format(const char* fmtstr, const Args&... args)
+    void append_format(std::string& output, const char* fmtstr, const Args&... args)
     {
         using vcpkg::Strings::details::to_printf_arg;
-        return details::format_internal(fmtstr, to_printf_arg(to_printf_arg(args))...);
+        details::append_format_internal(output, fmtstr, to_printf_arg(to_printf_arg(args))...);
     }
 
     template<class... Args>
-    std::wstring wformat(const wchar_t* fmtstr, const Args&... args)
+    void append_wformat(std::wstring& output, const wchar_t* fmtstr, const Args&... args)
     {
         using vcpkg::Strings::details::to_wprintf_arg;
-        return details::wformat_internal(fmtstr, to_wprintf_arg(to_wprintf_arg(args))...);
+        details::append_wformat_internal(output, fmtstr, to_wprintf_arg(to_wprintf_arg(args))...);
+    }
+
+    template<class... Args>
+    std::string format(const char* fmtstr, const Args&... args)
+    {
+        std::string output;
+        append_format(output, fmtstr, args...);
+        return output;
+    }
+
+    template<class... Args>
+    std::wstring wformat(const wchar_t* fmtstr, const Args&... args)
+    {
+        std::wstring output;
+        append_wformat(output, fmtstr, args...);
+        return output;
     }
 
     std::wstring to_utf16(const CStringView s);
 
     std::string to_utf8(const CWStringView w);
 
+    /// <summary>
+    /// Finds one pattern in any number of strings, ignoring the case of ASCII letters. The pattern is prepared once,
+    /// and where SSE2 is available the strings are scanned 16 bytes at a time for its first and last characters.
+    /// </summary>
+    struct CaseInsensitiveAsciiSearcher
+    {
+        explicit CaseInsensitiveAsciiSearcher(const std::string& pattern);
+
+        /// <summary>
+        /// The offset of the first match in the size characters at s, or std::string::npos
+        /// </summary>
+        size_t find(const char* s, const size_t size) const;
+        size_t find(const std::string& s) const { return find(s.data(), s.size()); }
+        bool contains(const std::string& s) const { return find(s) != std::string::npos; }
+
+    private:
+        bool matches_at(const char* s) const;
+
+        std::string m_lowercase_pattern;
+    };
+
     std::string::const_iterator case_insensitive_ascii_find(const std::string& s, const std::string& pattern);
 
     bool case_insensitive_ascii_contains(const std::string& s, const std::string& pattern);
@@ -65,6 +113,16 @@ namespace vcpkg::Strings
 
     std::string ascii_to_lowercase(const std::string& input);
 
+    /// <summary>
+    /// Quotes and escapes s as a JSON string literal
+    /// </summary>
+    std::string to_json_string(const std::string& s);
+
+    /// <summary>
+    /// Appends s to output as to_json_string() would return it, without allocating a string for it
+    /// </summary>
+    void append_json_string(std::string& output, const CStringView s);
+
     template<class Container, class Transformer, class CharType>
     std::basic_string<CharType> join(const CharType* delimiter, const Container& v, Transformer transformer)
     {
@@ -99,6 +157,16 @@ namespace vcpkg::Strings
 
     void trim_all_and_remove_whitespace_strings(std::vector<std::string>* strings);
 
+    /// <summary>
+    /// Replaces every run of whitespace with a single space
+    /// </summary>
+    std::string collapse_whitespace(const std::string& s);
+
+    /// <summary>
+    /// Replaces every occurrence of the non-empty string search with rep
+    /// </summary>
+    std::string replace_all(std::string&& s, const std::string& search, const std::string& rep);
+
     std::vector<std::string> split(const std::string& s, const std::string& delimiter);
 
     template<class T>
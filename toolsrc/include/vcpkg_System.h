@@ -2,8 +2,14 @@
 
 #include "filesystem_fs.h"
 #include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+#include "vcpkg_expected.h"
 #include "vcpkg_optional.h"
 #include <Windows.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 namespace vcpkg::System
 {
@@ -17,7 +23,125 @@ namespace vcpkg::System
         std::string output;
     };
 
-    int cmd_execute_clean(const CWStringView cmd_line);
+    /// <summary>
+    /// The environment block in which cmd_execute_clean() runs commands: a fixed set of variables from the current
+    /// environment and a minimal Path.
+    /// </summary>
+    std::wstring get_clean_environment();
+
+    /// <summary>
+    /// What the processes of a job object used together, including the ones which already exited
+    /// </summary>
+    struct ResourceUsage
+    {
+        /// <summary>User and kernel time of all processes</summary>
+        double cpu_microseconds = 0;
+        /// <summary>The most memory which the processes had committed at once</summary>
+        uint64_t peak_memory_bytes = 0;
+        uint64_t read_bytes = 0;
+        uint64_t write_bytes = 0;
+        uint32_t process_count = 0;
+    };
+
+    std::string to_string(const ResourceUsage& usage);
+
+    /// <summary>
+    /// A Windows job object. Every process which a process launched in it starts is in it as well, so it accounts for
+    /// the resources of a whole tree of processes. Closing it leaves the processes running.
+    /// </summary>
+    struct JobObject
+    {
+        static Expected<JobObject> create();
+
+        JobObject() = default;
+        JobObject(JobObject&& other) noexcept;
+        JobObject& operator=(JobObject&& other) noexcept;
+        JobObject(const JobObject&) = delete;
+        JobObject& operator=(const JobObject&) = delete;
+        ~JobObject();
+
+        ResourceUsage query() const;
+
+        /// <summary>
+        /// Runs every process of the job at idle priority and only on the cores of the affinity mask, whatever
+        /// priority the processes ask for. Returns false if the limits could not be set.
+        /// </summary>
+        bool set_background(const uint64_t affinity_mask);
+
+    private:
+        friend struct Process;
+        HANDLE m_job = nullptr;
+    };
+
+    /// <summary>
+    /// A process launched directly with CreateProcessW, without an intermediate cmd.exe
+    /// </summary>
+    struct Process
+    {
+        /// <summary>
+        /// Receives the merged standard output and standard error of the process as it arrives. It is called on a
+        /// separate thread, and the chunks are not split on line boundaries.
+        /// </summary>
+        using OutputCallback = std::function<void(const char* data, size_t size)>;
+
+        /// <summary>
+        /// Launches the command line. An empty environment block inherits the environment of vcpkg. Without an
+        /// output callback the process writes directly to the console. With a job, the process is in the job before it
+        /// runs, so none of the processes it starts escape it.
+        /// </summary>
+        static Expected<Process> start(const CWStringView cmd_line,
+                                       const std::wstring& environment_block,
+                                       OutputCallback on_output = nullptr,
+                                       const JobObject* job = nullptr);
+
+        Process() = default;
+        Process(Process&& other) noexcept;
+        Process& operator=(Process&& other) noexcept;
+        Process(const Process&) = delete;
+        Process& operator=(const Process&) = delete;
+        ~Process();
+
+        /// <summary>
+        /// Waits for the process to exit and for all of its output to be delivered, and returns its exit code
+        /// </summary>
+        int wait();
+
+        /// <summary>
+        /// Returns the exit code if the process has exited, or nullopt if it is still running
+        /// </summary>
+        Optional<int> try_wait();
+
+    private:
+        HANDLE m_process = nullptr;
+        std::thread m_output_reader;
+        int m_exit_code = 0;
+
+        // Only kept while processes are traced
+        std::string m_traced_cmd_line;
+        double m_start_us = 0;
+        std::shared_ptr<size_t> m_output_bytes;
+    };
+
+    int cmd_execute_clean(const CWStringView cmd_line, const JobObject* job = nullptr);
+
+    /// <summary>
+    /// Launches the command line directly, without cmd.exe, with the given environment block
+    /// </summary>
+    int execute_with_environment(const CWStringView cmd_line,
+                                 const std::wstring& environment_block,
+                                 const JobObject* job = nullptr);
+
+    /// <summary>
+    /// Runs the command with the clean environment and returns the environment block it leaves behind, or nullopt if
+    /// it fails. This is how the environment set up by a batch file such as vcvarsall.bat is captured.
+    /// </summary>
+    Optional<std::wstring> get_environment_after(const CWStringView cmd_line);
+
+    /// <summary>
+    /// Launches the command line directly, without a console, and does not wait for it. The process keeps running
+    /// after vcpkg exits. Returns false if it could not be started.
+    /// </summary>
+    bool start_detached(const CWStringView cmd_line);
 
     int cmd_execute(const CWStringView cmd_line);
 
@@ -38,30 +162,99 @@ namespace vcpkg::System
     void print(const Color c, const CStringView message);
     void println(const Color c, const CStringView message);
 
+    namespace details
+    {
+        /// <summary>
+        /// The buffer of the calling thread which the formatting overloads below reuse for every message
+        /// </summary>
+        std::string& message_buffer();
+
+        template<class... Args>
+        const std::string& format_message(const bool newline, const char* messageTemplate, const Args&... messageArgs)
+        {
+            std::string& buffer = message_buffer();
+            buffer.clear();
+            Strings::append_format(buffer, messageTemplate, messageArgs...);
+            if (newline) buffer.push_back('\n');
+            return buffer;
+        }
+    }
+
     template<class Arg1, class... Args>
     void print(const char* messageTemplate, const Arg1& messageArg1, const Args&... messageArgs)
     {
-        return System::print(Strings::format(messageTemplate, messageArg1, messageArgs...));
+        return System::print(details::format_message(false, messageTemplate, messageArg1, messageArgs...));
     }
 
     template<class Arg1, class... Args>
     void print(const Color c, const char* messageTemplate, const Arg1& messageArg1, const Args&... messageArgs)
     {
-        return System::print(c, Strings::format(messageTemplate, messageArg1, messageArgs...));
+        return System::print(c, details::format_message(false, messageTemplate, messageArg1, messageArgs...));
     }
 
     template<class Arg1, class... Args>
     void println(const char* messageTemplate, const Arg1& messageArg1, const Args&... messageArgs)
     {
-        return System::println(Strings::format(messageTemplate, messageArg1, messageArgs...));
+        return System::print(details::format_message(true, messageTemplate, messageArg1, messageArgs...));
     }
 
     template<class Arg1, class... Args>
     void println(const Color c, const char* messageTemplate, const Arg1& messageArg1, const Args&... messageArgs)
     {
-        return System::println(c, Strings::format(messageTemplate, messageArg1, messageArgs...));
+        return System::print(c, details::format_message(true, messageTemplate, messageArg1, messageArgs...));
     }
 
+    /// <summary>
+    /// Collects everything the current thread prints while it is alive, including the output of the processes it
+    /// launches, and writes it to the console in one piece when it is flushed or destroyed. This keeps the output of
+    /// packages which are built at the same time from interleaving.
+    /// </summary>
+    struct BufferedOutput : Util::ResourceBase
+    {
+        BufferedOutput();
+        ~BufferedOutput();
+
+        /// <summary>
+        /// Writes what has been collected so far and starts collecting again
+        /// </summary>
+        void flush();
+
+        /// <summary>
+        /// Appends output; safe to call on any thread, such as the one reading the output of a child process
+        /// </summary>
+        void append(const char* data, size_t size);
+        void append(const Color c, const CStringView text);
+
+        /// <summary>
+        /// Returns the output of the current thread, or nullptr if it writes straight to the console
+        /// </summary>
+        static BufferedOutput* current();
+
+    private:
+        struct Segment
+        {
+            Optional<Color> color;
+            std::string text;
+        };
+
+        std::mutex m_mutex;
+        std::vector<Segment> m_segments;
+        BufferedOutput* m_previous;
+    };
+
+    /// <summary>
+    /// Shows a single line below the output, which is redrawn as the output scrolls. An empty line removes it. It is
+    /// only shown when stdout is a console.
+    /// </summary>
+    void set_status_line(const std::string& status);
+
+    bool is_stdout_console();
+
+    /// <summary>
+    /// Writes the output which every thread has buffered so far, and removes the status line. Used before exiting.
+    /// </summary>
+    void flush_all_output();
+
     Optional<std::wstring> get_environment_variable(const CWStringView varname) noexcept;
 
     Optional<std::wstring> get_registry_string(HKEY base, const CWStringView subkey, const CWStringView valuename);
@@ -80,6 +273,23 @@ namespace vcpkg::System
 
     std::vector<CPUArchitecture> get_supported_host_architectures();
 
+    /// <summary>
+    /// The physical memory of the machine in MiB, or 0 if it cannot be queried
+    /// </summary>
+    size_t get_physical_memory_mib();
+
+    /// <summary>
+    /// The cores of the mask, or of the machine when it is 0, less the highest free_cores of them. At least one core
+    /// is kept.
+    /// </summary>
+    uint64_t get_background_affinity(const uint64_t mask, const size_t free_cores);
+
+    /// <summary>
+    /// The number of cores the builds may use: those of the background affinity in background mode and otherwise
+    /// all of them, or 0 if it cannot be queried
+    /// </summary>
+    size_t get_build_core_count();
+
     const fs::path& get_program_files_32_bit();
 
     const fs::path& get_program_files_platform_bitness();
@@ -87,12 +297,15 @@ namespace vcpkg::System
 
 namespace vcpkg::Debug
 {
+    bool is_enabled();
+
     void println(const CStringView message);
     void println(const System::Color c, const CStringView message);
 
     template<class Arg1, class... Args>
     void println(const char* messageTemplate, const Arg1& messageArg1, const Args&... messageArgs)
     {
+        if (!is_enabled()) return;
         return Debug::println(Strings::format(messageTemplate, messageArg1, messageArgs...));
     }
 
@@ -102,6 +315,7 @@ namespace vcpkg::Debug
                  const Arg1& messageArg1,
                  const Args&... messageArgs)
     {
+        if (!is_enabled()) return;
         return Debug::println(c, Strings::format(messageTemplate, messageArg1, messageArgs...));
     }
 }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+
+/// <summary>
+/// The threads which every parallel loop of vcpkg shares, so that nested and concurrent loops do not each start a
+/// thread per core. The threads are started on first use and live until the process exits.
+/// </summary>
+namespace vcpkg::ThreadPool
+{
+    /// <summary>
+    /// The number of threads a loop runs on, including the one which runs it: %NUMBER_OF_PROCESSORS%, or the
+    /// hardware concurrency where it is not set, capped by set_max_threads()
+    /// </summary>
+    size_t get_thread_count();
+
+    /// <summary>
+    /// Caps the number of threads, for example to --jobs. A cap above the current number of threads has no effect.
+    /// </summary>
+    void set_max_threads(const size_t max_threads);
+
+    /// <summary>
+    /// Calls f(i) for every i in [0, count) and returns once all calls returned. The calling thread takes indices
+    /// too, and the idle threads of the pool help whichever loop started first, so a loop inside a loop finishes even
+    /// when every thread is busy.
+    /// </summary>
+    void for_each_index(const size_t count, const std::function<void(size_t)>& f);
+}
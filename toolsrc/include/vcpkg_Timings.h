@@ -0,0 +1,125 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_MemStats.h"
+#include "vcpkg_Util.h"
+#include "vcpkg_optional.h"
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace vcpkg::Timings
+{
+    /// <summary>
+    /// A phase of the pipeline for one subject, usually a package spec or a triplet. Times are in microseconds
+    /// since the process started.
+    /// </summary>
+    struct TimingEvent
+    {
+        std::string phase;
+        std::string subject;
+        double start_us;
+        double duration_us;
+        unsigned long thread_id;
+
+        /// <summary>
+        /// What else is known about the event, such as the resources a build used; empty if nothing
+        /// </summary>
+        std::string details;
+
+        /// <summary>
+        /// What all threads allocated during the event, when memory statistics are enabled
+        /// </summary>
+        uint64_t allocations = 0;
+        uint64_t allocated_bytes = 0;
+    };
+
+    /// <summary>
+    /// A child process which vcpkg waited for
+    /// </summary>
+    struct ProcessEvent
+    {
+        std::string cmd_line;
+        double start_us;
+        double duration_us;
+        int exit_code;
+        /// <summary>
+        /// nullopt when the process wrote to the console rather than to vcpkg
+        /// </summary>
+        Optional<size_t> output_bytes;
+    };
+
+    struct Timings : Util::ResourceBase
+    {
+        void set_print_timings(bool should_print_timings);
+        void set_trace_file(const fs::path& trace_file);
+        void set_trace_processes(bool should_trace_processes);
+        void set_print_memstats(bool should_print_memstats);
+
+        void track_event(TimingEvent&& event);
+        void track_process(ProcessEvent&& event);
+
+        /// <summary>
+        /// Prints the time spent in each phase and in child processes and the memory each phase allocated, and writes
+        /// the Chrome trace-event file, if they were requested
+        /// </summary>
+        void flush();
+
+    private:
+        bool m_print_timings = false;
+        bool m_trace_processes = false;
+        bool m_print_memstats = false;
+        fs::path m_trace_file;
+        std::vector<TimingEvent> m_events;
+        std::vector<ProcessEvent> m_processes;
+    };
+
+    extern Util::LockGuarded<Timings> g_timings;
+
+    double microseconds_since_start();
+
+    /// <summary>
+    /// Converts a wall clock time, like the timestamps CMake writes, to microseconds since the process started
+    /// </summary>
+    double microseconds_since_start(const std::time_t wall_clock_time);
+
+    /// <summary>
+    /// Records an event for the calling thread when timings are enabled
+    /// </summary>
+    void track_event_if_enabled(const std::string& phase,
+                                const std::string& subject,
+                                const double start_us,
+                                const double duration_us,
+                                std::string details = std::string());
+
+    /// <summary>
+    /// Records a child process which exited, when processes are traced
+    /// </summary>
+    void track_process_if_enabled(std::string cmd_line,
+                                  const double start_us,
+                                  const int exit_code,
+                                  const Optional<size_t> output_bytes);
+
+    /// <summary>
+    /// The file name of the program that the command line runs, looking through cmd.exe /c to the command it runs
+    /// </summary>
+    std::string get_program_name(const std::string& cmd_line);
+
+    /// <summary>
+    /// Records the time from its construction to its destruction, and what was allocated meanwhile, as an event when
+    /// timings or memory statistics are enabled
+    /// </summary>
+    struct ScopedTimer : Util::ResourceBase
+    {
+        ScopedTimer(std::string phase, std::string subject);
+        ~ScopedTimer();
+
+    private:
+        bool m_enabled;
+        std::string m_phase;
+        std::string m_subject;
+        double m_start_us;
+        MemStats::Counters m_start_counters;
+    };
+}
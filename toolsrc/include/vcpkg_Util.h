@@ -1,7 +1,13 @@
 #pragma once
 
+#include "vcpkg_ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <mutex>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -22,6 +28,47 @@ namespace vcpkg::Util
         return ret;
     }
 
+    /// <summary>
+    /// Calls f(i) for every i in [0, count) on the shared thread pool, including the calling thread.
+    /// f must be safe to call concurrently for different indices; results should be written to per-index slots.
+    /// </summary>
+    template<class Func>
+    void parallel_for_each_index(const size_t count, Func&& f)
+    {
+        ThreadPool::for_each_index(count, [&f](const size_t i) { f(i); });
+    }
+
+    /// <summary>
+    /// Calls f for every element on the shared thread pool
+    /// </summary>
+    template<class Cont, class Func>
+    void parallel_for_each(Cont&& xs, Func&& f)
+    {
+        std::vector<decltype(&*begin(xs))> elements;
+        for (auto&& x : xs)
+            elements.push_back(&x);
+
+        parallel_for_each_index(elements.size(), [&](const size_t i) { f(*elements[i]); });
+    }
+
+    /// <summary>
+    /// Like fmap(), but on the shared thread pool. The results are in the order of the elements.
+    /// </summary>
+    template<class Cont, class Func, class Out = std::decay_t<FmapOut<Cont, Func>>>
+    std::vector<Out> parallel_fmap(Cont&& xs, Func&& f)
+    {
+        // Each thread writes its own slots, which the bits of a std::vector<bool> are not
+        static_assert(!std::is_same<Out, bool>::value, "parallel_fmap() cannot return bools");
+
+        std::vector<decltype(&*begin(xs))> elements;
+        for (auto&& x : xs)
+            elements.push_back(&x);
+
+        std::vector<Out> ret(elements.size());
+        parallel_for_each_index(elements.size(), [&](const size_t i) { ret[i] = f(*elements[i]); });
+        return ret;
+    }
+
     template<class Cont, class Func>
     using FmapFlattenOut = std::decay_t<decltype(*begin(std::declval<Func>()(*begin(std::declval<Cont>()))))>;
 
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_optional.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::VisualStudio
+{
+    /// <summary>
+    /// The installation directories of the Visual Studio 2017 instances, from the Setup Configuration API. Empty if
+    /// the API is not registered, because no instance was ever installed; nullopt if it could not be used at all.
+    /// </summary>
+    Optional<std::vector<fs::path>> find_vs2017_instances();
+
+    /// <summary>
+    /// The Include directories of the Windows SDKs, whose timestamps change when an SDK is installed or removed
+    /// </summary>
+    std::vector<fs::path> get_windows_sdk_include_dirs();
+
+    /// <summary>
+    /// The SDK which getWindowsSDK.ps1 would select: the newest complete Windows 10 SDK, or else the Windows 8.1 SDK
+    /// </summary>
+    Optional<std::string> find_windows_sdk_version(const Files::Filesystem& fs);
+}
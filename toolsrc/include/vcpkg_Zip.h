@@ -0,0 +1,50 @@
+#pragma once
+
+#include "filesystem_fs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_expected.h"
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::Zip
+{
+    /// <summary>
+    /// A file of a zip archive, whose contents are read from source, or taken from contents when source is empty
+    /// </summary>
+    struct Entry
+    {
+        /// <summary>
+        /// The name in the archive, separated by forward slashes
+        /// </summary>
+        std::string name;
+        fs::path source;
+        std::string contents;
+    };
+
+    /// <summary>
+    /// The CRC-32 of zip and gzip, continued from the CRC of the data before; 0 to start
+    /// </summary>
+    uint32_t crc32(uint32_t crc, const char* data, size_t size);
+
+    /// <summary>
+    /// The CRC-32 of two pieces of data one after the other, from the CRC of each and the size of the second
+    /// </summary>
+    uint32_t crc32_combine(uint32_t first_crc, uint32_t second_crc, uint64_t second_size);
+
+    /// <summary>
+    /// Appends the data as raw DEFLATE blocks (RFC 1951) which refer to nothing before them. Unless is_last, the
+    /// output ends with an empty stored block rather than a final block, so that pieces of a file compressed on
+    /// their own can be concatenated into one stream.
+    /// </summary>
+    void deflate(const char* data, size_t size, bool is_last, std::string& out);
+
+    /// <summary>
+    /// Writes a zip archive of the entries in their order, with Zip64 records where sizes or offsets need them. The
+    /// files are split into pieces which are compressed on the shared thread pool, a bounded number at a time, and
+    /// written in order. Returns the size of the archive.
+    /// </summary>
+    ExpectedT<uint64_t, std::string> write(const Files::Filesystem& fs,
+                                           const fs::path& archive,
+                                           const std::vector<Entry>& entries);
+}
@@ -3,11 +3,43 @@
 #include "SortedVector.h"
 #include "StatusParagraphs.h"
 #include "VcpkgPaths.h"
+#include "vcpkg_Listfile.h"
+#include "vcpkg_Util.h"
+
+#include <map>
 
 namespace vcpkg
 {
     StatusParagraphs database_load_check(const VcpkgPaths& paths);
 
+    /// <summary>
+    /// Must be held by this process to change the status database or the installed files, and keeps other vcpkg
+    /// processes on the same root from doing either until it is released. Reads of the status database wait for it
+    /// too, but builds do not, so that several processes can build while only their installs are serialized.
+    /// Within a process the lock can be taken again while it is held.
+    /// </summary>
+    struct InstalledTreeLock : Util::ResourceBase
+    {
+        explicit InstalledTreeLock(const VcpkgPaths& paths);
+        ~InstalledTreeLock();
+
+        /// <summary>Whether this process holds the lock</summary>
+        static bool is_held();
+    };
+
+    /// <summary>
+    /// Held while a package is built so that two processes never build into the same buildtrees and packages
+    /// directories at once
+    /// </summary>
+    Files::FileLock lock_package_build(const VcpkgPaths& paths, const PackageSpec& spec);
+
+    /// <summary>
+    /// Moves a directory into installed/vcpkg/trash, which takes a single rename however large it is, and returns.
+    /// The trash is deleted by a background process that outlives vcpkg. A directory which cannot be renamed, for
+    /// instance because it is on another volume, is deleted in place.
+    /// </summary>
+    void move_to_trash(const VcpkgPaths& paths, const fs::path& dir);
+
     void write_update(const VcpkgPaths& paths, const StatusParagraph& p);
 
     struct StatusParagraphAndAssociatedFiles
@@ -16,10 +48,61 @@ namespace vcpkg
         SortedVector<std::string> files;
     };
 
+    /// <summary>
+    /// Reads every line of a listfile, from its binary form when that is current. A listfile in an older format is
+    /// upgraded first, and its binary form is written for the next read.
+    /// </summary>
+    std::vector<Listfile::Entry> read_listfile_entries(Files::Filesystem& fs, const fs::path& listfile_path);
+
     std::vector<StatusParagraph*> get_installed_ports(const StatusParagraphs& status_db);
     std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
                                                                        const StatusParagraphs& status_db);
 
+    /// <summary>
+    /// Maps every file installed for a triplet to the package that owns it. The index is persisted in
+    /// installed/vcpkg and records the size and modification time of each listfile it was built from; when those no
+    /// longer match the installed packages it is rebuilt from the listfiles.
+    /// </summary>
+    struct InstalledFileOwners
+    {
+        struct Entry
+        {
+            /// Relative to installed/&lt;triplet&gt;; directories are not included
+            std::string file;
+            std::string owner;
+        };
+
+        static InstalledFileOwners load(const VcpkgPaths& paths,
+                                        const StatusParagraphs& status_db,
+                                        const Triplet& triplet);
+
+        /// <summary>Returns the name of the package which installed `file`, or nullptr</summary>
+        const std::string* find_owner(const std::string& file) const;
+
+        /// <summary>
+        /// Returns the owner of each of the files, or nullptr for those which are not installed. The files are looked
+        /// up in one pass which gallops through the index, so a small package is checked in O(k log(n/k)).
+        /// </summary>
+        std::vector<const std::string*> find_owners(const SortedVector<std::string>& files) const;
+
+        /// <summary>Sorted by file</summary>
+        const std::vector<Entry>& entries() const { return m_entries; }
+
+        /// <summary>Adds the files from the listfile of an installed package</summary>
+        void add_package(const VcpkgPaths& paths, const BinaryParagraph& pgh);
+        void remove_package(const std::string& name);
+
+        void save(const VcpkgPaths& paths) const;
+
+    private:
+        /// <summary>Reads the listfile of the package and stamps it; the entries are sorted by file</summary>
+        std::vector<Entry> read_package(const VcpkgPaths& paths, const BinaryParagraph& pgh);
+
+        Triplet m_triplet;
+        std::map<std::string, std::string> m_listfile_stamps;
+        std::vector<Entry> m_entries;
+    };
+
     struct CMakeVariable
     {
         CMakeVariable(const CWStringView varname, const wchar_t* varvalue);
@@ -34,5 +117,11 @@ namespace vcpkg
                                 const fs::path& cmake_script,
                                 const std::vector<CMakeVariable>& pass_variables);
 
+    /// <summary>
+    /// Runs ports.cmake with the variables and the locations of the downloads, buildtrees and packages, which may be
+    /// outside of the root
+    /// </summary>
+    std::wstring make_ports_cmake_cmd(const VcpkgPaths& paths, std::vector<CMakeVariable> pass_variables);
+
     std::string shorten_text(const std::string& desc, size_t length);
 } // namespace vcpkg
@@ -12,6 +12,7 @@ namespace vcpkg
         static const std::string VERSION = "Version";
         static const std::string ARCHITECTURE = "Architecture";
         static const std::string MULTI_ARCH = "Multi-Arch";
+        static const std::string ABI = "Abi";
     }
 
     namespace Fields
@@ -23,13 +24,32 @@ namespace vcpkg
         static const std::string DEFAULTFEATURES = "Default-Features";
     }
 
+    static constexpr std::string_view BINARY_FIELD_NAMES[] = {
+        "Package",
+        "Version",
+        "Architecture",
+        "Multi-Arch",
+        "Abi",
+        "Feature",
+        "Description",
+        "Maintainer",
+        "Depends",
+        "Default-Features",
+    };
+    static constexpr Parse::FieldTable BINARY_FIELDS(BINARY_FIELD_NAMES);
+
     BinaryParagraph::BinaryParagraph() = default;
 
     BinaryParagraph::BinaryParagraph(std::unordered_map<std::string, std::string> fields)
+        : BinaryParagraph(Parse::to_paragraph_view(fields))
+    {
+    }
+
+    BinaryParagraph::BinaryParagraph(const Parse::ParagraphView& fields)
     {
         using namespace vcpkg::Parse;
 
-        ParagraphParser parser(std::move(fields));
+        ParagraphParser parser(fields, BINARY_FIELDS);
 
         {
             std::string name;
@@ -46,6 +66,7 @@ namespace vcpkg
 
         this->description = parser.optional_field(Fields::DESCRIPTION);
         this->maintainer = parser.optional_field(Fields::MAINTAINER);
+        this->abi = parser.optional_field(Fields::ABI);
 
         std::string multi_arch;
         parser.required_field(Fields::MULTI_ARCH, multi_arch);
@@ -100,24 +121,85 @@ namespace vcpkg
         return Strings::format("%s_%s_%s", this->spec.name(), this->version, this->spec.triplet());
     }
 
-    void serialize(const BinaryParagraph& pgh, std::string& out_str)
+    struct ParagraphSizeCounter
+    {
+        void write(const std::string_view text) { size += text.size(); }
+
+        size_t size = 0;
+    };
+
+    struct ParagraphAppender
+    {
+        void write(const std::string_view text) { out_str.append(text.data(), text.size()); }
+
+        std::string& out_str;
+    };
+
+    /// <summary>
+    /// Both counts and writes the fields, so that the size serialized_size() computes is always that of the text
+    /// </summary>
+    template<class Out>
+    static void write_fields(const BinaryParagraph& pgh, Out& out)
     {
-        out_str.append("Package: ").append(pgh.spec.name()).push_back('\n');
+        const auto field = [&](const std::string& name, const std::string_view value) {
+            out.write(name);
+            out.write(": ");
+            out.write(value);
+            out.write("\n");
+        };
+
+        field(Fields::PACKAGE, pgh.spec.name());
         if (!pgh.version.empty())
-            out_str.append("Version: ").append(pgh.version).push_back('\n');
+            field(Fields::VERSION, pgh.version);
         else if (!pgh.feature.empty())
-            out_str.append("Feature: ").append(pgh.feature).push_back('\n');
+            field(Fields::FEATURE, pgh.feature);
         if (!pgh.depends.empty())
         {
-            out_str.append("Depends: ");
-            out_str.append(Strings::join(", ", pgh.depends));
-            out_str.push_back('\n');
+            out.write(Fields::DEPENDS);
+            out.write(": ");
+            for (size_t i = 0; i < pgh.depends.size(); ++i)
+            {
+                if (i != 0) out.write(", ");
+                out.write(pgh.depends[i]);
+            }
+            out.write("\n");
         }
 
-        out_str.append("Architecture: ").append(pgh.spec.triplet().to_string()).push_back('\n');
-        out_str.append("Multi-Arch: same\n");
+        field(Fields::ARCHITECTURE, pgh.spec.triplet().to_string());
+        field(Fields::MULTI_ARCH, "same");
+
+        if (!pgh.maintainer.empty()) field(Fields::MAINTAINER, pgh.maintainer);
+        if (!pgh.description.empty()) field(Fields::DESCRIPTION, pgh.description);
+        if (!pgh.abi.empty()) field(Fields::ABI, pgh.abi);
+    }
+
+    size_t serialized_size(const BinaryParagraph& pgh)
+    {
+        ParagraphSizeCounter counter;
+        write_fields(pgh, counter);
+        return counter.size;
+    }
+
+    void serialize(const BinaryParagraph& pgh, std::string& out_str)
+    {
+        ParagraphAppender appender{out_str};
+        write_fields(pgh, appender);
+    }
+
+    void serialize(const BinaryControlFile& bcf, std::string& out_str)
+    {
+        size_t size = serialized_size(bcf.core_paragraph);
+        for (auto&& feature : bcf.features)
+        {
+            size += 1 + serialized_size(feature);
+        }
+        out_str.reserve(out_str.size() + size);
 
-        if (!pgh.maintainer.empty()) out_str.append("Maintainer: ").append(pgh.maintainer).push_back('\n');
-        if (!pgh.description.empty()) out_str.append("Description: ").append(pgh.description).push_back('\n');
+        serialize(bcf.core_paragraph, out_str);
+        for (auto&& feature : bcf.features)
+        {
+            out_str.push_back('\n');
+            serialize(feature, out_str);
+        }
     }
 }
@@ -8,6 +8,29 @@ using vcpkg::Parse::parse_comma_list;
 
 namespace vcpkg
 {
+    struct PackageNameInstance
+    {
+        PackageNameInstance(std::string&& s) : value(std::move(s)), hash(std::hash<std::string>()(value)) {}
+
+        const std::string value;
+        const size_t hash = 0;
+
+        bool operator==(const PackageNameInstance& o) const { return o.value == value; }
+    };
+    const PackageNameInstance PackageSpec::DEFAULT_NAME_INSTANCE({});
+}
+
+template<>
+struct std::hash<vcpkg::PackageNameInstance>
+{
+    size_t operator()(const vcpkg::PackageNameInstance& t) const { return t.hash; }
+};
+
+namespace vcpkg
+{
+    // Specs are created from the parallel build workers, so the table is shared between threads
+    static Util::LockGuarded<std::unordered_set<PackageNameInstance>> g_package_name_instances;
+
     static bool is_valid_package_spec_char(char c)
     {
         return (c == '-') || isdigit(c) || (isalpha(c) && islower(c)) || (c == '[') || (c == ']');
@@ -87,22 +110,34 @@ namespace vcpkg
         }
 
         PackageSpec p;
-        p.m_name = name;
+        if (!name.empty())
+        {
+            p.m_name = &*g_package_name_instances.lock()->emplace(std::string(name)).first;
+        }
         p.m_triplet = triplet;
         return p;
     }
 
-    const std::string& PackageSpec::name() const { return this->m_name; }
+    const std::string& PackageSpec::name() const { return this->m_name->value; }
 
     const Triplet& PackageSpec::triplet() const { return this->m_triplet; }
 
-    std::string PackageSpec::dir() const { return Strings::format("%s_%s", this->m_name, this->m_triplet); }
+    std::string PackageSpec::dir() const { return Strings::format("%s_%s", this->name(), this->m_triplet); }
 
     std::string PackageSpec::to_string() const { return Strings::format("%s:%s", this->name(), this->triplet()); }
 
+    size_t PackageSpec::hash_code() const
+    {
+        size_t hash = 17;
+        hash = hash * 31 + this->m_name->hash;
+        hash = hash * 31 + this->m_triplet.hash_code();
+        return hash;
+    }
+
     bool operator==(const PackageSpec& left, const PackageSpec& right)
     {
-        return left.name() == right.name() && left.triplet() == right.triplet();
+        // Both names and triplets are interned
+        return &left.name() == &right.name() && left.triplet() == right.triplet();
     }
 
     bool operator!=(const PackageSpec& left, const PackageSpec& right) { return !(left == right); }
@@ -165,8 +200,8 @@ namespace vcpkg
                 VCPKG_LINE_INFO, spec->triplet.empty(), "error: triplet not allowed in specifier: %s", name);
 
             Features f;
-            f.name = spec->name;
-            f.features = spec->features;
+            f.name = std::move(spec->name);
+            f.features = std::move(spec->features);
             return f;
         }
 
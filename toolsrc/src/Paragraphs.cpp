@@ -4,12 +4,71 @@
 #include "Paragraphs.h"
 #include "vcpkg_Files.h"
 #include "vcpkg_GlobalState.h"
+#include "vcpkg_PortIndex.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Timings.h"
 #include "vcpkg_Util.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VCPKG_PARAGRAPHS_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 using namespace vcpkg::Parse;
 
 namespace vcpkg::Paragraphs
 {
+#if defined(VCPKG_PARAGRAPHS_SSE2)
+    static unsigned long lowest_set_bit(const unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<unsigned long>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+
+    /// <summary>
+    /// The first '\r', '\n', '\0' or delimiter in [cur, end), or end. The parser stops at a '\0' as it does at the end
+    /// of the text. Where SSE2 is available the text is compared 16 bytes at a time.
+    /// </summary>
+    static const char* find_line_end_or(const char* cur, const char* const end, const char delimiter)
+    {
+#if defined(VCPKG_PARAGRAPHS_SSE2)
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i nul = _mm_setzero_si128();
+        const __m128i delim = _mm_set1_epi8(delimiter);
+        for (; end - cur >= 16; cur += 16)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+            const __m128i line_ends = _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf));
+            const __m128i stops = _mm_or_si128(_mm_cmpeq_epi8(block, nul), _mm_cmpeq_epi8(block, delim));
+            const __m128i matches = _mm_or_si128(line_ends, stops);
+            const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(matches));
+            if (mask != 0) return cur + lowest_set_bit(mask);
+        }
+#endif
+
+        for (; cur != end; ++cur)
+        {
+            const char ch = *cur;
+            if (ch == '\r' || ch == '\n' || ch == '\0' || ch == delimiter) break;
+        }
+        return cur;
+    }
+
+    static const char* find_line_end(const char* cur, const char* const end)
+    {
+        return find_line_end_or(cur, end, '\n');
+    }
+
     struct Parser
     {
         Parser(const char* c, const char* e) : cur(c), end(e) {}
@@ -39,8 +98,8 @@ namespace vcpkg::Paragraphs
 
         void skip_comment(char& ch)
         {
-            while (ch != '\r' && ch != '\n' && ch != '\0')
-                next(ch);
+            cur = find_line_end(cur, end);
+            peek(ch);
             if (ch == '\r') next(ch);
             if (ch == '\n') next(ch);
         }
@@ -60,18 +119,17 @@ namespace vcpkg::Paragraphs
 
         static bool is_lineend(char ch) { return ch == '\r' || ch == '\n' || ch == 0; }
 
-        void get_fieldvalue(char& ch, std::string& fieldvalue)
+        void get_fieldvalue(char& ch, std::string_view& fieldvalue)
         {
-            fieldvalue.clear();
-
-            auto beginning_of_line = cur;
+            // The value is left with its original line endings; ParagraphView consumers normalize it on access.
+            const char* const beginning_of_value = cur;
             do
             {
                 // scan to end of current line (it is part of the field value)
-                while (!is_lineend(ch))
-                    next(ch);
+                cur = find_line_end(cur, end);
+                peek(ch);
 
-                fieldvalue.append(beginning_of_line, cur);
+                fieldvalue = std::string_view(beginning_of_value, cur - beginning_of_value);
 
                 if (ch == '\r') next(ch);
                 if (ch == '\n') next(ch);
@@ -82,8 +140,6 @@ namespace vcpkg::Paragraphs
                     return;
                 }
 
-                beginning_of_line = cur;
-
                 // Line may continue the current field with data or terminate the paragraph,
                 // depending on first nonspace character.
                 skip_spaces(ch);
@@ -97,29 +153,30 @@ namespace vcpkg::Paragraphs
                 }
 
                 // First nonspace is not a newline. This continues the current field value.
-                // We forcibly convert all newlines into single '\n' for ease of text handling later on.
-                fieldvalue.push_back('\n');
             } while (true);
         }
 
-        void get_fieldname(char& ch, std::string& fieldname)
+        void get_fieldname(char& ch, std::string_view& fieldname)
         {
-            auto begin_fieldname = cur;
-            while (is_alphanum(ch) || ch == '-')
-                next(ch);
-            Checks::check_exit(VCPKG_LINE_INFO, ch == ':', "Expected ':'");
-            fieldname = std::string(begin_fieldname, cur);
+            // The name is what comes before the separator, if the line has one
+            const char* const begin_fieldname = cur;
+            cur = find_line_end_or(cur, end, ':');
+            peek(ch);
+            const bool is_fieldname =
+                std::all_of(begin_fieldname, cur, [](const char c) { return is_alphanum(c) || c == '-'; });
+            Checks::check_exit(VCPKG_LINE_INFO, ch == ':' && is_fieldname, "Expected ':'");
+            fieldname = std::string_view(begin_fieldname, cur - begin_fieldname);
 
             // skip ': '
             next(ch);
             skip_spaces(ch);
         }
 
-        void get_paragraph(char& ch, std::unordered_map<std::string, std::string>& fields)
+        void get_paragraph(char& ch, ParagraphView& paragraph)
         {
-            fields.clear();
-            std::string fieldname;
-            std::string fieldvalue;
+            paragraph.fields.clear();
+            std::string_view fieldname;
+            std::string_view fieldvalue;
             do
             {
                 if (is_comment(ch))
@@ -130,19 +187,22 @@ namespace vcpkg::Paragraphs
 
                 get_fieldname(ch, fieldname);
 
-                auto it = fields.find(fieldname);
-                Checks::check_exit(VCPKG_LINE_INFO, it == fields.end(), "Duplicate field");
+                const bool is_duplicate =
+                    std::any_of(paragraph.fields.cbegin(), paragraph.fields.cend(), [&](const ParagraphView::Field& f) {
+                        return f.name == fieldname;
+                    });
+                Checks::check_exit(VCPKG_LINE_INFO, !is_duplicate, "Duplicate field");
 
                 get_fieldvalue(ch, fieldvalue);
 
-                fields.emplace(fieldname, fieldvalue);
+                paragraph.fields.push_back({fieldname, fieldvalue});
             } while (!is_lineend(ch));
         }
 
     public:
-        std::vector<std::unordered_map<std::string, std::string>> get_paragraphs()
+        std::vector<ParagraphView> get_paragraphs()
         {
-            std::vector<std::unordered_map<std::string, std::string>> paragraphs;
+            std::vector<ParagraphView> paragraphs;
 
             char ch;
             peek(ch);
@@ -189,12 +249,11 @@ namespace vcpkg::Paragraphs
 
     Expected<std::unordered_map<std::string, std::string>> parse_single_paragraph(const std::string& str)
     {
-        const std::vector<std::unordered_map<std::string, std::string>> p =
-            Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs();
+        const std::vector<ParagraphView> p = Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs();
 
         if (p.size() == 1)
         {
-            return p.at(0);
+            return to_raw_paragraph(p.at(0));
         }
 
         return std::error_code(ParagraphParseResult::EXPECTED_ONE_PARAGRAPH);
@@ -202,45 +261,90 @@ namespace vcpkg::Paragraphs
 
     Expected<std::vector<std::unordered_map<std::string, std::string>>> parse_paragraphs(const std::string& str)
     {
-        return Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs();
+        return Util::fmap(Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs(), to_raw_paragraph);
     }
 
-    ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& path)
+    ParagraphViews parse_paragraph_views(std::string&& str)
+    {
+        const auto owner = std::make_shared<const std::string>(std::move(str));
+
+        ParagraphViews views;
+        views.buffer = std::shared_ptr<const char>(owner, owner->c_str());
+        views.paragraphs = Parser(owner->c_str(), owner->c_str() + owner->size()).get_paragraphs();
+        return views;
+    }
+
+    ParagraphViews parse_paragraph_views(const Files::MappedFile& file)
     {
-        Expected<std::vector<std::unordered_map<std::string, std::string>>> pghs = get_paragraphs(fs, path / "CONTROL");
-        if (auto vector_pghs = pghs.get())
+        ParagraphViews views;
+        views.buffer = file.data;
+        views.paragraphs = Parser(file.contents().begin(), file.contents().end()).get_paragraphs();
+        return views;
+    }
+
+    Expected<ParagraphViews> get_paragraph_views(const Files::Filesystem& fs, const fs::path& control_path)
+    {
+        const Expected<Files::MappedFile> contents = fs.map_contents(control_path);
+        if (auto file = contents.get())
         {
-            auto csf = SourceControlFile::parse_control_file(std::move(*vector_pghs));
-            if (!GlobalState::feature_packages)
+            return parse_paragraph_views(*file);
+        }
+
+        return contents.error();
+    }
+
+    static ParseExpected<SourceControlFile> clear_features_if_disabled(ParseExpected<SourceControlFile>&& csf)
+    {
+        if (!GlobalState::feature_packages)
+        {
+            if (auto ptr = csf.get())
             {
-                if (auto ptr = csf.get())
-                {
-                    Checks::check_exit(VCPKG_LINE_INFO, ptr->get() != nullptr);
-                    ptr->get()->core_paragraph->default_features.clear();
-                    ptr->get()->feature_paragraphs.clear();
-                }
+                Checks::check_exit(VCPKG_LINE_INFO, ptr->get() != nullptr);
+                ptr->get()->core_paragraph->default_features.clear();
+                ptr->get()->feature_paragraphs.clear();
             }
-            return csf;
         }
+        return std::move(csf);
+    }
+
+    static std::unique_ptr<ParseControlErrorInfo> make_port_error_info(const fs::path& path, const std::error_code& ec)
+    {
         auto error_info = std::make_unique<ParseControlErrorInfo>();
         error_info->name = path.filename().generic_u8string();
-        error_info->error = pghs.error();
+        error_info->error = ec;
         return error_info;
     }
 
+    ParseExpected<SourceControlFile> parse_port(const ParagraphViews& pghs)
+    {
+        return clear_features_if_disabled(SourceControlFile::parse_control_file(pghs.paragraphs));
+    }
+
+    ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& path)
+    {
+        const Expected<ParagraphViews> pghs = get_paragraph_views(fs, path / "CONTROL");
+        if (auto views = pghs.get())
+        {
+            return parse_port(*views);
+        }
+        return make_port_error_info(path, pghs.error());
+    }
+
     Expected<BinaryControlFile> try_load_cached_control_package(const VcpkgPaths& paths, const PackageSpec& spec)
     {
-        Expected<std::vector<std::unordered_map<std::string, std::string>>> pghs =
-            get_paragraphs(paths.get_filesystem(), paths.package_dir(spec) / "CONTROL");
+        const Expected<ParagraphViews> pghs =
+            get_paragraph_views(paths.get_filesystem(), paths.package_dir(spec) / "CONTROL");
 
         if (auto p = pghs.get())
         {
-            BinaryControlFile bcf;
-            bcf.core_paragraph = BinaryParagraph(p->front());
-            p->erase(p->begin());
+            Checks::check_exit(VCPKG_LINE_INFO, !p->paragraphs.empty(), "Empty CONTROL file for %s", spec);
 
-            bcf.features =
-                Util::fmap(*p, [&](auto&& raw_feature) -> BinaryParagraph { return BinaryParagraph(raw_feature); });
+            BinaryControlFile bcf;
+            bcf.core_paragraph = BinaryParagraph(p->paragraphs.front());
+            for (auto it = std::next(p->paragraphs.cbegin()); it != p->paragraphs.cend(); ++it)
+            {
+                bcf.features.emplace_back(*it);
+            }
 
             return bcf;
         }
@@ -248,12 +352,24 @@ namespace vcpkg::Paragraphs
         return pghs.error();
     }
 
+    static std::vector<fs::path> get_sorted_port_dirs(const Files::Filesystem& fs, const fs::path& ports_dir)
+    {
+        std::vector<fs::path> port_dirs = fs.get_files_non_recursive(ports_dir);
+        std::sort(port_dirs.begin(), port_dirs.end());
+        return port_dirs;
+    }
+
     LoadResults try_load_all_ports(const Files::Filesystem& fs, const fs::path& ports_dir)
     {
+        const std::vector<fs::path> port_dirs = get_sorted_port_dirs(fs, ports_dir);
+
+        std::vector<ParseExpected<SourceControlFile>> loaded(port_dirs.size());
+        Util::parallel_for_each_index(port_dirs.size(),
+                                      [&](const size_t i) { loaded[i] = try_load_port(fs, port_dirs[i]); });
+
         LoadResults ret;
-        for (auto&& path : fs.get_files_non_recursive(ports_dir))
+        for (auto&& maybe_spgh : loaded)
         {
-            auto maybe_spgh = try_load_port(fs, path);
             if (auto spgh = maybe_spgh.get())
             {
                 ret.paragraphs.emplace_back(std::move(*spgh));
@@ -278,14 +394,220 @@ namespace vcpkg::Paragraphs
         return std::move(results.paragraphs);
     }
 
+    static std::map<std::string, VersionT> get_names_and_versions(
+        const std::vector<std::unique_ptr<SourceControlFile>>& all_ports)
+    {
+        std::map<std::string, VersionT> names_and_versions;
+        for (auto&& port : all_ports)
+            names_and_versions.emplace(port->core_paragraph->name, port->core_paragraph->version);
+
+        return names_and_versions;
+    }
+
     std::map<std::string, VersionT> load_all_port_names_and_versions(const Files::Filesystem& fs,
                                                                      const fs::path& ports_dir)
     {
-        auto all_ports = load_all_ports(fs, ports_dir);
+        return get_names_and_versions(load_all_ports(fs, ports_dir));
+    }
+
+    LoadResults try_load_all_ports(const VcpkgPaths& paths)
+    {
+        const Timings::ScopedTimer timer("port loading", "all ports");
+        auto& fs = paths.get_filesystem();
+        const fs::path index_path = PortIndex::get_index_path(paths);
+
+        auto old_index = std::make_unique<PortIndex::Table>(PortIndex::Table::load(fs, index_path));
+        const std::vector<fs::path> port_dirs = get_sorted_port_dirs(fs, paths.ports);
+
+        struct LoadedPort
+        {
+            std::string stamp;
+            ParagraphViews pghs;
+            bool from_index = false;
+            ParseExpected<SourceControlFile> result;
+        };
+
+        // Each task only looks up its own port in the mapped index, so no locking is needed
+        std::vector<LoadedPort> loaded(port_dirs.size());
+        Util::parallel_for_each_index(port_dirs.size(), [&](const size_t i) {
+            const fs::path& path = port_dirs[i];
+            const fs::path control_path = path / "CONTROL";
+            LoadedPort& port = loaded[i];
+            port.stamp = PortIndex::get_control_file_stamp(fs, control_path);
+
+            const Optional<PortIndex::Table::Entry> cached = old_index->find(path.filename().u8string());
+            const auto entry = cached.get();
+            if (!port.stamp.empty() && entry && entry->stamp == port.stamp)
+            {
+                port.pghs = entry->paragraphs;
+                port.from_index = true;
+            }
+            else
+            {
+                Expected<ParagraphViews> maybe_pghs = get_paragraph_views(fs, control_path);
+                if (auto p = maybe_pghs.get())
+                {
+                    port.pghs = std::move(*p);
+                }
+                else
+                {
+                    port.result = make_port_error_info(path, maybe_pghs.error());
+                    return;
+                }
+            }
+
+            port.result = parse_port(port.pghs);
+        });
+
+        std::vector<PortIndex::PortEntry> new_index;
+        bool index_changed = false;
+
+        LoadResults ret;
+        for (size_t i = 0; i < port_dirs.size(); ++i)
+        {
+            LoadedPort& port = loaded[i];
+            if (auto spgh = port.result.get())
+            {
+                ret.paragraphs.emplace_back(std::move(*spgh));
+                if (!port.stamp.empty())
+                {
+                    if (!port.from_index) index_changed = true;
+                    new_index.push_back(PortIndex::PortEntry{
+                        port_dirs[i].filename().u8string(), std::move(port.stamp), std::move(port.pghs)});
+                }
+            }
+            else
+            {
+                ret.errors.emplace_back(std::move(port.result).error());
+            }
+        }
+
+        if (index_changed || new_index.size() != old_index->size())
+        {
+            const Optional<std::string> bytes = PortIndex::serialize(new_index);
+
+            // A mapped file cannot be replaced, so the views into the old index are released first
+            new_index.clear();
+            loaded.clear();
+            old_index.reset();
+            if (const auto p = bytes.get()) PortIndex::write(fs, index_path, *p);
+        }
+
+        return ret;
+    }
+
+    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const VcpkgPaths& paths)
+    {
+        auto results = try_load_all_ports(paths);
+        if (!results.errors.empty())
+        {
+            print_error_message(results.errors);
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+        return std::move(results.paragraphs);
+    }
+
+    namespace PortHeaderFields
+    {
+        static const std::string SOURCE = "Source";
+        static const std::string VERSION = "Version";
+    }
+
+    Optional<std::pair<std::string, VersionT>> scan_port_name_and_version(span<const char> control_file)
+    {
+        Optional<std::string> name;
+        Optional<std::string> version;
+        bool in_paragraph = false;
+
+        const char* it = control_file.begin();
+        while (it != control_file.end())
+        {
+            const char* line_end = std::find(it, control_file.end(), '\n');
+            std::string line(it, line_end);
+            it = line_end == control_file.end() ? line_end : line_end + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+
+            // Comments and the continuations of multi-line values never hold these fields
+            if (!line.empty() && (line.front() == '#' || line.front() == ' ' || line.front() == '\t')) continue;
+
+            if (line.empty())
+            {
+                if (in_paragraph) break;
+                continue;
+            }
+            in_paragraph = true;
+
+            const size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+
+            const std::string field_name = line.substr(0, colon);
+            if (field_name == PortHeaderFields::SOURCE)
+                name = Strings::trimmed(line.substr(colon + 1));
+            else if (field_name == PortHeaderFields::VERSION)
+                version = Strings::trimmed(line.substr(colon + 1));
+
+            if (name && version) break;
+        }
+
+        const auto p_name = name.get();
+        if (!p_name || p_name->empty()) return nullopt;
+        return std::make_pair(std::move(*p_name), VersionT(version.value_or(Strings::EMPTY)));
+    }
+
+    std::map<std::string, VersionT> load_all_port_names_and_versions(const VcpkgPaths& paths)
+    {
+        const Timings::ScopedTimer timer("port loading", "all versions");
+        auto& fs = paths.get_filesystem();
+        const PortIndex::Table index = PortIndex::Table::load(fs, PortIndex::get_index_path(paths));
+        const std::vector<fs::path> port_dirs = get_sorted_port_dirs(fs, paths.ports);
+
+        std::vector<Optional<std::pair<std::string, VersionT>>> loaded(port_dirs.size());
+        Util::parallel_for_each_index(port_dirs.size(), [&](const size_t i) {
+            const fs::path control_path = port_dirs[i] / "CONTROL";
+            const std::string stamp = PortIndex::get_control_file_stamp(fs, control_path);
+
+            const Optional<PortIndex::Table::Entry> cached = index.find(port_dirs[i].filename().u8string());
+            const auto entry = cached.get();
+            if (!stamp.empty() && entry && entry->stamp == stamp)
+            {
+                Optional<std::string_view> name;
+                std::string_view version;
+                for (auto&& field : entry->paragraphs.paragraphs.front().fields)
+                {
+                    if (field.name == PortHeaderFields::SOURCE) name = field.value;
+                    if (field.name == PortHeaderFields::VERSION) version = field.value;
+                }
+                if (const auto p_name = name.get())
+                {
+                    loaded[i] = std::make_pair(std::string(*p_name), VersionT(std::string(version)));
+                    return;
+                }
+            }
+
+            const Expected<Files::MappedFile> contents = fs.map_contents(control_path);
+            if (const auto file = contents.get()) loaded[i] = scan_port_name_and_version(file->contents());
+        });
 
         std::map<std::string, VersionT> names_and_versions;
-        for (auto&& port : all_ports)
-            names_and_versions.emplace(port->core_paragraph->name, port->core_paragraph->version);
+        for (size_t i = 0; i < port_dirs.size(); ++i)
+        {
+            if (auto name_and_version = loaded[i].get())
+            {
+                names_and_versions.emplace(std::move(*name_and_version));
+                continue;
+            }
+
+            // Only a port which fails to load has no Source field, so the full parser reports the error
+            const auto maybe_port = try_load_port(fs, port_dirs[i]);
+            if (const auto port = maybe_port.get())
+            {
+                names_and_versions.emplace((*port)->core_paragraph->name, (*port)->core_paragraph->version);
+                continue;
+            }
+
+            print_error_message(maybe_port.error());
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
 
         return names_and_versions;
     }
@@ -3,6 +3,7 @@
 #include "PackageSpec.h"
 #include "PostBuildLint.h"
 #include "PostBuildLint_BuildType.h"
+#include "PostBuildLint_InspectionCache.h"
 #include "VcpkgPaths.h"
 #include "coff_file_reader.h"
 #include "vcpkg_Build.h"
@@ -16,48 +17,140 @@ using vcpkg::Build::PreBuildInfo;
 
 namespace vcpkg::PostBuildLint
 {
-    static auto has_extension_pred(const Files::Filesystem& fs, const std::string& ext)
-    {
-        return [&fs, ext](const fs::path& path) { return !fs.is_directory(path) && path.extension() == ext; };
-    }
-
     enum class LintStatus
     {
         SUCCESS = 0,
         ERROR_DETECTED = 1
     };
 
-    struct OutdatedDynamicCrt
+    static bool is_under(const fs::path& path, const fs::path& dir)
     {
-        std::string name;
-        std::regex regex;
+        const auto& p = path.native();
+        const auto& d = dir.native();
+        return p.size() > d.size() && p.compare(0, d.size(), d) == 0 && (p[d.size()] == '\\' || p[d.size()] == '/');
+    }
 
-        OutdatedDynamicCrt(const std::string& name, const std::string& regex_as_string)
-            : name(name), regex(std::regex(regex_as_string, std::regex_constants::icase))
+    /// <summary>
+    /// Every file and directory of the package, enumerated once and shared by all of the checks
+    /// </summary>
+    struct PackageManifest
+    {
+        static PackageManifest enumerate(const Files::Filesystem& fs, const fs::path& package_dir)
         {
+            PackageManifest manifest;
+            std::set<fs::path> non_empty_directories;
+            for (Files::DirectoryEntry& entry : fs.get_entries_recursive(package_dir))
+            {
+                non_empty_directories.insert(entry.path.parent_path());
+                if (fs::is_directory(entry.status))
+                    manifest.m_directories.push_back(std::move(entry.path));
+                else
+                    manifest.m_files.push_back(std::move(entry.path));
+            }
+
+            for (const fs::path& dir : manifest.m_directories)
+            {
+                if (non_empty_directories.find(dir) == non_empty_directories.cend())
+                {
+                    manifest.m_empty_directories.push_back(dir);
+                }
+            }
+
+            return manifest;
         }
+
+        /// <summary>
+        /// The files anywhere below dir, in enumeration order
+        /// </summary>
+        std::vector<fs::path> files_under(const fs::path& dir) const
+        {
+            return files_where([&](const fs::path& file) { return is_under(file, dir); });
+        }
+
+        std::vector<fs::path> files_under(const fs::path& dir, const std::string& extension) const
+        {
+            return files_where([&](const fs::path& file) {
+                return file.extension() == extension && is_under(file, dir);
+            });
+        }
+
+        /// <summary>
+        /// The files directly inside dir, in enumeration order
+        /// </summary>
+        std::vector<fs::path> files_in(const fs::path& dir) const
+        {
+            return files_where([&](const fs::path& file) { return file.parent_path() == dir; });
+        }
+
+        const std::vector<fs::path>& empty_directories() const { return m_empty_directories; }
+
+    private:
+        template<class Pred>
+        std::vector<fs::path> files_where(Pred pred) const
+        {
+            std::vector<fs::path> ret;
+            std::copy_if(m_files.cbegin(), m_files.cend(), std::back_inserter(ret), pred);
+            return ret;
+        }
+
+        std::vector<fs::path> m_files;
+        std::vector<fs::path> m_directories;
+        std::vector<fs::path> m_empty_directories;
+    };
+
+    struct DllFile
+    {
+        fs::path path;
+        CoffFileReader::DllInfo info;
+    };
+
+    struct LibFile
+    {
+        fs::path path;
+        CoffFileReader::LibInfo info;
+    };
+
+    /// <summary>
+    /// Pairs each binary with what was read from it. The results are in the same order as the paths, so the checks
+    /// consuming them report in a deterministic order.
+    /// </summary>
+    template<class Binary, class Info>
+    static std::vector<Binary> with_paths(const std::vector<fs::path>& paths, std::vector<Info>&& infos)
+    {
+        std::vector<Binary> binaries(paths.size());
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            binaries[i].path = paths[i];
+            binaries[i].info = std::move(infos[i]);
+        }
+        return binaries;
+    }
+
+    struct OutdatedDynamicCrt
+    {
+        std::string name;
     };
 
     const std::vector<OutdatedDynamicCrt>& get_outdated_dynamic_crts()
     {
         static const std::vector<OutdatedDynamicCrt> V_NO_MSVCRT = {
-            {"msvcp100.dll", R"(msvcp100\.dll)"},
-            {"msvcp100d.dll", R"(msvcp100d\.dll)"},
-            {"msvcp110.dll", R"(msvcp110\.dll)"},
-            {"msvcp110_win.dll", R"(msvcp110_win\.dll)"},
-            {"msvcp120.dll", R"(msvcp120\.dll)"},
-            {"msvcp120_clr0400.dll", R"(msvcp120_clr0400\.dll)"},
-            {"msvcp60.dll", R"(msvcp60\.dll)"},
-            {"msvcp60.dll", R"(msvcp60\.dll)"},
-
-            {"msvcr100.dll", R"(msvcr100\.dll)"},
-            {"msvcr100d.dll", R"(msvcr100d\.dll)"},
-            {"msvcr100_clr0400.dll", R"(msvcr100_clr0400\.dll)"},
-            {"msvcr110.dll", R"(msvcr110\.dll)"},
-            {"msvcr120.dll", R"(msvcr120\.dll)"},
-            {"msvcr120_clr0400.dll", R"(msvcr120_clr0400\.dll)"},
-            {"msvcrt20.dll", R"(msvcrt20\.dll)"},
-            {"msvcrt40.dll", R"(msvcrt40\.dll)"}};
+            {"msvcp100.dll"},
+            {"msvcp100d.dll"},
+            {"msvcp110.dll"},
+            {"msvcp110_win.dll"},
+            {"msvcp120.dll"},
+            {"msvcp120_clr0400.dll"},
+            {"msvcp60.dll"},
+            {"msvcp60.dll"},
+
+            {"msvcr100.dll"},
+            {"msvcr100d.dll"},
+            {"msvcr100_clr0400.dll"},
+            {"msvcr110.dll"},
+            {"msvcr120.dll"},
+            {"msvcr120_clr0400.dll"},
+            {"msvcrt20.dll"},
+            {"msvcrt40.dll"}};
 
         return V_NO_MSVCRT;
     }
@@ -82,15 +175,14 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_for_files_in_debug_include_directory(const Files::Filesystem& fs,
+    static LintStatus check_for_files_in_debug_include_directory(const PackageManifest& manifest,
                                                                  const fs::path& package_dir)
     {
         const fs::path debug_include_dir = package_dir / "debug" / "include";
 
-        std::vector<fs::path> files_found = fs.get_files_recursive(debug_include_dir);
+        std::vector<fs::path> files_found = manifest.files_under(debug_include_dir);
 
-        Util::unstable_keep_if(
-            files_found, [&fs](const fs::path& path) { return !fs.is_directory(path) && path.extension() != ".ifc"; });
+        Util::unstable_keep_if(files_found, [](const fs::path& path) { return path.extension() != ".ifc"; });
 
         if (!files_found.empty())
         {
@@ -136,7 +228,7 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_for_misplaced_cmake_files(const Files::Filesystem& fs,
+    static LintStatus check_for_misplaced_cmake_files(const PackageManifest& manifest,
                                                       const fs::path& package_dir,
                                                       const PackageSpec& spec)
     {
@@ -150,11 +242,9 @@ namespace vcpkg::PostBuildLint
         std::vector<fs::path> misplaced_cmake_files;
         for (auto&& dir : dirs)
         {
-            auto files = fs.get_files_recursive(dir);
-            for (auto&& file : files)
+            for (auto&& file : manifest.files_under(dir, ".cmake"))
             {
-                if (!fs.is_directory(file) && file.extension() == ".cmake")
-                    misplaced_cmake_files.push_back(std::move(file));
+                misplaced_cmake_files.push_back(std::move(file));
             }
         }
 
@@ -188,10 +278,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_for_dlls_in_lib_dir(const Files::Filesystem& fs, const fs::path& package_dir)
+    static LintStatus check_for_dlls_in_lib_dir(const PackageManifest& manifest, const fs::path& package_dir)
     {
-        std::vector<fs::path> dlls = fs.get_files_recursive(package_dir / "lib");
-        Util::unstable_keep_if(dlls, has_extension_pred(fs, ".dll"));
+        const std::vector<fs::path> dlls = manifest.files_under(package_dir / "lib", ".dll");
 
         if (!dlls.empty())
         {
@@ -262,10 +351,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::ERROR_DETECTED;
     }
 
-    static LintStatus check_for_exes(const Files::Filesystem& fs, const fs::path& package_dir)
+    static LintStatus check_for_exes(const PackageManifest& manifest, const fs::path& package_dir)
     {
-        std::vector<fs::path> exes = fs.get_files_recursive(package_dir / "bin");
-        Util::unstable_keep_if(exes, has_extension_pred(fs, ".exe"));
+        const std::vector<fs::path> exes = manifest.files_under(package_dir / "bin", ".exe");
 
         if (!exes.empty())
         {
@@ -279,22 +367,14 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_exports_of_dlls(const std::vector<fs::path>& dlls, const fs::path& dumpbin_exe)
+    static LintStatus check_exports_of_dlls(const std::vector<DllFile>& dlls)
     {
         std::vector<fs::path> dlls_with_no_exports;
-        for (const fs::path& dll : dlls)
+        for (const DllFile& dll : dlls)
         {
-            const std::wstring cmd_line =
-                Strings::wformat(LR"("%s" /exports "%s")", dumpbin_exe.native(), dll.native());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               ec_data.exit_code == 0,
-                               "Running command:\n   %s\n failed",
-                               Strings::to_utf8(cmd_line));
-
-            if (ec_data.output.find("ordinal hint RVA      name") == std::string::npos)
+            if (!dll.info.has_exports)
             {
-                dlls_with_no_exports.push_back(dll);
+                dlls_with_no_exports.push_back(dll.path);
             }
         }
 
@@ -309,9 +389,7 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_uwp_bit_of_dlls(const std::string& expected_system_name,
-                                            const std::vector<fs::path>& dlls,
-                                            const fs::path dumpbin_exe)
+    static LintStatus check_uwp_bit_of_dlls(const std::string& expected_system_name, const std::vector<DllFile>& dlls)
     {
         if (expected_system_name != "WindowsStore")
         {
@@ -319,19 +397,11 @@ namespace vcpkg::PostBuildLint
         }
 
         std::vector<fs::path> dlls_with_improper_uwp_bit;
-        for (const fs::path& dll : dlls)
+        for (const DllFile& dll : dlls)
         {
-            const std::wstring cmd_line =
-                Strings::wformat(LR"("%s" /headers "%s")", dumpbin_exe.native(), dll.native());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               ec_data.exit_code == 0,
-                               "Running command:\n   %s\n failed",
-                               Strings::to_utf8(cmd_line));
-
-            if (ec_data.output.find("App Container") == std::string::npos)
+            if (!dll.info.is_app_container)
             {
-                dlls_with_improper_uwp_bit.push_back(dll);
+                dlls_with_improper_uwp_bit.push_back(dll.path);
             }
         }
 
@@ -379,22 +449,21 @@ namespace vcpkg::PostBuildLint
     }
 
     static LintStatus check_dll_architecture(const std::string& expected_architecture,
-                                             const std::vector<fs::path>& files)
+                                             const std::vector<DllFile>& dlls)
     {
         std::vector<FileAndArch> binaries_with_invalid_architecture;
 
-        for (const fs::path& file : files)
+        for (const DllFile& dll : dlls)
         {
             Checks::check_exit(VCPKG_LINE_INFO,
-                               file.extension() == ".dll",
+                               dll.path.extension() == ".dll",
                                "The file extension was not .dll: %s",
-                               file.generic_string());
-            const CoffFileReader::DllInfo info = CoffFileReader::read_dll(file);
-            const std::string actual_architecture = get_actual_architecture(info.machine_type);
+                               dll.path.generic_string());
+            const std::string actual_architecture = get_actual_architecture(dll.info.machine_type);
 
             if (expected_architecture != actual_architecture)
             {
-                binaries_with_invalid_architecture.push_back({file, actual_architecture});
+                binaries_with_invalid_architecture.push_back({dll.path, actual_architecture});
             }
         }
 
@@ -408,17 +477,18 @@ namespace vcpkg::PostBuildLint
     }
 
     static LintStatus check_lib_architecture(const std::string& expected_architecture,
-                                             const std::vector<fs::path>& files)
+                                             const std::vector<LibFile>& libs)
     {
         std::vector<FileAndArch> binaries_with_invalid_architecture;
 
-        for (const fs::path& file : files)
+        for (const LibFile& lib : libs)
         {
+            const fs::path& file = lib.path;
+            const CoffFileReader::LibInfo& info = lib.info;
             Checks::check_exit(VCPKG_LINE_INFO,
                                file.extension() == ".lib",
                                "The file extension was not .lib: %s",
                                file.generic_string());
-            CoffFileReader::LibInfo info = CoffFileReader::read_lib(file);
 
             // This is zero for folly's debug library
             // TODO: Why?
@@ -552,13 +622,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::ERROR_DETECTED;
     }
 
-    static LintStatus check_no_empty_folders(const Files::Filesystem& fs, const fs::path& dir)
+    static LintStatus check_no_empty_folders(const PackageManifest& manifest, const fs::path& dir)
     {
-        std::vector<fs::path> empty_directories = fs.get_files_recursive(dir);
-
-        Util::unstable_keep_if(empty_directories, [&fs](const fs::path& current) {
-            return fs.is_directory(current) && fs.is_empty(current);
-        });
+        const std::vector<fs::path>& empty_directories = manifest.empty_directories();
 
         if (!empty_directories.empty())
         {
@@ -586,9 +652,7 @@ namespace vcpkg::PostBuildLint
         BuildType build_type;
     };
 
-    static LintStatus check_crt_linkage_of_libs(const BuildType& expected_build_type,
-                                                const std::vector<fs::path>& libs,
-                                                const fs::path dumpbin_exe)
+    static LintStatus check_crt_linkage_of_libs(const BuildType& expected_build_type, const span<const LibFile>& libs)
     {
         std::vector<BuildType> bad_build_types(BuildTypeC::VALUES.cbegin(), BuildTypeC::VALUES.cend());
         bad_build_types.erase(std::remove(bad_build_types.begin(), bad_build_types.end(), expected_build_type),
@@ -596,21 +660,20 @@ namespace vcpkg::PostBuildLint
 
         std::vector<BuildTypeAndFile> libs_with_invalid_crt;
 
-        for (const fs::path& lib : libs)
+        for (const LibFile& lib : libs)
         {
-            const std::wstring cmd_line =
-                Strings::wformat(LR"("%s" /directives "%s")", dumpbin_exe.native(), lib.native());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               ec_data.exit_code == 0,
-                               "Running command:\n   %s\n failed",
-                               Strings::to_utf8(cmd_line));
+            // One directive per line, as printed by dumpbin /directives, which is what the regexes expect
+            std::string directives;
+            for (const std::string& directive : lib.info.linker_directives)
+            {
+                directives.append(directive).push_back('\n');
+            }
 
             for (const BuildType& bad_build_type : bad_build_types)
             {
-                if (std::regex_search(ec_data.output.cbegin(), ec_data.output.cend(), bad_build_type.crt_regex()))
+                if (std::regex_search(directives.cbegin(), directives.cend(), bad_build_type.crt_regex()))
                 {
-                    libs_with_invalid_crt.push_back({lib, bad_build_type});
+                    libs_with_invalid_crt.push_back({lib.path, bad_build_type});
                     break;
                 }
             }
@@ -644,29 +707,21 @@ namespace vcpkg::PostBuildLint
         OutdatedDynamicCrtAndFile() = delete;
     };
 
-    static LintStatus check_outdated_crt_linkage_of_dlls(const std::vector<fs::path>& dlls,
-                                                         const fs::path dumpbin_exe,
-                                                         const BuildInfo& build_info)
+    static LintStatus check_outdated_crt_linkage_of_dlls(const std::vector<DllFile>& dlls, const BuildInfo& build_info)
     {
         if (build_info.policies.is_enabled(BuildPolicy::ALLOW_OBSOLETE_MSVCRT)) return LintStatus::SUCCESS;
 
         std::vector<OutdatedDynamicCrtAndFile> dlls_with_outdated_crt;
 
-        for (const fs::path& dll : dlls)
+        for (const DllFile& dll : dlls)
         {
-            const std::wstring cmd_line =
-                Strings::wformat(LR"("%s" /dependents "%s")", dumpbin_exe.native(), dll.native());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               ec_data.exit_code == 0,
-                               "Running command:\n   %s\n failed",
-                               Strings::to_utf8(cmd_line));
+            const std::string dependents = Strings::join("\n", dll.info.dependents);
 
             for (const OutdatedDynamicCrt& outdated_crt : get_outdated_dynamic_crts())
             {
-                if (std::regex_search(ec_data.output.cbegin(), ec_data.output.cend(), outdated_crt.regex))
+                if (Strings::case_insensitive_ascii_contains(dependents, outdated_crt.name))
                 {
-                    dlls_with_outdated_crt.push_back({dll, outdated_crt});
+                    dlls_with_outdated_crt.push_back({dll.path, outdated_crt});
                     break;
                 }
             }
@@ -690,16 +745,11 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_no_files_in_dir(const Files::Filesystem& fs, const fs::path& dir)
+    static LintStatus check_no_files_in_dir(const PackageManifest& manifest, const fs::path& dir)
     {
-        std::vector<fs::path> misplaced_files = fs.get_files_non_recursive(dir);
-        Util::unstable_keep_if(misplaced_files, [&fs](const fs::path& path) {
-            const std::string filename = path.filename().generic_string();
-            if (Strings::case_insensitive_ascii_compare(filename.c_str(), "CONTROL") == 0 ||
-                Strings::case_insensitive_ascii_compare(filename.c_str(), "BUILD_INFO") == 0)
-                return false;
-            return !fs.is_directory(path);
-        });
+        std::vector<fs::path> misplaced_files = manifest.files_in(dir);
+        Util::unstable_keep_if(misplaced_files,
+                               [](const fs::path& path) { return !Files::is_package_metadata_file(path); });
 
         if (!misplaced_files.empty())
         {
@@ -721,8 +771,6 @@ namespace vcpkg::PostBuildLint
     {
         const auto& fs = paths.get_filesystem();
 
-        // for dumpbin
-        const Toolset& toolset = paths.get_toolset(pre_build_info.platform_toolset);
         const fs::path package_dir = paths.package_dir(spec);
 
         size_t error_count = 0;
@@ -732,63 +780,73 @@ namespace vcpkg::PostBuildLint
             return error_count;
         }
 
+        // Enumerate the package once; the checks below only consult this manifest
+        const PackageManifest manifest = PackageManifest::enumerate(fs, package_dir);
+
         error_count += check_for_files_in_include_directory(fs, build_info.policies, package_dir);
-        error_count += check_for_files_in_debug_include_directory(fs, package_dir);
+        error_count += check_for_files_in_debug_include_directory(manifest, package_dir);
         error_count += check_for_files_in_debug_share_directory(fs, package_dir);
         error_count += check_folder_lib_cmake(fs, package_dir, spec);
-        error_count += check_for_misplaced_cmake_files(fs, package_dir, spec);
+        error_count += check_for_misplaced_cmake_files(manifest, package_dir, spec);
         error_count += check_folder_debug_lib_cmake(fs, package_dir, spec);
-        error_count += check_for_dlls_in_lib_dir(fs, package_dir);
-        error_count += check_for_dlls_in_lib_dir(fs, package_dir / "debug");
+        error_count += check_for_dlls_in_lib_dir(manifest, package_dir);
+        error_count += check_for_dlls_in_lib_dir(manifest, package_dir / "debug");
         error_count += check_for_copyright_file(fs, spec, paths);
-        error_count += check_for_exes(fs, package_dir);
-        error_count += check_for_exes(fs, package_dir / "debug");
+        error_count += check_for_exes(manifest, package_dir);
+        error_count += check_for_exes(manifest, package_dir / "debug");
 
         const fs::path debug_lib_dir = package_dir / "debug" / "lib";
         const fs::path release_lib_dir = package_dir / "lib";
         const fs::path debug_bin_dir = package_dir / "debug" / "bin";
         const fs::path release_bin_dir = package_dir / "bin";
 
-        std::vector<fs::path> debug_libs = fs.get_files_recursive(debug_lib_dir);
-        Util::unstable_keep_if(debug_libs, has_extension_pred(fs, ".lib"));
-        std::vector<fs::path> release_libs = fs.get_files_recursive(release_lib_dir);
-        Util::unstable_keep_if(release_libs, has_extension_pred(fs, ".lib"));
+        const std::vector<fs::path> debug_libs = manifest.files_under(debug_lib_dir, ".lib");
+        const std::vector<fs::path> release_libs = manifest.files_under(release_lib_dir, ".lib");
 
-        error_count += check_matching_debug_and_release_binaries(debug_libs, release_libs);
+        // A triplet which builds a single configuration has no debug binaries to match
+        const bool both_configurations = !pre_build_info.build_type.has_value();
+        if (both_configurations) error_count += check_matching_debug_and_release_binaries(debug_libs, release_libs);
 
-        {
-            std::vector<fs::path> libs;
-            libs.insert(libs.cend(), debug_libs.cbegin(), debug_libs.cend());
-            libs.insert(libs.cend(), release_libs.cbegin(), release_libs.cend());
+        // Debug libs first, then release libs
+        std::vector<fs::path> lib_paths;
+        lib_paths.insert(lib_paths.cend(), debug_libs.cbegin(), debug_libs.cend());
+        lib_paths.insert(lib_paths.cend(), release_libs.cbegin(), release_libs.cend());
+        // Only the binaries which changed since the last lint of the port are read
+        const fs::path inspection_cache_path =
+            paths.buildtrees / spec.name() / (spec.triplet().canonical_name() + ".vcpkg_lint_cache.txt");
+        InspectionCache inspection_cache = InspectionCache::load(fs, inspection_cache_path);
+        const std::vector<LibFile> libs = with_paths<LibFile>(lib_paths, inspection_cache.read_libs(fs, lib_paths));
 
-            error_count += check_lib_architecture(pre_build_info.target_architecture, libs);
-        }
+        error_count += check_lib_architecture(pre_build_info.target_architecture, libs);
 
-        std::vector<fs::path> debug_dlls = fs.get_files_recursive(debug_bin_dir);
-        Util::unstable_keep_if(debug_dlls, has_extension_pred(fs, ".dll"));
-        std::vector<fs::path> release_dlls = fs.get_files_recursive(release_bin_dir);
-        Util::unstable_keep_if(release_dlls, has_extension_pred(fs, ".dll"));
+        const std::vector<fs::path> debug_dlls = manifest.files_under(debug_bin_dir, ".dll");
+        const std::vector<fs::path> release_dlls = manifest.files_under(release_bin_dir, ".dll");
 
         switch (build_info.library_linkage)
         {
             case Build::LinkageType::DYNAMIC:
             {
-                error_count += check_matching_debug_and_release_binaries(debug_dlls, release_dlls);
+                if (both_configurations)
+                {
+                    error_count += check_matching_debug_and_release_binaries(debug_dlls, release_dlls);
+                }
 
                 error_count += check_lib_files_are_available_if_dlls_are_available(
                     build_info.policies, debug_libs.size(), debug_dlls.size(), debug_lib_dir);
                 error_count += check_lib_files_are_available_if_dlls_are_available(
                     build_info.policies, release_libs.size(), release_dlls.size(), release_lib_dir);
 
-                std::vector<fs::path> dlls;
-                dlls.insert(dlls.cend(), debug_dlls.cbegin(), debug_dlls.cend());
-                dlls.insert(dlls.cend(), release_dlls.cbegin(), release_dlls.cend());
+                std::vector<fs::path> dll_paths;
+                dll_paths.insert(dll_paths.cend(), debug_dlls.cbegin(), debug_dlls.cend());
+                dll_paths.insert(dll_paths.cend(), release_dlls.cbegin(), release_dlls.cend());
+                const std::vector<DllFile> dlls =
+                    with_paths<DllFile>(dll_paths, inspection_cache.read_dlls(fs, dll_paths));
 
-                error_count += check_exports_of_dlls(dlls, toolset.dumpbin);
-                error_count += check_uwp_bit_of_dlls(pre_build_info.cmake_system_name, dlls, toolset.dumpbin);
+                error_count += check_exports_of_dlls(dlls);
+                error_count += check_uwp_bit_of_dlls(pre_build_info.cmake_system_name, dlls);
                 error_count += check_dll_architecture(pre_build_info.target_architecture, dlls);
 
-                error_count += check_outdated_crt_linkage_of_dlls(dlls, toolset.dumpbin, build_info);
+                error_count += check_outdated_crt_linkage_of_dlls(dlls, build_info);
                 break;
             }
             case Build::LinkageType::STATIC:
@@ -799,26 +857,25 @@ namespace vcpkg::PostBuildLint
 
                 error_count += check_bin_folders_are_not_present_in_static_build(fs, package_dir);
 
+                const span<const LibFile> debug_lib_files(libs.data(), debug_libs.size());
+                const span<const LibFile> release_lib_files(libs.data() + debug_libs.size(), release_libs.size());
                 if (!build_info.policies.is_enabled(BuildPolicy::ONLY_RELEASE_CRT))
                 {
-                    error_count +=
-                        check_crt_linkage_of_libs(BuildType::value_of(ConfigurationType::DEBUG, build_info.crt_linkage),
-                                                  debug_libs,
-                                                  toolset.dumpbin);
+                    error_count += check_crt_linkage_of_libs(
+                        BuildType::value_of(ConfigurationType::DEBUG, build_info.crt_linkage), debug_lib_files);
                 }
-                error_count +=
-                    check_crt_linkage_of_libs(BuildType::value_of(ConfigurationType::RELEASE, build_info.crt_linkage),
-                                              release_libs,
-                                              toolset.dumpbin);
+                error_count += check_crt_linkage_of_libs(
+                    BuildType::value_of(ConfigurationType::RELEASE, build_info.crt_linkage), release_lib_files);
                 break;
             }
             default: Checks::unreachable(VCPKG_LINE_INFO);
         }
 
-        error_count += check_no_empty_folders(fs, package_dir);
-        error_count += check_no_files_in_dir(fs, package_dir);
-        error_count += check_no_files_in_dir(fs, package_dir / "debug");
+        error_count += check_no_empty_folders(manifest, package_dir);
+        error_count += check_no_files_in_dir(manifest, package_dir);
+        error_count += check_no_files_in_dir(manifest, package_dir / "debug");
 
+        inspection_cache.save(paths.get_filesystem(), inspection_cache_path);
         return error_count;
     }
 
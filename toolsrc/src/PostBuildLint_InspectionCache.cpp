@@ -0,0 +1,260 @@
+#include "pch.h"
+
+#include "PostBuildLint_InspectionCache.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+
+// The cache is a text file:
+//     vcpkg lint cache 1
+// followed by a record per binary, which starts with
+//     binary <size> <last write time> <sha1> <path>
+// and continues with what was read from it:
+//     dll <machine type> <has exports> <is app container>
+//     dependent <name>
+//     pdb <path>
+// or
+//     lib
+//     machine <machine type>
+//     directive <directive>
+namespace vcpkg::PostBuildLint
+{
+    using CoffFileReader::DllInfo;
+    using CoffFileReader::LibInfo;
+
+    static constexpr auto CACHE_HEADER = "vcpkg lint cache 1";
+
+    static std::string get_last_write_time(const Files::Filesystem& fs, const fs::path& path)
+    {
+        std::error_code ec;
+        const fs::file_time_type time = fs.last_write_time(path, ec);
+        if (ec) return Strings::EMPTY;
+        return std::to_string(time.time_since_epoch().count());
+    }
+
+    static Optional<uint64_t> parse_number(const std::string& text)
+    {
+        const bool is_number =
+            !text.empty() && text.size() <= 19 && std::all_of(text.cbegin(), text.cend(), [](const char c) {
+                return isdigit(static_cast<unsigned char>(c)) != 0;
+            });
+        if (!is_number) return nullopt;
+        return std::stoull(text);
+    }
+
+    static bool has_line_break(const std::string& text) { return text.find_first_of("\r\n") != std::string::npos; }
+
+    // Each string of the record goes on a line of its own
+    static bool is_representable(const InspectedBinary& binary)
+    {
+        if (has_line_break(binary.path.generic_u8string())) return false;
+        if (const auto dll = binary.dll.get())
+        {
+            if (has_line_break(dll->pdb_path)) return false;
+            if (std::any_of(dll->dependents.cbegin(), dll->dependents.cend(), has_line_break)) return false;
+        }
+        if (const auto lib = binary.lib.get())
+        {
+            if (std::any_of(lib->linker_directives.cbegin(), lib->linker_directives.cend(), has_line_break))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    InspectionCache InspectionCache::load(const Files::Filesystem& fs, const fs::path& cache_file)
+    {
+        const Expected<std::string> text = fs.read_contents(cache_file);
+        if (!text.has_value()) return InspectionCache();
+        return parse(*text.get());
+    }
+
+    InspectionCache InspectionCache::parse(const std::string& text)
+    {
+        const std::vector<std::string> lines = Strings::split(text, "\n");
+        if (lines.empty() || lines.front() != CACHE_HEADER) return InspectionCache();
+
+        InspectionCache cache;
+        std::vector<InspectedBinary>& binaries = cache.m_loaded;
+        for (auto it = lines.cbegin() + 1; it != lines.cend(); ++it)
+        {
+            const std::string& line = *it;
+            if (line.empty()) continue;
+
+            const size_t space = line.find(' ');
+            const std::string tag = line.substr(0, space);
+            const std::string rest = space == std::string::npos ? std::string() : line.substr(space + 1);
+            InspectedBinary* const binary = binaries.empty() ? nullptr : &binaries.back();
+            DllInfo* const dll = binary ? binary->dll.get() : nullptr;
+            LibInfo* const lib = binary ? binary->lib.get() : nullptr;
+
+            if (tag == "binary")
+            {
+                const size_t time_begin = rest.find(' ');
+                const size_t sha1_begin = time_begin == std::string::npos ? rest.npos : rest.find(' ', time_begin + 1);
+                const size_t path_begin = sha1_begin == std::string::npos ? rest.npos : rest.find(' ', sha1_begin + 1);
+                if (path_begin == std::string::npos) return InspectionCache();
+
+                const Optional<uint64_t> size = parse_number(rest.substr(0, time_begin));
+                if (!size.has_value()) return InspectionCache();
+
+                InspectedBinary parsed;
+                parsed.size = *size.get();
+                parsed.last_write_time = rest.substr(time_begin + 1, sha1_begin - time_begin - 1);
+                parsed.sha1 = rest.substr(sha1_begin + 1, path_begin - sha1_begin - 1);
+                parsed.path = Strings::to_utf16(rest.substr(path_begin + 1));
+                binaries.push_back(std::move(parsed));
+            }
+            else if (tag == "dll" && binary && !binary->dll && !binary->lib)
+            {
+                const std::vector<std::string> fields = Strings::split(rest, " ");
+                if (fields.size() != 3) return InspectionCache();
+                const Optional<uint64_t> machine_type = parse_number(fields[0]);
+                if (!machine_type.has_value() || *machine_type.get() > UINT16_MAX) return InspectionCache();
+
+                DllInfo info;
+                info.machine_type = static_cast<MachineType>(*machine_type.get());
+                info.has_exports = fields[1] == "1";
+                info.is_app_container = fields[2] == "1";
+                binary->dll = std::move(info);
+            }
+            else if (tag == "dependent" && dll)
+            {
+                dll->dependents.push_back(rest);
+            }
+            else if (tag == "pdb" && dll)
+            {
+                dll->pdb_path = rest;
+            }
+            else if (tag == "lib" && binary && !binary->dll && !binary->lib)
+            {
+                binary->lib = LibInfo();
+            }
+            else if (tag == "machine" && lib)
+            {
+                const Optional<uint64_t> machine_type = parse_number(rest);
+                if (!machine_type.has_value() || *machine_type.get() > UINT16_MAX) return InspectionCache();
+                lib->machine_types.push_back(static_cast<MachineType>(*machine_type.get()));
+            }
+            else if (tag == "directive" && lib)
+            {
+                lib->linker_directives.push_back(rest);
+            }
+            else
+            {
+                return InspectionCache();
+            }
+        }
+
+        return cache;
+    }
+
+    std::string InspectionCache::serialize() const
+    {
+        std::string text = CACHE_HEADER;
+        text.push_back('\n');
+        for (const InspectedBinary& binary : m_inspected)
+        {
+            if (!is_representable(binary)) continue;
+
+            text.append(Strings::format("binary %s %s %s %s\n",
+                                        std::to_string(binary.size),
+                                        binary.last_write_time,
+                                        binary.sha1,
+                                        binary.path.generic_u8string()));
+            if (const auto dll = binary.dll.get())
+            {
+                text.append(Strings::format("dll %d %d %d\n",
+                                            static_cast<int>(dll->machine_type),
+                                            dll->has_exports ? 1 : 0,
+                                            dll->is_app_container ? 1 : 0));
+                for (const std::string& dependent : dll->dependents)
+                    text.append(Strings::format("dependent %s\n", dependent));
+                text.append(Strings::format("pdb %s\n", dll->pdb_path));
+            }
+            if (const auto lib = binary.lib.get())
+            {
+                text.append("lib\n");
+                for (const MachineType machine_type : lib->machine_types)
+                    text.append(Strings::format("machine %d\n", static_cast<int>(machine_type)));
+                for (const std::string& directive : lib->linker_directives)
+                    text.append(Strings::format("directive %s\n", directive));
+            }
+        }
+        return text;
+    }
+
+    void InspectionCache::save(Files::Filesystem& fs, const fs::path& cache_file) const
+    {
+        std::error_code ec;
+        fs.create_directories(cache_file.parent_path(), ec);
+        const fs::path tmp_path = cache_file.parent_path() / (cache_file.filename().u8string() + ".tmp");
+        fs.write_contents(tmp_path, serialize());
+        fs.rename(tmp_path, cache_file, ec);
+    }
+
+    template<class Info, class Read>
+    static std::vector<Info> read_with_cache(const Files::Filesystem& fs,
+                                             const std::vector<fs::path>& paths,
+                                             const std::vector<InspectedBinary>& loaded,
+                                             std::vector<InspectedBinary>& inspected,
+                                             Optional<Info> InspectedBinary::*member,
+                                             Read read)
+    {
+        std::map<fs::path, const InspectedBinary*> loaded_by_path;
+        std::unordered_map<std::string, const InspectedBinary*> loaded_by_sha1;
+        for (const InspectedBinary& binary : loaded)
+        {
+            if (!(binary.*member).has_value()) continue;
+            loaded_by_path.emplace(binary.path, &binary);
+            loaded_by_sha1.emplace(binary.sha1, &binary);
+        }
+
+        std::vector<Info> infos(paths.size());
+        std::vector<InspectedBinary> binaries(paths.size());
+        Util::parallel_for_each_index(paths.size(), [&](const size_t i) {
+            InspectedBinary& binary = binaries[i];
+            binary.path = paths[i];
+            std::error_code ec;
+            binary.size = fs.file_size(paths[i], ec);
+            binary.last_write_time = ec ? Strings::EMPTY : get_last_write_time(fs, paths[i]);
+
+            // An incremental build leaves the binaries it did not relink as they were
+            const auto by_path = loaded_by_path.find(paths[i]);
+            if (by_path != loaded_by_path.cend() && !binary.last_write_time.empty() &&
+                by_path->second->size == binary.size && by_path->second->last_write_time == binary.last_write_time)
+            {
+                binary.sha1 = by_path->second->sha1;
+                infos[i] = *(by_path->second->*member).get();
+            }
+            else
+            {
+                // A binary which was written again, or restored, is known by its contents
+                binary.sha1 = Commands::Hash::get_file_hash(paths[i], "SHA1");
+                const auto by_sha1 = loaded_by_sha1.find(binary.sha1);
+                if (by_sha1 != loaded_by_sha1.cend())
+                    infos[i] = *(by_sha1->second->*member).get();
+                else
+                    infos[i] = read(paths[i]);
+            }
+
+            binary.*member = infos[i];
+        });
+
+        inspected.insert(inspected.cend(),
+                         std::make_move_iterator(binaries.begin()),
+                         std::make_move_iterator(binaries.end()));
+        return infos;
+    }
+
+    std::vector<DllInfo> InspectionCache::read_dlls(const Files::Filesystem& fs, const std::vector<fs::path>& paths)
+    {
+        return read_with_cache(fs, paths, m_loaded, m_inspected, &InspectedBinary::dll, CoffFileReader::read_dll);
+    }
+
+    std::vector<LibInfo> InspectionCache::read_libs(const Files::Filesystem& fs, const std::vector<fs::path>& paths)
+    {
+        return read_with_cache(fs, paths, m_loaded, m_inspected, &InspectedBinary::lib, CoffFileReader::read_lib);
+    }
+}
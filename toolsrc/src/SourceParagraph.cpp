@@ -16,6 +16,8 @@ namespace vcpkg
     namespace Fields
     {
         static const std::string BUILD_DEPENDS = "Build-Depends";
+        static const std::string BUILD_MEMORY = "Build-Memory";
+        static const std::string CHANGES_ABI = "Changes-ABI";
         static const std::string DEFAULTFEATURES = "Default-Features";
         static const std::string DESCRIPTION = "Description";
         static const std::string FEATURE = "Feature";
@@ -25,6 +27,26 @@ namespace vcpkg
         static const std::string VERSION = "Version";
     }
 
+    static constexpr std::string_view SOURCE_FIELD_NAMES[] = {
+        "Source",
+        "Version",
+        "Description",
+        "Maintainer",
+        "Build-Depends",
+        "Supports",
+        "Default-Features",
+        "Build-Memory",
+    };
+    static constexpr Parse::FieldTable SOURCE_FIELDS(SOURCE_FIELD_NAMES);
+
+    static constexpr std::string_view FEATURE_FIELD_NAMES[] = {
+        "Feature",
+        "Description",
+        "Build-Depends",
+        "Changes-ABI",
+    };
+    static constexpr Parse::FieldTable FEATURE_FIELDS(FEATURE_FIELD_NAMES);
+
     static span<const std::string> get_list_of_valid_fields()
     {
         static const std::string valid_fields[] = {
@@ -33,6 +55,7 @@ namespace vcpkg
             Fields::DESCRIPTION,
             Fields::MAINTAINER,
             Fields::BUILD_DEPENDS,
+            Fields::BUILD_MEMORY,
         };
 
         return valid_fields;
@@ -86,9 +109,9 @@ namespace vcpkg
         }
     }
 
-    static ParseExpected<SourceParagraph> parse_source_paragraph(RawParagraph&& fields)
+    static ParseExpected<SourceParagraph> parse_source_paragraph(const ParagraphView& fields)
     {
-        ParagraphParser parser(std::move(fields));
+        ParagraphParser parser(fields, SOURCE_FIELDS);
 
         auto spgh = std::make_unique<SourceParagraph>();
 
@@ -101,6 +124,19 @@ namespace vcpkg
         spgh->supports = parse_comma_list(parser.optional_field(Fields::SUPPORTS));
         spgh->default_features = parse_comma_list(parser.optional_field(Fields::DEFAULTFEATURES));
 
+        const std::string build_memory = parser.optional_field(Fields::BUILD_MEMORY);
+        if (!build_memory.empty())
+        {
+            const int parsed_memory = atoi(build_memory.c_str());
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               parsed_memory > 0,
+                               "Error: %s of %s must be a positive number of MiB, but was '%s'",
+                               Fields::BUILD_MEMORY,
+                               spgh->name,
+                               build_memory);
+            spgh->build_memory_mib = static_cast<size_t>(parsed_memory);
+        }
+
         auto err = parser.error_info(spgh->name);
         if (err)
             return std::move(err);
@@ -108,9 +144,9 @@ namespace vcpkg
             return std::move(spgh);
     }
 
-    static ParseExpected<FeatureParagraph> parse_feature_paragraph(RawParagraph&& fields)
+    static ParseExpected<FeatureParagraph> parse_feature_paragraph(const ParagraphView& fields)
     {
-        ParagraphParser parser(std::move(fields));
+        ParagraphParser parser(fields, FEATURE_FIELDS);
 
         auto fpgh = std::make_unique<FeatureParagraph>();
 
@@ -119,6 +155,15 @@ namespace vcpkg
 
         fpgh->depends = expand_qualified_dependencies(parse_comma_list(parser.optional_field(Fields::BUILD_DEPENDS)));
 
+        const std::string changes_abi = parser.optional_field(Fields::CHANGES_ABI);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           changes_abi.empty() || changes_abi == "yes" || changes_abi == "no",
+                           "Error: %s of feature %s must be yes or no, but was '%s'",
+                           Fields::CHANGES_ABI,
+                           fpgh->name,
+                           changes_abi);
+        fpgh->changes_abi = changes_abi == "yes";
+
         auto err = parser.error_info(fpgh->name);
         if (err)
             return std::move(err);
@@ -128,6 +173,12 @@ namespace vcpkg
 
     ParseExpected<SourceControlFile> SourceControlFile::parse_control_file(
         std::vector<std::unordered_map<std::string, std::string>>&& control_paragraphs)
+    {
+        return parse_control_file(Util::fmap(control_paragraphs, to_paragraph_view));
+    }
+
+    ParseExpected<SourceControlFile> SourceControlFile::parse_control_file(
+        const std::vector<ParagraphView>& control_paragraphs)
     {
         if (control_paragraphs.size() == 0)
         {
@@ -136,17 +187,16 @@ namespace vcpkg
 
         auto control_file = std::make_unique<SourceControlFile>();
 
-        auto maybe_source = parse_source_paragraph(std::move(control_paragraphs.front()));
+        auto maybe_source = parse_source_paragraph(control_paragraphs.front());
         if (const auto source = maybe_source.get())
             control_file->core_paragraph = std::move(*source);
         else
             return std::move(maybe_source).error();
 
-        control_paragraphs.erase(control_paragraphs.begin());
-
-        for (auto&& feature_pgh : control_paragraphs)
+        control_file->feature_paragraphs.reserve(control_paragraphs.size() - 1);
+        for (auto it = std::next(control_paragraphs.cbegin()); it != control_paragraphs.cend(); ++it)
         {
-            auto maybe_feature = parse_feature_paragraph(std::move(feature_pgh));
+            auto maybe_feature = parse_feature_paragraph(*it);
             if (const auto feature = maybe_feature.get())
                 control_file->feature_paragraphs.emplace_back(std::move(*feature));
             else
@@ -159,15 +209,25 @@ namespace vcpkg
     Dependency Dependency::parse_dependency(std::string name, std::string qualifier)
     {
         Dependency dep;
-        dep.qualifier = qualifier;
+        dep.qualifier = std::move(qualifier);
         if (auto maybe_features = Features::from_string(name))
-            dep.depend = *maybe_features.get();
+            dep.depend = std::move(*maybe_features.get());
         else
             Checks::exit_with_message(
                 VCPKG_LINE_INFO, "error while parsing dependency: %s: %s", to_string(maybe_features.error()), name);
         return dep;
     }
 
+    static const std::string HOST_QUALIFIER = "host";
+
+    bool Dependency::applies_to(const Triplet& t) const
+    {
+        if (this->is_host()) return false;
+        return this->qualifier.empty() || t.canonical_name().find(this->qualifier) != std::string::npos;
+    }
+
+    bool Dependency::is_host() const { return this->qualifier == HOST_QUALIFIER; }
+
     std::string Dependency::name() const
     {
         if (this->depend.features.empty()) return this->depend.name;
@@ -200,7 +260,7 @@ namespace vcpkg
         std::vector<std::string> ret;
         for (auto&& dep : deps)
         {
-            if (dep.qualifier.empty() || t.canonical_name().find(dep.qualifier) != std::string::npos)
+            if (dep.applies_to(t))
             {
                 ret.emplace_back(dep.name());
             }
@@ -208,9 +268,49 @@ namespace vcpkg
         return ret;
     }
 
+    std::vector<PackageSpec> filter_host_dependencies(const std::vector<Dependency>& deps)
+    {
+        std::vector<PackageSpec> ret;
+        for (auto&& dep : deps)
+        {
+            if (!dep.is_host()) continue;
+            ret.push_back(PackageSpec::from_name_and_triplet(dep.depend.name, Triplet::host())
+                              .value_or_exit(VCPKG_LINE_INFO));
+        }
+        return ret;
+    }
+
     std::vector<FeatureSpec> filter_dependencies_to_specs(const std::vector<Dependency>& deps, const Triplet& t)
     {
-        return FeatureSpec::from_strings_and_triplet(filter_dependencies(deps, t), t);
+        // The dependencies were parsed with the control file, so they need not be formatted and parsed again
+        std::vector<FeatureSpec> f_specs;
+        for (auto&& dep : deps)
+        {
+            if (!dep.applies_to(t) && !dep.is_host()) continue;
+
+            const PackageSpec pspec =
+                PackageSpec::from_name_and_triplet(dep.depend.name, dep.is_host() ? Triplet::host() : t)
+                    .value_or_exit(VCPKG_LINE_INFO);
+            for (auto&& feature : dep.depend.features)
+                f_specs.push_back(FeatureSpec{pspec, feature});
+
+            if (dep.depend.features.empty()) f_specs.push_back(FeatureSpec{pspec, Strings::EMPTY});
+        }
+        return f_specs;
+    }
+
+    const ResolvedDependencies& SourceControlFile::resolve_dependencies(const Triplet& triplet) const
+    {
+        const auto it = m_resolved_dependencies.find(triplet);
+        if (it != m_resolved_dependencies.cend()) return it->second;
+
+        ResolvedDependencies resolved;
+        resolved.core = filter_dependencies_to_specs(this->core_paragraph->depends, triplet);
+        for (auto&& feature : this->feature_paragraphs)
+        {
+            resolved.features.emplace(feature->name, filter_dependencies_to_specs(feature->depends, triplet));
+        }
+        return m_resolved_dependencies.emplace(triplet, std::move(resolved)).first->second;
     }
 
     std::string to_string(const Dependency& dep) { return dep.name(); }
@@ -13,25 +13,52 @@ namespace vcpkg
 
     StatusParagraph::StatusParagraph() : want(Want::ERROR_STATE), state(InstallState::ERROR_STATE) {}
 
+    static const std::string STATUS_OK = " ok ";
+
+    size_t serialized_size(const StatusParagraph& pgh)
+    {
+        return serialized_size(pgh.package) + BinaryParagraphRequiredField::STATUS.size() + 2 +
+               to_string(pgh.want).size() + STATUS_OK.size() + to_string(pgh.state).size() + 1;
+    }
+
     void serialize(const StatusParagraph& pgh, std::string& out_str)
     {
         serialize(pgh.package, out_str);
-        out_str.append("Status: ")
+        out_str.append(BinaryParagraphRequiredField::STATUS)
+            .append(": ")
             .append(to_string(pgh.want))
-            .append(" ok ")
+            .append(STATUS_OK)
             .append(to_string(pgh.state))
             .push_back('\n');
     }
 
     StatusParagraph::StatusParagraph(std::unordered_map<std::string, std::string>&& fields)
+        : StatusParagraph(to_paragraph_view(fields))
     {
-        auto status_it = fields.find(BinaryParagraphRequiredField::STATUS);
-        Checks::check_exit(VCPKG_LINE_INFO, status_it != fields.end(), "Expected 'Status' field in status paragraph");
-        std::string status_field = std::move(status_it->second);
-        fields.erase(status_it);
+    }
 
-        this->package = BinaryParagraph(std::move(fields));
+    StatusParagraph::StatusParagraph(const ParagraphView& fields)
+    {
+        ParagraphView package_fields;
+        package_fields.fields.reserve(fields.fields.size());
+        const ParagraphView::Field* status = nullptr;
+        for (auto&& field : fields.fields)
+        {
+            if (field.name == BinaryParagraphRequiredField::STATUS)
+                status = &field;
+            else
+                package_fields.fields.push_back(field);
+        }
+
+        Checks::check_exit(VCPKG_LINE_INFO, status != nullptr, "Expected 'Status' field in status paragraph");
+        const std::string status_field = normalize_field_value(status->value);
+
+        this->package = BinaryParagraph(package_fields);
+        std::tie(want, state) = parse_status_field(status_field);
+    }
 
+    std::pair<Want, InstallState> parse_status_field(const std::string& status_field)
+    {
         auto b = status_field.begin();
         const auto mark = b;
         const auto e = status_field.end();
@@ -40,7 +67,7 @@ namespace vcpkg
         while (b != e && *b != ' ')
             ++b;
 
-        want = [](const std::string& text) {
+        const Want want = [](const std::string& text) {
             if (text == "unknown") return Want::UNKNOWN;
             if (text == "install") return Want::INSTALL;
             if (text == "hold") return Want::HOLD;
@@ -49,15 +76,17 @@ namespace vcpkg
             return Want::ERROR_STATE;
         }(std::string(mark, b));
 
-        if (std::distance(b, e) < 4) return;
+        if (std::distance(b, e) < 4) return {want, InstallState::ERROR_STATE};
         b += 4;
 
-        state = [](const std::string& text) {
+        const InstallState state = [](const std::string& text) {
             if (text == "not-installed") return InstallState::NOT_INSTALLED;
             if (text == "installed") return InstallState::INSTALLED;
             if (text == "half-installed") return InstallState::HALF_INSTALLED;
             return InstallState::ERROR_STATE;
         }(std::string(b, e));
+
+        return {want, state};
     }
 
     std::string to_string(InstallState f)
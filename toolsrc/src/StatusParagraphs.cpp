@@ -2,88 +2,226 @@
 
 #include "StatusParagraphs.h"
 #include "vcpkg_Checks.h"
+#include "vcpkg_Util.h"
 #include <algorithm>
 
 namespace vcpkg
 {
+    namespace Fields
+    {
+        static const std::string PACKAGE = "Package";
+        static const std::string ARCHITECTURE = "Architecture";
+        static const std::string FEATURE = "Feature";
+        static const std::string STATUS = "Status";
+    }
+
     StatusParagraphs::StatusParagraphs() = default;
 
+    // The blocks for the paragraphs which are parsed or inserted after the database was created
+    static constexpr size_t STORAGE_BLOCK_SIZE = 64;
+
+    static std::string_view find_field(const Parse::ParagraphView& view, const std::string& name)
+    {
+        const auto it = Util::find_if(view.fields, [&](const Parse::ParagraphView::Field& field) {
+            return field.name == name;
+        });
+        return it == view.fields.cend() ? std::string_view() : it->value;
+    }
+
+    StatusParagraphs::StatusParagraphs(Paragraphs::ParagraphViews&& views) : pending_buffer(std::move(views.buffer))
+    {
+        paragraphs.reserve(views.paragraphs.size());
+        pending.reserve(views.paragraphs.size());
+        for (auto&& view : views.paragraphs)
+        {
+            const std::string_view name = find_field(view, Fields::PACKAGE);
+            const std::string_view architecture = find_field(view, Fields::ARCHITECTURE);
+            const std::string_view status = find_field(view, Fields::STATUS);
+            const auto maybe_spec = PackageSpec::from_name_and_triplet(
+                std::string(name), Triplet::from_canonical_name(std::string(architecture)));
+            const auto spec = maybe_spec.get();
+
+            const std::string_view feature = find_field(view, Fields::FEATURE);
+            const auto parsed_status = parse_status_field(Parse::normalize_field_value(status));
+            pending.push_back({std::move(view), feature, parsed_status.first, parsed_status.second});
+            paragraphs.push_back(nullptr);
+
+            // Parsing the paragraph now reports what is wrong with it
+            if (name.empty() || architecture.empty() || status.empty() || !spec)
+            {
+                at(paragraphs.size() - 1);
+                continue;
+            }
+
+            add_to_index(paragraphs.size() - 1, *spec);
+        }
+    }
+
+    StatusParagraphs::StatusParagraphs(std::vector<StatusParagraph>&& ps)
+    {
+        storage.push_back(std::move(ps));
+        paragraphs.reserve(storage.back().size());
+        for (StatusParagraph& pgh : storage.back())
+        {
+            paragraphs.push_back(&pgh);
+            add_to_index(paragraphs.size() - 1, pgh.package.spec);
+        }
+    }
+
     StatusParagraphs::StatusParagraphs(std::vector<std::unique_ptr<StatusParagraph>>&& ps)
-        : paragraphs(std::move(ps)){};
+        : StatusParagraphs(Util::fmap(ps, [](std::unique_ptr<StatusParagraph>& pgh) { return std::move(*pgh); }))
+    {
+    }
+
+    StatusParagraph* StatusParagraphs::allocate(StatusParagraph&& pgh) const
+    {
+        if (storage.empty() || storage.back().size() == storage.back().capacity())
+        {
+            storage.emplace_back();
+            storage.back().reserve(STORAGE_BLOCK_SIZE);
+        }
+
+        storage.back().push_back(std::move(pgh));
+        return &storage.back().back();
+    }
+
+    StatusParagraph* StatusParagraphs::at(const size_t position) const
+    {
+        StatusParagraph*& pgh = paragraphs[position];
+        if (pgh == nullptr) pgh = allocate(StatusParagraph(pending[position].view));
+        return pgh;
+    }
+
+    const StatusParagraphs::IndexEntries* StatusParagraphs::find_index_entries(const std::string& name,
+                                                                                const Triplet& triplet) const
+    {
+        const auto triplet_it = index.find(triplet);
+        if (triplet_it == index.cend()) return nullptr;
+
+        const auto name_it = triplet_it->second.find(name);
+        if (name_it == triplet_it->second.cend()) return nullptr;
+
+        return &name_it->second;
+    }
+
+    void StatusParagraphs::add_to_index(const size_t position, const PackageSpec& spec)
+    {
+        index[spec.triplet()][spec.name()].push_back(position);
+    }
+
+    bool StatusParagraphs::is_installed(const size_t position) const
+    {
+        if (const StatusParagraph* pgh = paragraphs[position])
+        {
+            return pgh->want == Want::INSTALL && pgh->state == InstallState::INSTALLED;
+        }
+
+        return pending[position].want == Want::INSTALL && pending[position].state == InstallState::INSTALLED;
+    }
 
     StatusParagraphs::const_iterator StatusParagraphs::find(const std::string& name, const Triplet& triplet) const
     {
-        return std::find_if(begin(), end(), [&](const std::unique_ptr<StatusParagraph>& pgh) {
-            const PackageSpec& spec = pgh->package.spec;
-            return spec.name() == name && spec.triplet() == triplet;
-        });
+        const IndexEntries* entries = find_index_entries(name, triplet);
+        if (entries == nullptr) return end();
+        return to_iterator(entries->back());
     }
 
     StatusParagraphs::iterator StatusParagraphs::find(const std::string& name, const Triplet& triplet)
     {
-        return std::find_if(begin(), end(), [&](const std::unique_ptr<StatusParagraph>& pgh) {
-            const PackageSpec& spec = pgh->package.spec;
-            return spec.name() == name && spec.triplet() == triplet;
-        });
+        const IndexEntries* entries = find_index_entries(name, triplet);
+        if (entries == nullptr) return end();
+        return to_iterator(entries->back());
     }
 
-    std::vector<std::unique_ptr<StatusParagraph>*> StatusParagraphs::find_all(const std::string& name,
-                                                                              const Triplet& triplet)
+    std::vector<StatusParagraph*> StatusParagraphs::find_all(const std::string& name, const Triplet& triplet)
     {
-        std::vector<std::unique_ptr<StatusParagraph>*> spghs;
-        for (auto&& p : *this)
+        std::vector<StatusParagraph*> spghs;
+        if (const IndexEntries* entries = find_index_entries(name, triplet))
         {
-            if (p->package.spec.name() == name && p->package.spec.triplet() == triplet)
+            for (auto it = entries->crbegin(); it != entries->crend(); ++it)
             {
-                spghs.emplace_back(&p);
+                spghs.emplace_back(at(*it));
             }
         }
         return spghs;
     }
 
+    Optional<size_t> StatusParagraphs::find_position(const std::string& name,
+                                                     const Triplet& triplet,
+                                                     const std::string& feature) const
+    {
+        const IndexEntries* entries = find_index_entries(name, triplet);
+        if (entries == nullptr) return nullopt;
+
+        // A package has only a handful of features, so a scan of its entries is cheaper than another map
+        const auto it = std::find_if(entries->crbegin(), entries->crend(), [&](const size_t position) {
+            if (const StatusParagraph* pgh = paragraphs[position]) return pgh->package.feature == feature;
+            return pending[position].feature == feature;
+        });
+        if (it == entries->crend()) return nullopt;
+        return *it;
+    }
+
     StatusParagraphs::iterator StatusParagraphs::find(const std::string& name,
                                                       const Triplet& triplet,
                                                       const std::string& feature)
     {
-        return std::find_if(begin(), end(), [&](const std::unique_ptr<StatusParagraph>& pgh) {
-            const PackageSpec& spec = pgh->package.spec;
-            return spec.name() == name && spec.triplet() == triplet && pgh->package.feature == feature;
-        });
+        const Optional<size_t> position = find_position(name, triplet, feature);
+        if (const auto p = position.get()) return to_iterator(*p);
+        return end();
     }
 
     StatusParagraphs::const_iterator StatusParagraphs::find_installed(const std::string& name,
                                                                       const Triplet& triplet) const
     {
-        const const_iterator it = find(name, triplet);
-        if (it != end() && (*it)->want == Want::INSTALL && (*it)->state == InstallState::INSTALLED)
+        const IndexEntries* entries = find_index_entries(name, triplet);
+        if (entries != nullptr && is_installed(entries->back()))
         {
-            return it;
+            return to_iterator(entries->back());
         }
 
         return end();
     }
 
-    StatusParagraphs::iterator StatusParagraphs::insert(std::unique_ptr<StatusParagraph> pgh)
+    StatusParagraphs::iterator StatusParagraphs::insert(StatusParagraph pgh)
     {
-        Checks::check_exit(VCPKG_LINE_INFO, pgh != nullptr, "Inserted null paragraph");
-        const PackageSpec& spec = pgh->package.spec;
-        const auto ptr = find(spec.name(), spec.triplet(), pgh->package.feature);
-        if (ptr == end())
+        const PackageSpec& spec = pgh.package.spec;
+        const Optional<size_t> maybe_position = find_position(spec.name(), spec.triplet(), pgh.package.feature);
+        const auto position = maybe_position.get();
+        if (!position)
         {
-            paragraphs.push_back(std::move(pgh));
-            return paragraphs.rbegin();
+            const PackageSpec new_spec = spec;
+            paragraphs.push_back(allocate(std::move(pgh)));
+            add_to_index(paragraphs.size() - 1, new_spec);
+            return begin();
         }
 
-        // consume data from provided pgh.
-        **ptr = std::move(*pgh);
-        return ptr;
+        // consume data from provided pgh; a pending paragraph is replaced without being parsed
+        if (StatusParagraph* existing = paragraphs[*position])
+            *existing = std::move(pgh);
+        else
+            paragraphs[*position] = allocate(std::move(pgh));
+        return to_iterator(*position);
+    }
+
+    StatusParagraphs::iterator StatusParagraphs::insert(std::unique_ptr<StatusParagraph> pgh)
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, pgh != nullptr, "Inserted null paragraph");
+        return insert(std::move(*pgh));
     }
 
     void serialize(const StatusParagraphs& pghs, std::string& out_str)
     {
-        for (auto& pgh : pghs.paragraphs)
+        size_t size = 0;
+        for (size_t position = 0; position < pghs.paragraphs.size(); ++position)
+        {
+            size += serialized_size(*pghs.at(position)) + 1;
+        }
+        out_str.reserve(out_str.size() + size);
+
+        for (size_t position = 0; position < pghs.paragraphs.size(); ++position)
         {
-            serialize(*pgh, out_str);
+            serialize(*pghs.at(position), out_str);
             out_str.push_back('\n');
         }
     }
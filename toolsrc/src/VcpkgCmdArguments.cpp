@@ -3,6 +3,7 @@
 #include "VcpkgCmdArguments.h"
 #include "metrics.h"
 #include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
 #include "vcpkg_GlobalState.h"
 #include "vcpkg_System.h"
 
@@ -44,6 +45,42 @@ namespace vcpkg
         option_field = new_setting;
     }
 
+    std::vector<std::string> VcpkgCmdArguments::split_argument_list(const std::string& text)
+    {
+        std::vector<std::string> arguments;
+        bool at_line_start = true;
+        // Editors on Windows save a byte order mark at the start of the file
+        size_t i = text.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+        while (i < text.size())
+        {
+            const char c = text[i];
+            if (c == '\n' || c == '\r')
+            {
+                at_line_start = true;
+                ++i;
+                continue;
+            }
+            if (isspace(static_cast<unsigned char>(c)))
+            {
+                ++i;
+                continue;
+            }
+            if (c == '#' && at_line_start)
+            {
+                i = text.find_first_of("\r\n", i);
+                if (i == std::string::npos) break;
+                continue;
+            }
+
+            const size_t start = i;
+            while (i < text.size() && !isspace(static_cast<unsigned char>(text[i])))
+                ++i;
+            arguments.emplace_back(text, start, i - start);
+            at_line_start = false;
+        }
+        return arguments;
+    }
+
     VcpkgCmdArguments VcpkgCmdArguments::create_from_command_line(const int argc, const wchar_t* const* const argv)
     {
         std::vector<std::string> v;
@@ -59,6 +96,14 @@ namespace vcpkg
                                                                   const std::string* arg_end)
     {
         VcpkgCmdArguments args;
+        bool specs_from_stdin = false;
+
+        const auto add_positional = [&](std::string&& arg) {
+            if (args.command.empty())
+                args.command = std::move(arg);
+            else
+                args.command_arguments.push_back(std::move(arg));
+        };
 
         for (; arg_begin != arg_end; ++arg_begin)
         {
@@ -69,6 +114,22 @@ namespace vcpkg
                 continue;
             }
 
+            // A response file holds arguments which would not fit on the command line, such as hundreds of specs
+            if (arg[0] == '@')
+            {
+                const fs::path response_file = fs::stdfs::u8path(arg.substr(1));
+                const Expected<std::string> contents = Files::get_real_filesystem().read_contents(response_file);
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   contents.get() != nullptr,
+                                   "Error: could not read the response file %s",
+                                   response_file.u8string());
+                for (auto&& response_arg : split_argument_list(*contents.get()))
+                {
+                    add_positional(std::move(response_arg));
+                }
+                continue;
+            }
+
             if (arg[0] == '-' && arg[1] != '-')
             {
                 Metrics::g_metrics.lock()->track_property("error", "error short options are not supported");
@@ -87,12 +148,54 @@ namespace vcpkg
                     parse_value(arg_begin, arg_end, "--vcpkg-root", args.vcpkg_root_dir);
                     continue;
                 }
+                if (arg == "--x-buildtrees-root")
+                {
+                    ++arg_begin;
+                    parse_value(arg_begin, arg_end, "--x-buildtrees-root", args.buildtrees_root_dir);
+                    continue;
+                }
+                if (arg == "--x-packages-root")
+                {
+                    ++arg_begin;
+                    parse_value(arg_begin, arg_end, "--x-packages-root", args.packages_root_dir);
+                    continue;
+                }
+                if (arg == "--downloads-root")
+                {
+                    ++arg_begin;
+                    parse_value(arg_begin, arg_end, "--downloads-root", args.downloads_root_dir);
+                    continue;
+                }
                 if (arg == "--triplet")
                 {
                     ++arg_begin;
                     parse_value(arg_begin, arg_end, "--triplet", args.triplet);
                     continue;
                 }
+                if (arg == "--timings-trace")
+                {
+                    ++arg_begin;
+                    parse_value(arg_begin, arg_end, "--timings-trace", args.timings_trace_file);
+                    continue;
+                }
+                if (arg == "--x-profile")
+                {
+                    ++arg_begin;
+                    parse_value(arg_begin, arg_end, "--x-profile", args.timings_trace_file);
+                    continue;
+                }
+                if (arg == "--background-affinity")
+                {
+                    ++arg_begin;
+                    parse_value(arg_begin, arg_end, "--background-affinity", args.background_affinity);
+                    continue;
+                }
+                if (arg == "--background-free-cores")
+                {
+                    ++arg_begin;
+                    parse_value(arg_begin, arg_end, "--background-free-cores", args.background_free_cores);
+                    continue;
+                }
                 if (arg == "--debug")
                 {
                     parse_switch(true, "debug", args.debug);
@@ -108,6 +211,26 @@ namespace vcpkg
                     parse_switch(true, "printmetrics", args.printmetrics);
                     continue;
                 }
+                if (arg == "--timings")
+                {
+                    parse_switch(true, "timings", args.timings);
+                    continue;
+                }
+                if (arg == "--x-trace-processes")
+                {
+                    parse_switch(true, "x-trace-processes", args.trace_processes);
+                    continue;
+                }
+                if (arg == "--x-memstats")
+                {
+                    parse_switch(true, "x-memstats", args.memstats);
+                    continue;
+                }
+                if (arg == "--background")
+                {
+                    parse_switch(true, "background", args.background);
+                    continue;
+                }
                 if (arg == "--no-sendmetrics")
                 {
                     parse_switch(false, "sendmetrics", args.sendmetrics);
@@ -123,6 +246,21 @@ namespace vcpkg
                     GlobalState::feature_packages = true;
                     continue;
                 }
+                if (arg == "--binarycaching")
+                {
+                    GlobalState::binary_caching = true;
+                    continue;
+                }
+                if (arg == "--deduplicate")
+                {
+                    GlobalState::deduplicate = true;
+                    continue;
+                }
+                if (arg == "--specs-from-stdin")
+                {
+                    specs_from_stdin = true;
+                    continue;
+                }
 
                 const auto eq_pos = arg.find('=');
                 if (eq_pos != std::string::npos)
@@ -136,13 +274,16 @@ namespace vcpkg
                 continue;
             }
 
-            if (args.command.empty())
-            {
-                args.command = arg;
-            }
-            else
+            add_positional(std::move(arg));
+        }
+
+        // Read after the command line, so that the arguments from stdin come last
+        if (specs_from_stdin)
+        {
+            const std::string text{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+            for (auto&& stdin_arg : split_argument_list(text))
             {
-                args.command_arguments.push_back(arg);
+                add_positional(std::move(stdin_arg));
             }
         }
 
@@ -3,9 +3,13 @@
 #include "PackageSpec.h"
 #include "VcpkgPaths.h"
 #include "metrics.h"
+#include "vcpkg_Commands.h"
 #include "vcpkg_Files.h"
+#include "vcpkg_Strings.h"
 #include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
 #include "vcpkg_Util.h"
+#include "vcpkg_VisualStudio.h"
 #include "vcpkg_expected.h"
 
 namespace vcpkg
@@ -14,62 +18,136 @@ namespace vcpkg
     static const std::wstring V_140 = L"v140";
     static const std::wstring V_141 = L"v141";
 
-    static bool exists_and_has_equal_or_greater_version(const std::wstring& version_cmd,
-                                                        const std::array<int, 3>& expected_version)
+    static std::string get_file_stamp(const Files::Filesystem& fs, const fs::path& path)
+    {
+        std::error_code ec;
+        const fs::file_time_type time = fs.last_write_time(path, ec);
+        if (ec) return Strings::EMPTY;
+        return std::to_string(time.time_since_epoch().count());
+    }
+
+    struct ToolPath
+    {
+        fs::path path;
+        std::array<int, 3> version;
+    };
+
+    static Optional<std::array<int, 3>> get_tool_version(const std::wstring& version_cmd)
     {
         static const std::regex RE(R"###((\d+)\.(\d+)\.(\d+))###");
 
         const auto rc = System::cmd_execute_and_capture_output(Strings::wformat(LR"(%s)", version_cmd));
         if (rc.exit_code != 0)
         {
-            return false;
+            return nullopt;
         }
 
         std::match_results<std::string::const_iterator> match;
         const auto found = std::regex_search(rc.output, match, RE);
         if (!found)
         {
-            return false;
+            return nullopt;
         }
 
-        const int d1 = atoi(match[1].str().c_str());
-        const int d2 = atoi(match[2].str().c_str());
-        const int d3 = atoi(match[3].str().c_str());
-        if (d1 > expected_version[0] || (d1 == expected_version[0] && d2 > expected_version[1]) ||
-            (d1 == expected_version[0] && d2 == expected_version[1] && d3 >= expected_version[2]))
-        {
-            // satisfactory version found
-            return true;
-        }
-
-        return false;
+        return std::array<int, 3>{
+            atoi(match[1].str().c_str()), atoi(match[2].str().c_str()), atoi(match[3].str().c_str())};
     }
 
-    static Optional<fs::path> find_if_has_equal_or_greater_version(const std::vector<fs::path>& candidate_paths,
+    static Optional<ToolPath> find_if_has_equal_or_greater_version(const std::vector<fs::path>& candidate_paths,
                                                                    const std::wstring& version_check_arguments,
                                                                    const std::array<int, 3>& expected_version)
     {
-        auto it = Util::find_if(candidate_paths, [&](const fs::path& p) {
+        for (const fs::path& p : candidate_paths)
+        {
             const std::wstring cmd = Strings::wformat(LR"("%s" %s)", p.native(), version_check_arguments);
-            return exists_and_has_equal_or_greater_version(cmd, expected_version);
-        });
+            const Optional<std::array<int, 3>> version = get_tool_version(cmd);
+            const auto v = version.get();
+            if (v && *v >= expected_version)
+            {
+                // satisfactory version found
+                return ToolPath{p, *v};
+            }
+        }
+
+        return nullopt;
+    }
+
+    static fs::path get_tool_manifest_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "tools"; }
 
-        if (it != candidate_paths.cend())
+    /// <summary>
+    /// The tool manifest has one line per tool: name|version|path|timestamp. A recorded tool is used without probing
+    /// its version again as long as the binary has the same timestamp.
+    /// </summary>
+    static Optional<fs::path> try_get_recorded_tool(const VcpkgPaths& paths,
+                                                    const std::string& tool_name,
+                                                    const std::array<int, 3>& expected_version)
+    {
+        const auto& fs = paths.get_filesystem();
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(get_tool_manifest_path(paths));
+        const auto lines = maybe_lines.get();
+        if (!lines) return nullopt;
+
+        for (const std::string& line : *lines)
         {
-            return std::move(*it);
+            const std::vector<std::string> fields = Strings::split(line, "|");
+            if (fields.size() != 4 || fields[0] != tool_name) continue;
+
+            const std::vector<std::string> version_parts = Strings::split(fields[1], ".");
+            if (version_parts.size() != 3) return nullopt;
+
+            const std::array<int, 3> version = {
+                atoi(version_parts[0].c_str()), atoi(version_parts[1].c_str()), atoi(version_parts[2].c_str())};
+            const fs::path path = Strings::to_utf16(fields[2]);
+            if (version < expected_version || fields[3].empty() || get_file_stamp(fs, path) != fields[3])
+            {
+                return nullopt;
+            }
+
+            return path;
         }
 
         return nullopt;
     }
 
-    static fs::path fetch_dependency(const fs::path& scripts_folder,
+    static fs::path record_tool(const VcpkgPaths& paths, const std::string& tool_name, ToolPath&& tool)
+    {
+        auto& fs = paths.get_filesystem();
+        const std::string stamp = get_file_stamp(fs, tool.path);
+        if (stamp.empty()) return std::move(tool.path);
+
+        // The tools may be found on several threads, each of which rewrites the whole manifest
+        static std::mutex manifest_mutex;
+        std::lock_guard<std::mutex> lock(manifest_mutex);
+
+        const fs::path manifest_path = get_tool_manifest_path(paths);
+        Expected<std::vector<std::string>> maybe_lines = fs.read_lines(manifest_path);
+        std::vector<std::string> lines;
+        if (const auto existing = maybe_lines.get()) lines = std::move(*existing);
+        Util::erase_remove_if(lines, [&](const std::string& line) { return line.find(tool_name + "|") == 0; });
+        lines.push_back(Strings::format("%s|%d.%d.%d|%s|%s",
+                                        tool_name,
+                                        tool.version[0],
+                                        tool.version[1],
+                                        tool.version[2],
+                                        tool.path.u8string(),
+                                        stamp));
+
+        const fs::path tmp_path = manifest_path.parent_path() / (manifest_path.filename().u8string() + ".tmp");
+        fs.write_lines(tmp_path, lines);
+        std::error_code ec;
+        fs.rename(tmp_path, manifest_path, ec);
+
+        return std::move(tool.path);
+    }
+
+    static ToolPath fetch_dependency(const VcpkgPaths& paths,
                                      const std::wstring& tool_name,
                                      const fs::path& expected_downloaded_path,
                                      const std::array<int, 3>& version)
     {
-        const fs::path script = scripts_folder / "fetchDependency.ps1";
-        const auto install_cmd =
-            System::create_powershell_script_cmd(script, Strings::wformat(L"-Dependency %s", tool_name));
+        const fs::path script = paths.scripts / "fetchDependency.ps1";
+        const auto install_cmd = System::create_powershell_script_cmd(
+            script, Strings::wformat(L"-Dependency %s -downloadsDir '%s'", tool_name, paths.downloads.native()));
         const System::ExitCodeAndOutput rc = System::cmd_execute_and_capture_output(install_cmd);
         if (rc.exit_code)
         {
@@ -96,15 +174,21 @@ namespace vcpkg
                            "Expected dependency downloaded path to be %s, but was %s",
                            expected_downloaded_path.u8string(),
                            actual_downloaded_path.u8string());
-        return actual_downloaded_path;
+        return ToolPath{actual_downloaded_path, version};
     }
 
-    static fs::path get_cmake_path(const fs::path& downloads_folder, const fs::path& scripts_folder)
+    static Optional<fs::path> get_cmake_path(const VcpkgPaths& paths, const bool fetch_if_missing)
     {
         static constexpr std::array<int, 3> EXPECTED_VERSION = {3, 9, 3};
         static const std::wstring VERSION_CHECK_ARGUMENTS = L"--version";
 
-        const fs::path downloaded_copy = downloads_folder / "cmake-3.9.3-win32-x86" / "bin" / "cmake.exe";
+        const Optional<fs::path> recorded = try_get_recorded_tool(paths, "cmake", EXPECTED_VERSION);
+        if (const auto r = recorded.get())
+        {
+            return *r;
+        }
+
+        const fs::path downloaded_copy = paths.downloads / "cmake-3.9.3-win32-x86" / "bin" / "cmake.exe";
         const std::vector<fs::path> from_path = Files::find_from_PATH(L"cmake");
 
         std::vector<fs::path> candidate_paths;
@@ -113,43 +197,60 @@ namespace vcpkg
         candidate_paths.push_back(System::get_program_files_platform_bitness() / "CMake" / "bin" / "cmake.exe");
         candidate_paths.push_back(System::get_program_files_32_bit() / "CMake" / "bin");
 
-        const Optional<fs::path> path =
+        Optional<ToolPath> found =
             find_if_has_equal_or_greater_version(candidate_paths, VERSION_CHECK_ARGUMENTS, EXPECTED_VERSION);
-        if (const auto p = path.get())
+        if (const auto f = found.get())
         {
-            return *p;
+            return record_tool(paths, "cmake", std::move(*f));
         }
 
-        return fetch_dependency(scripts_folder, L"cmake", downloaded_copy, EXPECTED_VERSION);
+        if (!fetch_if_missing) return nullopt;
+        return record_tool(
+            paths, "cmake", fetch_dependency(paths, L"cmake", downloaded_copy, EXPECTED_VERSION));
     }
 
-    fs::path get_nuget_path(const fs::path& downloads_folder, const fs::path& scripts_folder)
+    static Optional<fs::path> get_nuget_path(const VcpkgPaths& paths, const bool fetch_if_missing)
     {
         static constexpr std::array<int, 3> EXPECTED_VERSION = {4, 1, 0};
         static const std::wstring VERSION_CHECK_ARGUMENTS = Strings::WEMPTY;
 
-        const fs::path downloaded_copy = downloads_folder / "nuget-4.1.0" / "nuget.exe";
+        const Optional<fs::path> recorded = try_get_recorded_tool(paths, "nuget", EXPECTED_VERSION);
+        if (const auto r = recorded.get())
+        {
+            return *r;
+        }
+
+        const fs::path downloaded_copy = paths.downloads / "nuget-4.1.0" / "nuget.exe";
         const std::vector<fs::path> from_path = Files::find_from_PATH(L"nuget");
 
         std::vector<fs::path> candidate_paths;
         candidate_paths.push_back(downloaded_copy);
         candidate_paths.insert(candidate_paths.end(), from_path.cbegin(), from_path.cend());
 
-        auto path = find_if_has_equal_or_greater_version(candidate_paths, VERSION_CHECK_ARGUMENTS, EXPECTED_VERSION);
-        if (const auto p = path.get())
+        Optional<ToolPath> found =
+            find_if_has_equal_or_greater_version(candidate_paths, VERSION_CHECK_ARGUMENTS, EXPECTED_VERSION);
+        if (const auto f = found.get())
         {
-            return *p;
+            return record_tool(paths, "nuget", std::move(*f));
         }
 
-        return fetch_dependency(scripts_folder, L"nuget", downloaded_copy, EXPECTED_VERSION);
+        if (!fetch_if_missing) return nullopt;
+        return record_tool(
+            paths, "nuget", fetch_dependency(paths, L"nuget", downloaded_copy, EXPECTED_VERSION));
     }
 
-    fs::path get_git_path(const fs::path& downloads_folder, const fs::path& scripts_folder)
+    static Optional<fs::path> get_git_path(const VcpkgPaths& paths, const bool fetch_if_missing)
     {
         static constexpr std::array<int, 3> EXPECTED_VERSION = {2, 14, 1};
         static const std::wstring VERSION_CHECK_ARGUMENTS = L"--version";
 
-        const fs::path downloaded_copy = downloads_folder / "MinGit-2.14.1-32-bit" / "cmd" / "git.exe";
+        const Optional<fs::path> recorded = try_get_recorded_tool(paths, "git", EXPECTED_VERSION);
+        if (const auto r = recorded.get())
+        {
+            return *r;
+        }
+
+        const fs::path downloaded_copy = paths.downloads / "MinGit-2.14.1-32-bit" / "cmd" / "git.exe";
         const std::vector<fs::path> from_path = Files::find_from_PATH(L"git");
 
         std::vector<fs::path> candidate_paths;
@@ -158,14 +259,15 @@ namespace vcpkg
         candidate_paths.push_back(System::get_program_files_platform_bitness() / "git" / "cmd" / "git.exe");
         candidate_paths.push_back(System::get_program_files_32_bit() / "git" / "cmd" / "git.exe");
 
-        const Optional<fs::path> path =
+        Optional<ToolPath> found =
             find_if_has_equal_or_greater_version(candidate_paths, VERSION_CHECK_ARGUMENTS, EXPECTED_VERSION);
-        if (const auto p = path.get())
+        if (const auto f = found.get())
         {
-            return *p;
+            return record_tool(paths, "git", std::move(*f));
         }
 
-        return fetch_dependency(scripts_folder, L"git", downloaded_copy, EXPECTED_VERSION);
+        if (!fetch_if_missing) return nullopt;
+        return record_tool(paths, "git", fetch_dependency(paths, L"git", downloaded_copy, EXPECTED_VERSION));
     }
 
     Expected<VcpkgPaths> VcpkgPaths::create(const fs::path& vcpkg_root_dir)
@@ -177,8 +279,14 @@ namespace vcpkg
             return ec;
         }
 
+        return create(canonical_vcpkg_root_dir, Files::get_real_filesystem());
+    }
+
+    Expected<VcpkgPaths> VcpkgPaths::create(const fs::path& vcpkg_root_dir, Files::Filesystem& filesystem)
+    {
         VcpkgPaths paths;
-        paths.root = canonical_vcpkg_root_dir;
+        paths.filesystem = &filesystem;
+        paths.root = vcpkg_root_dir;
 
         if (paths.root.empty())
         {
@@ -201,6 +309,7 @@ namespace vcpkg
         paths.vcpkg_dir_status_file = paths.vcpkg_dir / "status";
         paths.vcpkg_dir_info = paths.vcpkg_dir / "info";
         paths.vcpkg_dir_updates = paths.vcpkg_dir / "updates";
+        paths.vcpkg_dir_status_journal = paths.vcpkg_dir_updates / "journal";
 
         paths.ports_cmake = paths.scripts / "ports.cmake";
 
@@ -222,37 +331,103 @@ namespace vcpkg
         return this->vcpkg_dir_info / (pgh.fullstem() + ".list");
     }
 
+    fs::path VcpkgPaths::file_owners_path(const Triplet& triplet) const
+    {
+        return this->vcpkg_dir / (triplet.canonical_name() + ".owners");
+    }
+
+    fs::path VcpkgPaths::pre_build_info_path(const Triplet& triplet) const
+    {
+        return this->vcpkg_dir / (triplet.canonical_name() + ".pre_build_info");
+    }
+
+    fs::path VcpkgPaths::toolchain_snapshot_path(const Triplet& triplet) const
+    {
+        return this->vcpkg_dir / "toolchain" / (triplet.canonical_name() + ".cmake");
+    }
+
+    fs::path VcpkgPaths::link_manifest_path(const PackageSpec& spec, const bool debug) const
+    {
+        const std::string filename = spec.name() + (debug ? ".debug.txt" : ".txt");
+        return this->vcpkg_dir / "link" / spec.triplet().canonical_name() / filename;
+    }
+
     bool VcpkgPaths::is_valid_triplet(const Triplet& t) const
     {
-        for (auto&& path : get_filesystem().get_files_non_recursive(this->triplets))
-        {
-            const std::string triplet_file_name = path.stem().generic_u8string();
-            if (t.canonical_name() == triplet_file_name) // TODO: fuzzy compare
+        // TODO: fuzzy compare
+        return Util::find(get_available_triplets(), t.canonical_name()) != get_available_triplets().cend();
+    }
+
+    const std::vector<std::string>& VcpkgPaths::get_available_triplets() const
+    {
+        return this->available_triplets.get_lazy([this]() {
+            const Timings::ScopedTimer timer("lazy paths", "triplets");
+            std::vector<std::string> triplets;
+            for (auto&& path : get_filesystem().get_files_non_recursive(this->triplets))
             {
-                // t.value = triplet_file_name; // NOTE: uncomment when implementing fuzzy compare
-                return true;
+                if (path.extension() == ".cmake") triplets.push_back(path.stem().generic_u8string());
             }
-        }
-        return false;
+            return triplets;
+        });
     }
 
     const fs::path& VcpkgPaths::get_cmake_exe() const
     {
-        return this->cmake_exe.get_lazy([this]() { return get_cmake_path(this->downloads, this->scripts); });
+        return this->cmake_exe.get_lazy([this]() {
+            const Timings::ScopedTimer timer("lazy paths", "cmake");
+            return get_cmake_path(*this, true).value_or_exit(VCPKG_LINE_INFO);
+        });
     }
 
     const fs::path& VcpkgPaths::get_git_exe() const
     {
-        return this->git_exe.get_lazy([this]() { return get_git_path(this->downloads, this->scripts); });
+        return this->git_exe.get_lazy([this]() {
+            const Timings::ScopedTimer timer("lazy paths", "git");
+            return get_git_path(*this, true).value_or_exit(VCPKG_LINE_INFO);
+        });
     }
 
     const fs::path& VcpkgPaths::get_nuget_exe() const
     {
-        return this->nuget_exe.get_lazy([this]() { return get_nuget_path(this->downloads, this->scripts); });
+        return this->nuget_exe.get_lazy([this]() {
+            const Timings::ScopedTimer timer("lazy paths", "nuget");
+            return get_nuget_path(*this, true).value_or_exit(VCPKG_LINE_INFO);
+        });
+    }
+
+    bool VcpkgPaths::warm_up(const std::vector<LazyTool>& tools) const
+    {
+        // A tool which is not on the machine is left for the first call to download, in case it is not needed
+        bool all_found = true;
+        for (const LazyTool tool : tools)
+        {
+            switch (tool)
+            {
+                case LazyTool::CMAKE:
+                    all_found &= cmake_exe.try_get_lazy([this]() { return get_cmake_path(*this, false); });
+                    break;
+                case LazyTool::GIT:
+                    all_found &= git_exe.try_get_lazy([this]() { return get_git_path(*this, false); });
+                    break;
+                case LazyTool::NUGET:
+                    all_found &= nuget_exe.try_get_lazy([this]() { return get_nuget_path(*this, false); });
+                    break;
+                case LazyTool::TOOLSETS: get_windows_sdk_version(); break;
+                default: Checks::unreachable(VCPKG_LINE_INFO);
+            }
+        }
+        return all_found;
     }
 
     static std::vector<std::string> get_vs2017_installation_instances(const VcpkgPaths& paths)
     {
+        const Optional<std::vector<fs::path>> maybe_instances = VisualStudio::find_vs2017_instances();
+        if (const auto instances = maybe_instances.get())
+        {
+            return Util::fmap(*instances, [](const fs::path& instance) { return instance.u8string(); });
+        }
+
+        // The Setup Configuration API could not be used, which the script reports in more detail
         const fs::path script = paths.scripts / "findVisualStudioInstallationInstances.ps1";
         const std::wstring cmd = System::create_powershell_script_cmd(script);
         const System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd);
@@ -388,6 +563,156 @@ namespace vcpkg
         return found_toolsets;
     }
 
+    /// <summary>
+    /// Identifies the inputs of the discovery that are not recorded per toolset: VS2015 is found through
+    /// VS140COMNTOOLS, installing or removing a VS2017 instance updates the instances directory, and installing or
+    /// removing a Windows SDK updates the Include directory of its kit.
+    /// </summary>
+    static std::string get_toolset_discovery_key(const Files::Filesystem& fs)
+    {
+        const std::wstring vs140_comntools = System::get_environment_variable(L"VS140COMNTOOLS").value_or(L"");
+        const std::wstring program_data = System::get_environment_variable(L"ProgramData").value_or(L"");
+        const fs::path vs2017_instances_dir =
+            fs::path(program_data) / "Microsoft" / "VisualStudio" / "Packages" / "_Instances";
+
+        const std::string sdk_stamps = Strings::join(
+            ",", VisualStudio::get_windows_sdk_include_dirs(), [&](auto&& dir) { return get_file_stamp(fs, dir); });
+
+        return Strings::format("toolsets-v2|%s|%s|%s",
+                               Strings::to_utf8(vs140_comntools),
+                               program_data.empty() ? Strings::EMPTY : get_file_stamp(fs, vs2017_instances_dir),
+                               sdk_stamps);
+    }
+
+    static Optional<CWStringView> toolset_version_from_string(const std::string& version)
+    {
+        if (version == "v140") return CWStringView(V_140);
+        if (version == "v141") return CWStringView(V_141);
+        return nullopt;
+    }
+
+    static Optional<ToolsetArchOption> toolset_arch_option_from_name(const std::string& name)
+    {
+        using CPU = System::CPUArchitecture;
+
+        static const std::vector<ToolsetArchOption> KNOWN_OPTIONS = {
+            {L"x86", CPU::X86, CPU::X86},
+            {L"x64", CPU::X64, CPU::X64},
+            {L"amd64", CPU::X64, CPU::X64},
+            {L"x86_amd64", CPU::X86, CPU::X64},
+            {L"x86_arm", CPU::X86, CPU::ARM},
+            {L"amd64_x86", CPU::X64, CPU::X86},
+            {L"amd64_arm", CPU::X64, CPU::ARM},
+        };
+
+        const std::wstring w_name = Strings::to_utf16(name);
+        const auto it = Util::find_if(KNOWN_OPTIONS, [&](const ToolsetArchOption& o) { return w_name == o.name; });
+        if (it == KNOWN_OPTIONS.cend()) return nullopt;
+        return *it;
+    }
+
+    static constexpr const char* SDK_LINE_PREFIX = "sdk|";
+
+    /// <summary>
+    /// The cache file starts with the discovery key and the Windows SDK version as sdk|version, followed by one line
+    /// per toolset: version|architectures|vcvarsall|vcvarsall timestamp|dumpbin|dumpbin timestamp
+    /// </summary>
+    static std::vector<std::string> serialize_toolsets(const Files::Filesystem& fs,
+                                                       const std::string& key,
+                                                       const ToolsetDiscovery& discovery)
+    {
+        std::vector<std::string> lines = {key, SDK_LINE_PREFIX + discovery.windows_sdk_version};
+        for (const Toolset& toolset : discovery.toolsets)
+        {
+            const std::string architectures = Strings::join(",", toolset.supported_architectures, [](auto&& o) {
+                return Strings::to_utf8(o.name);
+            });
+            lines.push_back(Strings::format("%s|%s|%s|%s|%s|%s",
+                                            Strings::to_utf8(toolset.version),
+                                            architectures,
+                                            toolset.vcvarsall.u8string(),
+                                            get_file_stamp(fs, toolset.vcvarsall),
+                                            toolset.dumpbin.u8string(),
+                                            get_file_stamp(fs, toolset.dumpbin)));
+        }
+        return lines;
+    }
+
+    /// <summary>
+    /// Returns nullopt unless the key matches and every recorded vcvarsall.bat and dumpbin.exe still exists with the
+    /// same timestamp
+    /// </summary>
+    static Optional<ToolsetDiscovery> try_load_cached_toolsets(const Files::Filesystem& fs,
+                                                               const fs::path& cache_path,
+                                                               const std::string& key)
+    {
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(cache_path);
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->size() < 3 || lines->at(0) != key) return nullopt;
+
+        const std::string& sdk_line = lines->at(1);
+        if (sdk_line.compare(0, strlen(SDK_LINE_PREFIX), SDK_LINE_PREFIX) != 0) return nullopt;
+
+        ToolsetDiscovery discovery;
+        discovery.windows_sdk_version = sdk_line.substr(strlen(SDK_LINE_PREFIX));
+        std::vector<Toolset>& toolsets = discovery.toolsets;
+        for (auto it = lines->cbegin() + 2; it != lines->cend(); ++it)
+        {
+            const std::vector<std::string> fields = Strings::split(*it, "|");
+            if (fields.size() != 6) return nullopt;
+
+            const Optional<CWStringView> version = toolset_version_from_string(fields[0]);
+            if (!version.get()) return nullopt;
+
+            std::vector<ToolsetArchOption> supported_architectures;
+            for (const std::string& name : Strings::split(fields[1], ","))
+            {
+                const Optional<ToolsetArchOption> option = toolset_arch_option_from_name(name);
+                const auto o = option.get();
+                if (!o) return nullopt;
+                supported_architectures.push_back(*o);
+            }
+
+            const fs::path vcvarsall = Strings::to_utf16(fields[2]);
+            const fs::path dumpbin = Strings::to_utf16(fields[4]);
+            if (fields[3].empty() || get_file_stamp(fs, vcvarsall) != fields[3]) return nullopt;
+            if (fields[5].empty() || get_file_stamp(fs, dumpbin) != fields[5]) return nullopt;
+
+            toolsets.push_back({dumpbin, vcvarsall, {}, *version.get(), std::move(supported_architectures)});
+        }
+
+        return discovery;
+    }
+
+    /// <summary>
+    /// Discovering the toolsets walks the Visual Studio instances and the Windows Kits, so the result is kept in
+    /// installed/vcpkg/toolsets. Deleting that file forces the discovery to run again.
+    /// </summary>
+    static ToolsetDiscovery find_toolset_instances_cached(const VcpkgPaths& paths)
+    {
+        const Timings::ScopedTimer timer("lazy paths", "toolsets");
+        auto& fs = paths.get_filesystem();
+        const fs::path cache_path = paths.vcpkg_dir / "toolsets";
+        const std::string key = get_toolset_discovery_key(fs);
+
+        Optional<ToolsetDiscovery> maybe_cached = try_load_cached_toolsets(fs, cache_path, key);
+        if (const auto cached = maybe_cached.get())
+        {
+            return std::move(*cached);
+        }
+
+        ToolsetDiscovery discovery;
+        discovery.toolsets = find_toolset_instances(paths);
+        discovery.windows_sdk_version = VisualStudio::find_windows_sdk_version(fs).value_or(Strings::EMPTY);
+
+        const fs::path tmp_path = cache_path.parent_path() / (cache_path.filename().u8string() + ".tmp");
+        fs.write_lines(tmp_path, serialize_toolsets(fs, key, discovery));
+        std::error_code ec;
+        fs.rename(tmp_path, cache_path, ec);
+
+        return discovery;
+    }
+
     static std::vector<Toolset> create_vs2017_v140_toolset_instances(const std::vector<Toolset>& vs_toolsets)
     {
         std::vector<Toolset> vs2017_v140_toolsets;
@@ -424,7 +749,7 @@ namespace vcpkg
 
         // Invariant: toolsets are non-empty and sorted with newest at back()
         const std::vector<Toolset>& vs_toolsets =
-            this->toolsets.get_lazy([this]() { return find_toolset_instances(*this); });
+            this->toolset_discovery.get_lazy([this]() { return find_toolset_instances_cached(*this); }).toolsets;
 
         if (w_toolset_version.empty())
         {
@@ -448,5 +773,103 @@ namespace vcpkg
         return *toolset;
     }
 
-    Files::Filesystem& VcpkgPaths::get_filesystem() const { return Files::get_real_filesystem(); }
+    const std::string& VcpkgPaths::get_windows_sdk_version() const
+    {
+        return this->toolset_discovery.get_lazy([this]() { return find_toolset_instances_cached(*this); })
+            .windows_sdk_version;
+    }
+
+    static constexpr auto BUNDLED_HELPERS = "vcpkg_common_functions";
+
+    /// <summary>
+    /// The names of the modules which vcpkg_common_functions.cmake includes, in order
+    /// </summary>
+    static std::vector<std::string> get_bundled_modules(const std::vector<std::string>& lines)
+    {
+        std::vector<std::string> modules;
+        for (auto&& line : lines)
+        {
+            const std::string trimmed = Strings::trimmed(line);
+            if (trimmed.size() > 9 && trimmed.compare(0, 8, "include(") == 0 && trimmed.back() == ')')
+            {
+                modules.push_back(trimmed.substr(8, trimmed.size() - 9));
+            }
+        }
+        return modules;
+    }
+
+    /// <summary>
+    /// cmake reads a single file much faster than two dozen modules found through CMAKE_MODULE_PATH, which every port
+    /// build and every portfile would otherwise do. The name of the bundle is a hash of its contents and of the version
+    /// of vcpkg, so a change to any helper writes a new bundle, and the ones it replaces are removed.
+    /// </summary>
+    static fs::path write_helpers_bundle(const VcpkgPaths& paths)
+    {
+        const Timings::ScopedTimer timer("lazy paths", "helpers bundle");
+        auto& fs = paths.get_filesystem();
+        const fs::path helpers_dir = paths.scripts / "cmake";
+        const Expected<std::vector<std::string>> maybe_lines =
+            fs.read_lines(helpers_dir / (std::string(BUNDLED_HELPERS) + ".cmake"));
+        const auto lines = maybe_lines.get();
+        if (!lines) return fs::path();
+
+        const std::vector<std::string> modules = get_bundled_modules(*lines);
+        std::string bundle =
+            Strings::format("# Written by vcpkg from the helpers of %s.cmake, do not edit\n", BUNDLED_HELPERS);
+        for (auto&& module : modules)
+        {
+            const Expected<std::vector<std::string>> maybe_module_lines =
+                fs.read_lines(helpers_dir / (module + ".cmake"));
+            const auto module_lines = maybe_module_lines.get();
+            if (!module_lines) return fs::path();
+
+            // The helpers which include each other are already in the bundle
+            bundle.append(Strings::format("\n# %s.cmake\n", module));
+            for (auto&& line : *module_lines)
+            {
+                const std::vector<std::string> included = get_bundled_modules({line});
+                if (included.size() == 1 && Util::find(modules, included.front()) != modules.cend()) continue;
+                bundle.append(line);
+                bundle.push_back('\n');
+            }
+        }
+        bundle.append("\nset(_VCPKG_COMMON_FUNCTIONS_BUNDLED 1)\n");
+
+        const std::string hash = Commands::Hash::get_string_hash(Commands::Version::version() + '\n' + bundle, "SHA1");
+        const std::string bundle_name = Strings::format("%s-%s.cmake", BUNDLED_HELPERS, hash.substr(0, 16));
+        const fs::path bundles_dir = paths.scripts / "bundles";
+        const fs::path bundle_path = bundles_dir / bundle_name;
+        if (fs.exists(bundle_path)) return bundle_path;
+
+        std::error_code ec;
+        fs.create_directories(bundles_dir, ec);
+        for (auto&& stale : fs.get_files_non_recursive(bundles_dir))
+        {
+            const std::string stale_name = stale.filename().u8string();
+            if (stale_name.compare(0, strlen(BUNDLED_HELPERS), BUNDLED_HELPERS) == 0 && stale.extension() == ".cmake")
+            {
+                fs.remove(stale, ec);
+            }
+        }
+
+        // Other vcpkg processes may write the same bundle at the same time
+        const fs::path tmp_path =
+            bundles_dir / Strings::format("%s.%d.tmp", bundle_name, static_cast<int>(GetCurrentProcessId()));
+        fs.write_contents(tmp_path, bundle);
+        fs.rename(tmp_path, bundle_path, ec);
+        if (ec)
+        {
+            fs.remove(tmp_path, ec);
+            if (!fs.exists(bundle_path)) return fs::path();
+        }
+
+        return bundle_path;
+    }
+
+    const fs::path& VcpkgPaths::get_helpers_bundle() const
+    {
+        return this->helpers_bundle.get_lazy([this]() { return write_helpers_bundle(*this); });
+    }
+
+    Files::Filesystem& VcpkgPaths::get_filesystem() const { return *this->filesystem; }
 }
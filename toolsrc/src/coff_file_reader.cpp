@@ -2,34 +2,188 @@
 
 #include "coff_file_reader.h"
 #include "vcpkg_Checks.h"
-
-using namespace std;
+#include "vcpkg_Files.h"
+#include "vcpkg_optional.h"
 
 namespace vcpkg::CoffFileReader
 {
-    template<class T>
-    static T reinterpret_bytes(const char* data)
+    // Layouts of the on-disk structures. They are packed so they can be overlaid on any offset of the mapped file.
+#pragma pack(push, 1)
+    struct CoffFileHeader
     {
-        return (*reinterpret_cast<const T*>(&data[0]));
-    }
+        uint16_t machine;
+        uint16_t number_of_sections;
+        uint32_t time_date_stamp;
+        uint32_t pointer_to_symbol_table;
+        uint32_t number_of_symbols;
+        uint16_t size_of_optional_header;
+        uint16_t characteristics;
+    };
 
-    template<class T>
-    static T read_value_from_stream(fstream& fs)
+    struct SectionHeader
     {
-        T data;
-        fs.read(reinterpret_cast<char*>(&data), sizeof data);
-        return data;
-    }
+        char name[8];
+        uint32_t virtual_size;
+        uint32_t virtual_address;
+        uint32_t size_of_raw_data;
+        uint32_t pointer_to_raw_data;
+        uint32_t pointer_to_relocations;
+        uint32_t pointer_to_line_numbers;
+        uint16_t number_of_relocations;
+        uint16_t number_of_line_numbers;
+        uint32_t characteristics;
+    };
 
-    template<class T>
-    static T peek_value_from_stream(fstream& fs)
+    struct DataDirectory
     {
-        const fpos_t original_pos = fs.tellg().seekpos();
-        T data;
-        fs.read(reinterpret_cast<char*>(&data), sizeof data);
-        fs.seekg(original_pos);
-        return data;
-    }
+        uint32_t virtual_address;
+        uint32_t size;
+    };
+
+    struct ExportDirectory
+    {
+        uint32_t characteristics;
+        uint32_t time_date_stamp;
+        uint16_t major_version;
+        uint16_t minor_version;
+        uint32_t name;
+        uint32_t base;
+        uint32_t number_of_functions;
+        uint32_t number_of_names;
+        uint32_t address_of_functions;
+        uint32_t address_of_names;
+        uint32_t address_of_name_ordinals;
+    };
+
+    struct ImportDescriptor
+    {
+        uint32_t original_first_thunk;
+        uint32_t time_date_stamp;
+        uint32_t forwarder_chain;
+        uint32_t name;
+        uint32_t first_thunk;
+    };
+
+    struct DelayImportDescriptor
+    {
+        uint32_t attributes;
+        uint32_t dll_name;
+        uint32_t module_handle;
+        uint32_t import_address_table;
+        uint32_t import_name_table;
+        uint32_t bound_import_address_table;
+        uint32_t unload_information_table;
+        uint32_t time_date_stamp;
+    };
+
+    struct DebugDirectory
+    {
+        uint32_t characteristics;
+        uint32_t time_date_stamp;
+        uint16_t major_version;
+        uint16_t minor_version;
+        uint32_t type;
+        uint32_t size_of_data;
+        uint32_t address_of_raw_data;
+        uint32_t pointer_to_raw_data;
+    };
+
+    struct ArchiveMemberHeader
+    {
+        char name[16];
+        char date[12];
+        char user_id[6];
+        char group_id[6];
+        char mode[8];
+        char size[10];
+        char end[2];
+    };
+
+    struct ImportHeader
+    {
+        uint16_t sig1;
+        uint16_t sig2;
+        uint16_t version;
+        uint16_t machine;
+        uint32_t time_date_stamp;
+        uint32_t size_of_data;
+        uint16_t ordinal_or_hint;
+        uint16_t type;
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(CoffFileHeader) == 20, "Unexpected COFF file header size");
+    static_assert(sizeof(SectionHeader) == 40, "Unexpected section header size");
+    static_assert(sizeof(ExportDirectory) == 40, "Unexpected export directory size");
+    static_assert(sizeof(ImportDescriptor) == 20, "Unexpected import descriptor size");
+    static_assert(sizeof(DelayImportDescriptor) == 32, "Unexpected delay-load import descriptor size");
+    static_assert(sizeof(DebugDirectory) == 28, "Unexpected debug directory size");
+    static_assert(sizeof(ArchiveMemberHeader) == 60, "Unexpected archive member header size");
+    static_assert(sizeof(ImportHeader) == 20, "Unexpected import header size");
+
+    /// <summary>
+    /// A bounds-checked window into a mapped file. Every access verifies that it lies inside the window.
+    /// </summary>
+    struct FileView
+    {
+        FileView(const char* data, const uint64_t size, const fs::path& path) : m_data(data), m_size(size), m_path(path)
+        {
+        }
+
+        const char* bytes_at(const uint64_t offset, const uint64_t size) const
+        {
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               offset <= m_size && size <= m_size - offset,
+                               "Unexpected end of file while reading %s bytes at offset %s of %s",
+                               std::to_string(size),
+                               std::to_string(offset),
+                               m_path.generic_string());
+            return m_data + offset;
+        }
+
+        template<class T>
+        const T& overlay(const uint64_t offset) const
+        {
+            return *reinterpret_cast<const T*>(bytes_at(offset, sizeof(T)));
+        }
+
+        template<class T>
+        span<const T> overlay_array(const uint64_t offset, const uint64_t count) const
+        {
+            return span<const T>(reinterpret_cast<const T*>(bytes_at(offset, count * sizeof(T))),
+                                 static_cast<size_t>(count));
+        }
+
+        template<class T>
+        T value_at(const uint64_t offset) const
+        {
+            return overlay<T>(offset);
+        }
+
+        FileView subview(const uint64_t offset, const uint64_t size) const
+        {
+            return FileView(bytes_at(offset, size), size, m_path);
+        }
+
+        std::string_view string_at(const uint64_t offset, const uint64_t size) const
+        {
+            return std::string_view(bytes_at(offset, size), static_cast<size_t>(size));
+        }
+
+        std::string null_terminated_string_at(const uint64_t offset) const
+        {
+            const char* const begin = bytes_at(offset, 0);
+            const char* const end = m_data + m_size;
+            return std::string(begin, std::find(begin, end, '\0'));
+        }
+
+        uint64_t size() const { return m_size; }
+
+    private:
+        const char* m_data;
+        uint64_t m_size;
+        const fs::path& m_path;
+    };
 
     static void verify_equal_strings(
         const LineInfo& line_info, const char* expected, const char* actual, int size, const char* label)
@@ -39,270 +193,381 @@ namespace vcpkg::CoffFileReader
                            "Incorrect string (%s) found. Expected: (%s) but found (%s)",
                            label,
                            expected,
-                           actual);
+                           std::string(actual, size));
+    }
+
+    static Files::MappedFile map_file(const fs::path& path)
+    {
+        Expected<Files::MappedFile> maybe_mapped = Files::get_real_filesystem().map_contents(path);
+        const auto mapped = maybe_mapped.get();
+        Checks::check_exit(
+            VCPKG_LINE_INFO, mapped != nullptr, "Could not open file %s for reading", path.generic_string());
+        return std::move(*mapped);
     }
 
-    static void read_and_verify_PE_signature(fstream& fs)
+    /// <summary>
+    /// Returns the offset of the COFF file header, which immediately follows the PE signature
+    /// </summary>
+    static uint64_t read_and_verify_PE_signature(const FileView& file)
     {
         static const size_t OFFSET_TO_PE_SIGNATURE_OFFSET = 0x3c;
 
         static const char* PE_SIGNATURE = "PE\0\0";
         static const size_t PE_SIGNATURE_SIZE = 4;
 
-        fs.seekg(OFFSET_TO_PE_SIGNATURE_OFFSET, ios_base::beg);
-        const int32_t offset_to_PE_signature = read_value_from_stream<int32_t>(fs);
-
-        fs.seekg(offset_to_PE_signature);
-        char signature[PE_SIGNATURE_SIZE];
-        fs.read(signature, PE_SIGNATURE_SIZE);
+        const uint32_t offset_to_PE_signature = file.value_at<uint32_t>(OFFSET_TO_PE_SIGNATURE_OFFSET);
+        const char* signature = file.bytes_at(offset_to_PE_signature, PE_SIGNATURE_SIZE);
         verify_equal_strings(VCPKG_LINE_INFO, PE_SIGNATURE, signature, PE_SIGNATURE_SIZE, "PE_SIGNATURE");
-        fs.seekg(offset_to_PE_signature + PE_SIGNATURE_SIZE, ios_base::beg);
+        return uint64_t{offset_to_PE_signature} + PE_SIGNATURE_SIZE;
     }
 
-    static fpos_t align_to_size(const uint64_t unaligned, const uint64_t alignment_size)
+    static uint64_t align_to_size(const uint64_t unaligned, const uint64_t alignment_size)
     {
-        fpos_t aligned = unaligned - 1;
+        uint64_t aligned = unaligned - 1;
         aligned /= alignment_size;
         aligned += 1;
         aligned *= alignment_size;
         return aligned;
     }
 
-    struct CoffFileHeader
+    struct OptionalHeader
     {
-        static const size_t HEADER_SIZE = 20;
-
-        static CoffFileHeader read(fstream& fs)
+        OptionalHeader(const FileView& file, const uint64_t offset, const uint16_t size)
+            : m_header(file.subview(offset, size))
         {
-            CoffFileHeader ret;
-            ret.data.resize(HEADER_SIZE);
-            fs.read(&ret.data[0], HEADER_SIZE);
-            return ret;
+            static const size_t MINIMUM_SIZE = 96;
+
+            Checks::check_exit(VCPKG_LINE_INFO, size >= MINIMUM_SIZE, "Optional header is too small: %d", size);
         }
 
-        MachineType machine_type() const
+        uint16_t dll_characteristics() const
         {
-            static const size_t MACHINE_TYPE_OFFSET = 0;
-            static const size_t MACHINE_TYPE_SIZE = 2;
+            static const size_t DLL_CHARACTERISTICS_OFFSET = 70;
+            return m_header.value_at<uint16_t>(DLL_CHARACTERISTICS_OFFSET);
+        }
 
-            std::string machine_field_as_string = data.substr(MACHINE_TYPE_OFFSET, MACHINE_TYPE_SIZE);
-            const uint16_t machine = reinterpret_bytes<uint16_t>(machine_field_as_string.c_str());
-            return to_machine_type(machine);
+        DataDirectory data_directory(const size_t index) const
+        {
+            static const uint16_t PE32_MAGIC = 0x10b;
+            static const uint16_t PE32_PLUS_MAGIC = 0x20b;
+            static const size_t PE32_DATA_DIRECTORIES_OFFSET = 96;
+            static const size_t PE32_PLUS_DATA_DIRECTORIES_OFFSET = 112;
+
+            const uint16_t magic = m_header.value_at<uint16_t>(0);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               magic == PE32_MAGIC || magic == PE32_PLUS_MAGIC,
+                               "Unrecognized optional header magic");
+
+            const size_t directories_offset =
+                magic == PE32_PLUS_MAGIC ? PE32_PLUS_DATA_DIRECTORIES_OFFSET : PE32_DATA_DIRECTORIES_OFFSET;
+            if (directories_offset > m_header.size()) return {0, 0};
+
+            // NumberOfRvaAndSizes immediately precedes the data directories
+            const uint32_t directory_count = m_header.value_at<uint32_t>(directories_offset - 4);
+            const uint64_t entry_offset = directories_offset + sizeof(DataDirectory) * index;
+            if (index >= directory_count || entry_offset + sizeof(DataDirectory) > m_header.size()) return {0, 0};
+
+            return m_header.value_at<DataDirectory>(entry_offset);
         }
 
     private:
-        std::string data;
+        FileView m_header;
     };
 
-    struct ArchiveMemberHeader
+    static std::string section_name(const SectionHeader& section)
     {
-        static const size_t HEADER_SIZE = 60;
+        const std::string name(section.name, sizeof(section.name));
+        return name.substr(0, name.find('\0'));
+    }
 
-        static ArchiveMemberHeader read(fstream& fs)
+    static Optional<uint64_t> rva_to_file_offset(const span<const SectionHeader>& sections, const uint32_t rva)
+    {
+        for (const SectionHeader& section : sections)
         {
-            static const size_t HEADER_END_OFFSET = 58;
-            static const char* HEADER_END = "`\n";
-            static const size_t HEADER_END_SIZE = 2;
-
-            ArchiveMemberHeader ret;
-            ret.data.resize(HEADER_SIZE);
-            fs.read(&ret.data[0], HEADER_SIZE);
-
-            if (ret.data[0] != '\0') // Due to freeglut. github issue #223
+            const uint32_t extent = std::max(section.virtual_size, section.size_of_raw_data);
+            if (rva >= section.virtual_address && rva - section.virtual_address < extent)
             {
-                const std::string header_end = ret.data.substr(HEADER_END_OFFSET, HEADER_END_SIZE);
-                verify_equal_strings(
-                    VCPKG_LINE_INFO, HEADER_END, header_end.c_str(), HEADER_END_SIZE, "LIB HEADER_END");
+                return uint64_t{section.pointer_to_raw_data} + (rva - section.virtual_address);
             }
-
-            return ret;
         }
 
-        std::string name() const
-        {
-            static const size_t HEADER_NAME_OFFSET = 0;
-            static const size_t HEADER_NAME_SIZE = 16;
-            return data.substr(HEADER_NAME_OFFSET, HEADER_NAME_SIZE);
-        }
-
-        uint64_t member_size() const
-        {
-            static const size_t ALIGNMENT_SIZE = 2;
+        return nullopt;
+    }
 
-            static const size_t HEADER_SIZE_OFFSET = 48;
-            static const size_t HEADER_SIZE_FIELD_SIZE = 10;
-            const std::string as_string = data.substr(HEADER_SIZE_OFFSET, HEADER_SIZE_FIELD_SIZE);
-            // This is in ASCII decimal representation
-            const uint64_t value = std::strtoull(as_string.c_str(), nullptr, 10);
+    static bool has_exported_functions(const FileView& file,
+                                       const span<const SectionHeader>& sections,
+                                       const DataDirectory& export_directory)
+    {
+        if (export_directory.virtual_address == 0) return false;
 
-            const uint64_t aligned = align_to_size(value, ALIGNMENT_SIZE);
-            return aligned;
-        }
+        const Optional<uint64_t> maybe_offset = rva_to_file_offset(sections, export_directory.virtual_address);
+        const auto offset = maybe_offset.get();
+        if (offset == nullptr) return false;
 
-        std::string data;
-    };
+        return file.overlay<ExportDirectory>(*offset).number_of_functions != 0;
+    }
 
-    struct OffsetsArray
+    /// <summary>
+    /// Reads the DLL names from a table of import or delay-load import descriptors. Both tables end with a descriptor
+    /// whose name is zero.
+    /// </summary>
+    template<class Descriptor, class GetNameRva>
+    static std::vector<std::string> read_imported_dll_names(const FileView& file,
+                                                            const span<const SectionHeader>& sections,
+                                                            const DataDirectory& import_directory,
+                                                            GetNameRva get_name_rva)
     {
-        static OffsetsArray read(fstream& fs, const uint32_t offset_count)
-        {
-            static const size_t OFFSET_WIDTH = 4;
+        std::vector<std::string> names;
+        if (import_directory.virtual_address == 0) return names;
 
-            std::string raw_offsets;
-            const size_t raw_offset_size = offset_count * OFFSET_WIDTH;
-            raw_offsets.resize(raw_offset_size);
-            fs.read(&raw_offsets[0], raw_offset_size);
+        const Optional<uint64_t> maybe_offset = rva_to_file_offset(sections, import_directory.virtual_address);
+        const auto offset = maybe_offset.get();
+        if (offset == nullptr) return names;
 
-            OffsetsArray ret;
-            for (uint32_t i = 0; i < offset_count; ++i)
-            {
-                const std::string value_as_string = raw_offsets.substr(OFFSET_WIDTH * i, OFFSET_WIDTH * (i + 1));
-                const uint32_t value = reinterpret_bytes<uint32_t>(value_as_string.c_str());
+        for (uint64_t descriptor_offset = *offset;; descriptor_offset += sizeof(Descriptor))
+        {
+            const uint32_t name_rva = get_name_rva(file.overlay<Descriptor>(descriptor_offset));
+            if (name_rva == 0) break;
 
-                // Ignore offsets that point to offset 0. See vcpkg github #223 #288 #292
-                if (value != 0)
-                {
-                    ret.data.push_back(value);
-                }
+            const Optional<uint64_t> maybe_name_offset = rva_to_file_offset(sections, name_rva);
+            if (const auto name_offset = maybe_name_offset.get())
+            {
+                names.push_back(file.null_terminated_string_at(*name_offset));
             }
-
-            // Sort the offsets, because it is possible for them to be unsorted. See vcpkg github #292
-            std::sort(ret.data.begin(), ret.data.end());
-            return ret;
         }
 
-        std::vector<uint32_t> data;
-    };
+        return names;
+    }
 
-    struct ImportHeader
+    /// <summary>
+    /// Reads the PDB path from the first CodeView debug directory entry in the RSDS format of PDB 7.0, which is what
+    /// dumpbin /PDBPATH reports. The entry is addressed by file offset, so it needs no section lookup.
+    /// </summary>
+    static std::string read_pdb_path(const FileView& file,
+                                     const span<const SectionHeader>& sections,
+                                     const DataDirectory& debug_directory)
     {
-        static const size_t HEADER_SIZE = 20;
+        static const uint32_t DEBUG_TYPE_CODEVIEW = 2;
+        static const char* RSDS_SIGNATURE = "RSDS";
+        static const size_t RSDS_SIGNATURE_SIZE = 4;
+        static const size_t RSDS_PATH_OFFSET = 24; // After the signature, the GUID and the age
+
+        if (debug_directory.virtual_address == 0) return std::string();
+
+        const Optional<uint64_t> maybe_offset = rva_to_file_offset(sections, debug_directory.virtual_address);
+        const auto offset = maybe_offset.get();
+        if (offset == nullptr) return std::string();
 
-        static ImportHeader read(fstream& fs)
+        const uint64_t entry_count = debug_directory.size / sizeof(DebugDirectory);
+        for (const DebugDirectory& entry : file.overlay_array<DebugDirectory>(*offset, entry_count))
         {
-            static const size_t SIG1_OFFSET = 0;
-            static const uint16_t SIG1 = static_cast<uint16_t>(MachineType::UNKNOWN);
-            static const size_t SIG1_SIZE = 2;
+            if (entry.type != DEBUG_TYPE_CODEVIEW || entry.size_of_data <= RSDS_PATH_OFFSET) continue;
 
-            static const size_t SIG2_OFFSET = 2;
-            static const uint16_t SIG2 = 0xFFFF;
-            static const size_t SIG2_SIZE = 2;
+            const FileView codeview = file.subview(entry.pointer_to_raw_data, entry.size_of_data);
+            if (memcmp(codeview.bytes_at(0, RSDS_SIGNATURE_SIZE), RSDS_SIGNATURE, RSDS_SIGNATURE_SIZE) != 0) continue;
 
-            ImportHeader ret;
-            ret.data.resize(HEADER_SIZE);
-            fs.read(&ret.data[0], HEADER_SIZE);
+            return codeview.null_terminated_string_at(RSDS_PATH_OFFSET);
+        }
 
-            const std::string sig1_as_string = ret.data.substr(SIG1_OFFSET, SIG1_SIZE);
-            const uint16_t sig1 = reinterpret_bytes<uint16_t>(sig1_as_string.c_str());
-            Checks::check_exit(VCPKG_LINE_INFO, sig1 == SIG1, "Sig1 was incorrect. Expected %s but got %s", SIG1, sig1);
+        return std::string();
+    }
 
-            const std::string sig2_as_string = ret.data.substr(SIG2_OFFSET, SIG2_SIZE);
-            const uint16_t sig2 = reinterpret_bytes<uint16_t>(sig2_as_string.c_str());
-            Checks::check_exit(VCPKG_LINE_INFO, sig2 == SIG2, "Sig2 was incorrect. Expected %s but got %s", SIG2, sig2);
+    /// <summary>
+    /// Splits the contents of a .drectve section at unquoted whitespace and drops the quotes, which is how
+    /// dumpbin /directives displays them.
+    /// </summary>
+    static std::vector<std::string> split_linker_directives(std::string_view raw)
+    {
+        static const std::string_view UTF8_BOM = "\xEF\xBB\xBF";
 
-            return ret;
-        }
+        if (raw.substr(0, UTF8_BOM.size()) == UTF8_BOM) raw.remove_prefix(UTF8_BOM.size());
 
-        MachineType machine_type() const
+        std::vector<std::string> directives;
+        std::string current;
+        bool in_quotes = false;
+        for (const char c : raw)
         {
-            static const size_t MACHINE_TYPE_OFFSET = 6;
-            static const size_t MACHINE_TYPE_SIZE = 2;
+            if (c == '"')
+            {
+                in_quotes = !in_quotes;
+                continue;
+            }
 
-            std::string machine_field_as_string = data.substr(MACHINE_TYPE_OFFSET, MACHINE_TYPE_SIZE);
-            const uint16_t machine = reinterpret_bytes<uint16_t>(machine_field_as_string.c_str());
-            return to_machine_type(machine);
+            if (!in_quotes && (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0'))
+            {
+                if (!current.empty()) directives.push_back(std::move(current));
+                current.clear();
+                continue;
+            }
+
+            current.push_back(c);
         }
 
-    private:
-        std::string data;
-    };
+        if (!current.empty()) directives.push_back(std::move(current));
+        return directives;
+    }
 
-    static void read_and_verify_archive_file_signature(fstream& fs)
+    static const ArchiveMemberHeader& read_archive_member_header(const FileView& file, const uint64_t offset)
     {
-        static const char* FILE_START = "!<arch>\n";
-        static const size_t FILE_START_SIZE = 8;
+        static const char* HEADER_END = "`\n";
+        static const size_t HEADER_END_SIZE = 2;
 
-        fs.seekg(fs.beg);
+        const ArchiveMemberHeader& header = file.overlay<ArchiveMemberHeader>(offset);
+        if (header.name[0] != '\0') // Due to freeglut. github issue #223
+        {
+            verify_equal_strings(VCPKG_LINE_INFO, HEADER_END, header.end, HEADER_END_SIZE, "LIB HEADER_END");
+        }
 
-        char file_start[FILE_START_SIZE];
-        fs.read(file_start, FILE_START_SIZE);
-        verify_equal_strings(VCPKG_LINE_INFO, FILE_START, file_start, FILE_START_SIZE, "LIB FILE_START");
+        return header;
     }
 
-    DllInfo read_dll(const fs::path& path)
+    static uint64_t member_size(const ArchiveMemberHeader& header)
     {
-        std::fstream fs(path, std::ios::in | std::ios::binary | std::ios::ate);
-        Checks::check_exit(VCPKG_LINE_INFO, fs.is_open(), "Could not open file %s for reading", path.generic_string());
+        static const size_t ALIGNMENT_SIZE = 2;
 
-        read_and_verify_PE_signature(fs);
-        CoffFileHeader header = CoffFileHeader::read(fs);
-        const MachineType machine = header.machine_type();
-        return {machine};
+        // This is in ASCII decimal representation
+        const std::string as_string(header.size, sizeof(header.size));
+        const uint64_t value = std::strtoull(as_string.c_str(), nullptr, 10);
+        return align_to_size(value, ALIGNMENT_SIZE);
     }
 
-    struct Marker
+    static std::vector<uint32_t> read_offsets(const FileView& file, const uint64_t offset, const uint32_t offset_count)
     {
-        void set_to_offset(const fpos_t position) { this->m_absolute_position = position; }
+        std::vector<uint32_t> ret;
+        for (const uint32_t value : file.overlay_array<uint32_t>(offset, offset_count))
+        {
+            // Ignore offsets that point to offset 0. See vcpkg github #223 #288 #292
+            if (value != 0)
+            {
+                ret.push_back(value);
+            }
+        }
 
-        void set_to_current_pos(fstream& fs) { this->m_absolute_position = fs.tellg().seekpos(); }
+        // Sort the offsets, because it is possible for them to be unsorted. See vcpkg github #292
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
 
-        void seek_to_marker(fstream& fs) const { fs.seekg(this->m_absolute_position, ios_base::beg); }
+    static const ImportHeader& read_import_header(const FileView& file, const uint64_t offset)
+    {
+        static const uint16_t SIG1 = static_cast<uint16_t>(MachineType::UNKNOWN);
+        static const uint16_t SIG2 = 0xFFFF;
+
+        const ImportHeader& header = file.overlay<ImportHeader>(offset);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, header.sig1 == SIG1, "Sig1 was incorrect. Expected %d but got %d", SIG1, header.sig1);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, header.sig2 == SIG2, "Sig2 was incorrect. Expected %d but got %d", SIG2, header.sig2);
+        return header;
+    }
 
-        void advance_by(const uint64_t offset) { this->m_absolute_position += offset; }
+    static void read_and_verify_archive_file_signature(const FileView& file)
+    {
+        static const char* FILE_START = "!<arch>\n";
+        static const size_t FILE_START_SIZE = 8;
 
-    private:
-        fpos_t m_absolute_position = 0;
-    };
+        const char* file_start = file.bytes_at(0, FILE_START_SIZE);
+        verify_equal_strings(VCPKG_LINE_INFO, FILE_START, file_start, FILE_START_SIZE, "LIB FILE_START");
+    }
+
+    DllInfo read_dll(const fs::path& path)
+    {
+        static const size_t EXPORT_DIRECTORY_INDEX = 0;
+        static const size_t IMPORT_DIRECTORY_INDEX = 1;
+        static const size_t DEBUG_DIRECTORY_INDEX = 6;
+        static const size_t DELAY_IMPORT_DIRECTORY_INDEX = 13;
+
+        static const uint16_t DLLCHARACTERISTICS_APPCONTAINER = 0x1000;
+
+        const Files::MappedFile mapped = map_file(path);
+        const FileView file(mapped.data.get(), mapped.size, path);
+
+        const uint64_t header_offset = read_and_verify_PE_signature(file);
+        const CoffFileHeader& header = file.overlay<CoffFileHeader>(header_offset);
+        const uint64_t optional_header_offset = header_offset + sizeof(CoffFileHeader);
+        const OptionalHeader optional_header(file, optional_header_offset, header.size_of_optional_header);
+        const span<const SectionHeader> sections = file.overlay_array<SectionHeader>(
+            optional_header_offset + header.size_of_optional_header, header.number_of_sections);
+
+        DllInfo info;
+        info.machine_type = to_machine_type(header.machine);
+        info.is_app_container = (optional_header.dll_characteristics() & DLLCHARACTERISTICS_APPCONTAINER) != 0;
+        info.has_exports =
+            has_exported_functions(file, sections, optional_header.data_directory(EXPORT_DIRECTORY_INDEX));
+        info.dependents = read_imported_dll_names<ImportDescriptor>(
+            file, sections, optional_header.data_directory(IMPORT_DIRECTORY_INDEX), [](const ImportDescriptor& d) {
+                return d.name;
+            });
+        const std::vector<std::string> delay_load_dependents = read_imported_dll_names<DelayImportDescriptor>(
+            file,
+            sections,
+            optional_header.data_directory(DELAY_IMPORT_DIRECTORY_INDEX),
+            [](const DelayImportDescriptor& d) { return d.dll_name; });
+        info.dependents.insert(info.dependents.end(), delay_load_dependents.cbegin(), delay_load_dependents.cend());
+        info.pdb_path = read_pdb_path(file, sections, optional_header.data_directory(DEBUG_DIRECTORY_INDEX));
+        return info;
+    }
 
     LibInfo read_lib(const fs::path& path)
     {
-        std::fstream fs(path, std::ios::in | std::ios::binary | std::ios::ate);
-        Checks::check_exit(VCPKG_LINE_INFO, fs.is_open(), "Could not open file %s for reading", path.generic_string());
+        static const size_t FILE_START_SIZE = 8;
+        static const char* DIRECTIVE_SECTION_NAME = ".drectve";
 
-        read_and_verify_archive_file_signature(fs);
+        const Files::MappedFile mapped = map_file(path);
+        const FileView file(mapped.data.get(), mapped.size, path);
 
-        Marker marker;
-        marker.set_to_current_pos(fs);
+        read_and_verify_archive_file_signature(file);
+        uint64_t position = FILE_START_SIZE;
 
         // First Linker Member
-        const ArchiveMemberHeader first_linker_member_header = ArchiveMemberHeader::read(fs);
+        const ArchiveMemberHeader& first_linker_member_header = read_archive_member_header(file, position);
         Checks::check_exit(VCPKG_LINE_INFO,
-                           first_linker_member_header.name().substr(0, 2) == "/ ",
+                           memcmp(first_linker_member_header.name, "/ ", 2) == 0,
                            "Could not find proper first linker member");
-        marker.advance_by(ArchiveMemberHeader::HEADER_SIZE + first_linker_member_header.member_size());
-        marker.seek_to_marker(fs);
+        position += sizeof(ArchiveMemberHeader) + member_size(first_linker_member_header);
 
-        const ArchiveMemberHeader second_linker_member_header = ArchiveMemberHeader::read(fs);
+        const ArchiveMemberHeader& second_linker_member_header = read_archive_member_header(file, position);
         Checks::check_exit(VCPKG_LINE_INFO,
-                           second_linker_member_header.name().substr(0, 2) == "/ ",
+                           memcmp(second_linker_member_header.name, "/ ", 2) == 0,
                            "Could not find proper second linker member");
+        position += sizeof(ArchiveMemberHeader);
         // The first 4 bytes contains the number of archive members
-        const uint32_t archive_member_count = read_value_from_stream<uint32_t>(fs);
-        const OffsetsArray offsets = OffsetsArray::read(fs, archive_member_count);
-        marker.advance_by(ArchiveMemberHeader::HEADER_SIZE + second_linker_member_header.member_size());
-        marker.seek_to_marker(fs);
-
-        const bool hasLongnameMemberHeader = peek_value_from_stream<uint16_t>(fs) == 0x2F2F;
-        if (hasLongnameMemberHeader)
-        {
-            const ArchiveMemberHeader longnames_member_header = ArchiveMemberHeader::read(fs);
-            marker.advance_by(ArchiveMemberHeader::HEADER_SIZE + longnames_member_header.member_size());
-            marker.seek_to_marker(fs);
-        }
+        const uint32_t archive_member_count = file.value_at<uint32_t>(position);
+        const std::vector<uint32_t> offsets = read_offsets(file, position + sizeof(uint32_t), archive_member_count);
 
         std::set<MachineType> machine_types;
-        // Next we have the obj and pseudo-object files
-        for (const uint32_t offset : offsets.data)
+        std::vector<std::string> linker_directives;
+        // Next we have the obj and pseudo-object files, which are located through the offsets
+        for (const uint32_t offset : offsets)
         {
-            marker.set_to_offset(offset + ArchiveMemberHeader::HEADER_SIZE); // Skip the header, no need to read it.
-            marker.seek_to_marker(fs);
-            const uint16_t first_two_bytes = peek_value_from_stream<uint16_t>(fs);
+            const uint64_t member_start = uint64_t{offset} + sizeof(ArchiveMemberHeader); // Skip the header
+            const uint16_t first_two_bytes = file.value_at<uint16_t>(member_start);
             const bool isImportHeader = to_machine_type(first_two_bytes) == MachineType::UNKNOWN;
-            const MachineType machine =
-                isImportHeader ? ImportHeader::read(fs).machine_type() : CoffFileHeader::read(fs).machine_type();
-            machine_types.insert(machine);
+            if (isImportHeader)
+            {
+                machine_types.insert(to_machine_type(read_import_header(file, member_start).machine));
+                continue;
+            }
+
+            const CoffFileHeader& header = file.overlay<CoffFileHeader>(member_start);
+            machine_types.insert(to_machine_type(header.machine));
+
+            // Object files normally have no optional header, but the section table follows it if there is one
+            const span<const SectionHeader> sections = file.overlay_array<SectionHeader>(
+                member_start + sizeof(CoffFileHeader) + header.size_of_optional_header, header.number_of_sections);
+            for (const SectionHeader& section : sections)
+            {
+                if (section_name(section) != DIRECTIVE_SECTION_NAME) continue;
+
+                const std::string_view raw_directives =
+                    file.string_at(member_start + section.pointer_to_raw_data, section.size_of_raw_data);
+                for (std::string& directive : split_linker_directives(raw_directives))
+                {
+                    linker_directives.push_back(std::move(directive));
+                }
+            }
         }
 
-        return {std::vector<MachineType>(machine_types.cbegin(), machine_types.cend())};
+        return {std::vector<MachineType>(machine_types.cbegin(), machine_types.cend()), std::move(linker_directives)};
     }
 }
@@ -0,0 +1,248 @@
+#include "pch.h"
+
+#include "coff_file_reader.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+
+namespace vcpkg::Commands::AppLocal
+{
+    /// <summary>
+    /// Appends a line in the encoding of the existing file, like Add-Content does: MSBuild writes the tlog as UTF-16
+    /// with a byte order mark, while the copied files log is plain text.
+    /// </summary>
+    static void append_line(const fs::path& log_file, const fs::path& line)
+    {
+        char bom[2] = {0, 0};
+        {
+            std::ifstream input(log_file, std::ios::binary);
+            input.read(bom, sizeof(bom));
+        }
+
+        std::ofstream output(log_file, std::ios::binary | std::ios::app);
+        if (bom[0] == '\xFF' && bom[1] == '\xFE')
+        {
+            const std::wstring wide_line = line.native() + L"\r\n";
+            output.write(reinterpret_cast<const char*>(wide_line.data()), wide_line.size() * sizeof(wchar_t));
+        }
+        else
+        {
+            output << line.u8string() << "\r\n";
+        }
+    }
+
+    static std::string get_cache_file_name(const std::string& triplet_dir_name, const bool debug)
+    {
+        return triplet_dir_name + (debug ? "-debug" : "") + ".txt";
+    }
+
+    /// <summary>
+    /// The cache for installed/&lt;triplet&gt;/bin or installed/&lt;triplet&gt;/debug/bin, kept in installed/vcpkg.
+    /// Empty if the directory is not laid out like an installed tree.
+    /// </summary>
+    static fs::path get_cache_path(const Files::Filesystem& fs, const fs::path& installed_bin_dir)
+    {
+        const fs::path config_dir = fs::stdfs::absolute(installed_bin_dir).parent_path();
+        const bool debug = config_dir.filename() == "debug";
+        const fs::path triplet_dir = debug ? config_dir.parent_path() : config_dir;
+        const fs::path vcpkg_dir = triplet_dir.parent_path() / "vcpkg";
+        if (!fs.is_directory(vcpkg_dir)) return fs::path();
+
+        return vcpkg_dir / "applocal" / get_cache_file_name(triplet_dir.filename().u8string(), debug);
+    }
+
+    void invalidate_dependents_cache(const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        auto& fs = paths.get_filesystem();
+        std::error_code ec;
+        fs.remove(paths.vcpkg_dir / "applocal" / get_cache_file_name(triplet.canonical_name(), false), ec);
+        fs.remove(paths.vcpkg_dir / "applocal" / get_cache_file_name(triplet.canonical_name(), true), ec);
+    }
+
+    static std::string get_file_stamp(const Files::Filesystem& fs, const fs::path& path)
+    {
+        std::error_code ec;
+        const std::uintmax_t size = fs.file_size(path, ec);
+        if (ec) return Strings::EMPTY;
+
+        const fs::file_time_type time = fs.last_write_time(path, ec);
+        if (ec) return Strings::EMPTY;
+
+        return std::to_string(size) + ':' + std::to_string(time.time_since_epoch().count());
+    }
+
+    static const std::string CACHE_VERSION = "applocal-v1";
+
+    struct CachedDll
+    {
+        std::string stamp;
+        std::vector<std::string> dependents;
+    };
+
+    /// <summary>
+    /// The cache starts with its version, followed by one line per installed DLL: lowercase name|stamp|dependents
+    /// </summary>
+    static std::map<std::string, CachedDll> load_cache(const Files::Filesystem& fs, const fs::path& cache_path)
+    {
+        std::map<std::string, CachedDll> cache;
+        const auto maybe_lines = fs.read_lines(cache_path);
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->empty() || lines->front() != CACHE_VERSION) return cache;
+
+        for (auto it = std::next(lines->cbegin()); it != lines->cend(); ++it)
+        {
+            const size_t name_end = it->find('|');
+            const size_t stamp_end = name_end == std::string::npos ? name_end : it->find('|', name_end + 1);
+            if (stamp_end == std::string::npos) return {};
+
+            CachedDll& dll = cache[it->substr(0, name_end)];
+            dll.stamp = it->substr(name_end + 1, stamp_end - name_end - 1);
+            const std::string dependents = it->substr(stamp_end + 1);
+            if (!dependents.empty()) dll.dependents = Strings::split(dependents, ",");
+        }
+
+        return cache;
+    }
+
+    static void write_cache(Files::Filesystem& fs,
+                            const fs::path& cache_path,
+                            const std::map<std::string, CachedDll>& cache)
+    {
+        std::vector<std::string> lines = {CACHE_VERSION};
+        for (auto&& entry : cache)
+        {
+            const std::string dependents = Strings::join(",", entry.second.dependents);
+            lines.push_back(Strings::format("%s|%s|%s", entry.first, entry.second.stamp, dependents));
+        }
+
+        // Builds of several projects deploy at the same time, so the cache is replaced rather than rewritten
+        std::error_code ec;
+        fs.create_directories(cache_path.parent_path(), ec);
+        const fs::path tmp_path = cache_path.parent_path() / (cache_path.filename().u8string() + ".tmp" +
+                                                              std::to_string(GetCurrentProcessId()));
+        fs.write_lines(tmp_path, lines);
+        fs.rename(tmp_path, cache_path, ec);
+        if (ec) fs.remove(tmp_path, ec);
+    }
+
+    struct Deployer
+    {
+        Files::Filesystem& fs;
+        fs::path installed_bin_dir;
+        fs::path tlog_file;
+        fs::path copied_files_log;
+
+        /// <summary>
+        /// The dependents of the installed DLLs, keyed by their lowercase names, from earlier deployments
+        /// </summary>
+        std::map<std::string, CachedDll> cache;
+        bool cache_changed = false;
+
+        /// <summary>
+        /// Lowercase names of the DLLs which were already looked up; like the PowerShell script, each DLL is
+        /// considered only once per target
+        /// </summary>
+        std::unordered_set<std::string> searched;
+
+        void deploy(const fs::path& target_dir, const std::string& dll_name)
+        {
+            const fs::path target = target_dir / dll_name;
+
+            // Copying only when the installed DLL is newer keeps incremental builds from rewriting every DLL
+            std::error_code ec;
+            fs.copy_file(installed_bin_dir / dll_name, target, fs::copy_options::update_existing, ec);
+            if (ec)
+            {
+                System::println(System::Color::error, "Error: Failed to copy %s: %s", target.u8string(), ec.message());
+            }
+
+            if (!copied_files_log.empty()) append_line(copied_files_log, target);
+            if (!tlog_file.empty()) append_line(tlog_file, target);
+        }
+
+        const std::vector<std::string>& get_installed_dependents(const std::string& dll_name,
+                                                                 const std::string& lowercase_name)
+        {
+            const fs::path installed_dll = installed_bin_dir / dll_name;
+            const std::string stamp = get_file_stamp(fs, installed_dll);
+
+            CachedDll& cached = cache[lowercase_name];
+            if (stamp.empty() || cached.stamp != stamp)
+            {
+                cached.stamp = stamp;
+                cached.dependents = CoffFileReader::read_dll(installed_dll).dependents;
+                cache_changed = true;
+            }
+            return cached.dependents;
+        }
+
+        void resolve(const fs::path& target_dir, const std::vector<std::string>& dependents)
+        {
+            for (const std::string& dll_name : dependents)
+            {
+                const std::string lowercase_name = Strings::ascii_to_lowercase(dll_name);
+                if (!searched.insert(lowercase_name).second) continue;
+
+                if (fs.exists(installed_bin_dir / dll_name))
+                {
+                    deploy(target_dir, dll_name);
+                    resolve(target_dir, get_installed_dependents(dll_name, lowercase_name));
+                }
+                else if (fs.exists(target_dir / dll_name))
+                {
+                    // Not from vcpkg, but its dependencies may be
+                    resolve(target_dir, CoffFileReader::read_dll(target_dir / dll_name).dependents);
+                }
+            }
+        }
+    };
+
+    void perform_and_exit(const VcpkgCmdArguments& args)
+    {
+        static const std::string EXAMPLE = Commands::Help::create_example_string(
+            R"###(applocal <target binary> <installed bin dir> [<tlog file> [<copied files log>]])###");
+        args.check_min_arg_count(2, EXAMPLE);
+        args.check_max_arg_count(4, EXAMPLE);
+        args.check_and_get_optional_command_arguments({});
+
+        const fs::path target_binary = fs::stdfs::absolute(Strings::to_utf16(args.command_arguments[0]));
+        const fs::path installed_bin_dir = Strings::to_utf16(args.command_arguments[1]);
+        const fs::path tlog_file =
+            args.command_arguments.size() > 2 ? Strings::to_utf16(args.command_arguments[2]) : std::wstring();
+        const fs::path copied_files_log =
+            args.command_arguments.size() > 3 ? Strings::to_utf16(args.command_arguments[3]) : std::wstring();
+
+        auto& fs = Files::get_real_filesystem();
+
+        // Qt deploys its plugins through a PowerShell hook, so it still needs the script
+        if (fs.exists(installed_bin_dir.parent_path() / "plugins" / "qtdeploy.ps1"))
+        {
+            const fs::path script = System::get_exe_path_of_current_process().parent_path() / "scripts" /
+                                    "buildsystems" / "msbuild" / "applocal.ps1";
+            const std::wstring script_args = Strings::wformat(L"'%s' '%s' '%s' '%s'",
+                                                              target_binary.native(),
+                                                              installed_bin_dir.native(),
+                                                              tlog_file.native(),
+                                                              copied_files_log.native());
+            const int exit_code = System::cmd_execute(System::create_powershell_script_cmd(script, script_args));
+            Checks::exit_with_code(VCPKG_LINE_INFO, exit_code);
+        }
+
+        // Created even if nothing is copied, since the build reads it afterwards
+        if (!copied_files_log.empty()) fs.write_contents(copied_files_log, "\r\n");
+
+        Deployer deployer{fs, installed_bin_dir, tlog_file, copied_files_log};
+        const fs::path cache_path = get_cache_path(fs, installed_bin_dir);
+        if (!cache_path.empty()) deployer.cache = load_cache(fs, cache_path);
+
+        if (fs.exists(target_binary))
+        {
+            deployer.resolve(target_binary.parent_path(), CoffFileReader::read_dll(target_binary).dependents);
+        }
+
+        if (!cache_path.empty() && deployer.cache_changed) write_cache(fs, cache_path, deployer.cache);
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
@@ -0,0 +1,451 @@
+#include "pch.h"
+
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+
+// What vcpkg_apply_patches.cmake does with a git apply process per patch, each of which scans the whole source tree,
+// in one pass over the files the patches touch. The semantics are those of git apply --ignore-whitespace, which the
+// script still runs when vcpkg is not available.
+namespace vcpkg::Commands::ApplyPatches
+{
+    static const std::string DEV_NULL = "/dev/null";
+    static const std::string APPLIED_PATCHES_FILE = ".vcpkg-applied-patches";
+
+    // Each line keeps its line ending, so that joining them gives back the text
+    static std::vector<std::string> split_lines(const std::string& text)
+    {
+        std::vector<std::string> lines;
+        size_t begin = 0;
+        while (begin < text.size())
+        {
+            const size_t newline = text.find('\n', begin);
+            const size_t end = newline == std::string::npos ? text.size() : newline + 1;
+            lines.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+        return lines;
+    }
+
+    static std::string without_line_ending(const std::string& line)
+    {
+        size_t end = line.size();
+        if (end > 0 && line[end - 1] == '\n') --end;
+        if (end > 0 && line[end - 1] == '\r') --end;
+        return line.substr(0, end);
+    }
+
+    static bool starts_with(const std::string& s, const std::string& prefix)
+    {
+        return s.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    // "a/src/zlib.c\t2017-01-15 12:00:00" -> "src/zlib.c"
+    static std::string strip_path(std::string path)
+    {
+        const size_t tab = path.find('\t');
+        if (tab != std::string::npos) path.erase(tab);
+        if (path.size() >= 2 && path.front() == '"' && path.back() == '"') path = path.substr(1, path.size() - 2);
+        if (path == DEV_NULL) return std::string();
+
+        const size_t slash = path.find('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    static bool is_inside_tree(const std::string& path)
+    {
+        if (path.empty() || path.front() == '/' || path.find(':') != std::string::npos) return false;
+        const std::vector<std::string> components = Strings::split(path, "/");
+        return Util::find(components, "..") == components.cend();
+    }
+
+    // "@@ -12,7 +12,8 @@ int main()", where a count which is left out is 1
+    static bool parse_hunk_header(const std::string& line, size_t& old_start, size_t& old_count, size_t& new_count)
+    {
+        const char* p = line.c_str() + 3;
+        const auto read_range = [&](const char sign, size_t& start, size_t& count) {
+            if (*p != sign) return false;
+            char* end;
+            start = std::strtoul(++p, &end, 10);
+            if (end == p) return false;
+            p = end;
+            count = 1;
+            if (*p == ',')
+            {
+                count = std::strtoul(++p, &end, 10);
+                if (end == p) return false;
+                p = end;
+            }
+            return true;
+        };
+
+        size_t new_start;
+        if (!read_range('-', old_start, old_count) || *p++ != ' ') return false;
+        if (!read_range('+', new_start, new_count)) return false;
+        return std::strncmp(p, " @@", 3) == 0;
+    }
+
+    static void remove_line_ending(std::string& line) { line = without_line_ending(line); }
+
+    ExpectedT<std::vector<FilePatch>, std::string> parse_patch(const std::string& text)
+    {
+        const std::vector<std::string> lines = split_lines(text);
+        std::vector<FilePatch> patches;
+
+        // Between "diff --git" and the first hunk of the file, where the extended headers are
+        bool in_git_header = false;
+
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            const std::string line = without_line_ending(lines[i]);
+            if (starts_with(line, "diff --git "))
+            {
+                // "diff --git a/<old> b/<new>" is all there is for a file which is only renamed
+                FilePatch patch;
+                const size_t b = line.rfind(" b/");
+                if (b != std::string::npos)
+                {
+                    patch.old_path = strip_path(line.substr(11, b - 11));
+                    patch.new_path = strip_path(line.substr(b + 1));
+                }
+                patches.push_back(std::move(patch));
+                in_git_header = true;
+            }
+            else if (in_git_header && starts_with(line, "rename from "))
+                patches.back().old_path = line.substr(12);
+            else if (in_git_header && starts_with(line, "rename to "))
+                patches.back().new_path = line.substr(10);
+            else if (in_git_header && starts_with(line, "new file mode "))
+                patches.back().old_path.clear();
+            else if (in_git_header && starts_with(line, "deleted file mode "))
+                patches.back().new_path.clear();
+            else if (starts_with(line, "GIT binary patch") || starts_with(line, "Binary files "))
+                return std::string("binary patches are not supported");
+            else if (starts_with(line, "--- ") && i + 1 < lines.size() && starts_with(lines[i + 1], "+++ "))
+            {
+                if (!in_git_header) patches.emplace_back();
+                patches.back().old_path = strip_path(line.substr(4));
+                patches.back().new_path = strip_path(without_line_ending(lines[i + 1]).substr(4));
+                in_git_header = false;
+                ++i;
+            }
+            else if (starts_with(line, "@@ "))
+            {
+                size_t old_start, old_count, new_count;
+                if (patches.empty() || !parse_hunk_header(line, old_start, old_count, new_count))
+                    return Strings::format("malformed hunk header at line %d", static_cast<int>(i + 1));
+                in_git_header = false;
+
+                // The counts tell where the hunk ends, since a removed line may well look like "--- "
+                Hunk hunk{old_start, {}};
+                while (old_count > 0 || new_count > 0)
+                {
+                    if (++i == lines.size())
+                        return Strings::format("the patch ends in the middle of a hunk, at line %d",
+                                               static_cast<int>(i));
+
+                    std::string hunk_line = lines[i];
+                    // An empty line is context whose space was trimmed by an editor, which git accepts as well
+                    if (without_line_ending(hunk_line).empty()) hunk_line.insert(0, 1, ' ');
+
+                    const char kind = hunk_line.front();
+                    if (kind == '\\' && !hunk.lines.empty())
+                    {
+                        remove_line_ending(hunk.lines.back());
+                        continue;
+                    }
+
+                    if (kind == ' ' && old_count > 0 && new_count > 0)
+                    {
+                        --old_count;
+                        --new_count;
+                    }
+                    else if (kind == '-' && old_count > 0)
+                        --old_count;
+                    else if (kind == '+' && new_count > 0)
+                        --new_count;
+                    else
+                        return Strings::format("malformed hunk line at line %d", static_cast<int>(i + 1));
+                    hunk.lines.push_back(std::move(hunk_line));
+                }
+
+                // "\ No newline at end of file" after the last line of the hunk is past its counts
+                if (i + 1 < lines.size() && starts_with(lines[i + 1], "\\") && !hunk.lines.empty())
+                {
+                    remove_line_ending(hunk.lines.back());
+                    ++i;
+                }
+                patches.back().hunks.push_back(std::move(hunk));
+            }
+        }
+
+        for (auto&& patch : patches)
+        {
+            if (patch.old_path.empty() && patch.new_path.empty()) return std::string("a file of the patch has no name");
+            for (auto&& path : {patch.old_path, patch.new_path})
+            {
+                if (!path.empty() && !is_inside_tree(path))
+                    return Strings::format("%s is outside of the source tree", path);
+            }
+        }
+        return patches;
+    }
+
+    // Runs of whitespace match each other whatever their length, and the line endings are ignored, like the
+    // fuzzy_matchlines() of git
+    static bool equal_ignoring_whitespace(const std::string& a, const std::string& b)
+    {
+        const auto is_space = [](const char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f'; };
+        const std::string a_line = without_line_ending(a);
+        const std::string b_line = without_line_ending(b);
+        size_t i = 0;
+        size_t j = 0;
+        while (i < a_line.size() && j < b_line.size())
+        {
+            if (is_space(a_line[i]))
+            {
+                // Both have to have whitespace here, so that "a b" does not match "ab"
+                if (!is_space(b_line[j])) return false;
+                while (i < a_line.size() && is_space(a_line[i]))
+                    ++i;
+                while (j < b_line.size() && is_space(b_line[j]))
+                    ++j;
+            }
+            else if (a_line[i++] != b_line[j++])
+                return false;
+        }
+        return i == a_line.size() && j == b_line.size();
+    }
+
+    static bool matches_at(const std::vector<std::string>& lines,
+                           const std::vector<std::string>& preimage,
+                           const size_t pos)
+    {
+        for (size_t k = 0; k < preimage.size(); ++k)
+        {
+            if (!equal_ignoring_whitespace(lines[pos + k], preimage[k])) return false;
+        }
+        return true;
+    }
+
+    // Looks for the preimage nearest to the line where it is expected, trying before it first, like git apply does.
+    // Hunks are applied in order, so none is looked for before min_pos.
+    static Optional<size_t> find_hunk(const std::vector<std::string>& lines,
+                                      const std::vector<std::string>& preimage,
+                                      const size_t expected,
+                                      const size_t min_pos,
+                                      const bool match_beginning,
+                                      const bool match_end)
+    {
+        if (lines.size() < min_pos + preimage.size()) return nullopt;
+        const size_t max_pos = lines.size() - preimage.size();
+
+        if (match_beginning || match_end)
+        {
+            const size_t pos = match_beginning ? 0 : max_pos;
+            if (pos < min_pos || (match_beginning && match_end && pos != max_pos)) return nullopt;
+            if (!matches_at(lines, preimage, pos)) return nullopt;
+            return pos;
+        }
+
+        const size_t start = std::min(std::max(expected, min_pos), max_pos);
+        for (size_t distance = 0;; ++distance)
+        {
+            const bool has_before = start >= min_pos + distance;
+            const bool has_after = start + distance <= max_pos;
+            if (!has_before && !has_after) return nullopt;
+            if (has_before && matches_at(lines, preimage, start - distance)) return start - distance;
+            if (distance != 0 && has_after && matches_at(lines, preimage, start + distance)) return start + distance;
+        }
+    }
+
+    // A line is added after the last line of the file, which has no line ending, on a line of its own
+    static void append_line(std::string& output, const std::string& line)
+    {
+        if (!output.empty() && output.back() != '\n') output.push_back('\n');
+        output.append(line);
+    }
+
+    Optional<std::string> apply_hunks(const std::string& contents, const std::vector<Hunk>& hunks)
+    {
+        const std::vector<std::string> lines = split_lines(contents);
+        std::string output;
+        size_t copied = 0;
+
+        // How far from their line numbers the hunks before were found, which the next one most likely is as well
+        ptrdiff_t offset = 0;
+
+        for (auto&& hunk : hunks)
+        {
+            std::vector<std::string> preimage;
+            for (auto&& line : hunk.lines)
+            {
+                if (line.front() != '+') preimage.push_back(line.substr(1));
+            }
+
+            // A hunk at the start of the file, or one without context after it at the end, is first looked for only
+            // there
+            const bool match_beginning = hunk.old_start <= 1;
+            const bool match_end = hunk.lines.empty() || hunk.lines.back().front() != ' ';
+
+            const size_t line_number = preimage.empty() || hunk.old_start == 0 ? hunk.old_start : hunk.old_start - 1;
+            const size_t expected =
+                static_cast<size_t>(std::max<ptrdiff_t>(0, static_cast<ptrdiff_t>(line_number) + offset));
+            Optional<size_t> maybe_pos = find_hunk(lines, preimage, expected, copied, match_beginning, match_end);
+            if (!maybe_pos && (match_beginning || match_end))
+                maybe_pos = find_hunk(lines, preimage, expected, copied, false, false);
+
+            const size_t* const pos = maybe_pos.get();
+            if (!pos) return nullopt;
+            offset = static_cast<ptrdiff_t>(*pos) - static_cast<ptrdiff_t>(line_number);
+
+            for (; copied < *pos; ++copied)
+            {
+                append_line(output, lines[copied]);
+            }
+
+            // The context is kept as it is in the file, since it matched only up to whitespace
+            for (auto&& line : hunk.lines)
+            {
+                if (line.front() == '+')
+                    append_line(output, line.substr(1));
+                else if (line.front() == ' ')
+                    append_line(output, lines[copied++]);
+                else
+                    ++copied;
+            }
+        }
+
+        for (; copied < lines.size(); ++copied)
+        {
+            append_line(output, lines[copied]);
+        }
+        return output;
+    }
+
+    // The contents of the files which the patches changed, by their path in the source tree; deleted ones have none
+    using ChangedFiles = std::map<std::string, Optional<std::string>>;
+
+    // Either every file of the patch applies or none of them does, like with git apply
+    static ExpectedT<ChangedFiles, std::string> apply_patch(const Files::Filesystem& fs,
+                                                           const fs::path& source_dir,
+                                                           const ChangedFiles& changed_before,
+                                                           const std::vector<FilePatch>& patch)
+    {
+        ChangedFiles changes;
+        const auto read_file = [&](const std::string& path) -> Optional<std::string> {
+            const auto change = changes.find(path);
+            if (change != changes.cend()) return change->second;
+            const auto change_before = changed_before.find(path);
+            if (change_before != changed_before.cend()) return change_before->second;
+
+            const fs::path file = source_dir / fs::stdfs::u8path(path);
+            if (!fs.is_regular_file(file)) return nullopt;
+            Expected<std::string> contents = fs.read_contents(file);
+            if (const auto c = contents.get()) return std::move(*c);
+            return nullopt;
+        };
+
+        for (auto&& file : patch)
+        {
+            const bool is_created = file.old_path.empty();
+            const bool is_deleted = file.new_path.empty();
+            if (!is_deleted && file.new_path != file.old_path && read_file(file.new_path))
+                return Strings::format("%s already exists", file.new_path);
+
+            const Optional<std::string> contents = is_created ? std::string() : read_file(file.old_path);
+            if (!contents) return Strings::format("%s does not exist", file.old_path);
+
+            Optional<std::string> maybe_patched = apply_hunks(*contents.get(), file.hunks);
+            const auto patched = maybe_patched.get();
+            if (!patched)
+                return Strings::format("the patch does not apply to %s", is_created ? file.new_path : file.old_path);
+
+            if (is_deleted && !patched->empty())
+                return Strings::format("%s: the patch deletes the file but leaves some of it", file.old_path);
+
+            if (!is_created && file.old_path != file.new_path) changes[file.old_path] = nullopt;
+            if (!is_deleted) changes[file.new_path] = std::move(*patched);
+        }
+        return changes;
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args)
+    {
+        static const std::string OPTION_QUIET = "--quiet";
+        static const std::string EXAMPLE = Commands::Help::create_example_string(
+            R"###(apply-patches buildtrees\zlib\src\zlib-1.2.11 ports\zlib\cmake.patch)###");
+        args.check_min_arg_count(1, EXAMPLE);
+        const std::unordered_set<std::string> options = args.check_and_get_optional_command_arguments({OPTION_QUIET});
+        const bool quiet = options.find(OPTION_QUIET) != options.cend();
+
+        auto& fs = Files::get_real_filesystem();
+        const fs::path source_dir = Strings::to_utf16(args.command_arguments[0]);
+
+        // The triplets of a port share its extracted sources, and so the patches which were applied to them
+        const fs::path applied_patches_file = source_dir / APPLIED_PATCHES_FILE;
+        std::vector<std::string> applied_patches;
+        if (fs.exists(applied_patches_file))
+        {
+            applied_patches = fs.read_lines(applied_patches_file).value_or_exit(VCPKG_LINE_INFO);
+        }
+
+        ChangedFiles changed_files;
+        bool any_applied = false;
+        for (size_t i = 1; i < args.command_arguments.size(); ++i)
+        {
+            const fs::path patch_file = Strings::to_utf16(args.command_arguments[i]);
+            const std::string hash = Hash::get_file_hash(patch_file, "SHA1");
+            if (Util::find(applied_patches, hash) != applied_patches.cend())
+            {
+                System::println("Skipping patch %s, which was already applied", patch_file.u8string());
+                continue;
+            }
+
+            System::println("Applying patch %s", patch_file.u8string());
+            const std::string text = fs.read_contents(patch_file).value_or_exit(VCPKG_LINE_INFO);
+            ExpectedT<std::vector<FilePatch>, std::string> maybe_patch = parse_patch(text);
+            ExpectedT<ChangedFiles, std::string> maybe_changes =
+                maybe_patch.get() ? apply_patch(fs, source_dir, changed_files, *maybe_patch.get())
+                                  : ExpectedT<ChangedFiles, std::string>(maybe_patch.error());
+
+            if (const auto changes = maybe_changes.get())
+            {
+                for (auto&& change : *changes)
+                {
+                    changed_files[change.first] = std::move(change.second);
+                }
+                applied_patches.push_back(hash);
+                any_applied = true;
+            }
+            else if (!quiet)
+            {
+                System::println("error: %s", maybe_changes.error());
+                System::println("Applying patch failed. This is expected if this patch was previously applied.");
+            }
+            System::println("Applying patch %s done", patch_file.u8string());
+        }
+
+        // Only now are the files written, each of them once however many of the patches change it
+        std::error_code ec;
+        for (auto&& file : changed_files)
+        {
+            const fs::path path = source_dir / fs::stdfs::u8path(file.first);
+            if (const auto contents = file.second.get())
+            {
+                fs.create_directories(path.parent_path(), ec);
+                fs.write_contents(path, *contents);
+            }
+            else
+            {
+                fs.remove(path, ec);
+            }
+        }
+
+        if (any_applied) fs.write_lines(applied_patches_file, applied_patches);
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
@@ -10,10 +10,13 @@ namespace vcpkg::Commands
             {"install", &Install::perform_and_exit},
             {"ci", &CI::perform_and_exit},
             {"remove", &Remove::perform_and_exit},
+            {"upgrade", &Upgrade::perform_and_exit},
             {"build", &BuildCommand::perform_and_exit},
             {"env", &Env::perform_and_exit},
             {"build-external", &BuildExternal::perform_and_exit},
             {"export", &Export::perform_and_exit},
+            {"x-logs", &Logs::perform_and_exit},
+            {"x-watch", &Watch::perform_and_exit},
         };
         return t;
     }
@@ -33,6 +36,9 @@ namespace vcpkg::Commands
             {"create", &Create::perform_and_exit},
             {"import", &Import::perform_and_exit},
             {"cache", &Cache::perform_and_exit},
+            {"x-gc", &GarbageCollect::perform_and_exit},
+            {"x-verify", &Verify::perform_and_exit},
+            {"x-build-worker", &BuildWorker::perform_and_exit},
             {"portsdiff", &PortsDiff::perform_and_exit},
         };
         return t;
@@ -44,6 +50,11 @@ namespace vcpkg::Commands
             {"version", &Version::perform_and_exit},
             {"contact", &Contact::perform_and_exit},
             {"hash", &Hash::perform_and_exit},
+            {"applocal", &AppLocal::perform_and_exit},
+            {"download", &Download::perform_and_exit},
+            {"pdbpaths", &PdbPaths::perform_and_exit},
+            {"fixup-cmake-targets", &FixupCmakeTargets::perform_and_exit},
+            {"apply-patches", &ApplyPatches::perform_and_exit},
         };
         return t;
     }
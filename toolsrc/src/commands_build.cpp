@@ -3,6 +3,7 @@
 #include "Paragraphs.h"
 #include "PostBuildLint.h"
 #include "StatusParagraphs.h"
+#include "vcpkg_BinaryCaching.h"
 #include "vcpkg_Commands.h"
 #include "vcpkg_Dependencies.h"
 #include "vcpkg_Enums.h"
@@ -20,6 +21,7 @@ namespace vcpkg::Commands::BuildCommand
     using Dependencies::InstallPlanType;
 
     static const std::string OPTION_CHECKS_ONLY = "--checks-only";
+    static const std::string OPTION_INCREMENTAL = "--incremental";
 
     void perform_and_exit(const FullPackageSpec& full_spec,
                           const fs::path& port_dir,
@@ -57,7 +59,10 @@ namespace vcpkg::Commands::BuildCommand
                            spec.name());
 
         const StatusParagraphs status_db = database_load_check(paths);
-        const Build::BuildPackageOptions build_package_options{Build::UseHeadVersion::NO, Build::AllowDownloads::YES};
+        const Build::IncrementalBuild incremental_build =
+            Build::to_incremental_build(options.find(OPTION_INCREMENTAL) != options.end());
+        const Build::BuildPackageOptions build_package_options{
+            Build::UseHeadVersion::NO, Build::AllowDownloads::YES, incremental_build, 0};
 
         const Build::BuildPackageConfig build_config{
             *scf->core_paragraph, spec.triplet(), paths.port_dir(spec), build_package_options};
@@ -84,6 +89,7 @@ namespace vcpkg::Commands::BuildCommand
             Checks::exit_fail(VCPKG_LINE_INFO);
         }
 
+        BinaryCaching::wait_for_uploads();
         Checks::exit_success(VCPKG_LINE_INFO);
     }
 
@@ -96,7 +102,7 @@ namespace vcpkg::Commands::BuildCommand
         const FullPackageSpec spec = Input::check_and_get_full_package_spec(command_argument, default_triplet, EXAMPLE);
         Input::check_triplet(spec.package_spec.triplet(), paths);
         const std::unordered_set<std::string> options =
-            args.check_and_get_optional_command_arguments({OPTION_CHECKS_ONLY});
+            args.check_and_get_optional_command_arguments({OPTION_CHECKS_ONLY, OPTION_INCREMENTAL});
         perform_and_exit(spec, paths.port_dir(spec.package_spec), options, paths);
     }
 }
@@ -0,0 +1,118 @@
+#include "pch.h"
+
+#include "vcpkg_BinaryCaching.h"
+#include "vcpkg_BuildQueue.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Dependencies.h"
+#include "vcpkg_GlobalState.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+#include "vcpkglib.h"
+
+#include <thread>
+
+namespace vcpkg::Commands::BuildWorker
+{
+    using Dependencies::AnyAction;
+    using Dependencies::InstallPlanAction;
+    using Dependencies::InstallPlanType;
+
+    /// <summary>
+    /// Builds the package of the job along with whatever it depends on, which the binary sources usually have, and
+    /// returns what to tell the coordinator
+    /// </summary>
+    static std::string perform_job(const VcpkgPaths& paths, const BuildQueue::Job& job)
+    {
+        StatusParagraphs status_db = database_load_check(paths);
+        Dependencies::PathsPortFile paths_port_file(paths);
+        std::vector<AnyAction> action_plan;
+        if (GlobalState::feature_packages)
+        {
+            const FullPackageSpec full_spec{job.spec, job.features};
+            action_plan = Dependencies::create_feature_install_plan(
+                paths_port_file, FullPackageSpec::to_feature_specs({full_spec}), status_db);
+        }
+        else
+        {
+            auto install_plan = Dependencies::create_install_plan(paths_port_file, {job.spec}, status_db);
+            action_plan = Util::fmap(
+                install_plan, [](InstallPlanAction& install_action) { return AnyAction(std::move(install_action)); });
+        }
+
+        const auto it_action =
+            Util::find_if(action_plan, [&](const AnyAction& action) { return action.spec() == job.spec; });
+        const auto install_action = it_action == action_plan.cend() ? nullptr : it_action->install_plan.get();
+        if (!install_action) return BuildQueue::ABI_MISMATCH;
+
+        const Build::BuildPackageOptions install_plan_options = {
+            Build::UseHeadVersion::NO, Build::AllowDownloads::YES, Build::IncrementalBuild::NO, 0};
+
+        // A package installed here earlier is only published again if it is the one which was asked for
+        if (install_action->plan_type == InstallPlanType::ALREADY_INSTALLED)
+        {
+            const auto installed = status_db.find_installed(job.spec);
+            const fs::path archive = Build::get_archive_path(paths, job.abi_tag);
+            if (installed == status_db.end() || (*installed)->package.abi != job.abi_tag ||
+                !paths.get_filesystem().exists(archive))
+            {
+                return BuildQueue::ABI_MISMATCH;
+            }
+
+            BinaryCaching::queue_upload(paths, job.spec, job.abi_tag, archive);
+            BinaryCaching::wait_for_uploads();
+            return Build::to_string(Build::BuildResult::SUCCEEDED);
+        }
+
+        const std::vector<Optional<std::string>> abi_tags =
+            Install::compute_planned_abis(action_plan, install_plan_options, paths, status_db);
+        const size_t index = it_action - action_plan.cbegin();
+        if (abi_tags[index].value_or(Strings::EMPTY) != job.abi_tag) return BuildQueue::ABI_MISMATCH;
+
+        // Waits for the uploads, so the package is in the binary sources before the coordinator hears of it
+        const Install::InstallSummary summary =
+            Install::perform(action_plan, install_plan_options, Install::KeepGoing::YES, 1, paths, status_db);
+        return Build::to_string(summary.results[index].build_result.code);
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    {
+        static const std::string OPTION_QUEUE = "--queue";
+        static const std::string EXAMPLE =
+            Commands::Help::create_example_string(R"(--binarycaching x-build-worker --queue=\\server\vcpkg-queue)");
+        args.check_exact_arg_count(0, EXAMPLE);
+
+        const ParsedArguments parsed_arguments = args.check_and_get_optional_command_arguments({}, {OPTION_QUEUE});
+        Optional<fs::path> queue_dir = BuildQueue::get_queue_dir();
+        const auto it_queue = parsed_arguments.settings.find(OPTION_QUEUE);
+        if (it_queue != parsed_arguments.settings.cend()) queue_dir = fs::path(it_queue->second);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           queue_dir.has_value(),
+                           "Error: pass %s or set VCPKG_BUILD_QUEUE to the queue of the coordinator\n%s",
+                           OPTION_QUEUE,
+                           EXAMPLE);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           GlobalState::binary_caching,
+                           "Error: x-build-worker publishes what it builds to the binary sources, which needs "
+                           "--binarycaching\n%s",
+                           EXAMPLE);
+
+        auto& fs = paths.get_filesystem();
+        const fs::path& queue = queue_dir.value_or_exit(VCPKG_LINE_INFO);
+        System::println("Waiting for builds in %s", queue.u8string());
+        for (;;)
+        {
+            const Optional<BuildQueue::ClaimedJob> maybe_claimed = BuildQueue::try_claim(fs, queue);
+            const auto claimed = maybe_claimed.get();
+            if (!claimed)
+            {
+                std::this_thread::sleep_for(std::chrono::seconds(2));
+                continue;
+            }
+
+            System::println("Building package %s for the coordinator", claimed->job.spec);
+            const std::string result = perform_job(paths, claimed->job);
+            BuildQueue::complete(fs, queue, *claimed, result);
+            System::println("Package %s: %s", claimed->job.spec, result);
+        }
+    }
+}
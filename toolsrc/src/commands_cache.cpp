@@ -4,25 +4,148 @@
 #include "Paragraphs.h"
 #include "vcpkg_Commands.h"
 #include "vcpkg_Files.h"
+#include "vcpkg_Listfile.h"
 #include "vcpkg_System.h"
 
 namespace vcpkg::Commands::Cache
 {
-    static std::vector<BinaryParagraph> read_all_binary_paragraphs(const VcpkgPaths& paths)
+    static const std::string INDEX_HEADER = "vcpkg-cache-index 1";
+
+    std::string CachedPackage::displayname() const
+    {
+        return Strings::format("%s[core]:%s", this->spec.name(), this->spec.triplet());
+    }
+
+    fs::path get_index_path(const VcpkgPaths& paths) { return paths.packages / "vcpkg-cache.index"; }
+
+    static std::string serialize_record(const CachedPackage& package)
+    {
+        return Strings::format("%s\t%s\t%s\t%s\t%s\t%s\t%s",
+                               package.dir,
+                               package.stamp,
+                               package.spec.name(),
+                               package.spec.triplet().canonical_name(),
+                               package.version,
+                               package.abi,
+                               Strings::join(",", package.features));
+    }
+
+    static Optional<CachedPackage> parse_record(const std::string& line)
+    {
+        // The features are last, so a package without any has one field less
+        const std::vector<std::string> fields = Strings::split(line, "\t");
+        if (fields.size() != 6 && fields.size() != 7) return nullopt;
+        if (fields[0].empty() || fields[1].empty()) return nullopt;
+
+        const auto maybe_spec = PackageSpec::from_name_and_triplet(fields[2], Triplet::from_canonical_name(fields[3]));
+        const auto spec = maybe_spec.get();
+        if (!spec) return nullopt;
+
+        CachedPackage package{fields[0], fields[1], *spec, fields[4], fields[5], {}};
+        if (fields.size() == 7) package.features = Strings::split(fields[6], ",");
+        return package;
+    }
+
+    static std::map<std::string, CachedPackage> read_index(const Files::Filesystem& fs, const fs::path& index_path)
+    {
+        std::map<std::string, CachedPackage> records;
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(index_path);
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->empty() || lines->front() != INDEX_HEADER) return records;
+
+        for (auto it = std::next(lines->cbegin()); it != lines->cend(); ++it)
+        {
+            Optional<CachedPackage> record = parse_record(*it);
+            if (auto p = record.get())
+            {
+                std::string dir = p->dir;
+                records.emplace(std::move(dir), std::move(*p));
+            }
+        }
+        return records;
+    }
+
+    static Optional<CachedPackage> read_package_dir(const Files::Filesystem& fs,
+                                                    const fs::path& package_dir,
+                                                    std::string stamp)
     {
-        std::vector<BinaryParagraph> output;
-        for (auto&& path : paths.get_filesystem().get_files_non_recursive(paths.packages))
+        const Expected<Paragraphs::ParagraphViews> maybe_views =
+            Paragraphs::get_paragraph_views(fs, package_dir / "CONTROL");
+        const auto views = maybe_views.get();
+        if (!views || views->paragraphs.empty()) return nullopt;
+
+        const BinaryParagraph core(views->paragraphs.front());
+        CachedPackage package{
+            package_dir.filename().u8string(), std::move(stamp), core.spec, core.version, core.abi, {}};
+        for (auto it = std::next(views->paragraphs.cbegin()); it != views->paragraphs.cend(); ++it)
         {
-            const Expected<std::unordered_map<std::string, std::string>> pghs =
-                Paragraphs::get_single_paragraph(paths.get_filesystem(), path / "CONTROL");
-            if (const auto p = pghs.get())
+            package.features.push_back(BinaryParagraph(*it).feature);
+        }
+        return package;
+    }
+
+    std::vector<CachedPackage> load_cached_packages(const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path index_path = get_index_path(paths);
+        std::map<std::string, CachedPackage> records = read_index(fs, index_path);
+
+        std::vector<CachedPackage> packages;
+        bool is_changed = false;
+        for (auto&& entry : fs.get_entries_non_recursive(paths.packages))
+        {
+            if (!fs::is_directory(entry.status)) continue;
+
+            const std::string dir = entry.path.filename().u8string();
+            std::string stamp = Listfile::get_stamp(fs, entry.path / "CONTROL");
+            const auto it = records.find(dir);
+            if (it != records.end() && !stamp.empty() && it->second.stamp == stamp)
             {
-                const BinaryParagraph binary_paragraph = BinaryParagraph(*p);
-                output.push_back(binary_paragraph);
+                packages.push_back(std::move(it->second));
+                records.erase(it);
+                continue;
             }
+
+            // New, rebuilt or restored since the index was written; only this directory is parsed again
+            is_changed = true;
+            if (stamp.empty()) continue;
+            Optional<CachedPackage> package = read_package_dir(fs, entry.path, std::move(stamp));
+            if (auto p = package.get()) packages.push_back(std::move(*p));
         }
 
-        return output;
+        // What is left was removed, by remove or gc for instance
+        if (!records.empty()) is_changed = true;
+
+        std::sort(packages.begin(), packages.end(), [](const CachedPackage& left, const CachedPackage& right) {
+            return left.dir < right.dir;
+        });
+
+        if (is_changed) save_index(fs, index_path, packages);
+        return packages;
+    }
+
+    void save_index(Files::Filesystem& fs, const fs::path& index_path, const std::vector<CachedPackage>& packages)
+    {
+        std::vector<std::string> lines;
+        lines.reserve(1 + packages.size());
+        lines.push_back(INDEX_HEADER);
+        for (auto&& package : packages)
+        {
+            lines.push_back(serialize_record(package));
+        }
+
+        // Concurrent invocations may both rebuild the index, so each writes its own temporary file
+        fs::path tmp_path = index_path;
+        tmp_path += Strings::format(".%d.tmp", static_cast<int>(GetCurrentProcessId()));
+        std::error_code ec;
+        fs.create_directories(index_path.parent_path(), ec);
+        fs.write_lines(tmp_path, lines);
+
+        fs.rename(tmp_path, index_path, ec);
+        if (ec)
+        {
+            fs.remove(tmp_path, ec);
+        }
     }
 
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
@@ -33,8 +156,8 @@ namespace vcpkg::Commands::Cache
         args.check_max_arg_count(1, EXAMPLE);
         args.check_and_get_optional_command_arguments({});
 
-        const std::vector<BinaryParagraph> binary_paragraphs = read_all_binary_paragraphs(paths);
-        if (binary_paragraphs.empty())
+        const std::vector<CachedPackage> packages = load_cached_packages(paths);
+        if (packages.empty())
         {
             System::println("No packages are cached.");
             Checks::exit_success(VCPKG_LINE_INFO);
@@ -42,19 +165,19 @@ namespace vcpkg::Commands::Cache
 
         if (args.command_arguments.size() == 0)
         {
-            for (const BinaryParagraph& binary_paragraph : binary_paragraphs)
+            for (const CachedPackage& package : packages)
             {
-                const std::string displayname = binary_paragraph.displayname();
-                System::println(displayname);
+                System::println(package.displayname());
             }
         }
         else
         {
             // At this point there is 1 argument
-            for (const BinaryParagraph& binary_paragraph : binary_paragraphs)
+            const Strings::CaseInsensitiveAsciiSearcher filter(args.command_arguments[0]);
+            for (const CachedPackage& package : packages)
             {
-                const std::string displayname = binary_paragraph.displayname();
-                if (Strings::case_insensitive_ascii_find(displayname, args.command_arguments[0]) == displayname.end())
+                const std::string displayname = package.displayname();
+                if (!filter.contains(displayname))
                 {
                     continue;
                 }
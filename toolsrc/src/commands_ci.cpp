@@ -17,43 +17,379 @@ namespace vcpkg::Commands::CI
     using Dependencies::InstallPlanAction;
     using Dependencies::InstallPlanType;
 
-    static std::vector<PackageSpec> load_all_package_specs(Files::Filesystem& fs,
-                                                           const fs::path& ports_directory,
-                                                           const Triplet& triplet)
-    {
-        auto ports = Paragraphs::load_all_ports(fs, ports_directory);
-        return Util::fmap(ports, [&](auto&& control_file) -> PackageSpec {
-            return PackageSpec::from_name_and_triplet(control_file->core_paragraph->name, triplet)
-                .value_or_exit(VCPKG_LINE_INFO);
+    static std::vector<Triplet> get_triplets(const VcpkgCmdArguments& args,
+                                             const VcpkgPaths& paths,
+                                             const Triplet& default_triplet)
+    {
+        std::vector<Triplet> triplets;
+        for (auto&& arg : args.command_arguments)
+        {
+            const Triplet triplet = Triplet::from_canonical_name(arg);
+            if (Util::find(triplets, triplet) == triplets.cend()) triplets.push_back(triplet);
+        }
+        if (triplets.empty()) triplets.push_back(default_triplet);
+
+        for (auto&& triplet : triplets)
+        {
+            Input::check_triplet(triplet, paths);
+        }
+        return triplets;
+    }
+
+    static void print_triplet_summaries(const Install::InstallSummary& summary, const std::vector<Triplet>& triplets)
+    {
+        System::println("\nSUMMARY BY TRIPLET");
+        for (auto&& triplet : triplets)
+        {
+            std::map<BuildResult, int> counts;
+            for (auto&& result : summary.results)
+            {
+                if (result.spec.triplet() == triplet) counts[result.build_result.code]++;
+            }
+
+            System::println("    %s:", triplet);
+            for (auto&& entry : counts)
+            {
+                System::println("        %s: %d", Build::to_string(entry.first), entry.second);
+            }
+        }
+    }
+
+    static const std::string RESULTS_FILENAME = "ci-results.txt";
+
+    /// <summary>
+    /// The result of building a package with the ABI tag it had in a previous run
+    /// </summary>
+    struct PreviousResult
+    {
+        std::string abi;
+        BuildResult code;
+    };
+
+    /// <summary>
+    /// The results are kept with the binary cache, which is what outlives the machines and trees of a CI run
+    /// </summary>
+    static fs::path get_results_path(const VcpkgPaths& paths)
+    {
+        return Build::get_binary_cache_dir(paths) / RESULTS_FILENAME;
+    }
+
+    /// <summary>
+    /// Each line is "<spec> <abi> <result>"
+    /// </summary>
+    static std::map<std::string, PreviousResult> load_previous_results(const VcpkgPaths& paths)
+    {
+        std::map<std::string, PreviousResult> results;
+        const Expected<std::vector<std::string>> maybe_lines =
+            paths.get_filesystem().read_lines(get_results_path(paths));
+        const auto lines = maybe_lines.get();
+        if (!lines) return results;
+
+        for (auto&& line : *lines)
+        {
+            const std::vector<std::string> fields = Strings::split(line, " ");
+            if (fields.size() != 3) continue;
+
+            const auto code = std::find_if(
+                Build::BUILD_RESULT_VALUES.cbegin(), Build::BUILD_RESULT_VALUES.cend(), [&](const BuildResult result) {
+                    return Build::to_string(result) == fields[2];
+                });
+            if (code != Build::BUILD_RESULT_VALUES.cend()) results[fields[0]] = PreviousResult{fields[1], *code};
+        }
+        return results;
+    }
+
+    static void save_results(const VcpkgPaths& paths, const std::map<std::string, PreviousResult>& results)
+    {
+        auto& fs = paths.get_filesystem();
+        std::vector<std::string> lines;
+        for (auto&& entry : results)
+        {
+            lines.push_back(
+                Strings::format("%s %s %s", entry.first, entry.second.abi, Build::to_string(entry.second.code)));
+        }
+
+        std::error_code ec;
+        const fs::path results_path = get_results_path(paths);
+        fs.create_directories(results_path.parent_path(), ec);
+        fs.write_lines(results_path, lines);
+    }
+
+    static std::vector<std::vector<size_t>> get_dependency_indices(
+        const std::vector<Dependencies::AnyAction>& action_plan)
+    {
+        std::unordered_map<PackageSpec, size_t> index_of_spec;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+            index_of_spec.emplace(action_plan[i].spec(), i);
+
+        return Util::fmap(action_plan, [&](const Dependencies::AnyAction& action) {
+            std::vector<size_t> indices;
+            for (auto&& spec : Install::get_install_plan_dependencies(*action.install_plan.get()))
+            {
+                const auto it = index_of_spec.find(spec);
+                if (it != index_of_spec.cend()) indices.push_back(it->second);
+            }
+            return indices;
         });
     }
 
+    /// <summary>
+    /// Marks the action and everything it depends on, and returns how long the ones which were not marked yet take
+    /// </summary>
+    static double add_with_dependencies(const std::vector<std::vector<size_t>>& dependencies,
+                                        const std::vector<double>& durations,
+                                        const size_t index,
+                                        std::vector<bool>& included)
+    {
+        double added = 0;
+        std::vector<size_t> stack = {index};
+        while (!stack.empty())
+        {
+            const size_t i = stack.back();
+            stack.pop_back();
+            if (included[i]) continue;
+
+            included[i] = true;
+            added += durations[i];
+            stack.insert(stack.end(), dependencies[i].cbegin(), dependencies[i].cend());
+        }
+        return added;
+    }
+
+    std::vector<size_t> select_shard(const std::vector<std::vector<size_t>>& dependencies,
+                                     const std::vector<double>& durations,
+                                     const size_t shard,
+                                     const size_t shard_count)
+    {
+        const size_t action_count = dependencies.size();
+        std::vector<double> closure_durations(action_count);
+        for (size_t i = 0; i < action_count; ++i)
+        {
+            std::vector<bool> included(action_count);
+            closure_durations[i] = add_with_dependencies(dependencies, durations, i, included);
+        }
+
+        // Placing the actions which take longest with their dependencies first balances the shards best. An action
+        // takes at least as long as any of its dependencies, and comes after them in the plan, so it is placed first
+        // and usually brings them into its shard.
+        std::vector<size_t> order(action_count);
+        for (size_t i = 0; i < action_count; ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](const size_t left, const size_t right) {
+            if (closure_durations[left] != closure_durations[right])
+                return closure_durations[left] > closure_durations[right];
+            return left > right;
+        });
+
+        std::vector<std::vector<bool>> included(shard_count, std::vector<bool>(action_count));
+        std::vector<double> loads(shard_count);
+        std::vector<bool> placed(action_count);
+        for (const size_t index : order)
+        {
+            if (placed[index]) continue;
+
+            size_t best_shard = 0;
+            double best_load = 0;
+            for (size_t s = 0; s < shard_count; ++s)
+            {
+                std::vector<bool> trial = included[s];
+                const double load = loads[s] + add_with_dependencies(dependencies, durations, index, trial);
+                if (s == 0 || load < best_load)
+                {
+                    best_shard = s;
+                    best_load = load;
+                }
+            }
+
+            loads[best_shard] = best_load;
+            add_with_dependencies(dependencies, durations, index, included[best_shard]);
+            for (size_t i = 0; i < action_count; ++i)
+            {
+                if (included[best_shard][i]) placed[i] = true;
+            }
+        }
+
+        std::vector<size_t> selected;
+        for (size_t i = 0; i < action_count; ++i)
+        {
+            if (included[shard][i]) selected.push_back(i);
+        }
+        return selected;
+    }
+
+    /// <summary>
+    /// Parses a shard like 2/8 into the zero-based index of the shard and the number of shards
+    /// </summary>
+    static std::pair<size_t, size_t> parse_shard(const std::string& text)
+    {
+        const auto slash = text.find('/');
+        const int shard = slash == std::string::npos ? 0 : atoi(text.substr(0, slash).c_str());
+        const int shard_count = slash == std::string::npos ? 0 : atoi(text.substr(slash + 1).c_str());
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           shard > 0 && shard <= shard_count,
+                           "Error: --shard must be a shard and the number of shards, like 2/8, but was '%s'",
+                           text);
+        return {static_cast<size_t>(shard - 1), static_cast<size_t>(shard_count)};
+    }
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
-        static const std::string EXAMPLE = Commands::Help::create_example_string("ci x64-windows");
-        args.check_max_arg_count(1, EXAMPLE);
-        const Triplet triplet = args.command_arguments.size() == 1
-                                    ? Triplet::from_canonical_name(args.command_arguments.at(0))
-                                    : default_triplet;
-        Input::check_triplet(triplet, paths);
-        args.check_and_get_optional_command_arguments({});
-        const std::vector<PackageSpec> specs = load_all_package_specs(paths.get_filesystem(), paths.ports, triplet);
+        static const std::string OPTION_JOBS = "--jobs";
+        static const std::string OPTION_JSON_REPORT = "--json-report";
+        static const std::string OPTION_SHARD = "--shard";
+        static const std::string OPTION_REBUILD_ALL = "--rebuild-all";
+        static const std::string OPTION_DRY_RUN = "--dry-run";
+
+        const ParsedArguments parsed_arguments = args.check_and_get_optional_command_arguments(
+            {OPTION_REBUILD_ALL, OPTION_DRY_RUN}, {OPTION_JOBS, OPTION_JSON_REPORT, OPTION_SHARD});
+        const bool rebuild_all =
+            parsed_arguments.switches.find(OPTION_REBUILD_ALL) != parsed_arguments.switches.cend();
+        const bool dry_run = parsed_arguments.switches.find(OPTION_DRY_RUN) != parsed_arguments.switches.cend();
+        const size_t jobs = Install::parse_jobs(parsed_arguments, OPTION_JOBS);
+        const std::vector<Triplet> triplets = get_triplets(args, paths, default_triplet);
+
+        // The builds need these, which are probed while the ports are parsed and the plan is computed
+        if (!dry_run) Build::start_warm_up(paths, {LazyTool::CMAKE, LazyTool::GIT, LazyTool::TOOLSETS}, triplets);
+
+        // The ports are parsed once and shared by the plans for all triplets
+        std::vector<std::string> port_names;
+        std::unordered_map<std::string, SourceControlFile> ports;
+        for (auto&& control_file : Paragraphs::load_all_ports(paths))
+        {
+            port_names.push_back(control_file->core_paragraph->name);
+            ports.emplace(control_file->core_paragraph->name, std::move(*control_file));
+        }
+
+        std::vector<PackageSpec> specs;
+        for (auto&& triplet : triplets)
+        {
+            for (auto&& port_name : port_names)
+            {
+                specs.push_back(PackageSpec::from_name_and_triplet(port_name, triplet).value_or_exit(VCPKG_LINE_INFO));
+            }
+        }
 
         StatusParagraphs status_db = database_load_check(paths);
-        const auto& paths_port_file = Dependencies::PathsPortFile(paths);
+        const Dependencies::MapPortFile map_port_file(ports);
         std::vector<InstallPlanAction> install_plan =
-            Dependencies::create_install_plan(paths_port_file, specs, status_db);
+            Dependencies::create_install_plan(map_port_file, specs, status_db);
         Checks::check_exit(VCPKG_LINE_INFO, !install_plan.empty(), "Install plan cannot be empty");
 
-        const Build::BuildPackageOptions install_plan_options = {Build::UseHeadVersion::NO, Build::AllowDownloads::YES};
+        const Build::BuildPackageOptions install_plan_options = {
+            Build::UseHeadVersion::NO, Build::AllowDownloads::YES, Build::IncrementalBuild::NO, 0};
 
-        const std::vector<Dependencies::AnyAction> action_plan =
+        // A single plan lets independent builds for different triplets share the job pool
+        std::vector<Dependencies::AnyAction> action_plan =
             Util::fmap(install_plan, [](InstallPlanAction& install_action) {
                 return Dependencies::AnyAction(std::move(install_action));
             });
 
-        Install::perform_and_exit(
-            action_plan, install_plan_options, Install::KeepGoing::YES, Install::PrintSummary::YES, paths, status_db);
+        // Every machine computes the same plan and keeps its own part of it
+        const auto it_shard = parsed_arguments.settings.find(OPTION_SHARD);
+        if (it_shard != parsed_arguments.settings.cend())
+        {
+            const std::pair<size_t, size_t> shard = parse_shard(it_shard->second);
+
+            const std::vector<std::vector<size_t>> dependencies = get_dependency_indices(action_plan);
+            const std::vector<double> durations =
+                Install::estimate_durations(action_plan, Build::BuildTimes::load(paths));
+            const std::vector<size_t> selected = select_shard(dependencies, durations, shard.first, shard.second);
+            System::println("Shard %d/%d has %d of the %d packages",
+                            static_cast<int>(shard.first + 1),
+                            static_cast<int>(shard.second),
+                            static_cast<int>(selected.size()),
+                            static_cast<int>(action_plan.size()));
+
+            action_plan = Util::fmap(selected, [&](const size_t i) { return std::move(action_plan[i]); });
+        }
+
+        // A package with the ABI tag it had in the previous run would build the same way again, so its result is
+        // reused, unless a package which is built now needs it installed
+        const std::vector<Optional<std::string>> abi_tags =
+            Install::compute_planned_abis(action_plan, install_plan_options, paths, status_db);
+        std::map<std::string, PreviousResult> results = load_previous_results(paths);
+        std::vector<Optional<BuildResult>> reused_results(action_plan.size());
+        if (!rebuild_all)
+        {
+            for (size_t i = 0; i < action_plan.size(); ++i)
+            {
+                const auto abi = abi_tags[i].get();
+                const auto previous = results.find(action_plan[i].spec().to_string());
+                if (abi && previous != results.cend() && previous->second.abi == *abi)
+                {
+                    reused_results[i] = previous->second.code;
+                }
+            }
+
+            // The packages come after their dependencies in the plan
+            const std::vector<std::vector<size_t>> dependencies = get_dependency_indices(action_plan);
+            for (size_t i = action_plan.size(); i-- > 0;)
+            {
+                if (reused_results[i].has_value()) continue;
+                for (const size_t dependency : dependencies[i])
+                {
+                    // A failure is reused all the same; the package which needs it fails with missing dependencies
+                    if (reused_results[dependency].value_or(BuildResult::NULLVALUE) == BuildResult::SUCCEEDED)
+                    {
+                        reused_results[dependency] = nullopt;
+                    }
+                }
+            }
+        }
+
+        const std::vector<PackageSpec> planned_specs =
+            Util::fmap(action_plan, [](const Dependencies::AnyAction& action) { return action.spec(); });
+        std::vector<Dependencies::AnyAction> changed_plan;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            if (reused_results[i].has_value()) continue;
+            changed_plan.push_back(std::move(action_plan[i]));
+        }
+        if (changed_plan.size() != planned_specs.size())
+        {
+            System::println("Skipping %d packages which are unchanged since the last run",
+                            static_cast<int>(planned_specs.size() - changed_plan.size()));
+        }
+
+        if (dry_run)
+        {
+            Install::print_plan_estimate(
+                changed_plan, install_plan_options, Install::PlanOrder::CRITICAL_PATH, jobs, paths, status_db);
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        const ElapsedTime timer = ElapsedTime::create_started();
+        Install::InstallSummary summary{{}, timer.to_string(), timer.microseconds()};
+        if (!changed_plan.empty())
+        {
+            summary =
+                Install::perform(changed_plan, install_plan_options, Install::KeepGoing::YES, jobs, paths, status_db);
+        }
+
+        std::vector<Install::SpecSummary> changed_results = std::move(summary.results);
+        summary.results.clear();
+        size_t next_changed = 0;
+        for (size_t i = 0; i < planned_specs.size(); ++i)
+        {
+            if (const auto reused = reused_results[i].get())
+            {
+                summary.results.push_back({planned_specs[i], {*reused, {}}, "unchanged", 0});
+                continue;
+            }
+
+            Install::SpecSummary& result = changed_results[next_changed++];
+            const BuildResult code = result.build_result.code;
+            if (const auto abi = abi_tags[i].get())
+            {
+                if (code != BuildResult::NULLVALUE) results[planned_specs[i].to_string()] = PreviousResult{*abi, code};
+            }
+            summary.results.push_back(std::move(result));
+        }
+        save_results(paths, results);
+
+        summary.print();
+        print_triplet_summaries(summary, triplets);
+        Install::write_json_report_if_requested(paths, parsed_arguments, OPTION_JSON_REPORT, summary);
 
         Checks::exit_success(VCPKG_LINE_INFO);
     }
@@ -17,8 +17,6 @@ namespace vcpkg::Commands::Create
         const std::string port_name = args.command_arguments.at(0);
         const std::string url = args.command_arguments.at(1);
 
-        const fs::path& cmake_exe = paths.get_cmake_exe();
-
         std::vector<CMakeVariable> cmake_args{{L"CMD", L"CREATE"}, {L"PORT", port_name}, {L"URL", url}};
 
         if (args.command_arguments.size() >= 3)
@@ -32,7 +30,7 @@ namespace vcpkg::Commands::Create
             cmake_args.push_back({L"FILENAME", zip_file_name});
         }
 
-        const std::wstring cmd_launch_cmake = make_cmake_cmd(cmake_exe, paths.ports_cmake, cmake_args);
+        const std::wstring cmd_launch_cmake = make_ports_cmake_cmd(paths, std::move(cmake_args));
         Checks::exit_with_code(VCPKG_LINE_INFO, System::cmd_execute_clean(cmd_launch_cmake));
     }
 }
@@ -2,6 +2,8 @@
 
 #include "Paragraphs.h"
 #include "vcpkg_Commands.h"
+#include "vcpkg_Dependencies.h"
+#include "vcpkg_Graphs.h"
 #include "vcpkg_Strings.h"
 #include "vcpkg_System.h"
 #include "vcpkg_Util.h"
@@ -10,36 +12,60 @@ namespace vcpkg::Commands::DependInfo
 {
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
     {
-        static const std::string EXAMPLE = Commands::Help::create_example_string(R"###(depend-info [pat])###");
+        static const std::string OPTION_RECURSE = "--recurse";
+        static const std::string EXAMPLE =
+            Commands::Help::create_example_string(R"###(depend-info [pat] [--recurse])###");
         args.check_max_arg_count(1, EXAMPLE);
-        args.check_and_get_optional_command_arguments({});
+        const std::unordered_set<std::string> options =
+            args.check_and_get_optional_command_arguments({OPTION_RECURSE});
+        const bool recurse = options.find(OPTION_RECURSE) != options.cend();
 
-        std::vector<std::unique_ptr<SourceControlFile>> source_control_files =
-            Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
+        std::vector<std::unique_ptr<SourceControlFile>> source_control_files = Paragraphs::load_all_ports(paths);
 
         if (args.command_arguments.size() == 1)
         {
-            const std::string filter = args.command_arguments.at(0);
+            const Strings::CaseInsensitiveAsciiSearcher filter(args.command_arguments.at(0));
+            const Graphs::Graph<std::string> graph = Dependencies::create_port_graph(source_control_files, nullopt);
 
-            Util::erase_remove_if(source_control_files,
-                                  [&](const std::unique_ptr<SourceControlFile>& source_control_file) {
-
-                                      const SourceParagraph& source_paragraph = *source_control_file->core_paragraph;
+            // The ports and dependencies matching the filter
+            Graphs::VertexSet matched(graph.vertex_count());
+            for (size_t id = 0; id < graph.vertex_count(); ++id)
+            {
+                if (filter.contains(graph.vertex(id))) matched.insert(id);
+            }
 
-                                      if (Strings::case_insensitive_ascii_contains(source_paragraph.name, filter))
-                                      {
-                                          return false;
-                                      }
+            // The ports which depend on a match through the core or a feature, and with --recurse also the ports which
+            // depend on one of those
+            Graphs::VertexSet selected = matched;
+            if (recurse)
+            {
+                const std::vector<Graphs::VertexSet> dependents = Graphs::transpose(graph.transitive_closure());
+                matched.for_each([&](const size_t id) { selected |= dependents[id]; });
+            }
+            else
+            {
+                const auto matches = [&](const Dependency& dependency) {
+                    return filter.contains(dependency.depend.name);
+                };
+                for (auto&& source_control_file : source_control_files)
+                {
+                    bool depends_on_match = Util::find_if(source_control_file->core_paragraph->depends, matches) !=
+                                            source_control_file->core_paragraph->depends.cend();
+                    for (auto&& feature : source_control_file->feature_paragraphs)
+                    {
+                        depends_on_match |= Util::find_if(feature->depends, matches) != feature->depends.cend();
+                    }
 
-                                      for (const Dependency& dependency : source_paragraph.depends)
-                                      {
-                                          if (Strings::case_insensitive_ascii_contains(dependency.name(), filter))
-                                          {
-                                              return false;
-                                          }
-                                      }
+                    const Optional<size_t> id = graph.id_of(source_control_file->core_paragraph->name);
+                    if (depends_on_match) selected.insert(id.value_or_exit(VCPKG_LINE_INFO));
+                }
+            }
 
-                                      return true;
+            Util::erase_remove_if(source_control_files,
+                                  [&](const std::unique_ptr<SourceControlFile>& source_control_file) {
+                                      const Optional<size_t> id =
+                                          graph.id_of(source_control_file->core_paragraph->name);
+                                      return !selected.contains(id.value_or_exit(VCPKG_LINE_INFO));
                                   });
         }
 
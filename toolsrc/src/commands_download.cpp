@@ -0,0 +1,303 @@
+#include "pch.h"
+
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Http.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+
+namespace vcpkg::Commands::Download
+{
+    static constexpr size_t MAX_CONNECTIONS = 4;
+    static constexpr size_t MAX_ATTEMPTS_PER_RANGE = 3;
+
+    /// <summary>
+    /// Files smaller than this are not worth splitting between connections
+    /// </summary>
+    static constexpr uint64_t MIN_RANGE_SIZE = 8 * 1024 * 1024;
+
+    /// <summary>
+    /// How much a connection downloads between updates of the progress file
+    /// </summary>
+    static constexpr uint64_t PROGRESS_INTERVAL = 4 * 1024 * 1024;
+
+    struct Range
+    {
+        uint64_t begin;
+        uint64_t end;
+        uint64_t done;
+    };
+
+    /// <summary>
+    /// A download in progress, kept as &lt;file&gt;.partial. The progress file next to it records the expected hash,
+    /// the size of the file and one line per range: begin end done. Since the hash identifies the contents, a
+    /// download which failed can be resumed from another URL.
+    /// </summary>
+    struct PartialDownload
+    {
+        fs::path data_path;
+        fs::path progress_path;
+        std::string sha512;
+        uint64_t size;
+        std::vector<Range> ranges;
+        std::mutex progress_mutex;
+
+        /// <summary>
+        /// Called by every connection, so the ranges are read and the file is written under progress_mutex
+        /// </summary>
+        void save_progress(Files::Filesystem& fs)
+        {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            std::vector<std::string> lines = {sha512, std::to_string(size)};
+            for (auto&& range : ranges)
+            {
+                lines.push_back(std::to_string(range.begin) + ' ' + std::to_string(range.end) + ' ' +
+                                std::to_string(range.done));
+            }
+            fs.write_lines(progress_path, lines);
+        }
+
+        void load_progress(const Files::Filesystem& fs)
+        {
+            ranges.clear();
+            if (!fs.exists(data_path)) return;
+
+            const auto maybe_lines = fs.read_lines(progress_path);
+            const auto lines = maybe_lines.get();
+            if (!lines || lines->size() < 3 || (*lines)[0] != sha512 || (*lines)[1] != std::to_string(size)) return;
+
+            for (auto it = lines->cbegin() + 2; it != lines->cend(); ++it)
+            {
+                Range range;
+                if (sscanf_s(it->c_str(), "%llu %llu %llu", &range.begin, &range.end, &range.done) != 3 ||
+                    range.begin + range.done > range.end || range.end > size)
+                {
+                    ranges.clear();
+                    return;
+                }
+                ranges.push_back(range);
+            }
+        }
+
+        void split(const size_t connections)
+        {
+            ranges.clear();
+            const uint64_t range_size = (size + connections - 1) / connections;
+            for (uint64_t begin = 0; begin < size; begin += range_size)
+            {
+                ranges.push_back({begin, std::min(begin + range_size, size), 0});
+            }
+        }
+    };
+
+    /// <summary>
+    /// Fetches the rest of one range into its place in the partial file. The first range also feeds the hasher,
+    /// as long as it has seen every byte before the range's position.
+    /// </summary>
+    static bool download_range(Files::Filesystem& fs,
+                               const HINTERNET session,
+                               const Http::ParsedUrl& url,
+                               PartialDownload& partial,
+                               Range& range,
+                               Hash::Hasher* hasher)
+    {
+        std::fstream output(partial.data_path, std::ios::binary | std::ios::in | std::ios::out);
+        if (!output) return false;
+
+        for (size_t attempt = 0; attempt < MAX_ATTEMPTS_PER_RANGE && range.begin + range.done < range.end; ++attempt)
+        {
+            const std::wstring headers = L"Range: bytes=" + std::to_wstring(range.begin + range.done) + L'-' +
+                                         std::to_wstring(range.end - 1) + L"\r\n";
+            const auto request = Http::send_request(session, url, L"GET", headers);
+            if (!request || request->status_code != 206) continue;
+
+            output.seekp(range.begin + range.done);
+            uint64_t unsaved = 0;
+            Http::read_body(request->request, [&](const char* data, const size_t size) {
+                const uint64_t remaining = range.end - range.begin - range.done;
+                const size_t used = static_cast<size_t>(std::min<uint64_t>(size, remaining));
+                output.write(data, used);
+                if (!output) return false;
+                if (hasher != nullptr) hasher->add(data, used);
+
+                {
+                    std::lock_guard<std::mutex> lock(partial.progress_mutex);
+                    range.done += used;
+                }
+
+                // The data has to reach the file before the progress which claims it
+                unsaved += used;
+                if (unsaved >= PROGRESS_INTERVAL)
+                {
+                    output.flush();
+                    partial.save_progress(fs);
+                    unsaved = 0;
+                }
+                return used == size;
+            });
+        }
+
+        output.flush();
+        partial.save_progress(fs);
+        return range.begin + range.done == range.end;
+    }
+
+    /// <summary>
+    /// Hashes data_path from offset to its end
+    /// </summary>
+    static bool hash_file_from(const fs::path& data_path, const uint64_t offset, Hash::Hasher& hasher)
+    {
+        std::ifstream input(data_path, std::ios::binary);
+        input.seekg(offset);
+        std::vector<char> buffer(1024 * 1024);
+        do
+        {
+            input.read(buffer.data(), buffer.size());
+            hasher.add(buffer.data(), static_cast<size_t>(input.gcount()));
+        } while (input);
+        return input.eof();
+    }
+
+    /// <summary>
+    /// Downloads the file from one URL, splitting it between several connections when the server accepts ranges.
+    /// Returns the hash of the downloaded data, or nothing if the download failed; a failed ranged download is
+    /// kept to be resumed.
+    /// </summary>
+    static Optional<std::string> download_from(Files::Filesystem& fs,
+                                               const HINTERNET session,
+                                               const std::string& url_string,
+                                               PartialDownload& partial)
+    {
+        const auto maybe_url = Http::parse_url(url_string);
+        const auto url = maybe_url.get();
+        if (!url)
+        {
+            System::println(System::Color::error, "Error: %s is not an http or https URL", url_string);
+            return nullopt;
+        }
+
+        Optional<std::wstring> accept_ranges;
+        Optional<std::wstring> content_length;
+        const auto head = Http::send_request(session, *url, L"HEAD", std::wstring());
+        if (head && head->status_code == 200)
+        {
+            accept_ranges = Http::query_header(head->request, WINHTTP_QUERY_ACCEPT_RANGES);
+            content_length = Http::query_header(head->request, WINHTTP_QUERY_CONTENT_LENGTH);
+        }
+
+        if (accept_ranges.value_or(L"") == L"bytes" && content_length.get() != nullptr)
+        {
+            partial.size = std::stoull(*content_length.get());
+            partial.load_progress(fs);
+            const bool resumed = !partial.ranges.empty();
+            if (!resumed)
+            {
+                partial.split(static_cast<size_t>(
+                    std::min<uint64_t>(MAX_CONNECTIONS, std::max<uint64_t>(1, partial.size / MIN_RANGE_SIZE))));
+                fs.write_contents(partial.data_path, Strings::EMPTY);
+                std::error_code ec;
+                fs::stdfs::resize_file(partial.data_path, partial.size, ec);
+                if (ec) return nullopt;
+                partial.save_progress(fs);
+            }
+            else
+            {
+                System::println("Resuming the download of %s", partial.data_path.filename().u8string());
+            }
+
+            // Only the first range of a fresh download sees the data from the start and in order; the rest is
+            // hashed from the file once every range is complete
+            Hash::Hasher hasher("SHA512");
+            std::vector<char> succeeded(partial.ranges.size(), false);
+            Util::parallel_for_each_index(partial.ranges.size(), [&](const size_t i) {
+                Hash::Hasher* const streaming_hasher = !resumed && i == 0 ? &hasher : nullptr;
+                succeeded[i] = download_range(fs, session, *url, partial, partial.ranges[i], streaming_hasher);
+            });
+            if (Util::find(succeeded, false) != succeeded.cend()) return nullopt;
+
+            const uint64_t hashed = resumed ? 0 : partial.ranges.front().end;
+            if (!hash_file_from(partial.data_path, hashed, hasher)) return nullopt;
+            return hasher.finish();
+        }
+
+        // Without ranges the file is streamed through a single connection and cannot be resumed
+        const auto request = Http::send_request(session, *url, L"GET", std::wstring());
+        if (!request || request->status_code != 200) return nullopt;
+
+        std::error_code ec;
+        fs.remove(partial.progress_path, ec);
+        std::ofstream output(partial.data_path, std::ios::binary | std::ios::trunc);
+        Hash::Hasher hasher("SHA512");
+        const bool completed = Http::read_body(request->request, [&](const char* data, const size_t size) {
+            output.write(data, size);
+            hasher.add(data, size);
+            return output.good();
+        });
+        output.close();
+        if (!completed || !output) return nullopt;
+        return hasher.finish();
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args)
+    {
+        static const std::string EXAMPLE = Commands::Help::create_example_string(
+            R"###(download downloads\zlib1211.tar.gz <sha512> https://zlib.net/zlib-1.2.11.tar.gz)###");
+        args.check_min_arg_count(3, EXAMPLE);
+        args.check_and_get_optional_command_arguments({});
+
+        const fs::path file_path = fs::stdfs::absolute(Strings::to_utf16(args.command_arguments[0]));
+        const std::string expected_hash = Strings::ascii_to_lowercase(args.command_arguments[1]);
+        const std::vector<std::string> urls(args.command_arguments.cbegin() + 2, args.command_arguments.cend());
+
+        auto& fs = Files::get_real_filesystem();
+        PartialDownload partial;
+        partial.data_path = file_path.parent_path() / (file_path.filename().u8string() + ".partial");
+        partial.progress_path = file_path.parent_path() / (file_path.filename().u8string() + ".partial.progress");
+        partial.sha512 = expected_hash;
+        partial.size = 0;
+
+        const HINTERNET session = WinHttpOpen(
+            L"vcpkg/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+        Checks::check_exit(VCPKG_LINE_INFO, session != nullptr, "Failed to open a WinHTTP session");
+
+        std::error_code ec;
+        for (auto&& url : urls)
+        {
+            const Optional<std::string> maybe_hash = download_from(fs, session, url, partial);
+            const auto actual_hash = maybe_hash.get();
+            if (!actual_hash)
+            {
+                System::println(System::Color::warning, "Downloading %s... Failed", url);
+                continue;
+            }
+
+            if (*actual_hash != expected_hash)
+            {
+                // The progress is for data which cannot be right, so the next URL starts over
+                System::println(System::Color::error,
+                                "\nFile does not have expected hash:\n"
+                                "             Url : [ %s ]\n"
+                                "        File path: [ %s ]\n"
+                                "    Expected hash: [ %s ]\n"
+                                "      Actual hash: [ %s ]\n",
+                                url,
+                                file_path.u8string(),
+                                expected_hash,
+                                *actual_hash);
+                fs.remove(partial.data_path, ec);
+                fs.remove(partial.progress_path, ec);
+                continue;
+            }
+
+            fs.rename(partial.data_path, file_path, ec);
+            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Failed to rename the download to %s", file_path.u8string());
+            fs.remove(partial.progress_path, ec);
+            WinHttpCloseHandle(session);
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        WinHttpCloseHandle(session);
+        Checks::exit_fail(VCPKG_LINE_INFO);
+    }
+}
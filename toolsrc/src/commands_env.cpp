@@ -2,19 +2,102 @@
 
 #include "vcpkg_Build.h"
 #include "vcpkg_Commands.h"
+#include "vcpkg_Strings.h"
 #include "vcpkg_System.h"
 
 namespace vcpkg::Commands::Env
 {
+    static const std::string OPTION_PRINT = "--print";
+    static const std::string OPTION_SHELL = "--shell";
+
+    static const std::string SHELL_CMD = "cmd";
+    static const std::string SHELL_POWERSHELL = "powershell";
+
+    /// <summary>
+    /// The variables of an environment block, without the ones whose names start with '=', which cmd uses for the
+    /// current directories of the drives
+    /// </summary>
+    static std::vector<std::pair<std::string, std::string>> to_variables(const std::wstring& environment_block)
+    {
+        std::vector<std::pair<std::string, std::string>> variables;
+        size_t begin = 0;
+        for (size_t end = environment_block.find(L'\0'); end != std::wstring::npos && end != begin;
+             end = environment_block.find(L'\0', begin))
+        {
+            const std::string variable = Strings::to_utf8(environment_block.substr(begin, end - begin));
+            begin = end + 1;
+
+            const size_t equals = variable.find('=');
+            if (equals == 0 || equals == std::string::npos) continue;
+            variables.emplace_back(variable.substr(0, equals), variable.substr(equals + 1));
+        }
+        return variables;
+    }
+
+    /// <summary>
+    /// A script which sets the variables when it is run with call, or with . in PowerShell
+    /// </summary>
+    static std::string make_script(const std::wstring& environment_block, const std::string& shell)
+    {
+        std::string script;
+        for (auto&& variable : to_variables(environment_block))
+        {
+            if (shell == SHELL_POWERSHELL)
+            {
+                const std::string value = Strings::replace_all(std::string(variable.second), "'", "''");
+                script.append(Strings::format("${env:%s} = '%s'\n", variable.first, value));
+            }
+            else
+            {
+                // A batch file expands %VARIABLE% even inside quotes
+                const std::string value = Strings::replace_all(std::string(variable.second), "%", "%%");
+                script.append(Strings::format("set \"%s=%s\"\n", variable.first, value));
+            }
+        }
+        return script;
+    }
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
         static const std::string EXAMPLE = Commands::Help::create_example_string(R"(env --Triplet x64-windows)");
         args.check_exact_arg_count(0, EXAMPLE);
-        args.check_and_get_optional_command_arguments({});
+        const ParsedArguments parsed_arguments =
+            args.check_and_get_optional_command_arguments({OPTION_PRINT}, {OPTION_SHELL});
 
+        std::string shell = SHELL_CMD;
+        const auto it_shell = parsed_arguments.settings.find(OPTION_SHELL);
+        if (it_shell != parsed_arguments.settings.cend()) shell = Strings::ascii_to_lowercase(it_shell->second);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           shell == SHELL_CMD || shell == SHELL_POWERSHELL,
+                           "The shell must be %s or %s, not %s",
+                           SHELL_CMD,
+                           SHELL_POWERSHELL,
+                           shell);
+        const bool print = parsed_arguments.switches.find(OPTION_PRINT) != parsed_arguments.switches.cend();
+
+        // Both the triplet and the vcvarsall environment are usually loaded from their caches, so that neither cmake
+        // nor vcvarsall.bat runs before the shell starts
         const auto pre_build_info = Build::PreBuildInfo::from_triplet_file(paths, default_triplet);
-        System::cmd_execute_clean(
-            Build::make_build_env_cmd(pre_build_info, paths.get_toolset(pre_build_info.platform_toolset)) + L" && cmd");
+        const Toolset& toolset = paths.get_toolset(pre_build_info.platform_toolset);
+        const Optional<std::wstring> maybe_environment = Build::get_build_environment(paths, pre_build_info, toolset);
+        const auto environment = maybe_environment.get();
+
+        if (print)
+        {
+            Checks::check_exit(VCPKG_LINE_INFO, environment != nullptr, "Failed to capture the build environment");
+            System::print(make_script(*environment, shell));
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        const std::wstring shell_cmd = shell == SHELL_POWERSHELL ? L"powershell -NoLogo" : L"cmd";
+        if (environment)
+        {
+            System::execute_with_environment(shell_cmd, *environment);
+        }
+        else
+        {
+            System::cmd_execute_clean(Build::make_build_env_cmd(pre_build_info, toolset) + L" && " + shell_cmd);
+        }
 
         Checks::exit_success(VCPKG_LINE_INFO);
     }
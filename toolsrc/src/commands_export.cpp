@@ -1,9 +1,11 @@
 #include "pch.h"
 
 #include "Paragraphs.h"
+#include "vcpkg_Build.h"
 #include "vcpkg_Commands.h"
 #include "vcpkg_Dependencies.h"
 #include "vcpkg_Input.h"
+#include "vcpkg_Nupkg.h"
 #include "vcpkg_System.h"
 #include "vcpkg_Util.h"
 #include "vcpkglib.h"
@@ -16,39 +18,6 @@ namespace vcpkg::Commands::Export
     using Dependencies::RequestType;
     using Install::InstallDir;
 
-    static std::string create_nuspec_file_contents(const std::string& raw_exported_dir,
-                                                   const std::string& targets_redirect_path,
-                                                   const std::string& nuget_id,
-                                                   const std::string& nupkg_version)
-    {
-        static constexpr auto CONTENT_TEMPLATE = R"(
-<package>
-    <metadata>
-        <id>@NUGET_ID@</id>
-        <version>@VERSION@</version>
-        <authors>vcpkg</authors>
-        <description>
-            Vcpkg NuGet export
-        </description>
-    </metadata>
-    <files>
-        <file src="@RAW_EXPORTED_DIR@\installed\**" target="installed" />
-        <file src="@RAW_EXPORTED_DIR@\scripts\**" target="scripts" />
-        <file src="@RAW_EXPORTED_DIR@\.vcpkg-root" target="" />
-        <file src="@TARGETS_REDIRECT_PATH@" target="build\native\@NUGET_ID@.targets" />
-    </files>
-</package>
-)";
-
-        std::string nuspec_file_content = std::regex_replace(CONTENT_TEMPLATE, std::regex("@NUGET_ID@"), nuget_id);
-        nuspec_file_content = std::regex_replace(nuspec_file_content, std::regex("@VERSION@"), nupkg_version);
-        nuspec_file_content =
-            std::regex_replace(nuspec_file_content, std::regex("@RAW_EXPORTED_DIR@"), raw_exported_dir);
-        nuspec_file_content =
-            std::regex_replace(nuspec_file_content, std::regex("@TARGETS_REDIRECT_PATH@"), targets_redirect_path);
-        return nuspec_file_content;
-    }
-
     static std::string create_targets_redirect(const std::string& target_path) noexcept
     {
         return Strings::format(R"###(
@@ -115,34 +84,31 @@ namespace vcpkg::Commands::Export
                                     const fs::path& output_dir)
     {
         Files::Filesystem& fs = paths.get_filesystem();
-        const fs::path& nuget_exe = paths.get_nuget_exe();
-
-        // This file will be placed in "build\native" in the nuget package. Therefore, go up two dirs.
-        const std::string targets_redirect_content =
-            create_targets_redirect("../../scripts/buildsystems/msbuild/vcpkg.targets");
-        const fs::path targets_redirect = paths.buildsystems / "tmp" / "vcpkg.export.nuget.targets";
-
-        std::error_code ec;
-        fs.create_directories(paths.buildsystems / "tmp", ec);
 
-        fs.write_contents(targets_redirect, targets_redirect_content);
+        const size_t prefix_length = raw_exported_dir.generic_u8string().size() + 1;
+        std::vector<Zip::Entry> files;
+        for (auto&& entry : fs.get_entries_recursive(raw_exported_dir))
+        {
+            if (!fs::is_regular_file(entry.status)) continue;
 
-        const std::string nuspec_file_content =
-            create_nuspec_file_contents(raw_exported_dir.string(), targets_redirect.string(), nuget_id, nuget_version);
-        const fs::path nuspec_file_path = paths.buildsystems / "tmp" / "vcpkg.export.nuspec";
-        fs.write_contents(nuspec_file_path, nuspec_file_content);
+            // The package refers to the installed tree and the scripts, relative to the .vcpkg-root next to them
+            const std::string name = entry.path.generic_u8string().substr(prefix_length);
+            const std::string top = name.substr(0, name.find('/'));
+            if (top != "installed" && top != "scripts" && name != ".vcpkg-root") continue;
 
-        // -NoDefaultExcludes is needed for ".vcpkg-root"
-        const std::wstring cmd_line =
-            Strings::wformat(LR"("%s" pack -OutputDirectory "%s" "%s" -NoDefaultExcludes > nul)",
-                             nuget_exe.native(),
-                             output_dir.native(),
-                             nuspec_file_path.native());
+            files.push_back({name, entry.path, {}});
+        }
 
-        const int exit_code = System::cmd_execute_clean(cmd_line);
-        Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Error: NuGet package creation failed");
+        // This file will be placed in "build\native" in the nuget package. Therefore, go up two dirs.
+        files.push_back({Strings::format("build/native/%s.targets", nuget_id),
+                         fs::path(),
+                         create_targets_redirect("../../scripts/buildsystems/msbuild/vcpkg.targets")});
 
         const fs::path output_path = output_dir / (nuget_id + ".nupkg");
+        const auto written =
+            Nupkg::write(fs, output_path, {nuget_id, nuget_version, "Vcpkg NuGet export"}, std::move(files));
+        Checks::check_exit(
+            VCPKG_LINE_INFO, written.has_value(), "Error: NuGet package creation failed: %s", written.error());
         return output_path;
     }
 
@@ -177,6 +143,16 @@ namespace vcpkg::Commands::Export
         constexpr const ArchiveFormat SEVEN_ZIP(ArchiveFormat::BackingEnum::SEVEN_ZIP, L"7z", L"7zip");
     }
 
+    static fs::path get_archive_path(const fs::path& raw_exported_dir,
+                                     const fs::path& output_dir,
+                                     const ArchiveFormat& format)
+    {
+        const std::wstring exported_dir_filename = raw_exported_dir.filename().native();
+        const std::wstring exported_archive_filename =
+            Strings::wformat(L"%s.%s", exported_dir_filename, format.extension());
+        return output_dir / exported_archive_filename;
+    }
+
     static fs::path do_archive_export(const VcpkgPaths& paths,
                                       const fs::path& raw_exported_dir,
                                       const fs::path& output_dir,
@@ -184,10 +160,7 @@ namespace vcpkg::Commands::Export
     {
         const fs::path& cmake_exe = paths.get_cmake_exe();
 
-        const std::wstring exported_dir_filename = raw_exported_dir.filename().native();
-        const std::wstring exported_archive_filename =
-            Strings::wformat(L"%s.%s", exported_dir_filename, format.extension());
-        const fs::path exported_archive_path = (output_dir / exported_archive_filename);
+        const fs::path exported_archive_path = get_archive_path(raw_exported_dir, output_dir, format);
 
         // -NoDefaultExcludes is needed for ".vcpkg-root"
         const std::wstring cmd_line = Strings::wformat(LR"("%s" -E tar "cf" "%s" --format=%s -- "%s")",
@@ -210,6 +183,52 @@ namespace vcpkg::Commands::Export
         return nullopt;
     }
 
+    /// <summary>
+    /// The export manifest has one "key: stamp" line per exported package, keyed by the stem of its listfile, plus
+    /// one line for each NuGet package or archive which was created from the tree.
+    /// </summary>
+    static std::map<std::string, std::string> load_export_manifest(const Files::Filesystem& fs,
+                                                                   const fs::path& manifest_path)
+    {
+        std::map<std::string, std::string> manifest;
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(manifest_path);
+        if (const auto lines = maybe_lines.get())
+        {
+            for (auto&& line : *lines)
+            {
+                const auto separator = line.find(": ");
+                if (separator == std::string::npos) continue;
+                manifest.emplace(line.substr(0, separator), line.substr(separator + 2));
+            }
+        }
+        return manifest;
+    }
+
+    static void write_export_manifest(Files::Filesystem& fs,
+                                      const fs::path& manifest_path,
+                                      const std::map<std::string, std::string>& manifest)
+    {
+        fs.write_lines(manifest_path, Util::fmap(manifest, [](auto&& entry) {
+                           return entry.first + ": " + entry.second;
+                       }));
+    }
+
+    /// <summary>
+    /// Builds rewrite the CONTROL file of a package, so its size and modification time identify the build
+    /// </summary>
+    static std::string get_package_stamp(const Files::Filesystem& fs, const fs::path& package_dir)
+    {
+        const fs::path control_path = package_dir / "CONTROL";
+        std::error_code ec;
+        const std::uintmax_t size = fs.file_size(control_path, ec);
+        if (ec) return Strings::EMPTY;
+
+        const fs::file_time_type time = fs.last_write_time(control_path, ec);
+        if (ec) return Strings::EMPTY;
+
+        return std::to_string(size) + ':' + std::to_string(time.time_since_epoch().count());
+    }
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
         static const std::string OPTION_DRY_RUN = "--dry-run";
@@ -217,8 +236,10 @@ namespace vcpkg::Commands::Export
         static const std::string OPTION_NUGET = "--nuget";
         static const std::string OPTION_ZIP = "--zip";
         static const std::string OPTION_SEVEN_ZIP = "--7zip";
+        static const std::string OPTION_LINK_FILES = "--x-link-files";
         static const std::string OPTION_NUGET_ID = "--nuget-id";
         static const std::string OPTION_NUGET_VERSION = "--nuget-version";
+        static const std::string OPTION_UPDATE_EXISTING = "--update-existing";
 
         // input sanitization
         static const std::string EXAMPLE =
@@ -238,16 +259,19 @@ namespace vcpkg::Commands::Export
                 OPTION_NUGET,
                 OPTION_ZIP,
                 OPTION_SEVEN_ZIP,
+                OPTION_LINK_FILES,
             },
             {
                 OPTION_NUGET_ID,
                 OPTION_NUGET_VERSION,
+                OPTION_UPDATE_EXISTING,
             });
         const bool dry_run = options.switches.find(OPTION_DRY_RUN) != options.switches.cend();
         const bool raw = options.switches.find(OPTION_RAW) != options.switches.cend();
         const bool nuget = options.switches.find(OPTION_NUGET) != options.switches.cend();
         const bool zip = options.switches.find(OPTION_ZIP) != options.switches.cend();
         const bool seven_zip = options.switches.find(OPTION_SEVEN_ZIP) != options.switches.cend();
+        const bool link_files_requested = options.switches.find(OPTION_LINK_FILES) != options.switches.cend();
 
         if (!raw && !nuget && !zip && !seven_zip && !dry_run)
         {
@@ -258,14 +282,20 @@ namespace vcpkg::Commands::Export
 
         auto maybe_nuget_id = maybe_lookup(options.settings, OPTION_NUGET_ID);
         auto maybe_nuget_version = maybe_lookup(options.settings, OPTION_NUGET_VERSION);
+        auto maybe_update_existing = maybe_lookup(options.settings, OPTION_UPDATE_EXISTING);
 
         Checks::check_exit(VCPKG_LINE_INFO, !maybe_nuget_id || nuget, "--nuget-id is only valid with --nuget");
         Checks::check_exit(
             VCPKG_LINE_INFO, !maybe_nuget_version || nuget, "--nuget-version is only valid with --nuget");
 
+        // The archives are created with cmake, which is probed while the status database loads and the plan is computed
+        if (!dry_run && (nuget || zip || seven_zip)) Build::start_warm_up(paths, {LazyTool::CMAKE}, {});
+
         // create the plan
         const StatusParagraphs status_db = database_load_check(paths);
-        std::vector<ExportPlanAction> export_plan = Dependencies::create_export_plan(paths, specs, status_db);
+        const Dependencies::PathsPortFile paths_port_file(paths);
+        std::vector<ExportPlanAction> export_plan =
+            Dependencies::create_export_plan(paths, paths_port_file, specs, status_db);
         Checks::check_exit(VCPKG_LINE_INFO, !export_plan.empty(), "Export plan cannot be empty");
 
         std::map<ExportPlanType, std::vector<const ExportPlanAction*>> group_by_plan_type;
@@ -305,14 +335,73 @@ namespace vcpkg::Commands::Export
             Checks::exit_success(VCPKG_LINE_INFO);
         }
 
-        const std::string export_id = create_export_id();
-
         Files::Filesystem& fs = paths.get_filesystem();
-        const fs::path export_to_path = paths.root;
-        const fs::path raw_exported_dir_path = export_to_path / export_id;
+        const fs::path raw_exported_dir_path = [&]() -> fs::path {
+            if (const auto update_existing = maybe_update_existing.get()) return fs::stdfs::absolute(*update_existing);
+            return paths.root / create_export_id();
+        }();
+        const fs::path export_to_path = raw_exported_dir_path.parent_path();
+        const fs::path exported_installed_dir = raw_exported_dir_path / "installed";
+        const fs::path exported_info_dir = exported_installed_dir / "vcpkg" / "info";
+        const fs::path manifest_path = exported_installed_dir / "vcpkg" / "export_manifest";
+
         std::error_code ec;
-        fs.remove_all(raw_exported_dir_path, ec);
-        fs.create_directory(raw_exported_dir_path, ec);
+        std::map<std::string, std::string> previous_manifest;
+        std::vector<std::string> previous_package_stems;
+        if (maybe_update_existing && fs.exists(raw_exported_dir_path))
+        {
+            previous_manifest = load_export_manifest(fs, manifest_path);
+            if (fs.exists(exported_info_dir))
+            {
+                for (auto&& listfile : fs.get_files_non_recursive(exported_info_dir))
+                {
+                    if (listfile.extension() == ".list") previous_package_stems.push_back(listfile.stem().u8string());
+                }
+            }
+        }
+        else
+        {
+            fs.remove_all(raw_exported_dir_path, ec);
+            fs.create_directory(raw_exported_dir_path, ec);
+        }
+
+        std::map<std::string, std::string> manifest;
+        for (const ExportPlanAction& action : export_plan)
+        {
+            const BinaryParagraph& binary_paragraph =
+                action.any_paragraph.binary_control_file.value_or_exit(VCPKG_LINE_INFO).core_paragraph;
+            manifest.emplace(binary_paragraph.fullstem(), get_package_stamp(fs, paths.package_dir(action.spec)));
+        }
+
+        // Packages which were removed from the plan or rebuilt since the previous export are removed first, so that
+        // files they no longer contain do not linger
+        bool tree_changed = previous_package_stems.empty();
+        for (auto&& stem : previous_package_stems)
+        {
+            const auto it = manifest.find(stem);
+            const auto previous = previous_manifest.find(stem);
+            if (it != manifest.cend() && previous != previous_manifest.cend() && !it->second.empty() &&
+                previous->second == it->second)
+            {
+                continue;
+            }
+
+            tree_changed = true;
+            const fs::path listfile = exported_info_dir / (stem + ".list");
+            const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(listfile);
+            if (const auto lines = maybe_lines.get())
+            {
+                Remove::remove_listed_files(fs, exported_installed_dir, *lines);
+            }
+            fs.remove(listfile, ec);
+        }
+
+        // When only archives are created, the staging directory is removed again without being modified, so it can
+        // share the files of the packages instead of copying them. A tree which is kept, or packed by nuget, is copied
+        // unless links are asked for, since editing a linked file would edit the file in packages/ as well.
+        const bool tree_is_kept = raw || nuget || maybe_update_existing;
+        const Install::LinkFiles link_files =
+            !tree_is_kept || link_files_requested ? Install::LinkFiles::YES : Install::LinkFiles::NO;
 
         // execute the plan
         for (const ExportPlanAction& action : export_plan)
@@ -323,16 +412,29 @@ namespace vcpkg::Commands::Export
             }
 
             const std::string display_name = action.spec.to_string();
-            System::println("Exporting package %s... ", display_name);
-
             const BinaryParagraph& binary_paragraph =
                 action.any_paragraph.binary_control_file.value_or_exit(VCPKG_LINE_INFO).core_paragraph;
-            const InstallDir dirs = InstallDir::from_destination_root(
-                raw_exported_dir_path / "installed",
-                action.spec.triplet().to_string(),
-                raw_exported_dir_path / "installed" / "vcpkg" / "info" / (binary_paragraph.fullstem() + ".list"));
+            const std::string stem = binary_paragraph.fullstem();
+            const fs::path listfile = exported_info_dir / (stem + ".list");
+
+            const std::string& stamp = manifest[stem];
+            const auto previous = previous_manifest.find(stem);
+            if (!stamp.empty() && previous != previous_manifest.cend() && previous->second == stamp &&
+                fs.exists(listfile))
+            {
+                System::println(System::Color::success, "Package %s is unchanged", display_name);
+                continue;
+            }
 
-            Install::install_files_and_write_listfile(paths.get_filesystem(), paths.package_dir(action.spec), dirs);
+            System::println("Exporting package %s... ", display_name);
+            tree_changed = true;
+            const InstallDir dirs =
+                InstallDir::from_destination_root(exported_installed_dir, action.spec.triplet().to_string(), listfile);
+
+            // Builds never modify the files of a package in place; they remove the package directory and write new
+            // files, which leaves the links alone
+            Install::install_files_and_write_listfile(
+                paths.get_filesystem(), paths.package_dir(action.spec), dirs, link_files);
             System::println(System::Color::success, "Exporting package %s... done", display_name);
         }
 
@@ -377,15 +479,31 @@ namespace vcpkg::Commands::Export
             print_next_step_info(export_to_path);
         }
 
+        // Outputs of an unchanged tree are only created again when they are missing or their options changed
+        const auto is_output_unchanged = [&](const std::string& key, const std::string& stamp, const fs::path& path) {
+            const auto previous = previous_manifest.find(key);
+            return !tree_changed && previous != previous_manifest.cend() && previous->second == stamp &&
+                   fs.exists(path);
+        };
+
         if (nuget)
         {
-            System::println("Creating nuget package... ");
-
             const std::string nuget_id = maybe_nuget_id.value_or(raw_exported_dir_path.filename().string());
             const std::string nuget_version = maybe_nuget_version.value_or("1.0.0");
-            const fs::path output_path =
+            const std::string nuget_stamp = nuget_id + " " + nuget_version;
+            const fs::path output_path = export_to_path / (nuget_id + ".nupkg");
+            manifest.emplace("NuGet", nuget_stamp);
+
+            if (is_output_unchanged("NuGet", nuget_stamp, output_path))
+            {
+                System::println(System::Color::success, "NuGet package %s is unchanged", nuget_id);
+            }
+            else
+            {
+                System::println("Creating nuget package... ");
                 do_nuget_export(paths, nuget_id, nuget_version, raw_exported_dir_path, export_to_path);
-            System::println(System::Color::success, "Creating nuget package... done");
+                System::println(System::Color::success, "Creating nuget package... done");
+            }
             System::println(System::Color::success, "NuGet package exported at: %s", output_path.generic_string());
 
             System::println(R"(
@@ -397,27 +515,60 @@ With a project open, go to Tools->NuGet Package Manager->Package Manager Console
                             output_path.parent_path().u8string());
         }
 
-        if (zip)
+        struct ArchiveExport
         {
-            System::println("Creating zip archive... ");
+            const ArchiveFormat* format;
+            const char* display_name;
+            const char* capitalized_name;
+            fs::path output_path;
+        };
+
+        std::vector<ArchiveExport> archive_exports;
+        if (zip) archive_exports.push_back({&ArchiveFormatC::ZIP, "zip", "Zip", {}});
+        if (seven_zip) archive_exports.push_back({&ArchiveFormatC::SEVEN_ZIP, "7zip", "7zip", {}});
+        Util::erase_remove_if(archive_exports, [&](ArchiveExport& archive_export) {
+            const std::string key = Strings::format("Archive-%s", archive_export.display_name);
             const fs::path output_path =
-                do_archive_export(paths, raw_exported_dir_path, export_to_path, ArchiveFormatC::ZIP);
-            System::println(System::Color::success, "Creating zip archive... done");
-            System::println(System::Color::success, "Zip archive exported at: %s", output_path.generic_string());
-            print_next_step_info("[...]");
-        }
+                get_archive_path(raw_exported_dir_path, export_to_path, *archive_export.format);
+            manifest.emplace(key, "created");
+            if (!is_output_unchanged(key, "created", output_path)) return false;
+
+            System::println(System::Color::success,
+                            "%s archive %s is unchanged",
+                            archive_export.capitalized_name,
+                            output_path.generic_string());
+            return true;
+        });
 
-        if (seven_zip)
+        if (!archive_exports.empty())
         {
-            System::println("Creating 7zip archive... ");
-            const fs::path output_path =
-                do_archive_export(paths, raw_exported_dir_path, export_to_path, ArchiveFormatC::SEVEN_ZIP);
-            System::println(System::Color::success, "Creating 7zip archive... done");
-            System::println(System::Color::success, "7zip archive exported at: %s", output_path.generic_string());
+            // The archives only read the staging directory, so they are created at the same time. The cmake path is
+            // discovered lazily, which is not safe to race on.
+            paths.get_cmake_exe();
+            for (auto&& archive_export : archive_exports)
+            {
+                System::println("Creating %s archive... ", archive_export.display_name);
+            }
+            Util::parallel_for_each_index(archive_exports.size(), [&](const size_t i) {
+                ArchiveExport& archive_export = archive_exports[i];
+                archive_export.output_path =
+                    do_archive_export(paths, raw_exported_dir_path, export_to_path, *archive_export.format);
+            });
+            for (auto&& archive_export : archive_exports)
+            {
+                System::println(System::Color::success, "Creating %s archive... done", archive_export.display_name);
+                System::println(System::Color::success,
+                                "%s archive exported at: %s",
+                                archive_export.capitalized_name,
+                                archive_export.output_path.generic_string());
+            }
             print_next_step_info("[...]");
         }
 
-        if (!raw)
+        write_export_manifest(fs, manifest_path, manifest);
+
+        // A tree which is updated in place is kept for the next update even if --raw was not given
+        if (!raw && !maybe_update_existing)
         {
             fs.remove_all(raw_exported_dir_path, ec);
         }
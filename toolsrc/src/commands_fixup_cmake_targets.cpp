@@ -0,0 +1,242 @@
+#include "pch.h"
+
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+
+// The same transformations as the script fallback of vcpkg_fixup_cmake_targets.cmake, which the output must match
+// byte for byte; the regular expressions of the script are spelled out in the comments
+namespace vcpkg::Commands::FixupCmakeTargets
+{
+    static const std::string IMPORT_PREFIX_BIN = "${_IMPORT_PREFIX}/bin/";
+    static const std::string IMPORT_PREFIX_FROM_LIST_FILE =
+        R"###(get_filename_component(_IMPORT_PREFIX "${CMAKE_CURRENT_LIST_FILE}" PATH))###";
+    static const std::string IMPORT_PREFIX_PARENT =
+        "\n" R"###(get_filename_component(_IMPORT_PREFIX "${_IMPORT_PREFIX}" PATH))###";
+    static const std::string PACKAGE_PREFIX_BEGIN =
+        R"###(get_filename_component(PACKAGE_PREFIX_DIR "${CMAKE_CURRENT_LIST_DIR}/../)###";
+    static const std::string PACKAGE_PREFIX_END = R"###(" ABSOLUTE))###";
+
+    std::string relocate_executables(const std::string& contents, const std::string& port)
+    {
+        // \${_IMPORT_PREFIX}/bin/([^ "]+\.exe) -> ${_IMPORT_PREFIX}/tools/<port>/\1
+        const std::string tools = Strings::format("${_IMPORT_PREFIX}/tools/%s/", port);
+
+        std::string output;
+        size_t copied = 0;
+        size_t pos = contents.find(IMPORT_PREFIX_BIN);
+        while (pos != std::string::npos)
+        {
+            const size_t name_begin = pos + IMPORT_PREFIX_BIN.size();
+            const size_t name_end = std::min(contents.find_first_of(" \"", name_begin), contents.size());
+
+            // The match is greedy, so it ends at the last .exe before a space or a quote; the name needs at least one
+            // character before it
+            const size_t exe = name_end - name_begin > 4 ? contents.rfind(".exe", name_end - 4) : std::string::npos;
+            if (exe == std::string::npos || exe <= name_begin)
+            {
+                pos = contents.find(IMPORT_PREFIX_BIN, pos + 1);
+                continue;
+            }
+
+            output.append(contents, copied, pos - copied);
+            output.append(tools);
+            output.append(contents, name_begin, exe + 4 - name_begin);
+            copied = exe + 4;
+            pos = contents.find(IMPORT_PREFIX_BIN, copied);
+        }
+
+        output.append(contents, copied, std::string::npos);
+        return output;
+    }
+
+    std::string relocate_debug_targets(const std::string& contents, const std::string& port)
+    {
+        std::string output = relocate_executables(contents, port);
+        output = Strings::replace_all(std::move(output), "${_IMPORT_PREFIX}/lib", "${_IMPORT_PREFIX}/debug/lib");
+        return Strings::replace_all(std::move(output), "${_IMPORT_PREFIX}/bin", "${_IMPORT_PREFIX}/debug/bin");
+    }
+
+    std::string fix_import_prefix(const std::string& contents)
+    {
+        // get_filename_component\(_IMPORT_PREFIX "\${CMAKE_CURRENT_LIST_FILE}" PATH\)
+        //     (\nget_filename_component\(_IMPORT_PREFIX "\${_IMPORT_PREFIX}" PATH\))*
+        // -> the first line followed by exactly two of the others, as share/<port> is two levels below the prefix
+        std::string output;
+        size_t copied = 0;
+        for (size_t pos = contents.find(IMPORT_PREFIX_FROM_LIST_FILE); pos != std::string::npos;
+             pos = contents.find(IMPORT_PREFIX_FROM_LIST_FILE, copied))
+        {
+            size_t end = pos + IMPORT_PREFIX_FROM_LIST_FILE.size();
+            while (contents.compare(end, IMPORT_PREFIX_PARENT.size(), IMPORT_PREFIX_PARENT) == 0)
+                end += IMPORT_PREFIX_PARENT.size();
+
+            output.append(contents, copied, pos - copied);
+            output.append(IMPORT_PREFIX_FROM_LIST_FILE);
+            output.append(IMPORT_PREFIX_PARENT);
+            output.append(IMPORT_PREFIX_PARENT);
+            copied = end;
+        }
+
+        output.append(contents, copied, std::string::npos);
+        return output;
+    }
+
+    std::string fix_package_prefix(const std::string& contents)
+    {
+        // get_filename_component\(PACKAGE_PREFIX_DIR "\${CMAKE_CURRENT_LIST_DIR}/\.\./(\.\./)*" ABSOLUTE\)
+        // -> get_filename_component(PACKAGE_PREFIX_DIR "${CMAKE_CURRENT_LIST_DIR}/../../" ABSOLUTE)
+        std::string output;
+        size_t copied = 0;
+        size_t pos = contents.find(PACKAGE_PREFIX_BEGIN);
+        while (pos != std::string::npos)
+        {
+            size_t end = pos + PACKAGE_PREFIX_BEGIN.size();
+            while (contents.compare(end, 3, "../") == 0)
+                end += 3;
+
+            if (contents.compare(end, PACKAGE_PREFIX_END.size(), PACKAGE_PREFIX_END) != 0)
+            {
+                pos = contents.find(PACKAGE_PREFIX_BEGIN, pos + 1);
+                continue;
+            }
+
+            output.append(contents, copied, pos - copied);
+            output.append(PACKAGE_PREFIX_BEGIN);
+            output.append("../");
+            output.append(PACKAGE_PREFIX_END);
+            copied = end + PACKAGE_PREFIX_END.size();
+            pos = contents.find(PACKAGE_PREFIX_BEGIN, copied);
+        }
+
+        output.append(contents, copied, std::string::npos);
+        return output;
+    }
+
+    enum class TargetFile
+    {
+        RELEASE_TARGETS,
+        DEBUG_TARGETS,
+        MAIN_TARGETS,
+        MAIN_CONFIG,
+    };
+
+    struct TargetFileAction
+    {
+        TargetFile kind;
+        fs::path path;
+    };
+
+    // The globs of the script are case insensitive on Windows, where the port is built
+    static bool has_suffix(const fs::path& file, const std::vector<std::string>& suffixes)
+    {
+        const std::string name = Strings::ascii_to_lowercase(file.filename().u8string());
+        return std::any_of(suffixes.cbegin(), suffixes.cend(), [&](const std::string& suffix) {
+            return name.size() >= suffix.size() &&
+                   name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        });
+    }
+
+    static std::vector<fs::path> get_regular_files(const Files::Filesystem& fs, const fs::path& dir)
+    {
+        std::vector<fs::path> files;
+        if (!fs.is_directory(dir)) return files;
+        for (auto&& entry : fs.get_entries_non_recursive(dir))
+        {
+            if (fs::is_regular_file(entry.status)) files.push_back(entry.path);
+        }
+        return files;
+    }
+
+    static void remove_if_no_files(Files::Filesystem& fs, const fs::path& dir)
+    {
+        if (!fs.is_directory(dir)) return;
+        const std::vector<Files::DirectoryEntry> entries = fs.get_entries_recursive(dir);
+        const bool has_files = std::any_of(entries.cbegin(), entries.cend(), [](const Files::DirectoryEntry& entry) {
+            return !fs::is_directory(entry.status);
+        });
+        if (has_files) return;
+
+        std::error_code ec;
+        fs.remove_all(dir, ec);
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args)
+    {
+        static const std::string EXAMPLE =
+            Commands::Help::create_example_string(R"###(fixup-cmake-targets packages\zlib_x64-windows zlib)###");
+        args.check_exact_arg_count(2, EXAMPLE);
+        args.check_and_get_optional_command_arguments({});
+
+        auto& fs = Files::get_real_filesystem();
+        const fs::path packages_dir = Strings::to_utf16(args.command_arguments[0]);
+        const std::string& port = args.command_arguments[1];
+        const fs::path debug_share = packages_dir / "debug" / "share" / port;
+        const fs::path release_share = packages_dir / "share" / port;
+
+        // The files are independent of each other, so they are globbed up front, like the script does before it
+        // writes the debug targets next to the release ones, which match none of the release globs
+        std::vector<TargetFileAction> actions;
+        for (auto&& file : get_regular_files(fs, debug_share))
+        {
+            if (has_suffix(file, {"targets.cmake", "config.cmake", "configversion.cmake", "config-version.cmake"}))
+            {
+                fs.remove(file);
+            }
+            else if (has_suffix(file, {"targets-debug.cmake", "config-debug.cmake"}))
+            {
+                actions.push_back({TargetFile::DEBUG_TARGETS, file});
+            }
+        }
+
+        for (auto&& file : get_regular_files(fs, release_share))
+        {
+            if (has_suffix(file, {"targets-release.cmake", "config-release.cmake"}))
+                actions.push_back({TargetFile::RELEASE_TARGETS, file});
+            else if (has_suffix(file, {"targets.cmake"}))
+                actions.push_back({TargetFile::MAIN_TARGETS, file});
+            else if (has_suffix(file, {"config.cmake"}))
+                actions.push_back({TargetFile::MAIN_CONFIG, file});
+        }
+
+        std::vector<std::string> errors(actions.size());
+        Util::parallel_for_each_index(actions.size(), [&](const size_t i) {
+            const TargetFileAction& action = actions[i];
+            const Expected<std::string> maybe_contents = fs.read_contents(action.path);
+            const std::string* const contents = maybe_contents.get();
+            if (!contents)
+            {
+                errors[i] = Strings::format("Error: could not read %s", action.path.u8string());
+                return;
+            }
+
+            switch (action.kind)
+            {
+                case TargetFile::RELEASE_TARGETS:
+                    fs.write_contents(action.path, relocate_executables(*contents, port));
+                    break;
+                case TargetFile::DEBUG_TARGETS:
+                    fs.write_contents(release_share / action.path.filename(), relocate_debug_targets(*contents, port));
+                    fs.remove(action.path);
+                    break;
+                case TargetFile::MAIN_TARGETS: fs.write_contents(action.path, fix_import_prefix(*contents)); break;
+                case TargetFile::MAIN_CONFIG:
+                    fs.write_contents(action.path, fix_package_prefix(fix_import_prefix(*contents)));
+                    break;
+                default: Checks::unreachable(VCPKG_LINE_INFO);
+            }
+        });
+
+        for (auto&& error : errors)
+        {
+            if (!error.empty()) Checks::exit_with_message(VCPKG_LINE_INFO, error);
+        }
+
+        remove_if_no_files(fs, debug_share);
+        remove_if_no_files(fs, packages_dir / "debug" / "share");
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
@@ -0,0 +1,291 @@
+#include "pch.h"
+
+#include "vcpkg_Build.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+#include "vcpkglib.h"
+
+namespace vcpkg::Commands::GarbageCollect
+{
+    static const std::string BUDGET_ENVIRONMENT_VARIABLE = "VCPKG_CACHE_BUDGET";
+
+    /// <summary>
+    /// A download, package directory or build tree, which vcpkg can recreate when it is needed again
+    /// </summary>
+    struct CacheEntry
+    {
+        fs::path path;
+
+        /// <summary>
+        /// What evicting the entry removes; for a build tree, its directories but not its logs
+        /// </summary>
+        std::vector<fs::path> evicted_paths;
+        std::uintmax_t size;
+        fs::file_time_type last_used;
+        bool is_referenced;
+    };
+
+    std::string format_size(const uint64_t size)
+    {
+        static constexpr const char* UNITS[] = {"KiB", "MiB", "GiB", "TiB"};
+        if (size < 1024) return Strings::format("%d B", static_cast<int>(size));
+
+        double value = static_cast<double>(size) / 1024;
+        size_t unit = 0;
+        while (value >= 1024 && unit + 1 < sizeof(UNITS) / sizeof(UNITS[0]))
+        {
+            value /= 1024;
+            ++unit;
+        }
+        return Strings::format("%.1f %s", value, UNITS[unit]);
+    }
+
+    Optional<uint64_t> parse_size(const std::string& text)
+    {
+        size_t digits = 0;
+        while (digits < text.size() && isdigit(static_cast<unsigned char>(text[digits])))
+            ++digits;
+        if (digits == 0 || digits > 15) return nullopt;
+
+        const uint64_t value = std::stoull(text.substr(0, digits));
+        std::string suffix = Strings::ascii_to_lowercase(text.substr(digits));
+        if (!suffix.empty() && suffix.back() == 'b') suffix.pop_back();
+        if (suffix.empty()) return value;
+
+        static const std::string MULTIPLES = "kmgt";
+        const size_t power = suffix.size() == 1 ? MULTIPLES.find(suffix.front()) : std::string::npos;
+        if (power == std::string::npos) return nullopt;
+
+        const uint64_t shift = 10 * (power + 1);
+        if (value > (std::numeric_limits<uint64_t>::max() >> shift)) return nullopt;
+        return value << shift;
+    }
+
+    static Optional<uint64_t> get_budget_from_environment()
+    {
+        const Optional<std::wstring> from_environment =
+            System::get_environment_variable(Strings::to_utf16(BUDGET_ENVIRONMENT_VARIABLE));
+        const auto text = from_environment.get();
+        if (!text) return nullopt;
+
+        const std::string budget_text = Strings::to_utf8(*text);
+        const Optional<uint64_t> budget = parse_size(budget_text);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           budget.has_value(),
+                           "Error: %s must be a size like 20G, but was '%s'",
+                           BUDGET_ENVIRONMENT_VARIABLE,
+                           budget_text);
+        return budget;
+    }
+
+    static void add_tree(const Files::Filesystem& fs, const fs::path& dir, CacheEntry& entry)
+    {
+        for (auto&& child : fs.get_entries_recursive(dir))
+        {
+            entry.size += child.size;
+            entry.last_used = std::max(entry.last_used, child.last_write_time);
+        }
+    }
+
+    static std::vector<CacheEntry> find_cache_entries(const VcpkgPaths& paths,
+                                                      const std::vector<PackageSpec>& referenced_specs)
+    {
+        auto& fs = paths.get_filesystem();
+        const StatusParagraphs status_db = database_load_check(paths);
+
+        std::unordered_set<std::string> kept_packages;
+        std::unordered_set<std::string> kept_buildtrees;
+        std::unordered_set<std::string> ports_with_kept_distfiles;
+        for (auto&& spec : referenced_specs)
+        {
+            kept_packages.insert(spec.dir());
+            kept_buildtrees.insert(spec.name());
+            ports_with_kept_distfiles.insert(spec.name());
+        }
+        for (auto&& pgh : get_installed_ports(status_db))
+        {
+            kept_packages.insert(pgh->package.spec.dir());
+            ports_with_kept_distfiles.insert(pgh->package.spec.name());
+        }
+
+        // Each build rewrites the manifest of the distfiles it used, which is how a download is known to be in use
+        std::unordered_set<std::string> kept_distfiles;
+        std::unordered_map<std::string, fs::file_time_type> distfile_last_used;
+        for (auto&& manifest : fs.get_entries_non_recursive(paths.downloads / "distfiles"))
+        {
+            if (!fs::is_regular_file(manifest.status)) continue;
+
+            const std::string port_name = manifest.path.stem().u8string();
+            const bool is_kept = ports_with_kept_distfiles.find(port_name) != ports_with_kept_distfiles.cend();
+            for (auto&& distfile : Build::load_recorded_distfiles(paths, port_name))
+            {
+                fs::file_time_type& last_used = distfile_last_used[distfile.filename];
+                last_used = std::max(last_used, manifest.last_write_time);
+                if (is_kept) kept_distfiles.insert(distfile.filename);
+            }
+        }
+
+        std::vector<CacheEntry> entries;
+        for (auto&& download : fs.get_entries_non_recursive(paths.downloads))
+        {
+            // The directories hold the tools vcpkg runs and the distfiles manifests
+            if (!fs::is_regular_file(download.status)) continue;
+
+            const std::string filename = download.path.filename().u8string();
+            CacheEntry entry{download.path,
+                             {download.path},
+                             download.size,
+                             download.last_write_time,
+                             kept_distfiles.find(filename) != kept_distfiles.cend()};
+            const auto it = distfile_last_used.find(filename);
+            if (it != distfile_last_used.cend()) entry.last_used = std::max(entry.last_used, it->second);
+            entries.push_back(std::move(entry));
+        }
+
+        for (auto&& package : fs.get_entries_non_recursive(paths.packages))
+        {
+            if (!fs::is_directory(package.status)) continue;
+
+            const std::string dirname = package.path.filename().u8string();
+            CacheEntry entry{package.path,
+                             {package.path},
+                             0,
+                             package.last_write_time,
+                             kept_packages.find(dirname) != kept_packages.cend()};
+            add_tree(fs, package.path, entry);
+            entries.push_back(std::move(entry));
+        }
+
+        for (auto&& buildtree : fs.get_entries_non_recursive(paths.buildtrees))
+        {
+            if (!fs::is_directory(buildtree.status)) continue;
+
+            const std::string port_name = buildtree.path.filename().u8string();
+            CacheEntry entry{buildtree.path,
+                             {},
+                             0,
+                             buildtree.last_write_time,
+                             kept_buildtrees.find(port_name) != kept_buildtrees.cend()};
+
+            // The logs of every build are rewritten, so they tell when the port was last built
+            for (auto&& child : fs.get_entries_non_recursive(buildtree.path))
+            {
+                entry.last_used = std::max(entry.last_used, child.last_write_time);
+                if (!fs::is_directory(child.status)) continue;
+
+                entry.evicted_paths.push_back(child.path);
+                add_tree(fs, child.path, entry);
+            }
+            if (!entry.evicted_paths.empty()) entries.push_back(std::move(entry));
+        }
+
+        return entries;
+    }
+
+    uint64_t collect(const VcpkgPaths& paths,
+                     const uint64_t budget,
+                     const std::vector<PackageSpec>& referenced_specs,
+                     const bool dry_run)
+    {
+        auto& fs = paths.get_filesystem();
+        std::vector<CacheEntry> entries = find_cache_entries(paths, referenced_specs);
+        std::sort(entries.begin(), entries.end(), [](const CacheEntry& left, const CacheEntry& right) {
+            return left.last_used < right.last_used;
+        });
+
+        uint64_t remaining = 0;
+        for (auto&& entry : entries)
+        {
+            remaining += entry.size;
+        }
+
+        uint64_t evicted = 0;
+        for (auto&& entry : entries)
+        {
+            if (remaining <= budget) break;
+            if (entry.is_referenced || entry.size == 0) continue;
+
+            System::println(
+                "%s %s (%s)", dry_run ? "Would evict" : "Evicting", entry.path.u8string(), format_size(entry.size));
+            if (!dry_run)
+            {
+                for (auto&& path : entry.evicted_paths)
+                {
+                    std::error_code ec;
+                    if (fs.is_directory(path))
+                        move_to_trash(paths, path);
+                    else
+                        fs.remove(path, ec);
+                }
+            }
+
+            remaining -= entry.size;
+            evicted += entry.size;
+        }
+
+        if (remaining > budget)
+        {
+            System::println(System::Color::warning,
+                            "The cache still takes %s, more than the budget of %s, because the rest is in use",
+                            format_size(remaining),
+                            format_size(budget));
+        }
+        return evicted;
+    }
+
+    void collect_if_over_budget(const VcpkgPaths& paths, const std::vector<Dependencies::AnyAction>& action_plan)
+    {
+        const Optional<uint64_t> maybe_budget = get_budget_from_environment();
+        const auto budget = maybe_budget.get();
+        if (!budget) return;
+
+        const std::vector<PackageSpec> referenced_specs =
+            Util::fmap(action_plan, [](const Dependencies::AnyAction& action) { return action.spec(); });
+        const uint64_t evicted = collect(paths, *budget, referenced_specs, false);
+        if (evicted != 0) System::println("Evicted %s from the cache", format_size(evicted));
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    {
+        static const std::string OPTION_BUDGET = "--budget";
+        static const std::string OPTION_DRY_RUN = "--dry-run";
+        static const std::string EXAMPLE = Commands::Help::create_example_string("x-gc --budget=20G");
+        args.check_exact_arg_count(0, EXAMPLE);
+
+        const ParsedArguments parsed_arguments =
+            args.check_and_get_optional_command_arguments({OPTION_DRY_RUN}, {OPTION_BUDGET});
+        const bool dry_run = parsed_arguments.switches.find(OPTION_DRY_RUN) != parsed_arguments.switches.cend();
+
+        Optional<uint64_t> budget;
+        const auto it_budget = parsed_arguments.settings.find(OPTION_BUDGET);
+        if (it_budget != parsed_arguments.settings.cend())
+        {
+            budget = parse_size(it_budget->second);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               budget.has_value(),
+                               "Error: %s must be a size like 20G, but was '%s'",
+                               OPTION_BUDGET,
+                               it_budget->second);
+        }
+        else
+        {
+            budget = get_budget_from_environment();
+        }
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           budget.has_value(),
+                           "Error: pass %s or set %s to the size the cache may take\n%s",
+                           OPTION_BUDGET,
+                           BUDGET_ENVIRONMENT_VARIABLE,
+                           EXAMPLE);
+
+        const uint64_t evicted = collect(paths, budget.value_or_exit(VCPKG_LINE_INFO), {}, dry_run);
+        if (evicted == 0)
+            System::println("Nothing was evicted");
+        else
+            System::println(System::Color::success, "%s %s", dry_run ? "Would evict" : "Evicted", format_size(evicted));
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
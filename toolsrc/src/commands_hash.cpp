@@ -4,32 +4,99 @@
 #include "vcpkg_System.h"
 #include "vcpkg_Util.h"
 
+#include <bcrypt.h>
+
+#pragma comment(lib, "bcrypt")
+
 namespace vcpkg::Commands::Hash
 {
-    static void do_file_hash(fs::path const& path, std::wstring const& hash_type)
+    static const wchar_t* to_bcrypt_algorithm(const std::string& hash_type)
     {
-        const auto cmd_line = Strings::wformat(LR"(CertUtil.exe -hashfile "%s" %s)", path.c_str(), hash_type);
-        const auto ec_data = System::cmd_execute_and_capture_output(cmd_line);
-        Checks::check_exit(
-            VCPKG_LINE_INFO, ec_data.exit_code == 0, "Running command:\n   %s\n failed", Strings::to_utf8(cmd_line));
+        const std::string lowercase_hash_type = Strings::ascii_to_lowercase(hash_type);
+        if (lowercase_hash_type == "md2") return BCRYPT_MD2_ALGORITHM;
+        if (lowercase_hash_type == "md4") return BCRYPT_MD4_ALGORITHM;
+        if (lowercase_hash_type == "md5") return BCRYPT_MD5_ALGORITHM;
+        if (lowercase_hash_type == "sha1") return BCRYPT_SHA1_ALGORITHM;
+        if (lowercase_hash_type == "sha256") return BCRYPT_SHA256_ALGORITHM;
+        if (lowercase_hash_type == "sha384") return BCRYPT_SHA384_ALGORITHM;
+        if (lowercase_hash_type == "sha512") return BCRYPT_SHA512_ALGORITHM;
 
-        std::string const& output = ec_data.output;
+        Checks::exit_with_message(VCPKG_LINE_INFO, "Unsupported hash type %s", hash_type);
+    }
 
-        const auto start = output.find_first_of("\r\n");
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           start != std::string::npos,
-                           "Unexpected output format from command: %s",
-                           Strings::to_utf8(cmd_line));
+    Hasher::Hasher(const std::string& hash_type)
+    {
+        NTSTATUS status = BCryptOpenAlgorithmProvider(&m_algorithm, to_bcrypt_algorithm(hash_type), nullptr, 0);
+        Checks::check_exit(VCPKG_LINE_INFO, BCRYPT_SUCCESS(status), "Failed to open the %s algorithm", hash_type);
 
-        const auto end = output.find_first_of("\r\n", start + 1);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           end != std::string::npos,
-                           "Unexpected output format from command: %s",
-                           Strings::to_utf8(cmd_line));
+        DWORD hash_length;
+        ULONG bytes_written;
+        status = BCryptGetProperty(m_algorithm,
+                                   BCRYPT_HASH_LENGTH,
+                                   reinterpret_cast<PUCHAR>(&hash_length),
+                                   sizeof(hash_length),
+                                   &bytes_written,
+                                   0);
+        Checks::check_exit(VCPKG_LINE_INFO, BCRYPT_SUCCESS(status), "Failed to get the %s hash length", hash_type);
+        m_hash_length = hash_length;
 
-        auto hash = output.substr(start, end - start);
-        Util::erase_remove_if(hash, isspace);
-        System::println(hash);
+        // The hash object buffer is allocated by BCrypt
+        status = BCryptCreateHash(m_algorithm, &m_hash, nullptr, 0, nullptr, 0, 0);
+        Checks::check_exit(VCPKG_LINE_INFO, BCRYPT_SUCCESS(status), "Failed to create a %s hash", hash_type);
+    }
+
+    Hasher::~Hasher()
+    {
+        if (m_hash != nullptr) BCryptDestroyHash(m_hash);
+        if (m_algorithm != nullptr) BCryptCloseAlgorithmProvider(m_algorithm, 0);
+    }
+
+    void Hasher::add(const char* data, const size_t size)
+    {
+        const NTSTATUS status =
+            BCryptHashData(m_hash, reinterpret_cast<PUCHAR>(const_cast<char*>(data)), static_cast<ULONG>(size), 0);
+        Checks::check_exit(VCPKG_LINE_INFO, BCRYPT_SUCCESS(status), "Failed to hash data");
+    }
+
+    std::string Hasher::finish()
+    {
+        std::vector<unsigned char> hash(m_hash_length);
+        const NTSTATUS status = BCryptFinishHash(m_hash, hash.data(), static_cast<ULONG>(hash.size()), 0);
+        Checks::check_exit(VCPKG_LINE_INFO, BCRYPT_SUCCESS(status), "Failed to finish the hash");
+
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+        std::string output;
+        output.reserve(hash.size() * 2);
+        for (const unsigned char byte : hash)
+        {
+            output.push_back(HEX_DIGITS[byte >> 4]);
+            output.push_back(HEX_DIGITS[byte & 0xf]);
+        }
+        return output;
+    }
+
+    std::string get_file_hash(const fs::path& path, const std::string& hash_type)
+    {
+        std::ifstream file(path, std::ios::binary);
+        Checks::check_exit(VCPKG_LINE_INFO, file.good(), "Failed to open %s for hashing", path.u8string());
+
+        Hasher hasher(hash_type);
+        std::vector<char> buffer(1024 * 1024);
+        do
+        {
+            file.read(buffer.data(), buffer.size());
+            hasher.add(buffer.data(), static_cast<size_t>(file.gcount()));
+        } while (file);
+
+        Checks::check_exit(VCPKG_LINE_INFO, file.eof(), "Failed to read %s for hashing", path.u8string());
+        return hasher.finish();
+    }
+
+    std::string get_string_hash(const std::string& data, const std::string& hash_type)
+    {
+        Hasher hasher(hash_type);
+        hasher.add(data.data(), data.size());
+        return hasher.finish();
     }
 
     void perform_and_exit(const VcpkgCmdArguments& args)
@@ -43,11 +110,11 @@ namespace vcpkg::Commands::Hash
 
         if (args.command_arguments.size() == 1)
         {
-            do_file_hash(args.command_arguments[0], L"SHA512");
+            System::println(get_file_hash(args.command_arguments[0], "SHA512"));
         }
         if (args.command_arguments.size() == 2)
         {
-            do_file_hash(args.command_arguments[0], Strings::to_utf16(args.command_arguments[1]));
+            System::println(get_file_hash(args.command_arguments[0], args.command_arguments[1]));
         }
 
         Checks::exit_success(VCPKG_LINE_INFO);
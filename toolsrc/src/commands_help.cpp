@@ -34,6 +34,12 @@ namespace vcpkg::Commands::Help
                         "  --nuget-id=<id>                 Specify the id for the exported NuGet package\n"
                         "  --nuget-version=<ver>           Specify the version for the exported NuGet package\n"
                         "  --raw                           Export to an uncompressed directory\n"
+                        "  --update-existing=<dir>         Update a previous export in <dir>, only changing the files\n"
+                        "                                  of packages which were added, removed or rebuilt\n"
+                        "  --x-link-files                  Hard link the files of --raw, --nuget and\n"
+                        "                                  --update-existing exports to packages/ instead of copying\n"
+                        "                                  them. Editing an exported file then edits the file in\n"
+                        "                                  packages/ as well.\n"
                         "  --zip                           Export to a zip file");
     }
 
@@ -47,6 +53,7 @@ namespace vcpkg::Commands::Help
             "  vcpkg remove --outdated         Uninstall all out-of-date packages\n"
             "  vcpkg list                      List installed packages\n"
             "  vcpkg update                    Display list of packages for updating\n"
+            "  vcpkg upgrade [pkg]...          Rebuild out-of-date packages, replacing only the files which changed\n"
             "  vcpkg hash <file> [alg]         Hash a file by specific algorithm, default SHA512\n"
             "  vcpkg help topics               Display the list of help topics\n"
             "  vcpkg help <topic>              Display help for a specific topic\n"
@@ -60,6 +67,10 @@ namespace vcpkg::Commands::Help
             "             [archivename]        Create a new package\n"
             "  vcpkg owns <pat>                Search for files in installed packages\n"
             "  vcpkg cache                     List cached compiled packages\n"
+            "  vcpkg x-verify [--repair]       Check the installed files against their listfiles\n"
+            "  vcpkg x-logs <pkg> [--phase=<p>]\n"
+            "             [--grep=<regex>]     List, print or search the logs of the last build of a package\n"
+            "  vcpkg x-watch <pkg>             Build a package incrementally each time its port changes\n"
             "  vcpkg version                   Display version information\n"
             "  vcpkg contact                   Display contact information to send feedback\n"
             "\n"
@@ -73,6 +84,27 @@ namespace vcpkg::Commands::Help
             "\n"
             "  --vcpkg-root <path>             Specify the vcpkg root directory\n"
             "                                  (default: %%VCPKG_ROOT%%)\n"
+            "  --downloads-root <path>         Keep the downloaded sources and tools in <path>\n"
+            "                                  (default: %%VCPKG_DOWNLOADS%%, or downloads in the root)\n"
+            "  --x-buildtrees-root <path>      Build in <path> (default: %%VCPKG_BUILDTREES_ROOT%%, or buildtrees)\n"
+            "  --x-packages-root <path>        Stage the built packages in <path>\n"
+            "                                  (default: %%VCPKG_PACKAGES_ROOT%%, or packages in the root)\n"
+            "\n"
+            "  --timings                       Print the time spent in each phase of the build\n"
+            "  --timings-trace <file>          Write the phase timings as a Chrome trace-event file\n"
+            "  --x-profile <file>              Same as --timings-trace\n"
+            "  --x-trace-processes             List the child processes vcpkg waited for, and the time spent in them\n"
+            "                                  (also enabled by %%VCPKG_TRACE_PROCESSES%%)\n"
+            "  --x-memstats                    Print the peak memory, and what each phase allocated\n"
+            "\n"
+            "  --background                    Build at idle priority, leaving cores free for interactive work\n"
+            "  --background-free-cores <n>     With --background, the number of cores left free (default: 1)\n"
+            "  --background-affinity <mask>    With --background, the cores the builds may run on, as in 0xFF\n"
+            "\n"
+            "  @<file>                         Read more arguments, such as a list of specs, from <file>\n"
+            "  --specs-from-stdin              Read more arguments from stdin, after those on the command line\n"
+            "\n"
+            "  --format=<json|tsv>             Print the records of 'list' and 'owns' for other programs to read\n"
             "\n"
             "For more help (including examples) see the accompanying README.md.",
             Integrate::INTEGRATE_COMMAND_HELPSTRING);
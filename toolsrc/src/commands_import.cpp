@@ -4,13 +4,18 @@
 #include "StatusParagraph.h"
 #include "vcpkg_Commands.h"
 #include "vcpkg_Files.h"
+#include "vcpkg_Util.h"
 
 namespace vcpkg::Commands::Import
 {
-    struct Binaries
+    /// <summary>
+    /// What an import puts in the package directory. The files are keyed by their target, so that a binary which is
+    /// found twice is taken from the last place it was found in, as when it was copied over the first one.
+    /// </summary>
+    struct ImportedFiles
     {
-        std::vector<fs::path> dlls;
-        std::vector<fs::path> libs;
+        std::set<fs::path> directories;
+        std::map<fs::path, fs::path> sources_by_target;
     };
 
     static void check_is_directory(const LineInfo& line_info, const Files::Filesystem& fs, const fs::path& dirpath)
@@ -18,62 +23,96 @@ namespace vcpkg::Commands::Import
         Checks::check_exit(line_info, fs.is_directory(dirpath), "The path %s is not a directory", dirpath.string());
     }
 
-    static Binaries find_binaries_in_dir(const Files::Filesystem& fs, const fs::path& path)
+    /// <summary>
+    /// The DLLs and their PDBs go to bin and the import and static libraries to lib, wherever they are in the tree
+    /// </summary>
+    static void add_binaries_in_dir(const Files::Filesystem& fs,
+                                    const fs::path& path,
+                                    const fs::path& destination_path,
+                                    ImportedFiles& imported)
     {
-        auto files = fs.get_files_recursive(path);
-
         check_is_directory(VCPKG_LINE_INFO, fs, path);
 
-        Binaries binaries;
-        for (auto&& file : files)
+        const fs::path bin_dir = destination_path / "bin";
+        const fs::path lib_dir = destination_path / "lib";
+        imported.directories.insert(destination_path);
+        imported.directories.insert(bin_dir);
+        imported.directories.insert(lib_dir);
+
+        // The enumeration reports what each entry is, so no file is asked about again
+        for (auto&& entry : fs.get_entries_recursive(path))
         {
-            if (fs.is_directory(file)) continue;
-            const auto ext = file.extension();
-            if (ext == ".dll")
-                binaries.dlls.push_back(std::move(file));
+            if (!fs::is_regular_file(entry.status)) continue;
+
+            const std::string ext = Strings::ascii_to_lowercase(entry.path.extension().u8string());
+            if (ext == ".dll" || ext == ".pdb")
+                imported.sources_by_target[bin_dir / entry.path.filename()] = std::move(entry.path);
             else if (ext == ".lib")
-                binaries.libs.push_back(std::move(file));
+                imported.sources_by_target[lib_dir / entry.path.filename()] = std::move(entry.path);
         }
-        return binaries;
     }
 
-    static void copy_files_into_directory(Files::Filesystem& fs,
-                                          const std::vector<fs::path>& files,
-                                          const fs::path& destination_folder)
+    static void add_tree(const Files::Filesystem& fs,
+                         const fs::path& path,
+                         const fs::path& destination_path,
+                         ImportedFiles& imported)
     {
-        std::error_code ec;
-        fs.create_directory(destination_folder, ec);
+        check_is_directory(VCPKG_LINE_INFO, fs, path);
 
-        for (auto const& src_path : files)
+        const size_t prefix_length = path.native().size();
+        imported.directories.insert(destination_path);
+        for (auto&& entry : fs.get_entries_recursive(path))
         {
-            const fs::path dest_path = destination_folder / src_path.filename();
-            fs.copy(src_path, dest_path, fs::copy_options::overwrite_existing);
+            const fs::path target = destination_path / (entry.path.native().c_str() + prefix_length + 1);
+            if (fs::is_directory(entry.status))
+                imported.directories.insert(target);
+            else if (fs::is_regular_file(entry.status))
+                imported.sources_by_target[target] = std::move(entry.path);
         }
     }
 
-    static void place_library_files_in(Files::Filesystem& fs,
-                                       const fs::path& include_directory,
-                                       const fs::path& project_directory,
-                                       const fs::path& destination_path)
+    /// <summary>
+    /// Hard-links the files into place, in parallel. A file on another volume than the package directory, or on a
+    /// file system without hard links, is copied instead.
+    /// </summary>
+    static void place_files(Files::Filesystem& fs, const ImportedFiles& imported)
     {
-        check_is_directory(VCPKG_LINE_INFO, fs, include_directory);
-        check_is_directory(VCPKG_LINE_INFO, fs, project_directory);
-        check_is_directory(VCPKG_LINE_INFO, fs, destination_path);
-        const Binaries debug_binaries = find_binaries_in_dir(fs, project_directory / "Debug");
-        const Binaries release_binaries = find_binaries_in_dir(fs, project_directory / "Release");
+        // The parents sort before their children
+        std::error_code ec;
+        for (auto&& directory : imported.directories)
+        {
+            fs.create_directories(directory, ec);
+            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not create directory %s", directory.u8string());
+        }
 
-        const fs::path destination_include_directory = destination_path / "include";
-        fs.copy(include_directory,
-                destination_include_directory,
-                fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+        const std::vector<std::pair<fs::path, fs::path>> files(imported.sources_by_target.cbegin(),
+                                                               imported.sources_by_target.cend());
+        std::vector<std::error_code> errors(files.size());
+        std::atomic<size_t> copied_count{0};
+        Util::parallel_for_each_index(files.size(), [&](const size_t i) {
+            const fs::path& target = files[i].first;
+            const fs::path& source = files[i].second;
 
-        copy_files_into_directory(fs, release_binaries.dlls, destination_path / "bin");
-        copy_files_into_directory(fs, release_binaries.libs, destination_path / "lib");
+            std::error_code link_ec;
+            fs.create_hard_link(source, target, link_ec);
+            if (!link_ec) return;
 
-        std::error_code ec;
-        fs.create_directory(destination_path / "debug", ec);
-        copy_files_into_directory(fs, debug_binaries.dlls, destination_path / "debug" / "bin");
-        copy_files_into_directory(fs, debug_binaries.libs, destination_path / "debug" / "lib");
+            fs.copy_file(source, target, fs::copy_options::overwrite_existing, errors[i]);
+            if (!errors[i]) ++copied_count;
+        });
+
+        bool failed = false;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (!errors[i]) continue;
+            System::println(System::Color::error, "failed: %s: %s", files[i].second.u8string(), errors[i].message());
+            failed = true;
+        }
+        Checks::check_exit(VCPKG_LINE_INFO, !failed, "Could not import every file");
+
+        System::println("Imported %d files, of which %d were copied rather than linked",
+                        files.size(),
+                        copied_count.load());
     }
 
     static void do_import(const VcpkgPaths& paths,
@@ -82,10 +121,19 @@ namespace vcpkg::Commands::Import
                           const BinaryParagraph& control_file_data)
     {
         auto& fs = paths.get_filesystem();
+        check_is_directory(VCPKG_LINE_INFO, fs, project_directory);
+
+        ImportedFiles imported;
         const fs::path library_destination_path = paths.package_dir(control_file_data.spec);
+        add_tree(fs, include_directory, library_destination_path / "include", imported);
+        add_binaries_in_dir(fs, project_directory / "Release", library_destination_path, imported);
+        add_binaries_in_dir(fs, project_directory / "Debug", library_destination_path / "debug", imported);
+
+        // A file left from an earlier import would be installed along with the new ones, and linking does not
+        // replace a file
         std::error_code ec;
-        fs.create_directory(library_destination_path, ec);
-        place_library_files_in(paths.get_filesystem(), include_directory, project_directory, library_destination_path);
+        fs.remove_all(library_destination_path, ec);
+        place_files(fs, imported);
 
         const fs::path control_file_path = library_destination_path / "CONTROL";
         fs.write_contents(control_file_path, Strings::serialize(control_file_data));
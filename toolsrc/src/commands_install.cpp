@@ -2,15 +2,24 @@
 
 #include "Paragraphs.h"
 #include "metrics.h"
+#include "vcpkg_BinaryCaching.h"
 #include "vcpkg_Build.h"
+#include "vcpkg_BuildQueue.h"
 #include "vcpkg_Commands.h"
+#include "vcpkg_ContentStore.h"
 #include "vcpkg_Dependencies.h"
 #include "vcpkg_Files.h"
 #include "vcpkg_GlobalState.h"
 #include "vcpkg_Input.h"
+#include "vcpkg_Listfile.h"
 #include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
 #include "vcpkg_Util.h"
 #include "vcpkglib.h"
+#include <condition_variable>
+#include <deque>
+#include <numeric>
+#include <thread>
 
 namespace vcpkg::Commands::Install
 {
@@ -24,6 +33,7 @@ namespace vcpkg::Commands::Install
         dirs.m_destination = destination_root / destination_subdirectory;
         dirs.m_destination_subdirectory = destination_subdirectory;
         dirs.m_listfile = listfile;
+        dirs.m_store_dir = ContentStore::store_dir(destination_root);
         return dirs;
     }
 
@@ -33,11 +43,37 @@ namespace vcpkg::Commands::Install
 
     const fs::path& InstallDir::listfile() const { return this->m_listfile; }
 
-    void install_files_and_write_listfile(Files::Filesystem& fs,
-                                          const fs::path& source_dir,
-                                          const InstallDir& destination_dir)
+    const fs::path& InstallDir::store_dir() const { return this->m_store_dir; }
+
+    static bool has_same_contents(const Files::Filesystem& fs,
+                                  const fs::path& left,
+                                  const fs::path& right,
+                                  const std::uintmax_t left_size)
+    {
+        std::error_code ec;
+        if (fs.file_size(right, ec) != left_size || ec) return false;
+
+        const Expected<Files::MappedFile> maybe_left = fs.map_contents(left);
+        const Expected<Files::MappedFile> maybe_right = fs.map_contents(right);
+        const auto left_file = maybe_left.get();
+        const auto right_file = maybe_right.get();
+        if (!left_file || !right_file || left_file->size != right_file->size) return false;
+
+        const span<const char> left_contents = left_file->contents();
+        return std::equal(left_contents.begin(), left_contents.end(), right_file->contents().begin());
+    }
+
+    /// <summary>
+    /// Copies the package into the destination, skipping the files which the previous entries list with the same
+    /// contents and removing the previous entries which the package no longer has
+    /// </summary>
+    static void install_files(Files::Filesystem& fs,
+                              const fs::path& source_dir,
+                              const InstallDir& destination_dir,
+                              const LinkFiles link_files,
+                              const std::vector<Listfile::Entry>& previous_entries)
     {
-        std::vector<std::string> output;
+        std::vector<Listfile::Entry> output;
         std::error_code ec;
 
         const size_t prefix_length = source_dir.native().size();
@@ -55,57 +91,56 @@ namespace vcpkg::Commands::Install
         Checks::check_exit(
             VCPKG_LINE_INFO, !ec, "Could not create directory for listfile %s", listfile.generic_string());
 
-        output.push_back(Strings::format(R"(%s/)", destination_subdirectory));
-        auto files = fs.get_files_recursive(source_dir);
-        for (auto&& file : files)
+        std::unordered_set<std::string> previous_files;
+        for (auto&& entry : previous_entries)
         {
-            const auto status = fs.status(file, ec);
-            if (ec)
-            {
-                System::println(System::Color::error, "failed: %s: %s", file.u8string(), ec.message());
-                continue;
-            }
+            if (!entry.is_directory) previous_files.insert(entry.path);
+        }
 
-            const std::string filename = file.filename().generic_string();
-            if (fs::is_regular_file(status) &&
-                (Strings::case_insensitive_ascii_compare(filename.c_str(), "CONTROL") == 0 ||
-                 Strings::case_insensitive_ascii_compare(filename.c_str(), "BUILD_INFO") == 0))
+        // The package is enumerated before anything is written, since the previous entries it no longer has are
+        // removed first; a file may have become a directory or the other way around. Then the directories are
+        // created, and the files are copied in parallel since large packages are dominated by per-file syscalls.
+        struct FileToCopy
+        {
+            fs::path source;
+            fs::path target;
+            std::string listed_path;
+            std::uintmax_t size;
+            bool was_installed;
+        };
+        std::vector<fs::path> directories_to_create;
+        std::vector<FileToCopy> files_to_copy;
+
+        output.push_back({destination_subdirectory, true, nullopt});
+        for (auto&& entry : fs.get_entries_recursive(source_dir))
+        {
+            const fs::path& file = entry.path;
+            const fs::file_status status = entry.status;
+            if (fs::is_regular_file(status) && Files::is_package_metadata_file(file))
             {
                 // Do not copy the control file
                 continue;
             }
 
-            const std::string suffix = file.generic_u8string().substr(prefix_length + 1);
-            const fs::path target = destination / suffix;
+            // The target keeps the native form, and only the listed path is converted to UTF-8
+            const fs::path target = destination / (file.native().c_str() + prefix_length + 1);
+            const std::string suffix = Files::generic_u8_suffix(file, prefix_length);
+            std::string listed_path;
+            listed_path.reserve(destination_subdirectory.size() + 1 + suffix.size());
+            listed_path.append(destination_subdirectory).append(1, '/').append(suffix);
 
             if (fs::is_directory(status))
             {
-                fs.create_directory(target, ec);
-                if (ec)
-                {
-                    System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
-                }
-
-                // Trailing backslash for directories
-                output.push_back(Strings::format(R"(%s/%s/)", destination_subdirectory, suffix));
+                directories_to_create.push_back(target);
+                output.push_back({std::move(listed_path), true, nullopt});
                 continue;
             }
 
             if (fs::is_regular_file(status))
             {
-                if (fs.exists(target))
-                {
-                    System::println(System::Color::warning,
-                                    "File %s was already present and will be overwritten",
-                                    target.u8string(),
-                                    ec.message());
-                }
-                fs.copy_file(file, target, fs::copy_options::overwrite_existing, ec);
-                if (ec)
-                {
-                    System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
-                }
-                output.push_back(Strings::format(R"(%s/%s)", destination_subdirectory, suffix));
+                const bool was_installed = previous_files.find(listed_path) != previous_files.cend();
+                files_to_copy.push_back({file, target, listed_path, entry.size, was_installed});
+                output.push_back({std::move(listed_path), false, entry.size});
                 continue;
             }
 
@@ -118,77 +153,290 @@ namespace vcpkg::Commands::Install
             System::println(System::Color::error, "failed: %s: cannot handle file type", file.u8string());
         }
 
-        std::sort(output.begin(), output.end());
+        if (!previous_entries.empty())
+        {
+            std::unordered_set<std::string> current_lines;
+            for (auto&& entry : output)
+            {
+                current_lines.insert(entry.to_line());
+            }
 
-        fs.write_lines(listfile, output);
-    }
+            // Listfile lines are relative to the installed directory, while these are relative to the destination
+            const std::string subdirectory_prefix = destination_subdirectory + '/';
+            std::vector<std::string> lines_to_remove;
+            for (auto&& entry : previous_entries)
+            {
+                std::string line = entry.to_line();
+                if (current_lines.find(line) != current_lines.cend()) continue;
+                if (line.compare(0, subdirectory_prefix.size(), subdirectory_prefix) != 0) continue;
+                lines_to_remove.push_back(line.substr(subdirectory_prefix.size()));
+            }
+            Commands::Remove::remove_listed_files(fs, destination, lines_to_remove);
+        }
 
-    static void remove_first_n_chars(std::vector<std::string>* strings, const size_t n)
-    {
-        for (std::string& s : *strings)
+        for (auto&& directory : directories_to_create)
         {
-            s.erase(0, n);
+            fs.create_directory(directory, ec);
+            if (ec)
+            {
+                System::println(System::Color::error, "failed: %s: %s", directory.u8string(), ec.message());
+            }
         }
-    };
 
-    static std::vector<std::string> extract_files_in_triplet(
-        const std::vector<StatusParagraphAndAssociatedFiles>& pgh_and_files, const Triplet& triplet)
-    {
-        std::vector<std::string> output;
-        for (const StatusParagraphAndAssociatedFiles& t : pgh_and_files)
+        const fs::path& store_dir = destination_dir.store_dir();
+        std::atomic<std::uintmax_t> bytes_copied{0};
+        std::atomic<size_t> files_unchanged{0};
+        std::vector<std::error_code> copy_errors(files_to_copy.size());
+        std::vector<char> overwritten(files_to_copy.size(), false); // not vector<bool>: written concurrently
+        std::vector<Optional<std::string>> store_keys(files_to_copy.size());
+
+        // Writing to a file which has other hard links, like those of the content store, would change them too
+        const auto must_unlink = [&](const fs::path& target) {
+            std::error_code link_ec;
+            return link_files == LinkFiles::TO_STORE || fs.hard_link_count(target, link_ec) > 1;
+        };
+        Util::parallel_for_each_index(files_to_copy.size(), [&](const size_t i) {
+            const FileToCopy& file = files_to_copy[i];
+            std::error_code copy_ec;
+
+            // An unchanged file keeps its timestamp, so that builds which use it are not considered out of date
+            if (file.was_installed)
+            {
+                if (has_same_contents(fs, file.source, file.target, file.size))
+                {
+                    ++files_unchanged;
+                    if (link_files == LinkFiles::TO_STORE)
+                    {
+                        store_keys[i] = ContentStore::find(fs, store_dir, file.target);
+                    }
+                    return;
+                }
+
+                if (!must_unlink(file.target))
+                {
+                    fs.copy_file(file.source, file.target, fs::copy_options::overwrite_existing, copy_ec);
+                    copy_errors[i] = copy_ec;
+                    if (!copy_ec) bytes_copied += file.size;
+                    return;
+                }
+                fs.remove(file.target, copy_ec);
+            }
+
+            // Linking fails across volumes and on file systems without hard links, which fall back to copying
+            if (link_files == LinkFiles::YES)
+            {
+                fs.create_hard_link(file.source, file.target, copy_ec);
+                if (!copy_ec) return;
+            }
+            else if (link_files == LinkFiles::TO_STORE)
+            {
+                store_keys[i] = ContentStore::link(fs, store_dir, file.source, file.target, file.size);
+                if (store_keys[i].has_value()) return;
+            }
+
+            // Copying without overwriting first avoids a separate exists() call for every file
+            fs.copy_file(file.source, file.target, fs::copy_options::none, copy_ec);
+            if (copy_ec == std::errc::file_exists)
+            {
+                overwritten[i] = true;
+                if (must_unlink(file.target)) fs.remove(file.target, copy_ec);
+                fs.copy_file(file.source, file.target, fs::copy_options::overwrite_existing, copy_ec);
+            }
+            copy_errors[i] = copy_ec;
+            if (!copy_ec) bytes_copied += file.size;
+        });
+
+        for (size_t i = 0; i < files_to_copy.size(); ++i)
         {
-            if (t.pgh.package.spec.triplet() != triplet)
+            const fs::path& target = files_to_copy[i].target;
+            if (overwritten[i])
             {
-                continue;
+                System::println(
+                    System::Color::warning, "File %s was already present and will be overwritten", target.u8string());
+            }
+            if (copy_errors[i])
+            {
+                System::println(System::Color::error, "failed: %s: %s", target.u8string(), copy_errors[i].message());
             }
+        }
 
-            output.insert(output.end(), t.files.begin(), t.files.end());
+        std::vector<ContentStore::Link> links;
+        for (size_t i = 0; i < files_to_copy.size(); ++i)
+        {
+            if (const auto key = store_keys[i].get()) links.push_back({*key, files_to_copy[i].listed_path});
         }
 
-        std::sort(output.begin(), output.end());
-        return output;
+        {
+            auto locked_metrics = Metrics::g_metrics.lock();
+            locked_metrics->track_counter("files_installed", static_cast<double>(files_to_copy.size()));
+            if (link_files == LinkFiles::TO_STORE)
+            {
+                locked_metrics->track_counter("files_deduplicated", static_cast<double>(links.size()));
+            }
+            locked_metrics->track_counter("bytes_copied", static_cast<double>(bytes_copied.load()));
+            if (!previous_entries.empty())
+            {
+                locked_metrics->track_counter("files_unchanged", static_cast<double>(files_unchanged.load()));
+            }
+        }
+
+        Listfile::write(fs, listfile, std::move(output));
+        ContentStore::write_links(fs, listfile, links);
+    }
+
+    void install_files_and_write_listfile(Files::Filesystem& fs,
+                                          const fs::path& source_dir,
+                                          const InstallDir& destination_dir,
+                                          const LinkFiles link_files)
+    {
+        install_files(fs, source_dir, destination_dir, link_files, {});
+    }
+
+    void replace_files_and_write_listfile(Files::Filesystem& fs,
+                                          const fs::path& source_dir,
+                                          const InstallDir& destination_dir,
+                                          const std::vector<Listfile::Entry>& previous_entries,
+                                          const LinkFiles link_files)
+    {
+        install_files(fs, source_dir, destination_dir, link_files, previous_entries);
     }
 
     static SortedVector<std::string> build_list_of_package_files(const Files::Filesystem& fs,
                                                                  const fs::path& package_dir)
     {
         const std::vector<fs::path> package_file_paths = fs.get_files_recursive(package_dir);
-        const size_t package_remove_char_count = package_dir.generic_string().size() + 1; // +1 for the slash
-        auto package_files = Util::fmap(package_file_paths, [package_remove_char_count](const fs::path& path) {
-            std::string as_string = path.generic_string();
-            as_string.erase(0, package_remove_char_count);
-            return std::move(as_string);
+        const size_t prefix_length = package_dir.native().size();
+        auto package_files = Util::fmap(package_file_paths, [prefix_length](const fs::path& path) {
+            return Files::generic_u8_suffix(path, prefix_length);
         });
 
         return SortedVector<std::string>(std::move(package_files));
     }
 
-    static SortedVector<std::string> build_list_of_installed_files(
-        const std::vector<StatusParagraphAndAssociatedFiles>& pgh_and_files, const Triplet& triplet)
+    /// <summary>
+    /// Writes the libraries which the MSBuild integration links when a project names the package in
+    /// VcpkgAutoLinkPackages: the import and static libraries directly in lib or debug/lib, followed by those of the
+    /// dependencies. The dependencies are installed first, so their manifests are already complete.
+    /// </summary>
+    static void write_link_manifests(const VcpkgPaths& paths,
+                                     const BinaryControlFile& bcf,
+                                     const SortedVector<std::string>& package_files)
+    {
+        auto& fs = paths.get_filesystem();
+        const PackageSpec& spec = bcf.core_paragraph.spec;
+
+        std::vector<std::string> dependencies = bcf.core_paragraph.depends;
+        for (auto&& feature : bcf.features)
+        {
+            dependencies.insert(dependencies.end(), feature.depends.cbegin(), feature.depends.cend());
+        }
+
+        for (const bool debug : {false, true})
+        {
+            const std::string lib_dir = debug ? "debug/lib/" : "lib/";
+            std::vector<std::string> libraries;
+            for (const std::string& file : package_files)
+            {
+                if (file.size() > lib_dir.size() + 4 && file.compare(0, lib_dir.size(), lib_dir) == 0 &&
+                    file.find('/', lib_dir.size()) == std::string::npos &&
+                    Strings::case_insensitive_ascii_compare(file.c_str() + file.size() - 4, ".lib") == 0)
+                {
+                    libraries.push_back(file.substr(lib_dir.size()));
+                }
+            }
+
+            for (const std::string& dependency : dependencies)
+            {
+                // Feature dependencies are written as name[feature]
+                const std::string name = dependency.substr(0, dependency.find('['));
+                const auto dependency_spec = PackageSpec::from_name_and_triplet(name, spec.triplet());
+                const auto maybe_lines =
+                    fs.read_lines(paths.link_manifest_path(dependency_spec.value_or_exit(VCPKG_LINE_INFO), debug));
+                if (const auto lines = maybe_lines.get())
+                {
+                    for (std::string& line : *lines)
+                    {
+                        if (Util::find(libraries, line) == libraries.cend()) libraries.push_back(std::move(line));
+                    }
+                }
+            }
+
+            const fs::path manifest_path = paths.link_manifest_path(spec, debug);
+            std::error_code ec;
+            fs.create_directories(manifest_path.parent_path(), ec);
+            fs.write_lines(manifest_path, libraries);
+        }
+    }
+
+    /// <summary>
+    /// Whether the package is installed with the ABI tag and the features it has now, in which case installing it would
+    /// put the same files in place. A package without an ABI tag is never taken to be the same.
+    /// </summary>
+    static bool is_installed_unchanged(StatusParagraphs& status_db, const BinaryControlFile& bcf)
     {
-        std::vector<std::string> installed_files = extract_files_in_triplet(pgh_and_files, triplet);
-        const size_t installed_remove_char_count = triplet.canonical_name().size() + 1; // +1 for the slash
-        remove_first_n_chars(&installed_files, installed_remove_char_count);
+        const BinaryParagraph& core = bcf.core_paragraph;
+        if (core.abi.empty()) return false;
+
+        const auto installed = status_db.find_installed(core.spec);
+        if (installed == status_db.end() || (*installed)->package.abi != core.abi) return false;
+
+        std::set<std::string> installed_features;
+        for (auto&& spgh : status_db.find_all(core.spec.name(), core.spec.triplet()))
+        {
+            if (!spgh->package.feature.empty() && spgh->state == InstallState::INSTALLED)
+                installed_features.insert(spgh->package.feature);
+        }
 
-        return SortedVector<std::string>(std::move(installed_files));
+        std::set<std::string> features;
+        for (auto&& feature : bcf.features)
+        {
+            features.insert(feature.feature);
+        }
+        return installed_features == features;
     }
 
     InstallResult install_package(const VcpkgPaths& paths, const BinaryControlFile& bcf, StatusParagraphs* status_db)
     {
+        // Neither the listfiles nor the owners of the installed files are loaded for a package which would not change
+        if (is_installed_unchanged(*status_db, bcf))
+        {
+            System::println("Package %s is already installed with the same ABI", bcf.core_paragraph.spec);
+            return InstallResult::SUCCESS;
+        }
+
+        const InstalledTreeLock tree_lock(paths);
         const fs::path package_dir = paths.package_dir(bcf.core_paragraph.spec);
         const Triplet& triplet = bcf.core_paragraph.spec.triplet();
-        const std::vector<StatusParagraphAndAssociatedFiles> pgh_and_files = get_installed_files(paths, *status_db);
+        const std::string& name = bcf.core_paragraph.spec.name();
+        auto& fs = paths.get_filesystem();
+        InstalledFileOwners file_owners = InstalledFileOwners::load(paths, *status_db, triplet);
+
+        // A package which is already installed is upgraded in place, leaving the files which did not change alone
+        fs::path previous_listfile;
+        std::vector<Listfile::Entry> previous_entries;
+        std::vector<std::string> previous_store_keys;
+        const auto installed = status_db->find_installed(bcf.core_paragraph.spec);
+        if (installed != status_db->end())
+        {
+            previous_listfile = paths.listfile_path((*installed)->package);
+            previous_entries = read_listfile_entries(fs, previous_listfile);
+            for (auto&& link : ContentStore::read_links(fs, previous_listfile))
+            {
+                previous_store_keys.push_back(link.key);
+            }
+        }
 
-        const SortedVector<std::string> package_files =
-            build_list_of_package_files(paths.get_filesystem(), package_dir);
-        const SortedVector<std::string> installed_files = build_list_of_installed_files(pgh_and_files, triplet);
+        const SortedVector<std::string> package_files = build_list_of_package_files(fs, package_dir);
 
         std::vector<std::string> intersection;
-        std::set_intersection(package_files.begin(),
-                              package_files.end(),
-                              installed_files.begin(),
-                              installed_files.end(),
-                              std::back_inserter(intersection));
+        const std::vector<const std::string*> owners = file_owners.find_owners(package_files);
+        for (size_t i = 0; i < owners.size(); ++i)
+        {
+            if (owners[i] != nullptr && *owners[i] != name)
+            {
+                intersection.push_back(*(package_files.begin() + i));
+            }
+        }
 
         if (!intersection.empty())
         {
@@ -209,7 +457,7 @@ namespace vcpkg::Commands::Install
         source_paragraph.state = InstallState::HALF_INSTALLED;
 
         write_update(paths, source_paragraph);
-        status_db->insert(std::make_unique<StatusParagraph>(source_paragraph));
+        status_db->insert(source_paragraph);
 
         std::vector<StatusParagraph> features_spghs;
         for (auto&& feature : bcf.features)
@@ -222,34 +470,130 @@ namespace vcpkg::Commands::Install
             feature_paragraph.state = InstallState::HALF_INSTALLED;
 
             write_update(paths, feature_paragraph);
-            status_db->insert(std::make_unique<StatusParagraph>(feature_paragraph));
+            status_db->insert(feature_paragraph);
         }
 
         const InstallDir install_dir = InstallDir::from_destination_root(
             paths.installed, triplet.to_string(), paths.listfile_path(bcf.core_paragraph));
 
-        install_files_and_write_listfile(paths.get_filesystem(), package_dir, install_dir);
+        const LinkFiles link_files = GlobalState::deduplicate ? LinkFiles::TO_STORE : LinkFiles::NO;
+        {
+            const Timings::ScopedTimer timer("install files", bcf.core_paragraph.spec.to_string());
+            if (previous_listfile.empty())
+                install_files_and_write_listfile(fs, package_dir, install_dir, link_files);
+            else
+                replace_files_and_write_listfile(fs, package_dir, install_dir, previous_entries, link_files);
+        }
+
+        // Released only now, since the new version may link to the same entries
+        ContentStore::release(fs, install_dir.store_dir(), previous_store_keys);
 
         source_paragraph.state = InstallState::INSTALLED;
         write_update(paths, source_paragraph);
-        status_db->insert(std::make_unique<StatusParagraph>(source_paragraph));
+        status_db->insert(source_paragraph);
 
         for (auto&& feature_paragraph : features_spghs)
         {
             feature_paragraph.state = InstallState::INSTALLED;
             write_update(paths, feature_paragraph);
-            status_db->insert(std::make_unique<StatusParagraph>(feature_paragraph));
+            status_db->insert(feature_paragraph);
+        }
+
+        if (!previous_listfile.empty())
+        {
+            // The features which the new version no longer has were removed along with their files
+            for (auto&& spgh : status_db->find_all(name, triplet))
+            {
+                StatusParagraph& pkg = *spgh;
+                if (pkg.package.feature.empty() || pkg.state != InstallState::INSTALLED) continue;
+                const bool is_kept = Util::find_if(bcf.features, [&](const BinaryParagraph& feature) {
+                                         return feature.feature == pkg.package.feature;
+                                     }) != bcf.features.cend();
+                if (is_kept) continue;
+
+                pkg.want = Want::PURGE;
+                pkg.state = InstallState::NOT_INSTALLED;
+                write_update(paths, pkg);
+            }
+
+            if (previous_listfile != install_dir.listfile())
+            {
+                std::error_code ec;
+                fs.remove(previous_listfile, ec);
+                fs.remove(Listfile::binary_listfile_path(previous_listfile), ec);
+                fs.remove(ContentStore::links_path(previous_listfile), ec);
+            }
         }
 
+        file_owners.add_package(paths, bcf.core_paragraph);
+        file_owners.save(paths);
+        Commands::AppLocal::invalidate_dependents_cache(paths, triplet);
+        Commands::Integrate::write_toolchain_snapshot(paths, *status_db, triplet);
+        write_link_manifests(paths, bcf, package_files);
+
         return InstallResult::SUCCESS;
     }
 
     using Build::BuildResult;
 
-    BuildResult perform_install_plan_action(const VcpkgPaths& paths,
-                                            const InstallPlanAction& action,
-                                            const Build::BuildPackageOptions& build_package_options,
-                                            StatusParagraphs& status_db)
+    /// <summary>
+    /// Calls f with the configuration which builds the package of the action
+    /// </summary>
+    template<class Func>
+    static auto with_build_config(const VcpkgPaths& paths,
+                                  const InstallPlanAction& action,
+                                  const Build::BuildPackageOptions& build_package_options,
+                                  Func&& f)
+    {
+        if (GlobalState::feature_packages)
+        {
+            const Build::BuildPackageConfig build_config{
+                *action.any_paragraph.source_control_file.value_or_exit(VCPKG_LINE_INFO),
+                action.spec.triplet(),
+                paths.port_dir(action.spec),
+                build_package_options,
+                action.feature_list};
+            return f(build_config);
+        }
+        else
+        {
+            const Build::BuildPackageConfig build_config{
+                *action.any_paragraph.source_paragraph.value_or_exit(VCPKG_LINE_INFO),
+                action.spec.triplet(),
+                paths.port_dir(action.spec),
+                build_package_options};
+            return f(build_config);
+        }
+    }
+
+    // Other vcpkg processes on the same root may have changed the status database since it was loaded
+    static InstallResult install_locked(const VcpkgPaths& paths,
+                                        const BinaryControlFile& bcf,
+                                        StatusParagraphs& status_db,
+                                        std::mutex& status_db_mutex)
+    {
+        std::lock_guard<std::mutex> lock(status_db_mutex);
+        const InstalledTreeLock tree_lock(paths);
+        status_db = database_load_check(paths);
+
+        if (is_installed_unchanged(status_db, bcf))
+        {
+            System::println("Package %s was installed by another vcpkg process", bcf.core_paragraph.spec);
+            return InstallResult::SUCCESS;
+        }
+
+        return install_package(paths, bcf, &status_db);
+    }
+
+    /// <summary>
+    /// Builds the package of the action, if it has to be built, up to its post-build checks. What is left is done by
+    /// finish_install_plan_action(), which need not wait for the next build to finish.
+    /// </summary>
+    static Build::StartedBuild start_install_plan_action(const VcpkgPaths& paths,
+                                                         const InstallPlanAction& action,
+                                                         const Build::BuildPackageOptions& build_package_options,
+                                                         const StatusParagraphs& status_db,
+                                                         std::mutex& status_db_mutex)
     {
         const InstallPlanType& plan_type = action.plan_type;
         const std::string display_name = action.spec.to_string();
@@ -266,7 +610,7 @@ namespace vcpkg::Commands::Install
                     System::Color::warning, "Package %s is already installed -- not building from HEAD", display_name);
             else
                 System::println(System::Color::success, "Package %s is already installed", display_name);
-            return BuildResult::SUCCEEDED;
+            return {{BuildResult::SUCCEEDED, {}}, true, {}, nullopt, nullopt, {}};
         }
 
         if (plan_type == InstallPlanType::BUILD_AND_INSTALL)
@@ -276,32 +620,80 @@ namespace vcpkg::Commands::Install
             else
                 System::println("Building package %s... ", display_name_with_features);
 
-            const auto result = [&]() -> Build::ExtendedBuildResult {
-                if (GlobalState::feature_packages)
+            const auto build = [&](const Build::BuildPackageConfig& build_config) -> Build::StartedBuild {
+                std::vector<Build::AbiEntry> dependency_abis;
                 {
-                    const Build::BuildPackageConfig build_config{
-                        *action.any_paragraph.source_control_file.value_or_exit(VCPKG_LINE_INFO),
-                        action.spec.triplet(),
-                        paths.port_dir(action.spec),
-                        build_package_options,
-                        action.feature_list};
-                    return Build::build_package(paths, build_config, status_db);
+                    std::lock_guard<std::mutex> lock(status_db_mutex);
+                    std::vector<PackageSpec> missing_specs = Build::find_missing_dependencies(build_config, status_db);
+                    if (!missing_specs.empty())
+                    {
+                        return {{BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES, std::move(missing_specs)},
+                                true,
+                                {},
+                                nullopt,
+                                nullopt,
+                                {}};
+                    }
+                    dependency_abis = Build::get_dependency_abis(build_config, status_db);
                 }
-                else
+
+                // A worker publishes what it builds to the binary sources, from which start_build() restores it
+                const Optional<BuildResult> remote_result =
+                    BuildQueue::try_build_remotely(paths, build_config, dependency_abis);
+                if (const auto p = remote_result.get())
                 {
-                    const Build::BuildPackageConfig build_config{
-                        action.any_paragraph.source_paragraph.value_or_exit(VCPKG_LINE_INFO),
-                        action.spec.triplet(),
-                        paths.port_dir(action.spec),
-                        build_package_options};
-                    return Build::build_package(paths, build_config, status_db);
+                    if (*p != BuildResult::SUCCEEDED) return {{*p, {}}, true, {}, nullopt, nullopt, {}};
                 }
-            }();
+
+                // The status database is not consulted while building, so other packages may be installed meanwhile
+                return Build::start_build(paths, build_config, dependency_abis);
+            };
+
+            return with_build_config(paths, action, build_package_options, build);
+        }
+
+        if (plan_type == InstallPlanType::INSTALL)
+        {
+            if (use_head_version && is_user_requested)
+            {
+                System::println(
+                    System::Color::warning, "Package %s is already built -- not building from HEAD", display_name);
+            }
+            return {{BuildResult::SUCCEEDED, {}}, false, {}, nullopt, nullopt, {}};
+        }
+
+        Checks::unreachable(VCPKG_LINE_INFO);
+    }
+
+    static Build::ExtendedBuildResult finish_install_plan_action(
+        const VcpkgPaths& paths,
+        const InstallPlanAction& action,
+        const Build::BuildPackageOptions& build_package_options,
+        Build::StartedBuild started,
+        StatusParagraphs& status_db,
+        std::mutex& status_db_mutex)
+    {
+        const InstallPlanType& plan_type = action.plan_type;
+        const std::string display_name = action.spec.to_string();
+        const std::string display_name_with_features =
+            GlobalState::feature_packages ? action.displayname() : display_name;
+
+        if (plan_type == InstallPlanType::ALREADY_INSTALLED)
+        {
+            return std::move(started.result);
+        }
+
+        if (plan_type == InstallPlanType::BUILD_AND_INSTALL)
+        {
+            auto result = with_build_config(
+                paths, action, build_package_options, [&](const Build::BuildPackageConfig& build_config) {
+                    return Build::finish_build(paths, build_config, std::move(started));
+                });
 
             if (result.code != Build::BuildResult::SUCCEEDED)
             {
                 System::println(System::Color::error, Build::create_error_message(result.code, action.spec));
-                return result.code;
+                return result;
             }
 
             System::println("Building package %s... done", display_name_with_features);
@@ -309,33 +701,34 @@ namespace vcpkg::Commands::Install
             const BinaryControlFile bcf =
                 Paragraphs::try_load_cached_control_package(paths, action.spec).value_or_exit(VCPKG_LINE_INFO);
             System::println("Installing package %s... ", display_name_with_features);
-            const auto install_result = install_package(paths, bcf, &status_db);
+            const ElapsedTime install_timer = ElapsedTime::create_started();
+            const auto install_result = install_locked(paths, bcf, status_db, status_db_mutex);
+            result.phase_timings.push_back({"install", install_timer.microseconds()});
             switch (install_result)
             {
                 case InstallResult::SUCCESS:
                     System::println(System::Color::success, "Installing package %s... done", display_name);
-                    return BuildResult::SUCCEEDED;
-                case InstallResult::FILE_CONFLICTS: return BuildResult::FILE_CONFLICTS;
+                    return result;
+                case InstallResult::FILE_CONFLICTS: result.code = BuildResult::FILE_CONFLICTS; return result;
                 default: Checks::unreachable(VCPKG_LINE_INFO);
             }
         }
 
         if (plan_type == InstallPlanType::INSTALL)
         {
-            if (use_head_version && is_user_requested)
-            {
-                System::println(
-                    System::Color::warning, "Package %s is already built -- not building from HEAD", display_name);
-            }
             System::println("Installing package %s... ", display_name);
-            const auto install_result = install_package(
-                paths, action.any_paragraph.binary_control_file.value_or_exit(VCPKG_LINE_INFO), &status_db);
+            const ElapsedTime install_timer = ElapsedTime::create_started();
+            const BinaryControlFile& bcf = action.any_paragraph.binary_control_file.value_or_exit(VCPKG_LINE_INFO);
+            const auto install_result = install_locked(paths, bcf, status_db, status_db_mutex);
+            std::vector<Build::PhaseTiming> phase_timings = {{"install", install_timer.microseconds()}};
             switch (install_result)
             {
                 case InstallResult::SUCCESS:
                     System::println(System::Color::success, "Installing package %s... done", display_name);
-                    return BuildResult::SUCCEEDED;
-                case InstallResult::FILE_CONFLICTS: return BuildResult::FILE_CONFLICTS;
+                    return {BuildResult::SUCCEEDED, {}, Build::BinaryCacheStatus::NOT_USED, std::move(phase_timings)};
+                case InstallResult::FILE_CONFLICTS:
+                    return {
+                        BuildResult::FILE_CONFLICTS, {}, Build::BinaryCacheStatus::NOT_USED, std::move(phase_timings)};
                 default: Checks::unreachable(VCPKG_LINE_INFO);
             }
         }
@@ -343,6 +736,28 @@ namespace vcpkg::Commands::Install
         Checks::unreachable(VCPKG_LINE_INFO);
     }
 
+    static Build::ExtendedBuildResult perform_install_plan_action(
+        const VcpkgPaths& paths,
+        const InstallPlanAction& action,
+        const Build::BuildPackageOptions& build_package_options,
+        StatusParagraphs& status_db,
+        std::mutex& status_db_mutex)
+    {
+        Build::StartedBuild started =
+            start_install_plan_action(paths, action, build_package_options, status_db, status_db_mutex);
+        return finish_install_plan_action(
+            paths, action, build_package_options, std::move(started), status_db, status_db_mutex);
+    }
+
+    BuildResult perform_install_plan_action(const VcpkgPaths& paths,
+                                            const InstallPlanAction& action,
+                                            const Build::BuildPackageOptions& build_package_options,
+                                            StatusParagraphs& status_db)
+    {
+        std::mutex status_db_mutex;
+        return perform_install_plan_action(paths, action, build_package_options, status_db, status_db_mutex).code;
+    }
+
     static void print_plan(const std::vector<AnyAction>& action_plan, bool is_recursive)
     {
         std::vector<const RemovePlanAction*> remove_plans;
@@ -407,10 +822,27 @@ namespace vcpkg::Commands::Install
 
         if (rebuilt_plans.size() > 0)
         {
-            const std::string rebuilt_string = Strings::join("\n", rebuilt_plans, [](const InstallPlanAction* p) {
-                return to_output_string(p->request_type, p->displayname());
+            const std::string rebuilt_string = Strings::join("\n", rebuilt_plans, [&](const InstallPlanAction* p) {
+                const auto remove_plan = *Util::find_if(
+                    remove_plans, [&](const RemovePlanAction* plan) { return plan->spec == p->spec; });
+                const auto cascaded_from = remove_plan->cascaded_from.get();
+                if (!cascaded_from) return to_output_string(p->request_type, p->displayname());
+                const std::string reason = Strings::format("against %s", cascaded_from->to_string());
+                return to_output_string(p->request_type, Strings::format("%s (%s)", p->displayname(), reason));
             });
             System::println("The following packages will be rebuilt:\n%s", rebuilt_string);
+
+            // The features added to these packages leave what their dependents were built against as it was
+            for (auto&& remove_plan : remove_plans)
+            {
+                if (remove_plan->kept_dependents.empty()) continue;
+                System::println("The installed packages which depend on %s are not rebuilt, as the features added to "
+                                "it do not change its ABI:\n    %s",
+                                remove_plan->spec.to_string(),
+                                Strings::join("\n    ", remove_plan->kept_dependents, [](const PackageSpec& spec) {
+                                    return spec.to_string();
+                                }));
+            }
         }
 
         if (new_plans.size() > 0)
@@ -442,100 +874,1334 @@ namespace vcpkg::Commands::Install
         }
     }
 
-    void perform_and_exit(const std::vector<AnyAction>& action_plan,
-                          const Build::BuildPackageOptions& install_plan_options,
-                          const KeepGoing keep_going,
-                          const PrintSummary print_summary,
-                          const VcpkgPaths& paths,
-                          StatusParagraphs& status_db)
+    static void exit_if_failed(const Build::ExtendedBuildResult& result,
+                               const PackageSpec& spec,
+                               const KeepGoing keep_going)
     {
-        std::vector<BuildResult> results;
-        std::vector<std::string> timing;
-        const ElapsedTime timer = ElapsedTime::create_started();
-        size_t counter = 0;
-        const size_t package_count = action_plan.size();
+        if (result.code != BuildResult::SUCCEEDED && keep_going == KeepGoing::NO)
+        {
+            System::println(Build::create_user_troubleshooting_message(spec));
+            BinaryCaching::wait_for_uploads();
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+    }
 
-        for (const auto& action : action_plan)
+    static Build::ExtendedBuildResult perform_action(const VcpkgPaths& paths,
+                                                     const AnyAction& action,
+                                                     const Build::BuildPackageOptions& install_plan_options,
+                                                     const KeepGoing keep_going,
+                                                     StatusParagraphs& status_db,
+                                                     std::mutex& status_db_mutex)
+    {
+        if (const auto install_action = action.install_plan.get())
         {
-            const ElapsedTime build_timer = ElapsedTime::create_started();
-            counter++;
+            Build::ExtendedBuildResult result =
+                perform_install_plan_action(paths, *install_action, install_plan_options, status_db, status_db_mutex);
+            exit_if_failed(result, install_action->spec, keep_going);
+            return result;
+        }
 
-            const std::string display_name = action.spec().to_string();
-            System::println("Starting package %d/%d: %s", counter, package_count, display_name);
+        if (const auto remove_action = action.remove_plan.get())
+        {
+            Checks::check_exit(VCPKG_LINE_INFO, GlobalState::feature_packages);
+            std::lock_guard<std::mutex> lock(status_db_mutex);
+            const InstalledTreeLock tree_lock(paths);
+            status_db = database_load_check(paths);
+            Remove::perform_remove_plan_action(paths, *remove_action, Remove::Purge::YES, status_db);
+            return {BuildResult::NULLVALUE, {}};
+        }
 
-            timing.push_back("0");
-            results.push_back(BuildResult::NULLVALUE);
+        Checks::unreachable(VCPKG_LINE_INFO);
+    }
 
-            if (const auto install_action = action.install_plan.get())
-            {
-                const BuildResult result =
-                    perform_install_plan_action(paths, *install_action, install_plan_options, status_db);
-                if (result != BuildResult::SUCCEEDED && keep_going == KeepGoing::NO)
-                {
-                    System::println(Build::create_user_troubleshooting_message(install_action->spec));
-                    Checks::exit_fail(VCPKG_LINE_INFO);
-                }
+    std::vector<PackageSpec> get_install_plan_dependencies(const InstallPlanAction& action)
+    {
+        // Already installed packages have nothing left to wait for
+        if (action.plan_type == InstallPlanType::ALREADY_INSTALLED) return {};
 
-                results.back() = result;
-            }
-            else if (const auto remove_action = action.remove_plan.get())
-            {
-                Checks::check_exit(VCPKG_LINE_INFO, GlobalState::feature_packages);
-                Remove::perform_remove_plan_action(paths, *remove_action, Remove::Purge::YES, status_db);
-            }
-            else
+        const Triplet& triplet = action.spec.triplet();
+        if (const auto p_scf = action.any_paragraph.source_control_file.get())
+        {
+            const SourceControlFile& scf = **p_scf;
+            const ResolvedDependencies& resolved = scf.resolve_dependencies(triplet);
+            std::vector<PackageSpec> deps =
+                Util::fmap(resolved.core, [](const FeatureSpec& fspec) { return fspec.spec(); });
+            for (auto&& feature : scf.feature_paragraphs)
             {
-                Checks::unreachable(VCPKG_LINE_INFO);
+                if (action.feature_list.find(feature->name) == action.feature_list.end()) continue;
+                for (auto&& fspec : resolved.features.at(feature->name))
+                    deps.push_back(fspec.spec());
             }
-
-            timing.back() = build_timer.to_string();
-            System::println("Elapsed time for package %s: %s", display_name, build_timer.to_string());
+            return deps;
         }
 
-        System::println("Total time taken: %s", timer.to_string());
+        return action.any_paragraph.dependencies(triplet);
+    }
 
-        if (print_summary == PrintSummary::YES)
+    /// <summary>
+    /// For each action in the plan, the indices of the earlier actions which must be completed before it can start
+    /// </summary>
+    static std::vector<std::vector<size_t>> get_action_plan_dependencies(const std::vector<AnyAction>& action_plan)
+    {
+        std::vector<std::vector<size_t>> output(action_plan.size());
+        std::unordered_map<PackageSpec, size_t> last_action_for_spec;
+        std::unordered_map<std::string, size_t> last_build_for_port;
+        Optional<size_t> last_remove_action;
+
+        for (size_t i = 0; i < action_plan.size(); ++i)
         {
-            for (size_t i = 0; i < results.size(); i++)
+            const AnyAction& action = action_plan[i];
+            std::vector<PackageSpec> specs_to_wait_for;
+            if (const auto install_action = action.install_plan.get())
             {
-                System::println("%s: %s: %s", action_plan[i].spec(), Build::to_string(results[i]), timing[i]);
+                specs_to_wait_for = get_install_plan_dependencies(*install_action);
             }
-
-            std::map<BuildResult, int> summary;
-            for (const BuildResult& v : Build::BUILD_RESULT_VALUES)
+            else if (const auto p_last_remove = last_remove_action.get())
             {
-                summary[v] = 0;
+                // Removals are cheap; keep them in plan order
+                output[i].push_back(*p_last_remove);
             }
 
-            for (const BuildResult& r : results)
+            // A package which is rebuilt must also wait for its own removal
+            specs_to_wait_for.push_back(action.spec());
+
+            for (auto&& spec : specs_to_wait_for)
             {
-                summary[r]++;
+                const auto it = last_action_for_spec.find(spec);
+                if (it != last_action_for_spec.end()) output[i].push_back(it->second);
             }
 
-            System::println("\n\nSUMMARY");
-            for (const std::pair<const BuildResult, int>& entry : summary)
+            // Builds of one port for different triplets share the port's buildtrees directory
+            const auto install_action = action.install_plan.get();
+            if (install_action && install_action->plan_type == InstallPlanType::BUILD_AND_INSTALL)
             {
-                System::println("    %s: %d", Build::to_string(entry.first), entry.second);
+                const auto it = last_build_for_port.find(action.spec().name());
+                if (it != last_build_for_port.end()) output[i].push_back(it->second);
+                last_build_for_port[action.spec().name()] = i;
             }
+
+            last_action_for_spec[action.spec()] = i;
+            if (action.remove_plan.get()) last_remove_action = i;
         }
 
-        Checks::exit_success(VCPKG_LINE_INFO);
+        return output;
     }
 
-    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
+    /// <summary>
+    /// For each action in the plan, the indices of the install actions of the packages it needs installed. Unlike the
+    /// dependencies, these leave out the actions which an action merely waits for, such as the build of the same port
+    /// for another triplet.
+    /// </summary>
+    static std::vector<std::vector<size_t>> get_action_plan_requirements(const std::vector<AnyAction>& action_plan)
     {
-        static const std::string OPTION_DRY_RUN = "--dry-run";
-        static const std::string OPTION_USE_HEAD_VERSION = "--head";
-        static const std::string OPTION_NO_DOWNLOADS = "--no-downloads";
-        static const std::string OPTION_RECURSE = "--recurse";
-        static const std::string OPTION_KEEP_GOING = "--keep-going";
-
-        // input sanitization
-        static const std::string EXAMPLE =
-            Commands::Help::create_example_string("install zlib zlib:x64-windows curl boost");
-        args.check_min_arg_count(1, EXAMPLE);
+        std::vector<std::vector<size_t>> output(action_plan.size());
+        std::unordered_map<PackageSpec, size_t> last_install_for_spec;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            const auto install_action = action_plan[i].install_plan.get();
+            if (install_action == nullptr) continue;
 
-        const std::vector<FullPackageSpec> specs = Util::fmap(args.command_arguments, [&](auto&& arg) {
+            for (auto&& spec : get_install_plan_dependencies(*install_action))
+            {
+                const auto it = last_install_for_spec.find(spec);
+                if (it != last_install_for_spec.end()) output[i].push_back(it->second);
+            }
+            last_install_for_spec[install_action->spec] = i;
+        }
+
+        return output;
+    }
+
+    static void prepare_paths_for_parallel_builds(const std::vector<AnyAction>& action_plan, const VcpkgPaths& paths)
+    {
+        // The tools and toolsets of VcpkgPaths are discovered lazily, which is not safe to race on
+        paths.get_cmake_exe();
+        paths.get_git_exe();
+
+        std::unordered_set<std::string> triplets;
+        for (auto&& action : action_plan)
+        {
+            const auto install_action = action.install_plan.get();
+            if (install_action == nullptr || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            const Triplet& triplet = install_action->spec.triplet();
+            if (!triplets.insert(triplet.canonical_name()).second) continue;
+
+            const auto pre_build_info = Build::PreBuildInfo::from_triplet_file(paths, triplet);
+            paths.get_toolset(pre_build_info.platform_toolset);
+        }
+    }
+
+    std::vector<Optional<std::string>> compute_planned_abis(const std::vector<AnyAction>& action_plan,
+                                                            const Build::BuildPackageOptions& install_plan_options,
+                                                            const VcpkgPaths& paths,
+                                                            const StatusParagraphs& status_db)
+    {
+        // Empty for a package which will not have an ABI tag, which keeps its dependents out of the cache as well
+        std::map<std::string, std::string> planned_abis;
+        std::vector<Optional<std::string>> abi_tags(action_plan.size());
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            const auto install_action = action_plan[i].install_plan.get();
+            if (!install_action || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            const auto compute_abi_tag = [&](const Build::BuildPackageConfig& build_config) {
+                const Triplet& triplet = build_config.triplet;
+                const std::vector<Dependency> depends = Build::get_build_dependencies(build_config);
+                std::vector<Build::AbiEntry> dependency_abis;
+                for (auto&& dep : filter_dependencies(depends, triplet))
+                {
+                    const auto planned = planned_abis.find(dep + ':' + triplet.canonical_name());
+                    if (planned != planned_abis.end())
+                    {
+                        dependency_abis.push_back({dep, planned->second});
+                        continue;
+                    }
+
+                    const auto installed = status_db.find_installed(dep, triplet);
+                    dependency_abis.push_back({dep, installed == status_db.end() ? "" : (*installed)->package.abi});
+                }
+                for (auto&& host_spec : filter_host_dependencies(depends))
+                {
+                    const std::string name = host_spec.to_string();
+                    const auto planned = planned_abis.find(name);
+                    if (planned != planned_abis.end())
+                    {
+                        dependency_abis.push_back({name, planned->second});
+                        continue;
+                    }
+
+                    const auto installed = status_db.find_installed(host_spec);
+                    dependency_abis.push_back({name, installed == status_db.end() ? "" : (*installed)->package.abi});
+                }
+                return Build::compute_abi_tag(paths, build_config, dependency_abis);
+            };
+
+            abi_tags[i] = with_build_config(paths, *install_action, install_plan_options, compute_abi_tag);
+            planned_abis[install_action->spec.to_string()] = abi_tags[i].value_or("");
+        }
+        return abi_tags;
+    }
+
+    /// <summary>
+    /// Starts fetching the packages which the plan builds from the binary sources while the plan runs
+    /// </summary>
+    static void prefetch_binary_packages(const std::vector<AnyAction>& action_plan,
+                                         const Build::BuildPackageOptions& install_plan_options,
+                                         const VcpkgPaths& paths,
+                                         const StatusParagraphs& status_db)
+    {
+        if (!GlobalState::binary_caching) return;
+
+        const std::vector<Optional<std::string>> abi_tags =
+            compute_planned_abis(action_plan, install_plan_options, paths, status_db);
+        std::vector<BinaryCaching::PrefetchRequest> requests;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            if (const auto p = abi_tags[i].get())
+            {
+                requests.push_back({action_plan[i].spec(), *p, Build::get_archive_path(paths, *p)});
+            }
+        }
+
+        BinaryCaching::prefetch_from_sources(paths, std::move(requests));
+    }
+
+    /// <summary>
+    /// Downloads the distfiles which the ports to be built recorded in their previous builds, all at once and before
+    /// the builds start, so that the builds do not wait on the network. Failures are left for the builds to report.
+    /// </summary>
+    static void prefetch_distfiles(const std::vector<AnyAction>& action_plan,
+                                   const Build::BuildPackageOptions& install_plan_options,
+                                   const VcpkgPaths& paths)
+    {
+        if (!to_bool(install_plan_options.allow_downloads) || to_bool(install_plan_options.use_head_version)) return;
+
+        auto& fs = paths.get_filesystem();
+        std::vector<Build::Distfile> distfiles;
+        std::unordered_set<std::string> seen_hashes;
+        for (auto&& action : action_plan)
+        {
+            const auto install_action = action.install_plan.get();
+            if (install_action == nullptr || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            const AnyParagraph& any_paragraph = install_action->any_paragraph;
+            const SourceParagraph& source = [&]() -> const SourceParagraph& {
+                if (const auto p_scf = any_paragraph.source_control_file.get()) return *(*p_scf)->core_paragraph;
+                return *any_paragraph.source_paragraph.value_or_exit(VCPKG_LINE_INFO);
+            }();
+
+            // Files are shared between ports and triplets, so each is fetched once
+            for (auto&& distfile : Build::load_distfiles(paths, source))
+            {
+                if (fs.exists(paths.downloads / distfile.filename)) continue;
+                if (seen_hashes.insert(distfile.sha512).second) distfiles.push_back(std::move(distfile));
+            }
+        }
+
+        if (distfiles.empty()) return;
+
+        System::println("Prefetching %d distfiles...", distfiles.size());
+        // Found once before the threads start, which all run it
+        paths.get_cmake_exe();
+        const fs::path vcpkg_exe = System::get_exe_path_of_current_process();
+        Util::parallel_for_each_index(distfiles.size(), [&](const size_t i) {
+            const Build::Distfile& distfile = distfiles[i];
+            const Timings::ScopedTimer timer("prefetch", distfile.filename);
+
+            const std::wstring cmd_launch_cmake = make_ports_cmake_cmd(paths,
+                                                                       {
+                                                                           {L"CMD", L"DOWNLOAD"},
+                                                                           {L"URLS", Strings::join(";", distfile.urls)},
+                                                                           {L"FILENAME", distfile.filename},
+                                                                           {L"SHA512", distfile.sha512},
+                                                                           {L"VCPKG_EXE", vcpkg_exe},
+                                                                       });
+            if (System::cmd_execute_and_capture_output(cmd_launch_cmake).exit_code == 0)
+            {
+                System::println("Prefetched %s", distfile.filename);
+                return;
+            }
+
+            // A file which failed the hash check is left behind; remove it so that the build downloads it again
+            std::error_code ec;
+            fs.remove(paths.downloads / distfile.filename, ec);
+            System::println(System::Color::warning, "Could not prefetch %s", distfile.filename);
+        });
+    }
+
+    /// <summary>
+    /// Installs the MSYS2 packages which the ports to be built asked for in their previous builds, in a single run of
+    /// pacman before the builds start, so that parallel builds do not update the shared environment one by one.
+    /// </summary>
+    static void prepare_msys(const std::vector<AnyAction>& action_plan,
+                             const Build::BuildPackageOptions& install_plan_options,
+                             const VcpkgPaths& paths)
+    {
+        if (!to_bool(install_plan_options.allow_downloads)) return;
+
+        std::vector<std::string> packages;
+        for (auto&& action : action_plan)
+        {
+            const auto install_action = action.install_plan.get();
+            if (install_action == nullptr || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            const AnyParagraph& any_paragraph = install_action->any_paragraph;
+            const SourceParagraph& source = [&]() -> const SourceParagraph& {
+                if (const auto p_scf = any_paragraph.source_control_file.get()) return *(*p_scf)->core_paragraph;
+                return *any_paragraph.source_paragraph.value_or_exit(VCPKG_LINE_INFO);
+            }();
+
+            for (auto&& package : Build::load_msys_packages(paths, source))
+            {
+                if (Util::find(packages, package) == packages.cend()) packages.push_back(std::move(package));
+            }
+        }
+
+        if (packages.empty()) return;
+
+        System::println("Preparing MSYS2 packages: %s", Strings::join(", ", packages));
+        const Timings::ScopedTimer timer("prepare", "msys2");
+        const std::wstring cmd_launch_cmake =
+            make_ports_cmake_cmd(paths,
+                                 {
+                                     {L"CMD", L"ACQUIRE_MSYS"},
+                                     {L"MSYS_PACKAGES", Strings::join(";", packages)},
+                                 });
+        if (System::cmd_execute_and_capture_output(cmd_launch_cmake).exit_code != 0)
+        {
+            System::println(System::Color::warning, "Could not prepare MSYS2; the builds will install what they need");
+        }
+    }
+
+    // What a build which was never timed is expected to take, when no other build was timed either
+    static constexpr double DEFAULT_BUILD_MICROSECONDS = 60e6;
+
+    static std::string format_microseconds(const double microseconds)
+    {
+        return format_time_userfriendly(std::chrono::nanoseconds(static_cast<long long>(microseconds * 1000)));
+    }
+
+    /// <summary>
+    /// How long each action is expected to take: a build as long as it took the last time, and a build of a port
+    /// which was never built as long as the average build. Everything else is quick in comparison, so it is free.
+    /// </summary>
+    std::vector<double> estimate_durations(const std::vector<AnyAction>& action_plan,
+                                           const Build::BuildTimes& build_times)
+    {
+        const double unknown = build_times.mean().value_or(DEFAULT_BUILD_MICROSECONDS);
+        return Util::fmap(action_plan, [&](const AnyAction& action) {
+            const auto install_action = action.install_plan.get();
+            if (install_action == nullptr || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL)
+            {
+                return 0.0;
+            }
+            return build_times.find(action.spec()).value_or(unknown);
+        });
+    }
+
+    /// <summary>
+    /// For each action, the later actions which wait for it
+    /// </summary>
+    static std::vector<std::vector<size_t>> get_dependents(const std::vector<std::vector<size_t>>& dependencies)
+    {
+        std::vector<std::vector<size_t>> dependents(dependencies.size());
+        for (size_t i = 0; i < dependencies.size(); ++i)
+        {
+            for (const size_t dependency : dependencies[i])
+                dependents[dependency].push_back(i);
+        }
+        return dependents;
+    }
+
+    /// <summary>
+    /// The expected time from the start of each action to the end of the longest chain of actions which wait for it
+    /// </summary>
+    static std::vector<double> get_critical_paths(const std::vector<double>& durations,
+                                                  const std::vector<std::vector<size_t>>& dependents)
+    {
+        // Actions only wait for earlier ones, so the dependents of each action are done before it
+        std::vector<double> critical_paths(durations.size());
+        for (size_t i = durations.size(); i-- > 0;)
+        {
+            double longest = 0;
+            for (const size_t dependent : dependents[i])
+                longest = std::max(longest, critical_paths[dependent]);
+            critical_paths[i] = durations[i] + longest;
+        }
+        return critical_paths;
+    }
+
+    /// <summary>
+    /// For each action, how many requested actions come before it in a plan which was put in order by the requests;
+    /// all 0 when the plan is scheduled by critical path alone
+    /// </summary>
+    static std::vector<size_t> get_request_ranks(const std::vector<AnyAction>& action_plan, const PlanOrder plan_order)
+    {
+        std::vector<size_t> ranks(action_plan.size());
+        if (plan_order == PlanOrder::CRITICAL_PATH) return ranks;
+
+        size_t rank = 0;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            ranks[i] = rank;
+            const auto install_action = action_plan[i].install_plan.get();
+            if (install_action && install_action->request_type == RequestType::USER_REQUESTED) ++rank;
+        }
+        return ranks;
+    }
+
+    /// <summary>
+    /// Orders the actions which are ready so that the one needed by the earliest request starts first, and among
+    /// those the one with the longest critical path, since starting it late makes the others wait; ties go to the
+    /// earliest in the plan
+    /// </summary>
+    struct ByPriority
+    {
+        const std::vector<size_t>* ranks;
+        const std::vector<double>* critical_paths;
+
+        bool operator()(const size_t left, const size_t right) const
+        {
+            if ((*ranks)[left] != (*ranks)[right]) return (*ranks)[left] < (*ranks)[right];
+            const double left_path = (*critical_paths)[left];
+            const double right_path = (*critical_paths)[right];
+            if (left_path != right_path) return left_path > right_path;
+            return left < right;
+        }
+    };
+
+    /// <summary>
+    /// Plays the schedule through with the expected durations to tell how long the whole plan takes
+    /// </summary>
+    static double estimate_plan_microseconds(const std::vector<double>& durations,
+                                             const std::vector<std::vector<size_t>>& dependencies,
+                                             const std::vector<std::vector<size_t>>& dependents,
+                                             const ByPriority& priority,
+                                             const size_t jobs)
+    {
+        std::vector<size_t> pending_dependencies(durations.size());
+        std::set<size_t, ByPriority> ready(priority);
+        for (size_t i = 0; i < durations.size(); ++i)
+        {
+            pending_dependencies[i] = dependencies[i].size();
+            if (pending_dependencies[i] == 0) ready.insert(i);
+        }
+
+        double now = 0;
+        std::multimap<double, size_t> running; // by the time each finishes
+        for (;;)
+        {
+            while (running.size() < jobs && !ready.empty())
+            {
+                const size_t index = *ready.begin();
+                ready.erase(ready.begin());
+                running.emplace(now + durations[index], index);
+            }
+            if (running.empty()) return now;
+
+            now = running.begin()->first;
+            const size_t finished = running.begin()->second;
+            running.erase(running.begin());
+            for (const size_t dependent : dependents[finished])
+            {
+                if (--pending_dependencies[dependent] == 0) ready.insert(dependent);
+            }
+        }
+    }
+
+    /// <summary>
+    /// How much memory the builds which run at once may take together: VCPKG_MEMORY_BUDGET in MiB, or three quarters
+    /// of the physical memory, which leaves the rest to the system and to the builds of ports without a Build-Memory.
+    /// 0 when there is no limit.
+    /// </summary>
+    static size_t get_memory_budget_mib()
+    {
+        const Optional<std::wstring> budget_env = System::get_environment_variable(L"VCPKG_MEMORY_BUDGET");
+        if (const auto p = budget_env.get())
+        {
+            const std::string budget = Strings::to_utf8(*p);
+            const int parsed_budget = atoi(budget.c_str());
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               parsed_budget > 0,
+                               "Error: VCPKG_MEMORY_BUDGET must be a positive number of MiB, but was '%s'",
+                               budget);
+            return static_cast<size_t>(parsed_budget);
+        }
+        return System::get_physical_memory_mib() / 4 * 3;
+    }
+
+    /// <summary>
+    /// The Build-Memory of the port, or else the peak memory its last build took
+    /// </summary>
+    static size_t get_build_memory_mib(const AnyAction& action, const Build::BuildTimes& build_times)
+    {
+        const auto install_action = action.install_plan.get();
+        if (install_action == nullptr || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL) return 0;
+
+        const AnyParagraph& any_paragraph = install_action->any_paragraph;
+        const size_t hint = [&]() {
+            if (const auto p_scf = any_paragraph.source_control_file.get())
+            {
+                return (*p_scf)->core_paragraph->build_memory_mib;
+            }
+            return any_paragraph.source_paragraph.value_or_exit(VCPKG_LINE_INFO)->build_memory_mib;
+        }();
+        if (hint != 0) return hint;
+        return build_times.find_peak_memory_mib(action.spec()).value_or(0);
+    }
+
+    /// <summary>
+    /// A package whose build has run, waiting for its post-build checks and installation
+    /// </summary>
+    struct PendingInstall
+    {
+        size_t index;
+        Build::StartedBuild started;
+        ElapsedTime package_timer;
+    };
+
+    static void perform_actions_in_parallel(const std::vector<AnyAction>& action_plan,
+                                            const Build::BuildPackageOptions& install_plan_options,
+                                            const KeepGoing keep_going,
+                                            const size_t jobs,
+                                            const VcpkgPaths& paths,
+                                            StatusParagraphs& status_db,
+                                            const std::vector<double>& estimated_durations,
+                                            const Build::BuildTimes& build_times,
+                                            const PlanOrder plan_order,
+                                            std::vector<SpecSummary>& results)
+    {
+        const size_t package_count = action_plan.size();
+        const std::vector<std::vector<size_t>> dependencies = get_action_plan_dependencies(action_plan);
+        const std::vector<std::vector<size_t>> dependents = get_dependents(dependencies);
+        const std::vector<std::vector<size_t>> requiring = get_dependents(get_action_plan_requirements(action_plan));
+
+        const std::vector<double> critical_paths = get_critical_paths(estimated_durations, dependents);
+        const std::vector<size_t> ranks = get_request_ranks(action_plan, plan_order);
+        const ByPriority priority{&ranks, &critical_paths};
+        std::vector<size_t> pending_dependencies(package_count);
+        std::set<size_t, ByPriority> ready(priority);
+        for (size_t i = 0; i < package_count; ++i)
+        {
+            pending_dependencies[i] = dependencies[i].size();
+            if (pending_dependencies[i] == 0) ready.insert(i);
+        }
+
+        const size_t worker_count = std::min(jobs, package_count);
+        const double estimated_microseconds =
+            estimate_plan_microseconds(estimated_durations, dependencies, dependents, priority, worker_count);
+        if (estimated_microseconds > 0)
+        {
+            System::println(
+                "Estimated time with %d jobs: %s", worker_count, format_microseconds(estimated_microseconds));
+        }
+        const ElapsedTime plan_timer = ElapsedTime::create_started();
+
+        prepare_paths_for_parallel_builds(action_plan, paths);
+
+        // The ports which build at once split the cores between them, rather than each running one process per core
+        Build::BuildPackageOptions build_options = install_plan_options;
+        const size_t cores = System::get_build_core_count();
+        if (cores != 0) build_options.concurrency = std::max<size_t>(1, cores / std::min(jobs, package_count));
+
+        // The builds are admitted by the memory they are expected to take as well as by the number of jobs
+        const std::vector<size_t> build_memory =
+            Util::fmap(action_plan, [&](const AnyAction& action) { return get_build_memory_mib(action, build_times); });
+        const bool has_memory_hints = std::any_of(build_memory.cbegin(), build_memory.cend(), [](const size_t mib) {
+            return mib != 0;
+        });
+        const size_t memory_budget = has_memory_hints ? get_memory_budget_mib() : 0;
+        if (memory_budget != 0) System::println("Memory budget of the builds: %d MiB", memory_budget);
+
+        std::mutex scheduler_mutex;
+        std::condition_variable scheduler_cv;
+        std::mutex status_db_mutex;
+        size_t started_count = 0;
+        size_t finished_count = 0;
+        size_t memory_in_use = 0;
+        std::vector<bool> cascaded(package_count);
+        std::set<size_t> running;
+        std::deque<PendingInstall> pending_installs;
+
+        // Called with scheduler_mutex held. The ready action of the highest priority whose build fits next to the
+        // builds which are running. A build which takes more than the whole budget runs once the others are done.
+        const auto find_admissible = [&]() {
+            return std::find_if(ready.begin(), ready.end(), [&](const size_t i) {
+                return memory_budget == 0 || memory_in_use == 0 || memory_in_use + build_memory[i] <= memory_budget;
+            });
+        };
+
+        // Called with scheduler_mutex held
+        const auto update_status_line = [&]() {
+            const std::string names =
+                Strings::join(", ", running, [&](const size_t i) { return action_plan[i].spec().to_string(); });
+            const double remaining = estimated_microseconds - plan_timer.microseconds();
+            const std::string eta = remaining > 0 ? ", about " + format_microseconds(remaining) + " left" : "";
+            System::set_status_line(Strings::format("[%d/%d done%s] %s", finished_count, package_count, eta, names));
+        };
+
+        // Called with scheduler_mutex held
+        const auto release_dependents = [&](const size_t index) {
+            ++finished_count;
+            for (const size_t dependent : dependents[index])
+            {
+                if (--pending_dependencies[dependent] == 0 && !cascaded[dependent]) ready.insert(dependent);
+            }
+        };
+
+        // Called with scheduler_mutex held. Every package which needs the failed one, directly or through others, is
+        // cascaded at once, rather than each reaching a job slot only to find its dependencies missing.
+        const auto cascade_from = [&](const size_t failed) {
+            std::vector<size_t> cone;
+            std::vector<size_t> stack = {failed};
+            while (!stack.empty())
+            {
+                const size_t index = stack.back();
+                stack.pop_back();
+                for (const size_t dependent : requiring[index])
+                {
+                    if (cascaded[dependent]) continue;
+                    cascaded[dependent] = true;
+                    const Build::ExtendedBuildResult result{BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES,
+                                                            {action_plan[index].spec()}};
+                    results[dependent] = SpecSummary{action_plan[dependent].spec(), result, "not started", 0};
+                    cone.push_back(dependent);
+                    stack.push_back(dependent);
+                }
+            }
+
+            if (cone.empty()) return;
+            const std::string names =
+                Strings::join(", ", cone, [&](const size_t i) { return action_plan[i].spec().to_string(); });
+            System::println(System::Color::warning,
+                            "The packages which need %s are not built: %s",
+                            action_plan[failed].spec(),
+                            names);
+            for (const size_t index : cone)
+            {
+                release_dependents(index);
+            }
+        };
+
+        // Called with scheduler_mutex held
+        const auto complete = [&](const size_t index, Build::ExtendedBuildResult result, const ElapsedTime& timer) {
+            running.erase(index);
+            const bool failed = result.code != BuildResult::SUCCEEDED && result.code != BuildResult::NULLVALUE;
+            results[index] =
+                SpecSummary{action_plan[index].spec(), std::move(result), timer.to_string(), timer.microseconds()};
+
+            // The dependents are marked first, so that none of them becomes ready when the failed package is released
+            if (failed) cascade_from(index);
+            release_dependents(index);
+            update_status_line();
+            scheduler_cv.notify_all();
+        };
+
+        // A build slot is free again once the portfile has run. The post-build checks and the installation are left
+        // to the installer, so that the next build overlaps with them even when there is a single slot.
+        const auto worker = [&]() {
+            std::unique_lock<std::mutex> lock(scheduler_mutex);
+            for (;;)
+            {
+                scheduler_cv.wait(lock, [&]() {
+                    return find_admissible() != ready.end() || finished_count == package_count;
+                });
+                const auto admissible = find_admissible();
+                if (admissible == ready.end()) return;
+
+                const size_t index = *admissible;
+                ready.erase(admissible);
+                const size_t counter = ++started_count;
+                running.insert(index);
+                memory_in_use += build_memory[index];
+                update_status_line();
+                lock.unlock();
+
+                const AnyAction& action = action_plan[index];
+                const std::string display_name = action.spec().to_string();
+                System::println("Starting package %d/%d: %s", counter, package_count, display_name);
+                const ElapsedTime package_timer = ElapsedTime::create_started();
+
+                if (const auto install_action = action.install_plan.get())
+                {
+                    // The output of the build appears in one piece once the portfile has run
+                    Build::StartedBuild started;
+                    {
+                        const System::BufferedOutput build_output;
+                        started = start_install_plan_action(
+                            paths, *install_action, build_options, status_db, status_db_mutex);
+                    }
+
+                    lock.lock();
+                    memory_in_use -= build_memory[index];
+                    pending_installs.push_back({index, std::move(started), package_timer});
+                    scheduler_cv.notify_all();
+                    continue;
+                }
+
+                Build::ExtendedBuildResult result;
+                {
+                    const System::BufferedOutput package_output;
+                    result = perform_action(paths, action, build_options, keep_going, status_db, status_db_mutex);
+                    System::println("Elapsed time for package %s: %s", display_name, package_timer.to_string());
+                }
+
+                lock.lock();
+                complete(index, std::move(result), package_timer);
+            }
+        };
+
+        // Packages are installed one at a time anyway, since installing locks the installed tree
+        const auto installer = [&]() {
+            std::unique_lock<std::mutex> lock(scheduler_mutex);
+            for (;;)
+            {
+                scheduler_cv.wait(lock, [&]() { return !pending_installs.empty() || finished_count == package_count; });
+                if (pending_installs.empty()) return;
+
+                PendingInstall pending = std::move(pending_installs.front());
+                pending_installs.pop_front();
+                lock.unlock();
+
+                const InstallPlanAction& action = *action_plan[pending.index].install_plan.get();
+                Build::ExtendedBuildResult result;
+                {
+                    const System::BufferedOutput install_output;
+                    result = finish_install_plan_action(
+                        paths, action, build_options, std::move(pending.started), status_db, status_db_mutex);
+                    exit_if_failed(result, action.spec, keep_going);
+                    System::println(
+                        "Elapsed time for package %s: %s", action.spec, pending.package_timer.to_string());
+                }
+
+                lock.lock();
+                complete(pending.index, std::move(result), pending.package_timer);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.emplace_back(installer);
+        for (size_t i = 0; i < worker_count; ++i)
+            workers.emplace_back(worker);
+        for (auto&& t : workers)
+            t.join();
+        System::set_status_line(std::string());
+    }
+
+    void InstallSummary::print() const
+    {
+        for (auto&& result : this->results)
+        {
+            System::println("%s: %s: %s", result.spec, Build::to_string(result.build_result.code), result.timing);
+        }
+
+        std::map<BuildResult, int> summary;
+        for (const BuildResult& v : Build::BUILD_RESULT_VALUES)
+        {
+            summary[v] = 0;
+        }
+
+        for (auto&& result : this->results)
+        {
+            summary[result.build_result.code]++;
+        }
+
+        System::println("\n\nSUMMARY");
+        for (const std::pair<const BuildResult, int>& entry : summary)
+        {
+            System::println("    %s: %d", Build::to_string(entry.first), entry.second);
+        }
+    }
+
+    std::string InstallSummary::to_json() const
+    {
+        const auto to_json_microseconds = [](const double microseconds) {
+            return std::to_string(static_cast<long long>(microseconds));
+        };
+
+        const std::string packages = Strings::join(",\n", this->results, [&](const SpecSummary& result) {
+            const std::string phases =
+                Strings::join(",", result.build_result.phase_timings, [&](const Build::PhaseTiming& timing) {
+                    return Strings::to_json_string(timing.phase) + ":" + to_json_microseconds(timing.microseconds);
+                });
+
+            std::string resources;
+            if (const auto usage = result.build_result.resource_usage.get())
+            {
+                resources = Strings::format(
+                    R"(,"resources":{"cpu_us":%s,"peak_memory_bytes":%s,"read_bytes":%s,"write_bytes":%s,)"
+                    R"("processes":%s})",
+                    to_json_microseconds(usage->cpu_microseconds),
+                    std::to_string(usage->peak_memory_bytes),
+                    std::to_string(usage->read_bytes),
+                    std::to_string(usage->write_bytes),
+                    std::to_string(usage->process_count));
+            }
+
+            // The packages which were cascaded name the ones they were missing, which together form the pruned graph
+            std::string missing;
+            if (!result.build_result.unmet_dependencies.empty())
+            {
+                const std::string specs = Strings::join(",", result.build_result.unmet_dependencies, [](auto&& spec) {
+                    return Strings::to_json_string(spec.to_string());
+                });
+                missing = R"(,"missing_dependencies":[)" + specs + "]";
+            }
+
+            return Strings::format(
+                R"(    {"spec":%s,"result":%s,"elapsed_us":%s,"binary_cache":%s,"phases_us":{%s}%s%s})",
+                Strings::to_json_string(result.spec.to_string()),
+                Strings::to_json_string(Build::to_string(result.build_result.code)),
+                to_json_microseconds(result.microseconds),
+                Strings::to_json_string(Build::to_string(result.build_result.binary_cache_status)),
+                phases,
+                resources,
+                missing);
+        });
+
+        return Strings::format("{\n  \"total_elapsed_us\": %s,\n  \"packages\": [\n%s\n  ]\n}\n",
+                               to_json_microseconds(this->total_microseconds),
+                               packages);
+    }
+
+    static void place_with_dependencies(const size_t index,
+                                        const std::vector<std::vector<size_t>>& dependencies,
+                                        std::vector<bool>& placed,
+                                        std::vector<size_t>& order)
+    {
+        if (placed[index]) return;
+        placed[index] = true;
+
+        // The dependencies keep their plan order among themselves
+        std::vector<size_t> sorted_dependencies = dependencies[index];
+        std::sort(sorted_dependencies.begin(), sorted_dependencies.end());
+        for (const size_t dependency : sorted_dependencies)
+            place_with_dependencies(dependency, dependencies, placed, order);
+        order.push_back(index);
+    }
+
+    std::vector<size_t> order_by_requests(const std::vector<std::vector<size_t>>& dependencies,
+                                          const std::vector<size_t>& requested)
+    {
+        std::vector<bool> placed(dependencies.size());
+        std::vector<size_t> order;
+        order.reserve(dependencies.size());
+        for (const size_t index : requested)
+            place_with_dependencies(index, dependencies, placed, order);
+        for (size_t i = 0; i < dependencies.size(); ++i)
+        {
+            if (!placed[i]) order.push_back(i);
+        }
+        return order;
+    }
+
+    /// <summary>
+    /// Puts the plan in the order of order_by_requests, with the specs requested on the command line
+    /// </summary>
+    static std::vector<AnyAction> order_plan_by_requests(std::vector<AnyAction> action_plan,
+                                                         const std::vector<FullPackageSpec>& specs)
+    {
+        std::vector<size_t> requested;
+        for (auto&& spec : specs)
+        {
+            for (size_t i = action_plan.size(); i-- > 0;)
+            {
+                if (action_plan[i].install_plan.get() && action_plan[i].spec() == spec.package_spec)
+                {
+                    requested.push_back(i);
+                    break;
+                }
+            }
+        }
+
+        const std::vector<size_t> order = order_by_requests(get_action_plan_dependencies(action_plan), requested);
+        std::vector<AnyAction> ordered_plan;
+        ordered_plan.reserve(action_plan.size());
+        for (const size_t index : order)
+            ordered_plan.push_back(std::move(action_plan[index]));
+        return ordered_plan;
+    }
+
+    size_t parse_jobs(const ParsedArguments& parsed_arguments, const std::string& option_jobs)
+    {
+        const auto it_jobs = parsed_arguments.settings.find(option_jobs);
+        if (it_jobs == parsed_arguments.settings.cend())
+        {
+            return 1;
+        }
+
+        const int parsed_jobs = atoi(it_jobs->second.c_str());
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           parsed_jobs > 0,
+                           "Error: %s must be a positive number of jobs, but was '%s'",
+                           option_jobs,
+                           it_jobs->second);
+        // In background mode no more ports build at once than there are cores left to them
+        size_t jobs = static_cast<size_t>(parsed_jobs);
+        const size_t cores = System::get_build_core_count();
+        if (GlobalState::background && cores != 0) jobs = std::min(jobs, cores);
+        ThreadPool::set_max_threads(jobs);
+        return jobs;
+    }
+
+    static const SourceParagraph& get_source_paragraph(const InstallPlanAction& install_action)
+    {
+        const AnyParagraph& any_paragraph = install_action.any_paragraph;
+        if (const auto p_scf = any_paragraph.source_control_file.get()) return *(*p_scf)->core_paragraph;
+        return *any_paragraph.source_paragraph.value_or_exit(VCPKG_LINE_INFO);
+    }
+
+    /// <summary>
+    /// Pads each column of the rows to its widest cell
+    /// </summary>
+    static std::string format_table(const std::vector<std::vector<std::string>>& rows)
+    {
+        std::vector<size_t> widths;
+        for (auto&& row : rows)
+        {
+            widths.resize(std::max(widths.size(), row.size()));
+            for (size_t column = 0; column < row.size(); ++column)
+                widths[column] = std::max(widths[column], row[column].size());
+        }
+
+        std::string table;
+        for (auto&& row : rows)
+        {
+            std::string line = "   ";
+            for (size_t column = 0; column < row.size(); ++column)
+            {
+                line.append(" ").append(row[column]);
+                if (column + 1 < row.size()) line.append(widths[column] - row[column].size() + 1, ' ');
+            }
+            table.append(line).append("\n");
+        }
+        return table;
+    }
+
+    void print_plan_estimate(const std::vector<AnyAction>& action_plan,
+                             const Build::BuildPackageOptions& install_plan_options,
+                             const PlanOrder plan_order,
+                             const size_t jobs,
+                             const VcpkgPaths& paths,
+                             const StatusParagraphs& status_db)
+    {
+        auto& fs = paths.get_filesystem();
+        std::vector<double> durations = estimate_durations(action_plan, Build::BuildTimes::load(paths));
+
+        // Only a package with an ABI tag can come from a binary cache
+        std::vector<Optional<std::string>> abi_tags(action_plan.size());
+        if (GlobalState::binary_caching)
+        {
+            abi_tags = compute_planned_abis(action_plan, install_plan_options, paths, status_db);
+        }
+
+        std::vector<std::string> sources(action_plan.size());
+        std::vector<size_t> remote_indices;
+        std::vector<std::string> remote_abi_tags;
+        size_t local_hits = 0;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            const auto install_action = action_plan[i].install_plan.get();
+            if (install_action == nullptr || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            sources[i] = "build";
+            const auto abi = abi_tags[i].get();
+            if (abi == nullptr) continue;
+            if (fs.exists(Build::get_archive_path(paths, *abi)))
+            {
+                sources[i] = "local binary cache";
+                durations[i] = 0;
+                ++local_hits;
+                continue;
+            }
+            remote_indices.push_back(i);
+            remote_abi_tags.push_back(*abi);
+        }
+
+        size_t remote_hits = 0;
+        size_t remote_unknown = 0;
+        const std::vector<Optional<bool>> found = BinaryCaching::check_sources(paths, remote_abi_tags);
+        for (size_t k = 0; k < remote_indices.size(); ++k)
+        {
+            const size_t i = remote_indices[k];
+            if (!found[k].has_value())
+            {
+                // Counted as a build, which is what it costs when the source does not have it after all
+                sources[i] = "build, unless a remote binary cache has it";
+                ++remote_unknown;
+            }
+            else if (*found[k].get())
+            {
+                sources[i] = "remote binary cache";
+                durations[i] = 0;
+                ++remote_hits;
+            }
+        }
+
+        // The distfiles which the builds need and which are not downloaded yet, each counted once
+        const bool knows_distfiles =
+            to_bool(install_plan_options.allow_downloads) && !to_bool(install_plan_options.use_head_version);
+        std::unordered_set<std::string> seen_hashes;
+        uint64_t download_bytes = 0;
+        size_t download_count = 0;
+        size_t unknown_size_count = 0;
+        std::vector<std::vector<std::string>> rows;
+        size_t build_count = 0;
+        double build_microseconds = 0;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            if (sources[i].empty()) continue;
+
+            std::string downloads;
+            if (durations[i] != 0)
+            {
+                ++build_count;
+                build_microseconds += durations[i];
+
+                uint64_t bytes = 0;
+                size_t unknown_sizes = 0;
+                const auto& install_action = action_plan[i].install_plan.value_or_exit(VCPKG_LINE_INFO);
+                const std::vector<Build::Distfile> distfiles =
+                    knows_distfiles ? Build::load_distfiles(paths, get_source_paragraph(install_action))
+                                    : std::vector<Build::Distfile>();
+                for (auto&& distfile : distfiles)
+                {
+                    if (fs.exists(paths.downloads / distfile.filename)) continue;
+                    if (!seen_hashes.insert(distfile.sha512).second) continue;
+                    ++download_count;
+                    if (const auto size = distfile.size.get())
+                        bytes += *size;
+                    else
+                        ++unknown_sizes;
+                }
+                download_bytes += bytes;
+                unknown_size_count += unknown_sizes;
+                if (bytes != 0) downloads = GarbageCollect::format_size(bytes) + " to download";
+                if (unknown_sizes != 0)
+                {
+                    downloads += Strings::format(
+                        "%s%d files of unknown size to download", downloads.empty() ? "" : " and ", unknown_sizes);
+                }
+            }
+
+            rows.push_back({action_plan[i].spec().to_string(),
+                            durations[i] != 0 ? format_microseconds(durations[i]) : "-",
+                            sources[i],
+                            downloads});
+        }
+
+        if (rows.empty())
+        {
+            System::println("Nothing in the plan has to be built");
+            return;
+        }
+
+        System::println("Expected cost of the packages to be built:\n%s", format_table(rows));
+        System::println(
+            "%d builds, expected to take %s one after another", build_count, format_microseconds(build_microseconds));
+        if (GlobalState::binary_caching)
+        {
+            System::println("%d packages from the local binary cache, %d from remote binary caches%s",
+                            local_hits,
+                            remote_hits,
+                            remote_unknown != 0 ? Strings::format(" and %d which may be", remote_unknown) : "");
+        }
+        if (knows_distfiles)
+        {
+            System::println("%s to download in %d distfiles%s",
+                            GarbageCollect::format_size(download_bytes),
+                            download_count,
+                            unknown_size_count != 0 ? Strings::format(", %d of unknown size", unknown_size_count) : "");
+        }
+
+        const std::vector<std::vector<size_t>> dependencies = get_action_plan_dependencies(action_plan);
+        const std::vector<std::vector<size_t>> dependents = get_dependents(dependencies);
+        const std::vector<double> critical_paths = get_critical_paths(durations, dependents);
+        const std::vector<size_t> ranks = get_request_ranks(action_plan, plan_order);
+        const size_t worker_count = std::max<size_t>(1, std::min(jobs, action_plan.size()));
+        const ByPriority priority{&ranks, &critical_paths};
+        const double wall_microseconds =
+            estimate_plan_microseconds(durations, dependencies, dependents, priority, worker_count);
+        const double longest_chain = *std::max_element(critical_paths.cbegin(), critical_paths.cend());
+        System::println("Estimated time with %d jobs: %s; the longest chain of builds takes %s",
+                        worker_count,
+                        format_microseconds(wall_microseconds),
+                        format_microseconds(longest_chain));
+    }
+
+    void write_json_report_if_requested(const VcpkgPaths& paths,
+                                        const ParsedArguments& parsed_arguments,
+                                        const std::string& option_json_report,
+                                        const InstallSummary& summary)
+    {
+        const auto it_report = parsed_arguments.settings.find(option_json_report);
+        if (it_report == parsed_arguments.settings.cend()) return;
+
+        paths.get_filesystem().write_contents(it_report->second, summary.to_json());
+        System::println("Wrote the install report to %s", it_report->second);
+    }
+
+    InstallSummary perform(const std::vector<AnyAction>& action_plan,
+                           const Build::BuildPackageOptions& install_plan_options,
+                           const KeepGoing keep_going,
+                           const size_t jobs,
+                           const VcpkgPaths& paths,
+                           StatusParagraphs& status_db,
+                           const PlanOrder plan_order)
+    {
+        const size_t package_count = action_plan.size();
+        InstallSummary summary;
+        summary.results.resize(package_count);
+        const ElapsedTime timer = ElapsedTime::create_started();
+
+        // A plan of packages which are all installed does nothing, so nothing is prefetched, estimated or collected
+        const bool is_installed = std::all_of(action_plan.cbegin(), action_plan.cend(), [](const AnyAction& action) {
+            const auto install_action = action.install_plan.get();
+            return install_action && install_action->plan_type == InstallPlanType::ALREADY_INSTALLED;
+        });
+        if (is_installed)
+        {
+            for (size_t i = 0; i < package_count; ++i)
+            {
+                summary.results[i] = SpecSummary{action_plan[i].spec(), {BuildResult::SUCCEEDED, {}}, "installed", 0};
+            }
+            summary.total_elapsed_time = timer.to_string();
+            summary.total_microseconds = timer.microseconds();
+            return summary;
+        }
+
+        prefetch_binary_packages(action_plan, install_plan_options, paths, status_db);
+        prefetch_distfiles(action_plan, install_plan_options, paths);
+        prepare_msys(action_plan, install_plan_options, paths);
+
+        Build::BuildTimes build_times = Build::BuildTimes::load(paths);
+        const std::vector<double> estimated_durations = estimate_durations(action_plan, build_times);
+        // A single job still overlaps each build with the installation of the previous package
+        if (jobs > 1 || package_count > 1)
+        {
+            perform_actions_in_parallel(action_plan,
+                                        install_plan_options,
+                                        keep_going,
+                                        jobs,
+                                        paths,
+                                        status_db,
+                                        estimated_durations,
+                                        build_times,
+                                        plan_order,
+                                        summary.results);
+        }
+        else
+        {
+            const double estimated_microseconds =
+                std::accumulate(estimated_durations.cbegin(), estimated_durations.cend(), 0.0);
+            if (estimated_microseconds > 0)
+            {
+                System::println("Estimated time: %s", format_microseconds(estimated_microseconds));
+            }
+
+            std::mutex status_db_mutex;
+            for (size_t i = 0; i < package_count; ++i)
+            {
+                const ElapsedTime build_timer = ElapsedTime::create_started();
+
+                const std::string display_name = action_plan[i].spec().to_string();
+                System::println("Starting package %d/%d: %s", i + 1, package_count, display_name);
+
+                Build::ExtendedBuildResult result =
+                    perform_action(paths, action_plan[i], install_plan_options, keep_going, status_db, status_db_mutex);
+
+                summary.results[i] = SpecSummary{
+                    action_plan[i].spec(), std::move(result), build_timer.to_string(), build_timer.microseconds()};
+                System::println("Elapsed time for package %s: %s", display_name, summary.results[i].timing);
+            }
+        }
+
+        BinaryCaching::wait_for_uploads();
+
+        // The builds which succeeded this time are what the next plan is estimated and admitted with
+        bool recorded_build_times = false;
+        for (auto&& result : summary.results)
+        {
+            if (result.build_result.code != BuildResult::SUCCEEDED) continue;
+            for (auto&& timing : result.build_result.phase_timings)
+            {
+                if (timing.phase != "build") continue;
+                build_times.record(result.spec, timing.microseconds);
+                recorded_build_times = true;
+            }
+            if (const auto usage = result.build_result.resource_usage.get())
+            {
+                build_times.record_peak_memory(result.spec, static_cast<size_t>(usage->peak_memory_bytes >> 20));
+            }
+        }
+        if (recorded_build_times) build_times.save(paths);
+
+        GarbageCollect::collect_if_over_budget(paths, action_plan);
+
+        summary.total_elapsed_time = timer.to_string();
+        summary.total_microseconds = timer.microseconds();
+        System::println("Total time taken: %s", summary.total_elapsed_time);
+        return summary;
+    }
+
+    void perform_and_exit(const std::vector<AnyAction>& action_plan,
+                          const Build::BuildPackageOptions& install_plan_options,
+                          const KeepGoing keep_going,
+                          const PrintSummary print_summary,
+                          const size_t jobs,
+                          const VcpkgPaths& paths,
+                          StatusParagraphs& status_db)
+    {
+        const InstallSummary summary = perform(action_plan, install_plan_options, keep_going, jobs, paths, status_db);
+
+        if (print_summary == PrintSummary::YES)
+        {
+            summary.print();
+        }
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+
+    /// <summary>
+    /// Carries out the plan on an overlay of the real filesystem, which finds the file conflicts an install would run
+    /// into without writing anything. Only packages which are already in the packages directory can be checked; the
+    /// files of the others are not known before they are built.
+    /// </summary>
+    static void simulate_and_exit(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan)
+    {
+        const std::shared_ptr<Files::Filesystem> overlay = Files::make_overlay_filesystem(paths.get_filesystem());
+        VcpkgPaths what_if_paths = VcpkgPaths::create(paths.root, *overlay).value_or_exit(VCPKG_LINE_INFO);
+        what_if_paths.buildtrees = paths.buildtrees;
+        what_if_paths.packages = paths.packages;
+        what_if_paths.downloads = paths.downloads;
+        StatusParagraphs status_db = database_load_check(what_if_paths);
+
+        std::vector<std::string> not_built;
+        size_t conflicts = 0;
+        for (auto&& action : action_plan)
+        {
+            if (const auto remove_action = action.remove_plan.get())
+            {
+                if (remove_action->plan_type == RemovePlanType::REMOVE)
+                {
+                    Remove::remove_package(what_if_paths, remove_action->spec, &status_db);
+                }
+                continue;
+            }
+
+            const InstallPlanAction& install_action = action.install_plan.value_or_exit(VCPKG_LINE_INFO);
+            if (install_action.plan_type == InstallPlanType::ALREADY_INSTALLED) continue;
+
+            const Expected<BinaryControlFile> maybe_bcf =
+                Paragraphs::try_load_cached_control_package(what_if_paths, install_action.spec);
+            const auto bcf = maybe_bcf.get();
+            if (!bcf)
+            {
+                not_built.push_back(install_action.spec.to_string());
+                continue;
+            }
+
+            if (install_package(what_if_paths, *bcf, &status_db) == InstallResult::FILE_CONFLICTS) ++conflicts;
+        }
+
+        if (!not_built.empty())
+        {
+            System::println(System::Color::warning,
+                            "The following packages have not been built yet, so their files were not checked:\n    %s",
+                            Strings::join("\n    ", not_built));
+        }
+
+        if (conflicts != 0)
+        {
+            System::println(System::Color::error, "%d packages would conflict with installed files", conflicts);
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+
+        System::println(System::Color::success, "No file conflicts found");
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+
+    /// <summary>
+    /// Installs the packages which are already in the packages directory, as vcpkg build leaves them, instead of
+    /// building them again. The others are built as usual.
+    /// </summary>
+    static void use_built_packages(const VcpkgPaths& paths, std::vector<AnyAction>& action_plan)
+    {
+        for (auto&& action : action_plan)
+        {
+            const auto install_action = action.install_plan.get();
+            if (!install_action || install_action->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            Expected<BinaryControlFile> maybe_bcf =
+                Paragraphs::try_load_cached_control_package(paths, install_action->spec);
+            if (const auto bcf = maybe_bcf.get())
+            {
+                install_action->any_paragraph.binary_control_file = std::move(*bcf);
+                install_action->plan_type = InstallPlanType::INSTALL;
+            }
+        }
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
+    {
+        static const std::string OPTION_DRY_RUN = "--dry-run";
+        static const std::string OPTION_WHAT_IF = "--what-if";
+        static const std::string OPTION_USE_HEAD_VERSION = "--head";
+        static const std::string OPTION_NO_DOWNLOADS = "--no-downloads";
+        static const std::string OPTION_RECURSE = "--recurse";
+        static const std::string OPTION_KEEP_GOING = "--keep-going";
+        static const std::string OPTION_JOBS = "--jobs";
+        static const std::string OPTION_JSON_REPORT = "--json-report";
+        static const std::string OPTION_REQUESTED_FIRST = "--requested-first";
+        static const std::string OPTION_USE_PACKAGES = "--x-use-packages";
+
+        // input sanitization
+        static const std::string EXAMPLE =
+            Commands::Help::create_example_string("install zlib zlib:x64-windows curl boost");
+        args.check_min_arg_count(1, EXAMPLE);
+
+        const std::vector<FullPackageSpec> specs = Util::fmap(args.command_arguments, [&](auto&& arg) {
             return Input::check_and_get_full_package_spec(arg, default_triplet, EXAMPLE);
         });
 
@@ -549,35 +2215,54 @@ namespace vcpkg::Commands::Install
             }
         }
 
-        const std::unordered_set<std::string> options = args.check_and_get_optional_command_arguments(
-            {OPTION_DRY_RUN, OPTION_USE_HEAD_VERSION, OPTION_NO_DOWNLOADS, OPTION_RECURSE, OPTION_KEEP_GOING});
+        const ParsedArguments parsed_arguments = args.check_and_get_optional_command_arguments(
+            {OPTION_DRY_RUN,
+             OPTION_WHAT_IF,
+             OPTION_USE_HEAD_VERSION,
+             OPTION_NO_DOWNLOADS,
+             OPTION_RECURSE,
+             OPTION_KEEP_GOING,
+             OPTION_REQUESTED_FIRST,
+             OPTION_USE_PACKAGES},
+            {OPTION_JOBS, OPTION_JSON_REPORT});
+        const std::unordered_set<std::string>& options = parsed_arguments.switches;
         const bool dry_run = options.find(OPTION_DRY_RUN) != options.cend();
+        const bool what_if = options.find(OPTION_WHAT_IF) != options.cend();
         const bool use_head_version = options.find(OPTION_USE_HEAD_VERSION) != options.cend();
         const bool no_downloads = options.find(OPTION_NO_DOWNLOADS) != options.cend();
         const bool is_recursive = options.find(OPTION_RECURSE) != options.cend();
         const KeepGoing keep_going = to_keep_going(options.find(OPTION_KEEP_GOING) != options.cend());
+        const PlanOrder plan_order = to_plan_order(options.find(OPTION_REQUESTED_FIRST) != options.cend());
+        const bool use_packages = options.find(OPTION_USE_PACKAGES) != options.cend();
+
+        const size_t jobs = parse_jobs(parsed_arguments, OPTION_JOBS);
+
+        // The builds need these, which are probed while the status database loads and the plan is computed. Packages
+        // which are already built need none of them.
+        if (!dry_run && !what_if && !use_packages)
+        {
+            std::vector<Triplet> triplets = Util::fmap(specs, [](auto&& spec) { return spec.package_spec.triplet(); });
+            Build::start_warm_up(paths, {LazyTool::CMAKE, LazyTool::GIT, LazyTool::TOOLSETS}, std::move(triplets));
+        }
 
         // create the plan
         StatusParagraphs status_db = database_load_check(paths);
 
         const Build::BuildPackageOptions install_plan_options = {Build::to_use_head_version(use_head_version),
-                                                                 Build::to_allow_downloads(!no_downloads)};
+                                                                 Build::to_allow_downloads(!no_downloads),
+                                                                 Build::IncrementalBuild::NO,
+                                                                 0};
 
         std::vector<AnyAction> action_plan;
 
+        Dependencies::PathsPortFile paths_port_file(paths);
         if (GlobalState::feature_packages)
         {
-            std::unordered_map<std::string, SourceControlFile> scf_map;
-            auto all_ports = Paragraphs::try_load_all_ports(paths.get_filesystem(), paths.ports);
-            for (auto&& port : all_ports.paragraphs)
-            {
-                scf_map[port->core_paragraph->name] = std::move(*port);
-            }
-            action_plan = create_feature_install_plan(scf_map, FullPackageSpec::to_feature_specs(specs), status_db);
+            action_plan =
+                create_feature_install_plan(paths_port_file, FullPackageSpec::to_feature_specs(specs), status_db);
         }
         else
         {
-            Dependencies::PathsPortFile paths_port_file(paths);
             auto install_plan = Dependencies::create_install_plan(
                 paths_port_file, Util::fmap(specs, [](auto&& spec) { return spec.package_spec; }), status_db);
 
@@ -588,6 +2273,13 @@ namespace vcpkg::Commands::Install
         // install plan will be empty if it is already installed - need to change this at status paragraph part
         Checks::check_exit(VCPKG_LINE_INFO, !action_plan.empty(), "Install plan cannot be empty");
 
+        if (plan_order == PlanOrder::REQUESTED_FIRST)
+        {
+            action_plan = order_plan_by_requests(std::move(action_plan), specs);
+        }
+
+        if (use_packages) use_built_packages(paths, action_plan);
+
         // log the plan
         const std::string specs_string = Strings::join(",", action_plan, [](const AnyAction& action) {
             if (auto iaction = action.install_plan.get())
@@ -603,10 +2295,18 @@ namespace vcpkg::Commands::Install
 
         if (dry_run)
         {
+            print_plan_estimate(action_plan, install_plan_options, plan_order, jobs, paths, status_db);
             Checks::exit_success(VCPKG_LINE_INFO);
         }
 
-        perform_and_exit(action_plan, install_plan_options, keep_going, PrintSummary::NO, paths, status_db);
+        if (what_if)
+        {
+            simulate_and_exit(paths, action_plan);
+        }
+
+        const InstallSummary summary =
+            perform(action_plan, install_plan_options, keep_going, jobs, paths, status_db, plan_order);
+        write_json_report_if_requested(paths, parsed_arguments, OPTION_JSON_REPORT, summary);
 
         Checks::exit_success(VCPKG_LINE_INFO);
     }
@@ -3,6 +3,7 @@
 #include "vcpkg_Checks.h"
 #include "vcpkg_Commands.h"
 #include "vcpkg_Files.h"
+#include "vcpkg_Nupkg.h"
 #include "vcpkg_System.h"
 #include "vcpkg_Util.h"
 
@@ -78,31 +79,11 @@ namespace vcpkg::Commands::Integrate
         return nuget_id;
     }
 
-    static std::string create_nuspec_file_contents(const fs::path& vcpkg_root_dir,
-                                                   const std::string& nuget_id,
-                                                   const std::string& nupkg_version)
+    static std::string create_nuget_description(const fs::path& vcpkg_root_dir)
     {
-        static constexpr auto CONTENT_TEMPLATE = R"(
-<package>
-    <metadata>
-        <id>@NUGET_ID@</id>
-        <version>@VERSION@</version>
-        <authors>vcpkg</authors>
-        <description>
-            This package imports all libraries currently installed in @VCPKG_DIR@. This package does not contain any libraries and instead refers to the folder directly (like a symlink).
-        </description>
-    </metadata>
-    <files>
-        <file src="vcpkg.nuget.props" target="build\native\@NUGET_ID@.props" />
-        <file src="vcpkg.nuget.targets" target="build\native\@NUGET_ID@.targets" />
-    </files>
-</package>
-)";
-
-        std::string content = std::regex_replace(CONTENT_TEMPLATE, std::regex("@NUGET_ID@"), nuget_id);
-        content = std::regex_replace(content, std::regex("@VCPKG_DIR@"), vcpkg_root_dir.string());
-        content = std::regex_replace(content, std::regex("@VERSION@"), nupkg_version);
-        return content;
+        return Strings::format("This package imports all libraries currently installed in %s. This package does not "
+                               "contain any libraries and instead refers to the folder directly (like a symlink).",
+                               vcpkg_root_dir.string());
     }
 
     enum class ElevationPromptChoice
@@ -265,39 +246,28 @@ namespace vcpkg::Commands::Integrate
     {
         auto& fs = paths.get_filesystem();
 
-        const fs::path& nuget_exe = paths.get_nuget_exe();
-
         const fs::path& buildsystems_dir = paths.buildsystems;
-        const fs::path tmp_dir = buildsystems_dir / "tmp";
         std::error_code ec;
         fs.create_directory(buildsystems_dir, ec);
-        fs.create_directory(tmp_dir, ec);
 
-        const fs::path targets_file_path = tmp_dir / "vcpkg.nuget.targets";
-        const fs::path props_file_path = tmp_dir / "vcpkg.nuget.props";
-        const fs::path nuspec_file_path = tmp_dir / "vcpkg.nuget.nuspec";
         const std::string nuget_id = get_nuget_id(paths.root);
         const std::string nupkg_version = "1.0.0";
-
-        fs.write_contents(targets_file_path, create_nuget_targets_file_contents(paths.buildsystems_msbuild_targets));
-        fs.write_contents(props_file_path, create_nuget_props_file_contents());
-        fs.write_contents(nuspec_file_path, create_nuspec_file_contents(paths.root, nuget_id, nupkg_version));
-
-        // Using all forward slashes for the command line
-        const std::wstring cmd_line = Strings::wformat(LR"("%s" pack -OutputDirectory "%s" "%s" > nul)",
-                                                       nuget_exe.native(),
-                                                       buildsystems_dir.native(),
-                                                       nuspec_file_path.native());
-
-        const int exit_code = System::cmd_execute_clean(cmd_line);
-
         const fs::path nuget_package = buildsystems_dir / Strings::format("%s.%s.nupkg", nuget_id, nupkg_version);
+
+        std::vector<Zip::Entry> files;
+        files.push_back(
+            {Strings::format("build/native/%s.props", nuget_id), fs::path(), create_nuget_props_file_contents()});
+        files.push_back({Strings::format("build/native/%s.targets", nuget_id),
+                         fs::path(),
+                         create_nuget_targets_file_contents(paths.buildsystems_msbuild_targets)});
+        const auto written = Nupkg::write(
+            fs, nuget_package, {nuget_id, nupkg_version, create_nuget_description(paths.root)}, std::move(files));
         Checks::check_exit(
-            VCPKG_LINE_INFO, exit_code == 0 && fs.exists(nuget_package), "Error: NuGet package creation failed");
+            VCPKG_LINE_INFO, written.has_value(), "Error: NuGet package creation failed: %s", written.error());
         System::println(System::Color::success, "Created nupkg: %s", nuget_package.string());
 
         auto source_path = buildsystems_dir.u8string();
-        source_path = std::regex_replace(source_path, std::regex("`"), "``");
+        source_path = Strings::replace_all(std::move(source_path), "`", "``");
 
         System::println(R"(
 With a project open, go to Tools->NuGet Package Manager->Package Manager Console and paste:
@@ -309,6 +279,69 @@ With a project open, go to Tools->NuGet Package Manager->Package Manager Console
         Checks::exit_success(VCPKG_LINE_INFO);
     }
 
+    /// <summary>
+    /// Escapes the characters which are special within a quoted CMake argument
+    /// </summary>
+    static std::string escape_cmake(const std::string& s)
+    {
+        std::string escaped = Strings::replace_all(std::string(s), "\\", "\\\\");
+        escaped = Strings::replace_all(std::move(escaped), "\"", "\\\"");
+        return Strings::replace_all(std::move(escaped), "$", "\\$");
+    }
+
+    static const std::string TOOLCHAIN_SNAPSHOT_VERSION = "1";
+
+    void write_toolchain_snapshot(const VcpkgPaths& paths, const StatusParagraphs& status_db, const Triplet& triplet)
+    {
+        auto& fs = paths.get_filesystem();
+        const std::string& triplet_name = triplet.canonical_name();
+
+        // The tool directories are written relative to the installed tree, so that the root can be moved
+        std::vector<std::string> tools_dirs;
+        for (auto&& entry : fs.get_entries_non_recursive(paths.installed / triplet_name / "tools"))
+        {
+            if (!fs::is_directory(entry.status)) continue;
+            tools_dirs.push_back(triplet_name + "/tools/" + entry.path.filename().u8string());
+        }
+        std::sort(tools_dirs.begin(), tools_dirs.end());
+
+        std::vector<std::string> packages;
+        for (auto&& pgh : status_db)
+        {
+            if (pgh->state != InstallState::INSTALLED || !pgh->package.feature.empty()) continue;
+            if (pgh->package.spec.triplet() != triplet) continue;
+            packages.push_back(pgh->package.spec.name());
+        }
+        std::sort(packages.begin(), packages.end());
+
+        std::vector<std::string> lines = {
+            "# Generated by vcpkg install and vcpkg remove. Do not edit.",
+            "set(_VCPKG_SNAPSHOT_VERSION " + TOOLCHAIN_SNAPSHOT_VERSION + ")",
+            "set(_VCPKG_SNAPSHOT_TOOLS_DIRS",
+        };
+        for (auto&& dir : tools_dirs)
+        {
+            lines.push_back("    \"${_VCPKG_INSTALLED_DIR}/" + escape_cmake(dir) + '"');
+        }
+        lines.push_back(")");
+        lines.push_back("set(VCPKG_INSTALLED_PACKAGES");
+        for (auto&& package : packages)
+        {
+            lines.push_back("    \"" + escape_cmake(package) + '"');
+        }
+        lines.push_back(")");
+
+        // A configure may read the snapshot while it is written, so it is replaced rather than rewritten
+        const fs::path snapshot_path = paths.toolchain_snapshot_path(triplet);
+        std::error_code ec;
+        fs.create_directories(snapshot_path.parent_path(), ec);
+        const fs::path tmp_path = snapshot_path.parent_path() / (snapshot_path.filename().u8string() + ".tmp" +
+                                                                 std::to_string(GetCurrentProcessId()));
+        fs.write_lines(tmp_path, lines);
+        fs.rename(tmp_path, snapshot_path, ec);
+        if (ec) fs.remove(tmp_path, ec);
+    }
+
     const char* const INTEGRATE_COMMAND_HELPSTRING =
         "  vcpkg integrate install         Make installed packages available user-wide. Requires admin privileges on "
         "first use\n"
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "vcpkg_Commands.h"
+#include "vcpkg_RecordWriter.h"
 #include "vcpkg_System.h"
 #include "vcpkglib.h"
 
@@ -23,16 +24,53 @@ namespace vcpkg::Commands::List
         }
     }
 
+    /// <summary>
+    /// Prints the installed packages in the order of the status database, as they are read from it
+    /// </summary>
+    static void write_records(const StatusParagraphs& status_db,
+                              const RecordWriter::Format format,
+                              const Optional<std::string>& filter_text)
+    {
+        const Strings::CaseInsensitiveAsciiSearcher filter(filter_text.value_or(Strings::EMPTY));
+        RecordWriter writer(format, {"package", "name", "feature", "triplet", "version", "description"});
+        for (const StatusParagraph* pgh : status_db)
+        {
+            if (pgh->state != InstallState::INSTALLED || pgh->want != Want::INSTALL) continue;
+
+            const BinaryParagraph& package = pgh->package;
+            const std::string displayname = package.displayname();
+            if (filter_text.has_value() && !filter.contains(displayname)) continue;
+
+            writer.write({displayname,
+                          package.spec.name(),
+                          package.feature,
+                          package.spec.triplet().canonical_name(),
+                          package.version,
+                          package.description});
+        }
+        writer.finish();
+    }
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
     {
         static const std::string EXAMPLE = Strings::format(
             "The argument should be a substring to search for, or no argument to display all installed libraries.\n%s",
             Commands::Help::create_example_string("list png"));
         args.check_max_arg_count(1, EXAMPLE);
-        const std::unordered_set<std::string> options =
-            args.check_and_get_optional_command_arguments({OPTION_FULLDESC});
+        const ParsedArguments parsed_arguments =
+            args.check_and_get_optional_command_arguments({OPTION_FULLDESC}, {OPTION_FORMAT});
+        const std::unordered_set<std::string>& options = parsed_arguments.switches;
 
         const StatusParagraphs status_paragraphs = database_load_check(paths);
+        const Optional<RecordWriter::Format> format = RecordWriter::get_format(parsed_arguments);
+        if (const auto p = format.get())
+        {
+            write_records(status_paragraphs,
+                          *p,
+                          args.command_arguments.empty() ? nullopt : Optional<std::string>(args.command_arguments[0]));
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
         std::vector<StatusParagraph*> installed_packages = get_installed_ports(status_paragraphs);
 
         if (installed_packages.empty())
@@ -57,10 +95,11 @@ namespace vcpkg::Commands::List
         else
         {
             // At this point there is 1 argument
+            const Strings::CaseInsensitiveAsciiSearcher filter(args.command_arguments[0]);
             for (const StatusParagraph* status_paragraph : installed_packages)
             {
                 const std::string displayname = status_paragraph->package.displayname();
-                if (Strings::case_insensitive_ascii_find(displayname, args.command_arguments[0]) == displayname.end())
+                if (!filter.contains(displayname))
                 {
                     continue;
                 }
@@ -0,0 +1,104 @@
+#include "pch.h"
+
+#include "vcpkg_BuildLogs.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Input.h"
+#include "vcpkg_PackageArchive.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+
+namespace vcpkg::Commands::Logs
+{
+    static const std::string OPTION_PHASE = "--phase";
+    static const std::string OPTION_GREP = "--grep";
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
+    {
+        static const std::string EXAMPLE = Commands::Help::create_example_string(
+            "x-logs zlib:x64-windows --phase=build --grep=warning");
+        args.check_exact_arg_count(1, EXAMPLE);
+        const ParsedArguments parsed_arguments =
+            args.check_and_get_optional_command_arguments({}, {OPTION_PHASE, OPTION_GREP});
+        const PackageSpec spec = Input::check_and_get_package_spec(args.command_arguments[0], default_triplet, EXAMPLE);
+        Input::check_triplet(spec.triplet(), paths);
+
+        const fs::path archive = BuildLogs::get_archive_path(paths, spec);
+        if (!paths.get_filesystem().exists(archive))
+        {
+            System::println(System::Color::error, "There are no logs of a build of %s", spec.to_string());
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+
+        const auto maybe_entries = PackageArchive::read_table(archive);
+        const auto entries = maybe_entries.get();
+        if (!entries) Checks::exit_with_message(VCPKG_LINE_INFO, maybe_entries.error());
+
+        // A phase selects the logs whose names start with it, so "config" selects both configurations
+        std::vector<PackageArchive::Entry> logs = *entries;
+        const auto it_phase = parsed_arguments.settings.find(OPTION_PHASE);
+        if (it_phase != parsed_arguments.settings.cend())
+        {
+            const std::string& phase = it_phase->second;
+            logs.erase(std::remove_if(logs.begin(),
+                                      logs.end(),
+                                      [&](const PackageArchive::Entry& log) {
+                                          return log.is_directory || log.path.compare(0, phase.size(), phase) != 0;
+                                      }),
+                       logs.end());
+        }
+
+        const auto it_grep = parsed_arguments.settings.find(OPTION_GREP);
+        if (it_phase == parsed_arguments.settings.cend() && it_grep == parsed_arguments.settings.cend())
+        {
+            for (auto&& log : logs)
+            {
+                System::println("%-48s %s", log.path, GarbageCollect::format_size(log.size));
+            }
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        Optional<std::regex> pattern;
+        if (it_grep != parsed_arguments.settings.cend())
+        {
+            try
+            {
+                pattern = std::regex(it_grep->second);
+            }
+            catch (const std::regex_error& e)
+            {
+                System::println(System::Color::error,
+                                "Error: %s is not a valid regular expression: %s",
+                                it_grep->second,
+                                e.what());
+                Checks::exit_fail(VCPKG_LINE_INFO);
+            }
+        }
+
+        // Each log is decompressed on its own, so printing one phase does not read the others
+        for (auto&& log : logs)
+        {
+            const auto maybe_contents = PackageArchive::read_file(archive, log.path);
+            const auto contents = maybe_contents.get();
+            if (!contents) Checks::exit_with_message(VCPKG_LINE_INFO, maybe_contents.error());
+
+            const auto p_pattern = pattern.get();
+            if (!p_pattern)
+            {
+                System::println(System::Color::success, "==> %s", log.path);
+                System::print(*contents);
+                if (!contents->empty() && contents->back() != '\n') System::println();
+                continue;
+            }
+
+            int line_number = 0;
+            for (std::string& line : Strings::split(*contents, "\n"))
+            {
+                ++line_number;
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (std::regex_search(line, *p_pattern)) System::println("%s:%d: %s", log.path, line_number, line);
+            }
+        }
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
@@ -1,26 +1,50 @@
 #include "pch.h"
 
 #include "vcpkg_Commands.h"
+#include "vcpkg_RecordWriter.h"
 #include "vcpkg_System.h"
 #include "vcpkglib.h"
 
 namespace vcpkg::Commands::Owns
 {
-    static void search_file(const VcpkgPaths& paths, const std::string& file_substr, const StatusParagraphs& status_db)
+    static void search_file(const VcpkgPaths& paths,
+                            const std::string& file_substr,
+                            const StatusParagraphs& status_db,
+                            const Optional<RecordWriter::Format>& format)
     {
-        const std::vector<StatusParagraphAndAssociatedFiles> installed_files = get_installed_files(paths, status_db);
-        for (const StatusParagraphAndAssociatedFiles& pgh_and_file : installed_files)
+        std::vector<Triplet> triplets;
+        for (const StatusParagraph* pgh : status_db)
         {
-            const StatusParagraph& pgh = pgh_and_file.pgh;
+            if (pgh->state != InstallState::INSTALLED) continue;
+            const Triplet& triplet = pgh->package.spec.triplet();
+            if (std::find(triplets.cbegin(), triplets.cend(), triplet) == triplets.cend()) triplets.push_back(triplet);
+        }
+
+        // Matches are written as they are found in the index of each triplet
+        std::unique_ptr<RecordWriter> writer;
+        if (const auto p = format.get())
+        {
+            writer = std::make_unique<RecordWriter>(*p, std::vector<std::string>{"package", "triplet", "file"});
+        }
 
-            for (const std::string& file : pgh_and_file.files)
+        // One buffer for all the paths, which would otherwise each be allocated only to be searched
+        std::string file;
+        for (const Triplet& triplet : triplets)
+        {
+            const InstalledFileOwners file_owners = InstalledFileOwners::load(paths, status_db, triplet);
+            for (const InstalledFileOwners::Entry& entry : file_owners.entries())
             {
-                if (file.find(file_substr) != std::string::npos)
-                {
-                    System::println("%s: %s", pgh.package.displayname(), file);
-                }
+                file.assign(triplet.canonical_name()).append(1, '/').append(entry.file);
+                if (file.find(file_substr) == std::string::npos) continue;
+
+                if (writer)
+                    writer->write({entry.owner, triplet.canonical_name(), file});
+                else
+                    System::println("%s[core]:%s: %s", entry.owner, triplet, file);
             }
         }
+
+        if (writer) writer->finish();
     }
 
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
@@ -28,10 +52,10 @@ namespace vcpkg::Commands::Owns
         static const std::string EXAMPLE = Strings::format("The argument should be a pattern to search for. %s",
                                                            Commands::Help::create_example_string("owns zlib.dll"));
         args.check_exact_arg_count(1, EXAMPLE);
-        args.check_and_get_optional_command_arguments({});
+        const ParsedArguments parsed_arguments = args.check_and_get_optional_command_arguments({}, {OPTION_FORMAT});
 
         StatusParagraphs status_db = database_load_check(paths);
-        search_file(paths, args.command_arguments[0], status_db);
+        search_file(paths, args.command_arguments[0], status_db, RecordWriter::get_format(parsed_arguments));
         Checks::exit_success(VCPKG_LINE_INFO);
     }
 }
@@ -0,0 +1,54 @@
+#include "pch.h"
+
+#include "coff_file_reader.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+
+namespace vcpkg::Commands::PdbPaths
+{
+    void perform_and_exit(const VcpkgCmdArguments& args)
+    {
+        static const std::string EXAMPLE =
+            Commands::Help::create_example_string(R"###(pdbpaths packages\zlib_x64-windows\bin <dll>...)###");
+        args.check_min_arg_count(1, EXAMPLE);
+        args.check_and_get_optional_command_arguments({});
+
+        auto& fs = Files::get_real_filesystem();
+
+        // Directories stand for the DLLs below them, which keeps the command line short for ports with many DLLs
+        std::vector<fs::path> dlls;
+        for (auto&& argument : args.command_arguments)
+        {
+            const fs::path path = Strings::to_utf16(argument);
+            if (!fs.is_directory(path))
+            {
+                dlls.push_back(path);
+                continue;
+            }
+
+            for (auto&& entry : fs.get_entries_recursive(path))
+            {
+                if (Strings::case_insensitive_ascii_compare(entry.path.extension().u8string(), ".dll") == 0 &&
+                    !fs::is_directory(entry.status))
+                {
+                    dlls.push_back(entry.path);
+                }
+            }
+        }
+
+        std::vector<std::string> pdb_paths(dlls.size());
+        Util::parallel_for_each_index(
+            dlls.size(), [&](const size_t i) { pdb_paths[i] = CoffFileReader::read_dll(dlls[i]).pdb_path; });
+
+        // One line per DLL, <dll>|<pdb>; the PDB is empty if the DLL has none and '|' cannot appear in a path
+        for (size_t i = 0; i < dlls.size(); ++i)
+        {
+            System::println("%s|%s", dlls[i].generic_u8string(), pdb_paths[i]);
+        }
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
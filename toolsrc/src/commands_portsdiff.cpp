@@ -5,6 +5,7 @@
 #include "vcpkg_Commands.h"
 #include "vcpkg_Maps.h"
 #include "vcpkg_System.h"
+#include "vcpkg_Util.h"
 
 namespace vcpkg::Commands::PortsDiff
 {
@@ -72,34 +73,126 @@ namespace vcpkg::Commands::PortsDiff
         }
     }
 
-    static std::map<std::string, VersionT> read_ports_from_commit(const VcpkgPaths& paths,
-                                                                  const std::wstring& git_commit_id)
+    /// <summary>
+    /// Maps the name of each port directory in the commit to the object id of its CONTROL file
+    /// </summary>
+    static std::map<std::string, std::string> read_control_blobs_from_commit(const VcpkgPaths& paths,
+                                                                             const std::wstring& git_commit_id)
     {
-        std::error_code ec;
-        auto& fs = paths.get_filesystem();
         const fs::path& git_exe = paths.get_git_exe();
         const fs::path dot_git_dir = paths.root / ".git";
         const std::wstring ports_dir_name_as_string = paths.ports.filename().native();
-        const fs::path temp_checkout_path =
-            paths.root / Strings::wformat(L"%s-%s", ports_dir_name_as_string, git_commit_id);
-        fs.create_directory(temp_checkout_path, ec);
-        const std::wstring checkout_this_dir =
-            Strings::wformat(LR"(.\%s)", ports_dir_name_as_string); // Must be relative to the root of the repository
-
-        const std::wstring cmd =
-            Strings::wformat(LR"("%s" --git-dir="%s" --work-tree="%s" checkout %s -f -q -- %s %s & "%s" reset >NUL)",
-                             git_exe.native(),
-                             dot_git_dir.native(),
-                             temp_checkout_path.native(),
-                             git_commit_id,
-                             checkout_this_dir,
-                             L".vcpkg-root",
-                             git_exe.native());
-        System::cmd_execute_clean(cmd);
-        const std::map<std::string, VersionT> names_and_versions = Paragraphs::load_all_port_names_and_versions(
-            paths.get_filesystem(), temp_checkout_path / ports_dir_name_as_string);
-        fs.remove_all(temp_checkout_path, ec);
-        return names_and_versions;
+
+        const std::wstring cmd = Strings::wformat(LR"("%s" --git-dir="%s" ls-tree -r --full-tree %s -- %s)",
+                                                  git_exe.native(),
+                                                  dot_git_dir.native(),
+                                                  git_commit_id,
+                                                  ports_dir_name_as_string);
+        const System::ExitCodeAndOutput output = System::cmd_execute_and_capture_output(cmd);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           output.exit_code == 0,
+                           "Failed to list the ports of commit %s:\n%s",
+                           Strings::to_utf8(git_commit_id),
+                           output.output);
+
+        // Each line is "<mode> <type> <object>\t<path>"; only ports/<name>/CONTROL is of interest
+        const std::string ports_prefix = Strings::to_utf8(ports_dir_name_as_string) + "/";
+        static const std::string CONTROL_SUFFIX = "/CONTROL";
+
+        std::map<std::string, std::string> control_blobs;
+        for (auto&& line : Strings::split(output.output, "\n"))
+        {
+            const size_t tab = line.find('\t');
+            if (tab == std::string::npos) continue;
+
+            const std::vector<std::string> fields = Strings::split(line.substr(0, tab), " ");
+            if (fields.size() != 3 || fields[1] != "blob") continue;
+
+            const std::string path = line.substr(tab + 1);
+            if (path.size() <= ports_prefix.size() + CONTROL_SUFFIX.size()) continue;
+            if (path.compare(0, ports_prefix.size(), ports_prefix) != 0) continue;
+            if (path.compare(path.size() - CONTROL_SUFFIX.size(), CONTROL_SUFFIX.size(), CONTROL_SUFFIX) != 0) continue;
+
+            const std::string port_name =
+                path.substr(ports_prefix.size(), path.size() - ports_prefix.size() - CONTROL_SUFFIX.size());
+            if (port_name.find('/') != std::string::npos) continue;
+
+            control_blobs.emplace(port_name, fields[2]);
+        }
+
+        return control_blobs;
+    }
+
+    /// <summary>
+    /// Reads the contents of the objects with a single git process, keyed by object id
+    /// </summary>
+    static std::map<std::string, std::string> read_blobs(const VcpkgPaths& paths,
+                                                         const std::vector<std::string>& object_ids)
+    {
+        if (object_ids.empty()) return {};
+
+        auto& fs = paths.get_filesystem();
+        const fs::path& git_exe = paths.get_git_exe();
+        const fs::path dot_git_dir = paths.root / ".git";
+
+        // cat-file --batch reads the object ids from its standard input
+        const fs::path object_ids_path = paths.root / "portsdiff-objects.txt";
+        fs.write_contents(object_ids_path, Strings::join("\n", object_ids) + "\n");
+
+        const std::wstring cmd = Strings::wformat(LR"(cmd.exe /c ""%s" --git-dir="%s" cat-file --batch < "%s" 2>NUL")",
+                                                  git_exe.native(),
+                                                  dot_git_dir.native(),
+                                                  object_ids_path.native());
+
+        // The output is read as is, since the sizes in the headers count the bytes of each object exactly. Errors are
+        // discarded so that they cannot be mistaken for contents.
+        std::string output;
+        auto maybe_process = System::Process::start(
+            cmd, std::wstring(), [&](const char* data, size_t size) { output.append(data, size); });
+        const auto process = maybe_process.get();
+        const int exit_code = process == nullptr ? 1 : process->wait();
+
+        std::error_code ec;
+        fs.remove(object_ids_path, ec);
+
+        Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Failed to read the CONTROL files from git");
+
+        // Each object is "<object> blob <size>\n<contents>\n", or "<object> missing\n"
+        std::map<std::string, std::string> blobs;
+        size_t position = 0;
+        while (position < output.size())
+        {
+            const size_t header_end = output.find('\n', position);
+            if (header_end == std::string::npos) break;
+
+            const std::vector<std::string> header =
+                Strings::split(output.substr(position, header_end - position), " ");
+            position = header_end + 1;
+            if (header.size() != 3) continue;
+
+            const size_t size = std::stoull(header[2]);
+            Checks::check_exit(VCPKG_LINE_INFO, position + size <= output.size(), "Unexpected end of git output");
+            blobs.emplace(header[0], output.substr(position, size));
+            position += size + 1;
+        }
+
+        return blobs;
+    }
+
+    static VersionT parse_name_and_version(const std::string& control_file_contents, std::string* name)
+    {
+        auto pghs = Paragraphs::parse_paragraphs(control_file_contents);
+        Checks::check_exit(VCPKG_LINE_INFO, pghs.get() != nullptr, "Failed to parse a CONTROL file from git");
+
+        auto maybe_control_file = SourceControlFile::parse_control_file(std::move(*pghs.get()));
+        if (const auto control_file = maybe_control_file.get())
+        {
+            *name = (*control_file)->core_paragraph->name;
+            return (*control_file)->core_paragraph->version;
+        }
+
+        print_error_message(maybe_control_file.error());
+        Checks::exit_fail(VCPKG_LINE_INFO);
     }
 
     static void check_commit_exists(const fs::path& git_exe, const std::wstring& git_commit_id)
@@ -132,10 +225,55 @@ namespace vcpkg::Commands::PortsDiff
         check_commit_exists(git_exe, git_commit_id_for_current_snapshot);
         check_commit_exists(git_exe, git_commit_id_for_previous_snapshot);
 
-        const std::map<std::string, VersionT> current_names_and_versions =
-            read_ports_from_commit(paths, git_commit_id_for_current_snapshot);
-        const std::map<std::string, VersionT> previous_names_and_versions =
-            read_ports_from_commit(paths, git_commit_id_for_previous_snapshot);
+        // The trees are read from the object store, so nothing is checked out, and both commits are listed at once
+        std::map<std::string, std::string> current_blobs;
+        std::map<std::string, std::string> previous_blobs;
+        Util::parallel_for_each_index(2, [&](const size_t i) {
+            if (i == 0)
+                current_blobs = read_control_blobs_from_commit(paths, git_commit_id_for_current_snapshot);
+            else
+                previous_blobs = read_control_blobs_from_commit(paths, git_commit_id_for_previous_snapshot);
+        });
+
+        // A port whose CONTROL file is the same object in both commits is unchanged, so it is neither read nor parsed
+        for (auto it = current_blobs.begin(); it != current_blobs.end();)
+        {
+            const auto previous = previous_blobs.find(it->first);
+            if (previous != previous_blobs.end() && previous->second == it->second)
+            {
+                previous_blobs.erase(previous);
+                it = current_blobs.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        std::set<std::string> object_ids;
+        for (auto&& blob : current_blobs)
+            object_ids.insert(blob.second);
+        for (auto&& blob : previous_blobs)
+            object_ids.insert(blob.second);
+
+        const std::map<std::string, std::string> control_files =
+            read_blobs(paths, std::vector<std::string>(object_ids.cbegin(), object_ids.cend()));
+        const auto to_names_and_versions = [&](const std::map<std::string, std::string>& blobs) {
+            std::map<std::string, VersionT> names_and_versions;
+            for (auto&& blob : blobs)
+            {
+                const auto control_file = control_files.find(blob.second);
+                if (control_file == control_files.cend()) continue;
+
+                std::string name;
+                VersionT version = parse_name_and_version(control_file->second, &name);
+                names_and_versions.emplace(std::move(name), std::move(version));
+            }
+            return names_and_versions;
+        };
+
+        const std::map<std::string, VersionT> current_names_and_versions = to_names_and_versions(current_blobs);
+        const std::map<std::string, VersionT> previous_names_and_versions = to_names_and_versions(previous_blobs);
 
         // Already sorted, so set_difference can work on std::vector too
         const std::vector<std::string> current_ports = Maps::extract_keys(current_names_and_versions);
@@ -1,8 +1,10 @@
 #include "pch.h"
 
 #include "vcpkg_Commands.h"
+#include "vcpkg_ContentStore.h"
 #include "vcpkg_Dependencies.h"
 #include "vcpkg_Input.h"
+#include "vcpkg_Listfile.h"
 #include "vcpkg_System.h"
 #include "vcpkg_Util.h"
 #include "vcpkglib.h"
@@ -14,90 +16,300 @@ namespace vcpkg::Commands::Remove
     using Dependencies::RequestType;
     using Update::OutdatedPackage;
 
-    void remove_package(const VcpkgPaths& paths, const PackageSpec& spec, StatusParagraphs* status_db)
+    static void print_aggregated(const System::Color color, const char* header, const std::vector<std::string>& items)
     {
-        auto& fs = paths.get_filesystem();
-        auto spghs = status_db->find_all(spec.name(), spec.triplet());
-        const auto core_pkg = **status_db->find(spec.name(), spec.triplet(), Strings::EMPTY);
+        if (items.empty()) return;
+
+        System::println(color, header, items.size());
+        System::println("    %s", Strings::join("\n    ", items));
+    }
 
-        for (auto&& spgh : spghs)
+    void remove_listed_files(Files::Filesystem& fs,
+                             const fs::path& installed_dir,
+                             const std::vector<std::string>& listfile_lines)
+    {
+
+        std::vector<fs::path> dirs_touched;
+        std::vector<fs::path> candidates;
+        for (auto&& line : listfile_lines)
         {
-            StatusParagraph& pkg = **spgh;
-            if (pkg.state != InstallState::INSTALLED) continue;
-            pkg.want = Want::PURGE;
-            pkg.state = InstallState::HALF_INSTALLED;
-            write_update(paths, pkg);
+            std::string suffix = line;
+            if (!suffix.empty() && suffix.back() == '\r') suffix.pop_back();
+            if (suffix.empty()) continue;
+
+            // Directories end in a slash; listfiles in the old format are resolved with status() below
+            if (suffix.back() == '/')
+            {
+                suffix.pop_back();
+                dirs_touched.push_back(installed_dir / suffix);
+            }
+            else
+            {
+                candidates.push_back(installed_dir / suffix);
+            }
         }
 
-        auto maybe_lines = fs.read_lines(paths.listfile_path(core_pkg.package));
+        enum class Outcome
+        {
+            REMOVED,
+            DIRECTORY,
+            FAILED,
+            UNKNOWN_STATUS,
+            UNSUPPORTED_TYPE,
+        };
+
+        struct Result
+        {
+            Outcome outcome = Outcome::REMOVED;
+            std::error_code ec;
+        };
+
+        std::vector<Result> results(candidates.size());
+        Util::parallel_for_each_index(candidates.size(), [&](const size_t i) {
+            const fs::path& target = candidates[i];
+            Result& result = results[i];
+
+            const auto status = fs.status(target, result.ec);
+            if (result.ec)
+                result.outcome = Outcome::FAILED;
+            else if (fs::is_directory(status))
+                result.outcome = Outcome::DIRECTORY;
+            else if (fs::is_regular_file(status))
+            {
+                fs.remove(target, result.ec);
+                if (result.ec) result.outcome = Outcome::FAILED;
+            }
+            else if (!fs::status_known(status))
+                result.outcome = Outcome::UNKNOWN_STATUS;
+            else
+                result.outcome = Outcome::UNSUPPORTED_TYPE;
+        });
+
+        std::vector<std::string> failed;
+        std::vector<std::string> unknown_status;
+        std::vector<std::string> unsupported_type;
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            const fs::path& target = candidates[i];
+            switch (results[i].outcome)
+            {
+                case Outcome::REMOVED: break;
+                case Outcome::DIRECTORY: dirs_touched.push_back(target); break;
+                case Outcome::FAILED:
+                    failed.push_back(Strings::format("%s: %s", target.u8string(), results[i].ec.message()));
+                    break;
+                case Outcome::UNKNOWN_STATUS: unknown_status.push_back(target.u8string()); break;
+                case Outcome::UNSUPPORTED_TYPE: unsupported_type.push_back(target.u8string()); break;
+                default: Checks::unreachable(VCPKG_LINE_INFO);
+            }
+        }
 
-        if (const auto lines = maybe_lines.get())
+        // Reverse lexicographic order visits every directory before its parent, and several packages may share one
+        std::sort(dirs_touched.begin(), dirs_touched.end(), std::greater<fs::path>());
+        dirs_touched.erase(std::unique(dirs_touched.begin(), dirs_touched.end()), dirs_touched.end());
+        for (auto&& dir : dirs_touched)
         {
-            std::vector<fs::path> dirs_touched;
-            for (auto&& suffix : *lines)
+            if (!fs.exists(dir) || !fs.is_empty(dir)) continue;
+
+            std::error_code ec;
+            fs.remove(dir, ec);
+            if (ec)
             {
-                if (!suffix.empty() && suffix.back() == '\r') suffix.pop_back();
+                failed.push_back(Strings::format("%s: %s", dir.u8string(), ec.message()));
+            }
+        }
 
-                std::error_code ec;
+        print_aggregated(System::Color::error, "Failed to remove %d paths:", failed);
+        print_aggregated(System::Color::warning, "Warning: %d paths have an unknown status:", unknown_status);
+        print_aggregated(
+            System::Color::warning, "Warning: %d paths have a file type that cannot be handled:", unsupported_type);
+    }
 
-                auto target = paths.installed / suffix;
+    static bool starts_with(const std::string& s, const std::string& prefix)
+    {
+        return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+    }
 
-                const auto status = fs.status(target, ec);
-                if (ec)
+    /// <summary>
+    /// Moves the directories which hold nothing but the listed entries into the trash, one rename each, and returns
+    /// the lines which are left to remove one by one. A directory qualifies when no other package owns a file in it
+    /// and nothing else was put there; the triplet directories themselves are always kept.
+    /// </summary>
+    static std::vector<std::string> trash_whole_directories(
+        const VcpkgPaths& paths,
+        const std::vector<PackageSpec>& specs,
+        const std::vector<std::pair<Triplet, InstalledFileOwners>>& file_owners,
+        std::vector<std::string> listfile_lines)
+    {
+        auto& fs = paths.get_filesystem();
+        for (auto&& line : listfile_lines)
+        {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+        }
+        Util::erase_remove_if(listfile_lines, [](const std::string& line) { return line.empty(); });
+        std::sort(listfile_lines.begin(), listfile_lines.end());
+        const std::unordered_set<std::string> listed(listfile_lines.cbegin(), listfile_lines.cend());
+
+        const auto is_owned_by_others = [&](const std::string& directory_line) {
+            const size_t slash = directory_line.find('/');
+            const std::string triplet = directory_line.substr(0, slash);
+            const std::string prefix = directory_line.substr(slash + 1);
+            for (auto&& owners : file_owners)
+            {
+                if (owners.first.to_string() != triplet) continue;
+
+                const auto& entries = owners.second.entries();
+                auto it = std::lower_bound(entries.cbegin(),
+                                           entries.cend(),
+                                           prefix,
+                                           [](const InstalledFileOwners::Entry& entry, const std::string& file) {
+                                               return entry.file < file;
+                                           });
+                for (; it != entries.cend() && starts_with(it->file, prefix); ++it)
                 {
-                    System::println(System::Color::error, "failed: %s", ec.message());
-                    continue;
+                    const bool is_removed = Util::find_if(specs, [&](const PackageSpec& spec) {
+                                                return spec.name() == it->owner && spec.triplet() == owners.first;
+                                            }) != specs.cend();
+                    if (!is_removed) return true;
                 }
+                return false;
+            }
+            return true;
+        };
 
-                if (fs::is_directory(status))
-                {
-                    dirs_touched.push_back(target);
-                }
-                else if (fs::is_regular_file(status))
-                {
-                    fs.remove(target, ec);
-                    if (ec)
-                    {
-                        System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
-                    }
-                }
-                else if (!fs::status_known(status))
-                {
-                    System::println(System::Color::warning, "Warning: unknown status: %s", target.u8string());
-                }
-                else
-                {
-                    System::println(System::Color::warning, "Warning: %s: cannot handle file type", target.u8string());
-                }
+        // Enumerating costs one call per directory, while deleting costs at least one per file
+        const size_t installed_prefix_length = paths.installed.native().size();
+        const auto has_unlisted_entries = [&](const fs::path& directory) {
+            for (auto&& entry : fs.get_entries_recursive(directory))
+            {
+                std::string line = Files::generic_u8_suffix(entry.path, installed_prefix_length);
+                if (fs::is_directory(entry.status)) line.push_back('/');
+                if (listed.find(line) == listed.cend()) return true;
             }
+            return false;
+        };
 
-            auto b = dirs_touched.rbegin();
-            const auto e = dirs_touched.rend();
-            for (; b != e; ++b)
+        std::vector<std::string> remaining;
+        std::string trashed;
+        for (auto&& line : listfile_lines)
+        {
+            // Sorting puts the contents of a directory right after it
+            if (!trashed.empty() && starts_with(line, trashed)) continue;
+
+            if (line.back() == '/' && std::count(line.cbegin(), line.cend(), '/') > 1 && !is_owned_by_others(line))
             {
-                if (fs.is_empty(*b))
+                const fs::path directory = paths.installed / line.substr(0, line.size() - 1);
+                if (!has_unlisted_entries(directory))
                 {
-                    std::error_code ec;
-                    fs.remove(*b, ec);
-                    if (ec)
-                    {
-                        System::println(System::Color::error, "failed: %s", ec.message());
-                    }
+                    move_to_trash(paths, directory);
+                    trashed = line;
+                    continue;
                 }
             }
 
-            fs.remove(paths.listfile_path(core_pkg.package));
+            remaining.push_back(line);
         }
+        return remaining;
+    }
+
+    void remove_packages(const VcpkgPaths& paths, const std::vector<PackageSpec>& specs, StatusParagraphs* status_db)
+    {
+        const InstalledTreeLock tree_lock(paths);
+        auto& fs = paths.get_filesystem();
 
-        for (auto&& spgh : spghs)
+        // Loaded while the packages are still installed so that the indexes match the status database
+        std::vector<std::pair<Triplet, InstalledFileOwners>> file_owners;
+        for (auto&& spec : specs)
         {
-            StatusParagraph& pkg = **spgh;
-            if (pkg.state != InstallState::HALF_INSTALLED) continue;
-            pkg.state = InstallState::NOT_INSTALLED;
-            write_update(paths, pkg);
+            const auto it = Util::find_if(file_owners, [&](auto&& owners) { return owners.first == spec.triplet(); });
+            if (it == file_owners.cend())
+            {
+                file_owners.emplace_back(spec.triplet(), InstalledFileOwners::load(paths, *status_db, spec.triplet()));
+            }
+        }
+
+        std::vector<std::vector<StatusParagraph*>> spghs_of_specs;
+        std::vector<std::string> listfile_lines;
+        std::vector<fs::path> listfiles;
+        std::vector<std::string> store_keys;
+        for (auto&& spec : specs)
+        {
+            auto spghs = status_db->find_all(spec.name(), spec.triplet());
+            const auto core_pkg = **status_db->find(spec.name(), spec.triplet(), Strings::EMPTY);
+
+            for (auto&& spgh : spghs)
+            {
+                StatusParagraph& pkg = *spgh;
+                if (pkg.state != InstallState::INSTALLED) continue;
+                pkg.want = Want::PURGE;
+                pkg.state = InstallState::HALF_INSTALLED;
+                write_update(paths, pkg);
+            }
+
+            const fs::path listfile = paths.listfile_path(core_pkg.package);
+            auto maybe_lines = fs.read_lines(listfile);
+            if (const auto lines = maybe_lines.get())
+            {
+                listfile_lines.insert(listfile_lines.end(), lines->begin(), lines->end());
+                listfiles.push_back(listfile);
+            }
+            for (auto&& link : ContentStore::read_links(fs, listfile))
+            {
+                store_keys.push_back(link.key);
+            }
+
+            spghs_of_specs.push_back(std::move(spghs));
+        }
+
+        // The store entries are released by counting the links left to them, which the trash would still hold
+        if (store_keys.empty())
+        {
+            listfile_lines = trash_whole_directories(paths, specs, file_owners, std::move(listfile_lines));
+        }
+        remove_listed_files(fs, paths.installed, listfile_lines);
+        ContentStore::release(fs, ContentStore::store_dir(paths.installed), store_keys);
+
+        for (auto&& listfile : listfiles)
+        {
+            fs.remove(listfile);
+            std::error_code ec;
+            fs.remove(Listfile::binary_listfile_path(listfile), ec);
+            fs.remove(ContentStore::links_path(listfile), ec);
+        }
+
+        for (auto&& spghs : spghs_of_specs)
+        {
+            for (auto&& spgh : spghs)
+            {
+                StatusParagraph& pkg = *spgh;
+                if (pkg.state != InstallState::HALF_INSTALLED) continue;
+                pkg.state = InstallState::NOT_INSTALLED;
+                write_update(paths, pkg);
+            }
+        }
+
+        for (auto&& owners : file_owners)
+        {
+            for (auto&& spec : specs)
+            {
+                if (spec.triplet() != owners.first) continue;
+                owners.second.remove_package(spec.name());
+
+                std::error_code ec;
+                fs.remove(paths.link_manifest_path(spec, false), ec);
+                fs.remove(paths.link_manifest_path(spec, true), ec);
+            }
+            owners.second.save(paths);
+            Commands::AppLocal::invalidate_dependents_cache(paths, owners.first);
+            Commands::Integrate::write_toolchain_snapshot(paths, *status_db, owners.first);
         }
     }
 
+    void remove_package(const VcpkgPaths& paths, const PackageSpec& spec, StatusParagraphs* status_db)
+    {
+        remove_packages(paths, {spec}, status_db);
+    }
+
     static void print_plan(const std::map<RemovePlanType, std::vector<const RemovePlanAction*>>& group_by_plan_type)
     {
         static constexpr std::array<RemovePlanType, 2> ORDER = {RemovePlanType::NOT_INSTALLED, RemovePlanType::REMOVE};
@@ -142,6 +354,12 @@ namespace vcpkg::Commands::Remove
                 System::println(System::Color::success, "Package %s is not installed", display_name);
                 break;
             case RemovePlanType::REMOVE:
+                // Another vcpkg process may have removed it since the plan was made
+                if (status_db.find_installed(action.spec) == status_db.end())
+                {
+                    System::println(System::Color::success, "Package %s is not installed", display_name);
+                    break;
+                }
                 System::println("Removing package %s... ", display_name);
                 remove_package(paths, action.spec, &status_db);
                 System::println(System::Color::success, "Removing package %s... done", display_name);
@@ -153,9 +371,7 @@ namespace vcpkg::Commands::Remove
         if (purge == Purge::YES)
         {
             System::println("Purging package %s... ", display_name);
-            Files::Filesystem& fs = paths.get_filesystem();
-            std::error_code ec;
-            fs.remove_all(paths.packages / action.spec.dir(), ec);
+            move_to_trash(paths, paths.packages / action.spec.dir());
             System::println(System::Color::success, "Purging package %s... done", display_name);
         }
     }
@@ -172,6 +388,8 @@ namespace vcpkg::Commands::Remove
         const std::unordered_set<std::string> options = args.check_and_get_optional_command_arguments(
             {OPTION_PURGE, OPTION_NO_PURGE, OPTION_RECURSE, OPTION_DRY_RUN, OPTION_OUTDATED});
 
+        // Held until the end so that the plan stays valid while it is carried out
+        const InstalledTreeLock tree_lock(paths);
         StatusParagraphs status_db = database_load_check(paths);
         std::vector<PackageSpec> specs;
         if (options.find(OPTION_OUTDATED) != options.cend())
@@ -239,9 +457,40 @@ namespace vcpkg::Commands::Remove
             Checks::exit_success(VCPKG_LINE_INFO);
         }
 
+        // The files of all packages are removed in a single batch, which matters for remove --outdated
+        std::vector<PackageSpec> specs_to_remove;
         for (const RemovePlanAction& action : remove_plan)
         {
-            perform_remove_plan_action(paths, action, purge, status_db);
+            switch (action.plan_type)
+            {
+                case RemovePlanType::NOT_INSTALLED:
+                    System::println(System::Color::success, "Package %s is not installed", action.spec.to_string());
+                    break;
+                case RemovePlanType::REMOVE: specs_to_remove.push_back(action.spec); break;
+                case RemovePlanType::UNKNOWN:
+                default: Checks::unreachable(VCPKG_LINE_INFO);
+            }
+        }
+
+        if (!specs_to_remove.empty())
+        {
+            const std::string display_names = Strings::join(", ", specs_to_remove, [](const PackageSpec& spec) {
+                return spec.to_string();
+            });
+            System::println("Removing packages %s... ", display_names);
+            remove_packages(paths, specs_to_remove, &status_db);
+            System::println(System::Color::success, "Removing packages %s... done", display_names);
+        }
+
+        if (purge == Purge::YES)
+        {
+            for (const RemovePlanAction& action : remove_plan)
+            {
+                const std::string display_name = action.spec.to_string();
+                System::println("Purging package %s... ", display_name);
+                move_to_trash(paths, paths.packages / action.spec.dir());
+                System::println(System::Color::success, "Purging package %s... done", display_name);
+            }
         }
 
         Checks::exit_success(VCPKG_LINE_INFO);
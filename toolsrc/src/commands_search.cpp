@@ -78,6 +78,94 @@ namespace vcpkg::Commands::Search
         }
     }
 
+    /// <summary>
+    /// How well a port or feature matches the search term, from best to worst
+    /// </summary>
+    enum class SearchRank
+    {
+        EXACT_NAME,
+        NAME_PREFIX,
+        NAME_WORD_PREFIX,
+        NAME_SUBSTRING,
+        DESCRIPTION_WORD_PREFIX,
+        DESCRIPTION_SUBSTRING,
+        NO_MATCH
+    };
+
+    /// <summary>
+    /// Whether some word of the text, delimited by anything but letters and digits, starts with the term
+    /// </summary>
+    static bool has_word_with_prefix(const std::string& lowercase_text, const std::string& lowercase_term)
+    {
+        for (size_t pos = lowercase_text.find(lowercase_term); pos != std::string::npos;
+             pos = lowercase_text.find(lowercase_term, pos + 1))
+        {
+            if (pos == 0 || !::isalnum(static_cast<unsigned char>(lowercase_text[pos - 1]))) return true;
+        }
+        return false;
+    }
+
+    static SearchRank get_search_rank(const std::string& name,
+                                      const std::string& description,
+                                      const std::string& lowercase_term)
+    {
+        const std::string lowercase_name = Strings::ascii_to_lowercase(name);
+        if (lowercase_name == lowercase_term) return SearchRank::EXACT_NAME;
+        if (lowercase_name.compare(0, lowercase_term.size(), lowercase_term) == 0) return SearchRank::NAME_PREFIX;
+        if (has_word_with_prefix(lowercase_name, lowercase_term)) return SearchRank::NAME_WORD_PREFIX;
+        if (lowercase_name.find(lowercase_term) != std::string::npos) return SearchRank::NAME_SUBSTRING;
+
+        const std::string lowercase_description = Strings::ascii_to_lowercase(description);
+        if (has_word_with_prefix(lowercase_description, lowercase_term)) return SearchRank::DESCRIPTION_WORD_PREFIX;
+        if (lowercase_description.find(lowercase_term) != std::string::npos) return SearchRank::DESCRIPTION_SUBSTRING;
+        return SearchRank::NO_MATCH;
+    }
+
+    struct SearchResult
+    {
+        const SourceControlFile* source_control_file;
+        SearchRank core_rank;
+        std::vector<const FeatureParagraph*> features;
+        SearchRank best_rank;
+    };
+
+    /// <summary>
+    /// The ports whose name, description or features contain the term, best matches first. Ports which match equally
+    /// well keep their alphabetical order.
+    /// </summary>
+    static std::vector<SearchResult> find_matches(
+        const std::vector<std::unique_ptr<SourceControlFile>>& source_paragraphs, const std::string& term)
+    {
+        const std::string lowercase_term = Strings::ascii_to_lowercase(term);
+
+        std::vector<SearchResult> results;
+        for (const auto& source_control_file : source_paragraphs)
+        {
+            const SourceParagraph& sp = *source_control_file->core_paragraph;
+            const SearchRank core_rank = get_search_rank(sp.name, sp.description, lowercase_term);
+            const bool contains_name = core_rank <= SearchRank::NAME_SUBSTRING;
+
+            SearchResult result{source_control_file.get(), core_rank, {}, core_rank};
+            for (auto&& feature_paragraph : source_control_file->feature_paragraphs)
+            {
+                const SearchRank feature_rank =
+                    get_search_rank(feature_paragraph->name, feature_paragraph->description, lowercase_term);
+                if (contains_name || feature_rank != SearchRank::NO_MATCH)
+                {
+                    result.features.push_back(feature_paragraph.get());
+                    result.best_rank = std::min(result.best_rank, feature_rank);
+                }
+            }
+
+            if (result.best_rank != SearchRank::NO_MATCH) results.push_back(std::move(result));
+        }
+
+        std::stable_sort(results.begin(), results.end(), [](const SearchResult& left, const SearchResult& right) {
+            return left.best_rank < right.best_rank;
+        });
+        return results;
+    }
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
     {
         static const std::string EXAMPLE = Strings::format(
@@ -87,7 +175,7 @@ namespace vcpkg::Commands::Search
         const std::unordered_set<std::string> options =
             args.check_and_get_optional_command_arguments({OPTION_GRAPH, OPTION_FULLDESC});
 
-        auto sources_and_errors = Paragraphs::try_load_all_ports(paths.get_filesystem(), paths.ports);
+        auto sources_and_errors = Paragraphs::try_load_all_ports(paths);
 
         if (!sources_and_errors.errors.empty())
         {
@@ -130,27 +218,18 @@ namespace vcpkg::Commands::Search
         }
         else
         {
-            const auto& icontains = Strings::case_insensitive_ascii_contains;
-
             // At this point there is 1 argument
-            auto&& args_zero = args.command_arguments[0];
-            for (const auto& source_control_file : source_paragraphs)
+            for (auto&& result : find_matches(source_paragraphs, args.command_arguments[0]))
             {
-                auto&& sp = *source_control_file->core_paragraph;
-
-                bool contains_name = icontains(sp.name, args_zero);
-                if (contains_name || icontains(sp.description, args_zero))
+                const SourceParagraph& sp = *result.source_control_file->core_paragraph;
+                if (result.core_rank != SearchRank::NO_MATCH)
                 {
                     do_print(sp, options.find(OPTION_FULLDESC) != options.cend());
                 }
 
-                for (auto&& feature_paragraph : source_control_file->feature_paragraphs)
+                for (auto&& feature_paragraph : result.features)
                 {
-                    if (contains_name || icontains(feature_paragraph->name, args_zero) ||
-                        icontains(feature_paragraph->description, args_zero))
-                    {
-                        do_print(sp.name, *feature_paragraph, options.find(OPTION_FULLDESC) != options.cend());
-                    }
+                    do_print(sp.name, *feature_paragraph, options.find(OPTION_FULLDESC) != options.cend());
                 }
             }
         }
@@ -15,7 +15,7 @@ namespace vcpkg::Commands::Update
     std::vector<OutdatedPackage> find_outdated_packages(const VcpkgPaths& paths, const StatusParagraphs& status_db)
     {
         const std::map<std::string, VersionT> src_names_to_versions =
-            Paragraphs::load_all_port_names_and_versions(paths.get_filesystem(), paths.ports);
+            Paragraphs::load_all_port_names_and_versions(paths);
         const std::vector<StatusParagraph*> installed_packages = get_installed_ports(status_db);
 
         std::vector<OutdatedPackage> output;
@@ -63,8 +63,7 @@ namespace vcpkg::Commands::Update
             }
             System::println("\n"
                             "To update these packages, run\n"
-                            "    .\\vcpkg remove --outdated\n"
-                            "    .\\vcpkg install " +
+                            "    .\\vcpkg upgrade " +
                             install_line);
         }
 
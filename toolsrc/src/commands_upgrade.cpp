@@ -0,0 +1,172 @@
+#include "pch.h"
+
+#include "vcpkg_Commands.h"
+#include "vcpkg_Dependencies.h"
+#include "vcpkg_GlobalState.h"
+#include "vcpkg_Input.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+#include "vcpkglib.h"
+
+namespace vcpkg::Commands::Upgrade
+{
+    using Dependencies::AnyAction;
+    using Dependencies::InstallPlanAction;
+    using Dependencies::InstallPlanType;
+    using Update::OutdatedPackage;
+
+    /// <summary>
+    /// A copy of the status database in which the outdated packages are not installed. Planning against it builds
+    /// them in dependency order, along with any dependencies their new versions added.
+    /// </summary>
+    static StatusParagraphs without_packages(const StatusParagraphs& status_db,
+                                             const std::vector<OutdatedPackage>& outdated)
+    {
+        std::vector<StatusParagraph> paragraphs;
+        for (auto&& pgh : status_db)
+        {
+            paragraphs.push_back(*pgh);
+        }
+
+        // The database iterates from the last paragraph, which takes precedence, so the copy is put back in order
+        std::reverse(paragraphs.begin(), paragraphs.end());
+        for (auto&& pgh : paragraphs)
+        {
+            const bool is_outdated = Util::find_if(outdated, [&](const OutdatedPackage& package) {
+                                         return package.spec == pgh.package.spec;
+                                     }) != outdated.cend();
+            if (is_outdated) pgh.state = InstallState::NOT_INSTALLED;
+        }
+
+        return StatusParagraphs(std::move(paragraphs));
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
+    {
+        static const std::string OPTION_DRY_RUN = "--dry-run";
+        static const std::string OPTION_NO_DOWNLOADS = "--no-downloads";
+        static const std::string OPTION_KEEP_GOING = "--keep-going";
+        static const std::string OPTION_JOBS = "--jobs";
+        static const std::string OPTION_JSON_REPORT = "--json-report";
+        static const std::string EXAMPLE = Commands::Help::create_example_string("upgrade zlib curl:x64-windows");
+
+        const ParsedArguments parsed_arguments = args.check_and_get_optional_command_arguments(
+            {OPTION_DRY_RUN, OPTION_NO_DOWNLOADS, OPTION_KEEP_GOING}, {OPTION_JOBS, OPTION_JSON_REPORT});
+        const std::unordered_set<std::string>& options = parsed_arguments.switches;
+        const bool dry_run = options.find(OPTION_DRY_RUN) != options.cend();
+        const bool no_downloads = options.find(OPTION_NO_DOWNLOADS) != options.cend();
+        const Install::KeepGoing keep_going =
+            Install::to_keep_going(options.find(OPTION_KEEP_GOING) != options.cend());
+        const size_t jobs = Install::parse_jobs(parsed_arguments, OPTION_JOBS);
+
+        const std::vector<PackageSpec> requested_specs = Util::fmap(args.command_arguments, [&](auto&& arg) {
+            return Input::check_and_get_package_spec(arg, default_triplet, EXAMPLE);
+        });
+        for (auto&& spec : requested_specs)
+            Input::check_triplet(spec.triplet(), paths);
+
+        StatusParagraphs status_db = database_load_check(paths);
+        std::vector<OutdatedPackage> outdated = Update::find_outdated_packages(paths, status_db);
+
+        // Without arguments every outdated package is upgraded
+        if (!requested_specs.empty())
+        {
+            for (auto&& spec : requested_specs)
+            {
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   status_db.find_installed(spec) != status_db.end(),
+                                   "Error: package %s is not installed",
+                                   spec);
+
+                const bool is_outdated = Util::find_if(outdated, [&](const OutdatedPackage& package) {
+                                             return package.spec == spec;
+                                         }) != outdated.cend();
+                if (!is_outdated) System::println(System::Color::success, "Package %s is up to date", spec);
+            }
+
+            Util::erase_remove_if(outdated, [&](const OutdatedPackage& package) {
+                return Util::find(requested_specs, package.spec) == requested_specs.cend();
+            });
+        }
+
+        if (outdated.empty())
+        {
+            System::println(System::Color::success, "There are no outdated packages.");
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        std::sort(outdated.begin(), outdated.end(), &OutdatedPackage::compare_by_name);
+        System::println("The following packages will be upgraded:");
+        for (auto&& package : outdated)
+        {
+            System::println("    %-32s %s", package.spec, package.version_diff.to_string());
+        }
+
+        const StatusParagraphs planning_db = without_packages(status_db, outdated);
+        Dependencies::PathsPortFile paths_port_file(paths);
+        std::vector<AnyAction> action_plan;
+        if (GlobalState::feature_packages)
+        {
+            // The installed features are built into the new versions too
+            const std::vector<FullPackageSpec> full_specs = Util::fmap(outdated, [&](const OutdatedPackage& package) {
+                FullPackageSpec full_spec{package.spec, {}};
+                for (auto&& spgh : status_db.find_all(package.spec.name(), package.spec.triplet()))
+                {
+                    const StatusParagraph& pkg = *spgh;
+                    if (!pkg.package.feature.empty() && pkg.state == InstallState::INSTALLED)
+                    {
+                        full_spec.features.push_back(pkg.package.feature);
+                    }
+                }
+                return full_spec;
+            });
+            action_plan = Dependencies::create_feature_install_plan(
+                paths_port_file, FullPackageSpec::to_feature_specs(full_specs), planning_db);
+        }
+        else
+        {
+            auto install_plan = Dependencies::create_install_plan(
+                paths_port_file, Util::fmap(outdated, [](auto&& package) { return package.spec; }), planning_db);
+            action_plan = Util::fmap(
+                install_plan, [](InstallPlanAction& install_action) { return AnyAction(std::move(install_action)); });
+        }
+
+        std::vector<std::string> additional_packages;
+        for (auto&& action : action_plan)
+        {
+            const auto install_action = action.install_plan.get();
+            if (install_action == nullptr || install_action->plan_type == InstallPlanType::ALREADY_INSTALLED) continue;
+
+            const bool is_outdated = Util::find_if(outdated, [&](const OutdatedPackage& package) {
+                                         return package.spec == install_action->spec;
+                                     }) != outdated.cend();
+            if (!is_outdated) additional_packages.push_back(install_action->spec.to_string());
+        }
+        if (!additional_packages.empty())
+        {
+            System::println("The following new dependencies will be installed:\n    %s",
+                            Strings::join("\n    ", additional_packages));
+        }
+
+        if (dry_run)
+        {
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        const Build::BuildPackageOptions install_plan_options = {Build::UseHeadVersion::NO,
+                                                                 Build::to_allow_downloads(!no_downloads),
+                                                                 Build::IncrementalBuild::NO,
+                                                                 0};
+
+        // Installing a package which is already installed replaces only the files which changed
+        const Install::InstallSummary summary =
+            Install::perform(action_plan, install_plan_options, keep_going, jobs, paths, status_db);
+        if (keep_going == Install::KeepGoing::YES)
+        {
+            summary.print();
+        }
+        Install::write_json_report_if_requested(paths, parsed_arguments, OPTION_JSON_REPORT, summary);
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
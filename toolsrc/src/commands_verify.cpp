@@ -0,0 +1,245 @@
+#include "pch.h"
+
+#include "Paragraphs.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_ContentStore.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+#include "vcpkglib.h"
+
+namespace vcpkg::Commands::Verify
+{
+    static const char* to_string(const FileState state)
+    {
+        switch (state)
+        {
+            case FileState::INTACT: return "intact";
+            case FileState::MISSING: return "missing";
+            case FileState::WRONG_SIZE: return "wrong size";
+            case FileState::WRONG_CONTENTS: return "wrong contents";
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    /// <summary>
+    /// A file of an installed package, with what is known about its contents
+    /// </summary>
+    struct FileToCheck
+    {
+        size_t package;
+        const Listfile::Entry* entry;
+        const std::string* key;
+    };
+
+    static bool has_same_contents(const Files::Filesystem& fs, const fs::path& left, const fs::path& right)
+    {
+        const Expected<Files::MappedFile> maybe_left = fs.map_contents(left);
+        const Expected<Files::MappedFile> maybe_right = fs.map_contents(right);
+        const auto left_file = maybe_left.get();
+        const auto right_file = maybe_right.get();
+        if (!left_file || !right_file || left_file->size != right_file->size) return false;
+
+        const span<const char> left_contents = left_file->contents();
+        return std::equal(left_contents.begin(), left_contents.end(), right_file->contents().begin());
+    }
+
+    static FileState check_file(const VcpkgPaths& paths,
+                                const PackageSpec& spec,
+                                const FileToCheck& file,
+                                const bool has_package_dir,
+                                const bool check_contents)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path installed_path = paths.installed / file.entry->path;
+        std::error_code ec;
+        const std::uintmax_t size = fs.file_size(installed_path, ec);
+        if (ec) return FileState::MISSING;
+
+        const auto expected_size = file.entry->size.get();
+        if (expected_size && *expected_size != size) return FileState::WRONG_SIZE;
+        if (!check_contents) return FileState::INTACT;
+
+        // The store key is the hash of the contents it was installed with; other files are compared with the package
+        if (file.key)
+        {
+            const Expected<Files::MappedFile> maybe_mapped = fs.map_contents(installed_path);
+            const auto mapped = maybe_mapped.get();
+            if (!mapped) return FileState::WRONG_CONTENTS;
+
+            Hash::Hasher hasher("SHA256");
+            hasher.add(mapped->data.get(), mapped->size);
+            return hasher.finish() == *file.key ? FileState::INTACT : FileState::WRONG_CONTENTS;
+        }
+
+        if (!has_package_dir) return FileState::INTACT;
+        const fs::path package_path = get_package_file_path(paths, spec, file.entry->path);
+        return has_same_contents(fs, installed_path, package_path) ? FileState::INTACT : FileState::WRONG_CONTENTS;
+    }
+
+    fs::path get_package_file_path(const VcpkgPaths& paths, const PackageSpec& spec, const std::string& listed_path)
+    {
+        // Listfile entries are prefixed with "<triplet>/"
+        const size_t prefix_length = spec.triplet().canonical_name().size() + 1;
+        return paths.package_dir(spec) / listed_path.substr(std::min(prefix_length, listed_path.size()));
+    }
+
+    /// <summary>
+    /// Whether packages/ still has the package which was installed, rather than another build of it
+    /// </summary>
+    static bool has_installed_package_dir(const VcpkgPaths& paths, const BinaryParagraph& installed)
+    {
+        if (!paths.get_filesystem().exists(paths.package_dir(installed.spec) / "CONTROL")) return false;
+
+        const Expected<BinaryControlFile> maybe_bcf =
+            Paragraphs::try_load_cached_control_package(paths, installed.spec);
+        const auto bcf = maybe_bcf.get();
+        if (!bcf) return false;
+
+        const BinaryParagraph& cached = bcf->core_paragraph;
+        return cached.version == installed.version && cached.abi == installed.abi;
+    }
+
+    std::vector<PackageDrift> verify(const VcpkgPaths& paths,
+                                     const StatusParagraphs& status_db,
+                                     const bool check_contents)
+    {
+        auto& fs = paths.get_filesystem();
+
+        std::vector<const BinaryParagraph*> packages;
+        for (const StatusParagraph* pgh : get_installed_ports(status_db))
+        {
+            if (pgh->package.feature.empty()) packages.push_back(&pgh->package);
+        }
+
+        const std::vector<char> has_package_dirs = Util::parallel_fmap(
+            packages, [&](const BinaryParagraph* pgh) -> char { return has_installed_package_dir(paths, *pgh); });
+
+        std::vector<std::vector<Listfile::Entry>> listfiles;
+        std::vector<std::unordered_map<std::string, std::string>> keys(packages.size());
+        listfiles.reserve(packages.size());
+        for (size_t i = 0; i < packages.size(); ++i)
+        {
+            const fs::path listfile_path = paths.listfile_path(*packages[i]);
+            listfiles.push_back(read_listfile_entries(fs, listfile_path));
+            if (!check_contents) continue;
+
+            for (auto&& link : ContentStore::read_links(fs, listfile_path))
+            {
+                keys[i].emplace(std::move(link.path), std::move(link.key));
+            }
+        }
+
+        // The files of all packages are checked together, so that a large package does not hold the others up
+        std::vector<FileToCheck> files;
+        for (size_t i = 0; i < packages.size(); ++i)
+        {
+            for (const Listfile::Entry& entry : listfiles[i])
+            {
+                if (entry.is_directory) continue;
+
+                const auto it = keys[i].find(entry.path);
+                files.push_back({i, &entry, it == keys[i].cend() ? nullptr : &it->second});
+            }
+        }
+
+        const std::vector<FileState> states = Util::parallel_fmap(files, [&](const FileToCheck& file) {
+            const size_t i = file.package;
+            return check_file(paths, packages[i]->spec, file, has_package_dirs[i] != 0, check_contents);
+        });
+
+        // The files are in the order of their packages
+        std::vector<PackageDrift> drift;
+        size_t current = packages.size();
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (states[i] == FileState::INTACT) continue;
+
+            const size_t package = files[i].package;
+            if (current != package)
+            {
+                drift.push_back({packages[package]->spec, has_package_dirs[package] != 0, {}});
+                current = package;
+            }
+            drift.back().files.push_back({files[i].entry->path, states[i]});
+        }
+        return drift;
+    }
+
+    size_t repair(const VcpkgPaths& paths, const std::vector<PackageDrift>& drift)
+    {
+        auto& fs = paths.get_filesystem();
+        size_t not_repaired = 0;
+        for (auto&& package : drift)
+        {
+            if (!package.has_package_dir)
+            {
+                not_repaired += package.files.size();
+                continue;
+            }
+
+            for (auto&& file : package.files)
+            {
+                const fs::path source = get_package_file_path(paths, package.spec, file.path);
+                const fs::path target = paths.installed / file.path;
+                std::error_code ec;
+
+                // A file linked to the content store is removed first, so that the copy does not overwrite the store
+                fs.remove(target, ec);
+                fs.create_directories(target.parent_path(), ec);
+                fs.copy_file(source, target, fs::copy_options::overwrite_existing, ec);
+                if (ec) ++not_repaired;
+            }
+        }
+        return not_repaired;
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    {
+        static const std::string OPTION_CONTENTS = "--contents";
+        static const std::string OPTION_REPAIR = "--repair";
+        static const std::string EXAMPLE = Commands::Help::create_example_string("x-verify --contents --repair");
+        args.check_exact_arg_count(0, EXAMPLE);
+
+        const std::unordered_set<std::string> options =
+            args.check_and_get_optional_command_arguments({OPTION_CONTENTS, OPTION_REPAIR});
+        const bool check_contents = options.find(OPTION_CONTENTS) != options.cend();
+        const bool should_repair = options.find(OPTION_REPAIR) != options.cend();
+
+        const StatusParagraphs status_db = database_load_check(paths);
+        const std::vector<PackageDrift> drift = verify(paths, status_db, check_contents);
+        if (drift.empty())
+        {
+            System::println(System::Color::success, "The installed files match their listfiles");
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        for (auto&& package : drift)
+        {
+            System::println("Package %s has %d damaged files:", package.spec, static_cast<int>(package.files.size()));
+            for (auto&& file : package.files)
+            {
+                System::println("    %s: %s", file.path, to_string(file.state));
+            }
+        }
+
+        if (!should_repair)
+        {
+            System::println("Run `vcpkg x-verify --repair` to copy them back from the package directories");
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+
+        const size_t not_repaired = repair(paths, drift);
+        if (not_repaired != 0)
+        {
+            System::println(System::Color::error,
+                            "%d files could not be repaired, because packages/ no longer has the build which was "
+                            "installed. Remove and install those packages again.",
+                            static_cast<int>(not_repaired));
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+
+        System::println(System::Color::success, "Repaired the damaged files");
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
@@ -0,0 +1,223 @@
+#include "pch.h"
+
+#include "Paragraphs.h"
+#include "vcpkg_Build.h"
+#include "vcpkg_Chrono.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Input.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkglib.h"
+
+namespace vcpkg::Commands::Watch
+{
+    using Build::BuildResult;
+    using Parse::ParseExpected;
+
+    // Editors save a file in several writes, and often several files at once
+    static constexpr DWORD QUIET_PERIOD_MS = 300;
+
+    /// <summary>
+    /// The changes to the files of a directory and its subdirectories, read with ReadDirectoryChangesW. Reading starts
+    /// when the watch is created, so the changes made during a build are not missed.
+    /// </summary>
+    class DirectoryWatch
+    {
+    public:
+        explicit DirectoryWatch(const fs::path& dir) : m_buffer(16 * 1024)
+        {
+            m_dir = CreateFileW(dir.c_str(),
+                                FILE_LIST_DIRECTORY,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                                nullptr);
+            Checks::check_exit(
+                VCPKG_LINE_INFO, m_dir != INVALID_HANDLE_VALUE, "Failed to watch %s", dir.generic_u8string());
+            m_overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            Checks::check_exit(VCPKG_LINE_INFO, m_overlapped.hEvent != nullptr, "Failed to create an event");
+            start_reading();
+        }
+
+        DirectoryWatch(const DirectoryWatch&) = delete;
+        DirectoryWatch& operator=(const DirectoryWatch&) = delete;
+
+        ~DirectoryWatch()
+        {
+            CancelIo(m_dir);
+            CloseHandle(m_overlapped.hEvent);
+            CloseHandle(m_dir);
+        }
+
+        /// <summary>
+        /// Waits until a file changes and then until the changes stop. Returns the changed files relative to the
+        /// directory; a change which overflowed the buffer is returned as an empty name, as any file may have changed.
+        /// </summary>
+        std::set<std::string> wait_for_changes()
+        {
+            std::set<std::string> changes;
+            DWORD timeout = INFINITE;
+            while (WaitForSingleObject(m_overlapped.hEvent, timeout) == WAIT_OBJECT_0)
+            {
+                DWORD bytes = 0;
+                const bool succeeded = GetOverlappedResult(m_dir, &m_overlapped, &bytes, FALSE) != 0;
+                if (!succeeded || bytes == 0)
+                    changes.emplace();
+                else
+                    read_changes(changes);
+
+                start_reading();
+                timeout = QUIET_PERIOD_MS;
+            }
+            return changes;
+        }
+
+    private:
+        void start_reading()
+        {
+            ResetEvent(m_overlapped.hEvent);
+            const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                 FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+            const bool started = ReadDirectoryChangesW(m_dir,
+                                                       m_buffer.data(),
+                                                       static_cast<DWORD>(m_buffer.size() * sizeof(DWORD)),
+                                                       TRUE,
+                                                       filter,
+                                                       nullptr,
+                                                       &m_overlapped,
+                                                       nullptr) != 0;
+            Checks::check_exit(VCPKG_LINE_INFO, started, "Failed to read the changes of the port directory");
+        }
+
+        void read_changes(std::set<std::string>& changes) const
+        {
+            const char* record = reinterpret_cast<const char*>(m_buffer.data());
+            for (;;)
+            {
+                const auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+                const std::wstring name(info->FileName, info->FileNameLength / sizeof(wchar_t));
+                changes.insert(Strings::to_utf8(name));
+                if (info->NextEntryOffset == 0) break;
+                record += info->NextEntryOffset;
+            }
+        }
+
+        HANDLE m_dir;
+        OVERLAPPED m_overlapped{};
+
+        // ReadDirectoryChangesW requires the buffer to be aligned to a DWORD
+        std::vector<DWORD> m_buffer;
+    };
+
+    /// <summary>
+    /// Whether a changed file of the port is one which only the portfile reads while the sources are prepared, such as
+    /// a patch. The configure and build steps notice the other changes by themselves: the configured build trees are
+    /// reused only if the configure arguments are the same, and the build tool rebuilds what changed.
+    /// </summary>
+    static bool invalidates_sources(const std::string& changed_file)
+    {
+        const std::string name = Strings::ascii_to_lowercase(changed_file);
+        return name != "portfile.cmake" && name != "control";
+    }
+
+    /// <summary>
+    /// Removes the markers of the extracted archives, so the next build extracts the sources again and applies the
+    /// patches to them as they are now
+    /// </summary>
+    static void invalidate_sources(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path sources_dir = paths.buildtrees / spec.name() / "src";
+        if (!fs.is_directory(sources_dir)) return;
+
+        for (auto&& entry : fs.get_entries_non_recursive(sources_dir))
+        {
+            if (entry.path.extension() != ".extracted") continue;
+            std::error_code ec;
+            fs.remove(entry.path, ec);
+        }
+    }
+
+    static void build_once(const VcpkgPaths& paths, const PackageSpec& spec, const fs::path& port_dir)
+    {
+        const ParseExpected<SourceControlFile> source_control_file =
+            Paragraphs::try_load_port(paths.get_filesystem(), port_dir);
+        if (!source_control_file.has_value())
+        {
+            print_error_message(source_control_file.error());
+            return;
+        }
+
+        const auto& scf = source_control_file.value_or_exit(VCPKG_LINE_INFO);
+        if (spec.name() != scf->core_paragraph->name)
+        {
+            System::println(System::Color::error,
+                            "The Name: field inside the CONTROL does not match the port directory: '%s' != '%s'",
+                            scf->core_paragraph->name,
+                            spec.name());
+            return;
+        }
+
+        // The dependencies may have been installed or removed while the port was being watched
+        const StatusParagraphs status_db = database_load_check(paths);
+        const Build::BuildPackageOptions build_package_options{
+            Build::UseHeadVersion::NO, Build::AllowDownloads::YES, Build::IncrementalBuild::YES, 0};
+        const Build::BuildPackageConfig build_config{
+            *scf->core_paragraph, spec.triplet(), fs::path(port_dir), build_package_options};
+
+        const ElapsedTime timer = ElapsedTime::create_started();
+        const auto result = Build::build_package(paths, build_config, status_db);
+        if (result.code == BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES)
+        {
+            System::println(System::Color::error, "The following dependencies are missing:");
+            for (const auto& p : result.unmet_dependencies)
+            {
+                System::println("    %s", p);
+            }
+            return;
+        }
+
+        if (result.code != BuildResult::SUCCEEDED)
+        {
+            System::println(System::Color::error, Build::create_error_message(result.code, spec));
+            return;
+        }
+
+        System::println(System::Color::success, "Built %s in %s", spec.to_string(), timer.to_string());
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
+    {
+        static const std::string EXAMPLE = Commands::Help::create_example_string("x-watch zlib:x64-windows");
+        args.check_exact_arg_count(1, EXAMPLE);
+        args.check_and_get_optional_command_arguments({});
+        const PackageSpec spec = Input::check_and_get_package_spec(args.command_arguments[0], default_triplet, EXAMPLE);
+        Input::check_triplet(spec.triplet(), paths);
+
+        const fs::path port_dir = paths.port_dir(spec);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           paths.get_filesystem().is_directory(port_dir),
+                           "There is no port directory %s",
+                           port_dir.generic_u8string());
+
+        DirectoryWatch watch(port_dir);
+        for (;;)
+        {
+            build_once(paths, spec, port_dir);
+
+            System::println("Watching %s for changes. Press Ctrl+C to stop.", port_dir.generic_u8string());
+            const std::set<std::string> changes = watch.wait_for_changes();
+            for (auto&& change : changes)
+            {
+                System::println("    %s", change.empty() ? "(too many changes to list)" : change);
+            }
+
+            if (std::any_of(changes.cbegin(), changes.cend(), invalidates_sources))
+            {
+                System::println("The sources will be extracted and patched again");
+                invalidate_sources(paths, spec);
+            }
+        }
+    }
+}
@@ -6,6 +6,8 @@
 #include "vcpkg_Strings.h"
 #include "vcpkg_System.h"
 
+#include <thread>
+
 namespace vcpkg::Metrics
 {
     Util::LockGuarded<Metrics> g_metrics;
@@ -85,37 +87,6 @@ namespace vcpkg::Metrics
         return ID;
     }
 
-    static std::string to_json_string(const std::string& str)
-    {
-        std::string encoded = "\"";
-        for (auto&& ch : str)
-        {
-            if (ch == '\\')
-            {
-                encoded.append("\\\\");
-            }
-            else if (ch == '"')
-            {
-                encoded.append("\\\"");
-            }
-            else if (ch < 0x20 || ch >= 0x80)
-            {
-                // Note: this treats incoming Strings as Latin-1
-                static constexpr const char HEX[16] = {
-                    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-                encoded.append("\\u00");
-                encoded.push_back(HEX[ch / 16]);
-                encoded.push_back(HEX[ch % 16]);
-            }
-            else
-            {
-                encoded.push_back(ch);
-            }
-        }
-        encoded.push_back('"');
-        return encoded;
-    }
-
     static std::string get_os_version_string()
     {
         std::wstring path;
@@ -151,23 +122,51 @@ namespace vcpkg::Metrics
         std::string timestamp = get_current_date_time();
         std::string properties;
         std::string measurements;
+        std::map<std::string, double> counters;
 
         void track_property(const std::string& name, const std::string& value)
         {
             if (properties.size() != 0) properties.push_back(',');
-            properties.append(to_json_string(name));
+            properties.append(Strings::to_json_string(name));
             properties.push_back(':');
-            properties.append(to_json_string(value));
+            properties.append(Strings::to_json_string(value));
         }
 
         void track_metric(const std::string& name, double value)
         {
             if (measurements.size() != 0) measurements.push_back(',');
-            measurements.append(to_json_string(name));
+            measurements.append(Strings::to_json_string(name));
             measurements.push_back(':');
             measurements.append(std::to_string(value));
         }
 
+        void track_counter(const std::string& name, double increment) { counters[name] += increment; }
+
+        std::string format_measurements() const
+        {
+            std::string all_measurements = measurements;
+            for (auto&& counter : counters)
+            {
+                if (all_measurements.size() != 0) all_measurements.push_back(',');
+                all_measurements.append(Strings::to_json_string(counter.first));
+                all_measurements.push_back(':');
+                all_measurements.append(std::to_string(counter.second));
+            }
+            return all_measurements;
+        }
+
+        /// <summary>
+        /// A single line record for the local metrics file, which self-hosted dashboards can ingest as JSON Lines
+        /// </summary>
+        std::string format_local_record() const
+        {
+            return Strings::format(R"({"time":"%s","session":"%s","properties":{%s},"measurements":{%s}})",
+                                   timestamp,
+                                   get_session_id(),
+                                   properties,
+                                   format_measurements());
+        }
+
         std::string format_event_data_template() const
         {
             const std::string& session_id = get_session_id();
@@ -202,7 +201,7 @@ namespace vcpkg::Metrics
                                    user_id,
                                    user_timestamp,
                                    properties,
-                                   measurements);
+                                   format_measurements());
         }
     };
 
@@ -243,6 +242,11 @@ namespace vcpkg::Metrics
 
     void Metrics::track_metric(const std::string& name, double value) { g_metricmessage.track_metric(name, value); }
 
+    void Metrics::track_counter(const std::string& name, double increment)
+    {
+        g_metricmessage.track_counter(name, increment);
+    }
+
     void Metrics::track_property(const std::string& name, const std::wstring& value)
     {
         // Note: this is not valid UTF-16 -> UTF-8, it just yields a close enough approximation for our purposes.
@@ -259,7 +263,7 @@ namespace vcpkg::Metrics
         g_metricmessage.track_property(name, value);
     }
 
-    void Metrics::upload(const std::string& payload)
+    bool Metrics::upload(const std::string& payload)
     {
         HINTERNET connect = nullptr, request = nullptr;
         BOOL results = FALSE;
@@ -341,6 +345,8 @@ namespace vcpkg::Metrics
         if (request) WinHttpCloseHandle(request);
         if (connect) WinHttpCloseHandle(connect);
         if (session) WinHttpCloseHandle(session);
+
+        return results == TRUE && http_code == 200;
     }
 
     static fs::path get_bindir()
@@ -351,45 +357,167 @@ namespace vcpkg::Metrics
         return fs::path(buf, buf + bytes);
     }
 
+    // Held by the uploader while it drains the spool, so that vcpkg starts at most one uploader at a time
+    static const wchar_t* UPLOADER_MUTEX_NAME = L"Local\\vcpkg-metrics-uploader";
+
+    // Payloads beyond this count are dropped, oldest first, when the uploader cannot reach the server
+    static constexpr size_t MAX_SPOOLED_PAYLOADS = 100;
+
+    // Each upload sends the events of up to this many invocations
+    static constexpr size_t PAYLOADS_PER_BATCH = 20;
+
+    static fs::path get_temp_folder()
+    {
+        wchar_t temp_folder[MAX_PATH];
+        GetTempPathW(MAX_PATH, temp_folder);
+        return temp_folder;
+    }
+
+    static std::vector<fs::path> get_spooled_payloads_oldest_first(const Files::Filesystem& fs,
+                                                                   const fs::path& spool_dir)
+    {
+        if (!fs.exists(spool_dir)) return {};
+
+        std::vector<std::pair<fs::file_time_type, fs::path>> payloads;
+        for (auto&& path : fs.get_files_non_recursive(spool_dir))
+        {
+            if (path.extension() != ".json") continue;
+            std::error_code ec;
+            const fs::file_time_type time = fs.last_write_time(path, ec);
+            if (!ec) payloads.emplace_back(time, path);
+        }
+
+        std::sort(payloads.begin(), payloads.end());
+        return Util::fmap(payloads, [](auto&& payload) { return payload.second; });
+    }
+
+    static void append_to_local_metrics_file(const fs::path& metrics_file)
+    {
+        // This runs while exiting, so a file which cannot be written is skipped instead of exiting again
+        std::ofstream output(metrics_file, std::ios::binary | std::ios::app);
+        if (!output) return;
+
+        output << g_metricmessage.format_local_record() + "\n";
+    }
+
     void Metrics::flush()
     {
+        // Independent of sending metrics, so that the local file works in builds with metrics disabled
+        const Optional<std::wstring> local_metrics_file = System::get_environment_variable(L"VCPKG_METRICS_FILE");
+        if (const auto p = local_metrics_file.get())
+        {
+            if (!p->empty()) append_to_local_metrics_file(*p);
+        }
+
         const std::string payload = g_metricmessage.format_event_data_template();
         if (g_should_print_metrics) std::cerr << payload << "\n";
         if (!g_should_send_metrics) return;
 
-        // upload(payload);
+        // The payload is only spooled here; a detached uploader sends it, so no command waits on the network
+        auto& fs = Files::get_real_filesystem();
+        const fs::path temp_folder_path = get_temp_folder();
+        const fs::path spool_dir = temp_folder_path / "vcpkg-metrics";
+        std::error_code ec;
+        fs.create_directories(spool_dir, ec);
+
+        // Renamed into place so that the uploader never reads a partial payload
+        const std::string payload_name = generate_random_UUID();
+        const fs::path tmp_payload_path = spool_dir / (payload_name + ".tmp");
+        fs.write_lines(tmp_payload_path, {payload});
+        fs.rename(tmp_payload_path, spool_dir / (payload_name + ".json"), ec);
+        if (ec)
+        {
+            fs.remove(tmp_payload_path, ec);
+            return;
+        }
 
-        wchar_t temp_folder[MAX_PATH];
-        GetTempPathW(MAX_PATH, temp_folder);
+        const std::vector<fs::path> spooled = get_spooled_payloads_oldest_first(fs, spool_dir);
+        for (size_t i = 0; i + MAX_SPOOLED_PAYLOADS < spooled.size(); ++i)
+        {
+            fs.remove(spooled[i], ec);
+        }
+
+        // A running uploader picks up the new payload before it exits
+        const HANDLE uploader_mutex = OpenMutexW(SYNCHRONIZE, FALSE, UPLOADER_MUTEX_NAME);
+        if (uploader_mutex != nullptr)
+        {
+            CloseHandle(uploader_mutex);
+            return;
+        }
 
-        const fs::path temp_folder_path = temp_folder;
+        // The uploader runs from the temp folder so that it does not keep the vcpkg directory in use
         const fs::path temp_folder_path_exe = temp_folder_path / "vcpkgmetricsuploader.exe";
+        const fs::path exe_path = [&fs]() -> fs::path {
+            auto vcpkgdir = get_bindir().parent_path();
+            auto path = vcpkgdir / "vcpkgmetricsuploader.exe";
+            if (fs.exists(path)) return path;
 
-        auto& fs = Files::get_real_filesystem();
+            path = vcpkgdir / "scripts" / "vcpkgmetricsuploader.exe";
+            if (fs.exists(path)) return path;
+
+            return Strings::WEMPTY;
+        }();
+
+        fs.copy_file(exe_path, temp_folder_path_exe, fs::copy_options::update_existing, ec);
+        if (ec) return;
+
+        System::start_detached(Strings::wformat(LR"("%s" "%s")", temp_folder_path_exe.native(), spool_dir.native()));
+    }
+
+    /// <summary>
+    /// Merges the event arrays of several payloads into a single array
+    /// </summary>
+    static std::string merge_payloads(const std::vector<std::string>& payloads)
+    {
+        const std::string events = Strings::join(",", payloads, [](const std::string& payload) {
+            const std::string trimmed = Strings::trimmed(payload);
+            if (trimmed.size() < 2 || trimmed.front() != '[' || trimmed.back() != ']') return trimmed;
+            return trimmed.substr(1, trimmed.size() - 2);
+        });
+        return "[" + events + "]";
+    }
+
+    void upload_spooled_metrics(const fs::path& spool_dir)
+    {
+        const HANDLE uploader_mutex = CreateMutexW(nullptr, TRUE, UPLOADER_MUTEX_NAME);
+        if (uploader_mutex == nullptr) return;
+        if (GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle(uploader_mutex);
+            return;
+        }
 
-        if (true)
+        auto& fs = Files::get_real_filesystem();
+        for (;;)
         {
-            const fs::path exe_path = [&fs]() -> fs::path {
-                auto vcpkgdir = get_bindir().parent_path();
-                auto path = vcpkgdir / "vcpkgmetricsuploader.exe";
-                if (fs.exists(path)) return path;
+            std::vector<fs::path> batch = get_spooled_payloads_oldest_first(fs, spool_dir);
+            if (batch.empty()) break;
+            if (batch.size() > PAYLOADS_PER_BATCH) batch.resize(PAYLOADS_PER_BATCH);
 
-                path = vcpkgdir / "scripts" / "vcpkgmetricsuploader.exe";
-                if (fs.exists(path)) return path;
+            std::vector<std::string> payloads;
+            for (auto&& path : batch)
+            {
+                if (const auto contents = fs.read_contents(path).get()) payloads.push_back(std::move(*contents));
+            }
 
-                return Strings::WEMPTY;
-            }();
+            // Retried with exponential backoff; payloads which still fail are left for the next uploader
+            bool uploaded = false;
+            const std::string merged_payload = merge_payloads(payloads);
+            for (int attempt = 0; attempt < 4 && !uploaded; ++attempt)
+            {
+                if (attempt != 0) std::this_thread::sleep_for(std::chrono::seconds(1 << attempt));
+                uploaded = g_metrics.lock()->upload(merged_payload);
+            }
+            if (!uploaded) break;
 
             std::error_code ec;
-            fs.copy_file(exe_path, temp_folder_path_exe, fs::copy_options::skip_existing, ec);
-            if (ec) return;
+            for (auto&& path : batch)
+            {
+                fs.remove(path, ec);
+            }
         }
 
-        const fs::path vcpkg_metrics_txt_path = temp_folder_path / ("vcpkg" + generate_random_UUID() + ".txt");
-        fs.write_contents(vcpkg_metrics_txt_path, payload);
-
-        const std::wstring cmd_line =
-            Strings::wformat(L"start %s %s", temp_folder_path_exe.native(), vcpkg_metrics_txt_path.native());
-        System::cmd_execute_clean(cmd_line);
+        ReleaseMutex(uploader_mutex);
+        CloseHandle(uploader_mutex);
     }
 }
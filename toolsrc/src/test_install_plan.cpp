@@ -421,6 +421,40 @@ namespace UnitTest1
             auto spec_x = FullPackageSpec{spec_map.emplace("x", "a"), {"core"}};
             auto spec_b = FullPackageSpec{spec_map.emplace("b", "", {{"b1", ""}}), {"b1"}};
 
+            auto install_plan =
+                Dependencies::create_feature_install_plan(spec_map.map,
+                                                          FullPackageSpec::to_feature_specs({spec_b}),
+                                                          StatusParagraphs(std::move(status_paragraphs)));
+
+            // b1 only adds to b, so x stays as it was built
+            Assert::AreEqual(size_t(2), install_plan.size());
+            remove_plan_check(&install_plan[0], "b");
+            features_check(&install_plan[1], "b", {"core", "b1"});
+
+            const auto& remove_plan = install_plan[0].remove_plan.value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(size_t(1), remove_plan.kept_dependents.size());
+            Assert::AreEqual("x", remove_plan.kept_dependents[0].name().c_str());
+        }
+
+        TEST_METHOD(basic_feature_test_7_changes_abi)
+        {
+            std::vector<std::unique_ptr<StatusParagraph>> status_paragraphs;
+            status_paragraphs.push_back(make_status_pgh("x", "b"));
+            status_paragraphs.push_back(make_status_pgh("b"));
+
+            PackageSpecMap spec_map(Triplet::X86_WINDOWS);
+
+            auto spec_a = FullPackageSpec{spec_map.emplace("a")};
+            auto spec_x = FullPackageSpec{spec_map.emplace("x", "a"), {"core"}};
+
+            using Pgh = std::unordered_map<std::string, std::string>;
+            std::vector<Pgh> b_pghs;
+            b_pghs.push_back(Pgh{{"Source", "b"}, {"Version", "0"}});
+            b_pghs.push_back(Pgh{{"Feature", "b1"}, {"Description", "feature"}, {"Changes-ABI", "yes"}});
+            auto b_scf = SourceControlFile::parse_control_file(std::move(b_pghs));
+            Assert::IsTrue(b_scf.has_value());
+            auto spec_b = FullPackageSpec{spec_map.emplace(std::move(**b_scf.get())), {"b1"}};
+
             auto install_plan =
                 Dependencies::create_feature_install_plan(spec_map.map,
                                                           FullPackageSpec::to_feature_specs({spec_b}),
@@ -430,6 +464,11 @@ namespace UnitTest1
             remove_plan_check(&install_plan[0], "x");
             remove_plan_check(&install_plan[1], "b");
 
+            const auto& remove_plan = install_plan[0].remove_plan.value_or_exit(VCPKG_LINE_INFO);
+            const auto cascaded_from = remove_plan.cascaded_from.get();
+            Assert::IsNotNull(cascaded_from);
+            Assert::AreEqual("b", cascaded_from->name().c_str());
+
             // TODO: order here may change but A < X, and B anywhere
             features_check(&install_plan[2], "b", {"core", "b1"});
             features_check(&install_plan[3], "a", {"core"});
@@ -482,5 +521,48 @@ namespace UnitTest1
             features_check(&install_plan[6], "a", {"a1", "core"});
             features_check(&install_plan[7], "c", {"core"});
         }
+
+        TEST_METHOD(feature_planner_incremental_requests)
+        {
+            std::vector<std::unique_ptr<StatusParagraph>> status_paragraphs;
+            status_paragraphs.push_back(make_status_pgh("a", "b, b[b1]"));
+            status_paragraphs.push_back(make_status_pgh("b"));
+            status_paragraphs.push_back(make_status_feature_pgh("b", "b1"));
+            const StatusParagraphs status_db(std::move(status_paragraphs));
+
+            PackageSpecMap spec_map(Triplet::X86_WINDOWS);
+            auto spec_a = spec_map.emplace("a", "b, b[b1]", {{"a1", "b[b2]"}});
+            auto spec_b = spec_map.emplace("b", "", {{"b1", ""}, {"b2", ""}, {"b3", ""}});
+
+            Dependencies::MapPortFile map_port(spec_map.map);
+            Dependencies::FeatureInstallPlanner planner(map_port, status_db);
+            planner.add(FeatureSpec{spec_a, ""});
+            planner.add(FeatureSpec{spec_a, "a1"});
+
+            auto install_plan = planner.plan();
+            Assert::AreEqual(size_t(4), install_plan.size());
+            remove_plan_check(&install_plan[0], "a");
+            remove_plan_check(&install_plan[1], "b");
+            features_check(&install_plan[2], "b", {"b1", "core", "b1"});
+            features_check(&install_plan[3], "a", {"a1", "core"});
+
+            planner.remove(FeatureSpec{spec_a, "a1"});
+
+            install_plan = planner.plan();
+            Assert::AreEqual(size_t(1), install_plan.size());
+            auto p = install_plan[0].install_plan.get();
+            Assert::IsNotNull(p);
+            Assert::AreEqual("a", p->spec.name().c_str());
+            Assert::AreEqual(Dependencies::InstallPlanType::ALREADY_INSTALLED, p->plan_type);
+
+            planner.add(FeatureSpec{spec_a, "a1"});
+
+            install_plan = planner.plan();
+            Assert::AreEqual(size_t(4), install_plan.size());
+            remove_plan_check(&install_plan[0], "a");
+            remove_plan_check(&install_plan[1], "b");
+            features_check(&install_plan[2], "b", {"b1", "core", "b1"});
+            features_check(&install_plan[3], "a", {"a1", "core"});
+        }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,91 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Commands.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+    using namespace Commands::ApplyPatches;
+
+    class ApplyPatches : public TestClass<ApplyPatches>
+    {
+        static const std::vector<Hunk>& single_file_hunks(const ExpectedT<std::vector<FilePatch>, std::string>& patch)
+        {
+            Assert::IsTrue(patch.get() != nullptr);
+            Assert::AreEqual(size_t{1}, patch.get()->size());
+            return patch.get()->front().hunks;
+        }
+
+        TEST_METHOD(git_headers_are_parsed)
+        {
+            const auto patch = parse_patch("From 0123 Mon Sep 17 00:00:00 2001\n"
+                                           "Subject: [PATCH] Fix the build\n"
+                                           "---\n"
+                                           "diff --git a/src/zlib.c b/src/zlib.c\n"
+                                           "index 1234567..89abcde 100644\n"
+                                           "--- a/src/zlib.c\n"
+                                           "+++ b/src/zlib.c\n"
+                                           "@@ -1,2 +1,2 @@\n"
+                                           "--- not a header\n"
+                                           "+++ not a header either\n"
+                                           " end\n"
+                                           "diff --git a/new.h b/new.h\n"
+                                           "new file mode 100644\n"
+                                           "--- /dev/null\n"
+                                           "+++ b/new.h\n"
+                                           "@@ -0,0 +1 @@\n"
+                                           "+#pragma once\n"
+                                           "\\ No newline at end of file\n"
+                                           "diff --git a/old.txt b/renamed.txt\n"
+                                           "similarity index 100%\n"
+                                           "rename from old.txt\n"
+                                           "rename to renamed.txt\n");
+
+            const std::vector<FilePatch>* const files = patch.get();
+            Assert::IsTrue(files != nullptr);
+            Assert::AreEqual(size_t{3}, files->size());
+            Assert::AreEqual("src/zlib.c", files->at(0).old_path.c_str());
+            Assert::AreEqual(size_t{3}, files->at(0).hunks.front().lines.size());
+            Assert::IsTrue(files->at(1).old_path.empty());
+            Assert::AreEqual("new.h", files->at(1).new_path.c_str());
+            Assert::AreEqual("+#pragma once", files->at(1).hunks.front().lines.front().c_str());
+            Assert::AreEqual("renamed.txt", files->at(2).new_path.c_str());
+            Assert::IsTrue(files->at(2).hunks.empty());
+        }
+
+        TEST_METHOD(malformed_patches_are_rejected)
+        {
+            Assert::IsFalse(parse_patch("--- a/x\n+++ b/x\n@@ -1,2 +1,2 @@\n a\n").has_value());
+            Assert::IsFalse(parse_patch("--- a/../x\n+++ b/../x\n@@ -1 +1 @@\n-a\n+b\n").has_value());
+            Assert::IsFalse(parse_patch("diff --git a/x b/x\nGIT binary patch\nliteral 0\n").has_value());
+        }
+
+        TEST_METHOD(hunks_are_found_at_an_offset)
+        {
+            const auto patch = parse_patch("--- a/x\n+++ b/x\n"
+                                           "@@ -2,3 +2,3 @@\n one\n-two\n+TWO\n three\n"
+                                           "@@ -8,2 +8,3 @@\n seven\n eight\n+nine\n\\ No newline at end of file\n");
+
+            // Two lines were added in front, and the context keeps the line endings of the file
+            const std::string file =
+                "x\r\ny\r\nzero\r\none\r\ntwo\r\nthree\r\nfour\r\nfive\r\nsix\r\nseven\r\neight\r\n";
+            const Optional<std::string> patched = apply_hunks(file, single_file_hunks(patch));
+            Assert::IsTrue(patched.has_value());
+            Assert::AreEqual("x\r\ny\r\nzero\r\none\r\nTWO\nthree\r\nfour\r\nfive\r\nsix\r\nseven\r\neight\r\nnine",
+                             patched.get()->c_str());
+
+            Assert::IsFalse(apply_hunks("zero\none\nthree\n", single_file_hunks(patch)).has_value());
+        }
+
+        TEST_METHOD(context_matches_but_for_whitespace)
+        {
+            const auto patch = parse_patch("--- a/x\n+++ b/x\n@@ -1 +1 @@\n-int main( void)\n+int main()\n");
+            Assert::IsTrue(apply_hunks("int  main(\tvoid)\r\n", single_file_hunks(patch)).has_value());
+            Assert::IsFalse(apply_hunks("int main(void)\n", single_file_hunks(patch)).has_value());
+        }
+    };
+}
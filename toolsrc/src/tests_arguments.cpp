@@ -1,5 +1,6 @@
 #include "CppUnitTest.h"
 #include "VcpkgCmdArguments.h"
+#include "vcpkg_Files.h"
 
 #pragma comment(lib, "version")
 #pragma comment(lib, "winhttp")
@@ -54,5 +55,32 @@ namespace UnitTest1
             Assert::IsTrue(opts.settings.find("--c") == opts.settings.end());
             Assert::AreEqual(size_t{0}, v.command_arguments.size());
         }
+
+        TEST_METHOD(split_argument_list_skips_comments_and_blank_lines)
+        {
+            const std::string text = "\xEF\xBB\xBFzlib:x86-windows  boost\r\n  # comment\n\n\tcurl[ssl]\n";
+            const auto v = VcpkgCmdArguments::split_argument_list(text);
+            Assert::AreEqual(size_t{3}, v.size());
+            Assert::AreEqual("zlib:x86-windows", v[0].c_str());
+            Assert::AreEqual("boost", v[1].c_str());
+            Assert::AreEqual("curl[ssl]", v[2].c_str());
+        }
+
+        TEST_METHOD(create_from_arg_sequence_response_file)
+        {
+            const fs::path response_file = fs::stdfs::temp_directory_path() / "vcpkg-test-specs.txt";
+            Files::get_real_filesystem().write_contents(response_file, "zlib\nboost\n");
+
+            std::vector<std::string> t = {"install", "@" + response_file.u8string(), "curl"};
+            auto v = VcpkgCmdArguments::create_from_arg_sequence(t.data(), t.data() + t.size());
+            Assert::AreEqual("install", v.command.c_str());
+            Assert::AreEqual(size_t{3}, v.command_arguments.size());
+            Assert::AreEqual("zlib", v.command_arguments[0].c_str());
+            Assert::AreEqual("boost", v.command_arguments[1].c_str());
+            Assert::AreEqual("curl", v.command_arguments[2].c_str());
+
+            std::error_code ec;
+            fs::stdfs::remove(response_file, ec);
+        }
     };
 }
\ No newline at end of file
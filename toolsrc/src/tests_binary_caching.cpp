@@ -0,0 +1,43 @@
+#include "CppUnitTest.h"
+#include "vcpkg_BinaryCaching.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class BinaryCaching : public TestClass<BinaryCaching>
+    {
+        TEST_METHOD(parse_binary_sources_reads_every_kind)
+        {
+            const auto maybe_sources = vcpkg::BinaryCaching::parse_binary_sources(
+                "# shared by the build agents\n"
+                "http,https://cache.example.com/vcpkg/,read;nuget, https://feed.example.com/v3/index.json\n"
+                "azblob,https://account.blob.core.windows.net/archives,sv=2019&sig=secret,write\n");
+            const auto& sources = maybe_sources.value_or_exit(VCPKG_LINE_INFO);
+
+            Assert::AreEqual(size_t(3), sources.size());
+            Assert::AreEqual(std::string("http https://cache.example.com/vcpkg"), sources[0].provider->describe());
+            Assert::IsTrue(sources[0].read);
+            Assert::IsFalse(sources[0].write);
+            Assert::AreEqual(std::string("nuget https://feed.example.com/v3/index.json"),
+                             sources[1].provider->describe());
+            Assert::IsTrue(sources[1].read && sources[1].write);
+            Assert::AreEqual(std::string("azblob https://account.blob.core.windows.net/archives"),
+                             sources[2].provider->describe());
+            Assert::IsFalse(sources[2].read);
+            Assert::IsTrue(sources[2].write);
+        }
+
+        TEST_METHOD(parse_binary_sources_rejects_unknown_kinds)
+        {
+            Assert::IsFalse(vcpkg::BinaryCaching::parse_binary_sources("ftp,ftp://example.com").has_value());
+            Assert::IsFalse(vcpkg::BinaryCaching::parse_binary_sources("azblob,https://example.com").has_value());
+            Assert::IsTrue(vcpkg::BinaryCaching::parse_binary_sources("").has_value());
+        }
+    };
+}
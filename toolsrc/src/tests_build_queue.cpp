@@ -0,0 +1,39 @@
+#include "CppUnitTest.h"
+#include "vcpkg_BuildQueue.h"
+#include "vcpkg_Files.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class BuildQueue : public TestClass<BuildQueue>
+    {
+        TEST_METHOD(pending_job_is_claimed_once)
+        {
+            const auto spec =
+                PackageSpec::from_name_and_triplet("curl", Triplet::X64_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            const vcpkg::BuildQueue::Job job{spec, "0123abcd", {"openssl", "tool"}};
+
+            const auto fs = Files::make_memory_filesystem();
+            std::error_code ec;
+            fs->create_directories("C:/queue/pending", ec);
+            fs->write_contents("C:/queue/pending/0123abcd.job", vcpkg::BuildQueue::serialize_job(job));
+
+            const auto claimed = vcpkg::BuildQueue::try_claim(*fs, "C:/queue").value_or_exit(VCPKG_LINE_INFO);
+            Assert::IsTrue(claimed.job.spec == spec);
+            Assert::AreEqual(std::string("0123abcd"), claimed.job.abi_tag);
+            Assert::IsTrue(claimed.job.features == job.features);
+            Assert::IsTrue(claimed.lock.is_held());
+            Assert::IsFalse(fs->exists("C:/queue/pending/0123abcd.job"));
+            Assert::IsFalse(vcpkg::BuildQueue::try_claim(*fs, "C:/queue").has_value());
+
+            vcpkg::BuildQueue::complete(*fs, "C:/queue", claimed, "SUCCEEDED");
+            Assert::IsTrue(fs->exists("C:/queue/done/0123abcd.result"));
+        }
+    };
+}
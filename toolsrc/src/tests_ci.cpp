@@ -0,0 +1,43 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Commands.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class CI : public TestClass<CI>
+    {
+        TEST_METHOD(shards_cover_the_plan_and_keep_dependencies)
+        {
+            // Two independent chains of three builds each, and a slow port which depends on nothing
+            const std::vector<std::vector<size_t>> dependencies = {{}, {0}, {1}, {}, {3}, {4}, {}};
+            const std::vector<double> durations = {10, 10, 10, 10, 10, 10, 40};
+
+            std::vector<bool> covered(dependencies.size());
+            for (size_t shard = 0; shard < 3; ++shard)
+            {
+                const std::vector<size_t> selected = Commands::CI::select_shard(dependencies, durations, shard, 3);
+                Assert::IsTrue(std::is_sorted(selected.cbegin(), selected.cend()));
+                Assert::IsTrue(selected == Commands::CI::select_shard(dependencies, durations, shard, 3));
+
+                double load = 0;
+                for (const size_t index : selected)
+                {
+                    covered[index] = true;
+                    load += durations[index];
+                    for (const size_t dependency : dependencies[index])
+                    {
+                        Assert::IsTrue(Util::find(selected, dependency) != selected.cend());
+                    }
+                }
+                Assert::IsTrue(load == 30 || load == 40);
+            }
+            Assert::IsTrue(std::find(covered.cbegin(), covered.cend(), false) == covered.cend());
+        }
+    };
+}
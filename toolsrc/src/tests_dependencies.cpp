@@ -35,6 +35,21 @@ namespace UnitTest1
             Assert::AreEqual("libB", v2[0].c_str());
             Assert::AreEqual("libC", v2[1].c_str());
         }
+
+        TEST_METHOD(filter_host_depends)
+        {
+            auto deps = expand_qualified_dependencies(parse_comma_list("libA, libB (host)"));
+            auto v = filter_dependencies(deps, Triplet::ARM_UWP);
+            Assert::AreEqual(size_t(1), v.size());
+            Assert::AreEqual("libA", v[0].c_str());
+
+            auto specs = filter_dependencies_to_specs(deps, Triplet::ARM_UWP);
+            Assert::AreEqual(size_t(2), specs.size());
+            Assert::AreEqual("libA", specs[0].name().c_str());
+            Assert::IsTrue(specs[0].triplet() == Triplet::ARM_UWP);
+            Assert::AreEqual("libB", specs[1].name().c_str());
+            Assert::IsTrue(specs[1].triplet() == Triplet::host());
+        }
     };
 
     class SupportsTests : public TestClass<SupportsTests>
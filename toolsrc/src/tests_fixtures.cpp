@@ -0,0 +1,177 @@
+#include "CppUnitTest.h"
+#include "Paragraphs.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Fixtures.h"
+#include "vcpkglib.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class Fixtures : public TestClass<Fixtures>
+    {
+        TEST_METHOD(memory_filesystem_reads_back_writes)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            std::error_code ec;
+            Assert::IsTrue(fs->create_directories("C:/root/dir", ec));
+            fs->write_lines("C:/root/dir/file.txt", {"a", "b"});
+
+            Assert::IsTrue(fs->is_regular_file("c:\\ROOT\\dir\\file.txt"));
+            Assert::IsTrue(fs->is_directory("C:/root"));
+            Assert::AreEqual(size_t(2), fs->read_lines("C:/root/dir/file.txt").value_or_exit(VCPKG_LINE_INFO).size());
+            Assert::AreEqual(size_t(2), fs->get_files_recursive("C:/root").size());
+
+            fs->rename("C:/root/dir", "C:/root/moved");
+            Assert::IsFalse(fs->exists("C:/root/dir/file.txt"));
+            Assert::AreEqual(std::string("a\nb\n"),
+                             fs->read_contents("C:/root/moved/file.txt").value_or_exit(VCPKG_LINE_INFO));
+
+            Assert::IsFalse(fs->remove("C:/root/missing"));
+            Assert::AreEqual(std::uintmax_t(3), fs->remove_all("C:/root", ec));
+        }
+
+        TEST_METHOD(memory_filesystem_lists_entries_with_attributes)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            std::error_code ec;
+            fs->create_directories("C:/root/dir", ec);
+            fs->write_contents("C:/root/dir/file.txt", "contents");
+
+            const std::vector<Files::DirectoryEntry> entries = fs->get_entries_recursive("C:/root");
+            Assert::AreEqual(size_t(2), entries.size());
+            Assert::IsTrue(fs::is_directory(entries[0].status));
+            Assert::AreEqual(std::uintmax_t(0), entries[0].size);
+            Assert::IsTrue(fs::is_regular_file(entries[1].status));
+            Assert::AreEqual(std::uintmax_t(8), entries[1].size);
+            Assert::AreEqual(size_t(1), fs->get_entries_non_recursive("C:/root").size());
+        }
+
+        TEST_METHOD(generated_root_loads_as_installed)
+        {
+            vcpkg::Fixtures::Parameters parameters;
+            parameters.port_count = 20;
+            parameters.feature_count = 2;
+            parameters.dependency_depth = 4;
+            parameters.installed_file_count = 3;
+            parameters.triplets = {Triplet::X86_WINDOWS, Triplet::X64_WINDOWS};
+
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_root(*fs, "C:/vcpkg", parameters);
+            Assert::IsTrue(fs->is_regular_file(paths.port_dir("port-19") / "CONTROL"));
+
+            const StatusParagraphs status_db = database_load_check(paths);
+            Assert::IsTrue(status_db.find_installed("port-19", Triplet::X64_WINDOWS) != status_db.end());
+
+            const auto installed = get_installed_files(paths, status_db);
+            Assert::AreEqual(size_t(40), installed.size());
+            Assert::AreEqual(size_t(3), installed.front().files.size());
+        }
+
+        TEST_METHOD(install_package_detects_conflicts_without_disk)
+        {
+            vcpkg::Fixtures::Parameters parameters;
+            parameters.port_count = 2;
+            parameters.feature_count = 0;
+            parameters.dependency_depth = 1;
+            parameters.installed_file_count = 1;
+            parameters.triplets = {Triplet::X86_WINDOWS};
+
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_root(*fs, "C:/vcpkg", parameters);
+            StatusParagraphs status_db = database_load_check(paths);
+
+            const auto write_package = [&](const std::string& name, const std::string& header) {
+                const PackageSpec spec =
+                    PackageSpec::from_name_and_triplet(name, Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+                const fs::path package_dir = paths.package_dir(spec);
+                std::error_code ec;
+                fs->create_directories(package_dir / "include" / "port-0", ec);
+                fs->write_contents(package_dir / "CONTROL",
+                                   "Package: " + name + "\nVersion: 1\nArchitecture: x86-windows\nMulti-Arch: same\n");
+                fs->write_contents(package_dir / "include" / "port-0" / header, Strings::EMPTY);
+                return Paragraphs::try_load_cached_control_package(paths, spec).value_or_exit(VCPKG_LINE_INFO);
+            };
+
+            using Commands::Install::InstallResult;
+            Assert::IsTrue(InstallResult::FILE_CONFLICTS ==
+                           Commands::Install::install_package(paths, write_package("clash", "header-0.h"), &status_db));
+            Assert::IsTrue(InstallResult::SUCCESS ==
+                           Commands::Install::install_package(paths, write_package("fresh", "fresh.h"), &status_db));
+            Assert::IsTrue(fs->is_regular_file("C:/vcpkg/installed/x86-windows/include/port-0/fresh.h"));
+            Assert::IsTrue(status_db.find_installed("fresh", Triplet::X86_WINDOWS) != status_db.end());
+        }
+
+        TEST_METHOD(prebuilt_root_installs_from_packages)
+        {
+            vcpkg::Fixtures::Parameters parameters;
+            parameters.port_count = 2;
+            parameters.feature_count = 0;
+            parameters.dependency_depth = 1;
+            parameters.installed_file_count = 2;
+            parameters.triplets = {Triplet::X86_WINDOWS};
+
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_prebuilt_root(*fs, "C:/vcpkg", parameters);
+            StatusParagraphs status_db = database_load_check(paths);
+            Assert::IsTrue(status_db.find_installed("port-0", Triplet::X86_WINDOWS) == status_db.end());
+
+            for (size_t i = 0; i < parameters.port_count; ++i)
+            {
+                const PackageSpec spec =
+                    PackageSpec::from_name_and_triplet(vcpkg::Fixtures::port_name(i), Triplet::X86_WINDOWS)
+                        .value_or_exit(VCPKG_LINE_INFO);
+                const BinaryControlFile bcf =
+                    Paragraphs::try_load_cached_control_package(paths, spec).value_or_exit(VCPKG_LINE_INFO);
+                Assert::IsTrue(Commands::Install::InstallResult::SUCCESS ==
+                               Commands::Install::install_package(paths, bcf, &status_db));
+            }
+
+            Assert::IsTrue(fs->is_regular_file("C:/vcpkg/installed/x86-windows/include/port-1/header-1.h"));
+            Assert::IsTrue(status_db.find_installed("port-1", Triplet::X86_WINDOWS) != status_db.end());
+        }
+
+        TEST_METHOD(remove_packages_trashes_directories_they_own)
+        {
+            vcpkg::Fixtures::Parameters parameters;
+            parameters.port_count = 2;
+            parameters.feature_count = 0;
+            parameters.dependency_depth = 1;
+            parameters.installed_file_count = 3;
+            parameters.triplets = {Triplet::X86_WINDOWS};
+
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_root(*fs, "C:/vcpkg", parameters);
+            std::error_code ec;
+            for (size_t i = 0; i < parameters.port_count; ++i)
+            {
+                for (auto&& line : vcpkg::Fixtures::generate_listfile(parameters, i, Triplet::X86_WINDOWS))
+                {
+                    if (line.back() == '/')
+                        fs->create_directories(paths.installed / line, ec);
+                    else
+                        fs->write_contents(paths.installed / line, Strings::EMPTY);
+                }
+            }
+            fs->write_contents("C:/vcpkg/installed/x86-windows/include/port-1/user.h", Strings::EMPTY);
+
+            StatusParagraphs status_db = database_load_check(paths);
+            const std::vector<PackageSpec> specs = {
+                PackageSpec::from_name_and_triplet("port-0", Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO),
+                PackageSpec::from_name_and_triplet("port-1", Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO)};
+            Commands::Remove::remove_packages(paths, specs, &status_db);
+
+            Assert::IsFalse(fs->exists("C:/vcpkg/installed/x86-windows/include/port-0"));
+            Assert::IsTrue(fs->exists("C:/vcpkg/installed/x86-windows/include/port-1/user.h"));
+            Assert::IsFalse(fs->exists("C:/vcpkg/installed/x86-windows/include/port-1/header-0.h"));
+            Assert::IsTrue(fs->get_files_non_recursive(paths.vcpkg_dir / "trash").empty());
+            Assert::IsTrue(status_db.find_installed(specs[0]) == status_db.end());
+        }
+    };
+}
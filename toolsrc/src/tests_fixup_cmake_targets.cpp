@@ -0,0 +1,53 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Commands.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+    using namespace Commands::FixupCmakeTargets;
+
+    class FixupCmakeTargets : public TestClass<FixupCmakeTargets>
+    {
+        TEST_METHOD(executables_are_relocated_like_the_regular_expression)
+        {
+            const std::string bin = "${_IMPORT_PREFIX}/bin/";
+            const std::string tools = "${_IMPORT_PREFIX}/tools/zlib/";
+
+            // The match ends at the last .exe before a quote, even past a name which is not an executable
+            Assert::AreEqual('"' + tools + "a.dll;" + bin + "b.exe\"",
+                             relocate_executables('"' + bin + "a.dll;" + bin + "b.exe\"", "zlib"));
+            Assert::AreEqual('"' + bin + "a.dll\" \"" + tools + "c.exe\"",
+                             relocate_executables('"' + bin + "a.dll\" \"" + bin + "c.exe\"", "zlib"));
+            Assert::AreEqual('"' + bin + ".exe\"", relocate_executables('"' + bin + ".exe\"", "zlib"));
+        }
+
+        TEST_METHOD(debug_targets_point_at_debug)
+        {
+            Assert::AreEqual(
+                std::string(R"("${_IMPORT_PREFIX}/debug/lib/z.lib" "${_IMPORT_PREFIX}/tools/zlib/z.exe")"),
+                relocate_debug_targets(R"("${_IMPORT_PREFIX}/lib/z.lib" "${_IMPORT_PREFIX}/bin/z.exe")", "zlib"));
+        }
+
+        TEST_METHOD(prefixes_are_two_directories_up)
+        {
+            const std::string list_file =
+                R"(get_filename_component(_IMPORT_PREFIX "${CMAKE_CURRENT_LIST_FILE}" PATH))";
+            const std::string parent = "\n" R"(get_filename_component(_IMPORT_PREFIX "${_IMPORT_PREFIX}" PATH))";
+            const std::string expected = "x\n" + list_file + parent + parent + "\ny";
+            Assert::AreEqual(expected, fix_import_prefix("x\n" + list_file + "\ny"));
+            Assert::AreEqual(expected, fix_import_prefix("x\n" + list_file + parent + parent + parent + "\ny"));
+
+            const std::string package_prefix =
+                R"(get_filename_component(PACKAGE_PREFIX_DIR "${CMAKE_CURRENT_LIST_DIR}/)";
+            Assert::AreEqual(package_prefix + R"(../../" ABSOLUTE))",
+                             fix_package_prefix(package_prefix + R"(../../../" ABSOLUTE))"));
+            Assert::AreEqual(package_prefix + R"(../x/" ABSOLUTE))",
+                             fix_package_prefix(package_prefix + R"(../x/" ABSOLUTE))"));
+        }
+    };
+}
@@ -0,0 +1,100 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Fixtures.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class GarbageCollect : public TestClass<GarbageCollect>
+    {
+        TEST_METHOD(parse_size_accepts_binary_suffixes)
+        {
+            using Commands::GarbageCollect::parse_size;
+            Assert::AreEqual(uint64_t(1000), parse_size("1000").value_or_exit(VCPKG_LINE_INFO));
+            Assert::AreEqual(uint64_t(512) << 20, parse_size("512M").value_or_exit(VCPKG_LINE_INFO));
+            Assert::AreEqual(uint64_t(20) << 30, parse_size("20GB").value_or_exit(VCPKG_LINE_INFO));
+            Assert::AreEqual(uint64_t(2) << 40, parse_size("2t").value_or_exit(VCPKG_LINE_INFO));
+            Assert::IsFalse(parse_size("").has_value());
+            Assert::IsFalse(parse_size("G").has_value());
+            Assert::IsFalse(parse_size("20 GB").has_value());
+            Assert::IsFalse(parse_size("20P").has_value());
+            Assert::IsFalse(parse_size("999999999999999T").has_value());
+        }
+
+        TEST_METHOD(collect_keeps_what_installed_packages_reference)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_small_root(*fs, "C:/vcpkg");
+            std::error_code ec;
+            fs->create_directories(paths.packages / "port-0_x86-windows", ec);
+            fs->create_directories(paths.packages / "zlib_x86-windows", ec);
+            fs->create_directories(paths.downloads / "distfiles", ec);
+            fs->create_directories(paths.downloads / "tools", ec);
+            fs->create_directories(paths.buildtrees / "zlib" / "src", ec);
+            fs->write_contents(paths.packages / "port-0_x86-windows" / "CONTROL", "Package: port-0\n");
+            fs->write_contents(paths.packages / "zlib_x86-windows" / "CONTROL", "Package: zlib\n");
+            fs->write_lines(paths.downloads / "distfiles" / "port-0.txt",
+                            {"Version: 1.0", "0123;port-0-1.0.tar.gz;https://example.com/port-0-1.0.tar.gz"});
+            fs->write_contents(paths.downloads / "port-0-1.0.tar.gz", "port-0 sources");
+            fs->write_contents(paths.downloads / "zlib-1.2.11.tar.gz", "zlib sources");
+            fs->write_contents(paths.downloads / "tools" / "tool.exe", "tool");
+            fs->write_contents(paths.buildtrees / "zlib" / "src" / "zlib.c", "zlib sources");
+            fs->write_contents(paths.buildtrees / "zlib" / "install-x86-windows-rel-out.log", "log");
+
+            const uint64_t evicted = Commands::GarbageCollect::collect(paths, 0, {}, false);
+
+            Assert::AreEqual(uint64_t(14 + 12 + 12), evicted);
+            Assert::IsTrue(fs->exists(paths.packages / "port-0_x86-windows"));
+            Assert::IsTrue(fs->exists(paths.downloads / "port-0-1.0.tar.gz"));
+            Assert::IsTrue(fs->exists(paths.downloads / "tools" / "tool.exe"));
+            Assert::IsTrue(fs->exists(paths.buildtrees / "zlib" / "install-x86-windows-rel-out.log"));
+            Assert::IsFalse(fs->exists(paths.packages / "zlib_x86-windows"));
+            Assert::IsFalse(fs->exists(paths.downloads / "zlib-1.2.11.tar.gz"));
+            Assert::IsFalse(fs->exists(paths.buildtrees / "zlib" / "src"));
+        }
+
+        TEST_METHOD(cache_index_follows_the_package_directories)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_small_root(*fs, "C:/vcpkg");
+            std::error_code ec;
+            fs->create_directories(paths.packages / "zlib_x86-windows", ec);
+            fs->create_directories(paths.packages / "png_x86-windows", ec);
+            fs->write_contents(paths.packages / "zlib_x86-windows" / "CONTROL",
+                               "Package: zlib\nVersion: 1.2\nArchitecture: x86-windows\nMulti-Arch: same\nAbi: 0123\n");
+            fs->write_contents(paths.packages / "png_x86-windows" / "CONTROL",
+                               "Package: png\nVersion: 1.6\nArchitecture: x86-windows\nMulti-Arch: same\n\n"
+                               "Package: png\nFeature: apng\nArchitecture: x86-windows\nMulti-Arch: same\n");
+
+            std::vector<Commands::Cache::CachedPackage> packages = Commands::Cache::load_cached_packages(paths);
+            Assert::AreEqual(size_t(2), packages.size());
+            Assert::AreEqual("png_x86-windows", packages[0].dir.c_str());
+            Assert::AreEqual(size_t(1), packages[0].features.size());
+            Assert::AreEqual("apng", packages[0].features[0].c_str());
+            Assert::AreEqual("zlib[core]:x86-windows", packages[1].displayname().c_str());
+            Assert::AreEqual("0123", packages[1].abi.c_str());
+            Assert::IsTrue(fs->exists(Commands::Cache::get_index_path(paths)));
+
+            // A record whose stamp still matches is used as it is, without reading the CONTROL file
+            packages[1].version = "from the index";
+            Commands::Cache::save_index(*fs, Commands::Cache::get_index_path(paths), packages);
+            packages = Commands::Cache::load_cached_packages(paths);
+            Assert::AreEqual("from the index", packages[1].version.c_str());
+
+            fs->write_contents(paths.packages / "zlib_x86-windows" / "CONTROL",
+                               "Package: zlib\nVersion: 1.2.11\nArchitecture: x86-windows\nMulti-Arch: same\n");
+            fs->remove_all(paths.packages / "png_x86-windows", ec);
+            packages = Commands::Cache::load_cached_packages(paths);
+            Assert::AreEqual(size_t(1), packages.size());
+            Assert::AreEqual("1.2.11", packages[0].version.c_str());
+            Assert::AreEqual("", packages[0].abi.c_str());
+        }
+    };
+}
@@ -0,0 +1,124 @@
+#include "CppUnitTest.h"
+#include "PackageSpec.h"
+#include "vcpkg_Graphs.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    static PackageSpec spec(const std::string& name)
+    {
+        return PackageSpec::from_name_and_triplet(name, Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+    }
+
+    static size_t position_of(const std::vector<PackageSpec>& sorted, const std::string& name)
+    {
+        const auto it = Util::find(sorted, spec(name));
+        Assert::IsTrue(it != sorted.cend());
+        return it - sorted.cbegin();
+    }
+
+    struct MapAdjacencyProvider final : Graphs::AdjacencyProvider<PackageSpec, PackageSpec>
+    {
+        std::unordered_map<PackageSpec, std::vector<PackageSpec>> edges;
+
+        std::vector<PackageSpec> adjacency_list(const PackageSpec& vertex) const override
+        {
+            const auto it = edges.find(vertex);
+            return it == edges.cend() ? std::vector<PackageSpec>{} : it->second;
+        }
+
+        PackageSpec load_vertex_data(const PackageSpec& vertex) const override { return vertex; }
+    };
+
+    class GraphTests : public TestClass<GraphTests>
+    {
+        TEST_METHOD(graph_sort_places_targets_first)
+        {
+            Graphs::Graph<PackageSpec> graph;
+            graph.add_edge(spec("a"), spec("b"));
+            graph.add_edge(spec("b"), spec("c"));
+            graph.add_edge(spec("a"), spec("c"));
+            graph.add_vertex(spec("d"));
+
+            const std::vector<PackageSpec> sorted = graph.topological_sort();
+            Assert::AreEqual(size_t(4), sorted.size());
+            Assert::IsTrue(position_of(sorted, "c") < position_of(sorted, "b"));
+            Assert::IsTrue(position_of(sorted, "b") < position_of(sorted, "a"));
+        }
+
+        TEST_METHOD(graph_sort_handles_duplicate_edges)
+        {
+            Graphs::Graph<PackageSpec> graph;
+            graph.add_edge(spec("a"), spec("b"));
+            graph.add_edge(spec("a"), spec("b"));
+
+            const std::vector<PackageSpec> sorted = graph.topological_sort();
+            Assert::AreEqual(size_t(2), sorted.size());
+            Assert::IsTrue(position_of(sorted, "b") < position_of(sorted, "a"));
+        }
+
+        TEST_METHOD(graph_sort_handles_deep_chains)
+        {
+            static constexpr int DEPTH = 100000;
+
+            Graphs::Graph<PackageSpec> graph;
+            for (int i = 0; i < DEPTH; ++i)
+            {
+                graph.add_edge(spec("p" + std::to_string(i)), spec("p" + std::to_string(i + 1)));
+            }
+
+            const std::vector<PackageSpec> sorted = graph.topological_sort();
+            Assert::AreEqual(size_t(DEPTH + 1), sorted.size());
+            Assert::AreEqual(spec("p" + std::to_string(DEPTH)).to_string(), sorted.front().to_string());
+            Assert::AreEqual(spec("p0").to_string(), sorted.back().to_string());
+        }
+
+        TEST_METHOD(provider_sort_visits_reachable_vertices_once)
+        {
+            MapAdjacencyProvider provider;
+            provider.edges[spec("a")] = {spec("b"), spec("c")};
+            provider.edges[spec("b")] = {spec("c")};
+
+            const std::vector<PackageSpec> sorted = Graphs::topological_sort({spec("a"), spec("b")}, provider);
+            Assert::AreEqual(size_t(3), sorted.size());
+            Assert::IsTrue(position_of(sorted, "c") < position_of(sorted, "b"));
+            Assert::IsTrue(position_of(sorted, "b") < position_of(sorted, "a"));
+        }
+
+        TEST_METHOD(graph_closure_covers_indirect_edges)
+        {
+            // More than 64 vertices, so that the sets span several words
+            Graphs::Graph<std::string> graph;
+            for (int i = 0; i < 99; ++i)
+            {
+                graph.add_edge("p" + std::to_string(i), "p" + std::to_string(i + 1));
+            }
+            graph.add_vertex("alone");
+
+            const std::vector<Graphs::VertexSet> dependencies = graph.transitive_closure();
+            const std::vector<Graphs::VertexSet> dependents = Graphs::transpose(dependencies);
+            const size_t first = graph.id_of("p0").value_or_exit(VCPKG_LINE_INFO);
+            const size_t last = graph.id_of("p99").value_or_exit(VCPKG_LINE_INFO);
+            const size_t alone = graph.id_of("alone").value_or_exit(VCPKG_LINE_INFO);
+
+            Assert::AreEqual(size_t(99), dependencies[first].size());
+            Assert::IsTrue(dependencies[first].contains(last));
+            Assert::IsFalse(dependencies[first].contains(first));
+            Assert::AreEqual(size_t(0), dependencies[last].size());
+            Assert::AreEqual(size_t(99), dependents[last].size());
+            Assert::IsFalse(dependents[last].intersects(dependents[alone]));
+
+            std::vector<size_t> ids;
+            const size_t middle = graph.id_of("p2").value_or_exit(VCPKG_LINE_INFO);
+            dependents[middle].for_each([&](const size_t id) { ids.push_back(id); });
+            Assert::AreEqual(size_t(2), ids.size());
+            Assert::AreEqual(first, ids[0]);
+        }
+    };
+}
@@ -0,0 +1,26 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Commands.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class Hashing : public TestClass<Hashing>
+    {
+        TEST_METHOD(string_hash_matches_known_digests)
+        {
+            Assert::AreEqual("a9993e364706816aba3e25717850c26c9cd0d89d",
+                             Commands::Hash::get_string_hash("abc", "SHA1").c_str());
+            Assert::AreEqual("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+                             Commands::Hash::get_string_hash("", "sha256").c_str());
+            Assert::AreEqual("ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                             "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",
+                             Commands::Hash::get_string_hash("abc", "SHA512").c_str());
+        }
+    };
+}
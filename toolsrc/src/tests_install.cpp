@@ -0,0 +1,242 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_ContentStore.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Fixtures.h"
+#include "vcpkglib.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class Install : public TestClass<Install>
+    {
+        /// <summary>
+        /// A root with nothing in it but the directory of the status database
+        /// </summary>
+        static VcpkgPaths create_empty_root(Files::Filesystem& fs)
+        {
+            const VcpkgPaths paths = VcpkgPaths::create("C:/vcpkg", fs).value_or_exit(VCPKG_LINE_INFO);
+            std::error_code ec;
+            fs.create_directories(paths.vcpkg_dir, ec);
+            return paths;
+        }
+
+        TEST_METHOD(replace_files_changes_only_what_differs)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            std::error_code ec;
+            fs->create_directories("C:/packages/zlib_1/include/old", ec);
+            fs->create_directories("C:/packages/zlib_1/share/zlib", ec);
+            fs->write_contents("C:/packages/zlib_1/CONTROL", "Package: zlib\n");
+            fs->write_contents("C:/packages/zlib_1/include/zlib.h", "unchanged");
+            fs->write_contents("C:/packages/zlib_1/include/zconf.h", "version 1");
+            fs->write_contents("C:/packages/zlib_1/include/old/gone.h", "removed");
+            fs->write_contents("C:/packages/zlib_1/share/zlib/copyright", "license");
+
+            const auto v1 = Commands::Install::InstallDir::from_destination_root(
+                "C:/installed", "x86-windows", "C:/installed/vcpkg/info/zlib_1_x86-windows.list");
+            Commands::Install::install_files_and_write_listfile(*fs, "C:/packages/zlib_1", v1);
+            const fs::path unchanged = "C:/installed/x86-windows/include/zlib.h";
+            const fs::file_time_type unchanged_time = fs->last_write_time(unchanged, ec);
+
+            fs->create_directories("C:/packages/zlib_2/include", ec);
+            fs->create_directories("C:/packages/zlib_2/share/zlib", ec);
+            fs->write_contents("C:/packages/zlib_2/CONTROL", "Package: zlib\n");
+            fs->write_contents("C:/packages/zlib_2/include/zlib.h", "unchanged");
+            fs->write_contents("C:/packages/zlib_2/include/zconf.h", "version 2");
+            fs->write_contents("C:/packages/zlib_2/include/new.h", "added");
+            fs->write_contents("C:/packages/zlib_2/share/zlib/copyright", "license");
+
+            const auto v2 = Commands::Install::InstallDir::from_destination_root(
+                "C:/installed", "x86-windows", "C:/installed/vcpkg/info/zlib_2_x86-windows.list");
+            Commands::Install::replace_files_and_write_listfile(
+                *fs, "C:/packages/zlib_2", v2, read_listfile_entries(*fs, v1.listfile()));
+
+            Assert::IsTrue(unchanged_time == fs->last_write_time(unchanged, ec));
+            const auto zconf = fs->read_contents("C:/installed/x86-windows/include/zconf.h");
+            Assert::AreEqual(std::string("version 2"), zconf.value_or_exit(VCPKG_LINE_INFO));
+            Assert::IsTrue(fs->exists("C:/installed/x86-windows/include/new.h"));
+            Assert::IsFalse(fs->exists("C:/installed/x86-windows/include/old"));
+
+            const auto lines = fs->read_lines(v2.listfile()).value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(size_t(8), lines.size());
+            Assert::IsTrue(Util::find(lines, "x86-windows/include/old/") == lines.cend());
+            Assert::IsTrue(Util::find(lines, "x86-windows/include/new.h") != lines.cend());
+        }
+
+        TEST_METHOD(deduplicated_files_share_a_store_entry)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            std::error_code ec;
+            fs->create_directories("C:/packages/zlib_x86-windows/include", ec);
+            fs->create_directories("C:/packages/zlib_x64-windows/include", ec);
+            fs->write_contents("C:/packages/zlib_x86-windows/include/zlib.h", "same header");
+            fs->write_contents("C:/packages/zlib_x64-windows/include/zlib.h", "same header");
+
+            using Commands::Install::InstallDir;
+            const auto x86 = InstallDir::from_destination_root(
+                "C:/installed", "x86-windows", "C:/installed/vcpkg/info/zlib_1_x86-windows.list");
+            const auto x64 = InstallDir::from_destination_root(
+                "C:/installed", "x64-windows", "C:/installed/vcpkg/info/zlib_1_x64-windows.list");
+            const auto to_store = Commands::Install::LinkFiles::TO_STORE;
+            Commands::Install::install_files_and_write_listfile(*fs, "C:/packages/zlib_x86-windows", x86, to_store);
+            Commands::Install::install_files_and_write_listfile(*fs, "C:/packages/zlib_x64-windows", x64, to_store);
+
+            const auto links = ContentStore::read_links(*fs, x86.listfile());
+            Assert::AreEqual(size_t(1), links.size());
+            Assert::AreEqual(std::string("x86-windows/include/zlib.h"), links[0].path);
+            Assert::IsTrue(links[0].key == ContentStore::read_links(*fs, x64.listfile()).at(0).key);
+            Assert::AreEqual(uintmax_t(3), fs->hard_link_count("C:/installed/x64-windows/include/zlib.h", ec));
+
+            const std::string& key = links[0].key;
+            const fs::path entry = x86.store_dir() / key.substr(0, 2) / key;
+            Assert::IsTrue(fs->exists(entry));
+            fs->remove("C:/installed/x86-windows/include/zlib.h", ec);
+            ContentStore::release(*fs, x86.store_dir(), {key});
+            Assert::IsTrue(fs->exists(entry));
+
+            fs->remove("C:/installed/x64-windows/include/zlib.h", ec);
+            ContentStore::release(*fs, x86.store_dir(), {key});
+            Assert::IsFalse(fs->exists(entry));
+        }
+
+        TEST_METHOD(build_times_are_kept_per_port_and_triplet)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = create_empty_root(*fs);
+            const auto x86 =
+                PackageSpec::from_name_and_triplet("qt5", Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            const auto x64 =
+                PackageSpec::from_name_and_triplet("qt5", Triplet::X64_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+
+            Build::BuildTimes build_times = Build::BuildTimes::load(paths);
+            Assert::IsFalse(build_times.mean().has_value());
+            build_times.record(x86, 3000000);
+            build_times.record(x64, 1000000);
+            build_times.save(paths);
+
+            const Build::BuildTimes loaded = Build::BuildTimes::load(paths);
+            Assert::AreEqual(3000000.0, loaded.find(x86).value_or_exit(VCPKG_LINE_INFO));
+            Assert::AreEqual(1000000.0, loaded.find(x64).value_or_exit(VCPKG_LINE_INFO));
+            Assert::AreEqual(2000000.0, loaded.mean().value_or_exit(VCPKG_LINE_INFO));
+            Assert::IsFalse(loaded.find_peak_memory_mib(x86).has_value());
+        }
+
+        TEST_METHOD(build_times_keep_peak_memory)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = create_empty_root(*fs);
+            const auto spec =
+                PackageSpec::from_name_and_triplet("llvm", Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+
+            Build::BuildTimes build_times = Build::BuildTimes::load(paths);
+            build_times.record(spec, 5000000);
+            build_times.record_peak_memory(spec, 6144);
+            build_times.save(paths);
+
+            const Build::BuildTimes loaded = Build::BuildTimes::load(paths);
+            Assert::AreEqual(5000000.0, loaded.find(spec).value_or_exit(VCPKG_LINE_INFO));
+            Assert::AreEqual(size_t(6144), loaded.find_peak_memory_mib(spec).value_or_exit(VCPKG_LINE_INFO));
+        }
+
+        TEST_METHOD(requested_actions_come_right_after_their_dependencies)
+        {
+            // 0 and 1 are dependencies of the request 3, 2 of the request 4; 5 was needed by no request
+            const std::vector<std::vector<size_t>> dependencies = {{}, {0}, {}, {1, 0}, {2, 0}, {3}};
+            const std::vector<size_t> order = Commands::Install::order_by_requests(dependencies, {4, 3});
+            Assert::IsTrue(order == std::vector<size_t>{0, 2, 4, 1, 3, 5});
+
+            const std::vector<size_t> unchanged = Commands::Install::order_by_requests(dependencies, {});
+            Assert::IsTrue(unchanged == std::vector<size_t>{0, 1, 2, 3, 4, 5});
+        }
+
+        TEST_METHOD(sorted_runs_merge_and_gallop)
+        {
+            const std::vector<std::string> merged = merge_sorted_runs(
+                std::vector<std::vector<std::string>>{{"bin/a.dll", "include/a.h"}, {"bin/b.dll"}, {}, {"lib/a.lib"}},
+                std::less<>());
+            Assert::IsTrue(merged ==
+                           std::vector<std::string>{"bin/a.dll", "bin/b.dll", "include/a.h", "lib/a.lib"});
+
+            std::vector<int> installed(100000);
+            for (size_t i = 0; i < installed.size(); ++i)
+                installed[i] = static_cast<int>(i * 2);
+
+            auto it = installed.cbegin();
+            for (const int file : {3, 4, 98765, 199998, 200001})
+            {
+                it = gallop_lower_bound(it, installed.cend(), file, std::less<>());
+                Assert::IsTrue(it == std::lower_bound(installed.cbegin(), installed.cend(), file));
+            }
+
+            const SortedVector<std::string> files(std::vector<std::string>{"include/a.h", "bin/a.dll"});
+            Assert::IsTrue(files.contains(std::string_view("include/a.h")));
+            Assert::IsFalse(files.contains(std::string_view("include")));
+        }
+
+        TEST_METHOD(verify_finds_and_repairs_drifted_files)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_small_root(*fs, "C:/vcpkg");
+            StatusParagraphs status_db = database_load_check(paths);
+
+            const PackageSpec spec =
+                PackageSpec::from_name_and_triplet("fresh", Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            const BinaryControlFile bcf = vcpkg::Fixtures::write_built_package(
+                paths, spec, Strings::EMPTY, {{"fresh.h", "int fresh;"}, {"gone.h", "int gone;"}});
+            Assert::IsTrue(Commands::Install::InstallResult::SUCCESS ==
+                           Commands::Install::install_package(paths, bcf, &status_db));
+
+            using Commands::Verify::FileState;
+            Assert::IsTrue(Commands::Verify::verify(paths, status_db, true).empty());
+
+            // An edit which keeps the size is only found by comparing the contents
+            const fs::path fresh_header = paths.installed / "x86-windows" / "include" / "fresh.h";
+            fs->write_contents(fresh_header, "int stale;");
+            std::error_code ec;
+            fs->remove(paths.installed / "x86-windows" / "include" / "gone.h", ec);
+            Assert::AreEqual(size_t(1), Commands::Verify::verify(paths, status_db, false).front().files.size());
+
+            const auto drift = Commands::Verify::verify(paths, status_db, true);
+            Assert::AreEqual(size_t(1), drift.size());
+            Assert::AreEqual("fresh", drift[0].spec.name().c_str());
+            Assert::IsTrue(drift[0].has_package_dir);
+            Assert::AreEqual(size_t(2), drift[0].files.size());
+            Assert::AreEqual("x86-windows/include/fresh.h", drift[0].files[0].path.c_str());
+            Assert::IsTrue(FileState::WRONG_CONTENTS == drift[0].files[0].state);
+            Assert::IsTrue(FileState::MISSING == drift[0].files[1].state);
+
+            Assert::AreEqual(size_t(0), Commands::Verify::repair(paths, drift));
+            Assert::AreEqual(std::string("int fresh;"), fs->read_contents(fresh_header).value_or_exit(VCPKG_LINE_INFO));
+            Assert::IsTrue(Commands::Verify::verify(paths, status_db, true).empty());
+        }
+
+        TEST_METHOD(install_package_skips_package_installed_with_same_abi)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const VcpkgPaths paths = vcpkg::Fixtures::create_small_root(*fs, "C:/vcpkg");
+            StatusParagraphs status_db = database_load_check(paths);
+
+            const PackageSpec spec =
+                PackageSpec::from_name_and_triplet("fresh", Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            const BinaryControlFile bcf =
+                vcpkg::Fixtures::write_built_package(paths, spec, "1234", {{"fresh.h", "int fresh;"}});
+            Assert::IsTrue(Commands::Install::InstallResult::SUCCESS ==
+                           Commands::Install::install_package(paths, bcf, &status_db));
+
+            // The files are left as they are, since the package would put the same ones in place
+            const fs::path fresh_header = paths.installed / "x86-windows" / "include" / "fresh.h";
+            fs->write_contents(fresh_header, "int edited;");
+            Assert::IsTrue(Commands::Install::InstallResult::SUCCESS ==
+                           Commands::Install::install_package(paths, bcf, &status_db));
+            Assert::AreEqual(std::string("int edited;"),
+                             fs->read_contents(fresh_header).value_or_exit(VCPKG_LINE_INFO));
+        }
+    };
+}
@@ -0,0 +1,100 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Listfile.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class Listfile : public TestClass<Listfile>
+    {
+        static std::vector<vcpkg::Listfile::Entry> create_entries()
+        {
+            std::vector<vcpkg::Listfile::Entry> entries;
+            entries.push_back({"x86-windows", true, nullopt});
+            entries.push_back({"x86-windows/include", true, nullopt});
+            entries.push_back({"x86-windows/include/FLAC", true, nullopt});
+            entries.push_back({"x86-windows/include/FLAC++", true, nullopt});
+            for (int i = 0; i < 50; ++i)
+            {
+                const uint64_t size = 1000 * i;
+                entries.push_back({Strings::format("x86-windows/include/FLAC/format%d.h", i), false, size});
+                entries.push_back({Strings::format("x86-windows/include/FLAC++/decoder%d.h", i), false, size});
+            }
+            return entries;
+        }
+
+        TEST_METHOD(binary_listfile_round_trip)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const fs::path listfile = "C:/installed/vcpkg/info/libflac_1.3.2_x86-windows.list";
+            std::error_code ec;
+            fs->create_directories(listfile.parent_path(), ec);
+            vcpkg::Listfile::write(*fs, listfile, create_entries());
+
+            const auto lines = fs->read_lines(listfile).value_or_exit(VCPKG_LINE_INFO);
+            Assert::IsTrue(std::is_sorted(lines.cbegin(), lines.cend()));
+
+            const auto entries = vcpkg::Listfile::try_read_binary(*fs, listfile).value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(lines.size(), entries.size());
+            for (size_t i = 0; i < lines.size(); ++i)
+            {
+                Assert::AreEqual(lines[i], entries[i].to_line());
+            }
+
+            const auto big = std::find_if(entries.cbegin(), entries.cend(), [](const vcpkg::Listfile::Entry& e) {
+                return e.path == "x86-windows/include/FLAC/format49.h";
+            });
+            Assert::IsTrue(big != entries.cend());
+            Assert::AreEqual(uint64_t(49000), big->size.value_or_exit(VCPKG_LINE_INFO));
+
+            const auto file = fs->map_contents(vcpkg::Listfile::binary_listfile_path(listfile));
+            const auto maybe_binary = vcpkg::Listfile::BinaryListfile::parse(file.value_or_exit(VCPKG_LINE_INFO));
+            const auto& binary = maybe_binary.value_or_exit(VCPKG_LINE_INFO);
+            for (const std::string& line : lines)
+            {
+                Assert::IsTrue(binary.contains(line));
+            }
+            Assert::IsFalse(binary.contains("x86-windows/include/FLAC"));
+            Assert::IsFalse(binary.contains("x86-windows/include/FLAC/format5.h/"));
+            Assert::IsFalse(binary.contains("zlib"));
+            Assert::IsFalse(binary.contains(""));
+        }
+
+        TEST_METHOD(binary_listfile_is_ignored_when_stale)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const fs::path listfile = "C:/installed/vcpkg/info/libflac_1.3.2_x86-windows.list";
+            std::error_code ec;
+            fs->create_directories(listfile.parent_path(), ec);
+            vcpkg::Listfile::write(*fs, listfile, create_entries());
+            Assert::IsTrue(vcpkg::Listfile::try_read_binary(*fs, listfile).has_value());
+
+            fs->write_lines(listfile, {"x86-windows/", "x86-windows/include/"});
+            Assert::IsFalse(vcpkg::Listfile::try_read_binary(*fs, listfile).has_value());
+
+            vcpkg::Listfile::write(*fs, listfile, create_entries());
+            fs->write_contents(vcpkg::Listfile::binary_listfile_path(listfile), "VCPKGLST");
+            Assert::IsFalse(vcpkg::Listfile::try_read_binary(*fs, listfile).has_value());
+        }
+
+        TEST_METHOD(listed_paths_are_generic_utf8)
+        {
+            const fs::path package_dir = L"C:\\packages\\zlib_x86-windows";
+            const fs::path file = package_dir / L"include" / L"z\u00e9lib.h";
+            Assert::AreEqual(std::string("include/z\xc3\xa9lib.h"),
+                             Files::generic_u8_suffix(file, package_dir.native().size()));
+            Assert::AreEqual(std::string(), Files::generic_u8_suffix(package_dir, package_dir.native().size()));
+
+            Assert::IsTrue(Files::is_package_metadata_file(package_dir / L"CONTROL"));
+            Assert::IsTrue(Files::is_package_metadata_file(package_dir / L"build_info"));
+            Assert::IsFalse(Files::is_package_metadata_file(package_dir / L"CONTROLS"));
+            Assert::IsFalse(Files::is_package_metadata_file(package_dir / L"include" / L"control.h"));
+        }
+    };
+}
@@ -0,0 +1,135 @@
+#include "CppUnitTest.h"
+#include "vcpkg_ChunkStore.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_PackageArchive.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class PackageArchive : public TestClass<PackageArchive>
+    {
+        // The archives are read and written with file streams, so these run against a temporary directory
+        static fs::path create_package(Files::Filesystem& fs, const fs::path& root)
+        {
+            std::error_code ec;
+            fs.remove_all(root, ec);
+            const fs::path package_dir = root / "zlib_x86-windows";
+            fs.create_directories(package_dir / "include", ec);
+            fs.create_directories(package_dir / "share" / "zlib", ec);
+            fs.write_contents(package_dir / "CONTROL", "Package: zlib\nVersion: 1.2.11\nArchitecture: x86-windows\n");
+            fs.write_contents(package_dir / "include" / "zlib.h", std::string(3 * 1024 * 1024, 'z'));
+            fs.write_contents(package_dir / "share" / "zlib" / "copyright", std::string());
+            return package_dir;
+        }
+
+        TEST_METHOD(package_archive_round_trip)
+        {
+            auto& fs = Files::get_real_filesystem();
+            const fs::path root = fs::stdfs::temp_directory_path() / "vcpkg-test-package-archive";
+            const fs::path package_dir = create_package(fs, root);
+            const fs::path archive = root / "zlib.vpkg";
+
+            const auto created = vcpkg::PackageArchive::create(fs, package_dir, archive).value_or_exit(VCPKG_LINE_INFO);
+            const auto table = vcpkg::PackageArchive::read_table(archive).value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(created.size(), table.size());
+            for (size_t i = 0; i < table.size(); ++i)
+            {
+                Assert::AreEqual(created[i].path, table[i].path);
+                Assert::AreEqual(created[i].sha256, table[i].sha256);
+            }
+
+            const auto zlib_h = std::find_if(table.cbegin(), table.cend(), [](const vcpkg::PackageArchive::Entry& e) {
+                return e.path == "include/zlib.h";
+            });
+            Assert::IsTrue(zlib_h != table.cend());
+            Assert::AreEqual(uint64_t(3 * 1024 * 1024), zlib_h->size);
+
+            const fs::path extracted = root / "extracted";
+            Assert::IsTrue(vcpkg::PackageArchive::extract(fs, archive, extracted).has_value());
+            Assert::AreEqual(fs.read_contents(package_dir / "include" / "zlib.h").value_or_exit(VCPKG_LINE_INFO),
+                             fs.read_contents(extracted / "include" / "zlib.h").value_or_exit(VCPKG_LINE_INFO));
+            Assert::IsTrue(fs.is_directory(extracted / "share" / "zlib"));
+            Assert::IsTrue(fs.exists(extracted / "share" / "zlib" / "copyright"));
+
+            std::error_code ec;
+            fs.remove_all(root, ec);
+        }
+
+        TEST_METHOD(package_archive_detects_corruption)
+        {
+            auto& fs = Files::get_real_filesystem();
+            const fs::path root = fs::stdfs::temp_directory_path() / "vcpkg-test-package-archive-corrupt";
+            const fs::path package_dir = create_package(fs, root);
+            const fs::path archive = root / "zlib.vpkg";
+            Assert::IsTrue(vcpkg::PackageArchive::create(fs, package_dir, archive).has_value());
+
+            std::string contents = fs.read_contents(archive).value_or_exit(VCPKG_LINE_INFO);
+            contents.back() ^= 1;
+            fs.write_contents(archive, contents);
+            Assert::IsFalse(vcpkg::PackageArchive::extract(fs, archive, root / "extracted").has_value());
+
+            fs.write_contents(archive, "PK\x03\x04");
+            Assert::IsFalse(vcpkg::PackageArchive::read_table(archive).has_value());
+
+            std::error_code ec;
+            fs.remove_all(root, ec);
+        }
+
+        static std::string make_random_bytes(const size_t size, uint32_t seed)
+        {
+            std::string bytes(size, '\0');
+            for (auto&& byte : bytes)
+            {
+                seed = seed * 1664525 + 1013904223;
+                byte = static_cast<char>(seed >> 24);
+            }
+            return bytes;
+        }
+
+        TEST_METHOD(chunks_survive_an_insertion)
+        {
+            auto& fs = Files::get_real_filesystem();
+            const fs::path root = fs::stdfs::temp_directory_path() / "vcpkg-test-chunk-store";
+            std::error_code ec;
+            fs.remove_all(root, ec);
+            fs.create_directories(root / "aa", ec);
+
+            const std::string old_contents = make_random_bytes(8 * 1024 * 1024, 1);
+            const fs::path old_archive = root / "aa" / "aaaa.vpkg";
+            fs.write_contents(old_archive, old_contents);
+            const auto old_chunks = ChunkStore::index_archive(fs, old_archive).value_or_exit(VCPKG_LINE_INFO);
+            Assert::IsTrue(fs.exists(ChunkStore::get_index_path(old_archive)));
+            for (auto&& chunk : old_chunks)
+            {
+                Assert::IsTrue(chunk.size <= ChunkStore::MAX_CHUNK_SIZE);
+                Assert::IsTrue(chunk.size >= ChunkStore::MIN_CHUNK_SIZE || &chunk == &old_chunks.back());
+            }
+
+            // Bytes inserted at the start only change the chunks around them
+            const std::string new_contents = "a new header" + old_contents;
+            const fs::path new_archive = root / "new.vpkg";
+            fs.write_contents(new_archive, new_contents);
+            const auto new_chunks = ChunkStore::split_file(new_archive).value_or_exit(VCPKG_LINE_INFO);
+            const auto parsed = ChunkStore::parse_index(ChunkStore::format_index(new_chunks));
+            Assert::AreEqual(new_chunks.size(), parsed.value_or_exit(VCPKG_LINE_INFO).size());
+            Assert::AreEqual(new_chunks.back().offset, parsed.value_or_exit(VCPKG_LINE_INFO).back().offset);
+
+            const fs::path assembled = root / "assembled.vpkg";
+            const auto fetch = [&](const ChunkStore::Chunk& chunk, std::string& data) {
+                return ChunkStore::read_chunk(new_archive, chunk, data);
+            };
+            const uint64_t fetched_bytes =
+                ChunkStore::assemble(fs, root, new_chunks, assembled, fetch).value_or_exit(VCPKG_LINE_INFO);
+            Assert::IsTrue(fetched_bytes < new_contents.size() / 4);
+            Assert::IsTrue(new_contents == fs.read_contents(assembled).value_or_exit(VCPKG_LINE_INFO));
+
+            fs.remove_all(root, ec);
+        }
+    };
+}
@@ -49,6 +49,23 @@ namespace UnitTest1
                 Assert::AreEqual(*specs[i], fspecs[i].spec());
             }
         }
+
+        TEST_METHOD(package_spec_names_are_interned)
+        {
+            auto a_spec = PackageSpec::from_name_and_triplet("a", Triplet::X64_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            auto a_spec2 = PackageSpec::from_name_and_triplet("a", Triplet::X64_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            auto a_x86 = PackageSpec::from_name_and_triplet("a", Triplet::X86_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            auto b_spec = PackageSpec::from_name_and_triplet("b", Triplet::X64_WINDOWS).value_or_exit(VCPKG_LINE_INFO);
+            auto empty_spec = PackageSpec::from_name_and_triplet("", Triplet()).value_or_exit(VCPKG_LINE_INFO);
+
+            Assert::IsTrue(&a_spec.name() == &a_spec2.name());
+            Assert::AreEqual(a_spec, a_spec2);
+            Assert::AreEqual(std::hash<PackageSpec>()(a_spec), std::hash<PackageSpec>()(a_spec2));
+            Assert::IsTrue(a_spec != a_x86);
+            Assert::IsTrue(a_spec != b_spec);
+            Assert::AreEqual(PackageSpec(), empty_spec);
+            Assert::AreEqual("a:x64-windows", a_spec.to_string().c_str());
+        }
     };
 
     class SpecifierParsing : public TestClass<SpecifierParsing>
@@ -113,6 +130,12 @@ namespace UnitTest1
             auto str = vcpkg::Strings::to_utf16("abc -x86-windows");
             Assert::AreEqual(L"abc -x86-windows", str.c_str());
         }
+
+        TEST_METHOD(collapse_whitespace_and_replace_all)
+        {
+            Assert::AreEqual(" a b c ", vcpkg::Strings::collapse_whitespace(" a \t\r\n b  c\n").c_str());
+            Assert::AreEqual("a``b``", vcpkg::Strings::replace_all("a`b`", "`", "``").c_str());
+        }
     };
 
     TEST_CLASS(Metrics){};
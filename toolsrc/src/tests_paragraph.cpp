@@ -1,6 +1,8 @@
 #include "BinaryParagraph.h"
 #include "CppUnitTest.h"
 #include "Paragraphs.h"
+#include "StatusParagraphs.h"
+#include "vcpkg_PortIndex.h"
 #include "vcpkg_Strings.h"
 
 #pragma comment(lib, "version")
@@ -137,6 +139,31 @@ namespace UnitTest1
             Assert::AreEqual("uwp", pgh->core_paragraph->depends[1].qualifier.c_str());
         }
 
+        TEST_METHOD(SourceControlFile_Resolves_Dependencies_Per_Triplet)
+        {
+            auto m_pgh =
+                vcpkg::SourceControlFile::parse_control_file(std::vector<std::unordered_map<std::string, std::string>>{
+                    {{"Source", "zlib"}, {"Version", "1.2.8"}, {"Build-Depends", "libA (windows), libB (uwp)"}},
+                    {{"Feature", "ssl"}, {"Description", ""}, {"Build-Depends", "openssl[tools,core]"}},
+                });
+            Assert::IsTrue(m_pgh.has_value());
+            auto& pgh = *m_pgh.get();
+
+            const vcpkg::ResolvedDependencies& uwp = pgh->resolve_dependencies(vcpkg::Triplet::X86_UWP);
+            Assert::AreEqual(size_t(1), uwp.core.size());
+            Assert::AreEqual("libB", uwp.core[0].name().c_str());
+            Assert::AreEqual("", uwp.core[0].feature().c_str());
+            Assert::IsTrue(&uwp == &pgh->resolve_dependencies(vcpkg::Triplet::X86_UWP));
+
+            const vcpkg::ResolvedDependencies& windows = pgh->resolve_dependencies(vcpkg::Triplet::X64_WINDOWS);
+            Assert::AreEqual(size_t(1), windows.core.size());
+            Assert::AreEqual("libA", windows.core[0].name().c_str());
+            const auto& ssl = windows.features.at("ssl");
+            Assert::AreEqual(size_t(2), ssl.size());
+            Assert::AreEqual("tools", ssl[0].feature().c_str());
+            Assert::AreEqual(vcpkg::Triplet::X64_WINDOWS.canonical_name(), ssl[1].triplet().canonical_name());
+        }
+
         TEST_METHOD(BinaryParagraph_Construct_Minimum)
         {
             vcpkg::BinaryParagraph pgh({
@@ -282,6 +309,22 @@ namespace UnitTest1
             Assert::AreEqual("\n f2\n continue", pghs[0]["f2"].c_str());
         }
 
+        TEST_METHOD(parse_paragraph_views_multiline_fields)
+        {
+            auto views = vcpkg::Paragraphs::parse_paragraph_views("f1: simple\n"
+                                                                  " f1\r\n"
+                                                                  "f2:\r\n"
+                                                                  " f2\r\n"
+                                                                  " continue\r\n");
+            Assert::AreEqual(size_t(1), views.paragraphs.size());
+            const auto& fields = views.paragraphs[0].fields;
+            Assert::AreEqual(size_t(2), fields.size());
+            Assert::AreEqual("f1", std::string(fields[0].name).c_str());
+            Assert::AreEqual("simple\n f1", vcpkg::Parse::normalize_field_value(fields[0].value).c_str());
+            Assert::AreEqual("f2", std::string(fields[1].name).c_str());
+            Assert::AreEqual("\n f2\n continue", vcpkg::Parse::normalize_field_value(fields[1].value).c_str());
+        }
+
         TEST_METHOD(parse_paragraphs_crlfs)
         {
             const char* str = "f1: v1\r\n"
@@ -299,6 +342,20 @@ namespace UnitTest1
             Assert::AreEqual("v4", pghs[1]["f4"].c_str());
         }
 
+        TEST_METHOD(parse_paragraphs_lines_longer_than_a_block)
+        {
+            const char* str = "Field-Name-Longer-Than-Sixteen: a value which is longer than sixteen bytes\r\n"
+                              " and continues: after a colon\r\n"
+                              "# a comment which is longer than sixteen bytes\n"
+                              "f2:v2\n";
+            auto pghs = vcpkg::Paragraphs::parse_paragraphs(str).value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(size_t(1), pghs.size());
+            Assert::AreEqual(size_t(2), pghs[0].size());
+            Assert::AreEqual("a value which is longer than sixteen bytes\n and continues: after a colon",
+                             pghs[0]["Field-Name-Longer-Than-Sixteen"].c_str());
+            Assert::AreEqual("v2", pghs[0]["f2"].c_str());
+        }
+
         TEST_METHOD(parse_paragraphs_comment)
         {
             const char* str = "f1: v1\r\n"
@@ -329,6 +386,63 @@ namespace UnitTest1
             Assert::AreEqual("v1", pghs[0]["f1"].c_str());
         }
 
+        TEST_METHOD(scan_port_name_and_version_first_paragraph)
+        {
+            const std::string str = "# comment\r\n"
+                                    "\r\n"
+                                    "Source: zlib\r\n"
+                                    "Description: a\r\n"
+                                    "  Version: not a field\r\n"
+                                    "Version:  1.2.11 \r\n"
+                                    "\r\n"
+                                    "Feature: f\r\n"
+                                    "Version: 2\r\n";
+            auto result = vcpkg::Paragraphs::scan_port_name_and_version({str.data(), str.size()});
+            Assert::IsTrue(result.has_value());
+            Assert::AreEqual("zlib", result.get()->first.c_str());
+            Assert::AreEqual("1.2.11", result.get()->second.to_string().c_str());
+
+            const std::string no_source = "Version: 1\n";
+            Assert::IsFalse(
+                vcpkg::Paragraphs::scan_port_name_and_version({no_source.data(), no_source.size()}).has_value());
+        }
+
+        TEST_METHOD(port_index_finds_each_port_by_hash)
+        {
+            std::vector<vcpkg::PortIndex::PortEntry> ports;
+            for (int i = 0; i < 50; ++i)
+            {
+                const std::string name = "port" + std::to_string(i);
+                ports.push_back({name,
+                                 std::to_string(i) + ":0",
+                                 vcpkg::Paragraphs::parse_paragraph_views("Source: " + name + "\nVersion: " +
+                                                                          std::to_string(i) +
+                                                                          "\n\nFeature: f\nDescription: d\n")});
+            }
+
+            const auto bytes = std::make_shared<const std::string>(
+                vcpkg::PortIndex::serialize(ports).value_or_exit(VCPKG_LINE_INFO));
+            const vcpkg::Files::MappedFile file{std::shared_ptr<const char>(bytes, bytes->data()), bytes->size()};
+            const auto table = vcpkg::PortIndex::Table::from_file(file);
+            Assert::AreEqual(size_t(50), table.size());
+
+            for (int i = 0; i < 50; ++i)
+            {
+                const auto entry = table.find("port" + std::to_string(i));
+                Assert::IsTrue(entry.has_value());
+                Assert::AreEqual(std::to_string(i) + ":0", std::string(entry.get()->stamp));
+
+                const auto& pghs = entry.get()->paragraphs.paragraphs;
+                Assert::AreEqual(size_t(2), pghs.size());
+                Assert::AreEqual(std::to_string(i), std::string(pghs[0].fields[1].value));
+                Assert::AreEqual(std::string("f"), std::string(pghs[1].fields[0].value));
+            }
+            Assert::IsFalse(table.find("zlib").has_value());
+
+            const vcpkg::Files::MappedFile truncated{file.data, file.size - 1};
+            Assert::AreEqual(size_t(0), vcpkg::PortIndex::Table::from_file(truncated).size());
+        }
+
         TEST_METHOD(BinaryParagraph_serialize_min)
         {
             vcpkg::BinaryParagraph pgh({
@@ -384,5 +498,156 @@ namespace UnitTest1
             Assert::AreEqual(size_t(1), pghs.size());
             Assert::AreEqual("a, b, c", pghs[0]["Depends"].c_str());
         }
+
+        TEST_METHOD(BinaryParagraph_serialize_abi)
+        {
+            vcpkg::BinaryParagraph pgh({
+                {"Package", "zlib"},
+                {"Version", "1.2.8"},
+                {"Architecture", "x86-windows"},
+                {"Multi-Arch", "same"},
+                {"Abi", "abcd123"},
+            });
+            Assert::AreEqual("abcd123", pgh.abi.c_str());
+
+            std::string ss = Strings::serialize(pgh);
+            auto pghs = vcpkg::Paragraphs::parse_paragraphs(ss).value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(size_t(1), pghs.size());
+            Assert::AreEqual("abcd123", pghs[0]["Abi"].c_str());
+        }
+
+        TEST_METHOD(serialized_size_is_that_of_the_text)
+        {
+            vcpkg::StatusParagraph pgh(std::unordered_map<std::string, std::string>{
+                {"Package", "curl"},
+                {"Version", "7.55.1"},
+                {"Architecture", "x64-windows"},
+                {"Multi-Arch", "same"},
+                {"Depends", "openssl, zlib"},
+                {"Description", "A library for transferring data with URLs"},
+                {"Abi", "abcd123"},
+                {"Status", "install ok half-installed"},
+            });
+
+            std::string text;
+            serialize(pgh, text);
+            Assert::AreEqual(text.size(), vcpkg::serialized_size(pgh));
+            Assert::AreEqual(vcpkg::Strings::serialize(pgh.package).size(), vcpkg::serialized_size(pgh.package));
+            Assert::IsTrue(text.find("Depends: openssl, zlib\n") != std::string::npos);
+            Assert::IsTrue(text.find("Status: install ok half-installed\n") != std::string::npos);
+        }
+
+        TEST_METHOD(StatusParagraphs_find_last_writer_wins)
+        {
+            auto make_pgh = [](const char* version, const char* status) {
+                return std::make_unique<vcpkg::StatusParagraph>(std::unordered_map<std::string, std::string>{
+                    {"Package", "zlib"},
+                    {"Version", version},
+                    {"Architecture", "x86-windows"},
+                    {"Multi-Arch", "same"},
+                    {"Status", status},
+                });
+            };
+
+            std::vector<std::unique_ptr<vcpkg::StatusParagraph>> pghs;
+            pghs.push_back(make_pgh("1.2.8", "install ok installed"));
+            pghs.push_back(make_pgh("1.2.11", "purge ok not-installed"));
+            vcpkg::StatusParagraphs status_db(std::move(pghs));
+
+            const auto it = status_db.find("zlib", vcpkg::Triplet::X86_WINDOWS);
+            Assert::IsTrue(it != status_db.end());
+            Assert::AreEqual("1.2.11", (*it)->package.version.c_str());
+            Assert::AreEqual(size_t(2), status_db.find_all("zlib", vcpkg::Triplet::X86_WINDOWS).size());
+            Assert::IsTrue(status_db.find_installed("zlib", vcpkg::Triplet::X86_WINDOWS) == status_db.end());
+            Assert::IsTrue(status_db.find("zlib", vcpkg::Triplet::X64_WINDOWS) == status_db.end());
+
+            status_db.insert(make_pgh("1.2.11", "install ok installed"));
+            const auto installed = status_db.find_installed("zlib", vcpkg::Triplet::X86_WINDOWS);
+            Assert::IsTrue(installed != status_db.end());
+            Assert::AreEqual("1.2.11", (*installed)->package.version.c_str());
+            Assert::AreEqual(size_t(2), status_db.find_all("zlib", vcpkg::Triplet::X86_WINDOWS).size());
+        }
+
+        TEST_METHOD(StatusParagraphs_insert_keeps_paragraphs_in_place)
+        {
+            auto make_pgh = [](const std::string& name) {
+                return vcpkg::StatusParagraph(std::unordered_map<std::string, std::string>{
+                    {"Package", name},
+                    {"Version", "1.0"},
+                    {"Architecture", "x86-windows"},
+                    {"Multi-Arch", "same"},
+                    {"Status", "install ok installed"},
+                });
+            };
+
+            std::vector<vcpkg::StatusParagraph> pghs;
+            pghs.push_back(make_pgh("zlib"));
+            vcpkg::StatusParagraphs status_db(std::move(pghs));
+            const vcpkg::StatusParagraph* zlib = *status_db.find("zlib", vcpkg::Triplet::X86_WINDOWS);
+
+            for (int i = 0; i < 1000; ++i)
+            {
+                status_db.insert(make_pgh("port-" + std::to_string(i)));
+            }
+
+            Assert::IsTrue(zlib == *status_db.find("zlib", vcpkg::Triplet::X86_WINDOWS));
+            Assert::AreEqual("zlib", zlib->package.spec.name().c_str());
+            const auto last = status_db.find_installed("port-999", vcpkg::Triplet::X86_WINDOWS);
+            Assert::IsTrue(last != status_db.end());
+            Assert::IsTrue(status_db.begin() == last);
+        }
+
+        TEST_METHOD(StatusParagraphs_from_views_parse_on_use)
+        {
+            vcpkg::StatusParagraphs status_db(vcpkg::Paragraphs::parse_paragraph_views(
+                "Package: zlib\nVersion: 1.2.11\nArchitecture: x86-windows\nMulti-Arch: same\n"
+                "Status: install ok installed\n\n"
+                "Package: curl\nFeature: ssl\nArchitecture: x86-windows\nMulti-Arch: same\n"
+                "Depends: openssl\nStatus: purge ok not-installed\n"));
+
+            Assert::IsTrue(status_db.find_installed("curl", vcpkg::Triplet::X86_WINDOWS) == status_db.end());
+            const auto zlib = status_db.find_installed("zlib", vcpkg::Triplet::X86_WINDOWS);
+            Assert::IsTrue(zlib != status_db.end());
+            Assert::AreEqual("1.2.11", (*zlib)->package.version.c_str());
+
+            const auto ssl = status_db.find("curl", vcpkg::Triplet::X86_WINDOWS, "ssl");
+            Assert::IsTrue(ssl != status_db.end());
+            Assert::AreEqual(size_t(1), (*ssl)->package.depends.size());
+
+            std::string serialized;
+            serialize(status_db, serialized);
+            Assert::AreEqual(size_t(2),
+                             vcpkg::Paragraphs::parse_paragraphs(serialized).value_or_exit(VCPKG_LINE_INFO).size());
+        }
+
+        TEST_METHOD(ParagraphParser_field_table_reports_unread_and_unknown_fields)
+        {
+            static constexpr std::string_view NAMES[] = {"Source", "Version", "Description"};
+            static constexpr vcpkg::Parse::FieldTable TABLE(NAMES);
+            static_assert(TABLE.find("Version") == 1, "");
+            static_assert(TABLE.find("Status") == vcpkg::Parse::FieldTable::NOT_FOUND, "");
+
+            const vcpkg::Parse::ParagraphView view{{
+                {"Version", "1.0"},
+                {"Source", "zlib"},
+                {"Unknown", "x"},
+                {"Description", "compression"},
+            }};
+            vcpkg::Parse::ParagraphParser parser(view, TABLE);
+
+            std::string name;
+            parser.required_field("Source", name);
+            Assert::AreEqual("zlib", name.c_str());
+            Assert::AreEqual("1.0", parser.optional_field("Version").c_str());
+            Assert::AreEqual("", parser.optional_field("Version").c_str());
+            parser.required_field("Build-Depends", name);
+
+            const auto err = parser.error_info("zlib");
+            Assert::IsTrue(err != nullptr);
+            Assert::AreEqual(size_t(1), err->missing_fields.size());
+            Assert::AreEqual(size_t(2), err->extra_fields.size());
+            Assert::AreEqual("Description", err->extra_fields[0].c_str());
+            Assert::AreEqual("Unknown", err->extra_fields[1].c_str());
+        }
     };
 }
@@ -0,0 +1,57 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Strings.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class StringsTests : public TestClass<StringsTests>
+    {
+        TEST_METHOD(case_insensitive_search_matches_any_case)
+        {
+            const Strings::CaseInsensitiveAsciiSearcher searcher("ZLib");
+            Assert::AreEqual(size_t(0), searcher.find("zlib:x86-windows"));
+            Assert::AreEqual(size_t(6), searcher.find("12345 ZLIB"));
+            Assert::IsFalse(searcher.contains("zli"));
+            Assert::IsFalse(searcher.contains(""));
+            Assert::AreEqual(size_t(0), Strings::CaseInsensitiveAsciiSearcher("").find("anything"));
+        }
+
+        TEST_METHOD(case_insensitive_search_scans_long_strings)
+        {
+            // Matches at every offset, including those in the last partial block
+            for (size_t offset = 0; offset < 80; ++offset)
+            {
+                std::string text(80, 'a');
+                text.replace(offset, 3, "B@z", text.size() - offset < 3 ? text.size() - offset : 3);
+                const size_t expected = offset + 3 <= text.size() ? offset : std::string::npos;
+                Assert::AreEqual(expected, Strings::CaseInsensitiveAsciiSearcher("b@Z").find(text));
+            }
+
+            // '@' and '`' differ only in the bit which folds the case of letters
+            Assert::IsFalse(Strings::CaseInsensitiveAsciiSearcher("@x").contains(std::string(40, '`') + "`X"));
+            Assert::IsTrue(Strings::CaseInsensitiveAsciiSearcher("@x").contains(std::string(40, '`') + "@X"));
+        }
+
+        TEST_METHOD(append_format_appends_in_place)
+        {
+            std::string output = "zlib";
+            Strings::append_format(output, ":%s", "x86-windows");
+            Strings::append_format(output, "%s", "");
+            Assert::AreEqual(std::string("zlib:x86-windows"), output);
+        }
+
+        TEST_METHOD(append_json_string_escapes_in_place)
+        {
+            std::string output = "{";
+            Strings::append_json_string(output, "C:\\vcpkg \"installed\"\n");
+            Assert::AreEqual(std::string(R"({"C:\\vcpkg \"installed\"\u000A")"), output);
+            Assert::AreEqual(output.substr(1), Strings::to_json_string("C:\\vcpkg \"installed\"\n"));
+        }
+    };
+}
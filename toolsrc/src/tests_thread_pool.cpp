@@ -0,0 +1,49 @@
+#include "CppUnitTest.h"
+#include "vcpkg_ThreadPool.h"
+#include "vcpkg_Util.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class ThreadPoolTests : public TestClass<ThreadPoolTests>
+    {
+        TEST_METHOD(parallel_fmap_keeps_the_order)
+        {
+            std::vector<int> xs(1000);
+            for (size_t i = 0; i < xs.size(); ++i)
+                xs[i] = static_cast<int>(i);
+
+            const std::vector<std::string> strings =
+                Util::parallel_fmap(xs, [](const int x) { return std::to_string(x); });
+
+            Assert::AreEqual(xs.size(), strings.size());
+            for (size_t i = 0; i < xs.size(); ++i)
+                Assert::AreEqual(std::to_string(i), strings[i]);
+        }
+
+        TEST_METHOD(for_each_index_calls_each_index_once)
+        {
+            std::vector<std::atomic<int>> calls(500);
+            ThreadPool::for_each_index(calls.size(), [&](const size_t i) { ++calls[i]; });
+
+            for (auto&& count : calls)
+                Assert::AreEqual(1, count.load());
+        }
+
+        TEST_METHOD(nested_loops_finish)
+        {
+            std::atomic<size_t> total{0};
+            Util::parallel_for_each_index(ThreadPool::get_thread_count() * 2, [&](const size_t) {
+                Util::parallel_for_each_index(100, [&](const size_t) { ++total; });
+            });
+
+            Assert::AreEqual(ThreadPool::get_thread_count() * 2 * 100, total.load());
+        }
+    };
+}
@@ -0,0 +1,77 @@
+#include "CppUnitTest.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Nupkg.h"
+#include "vcpkg_Zip.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest1
+{
+    using namespace vcpkg;
+
+    class ZipTests : public TestClass<ZipTests>
+    {
+        TEST_METHOD(crc32_matches_zip_and_combines)
+        {
+            const std::string data = "123456789";
+            Assert::AreEqual(uint32_t(0xCBF43926), Zip::crc32(0, data.data(), data.size()));
+            Assert::AreEqual(uint32_t(0xCBF43926), Zip::crc32(Zip::crc32(0, data.data(), 4), data.data() + 4, 5));
+
+            const uint32_t first = Zip::crc32(0, data.data(), 4);
+            const uint32_t second = Zip::crc32(0, data.data() + 4, 5);
+            Assert::AreEqual(uint32_t(0xCBF43926), Zip::crc32_combine(first, second, 5));
+        }
+
+        TEST_METHOD(deflate_ends_pieces_so_they_concatenate)
+        {
+            std::string last;
+            Zip::deflate(nullptr, 0, true, last);
+            Assert::AreEqual(std::string("\x03\x00", 2), last);
+
+            // A piece which is not the last one ends on a byte boundary with the marker of an empty stored block
+            std::string piece;
+            const std::string data(100000, 'a');
+            Zip::deflate(data.data(), data.size(), false, piece);
+            Assert::IsTrue(piece.size() < 1000);
+            Assert::AreEqual(std::string("\x00\x00\xFF\xFF", 4), piece.substr(piece.size() - 4));
+        }
+
+        TEST_METHOD(nupkg_part_names_are_percent_encoded)
+        {
+            Assert::AreEqual(std::string("build/native/vcpkg.targets"),
+                             Nupkg::encode_part_name("build/native/vcpkg.targets"));
+            Assert::AreEqual(std::string("installed/a%20b/100%25/%C3%A9.h"),
+                             Nupkg::encode_part_name("installed/a b/100%/\xC3\xA9.h"));
+        }
+
+        TEST_METHOD(nupkg_is_a_zip_archive)
+        {
+            auto& fs = Files::get_real_filesystem();
+            const fs::path root = fs::stdfs::temp_directory_path() / "vcpkg-test-nupkg";
+            std::error_code ec;
+            fs.remove_all(root, ec);
+            fs.create_directories(root, ec);
+            fs.write_contents(root / "zlib.h", std::string(3 * 1024 * 1024, 'z'));
+
+            std::vector<Zip::Entry> files;
+            files.push_back({"installed/x86-windows/include/zlib.h", root / "zlib.h", {}});
+            files.push_back({"build/native/vcpkg.export.targets", fs::path(), "<Project />"});
+            const fs::path nupkg = root / "vcpkg.export.1.0.0.nupkg";
+            const uint64_t size =
+                Nupkg::write(fs, nupkg, {"vcpkg.export", "1.0.0", "test"}, files).value_or_exit(VCPKG_LINE_INFO);
+
+            const std::string contents = fs.read_contents(nupkg).value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(size, uint64_t(contents.size()));
+            Assert::IsTrue(contents.size() < 1024 * 1024);
+            Assert::AreEqual(std::string("PK\x03\x04", 4), contents.substr(0, 4));
+            Assert::AreEqual(std::string("PK\x05\x06", 4), contents.substr(contents.size() - 22, 4));
+            Assert::IsTrue(contents.find("vcpkg.export.nuspec") != std::string::npos);
+            Assert::IsTrue(contents.find("[Content_Types].xml") != std::string::npos);
+
+            fs.remove_all(root, ec);
+        }
+    };
+}
@@ -3,6 +3,8 @@
 #include "Triplet.h"
 #include "vcpkg_Checks.h"
 #include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
 
 namespace vcpkg
 {
@@ -26,7 +28,7 @@ struct std::hash<vcpkg::TripletInstance>
 
 namespace vcpkg
 {
-    static std::unordered_set<TripletInstance> g_triplet_instances;
+    static Util::LockGuarded<std::unordered_set<TripletInstance>> g_triplet_instances;
 
     const Triplet Triplet::X86_WINDOWS = from_canonical_name("x86-windows");
     const Triplet Triplet::X64_WINDOWS = from_canonical_name("x64-windows");
@@ -44,10 +46,21 @@ namespace vcpkg
         const auto it = std::find(s.cbegin(), s.cend(), '-');
         Checks::check_exit(VCPKG_LINE_INFO, it != s.cend(), "Invalid triplet: %s", triplet_as_string);
 
-        const auto p = g_triplet_instances.emplace(std::move(s));
+        const auto p = g_triplet_instances.lock()->emplace(std::move(s));
         return &*p.first;
     }
 
+    Triplet Triplet::host()
+    {
+        static const Triplet host = []() {
+            const Optional<std::wstring> host_triplet_env =
+                System::get_environment_variable(L"VCPKG_DEFAULT_HOST_TRIPLET");
+            if (const auto v = host_triplet_env.get()) return from_canonical_name(Strings::to_utf8(*v));
+            return X86_WINDOWS;
+        }();
+        return host;
+    }
+
     const std::string& Triplet::canonical_name() const { return this->m_instance->value; }
 
     const std::string& Triplet::to_string() const { return this->canonical_name(); }
@@ -10,6 +10,7 @@
 #include "vcpkg_Input.h"
 #include "vcpkg_Strings.h"
 #include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
 #include "vcpkglib.h"
 #include <Shlobj.h>
 #include <cassert>
@@ -25,6 +26,23 @@ void invalid_command(const std::string& cmd)
     Checks::exit_fail(VCPKG_LINE_INFO);
 }
 
+/// <summary>
+/// A storage location given on the command line, else in the environment variable, else the default under the root
+/// </summary>
+static fs::path get_storage_root(const std::unique_ptr<std::string>& argument,
+                                 const wchar_t* environment_variable,
+                                 const fs::path& default_path)
+{
+    if (argument != nullptr) return fs::stdfs::absolute(Strings::to_utf16(*argument));
+
+    const Optional<std::wstring> from_environment = System::get_environment_variable(environment_variable);
+    if (const auto v = from_environment.get())
+    {
+        if (!v->empty()) return fs::stdfs::absolute(*v);
+    }
+    return default_path;
+}
+
 static void inner(const VcpkgCmdArguments& args)
 {
     Metrics::g_metrics.lock()->track_property("command", args.command);
@@ -40,36 +58,51 @@ static void inner(const VcpkgCmdArguments& args)
     }
 
     fs::path vcpkg_root_dir;
-    if (args.vcpkg_root_dir != nullptr)
-    {
-        vcpkg_root_dir = fs::stdfs::absolute(Strings::to_utf16(*args.vcpkg_root_dir));
-    }
-    else
     {
-        const Optional<std::wstring> vcpkg_root_dir_env = System::get_environment_variable(L"VCPKG_ROOT");
-        if (const auto v = vcpkg_root_dir_env.get())
+        const Timings::ScopedTimer timer("startup", "root");
+        if (args.vcpkg_root_dir != nullptr)
         {
-            vcpkg_root_dir = fs::stdfs::absolute(*v);
+            vcpkg_root_dir = fs::stdfs::absolute(Strings::to_utf16(*args.vcpkg_root_dir));
         }
         else
         {
-            vcpkg_root_dir = Files::get_real_filesystem().find_file_recursively_up(
-                fs::stdfs::absolute(System::get_exe_path_of_current_process()), ".vcpkg-root");
+            const Optional<std::wstring> vcpkg_root_dir_env = System::get_environment_variable(L"VCPKG_ROOT");
+            if (const auto v = vcpkg_root_dir_env.get())
+            {
+                vcpkg_root_dir = fs::stdfs::absolute(*v);
+            }
+            else
+            {
+                vcpkg_root_dir = Files::get_real_filesystem().find_file_recursively_up(
+                    fs::stdfs::absolute(System::get_exe_path_of_current_process()), ".vcpkg-root");
+            }
         }
     }
 
     Checks::check_exit(VCPKG_LINE_INFO, !vcpkg_root_dir.empty(), "Error: Could not detect vcpkg-root.");
 
-    const Expected<VcpkgPaths> expected_paths = VcpkgPaths::create(vcpkg_root_dir);
-    Checks::check_exit(VCPKG_LINE_INFO,
-                       !expected_paths.error(),
-                       "Error: Invalid vcpkg root directory %s: %s",
-                       vcpkg_root_dir.string(),
-                       expected_paths.error().message());
-    const VcpkgPaths paths = expected_paths.value_or_exit(VCPKG_LINE_INFO);
+    const VcpkgPaths paths = [&]() {
+        const Timings::ScopedTimer timer("startup", "paths");
+        const Expected<VcpkgPaths> expected_paths = VcpkgPaths::create(vcpkg_root_dir);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !expected_paths.error(),
+                           "Error: Invalid vcpkg root directory %s: %s",
+                           vcpkg_root_dir.string(),
+                           expected_paths.error().message());
+        VcpkgPaths created = expected_paths.value_or_exit(VCPKG_LINE_INFO);
+
+        // Scratch space can live on a faster volume than the root, and the downloads on a shared one
+        created.buildtrees = get_storage_root(args.buildtrees_root_dir, L"VCPKG_BUILDTREES_ROOT", created.buildtrees);
+        created.packages = get_storage_root(args.packages_root_dir, L"VCPKG_PACKAGES_ROOT", created.packages);
+        created.downloads = get_storage_root(args.downloads_root_dir, L"VCPKG_DOWNLOADS", created.downloads);
+        return created;
+    }();
     const int exit_code = _wchdir(paths.root.c_str());
     Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Changing the working dir failed");
-    Commands::Version::warn_if_vcpkg_version_mismatch(paths);
+    {
+        const Timings::ScopedTimer timer("startup", "version check");
+        Commands::Version::warn_if_vcpkg_version_mismatch(paths);
+    }
 
     if (const auto command_function = Commands::find(args.command, Commands::get_available_commands_type_b()))
     {
@@ -189,6 +222,35 @@ static std::string trim_path_from_command_line(const std::string& full_command_l
     return std::string(it, full_command_line.cend());
 }
 
+static uint64_t parse_background_number(const std::unique_ptr<std::string>& argument,
+                                        const char* option_name,
+                                        const uint64_t default_value)
+{
+    if (argument == nullptr) return default_value;
+
+    // The mask may be given in hex, as in 0xFF
+    char* end = nullptr;
+    const uint64_t value = strtoull(argument->c_str(), &end, 0);
+    Checks::check_exit(VCPKG_LINE_INFO,
+                       !argument->empty() && *end == '\0',
+                       "Error: %s must be a number, but was '%s'",
+                       option_name,
+                       *argument);
+    return value;
+}
+
+static void set_background_mode(const VcpkgCmdArguments& args)
+{
+    if (!args.background.value_or(false)) return;
+
+    const uint64_t mask = parse_background_number(args.background_affinity, "--background-affinity", 0);
+    const uint64_t free_cores = parse_background_number(args.background_free_cores, "--background-free-cores", 1);
+    GlobalState::background_affinity = System::get_background_affinity(mask, static_cast<size_t>(free_cores));
+    GlobalState::background = true;
+    Debug::println("Background builds on the cores 0x%llx",
+                   static_cast<unsigned long long>(GlobalState::background_affinity));
+}
+
 int wmain(const int argc, const wchar_t* const* const argv)
 {
     if (argc == 0) std::abort();
@@ -208,14 +270,44 @@ int wmain(const int argc, const wchar_t* const* const argv)
         locked_metrics->track_property("version", Commands::Version::version());
         locked_metrics->track_property("cmdline", trimmed_command_line);
     }
+    const double config_start_us = Timings::microseconds_since_start();
     load_config();
     Metrics::g_metrics.lock()->track_property("sqmuser", Metrics::get_SQM_user());
+    const double config_end_us = Timings::microseconds_since_start();
 
     const VcpkgCmdArguments args = VcpkgCmdArguments::create_from_command_line(argc, argv);
 
     if (const auto p = args.printmetrics.get()) Metrics::g_metrics.lock()->set_print_metrics(*p);
     if (const auto p = args.sendmetrics.get()) Metrics::g_metrics.lock()->set_send_metrics(*p);
     if (const auto p = args.debug.get()) GlobalState::debugging = *p;
+    if (const auto p = args.timings.get())
+    {
+        Timings::g_timings.lock()->set_print_timings(*p);
+        GlobalState::timings = *p;
+    }
+    if (const auto p = args.timings_trace_file.get())
+    {
+        Timings::g_timings.lock()->set_trace_file(*p);
+        GlobalState::timings = true;
+    }
+    {
+        // Unlike the switch, the environment variable also reaches the vcpkg processes which portfiles start
+        const bool trace_processes =
+            args.trace_processes.value_or(System::get_environment_variable(L"VCPKG_TRACE_PROCESSES").has_value());
+        Timings::g_timings.lock()->set_trace_processes(trace_processes);
+        GlobalState::trace_processes = trace_processes;
+    }
+
+    if (const auto p = args.memstats.get())
+    {
+        Timings::g_timings.lock()->set_print_memstats(*p);
+        GlobalState::memstats = *p;
+    }
+
+    set_background_mode(args);
+
+    // The config is loaded before the arguments say whether to time it
+    Timings::track_event_if_enabled("startup", "config", config_start_us, config_end_us - config_start_us);
 
     Checks::register_console_ctrl_handler();
 
@@ -0,0 +1,691 @@
+#include "pch.h"
+
+#include "metrics.h"
+#include "vcpkg_BinaryCaching.h"
+#include "vcpkg_Build.h"
+#include "vcpkg_ChunkStore.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Http.h"
+#include "vcpkg_PackageArchive.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace vcpkg::BinaryCaching
+{
+    static constexpr size_t MAX_CONCURRENT_UPLOADS = 4;
+
+    struct HttpProvider final : BinaryProvider
+    {
+        /// <summary>
+        /// The index of the archive for an ABI tag is at prefix/&lt;abi&gt;.vpkgi and its chunks are at
+        /// prefix/chunks/&lt;sha256&gt;, each followed by the query, which carries any credentials. Archives uploaded
+        /// whole, at prefix/&lt;abi&gt;.vpkg, are still downloaded.
+        /// </summary>
+        HttpProvider(std::string prefix, std::string query, std::wstring upload_headers, std::string description)
+            : m_prefix(std::move(prefix))
+            , m_query(std::move(query))
+            , m_upload_headers(std::move(upload_headers))
+            , m_description(std::move(description))
+            , m_session(WinHttpOpen(
+                  L"vcpkg/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0))
+        {
+        }
+
+        HttpProvider(const HttpProvider&) = delete;
+        HttpProvider& operator=(const HttpProvider&) = delete;
+
+        ~HttpProvider()
+        {
+            if (m_session) WinHttpCloseHandle(m_session);
+        }
+
+        std::string describe() const override { return m_description; }
+
+        bool download(const VcpkgPaths& paths,
+                      const PackageSpec&,
+                      const std::string& abi_tag,
+                      const fs::path& archive) const override
+        {
+            // Packages which were uploaded before archives were split into chunks only have the whole archive
+            std::string index_text;
+            const DWORD index_status = get(url_for(abi_tag, ".vpkgi"), index_text);
+            if (index_status == 404) return download_archive(abi_tag, archive);
+            if (index_status != 200) return false;
+
+            const auto maybe_chunks = ChunkStore::parse_index(index_text);
+            const auto chunks = maybe_chunks.get();
+            if (!chunks) return false;
+
+            const auto fetch = [&](const ChunkStore::Chunk& chunk, std::string& data) {
+                return get(chunk_url(chunk.sha256), data) == 200;
+            };
+            const auto maybe_fetched = ChunkStore::assemble(
+                paths.get_filesystem(), Build::get_binary_cache_dir(paths), *chunks, archive, fetch);
+            const auto fetched = maybe_fetched.get();
+            if (!fetched)
+            {
+                System::println(System::Color::warning, "%s", maybe_fetched.error());
+                return false;
+            }
+
+            const uint64_t size = chunks->empty() ? 0 : chunks->back().offset + chunks->back().size;
+            System::println("Fetched %s of the %s of %s; the rest was in the local binary cache",
+                            Commands::GarbageCollect::format_size(*fetched),
+                            Commands::GarbageCollect::format_size(size),
+                            archive.filename().u8string());
+            return true;
+        }
+
+        /// <summary>
+        /// Uploads the chunks of the archive which the server does not have yet, then the index. The chunks are
+        /// shared by all packages, so a new version of a package mostly consists of chunks which are there already.
+        /// </summary>
+        bool upload(const VcpkgPaths& paths,
+                    const PackageSpec&,
+                    const std::string& abi_tag,
+                    const fs::path& archive) const override
+        {
+            if (!m_session) return false;
+
+            // The archives of the local binary cache are indexed when they are stored there
+            auto& fs = paths.get_filesystem();
+            const Expected<std::string> index_text = fs.read_contents(ChunkStore::get_index_path(archive));
+            auto maybe_chunks = index_text.has_value() ? ChunkStore::parse_index(*index_text.get())
+                                                       : ChunkStore::index_archive(fs, archive);
+            const auto chunks = maybe_chunks.get();
+            if (!chunks) return false;
+
+            std::vector<const ChunkStore::Chunk*> unique_chunks;
+            std::unordered_set<std::string> seen;
+            for (auto&& chunk : *chunks)
+            {
+                if (seen.insert(chunk.sha256).second) unique_chunks.push_back(&chunk);
+            }
+
+            std::atomic<bool> uploaded{true};
+            Util::parallel_for_each_index(unique_chunks.size(), [&](const size_t i) {
+                const ChunkStore::Chunk& chunk = *unique_chunks[i];
+                if (head(chunk_url(chunk.sha256)) == 200) return;
+
+                std::string data;
+                if (!ChunkStore::read_chunk(archive, chunk, data) || !put(chunk_url(chunk.sha256), data))
+                {
+                    uploaded = false;
+                }
+            });
+
+            // The index goes last, so that a package is only found once all of its chunks are there
+            return uploaded && put(url_for(abi_tag, ".vpkgi"), ChunkStore::format_index(*chunks));
+        }
+
+        std::vector<Optional<bool>> check_archives(const std::vector<std::string>& abi_tags) const override
+        {
+            std::vector<Optional<bool>> found(abi_tags.size());
+            if (!m_session) return found;
+
+            Util::parallel_for_each_index(abi_tags.size(), [&](const size_t i) {
+                DWORD status = head(url_for(abi_tags[i], ".vpkgi"));
+                if (status == 404) status = head(url_for(abi_tags[i], ".vpkg"));
+                if (status == 200) found[i] = true;
+                if (status == 404) found[i] = false;
+            });
+            return found;
+        }
+
+    private:
+        std::string url_for(const std::string& abi_tag, const char* extension) const
+        {
+            return m_prefix + '/' + abi_tag + extension + m_query;
+        }
+
+        std::string chunk_url(const std::string& sha256) const { return m_prefix + "/chunks/" + sha256 + m_query; }
+
+        /// <summary>
+        /// The status of the request, or 0 if the server could not be reached
+        /// </summary>
+        DWORD head(const std::string& url_text) const
+        {
+            const auto maybe_url = Http::parse_url(url_text);
+            const auto url = maybe_url.get();
+            if (!m_session || !url) return 0;
+
+            const auto request = Http::send_request(m_session, *url, L"HEAD", std::wstring());
+            return request ? request->status_code : 0;
+        }
+
+        /// <summary>
+        /// The status of the request, or 0 if the server could not be reached or the body did not arrive completely.
+        /// The body is only read when the status is 200.
+        /// </summary>
+        DWORD get(const std::string& url_text, std::string& body) const
+        {
+            const auto maybe_url = Http::parse_url(url_text);
+            const auto url = maybe_url.get();
+            if (!m_session || !url) return 0;
+
+            const auto request = Http::send_request(m_session, *url, L"GET", std::wstring());
+            if (!request) return 0;
+            if (request->status_code != 200) return request->status_code;
+
+            body.clear();
+            const bool completed = Http::read_body(request->request, [&](const char* data, const size_t size) {
+                body.append(data, size);
+                return true;
+            });
+            return completed ? 200 : 0;
+        }
+
+        bool put(const std::string& url_text, const std::string& body) const
+        {
+            const auto maybe_url = Http::parse_url(url_text);
+            const auto url = maybe_url.get();
+            if (!m_session || !url) return false;
+
+            const auto request = Http::send_data(m_session, *url, L"PUT", m_upload_headers, body);
+            return request && request->status_code >= 200 && request->status_code < 300;
+        }
+
+        bool download_archive(const std::string& abi_tag, const fs::path& archive) const
+        {
+            const auto maybe_url = Http::parse_url(url_for(abi_tag, ".vpkg"));
+            const auto url = maybe_url.get();
+            if (!m_session || !url) return false;
+
+            const auto request = Http::send_request(m_session, *url, L"GET", std::wstring());
+            if (!request || request->status_code != 200) return false;
+
+            std::ofstream output(archive, std::ios::binary | std::ios::trunc);
+            const bool completed = Http::read_body(request->request, [&](const char* data, const size_t size) {
+                output.write(data, size);
+                return output.good();
+            });
+            output.close();
+            return completed && output.good();
+        }
+
+        std::string m_prefix;
+        std::string m_query;
+        std::wstring m_upload_headers;
+        std::string m_description;
+        HINTERNET m_session;
+    };
+
+    struct NuGetProvider final : BinaryProvider
+    {
+        explicit NuGetProvider(std::string feed) : m_feed(std::move(feed)) {}
+
+        std::string describe() const override { return "nuget " + m_feed; }
+
+        bool download(const VcpkgPaths& paths,
+                      const PackageSpec& spec,
+                      const std::string& abi_tag,
+                      const fs::path& archive) const override
+        {
+            auto& fs = paths.get_filesystem();
+            const fs::path output_dir = archive.parent_path() / (archive.filename().u8string() + ".nuget");
+            std::error_code ec;
+            fs.remove_all(output_dir, ec);
+
+            const std::wstring cmd_line = Strings::wformat(
+                LR"("%s" install "%s" -Version "%s" -Source "%s" -OutputDirectory "%s" -ExcludeVersion -NoCache )"
+                LR"(-NonInteractive > nul 2>&1)",
+                paths.get_nuget_exe().native(),
+                Strings::to_utf16(package_id(spec)),
+                Strings::to_utf16(package_version(abi_tag)),
+                Strings::to_utf16(m_feed),
+                output_dir.native());
+            const bool installed = System::cmd_execute_clean(cmd_line) == 0;
+
+            bool found = false;
+            if (installed)
+            {
+                fs.rename(output_dir / package_id(spec) / (abi_tag + ".vpkg"), archive, ec);
+                found = !ec;
+            }
+            fs.remove_all(output_dir, ec);
+            return found;
+        }
+
+        bool upload(const VcpkgPaths& paths,
+                    const PackageSpec& spec,
+                    const std::string& abi_tag,
+                    const fs::path& archive) const override
+        {
+            static constexpr auto NUSPEC_TEMPLATE = R"(
+<package>
+    <metadata>
+        <id>@ID@</id>
+        <version>@VERSION@</version>
+        <authors>vcpkg</authors>
+        <description>
+            Cached build of @SPEC@ with the ABI tag @ABI@
+        </description>
+    </metadata>
+    <files>
+        <file src="@ARCHIVE@" target="" />
+    </files>
+</package>
+)";
+
+            auto& fs = paths.get_filesystem();
+            const fs::path pack_dir = archive.parent_path() / (archive.filename().u8string() + ".nupkg");
+            std::error_code ec;
+            fs.remove_all(pack_dir, ec);
+            fs.create_directories(pack_dir, ec);
+
+            const std::string id = package_id(spec);
+            const std::string version = package_version(abi_tag);
+            std::string nuspec = Strings::replace_all(NUSPEC_TEMPLATE, "@ID@", id);
+            nuspec = Strings::replace_all(std::move(nuspec), "@VERSION@", version);
+            nuspec = Strings::replace_all(std::move(nuspec), "@SPEC@", spec.to_string());
+            nuspec = Strings::replace_all(std::move(nuspec), "@ABI@", abi_tag);
+            nuspec = Strings::replace_all(std::move(nuspec), "@ARCHIVE@", archive.u8string());
+            const fs::path nuspec_path = pack_dir / (id + ".nuspec");
+            fs.write_contents(nuspec_path, nuspec);
+
+            const fs::path& nuget_exe = paths.get_nuget_exe();
+            const std::wstring pack = Strings::wformat(LR"("%s" pack "%s" -OutputDirectory "%s" -NonInteractive > nul)",
+                                                       nuget_exe.native(),
+                                                       nuspec_path.native(),
+                                                       pack_dir.native());
+            const fs::path nupkg = pack_dir / (id + '.' + version + ".nupkg");
+            const std::wstring push = Strings::wformat(LR"("%s" push "%s" -Source "%s" -NonInteractive > nul)",
+                                                       nuget_exe.native(),
+                                                       nupkg.native(),
+                                                       Strings::to_utf16(m_feed));
+            const bool pushed = System::cmd_execute_clean(pack) == 0 && System::cmd_execute_clean(push) == 0;
+            fs.remove_all(pack_dir, ec);
+            return pushed;
+        }
+
+        // Only nuget.exe knows the layout of the feed, and it has no command to look up many packages at once
+        std::vector<Optional<bool>> check_archives(const std::vector<std::string>& abi_tags) const override
+        {
+            return std::vector<Optional<bool>>(abi_tags.size());
+        }
+
+    private:
+        static std::string package_id(const PackageSpec& spec) { return spec.dir(); }
+
+        // The ABI tag is hex, so it can start with a digit; a prerelease label must not be a number with a leading zero
+        static std::string package_version(const std::string& abi_tag) { return "1.0.0-abi" + abi_tag; }
+
+        std::string m_feed;
+    };
+
+    static ExpectedT<BinarySource, std::string> parse_binary_source(const std::string& entry)
+    {
+        std::vector<std::string> fields = Strings::split(entry, ",");
+        for (auto&& field : fields)
+        {
+            Strings::trim(&field);
+        }
+
+        BinarySource source;
+        source.read = true;
+        source.write = true;
+        if (fields.size() > 1)
+        {
+            const std::string& mode = fields.back();
+            if (mode == "read" || mode == "write" || mode == "readwrite")
+            {
+                source.read = mode != "write";
+                source.write = mode != "read";
+                fields.pop_back();
+            }
+        }
+
+        const std::string& kind = fields.front();
+        if (kind == "http" && fields.size() == 2)
+        {
+            std::string prefix = fields[1];
+            if (!prefix.empty() && prefix.back() == '/') prefix.pop_back();
+            source.provider = std::make_shared<HttpProvider>(prefix, std::string(), std::wstring(), "http " + prefix);
+        }
+        else if (kind == "azblob" && fields.size() == 3)
+        {
+            std::string container = fields[1];
+            if (!container.empty() && container.back() == '/') container.pop_back();
+            const std::string& sas = fields[2];
+            // The signature is a credential, so it is left out of the description
+            source.provider =
+                std::make_shared<HttpProvider>(container,
+                                               sas.empty() || sas.front() == '?' ? sas : '?' + sas,
+                                               L"x-ms-blob-type: BlockBlob\r\nx-ms-version: 2019-12-12\r\n",
+                                               "azblob " + container);
+        }
+        else if (kind == "nuget" && fields.size() == 2)
+        {
+            source.provider = std::make_shared<NuGetProvider>(fields[1]);
+        }
+        else
+        {
+            return Strings::format("Error: '%s' is not a binary source. Expected one of:\n"
+                                   "    http,<url>[,<mode>]\n"
+                                   "    azblob,<container url>,<sas>[,<mode>]\n"
+                                   "    nuget,<feed>[,<mode>]\n"
+                                   "where <mode> is read, write or readwrite",
+                                   entry);
+        }
+
+        return std::move(source);
+    }
+
+    ExpectedT<std::vector<BinarySource>, std::string> parse_binary_sources(const std::string& text)
+    {
+        std::vector<BinarySource> sources;
+        for (auto&& line : Strings::split(text, "\n"))
+        {
+            const std::string trimmed_line = Strings::trimmed(line);
+            if (trimmed_line.empty() || trimmed_line.front() == '#') continue;
+
+            for (auto&& entry : Strings::split(trimmed_line, ";"))
+            {
+                if (Strings::trimmed(entry).empty()) continue;
+
+                auto maybe_source = parse_binary_source(entry);
+                if (const auto source = maybe_source.get())
+                {
+                    sources.push_back(std::move(*source));
+                }
+                else
+                {
+                    return maybe_source.error();
+                }
+            }
+        }
+        return std::move(sources);
+    }
+
+    const std::vector<BinarySource>& get_binary_sources(const VcpkgPaths& paths)
+    {
+        static const std::vector<BinarySource> SOURCES = [&]() {
+            std::string text;
+            const Optional<std::wstring> from_environment = System::get_environment_variable(L"VCPKG_BINARY_SOURCES");
+            if (const auto p = from_environment.get())
+            {
+                text = Strings::to_utf8(*p);
+            }
+            else
+            {
+                const Expected<std::string> from_file =
+                    paths.get_filesystem().read_contents(paths.root / "binarysources.txt");
+                if (const auto contents = from_file.get()) text = *contents;
+            }
+
+            auto maybe_sources = parse_binary_sources(text);
+            Checks::check_exit(VCPKG_LINE_INFO, maybe_sources.has_value(), maybe_sources.error());
+            return std::move(maybe_sources).value_or_exit(VCPKG_LINE_INFO);
+        }();
+        return SOURCES;
+    }
+
+    // Names the temporary files of this process, so that several processes can share the local binary cache
+    static fs::path get_temporary_path(const fs::path& archive, const std::string& suffix)
+    {
+        return archive.parent_path() /
+               Strings::format("%s.%d%s", archive.filename().u8string(), GetCurrentProcessId(), suffix);
+    }
+
+    /// <summary>
+    /// The ABI tags which are being prefetched, and whether each has finished
+    /// </summary>
+    struct PrefetchState
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::map<std::string, bool> fetches;
+
+        void finish(const std::string& abi_tag)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fetches[abi_tag] = true;
+            cv.notify_all();
+        }
+    };
+
+    static PrefetchState g_prefetch;
+
+    static bool restore_from(const VcpkgPaths& paths,
+                             const PackageSpec& spec,
+                             const std::string& abi_tag,
+                             const fs::path& archive,
+                             const std::vector<const BinarySource*>& sources)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path download = get_temporary_path(archive, ".download");
+        std::error_code ec;
+
+        for (auto&& source : sources)
+        {
+            fs.create_directories(archive.parent_path(), ec);
+            const bool downloaded = source->provider->download(paths, spec, abi_tag, download);
+            if (!downloaded)
+            {
+                fs.remove(download, ec);
+                continue;
+            }
+
+            // The contents are checked against the hashes of the table when the package is extracted
+            const auto maybe_table = PackageArchive::read_table(download);
+            if (!maybe_table.has_value())
+            {
+                System::println(System::Color::warning,
+                                "The binary package %s from %s is not valid: %s",
+                                abi_tag,
+                                source->provider->describe(),
+                                maybe_table.error());
+                fs.remove(download, ec);
+                continue;
+            }
+
+            fs.rename(download, archive, ec);
+            // Another build may have restored the same ABI concurrently and still be reading it
+            if (ec) fs.remove(download, ec);
+            if (!fs.exists(ChunkStore::get_index_path(archive))) ChunkStore::index_archive(fs, archive);
+
+            System::println("Downloaded binary package %s from %s", spec, source->provider->describe());
+            Metrics::g_metrics.lock()->track_counter("binary_cache_remote_hits", 1);
+            return true;
+        }
+        return false;
+    }
+
+    static std::vector<const BinarySource*> get_readable_sources(const VcpkgPaths& paths)
+    {
+        std::vector<const BinarySource*> readable;
+        for (auto&& source : get_binary_sources(paths))
+        {
+            if (source.read) readable.push_back(&source);
+        }
+        return readable;
+    }
+
+    bool try_restore_from_sources(const VcpkgPaths& paths,
+                                  const PackageSpec& spec,
+                                  const std::string& abi_tag,
+                                  const fs::path& archive)
+    {
+        {
+            std::unique_lock<std::mutex> lock(g_prefetch.mutex);
+            const auto it = g_prefetch.fetches.find(abi_tag);
+            if (it != g_prefetch.fetches.end())
+            {
+                g_prefetch.cv.wait(lock, [&]() { return it->second; });
+                return paths.get_filesystem().exists(archive);
+            }
+        }
+
+        return restore_from(paths, spec, abi_tag, archive, get_readable_sources(paths));
+    }
+
+    std::vector<Optional<bool>> check_sources(const VcpkgPaths& paths, const std::vector<std::string>& abi_tags)
+    {
+        std::vector<Optional<bool>> found(abi_tags.size(), false);
+        for (auto&& source : get_readable_sources(paths))
+        {
+            const std::vector<Optional<bool>> found_in_source = source->provider->check_archives(abi_tags);
+            for (size_t i = 0; i < abi_tags.size(); ++i)
+            {
+                if (found[i].value_or(false)) continue;
+                if (const auto p = found_in_source[i].get())
+                {
+                    if (*p) found[i] = true;
+                }
+                else
+                {
+                    found[i] = nullopt;
+                }
+            }
+        }
+        return found;
+    }
+
+    static void prefetch(const VcpkgPaths& paths, const std::vector<PrefetchRequest>& requests)
+    {
+        const std::vector<const BinarySource*> sources = get_readable_sources(paths);
+        const std::vector<std::string> abi_tags =
+            Util::fmap(requests, [](const PrefetchRequest& request) { return request.abi_tag; });
+
+        // The sources which may have each request, in the order in which they are configured
+        std::vector<std::vector<const BinarySource*>> candidates(requests.size());
+        for (auto&& source : sources)
+        {
+            const std::vector<Optional<bool>> found = source->provider->check_archives(abi_tags);
+            for (size_t i = 0; i < requests.size(); ++i)
+            {
+                if (found[i].value_or(true)) candidates[i].push_back(source);
+            }
+        }
+
+        // Packages which no source has can be built without waiting for the downloads of the others
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            if (candidates[i].empty()) g_prefetch.finish(requests[i].abi_tag);
+        }
+
+        Util::parallel_for_each_index(requests.size(), [&](const size_t i) {
+            if (candidates[i].empty()) return;
+
+            const PrefetchRequest& request = requests[i];
+            restore_from(paths, request.spec, request.abi_tag, request.archive, candidates[i]);
+            g_prefetch.finish(request.abi_tag);
+        });
+    }
+
+    void prefetch_from_sources(const VcpkgPaths& paths, std::vector<PrefetchRequest> requests)
+    {
+        if (get_readable_sources(paths).empty()) return;
+
+        auto& fs = paths.get_filesystem();
+        {
+            std::lock_guard<std::mutex> lock(g_prefetch.mutex);
+            Util::erase_remove_if(requests, [&](const PrefetchRequest& request) {
+                return fs.exists(request.archive) ||
+                       !g_prefetch.fetches.emplace(request.abi_tag, false).second;
+            });
+        }
+        if (requests.empty()) return;
+
+        System::println("Looking up %d binary packages in the binary sources...", requests.size());
+
+        // The builds wait for the packages they need, so nothing waits for the thread as a whole
+        const VcpkgPaths* const p = &paths;
+        std::thread([p, requests = std::move(requests)]() { prefetch(*p, requests); }).detach();
+    }
+
+    struct UploadQueue
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+        std::vector<std::thread> workers;
+        bool draining = false;
+
+        void worker()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;)
+            {
+                cv.wait(lock, [&]() { return !tasks.empty() || draining; });
+                if (tasks.empty()) return;
+
+                const std::function<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                task();
+                lock.lock();
+            }
+        }
+    };
+
+    static UploadQueue g_upload_queue;
+
+    static void upload_to_sources(const VcpkgPaths& paths,
+                                  const PackageSpec& spec,
+                                  const std::string& abi_tag,
+                                  const fs::path& archive)
+    {
+        std::vector<const BinarySource*> targets;
+        for (auto&& source : get_binary_sources(paths))
+        {
+            if (source.write) targets.push_back(&source);
+        }
+
+        Util::parallel_for_each_index(targets.size(), [&](const size_t i) {
+            const BinaryProvider& provider = *targets[i]->provider;
+            if (provider.upload(paths, spec, abi_tag, archive))
+            {
+                System::println("Uploaded binary package %s to %s", spec, provider.describe());
+            }
+            else
+            {
+                System::println(
+                    System::Color::warning, "Failed to upload binary package %s to %s", spec, provider.describe());
+            }
+        });
+    }
+
+    void queue_upload(const VcpkgPaths& paths,
+                      const PackageSpec& spec,
+                      const std::string& abi_tag,
+                      const fs::path& archive)
+    {
+        const std::vector<BinarySource>& sources = get_binary_sources(paths);
+        if (std::none_of(sources.cbegin(), sources.cend(), [](const BinarySource& s) { return s.write; })) return;
+
+        std::lock_guard<std::mutex> lock(g_upload_queue.mutex);
+        const VcpkgPaths* const p = &paths;
+        g_upload_queue.tasks.push_back(
+            [p, spec, abi_tag, archive]() { upload_to_sources(*p, spec, abi_tag, archive); });
+        if (g_upload_queue.workers.size() < MAX_CONCURRENT_UPLOADS)
+        {
+            g_upload_queue.workers.emplace_back([]() { g_upload_queue.worker(); });
+        }
+        g_upload_queue.cv.notify_one();
+    }
+
+    void wait_for_uploads()
+    {
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard<std::mutex> lock(g_upload_queue.mutex);
+            if (g_upload_queue.workers.empty()) return;
+
+            System::println("Waiting for the binary package uploads to finish...");
+            g_upload_queue.draining = true;
+            workers.swap(g_upload_queue.workers);
+        }
+        g_upload_queue.cv.notify_all();
+        for (auto&& t : workers)
+            t.join();
+
+        std::lock_guard<std::mutex> lock(g_upload_queue.mutex);
+        g_upload_queue.draining = false;
+    }
+}
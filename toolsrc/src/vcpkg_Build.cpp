@@ -3,13 +3,19 @@
 #include "Paragraphs.h"
 #include "PostBuildLint.h"
 #include "metrics.h"
+#include "vcpkg_BinaryCaching.h"
 #include "vcpkg_Build.h"
+#include "vcpkg_BuildLogs.h"
 #include "vcpkg_Checks.h"
 #include "vcpkg_Chrono.h"
+#include "vcpkg_ChunkStore.h"
 #include "vcpkg_Commands.h"
 #include "vcpkg_Enums.h"
 #include "vcpkg_GlobalState.h"
+#include "vcpkg_PackageArchive.h"
 #include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
+#include "vcpkg_Util.h"
 #include "vcpkg_optional.h"
 #include "vcpkglib.h"
 
@@ -28,6 +34,20 @@ namespace vcpkg::Build
         static const std::string LIBRARY_LINKAGE = "LibraryLinkage";
     }
 
+    // A policy which is missing here is still read, only by comparing its name with the remaining fields
+    static constexpr std::string_view BUILD_INFO_FIELD_NAMES[] = {
+        "CRTLinkage",
+        "LibraryLinkage",
+        "Version",
+        "PolicyEmptyPackage",
+        "PolicyDLLsWithoutLIBs",
+        "PolicyOnlyReleaseCRT",
+        "PolicyEmptyIncludeFolder",
+        "PolicyAllowObsoleteMsvcrt",
+    };
+    static constexpr Parse::FieldTable BUILD_INFO_FIELDS(BUILD_INFO_FIELD_NAMES);
+    static_assert(BUILD_INFO_FIELDS.size() == 3 + G_ALL_POLICIES.size(), "Every policy is a field of BUILD_INFO");
+
     CWStringView to_vcvarsall_target(const std::string& cmake_system_name)
     {
         if (cmake_system_name == Strings::EMPTY) return Strings::WEMPTY;
@@ -56,6 +76,18 @@ namespace vcpkg::Build
         Checks::exit_with_message(VCPKG_LINE_INFO, "Unsupported toolchain combination %s", target_architecture);
     }
 
+    static std::wstring make_vcvarsall_cmd(const PreBuildInfo& pre_build_info, const Toolset& toolset)
+    {
+        const auto arch = to_vcvarsall_toolchain(pre_build_info.target_architecture, toolset);
+        const auto target = to_vcvarsall_target(pre_build_info.cmake_system_name);
+
+        return Strings::wformat(LR"("%s" %s %s %s)",
+                                toolset.vcvarsall.native(),
+                                Strings::join(L" ", toolset.vcvarsall_options),
+                                arch,
+                                target);
+    }
+
     std::wstring make_build_env_cmd(const PreBuildInfo& pre_build_info, const Toolset& toolset)
     {
         const wchar_t* tonull = L" >nul";
@@ -64,15 +96,128 @@ namespace vcpkg::Build
             tonull = Strings::WEMPTY;
         }
 
-        const auto arch = to_vcvarsall_toolchain(pre_build_info.target_architecture, toolset);
-        const auto target = to_vcvarsall_target(pre_build_info.cmake_system_name);
+        return Strings::wformat(LR"(%s%s 2>&1)", make_vcvarsall_cmd(pre_build_info, toolset), tonull);
+    }
 
-        return Strings::wformat(LR"("%s" %s %s %s %s 2>&1)",
-                                toolset.vcvarsall.native(),
-                                Strings::join(L" ", toolset.vcvarsall_options),
-                                arch,
-                                target,
-                                tonull);
+    /// <summary>
+    /// FNV-1a, used to key on-disk caches. Unlike std::hash it is the same across builds of vcpkg.
+    /// </summary>
+    struct StableHash
+    {
+        void add(const std::string& data)
+        {
+            for (const char c : data)
+            {
+                m_value ^= static_cast<unsigned char>(c);
+                m_value *= FNV_PRIME;
+            }
+
+            // Mix in a separator so that moving bytes from one input to the next changes the hash
+            m_value *= FNV_PRIME;
+        }
+
+        std::string to_string() const
+        {
+            char buffer[17];
+            sprintf_s(buffer, "%016llx", m_value);
+            return buffer;
+        }
+
+    private:
+        static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+        static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+        uint64_t m_value = FNV_OFFSET_BASIS;
+    };
+
+    /// <summary>
+    /// The cache file starts with the key, followed by one NAME=VALUE line per variable
+    /// </summary>
+    static Optional<std::wstring> try_load_build_environment(const Files::Filesystem& fs,
+                                                             const fs::path& cache_path,
+                                                             const std::string& key)
+    {
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(cache_path);
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->size() < 2 || lines->front() != key) return nullopt;
+
+        std::wstring environment_block;
+        for (auto it = lines->cbegin() + 1; it != lines->cend(); ++it)
+        {
+            environment_block.append(Strings::to_utf16(*it));
+            environment_block.push_back(L'\0');
+        }
+
+        environment_block.push_back(L'\0');
+        return environment_block;
+    }
+
+    static void store_build_environment(Files::Filesystem& fs,
+                                        const fs::path& cache_path,
+                                        const std::string& key,
+                                        const std::wstring& environment_block)
+    {
+        std::vector<std::string> lines = {key};
+        size_t begin = 0;
+        for (size_t end = environment_block.find(L'\0'); end != std::wstring::npos && end != begin;
+             end = environment_block.find(L'\0', begin))
+        {
+            lines.push_back(Strings::to_utf8(environment_block.substr(begin, end - begin)));
+            begin = end + 1;
+        }
+
+        std::error_code ec;
+        fs.create_directories(cache_path.parent_path(), ec);
+        const fs::path tmp_path = cache_path.parent_path() / (cache_path.filename().u8string() + ".tmp");
+        fs.write_lines(tmp_path, lines);
+        fs.rename(tmp_path, cache_path, ec);
+    }
+
+    Optional<std::wstring> get_build_environment(const VcpkgPaths& paths,
+                                                 const PreBuildInfo& pre_build_info,
+                                                 const Toolset& toolset)
+    {
+        static Util::LockGuarded<std::map<std::wstring, Optional<std::wstring>>> memoized;
+
+        const std::wstring vcvarsall_cmd = make_vcvarsall_cmd(pre_build_info, toolset);
+        {
+            auto locked = memoized.lock();
+            const auto it = locked->find(vcvarsall_cmd);
+            if (it != locked->cend()) return it->second;
+        }
+
+        const std::string toolset_subject =
+            Strings::format("%s %s", Strings::to_utf8(toolset.version), pre_build_info.target_architecture);
+        const Timings::ScopedTimer timer("vcvarsall", toolset_subject);
+
+        auto& fs = paths.get_filesystem();
+        std::error_code ec;
+        const fs::file_time_type vcvarsall_time = fs.last_write_time(toolset.vcvarsall, ec);
+
+        Optional<std::wstring> environment;
+        if (!ec)
+        {
+            StableHash clean_environment_hash;
+            clean_environment_hash.add(Strings::to_utf8(System::get_clean_environment()));
+            const std::string key = Strings::format("%s|%s|%s",
+                                                    Strings::to_utf8(vcvarsall_cmd),
+                                                    std::to_string(vcvarsall_time.time_since_epoch().count()),
+                                                    clean_environment_hash.to_string());
+
+            StableHash key_hash;
+            key_hash.add(key);
+            const fs::path cache_path = paths.vcpkg_dir / "build_environments" / (key_hash.to_string() + ".env");
+
+            environment = try_load_build_environment(fs, cache_path, key);
+            if (!environment)
+            {
+                environment = System::get_environment_after(vcvarsall_cmd + L" >nul 2>&1");
+                if (const auto block = environment.get()) store_build_environment(fs, cache_path, key, *block);
+            }
+        }
+
+        memoized.lock()->emplace(vcvarsall_cmd, environment);
+        return environment;
     }
 
     static void create_binary_feature_control_file(const SourceParagraph& source_paragraph,
@@ -99,46 +244,559 @@ namespace vcpkg::Build
 
     static void write_binary_control_file(const VcpkgPaths& paths, BinaryControlFile bcf)
     {
-        std::string start = Strings::serialize(bcf.core_paragraph);
-        for (auto&& feature : bcf.features)
+        const fs::path binary_control_file = paths.packages / bcf.core_paragraph.dir() / "CONTROL";
+        paths.get_filesystem().write_contents(binary_control_file, Strings::serialize(bcf));
+    }
+
+    std::vector<Dependency> get_build_dependencies(const BuildPackageConfig& config)
+    {
+        std::vector<Dependency> depends = config.src.depends;
+        if (GlobalState::feature_packages && config.scf && config.feature_list)
+        {
+            for (auto&& f_pgh : config.scf->feature_paragraphs)
+            {
+                if (config.feature_list->find(f_pgh->name) == config.feature_list->end()) continue;
+                depends.insert(depends.end(), f_pgh->depends.begin(), f_pgh->depends.end());
+            }
+        }
+        return depends;
+    }
+
+    std::vector<PackageSpec> find_missing_dependencies(const BuildPackageConfig& config,
+                                                       const StatusParagraphs& status_db)
+    {
+        const Triplet& triplet = config.triplet;
+        const std::vector<Dependency> depends = get_build_dependencies(config);
+
+        std::vector<PackageSpec> missing_specs;
+        for (auto&& dep : filter_dependencies(depends, triplet))
         {
-            start += "\n" + Strings::serialize(feature);
+            if (status_db.find_installed(dep, triplet) == status_db.end())
+            {
+                missing_specs.push_back(
+                    PackageSpec::from_name_and_triplet(dep, triplet).value_or_exit(VCPKG_LINE_INFO));
+            }
         }
-        const fs::path binary_control_file = paths.packages / bcf.core_paragraph.dir() / "CONTROL";
-        paths.get_filesystem().write_contents(binary_control_file, start);
+        for (auto&& host_spec : filter_host_dependencies(depends))
+        {
+            if (status_db.find_installed(host_spec) == status_db.end()) missing_specs.push_back(host_spec);
+        }
+        // A feature may depend on a port which the core, or another feature, depends on as well
+        std::vector<PackageSpec> unique_specs;
+        for (auto&& spec : missing_specs)
+        {
+            if (Util::find(unique_specs, spec) == unique_specs.cend()) unique_specs.push_back(spec);
+        }
+        return unique_specs;
+    }
+
+    std::vector<AbiEntry> get_dependency_abis(const BuildPackageConfig& config, const StatusParagraphs& status_db)
+    {
+        const Triplet& triplet = config.triplet;
+        const std::vector<Dependency> depends = get_build_dependencies(config);
+
+        std::vector<AbiEntry> dependency_abis;
+        for (auto&& dep : filter_dependencies(depends, triplet))
+        {
+            const auto it = status_db.find_installed(dep, triplet);
+            dependency_abis.push_back({dep, it == status_db.end() ? Strings::EMPTY : (*it)->package.abi});
+        }
+        // A tool of another triplet is named with its triplet, so that it changes the tag when the host triplet does
+        for (auto&& host_spec : filter_host_dependencies(depends))
+        {
+            const auto it = status_db.find_installed(host_spec);
+            dependency_abis.push_back(
+                {host_spec.to_string(), it == status_db.end() ? Strings::EMPTY : (*it)->package.abi});
+        }
+        return dependency_abis;
+    }
+
+    fs::path get_binary_cache_dir(const VcpkgPaths& paths)
+    {
+        const Optional<std::wstring> binary_cache_env = System::get_environment_variable(L"VCPKG_BINARY_CACHE");
+        if (const auto p = binary_cache_env.get())
+        {
+            return *p;
+        }
+        return paths.root / "archives";
+    }
+
+    fs::path get_archive_path(const VcpkgPaths& paths, const std::string& abi_tag)
+    {
+        return get_binary_cache_dir(paths) / abi_tag.substr(0, 2) / (abi_tag + ".vpkg");
+    }
+
+    static Optional<std::string> compute_abi_tag(const VcpkgPaths& paths,
+                                                 const BuildPackageConfig& config,
+                                                 const PreBuildInfo& pre_build_info,
+                                                 const Toolset& toolset,
+                                                 const std::vector<AbiEntry>& dependency_abis)
+    {
+        if (!GlobalState::binary_caching) return nullopt;
+
+        // Building from HEAD is not reproducible
+        if (to_bool(config.build_package_options.use_head_version)) return nullopt;
+
+        auto& fs = paths.get_filesystem();
+        const Triplet& triplet = config.triplet;
+
+        std::vector<AbiEntry> abi_tag_entries = dependency_abis;
+        std::sort(abi_tag_entries.begin(), abi_tag_entries.end(), [](const AbiEntry& lhs, const AbiEntry& rhs) {
+            return lhs.key < rhs.key;
+        });
+        // A dependency of several of the features is listed once
+        abi_tag_entries.erase(std::unique(abi_tag_entries.begin(),
+                                          abi_tag_entries.end(),
+                                          [](const AbiEntry& lhs, const AbiEntry& rhs) { return lhs.key == rhs.key; }),
+                              abi_tag_entries.end());
+        for (auto&& entry : abi_tag_entries)
+        {
+            if (entry.value.empty())
+            {
+                Debug::println(
+                    "Binary caching for %s is disabled because %s has no ABI tag", config.src.name, entry.key);
+                return nullopt;
+            }
+        }
+
+        const fs::path triplet_file_path = paths.triplets / (triplet.canonical_name() + ".cmake");
+        abi_tag_entries.push_back({"triplet", Commands::Hash::get_file_hash(triplet_file_path, "SHA1")});
+        abi_tag_entries.push_back({"ports.cmake", Commands::Hash::get_file_hash(paths.ports_cmake, "SHA1")});
+        abi_tag_entries.push_back({"toolset", Strings::to_utf8(toolset.version.c_str())});
+        abi_tag_entries.push_back({"target_architecture", pre_build_info.target_architecture});
+        abi_tag_entries.push_back({"cmake_system_name", pre_build_info.cmake_system_name});
+        abi_tag_entries.push_back({"cmake_system_version", pre_build_info.cmake_system_version});
+        abi_tag_entries.push_back({"platform_toolset", pre_build_info.platform_toolset});
+
+        if (GlobalState::feature_packages && config.feature_list)
+        {
+            std::vector<std::string> features(config.feature_list->cbegin(), config.feature_list->cend());
+            std::sort(features.begin(), features.end());
+            abi_tag_entries.push_back({"features", Strings::join(";", features)});
+        }
+
+        std::vector<Files::DirectoryEntry> port_files = fs.get_entries_recursive(config.port_dir);
+        std::sort(port_files.begin(),
+                  port_files.end(),
+                  [](const Files::DirectoryEntry& a, const Files::DirectoryEntry& b) { return a.path < b.path; });
+        const size_t port_dir_prefix_length = config.port_dir.generic_u8string().size() + 1;
+        for (auto&& port_file : port_files)
+        {
+            if (!fs::is_regular_file(port_file.status)) continue;
+            abi_tag_entries.push_back({port_file.path.generic_u8string().substr(port_dir_prefix_length),
+                                       Commands::Hash::get_file_hash(port_file.path, "SHA1")});
+        }
+
+        const std::string abi_info = Strings::join(
+            "", abi_tag_entries, [](const AbiEntry& entry) { return entry.key + " " + entry.value + "\n"; });
+
+        std::error_code ec;
+        const fs::path abi_info_dir = paths.buildtrees / config.src.name;
+        fs.create_directories(abi_info_dir, ec);
+        const fs::path abi_info_file_path = abi_info_dir / (triplet.canonical_name() + ".vcpkg_abi_info.txt");
+        fs.write_contents(abi_info_file_path, abi_info);
+
+        return Commands::Hash::get_file_hash(abi_info_file_path, "SHA1");
+    }
+
+    Optional<std::string> compute_abi_tag(const VcpkgPaths& paths,
+                                          const BuildPackageConfig& config,
+                                          const std::vector<AbiEntry>& dependency_abis)
+    {
+        if (to_bool(config.build_package_options.incremental_build)) return nullopt;
+
+        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, config.triplet);
+        const Toolset& toolset = paths.get_toolset(pre_build_info.platform_toolset);
+        return compute_abi_tag(paths, config, pre_build_info, toolset, dependency_abis);
+    }
+
+    /// <summary>
+    /// Records the phases which the helper scripts marked while the port was built. Each line of the markers file is
+    /// "<seconds since the Unix epoch> <begin|end> <phase>".
+    /// </summary>
+    static void track_phase_markers(const Files::Filesystem& fs, const fs::path& markers_path, const std::string& spec)
+    {
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(markers_path);
+        const auto lines = maybe_lines.get();
+        if (!lines) return;
+
+        std::map<std::string, double> open_phases;
+        auto locked_timings = Timings::g_timings.lock();
+        for (auto&& line : *lines)
+        {
+            const std::vector<std::string> fields = Strings::split(line, " ");
+            if (fields.size() != 3 || fields[0].empty()) continue;
+            if (!std::all_of(fields[0].cbegin(), fields[0].cend(), ::isdigit)) continue;
+
+            const double time_us = Timings::microseconds_since_start(std::stoll(fields[0]));
+            if (fields[1] == "begin")
+            {
+                open_phases[fields[2]] = time_us;
+            }
+            else if (fields[1] == "end")
+            {
+                const auto it = open_phases.find(fields[2]);
+                if (it == open_phases.end()) continue;
+                locked_timings->track_event(
+                    {fields[2], spec, it->second, time_us - it->second, GetCurrentThreadId(), std::string()});
+                open_phases.erase(it);
+            }
+        }
+    }
+
+    static fs::path distfiles_manifest_path(const VcpkgPaths& paths, const std::string& port_name)
+    {
+        return paths.downloads / "distfiles" / (port_name + ".txt");
+    }
+
+    static fs::path msys_packages_manifest_path(const VcpkgPaths& paths, const std::string& port_name)
+    {
+        return paths.downloads / "tools" / "msys2" / "ports" / (port_name + ".txt");
+    }
+
+    /// <summary>
+    /// Keeps what the scripts recorded during the build, so that later install plans can prepare it before the port
+    /// is built again. The manifest starts with the version of the port, followed by the unique recorded lines.
+    /// </summary>
+    static void save_recorded_manifest(const VcpkgPaths& paths,
+                                       const SourceParagraph& source,
+                                       const fs::path& recorded_path,
+                                       const fs::path& manifest_path)
+    {
+        auto& fs = paths.get_filesystem();
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(recorded_path);
+        const auto lines = maybe_lines.get();
+        if (!lines) return;
+
+        std::vector<std::string> manifest = {"Version: " + source.version};
+        for (auto&& line : *lines)
+        {
+            if (!line.empty() && Util::find(manifest, line) == manifest.cend()) manifest.push_back(line);
+        }
+
+        std::error_code ec;
+        fs.create_directories(manifest_path.parent_path(), ec);
+        fs.write_lines(manifest_path, manifest);
+    }
+
+    /// <summary>
+    /// The lines which vcpkg_download_distfile recorded are "<sha512>;<filename>;<urls...>". The size of each file
+    /// which was downloaded is kept after its name, so that a plan can tell how much it has to download.
+    /// </summary>
+    static void save_distfiles_manifest(const VcpkgPaths& paths,
+                                        const SourceParagraph& source,
+                                        const fs::path& recorded_path)
+    {
+        auto& fs = paths.get_filesystem();
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(recorded_path);
+        if (const auto lines = maybe_lines.get())
+        {
+            const std::vector<std::string> sized_lines = Util::fmap(*lines, [&](const std::string& line) {
+                const std::vector<std::string> fields = Strings::split(line, ";");
+                if (fields.size() < 3) return line;
+
+                std::error_code ec;
+                const uintmax_t size = fs.file_size(paths.downloads / fields[1], ec);
+                if (ec) return line;
+                const size_t urls_begin = fields[0].size() + fields[1].size() + 2;
+                return Strings::format(
+                    "%s;%s;%s;%s", fields[0], fields[1], std::to_string(size), line.substr(urls_begin));
+            });
+            fs.write_lines(recorded_path, sized_lines);
+        }
+
+        save_recorded_manifest(paths, source, recorded_path, distfiles_manifest_path(paths, source.name));
+    }
+
+    static bool is_size_field(const std::string& field)
+    {
+        return !field.empty() && std::all_of(field.cbegin(), field.cend(), [](const char c) {
+            return isdigit(static_cast<unsigned char>(c)) != 0;
+        });
+    }
+
+    static std::vector<Distfile> parse_distfiles(const std::vector<std::string>& lines)
+    {
+        std::vector<Distfile> distfiles;
+        for (auto it = lines.cbegin() + 1; it != lines.cend(); ++it)
+        {
+            const std::vector<std::string> fields = Strings::split(*it, ";");
+            if (fields.size() < 3) continue;
+
+            // Manifests saved before the sizes were kept go straight from the name to the urls
+            if (fields.size() > 3 && is_size_field(fields[2]))
+            {
+                const uintmax_t size = std::stoull(fields[2]);
+                distfiles.push_back({fields[0], fields[1], {fields.cbegin() + 3, fields.cend()}, size});
+                continue;
+            }
+            distfiles.push_back({fields[0], fields[1], {fields.cbegin() + 2, fields.cend()}, nullopt});
+        }
+        return distfiles;
+    }
+
+    std::vector<Distfile> load_distfiles(const VcpkgPaths& paths, const SourceParagraph& source)
+    {
+        const Expected<std::vector<std::string>> maybe_lines =
+            paths.get_filesystem().read_lines(distfiles_manifest_path(paths, source.name));
+        const auto lines = maybe_lines.get();
+
+        // Another version of the port may download other files
+        if (!lines || lines->empty() || lines->front() != "Version: " + source.version) return {};
+        return parse_distfiles(*lines);
+    }
+
+    std::vector<Distfile> load_recorded_distfiles(const VcpkgPaths& paths, const std::string& port_name)
+    {
+        const Expected<std::vector<std::string>> maybe_lines =
+            paths.get_filesystem().read_lines(distfiles_manifest_path(paths, port_name));
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->empty()) return {};
+        return parse_distfiles(*lines);
+    }
+
+    std::vector<std::string> load_msys_packages(const VcpkgPaths& paths, const SourceParagraph& source)
+    {
+        const Expected<std::vector<std::string>> maybe_lines =
+            paths.get_filesystem().read_lines(msys_packages_manifest_path(paths, source.name));
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->empty() || lines->front() != "Version: " + source.version) return {};
+        return std::vector<std::string>(lines->cbegin() + 1, lines->cend());
+    }
+
+    static fs::path build_times_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "buildtimes"; }
+
+    BuildTimes BuildTimes::load(const VcpkgPaths& paths)
+    {
+        BuildTimes build_times;
+        const Expected<std::vector<std::string>> maybe_lines =
+            paths.get_filesystem().read_lines(build_times_path(paths));
+        const auto lines = maybe_lines.get();
+        if (!lines) return build_times;
+
+        // Each line is "<spec> <microseconds>", followed by " <peak MiB>" when the memory was measured
+        for (auto&& line : *lines)
+        {
+            const size_t space = line.find(' ');
+            if (space == std::string::npos) continue;
+
+            const std::string spec = line.substr(0, space);
+            char* end = nullptr;
+            const double microseconds = strtod(line.c_str() + space + 1, &end);
+            if (microseconds > 0) build_times.m_microseconds[spec] = microseconds;
+
+            const long long peak_memory_mib = atoll(end);
+            if (peak_memory_mib > 0) build_times.m_peak_memory_mib[spec] = static_cast<size_t>(peak_memory_mib);
+        }
+        return build_times;
+    }
+
+    Optional<double> BuildTimes::find(const PackageSpec& spec) const
+    {
+        const auto it = m_microseconds.find(spec.to_string());
+        if (it == m_microseconds.cend()) return nullopt;
+        return it->second;
+    }
+
+    Optional<double> BuildTimes::mean() const
+    {
+        if (m_microseconds.empty()) return nullopt;
+
+        double total = 0;
+        for (auto&& entry : m_microseconds)
+        {
+            total += entry.second;
+        }
+        return total / m_microseconds.size();
+    }
+
+    Optional<size_t> BuildTimes::find_peak_memory_mib(const PackageSpec& spec) const
+    {
+        const auto it = m_peak_memory_mib.find(spec.to_string());
+        if (it == m_peak_memory_mib.cend()) return nullopt;
+        return it->second;
+    }
+
+    void BuildTimes::record(const PackageSpec& spec, const double microseconds)
+    {
+        m_microseconds[spec.to_string()] = microseconds;
+    }
+
+    void BuildTimes::record_peak_memory(const PackageSpec& spec, const size_t mib)
+    {
+        m_peak_memory_mib[spec.to_string()] = mib;
+    }
+
+    void BuildTimes::save(const VcpkgPaths& paths) const
+    {
+        std::vector<std::string> lines;
+        for (auto&& entry : m_microseconds)
+        {
+            std::string line = Strings::format("%s %lld", entry.first, static_cast<long long>(entry.second));
+            const auto it = m_peak_memory_mib.find(entry.first);
+            if (it != m_peak_memory_mib.cend()) line += Strings::format(" %lld", static_cast<long long>(it->second));
+            lines.push_back(std::move(line));
+        }
+        paths.get_filesystem().write_lines(build_times_path(paths), lines);
+    }
+
+    static fs::path acquired_programs_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "acquired_programs"; }
+
+    /// <summary>
+    /// vcpkg_find_acquire_program() records each program it finds, one line each: VAR|hash|path. The hash is the one
+    /// of the archive the script would download, so a script which asks for another version acquires it anew.
+    /// Each build rereads the file, so a program is probed once even within a session.
+    /// </summary>
+    static void add_acquired_programs(const VcpkgPaths& paths, std::vector<CMakeVariable>& cmake_variables)
+    {
+        const auto& fs = paths.get_filesystem();
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(acquired_programs_path(paths));
+        const auto lines = maybe_lines.get();
+        if (!lines) return;
+
+        // A program found again is recorded again, and the last record wins
+        std::map<std::string, std::pair<std::string, std::string>> programs;
+        for (const std::string& line : *lines)
+        {
+            const std::vector<std::string> fields = Strings::split(line, "|");
+            if (fields.size() != 3 || fields[0].empty() || fields[2].empty()) continue;
+            programs[fields[0]] = std::make_pair(fields[1], fields[2]);
+        }
+
+        for (auto&& program : programs)
+        {
+            if (!fs.exists(Strings::to_utf16(program.second.second))) continue;
+
+            const std::wstring name = L"_VCPKG_ACQUIRED_" + Strings::to_utf16(program.first);
+            cmake_variables.push_back({name, program.second.second});
+            cmake_variables.push_back({name + L"_HASH", program.second.first});
+        }
+    }
+
+    static bool try_restore_from_binary_cache(const VcpkgPaths& paths,
+                                              const PackageSpec& spec,
+                                              const fs::path& archive)
+    {
+        auto& fs = paths.get_filesystem();
+        if (!fs.exists(archive)) return false;
+
+        const fs::path package_dir = paths.package_dir(spec);
+        std::error_code ec;
+        move_to_trash(paths, package_dir);
+        const auto maybe_entries = PackageArchive::extract(fs, archive, package_dir);
+        if (!maybe_entries.has_value())
+        {
+            // Dropping the damaged archive lets this build store a good one
+            System::println(System::Color::warning, "%s; the package will be built again", maybe_entries.error());
+            move_to_trash(paths, package_dir);
+            fs.remove(archive, ec);
+            return false;
+        }
+
+        System::println("Using cached binary package: %s", archive.u8string());
+        return true;
+    }
+
+    static bool store_in_binary_cache(const VcpkgPaths& paths, const PackageSpec& spec, const fs::path& archive)
+    {
+        auto& fs = paths.get_filesystem();
+        std::error_code ec;
+
+        // Written next to the final location so that a shared cache never exposes a partially written archive
+        const fs::path tmp_archive =
+            archive.parent_path() /
+            Strings::format("%s.%d.incomplete", archive.filename().u8string(), GetCurrentProcessId());
+        fs.create_directories(archive.parent_path(), ec);
+        const auto maybe_entries = PackageArchive::create(fs, paths.package_dir(spec), tmp_archive);
+        if (!maybe_entries.has_value())
+        {
+            System::println(System::Color::warning, "%s", maybe_entries.error());
+            fs.remove(tmp_archive, ec);
+            return false;
+        }
+
+        fs.rename(tmp_archive, archive, ec);
+        if (ec)
+        {
+            // Another build may have stored the same ABI concurrently and still be reading it
+            fs.remove(tmp_archive, ec);
+        }
+        else
+        {
+            // Lets archives of later versions of the package be fetched as the chunks which changed
+            ChunkStore::index_archive(fs, archive);
+        }
+        return fs.exists(archive);
     }
 
     ExtendedBuildResult build_package(const VcpkgPaths& paths,
                                       const BuildPackageConfig& config,
                                       const StatusParagraphs& status_db)
+    {
+        std::vector<PackageSpec> missing_specs = find_missing_dependencies(config, status_db);
+        // Fail the build if any dependencies were missing
+        if (!missing_specs.empty())
+        {
+            return {BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES, std::move(missing_specs)};
+        }
+
+        return build_package(paths, config, get_dependency_abis(config, status_db));
+    }
+
+    ExtendedBuildResult build_package(const VcpkgPaths& paths,
+                                      const BuildPackageConfig& config,
+                                      const std::vector<AbiEntry>& dependency_abis)
+    {
+        return finish_build(paths, config, start_build(paths, config, dependency_abis));
+    }
+
+    StartedBuild start_build(const VcpkgPaths& paths,
+                             const BuildPackageConfig& config,
+                             const std::vector<AbiEntry>& dependency_abis)
     {
         const PackageSpec spec =
             PackageSpec::from_name_and_triplet(config.src.name, config.triplet).value_or_exit(VCPKG_LINE_INFO);
+        Files::FileLock build_lock = lock_package_build(paths, spec);
 
         const Triplet& triplet = config.triplet;
+
+        const fs::path& git_exe_path = paths.get_git_exe();
+
+        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, triplet);
+        const Toolset& toolset = paths.get_toolset(pre_build_info.platform_toolset);
+
+        // An incremental build is for iterating on the port itself, so it neither restores nor stores a cached package
+        const bool incremental_build = to_bool(config.build_package_options.incremental_build);
+        Optional<std::string> maybe_abi_tag;
+        if (!incremental_build)
         {
-            std::vector<PackageSpec> missing_specs;
-            for (auto&& dep : filter_dependencies(config.src.depends, triplet))
+            maybe_abi_tag = compute_abi_tag(paths, config, pre_build_info, toolset, dependency_abis);
+        }
+        Optional<fs::path> maybe_archive;
+        BinaryCacheStatus binary_cache_status = BinaryCacheStatus::NOT_USED;
+        if (const auto abi_tag = maybe_abi_tag.get())
+        {
+            const fs::path archive = get_archive_path(paths, *abi_tag);
+            maybe_archive = archive;
+            // The local cache is filled from the remote sources, so that other builds on this machine find it there
+            if (!paths.get_filesystem().exists(archive))
             {
-                if (status_db.find_installed(dep, triplet) == status_db.end())
-                {
-                    missing_specs.push_back(
-                        PackageSpec::from_name_and_triplet(dep, triplet).value_or_exit(VCPKG_LINE_INFO));
-                }
+                BinaryCaching::try_restore_from_sources(paths, spec, *abi_tag, archive);
             }
-            // Fail the build if any dependencies were missing
-            if (!missing_specs.empty())
+            if (try_restore_from_binary_cache(paths, spec, archive))
             {
-                return {BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES, std::move(missing_specs)};
+                Metrics::g_metrics.lock()->track_counter("binary_cache_hits", 1);
+                return {{BuildResult::SUCCEEDED, {}, BinaryCacheStatus::HIT},
+                        true,
+                        pre_build_info,
+                        std::move(maybe_abi_tag),
+                        std::move(maybe_archive),
+                        std::move(build_lock)};
             }
+            Metrics::g_metrics.lock()->track_counter("binary_cache_misses", 1);
+            binary_cache_status = BinaryCacheStatus::MISS;
         }
 
-        const fs::path& cmake_exe_path = paths.get_cmake_exe();
-        const fs::path& git_exe_path = paths.get_git_exe();
-
-        const fs::path ports_cmake_script_path = paths.ports_cmake;
-        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, triplet);
-        const Toolset& toolset = paths.get_toolset(pre_build_info.platform_toolset);
         const auto cmd_set_environment = make_build_env_cmd(pre_build_info, toolset);
 
         std::string features;
@@ -157,28 +815,119 @@ namespace vcpkg::Build
             }
         }
 
-        const std::wstring cmd_launch_cmake = make_cmake_cmd(
-            cmake_exe_path,
-            ports_cmake_script_path,
-            {
-                {L"CMD", L"BUILD"},
-                {L"PORT", config.src.name},
-                {L"CURRENT_PORT_DIR", config.port_dir / "/."},
-                {L"TARGET_TRIPLET", triplet.canonical_name()},
-                {L"VCPKG_PLATFORM_TOOLSET", toolset.version},
-                {L"VCPKG_USE_HEAD_VERSION", to_bool(config.build_package_options.use_head_version) ? L"1" : L"0"},
-                {L"_VCPKG_NO_DOWNLOADS", !to_bool(config.build_package_options.allow_downloads) ? L"1" : L"0"},
-                {L"GIT", git_exe_path},
-                {L"FEATURES", features},
-            });
+        std::vector<CMakeVariable> cmake_variables = {
+            {L"CMD", L"BUILD"},
+            {L"PORT", config.src.name},
+            {L"CURRENT_PORT_DIR", config.port_dir / "/."},
+            {L"TARGET_TRIPLET", triplet.canonical_name()},
+            {L"VCPKG_HOST_TRIPLET", Triplet::host().canonical_name()},
+            {L"VCPKG_PLATFORM_TOOLSET", toolset.version},
+            {L"VCPKG_USE_HEAD_VERSION", to_bool(config.build_package_options.use_head_version) ? L"1" : L"0"},
+            {L"_VCPKG_NO_DOWNLOADS", !to_bool(config.build_package_options.allow_downloads) ? L"1" : L"0"},
+            {L"GIT", git_exe_path},
+            {L"VCPKG_EXE", System::get_exe_path_of_current_process()},
+            {L"FEATURES", features},
+            {L"VCPKG_INCREMENTAL_BUILD", incremental_build ? L"1" : L"0"},
+        };
+
+        if (config.build_package_options.concurrency != 0)
+        {
+            cmake_variables.push_back(
+                {L"VCPKG_CONCURRENCY", std::to_wstring(config.build_package_options.concurrency)});
+        }
+
+        // Spares vcpkg_get_windows_sdk() from running getWindowsSDK.ps1 for every port
+        const std::string& windows_sdk_version = paths.get_windows_sdk_version();
+        if (!windows_sdk_version.empty())
+        {
+            cmake_variables.push_back({L"_VCPKG_WINDOWS_SDK", Strings::to_utf16(windows_sdk_version)});
+        }
+
+        const fs::path& helpers_bundle = paths.get_helpers_bundle();
+        if (!helpers_bundle.empty())
+        {
+            cmake_variables.push_back({L"VCPKG_HELPERS_BUNDLE", helpers_bundle});
+        }
+
+        cmake_variables.push_back({L"_VCPKG_ACQUIRED_PROGRAMS_FILE", acquired_programs_path(paths)});
+        add_acquired_programs(paths, cmake_variables);
+
+        Optional<fs::path> maybe_phase_markers_path;
+        if (GlobalState::timings)
+        {
+            maybe_phase_markers_path =
+                paths.buildtrees / config.src.name / (triplet.canonical_name() + ".vcpkg_phases.txt");
+            const fs::path& phase_markers_path = *maybe_phase_markers_path.get();
+            std::error_code ec;
+            paths.get_filesystem().create_directories(phase_markers_path.parent_path(), ec);
+            paths.get_filesystem().remove(phase_markers_path, ec);
+            cmake_variables.push_back({L"VCPKG_PHASE_MARKERS_FILE", phase_markers_path});
+        }
 
-        const std::wstring command = Strings::wformat(LR"(%s && %s)", cmd_set_environment, cmd_launch_cmake);
+        const bool use_head_version = to_bool(config.build_package_options.use_head_version);
+        const fs::path distfiles_path =
+            paths.buildtrees / config.src.name / (triplet.canonical_name() + ".vcpkg_distfiles.txt");
+        if (!use_head_version)
+        {
+            std::error_code ec;
+            paths.get_filesystem().create_directories(distfiles_path.parent_path(), ec);
+            paths.get_filesystem().remove(distfiles_path, ec);
+            cmake_variables.push_back({L"VCPKG_DISTFILES_MANIFEST", distfiles_path});
+        }
+
+        const fs::path msys_packages_path =
+            paths.buildtrees / config.src.name / (triplet.canonical_name() + ".vcpkg_msys_packages.txt");
+        {
+            std::error_code ec;
+            paths.get_filesystem().create_directories(msys_packages_path.parent_path(), ec);
+            paths.get_filesystem().remove(msys_packages_path, ec);
+            cmake_variables.push_back({L"VCPKG_MSYS_PACKAGES_MANIFEST", msys_packages_path});
+        }
+
+        const std::wstring cmd_launch_cmake = make_ports_cmake_cmd(paths, std::move(cmake_variables));
 
         const ElapsedTime timer = ElapsedTime::create_started();
+        const double timer_start_us = Timings::microseconds_since_start();
+        // The times of the last writes of the logs may be a little behind the clock
+        const fs::file_time_type build_start = fs::file_time_type::clock::now() - std::chrono::seconds(2);
 
-        const int return_code = System::cmd_execute_clean(command);
+        // Launch cmake directly in the captured vcvarsall environment and only chain through vcvarsall.bat when that
+        // environment is not available
+        const Optional<std::wstring> maybe_build_environment = get_build_environment(paths, pre_build_info, toolset);
+
+        // The job accounts for everything the portfile starts: compilers, linkers, and the builds of other tools
+        Expected<System::JobObject> maybe_job = System::JobObject::create();
+        System::JobObject* const job = maybe_job.get();
+        if (job && GlobalState::background && !job->set_background(GlobalState::background_affinity))
+        {
+            Debug::println("Could not limit the build of %s to the background", spec.to_string());
+        }
+        int return_code;
+        if (const auto build_environment = maybe_build_environment.get())
+        {
+            return_code = System::execute_with_environment(cmd_launch_cmake, *build_environment, job);
+        }
+        else
+        {
+            const std::wstring command = Strings::wformat(LR"(%s && %s)", cmd_set_environment, cmd_launch_cmake);
+            return_code = System::cmd_execute_clean(command, job);
+        }
         const auto buildtimeus = timer.microseconds();
         const auto spec_string = spec.to_string();
+        BuildLogs::archive_logs(paths, spec, build_start);
+        std::vector<PhaseTiming> phase_timings = {{"build", buildtimeus}};
+        Optional<System::ResourceUsage> resource_usage;
+        if (job) resource_usage = job->query();
+
+        Timings::track_event_if_enabled("cmake",
+                                        spec_string,
+                                        timer_start_us,
+                                        buildtimeus,
+                                        job ? System::to_string(*resource_usage.get()) : std::string());
+        if (const auto phase_markers_path = maybe_phase_markers_path.get())
+        {
+            track_phase_markers(paths.get_filesystem(), *phase_markers_path, spec_string);
+        }
 
         {
             auto locked_metrics = Metrics::g_metrics.lock();
@@ -187,12 +936,50 @@ namespace vcpkg::Build
             {
                 locked_metrics->track_property("error", "build failed");
                 locked_metrics->track_property("build_error", spec_string);
-                return {BuildResult::BUILD_FAILED, {}};
+                return {{BuildResult::BUILD_FAILED, {}, binary_cache_status, std::move(phase_timings), resource_usage},
+                        true,
+                        pre_build_info,
+                        std::move(maybe_abi_tag),
+                        std::move(maybe_archive),
+                        std::move(build_lock)};
             }
         }
 
+        if (!use_head_version)
+        {
+            save_distfiles_manifest(paths, config.src, distfiles_path);
+        }
+        save_recorded_manifest(
+            paths, config.src, msys_packages_path, msys_packages_manifest_path(paths, config.src.name));
+
+        return {{BuildResult::SUCCEEDED, {}, binary_cache_status, std::move(phase_timings), resource_usage},
+                false,
+                pre_build_info,
+                std::move(maybe_abi_tag),
+                std::move(maybe_archive),
+                std::move(build_lock)};
+    }
+
+    ExtendedBuildResult finish_build(const VcpkgPaths& paths, const BuildPackageConfig& config, StartedBuild started)
+    {
+        if (started.is_finished) return std::move(started.result);
+
+        const PackageSpec spec =
+            PackageSpec::from_name_and_triplet(config.src.name, config.triplet).value_or_exit(VCPKG_LINE_INFO);
+        const Triplet& triplet = config.triplet;
+        const auto spec_string = spec.to_string();
+        const PreBuildInfo& pre_build_info = started.pre_build_info;
+        const BinaryCacheStatus binary_cache_status = started.result.binary_cache_status;
+        std::vector<PhaseTiming>& phase_timings = started.result.phase_timings;
+        const Optional<System::ResourceUsage>& resource_usage = started.result.resource_usage;
+        const bool incremental_build = to_bool(config.build_package_options.incremental_build);
+
         const BuildInfo build_info = read_build_info(paths.get_filesystem(), paths.build_info_file_path(spec));
+        const ElapsedTime lint_timer = ElapsedTime::create_started();
+        const double lint_start_us = Timings::microseconds_since_start();
         const size_t error_count = PostBuildLint::perform_all_checks(spec, paths, pre_build_info, build_info);
+        phase_timings.push_back({"lint", lint_timer.microseconds()});
+        Timings::track_event_if_enabled("post-build checks", spec_string, lint_start_us, lint_timer.microseconds());
 
         BinaryControlFile bcf;
 
@@ -200,7 +987,11 @@ namespace vcpkg::Build
 
         if (error_count != 0)
         {
-            return {BuildResult::POST_BUILD_CHECKS_FAILED, {}};
+            return {BuildResult::POST_BUILD_CHECKS_FAILED,
+                    {},
+                    binary_cache_status,
+                    std::move(phase_timings),
+                    resource_usage};
         }
         if (GlobalState::feature_packages)
         {
@@ -217,12 +1008,48 @@ namespace vcpkg::Build
             }
         }
 
+        if (const auto abi_tag = started.abi_tag.get())
+        {
+            bcf.core_paragraph.abi = *abi_tag;
+        }
+
         write_binary_control_file(paths, bcf);
 
-        // const fs::path port_buildtrees_dir = paths.buildtrees / spec.name;
-        // delete_directory(port_buildtrees_dir);
+        if (const auto archive = started.archive.get())
+        {
+            if (store_in_binary_cache(paths, spec, *archive))
+            {
+                BinaryCaching::queue_upload(paths, spec, *started.abi_tag.get(), *archive);
+            }
+        }
+
+        // The next build configures from scratch anyway, so the build trees of a successful build are only kept to be
+        // reused incrementally. The sources are shared with other triplets and stay; the logs are in their archive.
+        BuildLogs::remove_archived_logs(paths, spec);
+        if (!incremental_build)
+        {
+            for (const char* suffix : {"-rel", "-dbg"})
+            {
+                move_to_trash(paths, paths.buildtrees / config.src.name / (triplet.canonical_name() + suffix));
+            }
+        }
+
+        return {BuildResult::SUCCEEDED, {}, binary_cache_status, std::move(phase_timings), resource_usage};
+    }
 
-        return {BuildResult::SUCCEEDED, {}};
+    const std::string& to_string(const BinaryCacheStatus binary_cache_status)
+    {
+        static const std::string NOT_USED_STRING = "NOT_USED";
+        static const std::string HIT_STRING = "HIT";
+        static const std::string MISS_STRING = "MISS";
+
+        switch (binary_cache_status)
+        {
+            case BinaryCacheStatus::NOT_USED: return NOT_USED_STRING;
+            case BinaryCacheStatus::HIT: return HIT_STRING;
+            case BinaryCacheStatus::MISS: return MISS_STRING;
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
     }
 
     const std::string& to_string(const BuildResult build_result)
@@ -263,9 +1090,9 @@ namespace vcpkg::Build
                                Commands::Version::version());
     }
 
-    static BuildInfo inner_create_buildinfo(std::unordered_map<std::string, std::string> pgh)
+    static BuildInfo inner_create_buildinfo(const Parse::ParagraphView& pgh)
     {
-        Parse::ParagraphParser parser(std::move(pgh));
+        Parse::ParagraphParser parser(pgh, BUILD_INFO_FIELDS);
 
         BuildInfo build_info;
 
@@ -320,24 +1147,114 @@ namespace vcpkg::Build
 
     BuildInfo read_build_info(const Files::Filesystem& fs, const fs::path& filepath)
     {
-        const Expected<std::unordered_map<std::string, std::string>> pghs =
-            Paragraphs::get_single_paragraph(fs, filepath);
-        Checks::check_exit(VCPKG_LINE_INFO, pghs.get() != nullptr, "Invalid BUILD_INFO file for package");
-        return inner_create_buildinfo(*pghs.get());
+        const Expected<Paragraphs::ParagraphViews> pghs = Paragraphs::get_paragraph_views(fs, filepath);
+        const auto views = pghs.get();
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           views != nullptr && views->paragraphs.size() == 1,
+                           "Invalid BUILD_INFO file for package");
+        return inner_create_buildinfo(views->paragraphs.front());
     }
 
-    PreBuildInfo PreBuildInfo::from_triplet_file(const VcpkgPaths& paths, const Triplet& triplet)
+    static bool try_set_pre_build_variable(PreBuildInfo& pre_build_info,
+                                           const std::string& variable_name,
+                                           const std::string& variable_value)
+    {
+        if (variable_name == "VCPKG_TARGET_ARCHITECTURE")
+            pre_build_info.target_architecture = variable_value;
+        else if (variable_name == "VCPKG_CMAKE_SYSTEM_NAME")
+            pre_build_info.cmake_system_name = variable_value;
+        else if (variable_name == "VCPKG_CMAKE_SYSTEM_VERSION")
+            pre_build_info.cmake_system_version = variable_value;
+        else if (variable_name == "VCPKG_PLATFORM_TOOLSET")
+            pre_build_info.platform_toolset = variable_value;
+        else if (variable_name == "VCPKG_BUILD_TYPE")
+        {
+            if (variable_value.empty())
+                pre_build_info.build_type = nullopt;
+            else if (variable_value == "release")
+                pre_build_info.build_type = ConfigurationType::RELEASE;
+            else
+                Checks::exit_with_message(VCPKG_LINE_INFO, "Unknown setting for VCPKG_BUILD_TYPE: %s", variable_value);
+        }
+        else
+            return false;
+
+        return true;
+    }
+
+    static std::vector<std::string> serialize_pre_build_info(const PreBuildInfo& pre_build_info)
+    {
+        return {
+            "VCPKG_TARGET_ARCHITECTURE=" + pre_build_info.target_architecture,
+            "VCPKG_CMAKE_SYSTEM_NAME=" + pre_build_info.cmake_system_name,
+            "VCPKG_CMAKE_SYSTEM_VERSION=" + pre_build_info.cmake_system_version,
+            "VCPKG_PLATFORM_TOOLSET=" + pre_build_info.platform_toolset,
+            std::string("VCPKG_BUILD_TYPE=") + (pre_build_info.build_type ? "release" : ""),
+        };
+    }
+
+    /// <summary>
+    /// Hashes everything the result of get_triplet_environment.cmake depends on: the triplet file and the script
+    /// </summary>
+    static std::string get_triplet_environment_hash(const VcpkgPaths& paths, const fs::path& triplet_file_path)
+    {
+        const auto& fs = paths.get_filesystem();
+
+        StableHash hash;
+        for (auto&& input : {triplet_file_path, paths.scripts / "get_triplet_environment.cmake"})
+        {
+            const Expected<std::string> contents = fs.read_contents(input);
+            const auto text = contents.get();
+            if (!text) return Strings::EMPTY;
+
+            hash.add(*text);
+        }
+
+        return hash.to_string();
+    }
+
+    /// <summary>
+    /// The cache file starts with the hash of the inputs, followed by the variables in the format printed by
+    /// get_triplet_environment.cmake.
+    /// </summary>
+    static Optional<PreBuildInfo> try_load_cached_pre_build_info(const Files::Filesystem& fs,
+                                                                 const fs::path& cache_path,
+                                                                 const std::string& hash)
+    {
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(cache_path);
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->empty() || lines->front() != hash) return nullopt;
+
+        PreBuildInfo pre_build_info;
+        for (auto it = lines->cbegin() + 1; it != lines->cend(); ++it)
+        {
+            const size_t equals = it->find('=');
+            if (equals == std::string::npos) return nullopt;
+            if (!try_set_pre_build_variable(pre_build_info, it->substr(0, equals), it->substr(equals + 1)))
+                return nullopt;
+        }
+
+        return pre_build_info;
+    }
+
+    /// <summary>
+    /// Captures the triplet files in one launch of CMake. The script prints a TRIPLET=name line before the variables
+    /// of each file.
+    /// </summary>
+    static std::map<std::string, PreBuildInfo> run_triplet_files(const VcpkgPaths& paths,
+                                                                 const std::vector<fs::path>& triplet_file_paths)
     {
         static constexpr CStringView FLAG_GUID = "c35112b6-d1ba-415b-aa5d-81de856ef8eb";
 
         const fs::path& cmake_exe_path = paths.get_cmake_exe();
         const fs::path ports_cmake_script_path = paths.scripts / "get_triplet_environment.cmake";
-        const fs::path triplet_file_path = paths.triplets / (triplet.canonical_name() + ".cmake");
 
+        const std::wstring triplet_files =
+            Strings::join(L";", triplet_file_paths, [](const fs::path& path) { return path.generic_wstring(); });
         const std::wstring cmd_launch_cmake = make_cmake_cmd(cmake_exe_path,
                                                              ports_cmake_script_path,
                                                              {
-                                                                 {L"CMAKE_TRIPLET_FILE", triplet_file_path},
+                                                                 {L"CMAKE_TRIPLET_FILES", triplet_files},
                                                              });
 
         const std::wstring command = Strings::wformat(LR"(%s)", cmd_launch_cmake);
@@ -346,7 +1263,8 @@ namespace vcpkg::Build
 
         const std::vector<std::string> lines = Strings::split(ec_data.output, "\n");
 
-        PreBuildInfo pre_build_info;
+        std::map<std::string, PreBuildInfo> pre_build_infos;
+        PreBuildInfo* pre_build_info = nullptr;
 
         const auto e = lines.cend();
         auto cur = std::find(lines.cbegin(), e, FLAG_GUID);
@@ -366,33 +1284,97 @@ namespace vcpkg::Build
             const std::string variable_name = s.at(0);
             const std::string variable_value = variable_with_no_value ? Strings::EMPTY : s.at(1);
 
-            if (variable_name == "VCPKG_TARGET_ARCHITECTURE")
+            if (variable_name == "TRIPLET")
             {
-                pre_build_info.target_architecture = variable_value;
+                pre_build_info = &pre_build_infos[variable_value];
                 continue;
             }
 
-            if (variable_name == "VCPKG_CMAKE_SYSTEM_NAME")
+            if (!pre_build_info || !try_set_pre_build_variable(*pre_build_info, variable_name, variable_value))
             {
-                pre_build_info.cmake_system_name = variable_value;
-                continue;
+                Checks::exit_with_message(VCPKG_LINE_INFO, "Unknown variable name %s", line);
             }
+        }
+
+        return pre_build_infos;
+    }
+
+    PreBuildInfo PreBuildInfo::from_triplet_file(const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        // Every triplet is captured on the first call, which the other builds wait for instead of capturing again
+        static Util::LockGuarded<std::map<std::string, PreBuildInfo>> memoized;
+        auto locked = memoized.lock();
 
-            if (variable_name == "VCPKG_CMAKE_SYSTEM_VERSION")
+        const std::string& triplet_name = triplet.canonical_name();
+        const auto it = locked->find(triplet_name);
+        if (it != locked->cend()) return it->second;
+
+        const Timings::ScopedTimer timer("triplet capture", triplet_name);
+
+        auto& fs = paths.get_filesystem();
+        std::vector<std::string> triplet_names = paths.get_available_triplets();
+        if (Util::find(triplet_names, triplet_name) == triplet_names.cend()) triplet_names.push_back(triplet_name);
+
+        std::vector<fs::path> stale_triplet_files;
+        std::map<std::string, std::string> stale_hashes;
+        for (auto&& name : triplet_names)
+        {
+            const fs::path triplet_file_path = paths.triplets / (name + ".cmake");
+            const std::string hash = get_triplet_environment_hash(paths, triplet_file_path);
+            const Optional<PreBuildInfo> maybe_cached =
+                hash.empty() ? Optional<PreBuildInfo>()
+                             : try_load_cached_pre_build_info(
+                                   fs, paths.pre_build_info_path(Triplet::from_canonical_name(name)), hash);
+
+            if (const auto cached = maybe_cached.get())
             {
-                pre_build_info.cmake_system_version = variable_value;
-                continue;
+                locked->emplace(name, *cached);
             }
-
-            if (variable_name == "VCPKG_PLATFORM_TOOLSET")
+            else
             {
-                pre_build_info.platform_toolset = variable_value;
-                continue;
+                stale_triplet_files.push_back(triplet_file_path);
+                stale_hashes.emplace(name, hash);
             }
+        }
 
-            Checks::exit_with_message(VCPKG_LINE_INFO, "Unknown variable name %s", line);
+        if (!stale_triplet_files.empty())
+        {
+            for (auto&& captured : run_triplet_files(paths, stale_triplet_files))
+            {
+                const std::string& hash = stale_hashes[captured.first];
+                if (!hash.empty())
+                {
+                    std::vector<std::string> lines = serialize_pre_build_info(captured.second);
+                    lines.insert(lines.begin(), hash);
+
+                    const fs::path cache_path = paths.pre_build_info_path(Triplet::from_canonical_name(captured.first));
+                    const fs::path tmp_path = cache_path.parent_path() / (cache_path.filename().u8string() + ".tmp");
+                    fs.write_lines(tmp_path, lines);
+                    std::error_code ec;
+                    fs.rename(tmp_path, cache_path, ec);
+                }
+                locked->emplace(captured.first, std::move(captured.second));
+            }
         }
 
-        return pre_build_info;
+        const auto captured = locked->find(triplet_name);
+        Checks::check_exit(VCPKG_LINE_INFO, captured != locked->cend(), "Could not capture triplet %s", triplet_name);
+        return captured->second;
+    }
+
+    void start_warm_up(const VcpkgPaths& paths, std::vector<LazyTool> tools, std::vector<Triplet> triplets)
+    {
+        const VcpkgPaths* const p = &paths;
+        std::thread([p, tools = std::move(tools), triplets = std::move(triplets)]() {
+            const Timings::ScopedTimer timer("warm-up", "tools");
+            p->warm_up(tools);
+
+            // Capturing the triplets runs cmake, which is not downloaded here either
+            if (triplets.empty() || !p->warm_up({LazyTool::CMAKE})) return;
+            for (auto&& triplet : triplets)
+            {
+                PreBuildInfo::from_triplet_file(*p, triplet);
+            }
+        }).detach();
     }
 }
@@ -0,0 +1,95 @@
+#include "pch.h"
+
+#include "vcpkg_BuildLogs.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_PackageArchive.h"
+#include "vcpkg_System.h"
+
+namespace vcpkg::BuildLogs
+{
+    fs::path get_archive_path(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        return paths.buildtrees / spec.name() / (spec.triplet().canonical_name() + ".vcpkg_logs");
+    }
+
+    static bool names_triplet(const std::string& file_name, const std::string& triplet)
+    {
+        static const std::string LOG_EXTENSION = ".log";
+        if (file_name.size() <= LOG_EXTENSION.size() ||
+            file_name.compare(file_name.size() - LOG_EXTENSION.size(), LOG_EXTENSION.size(), LOG_EXTENSION) != 0)
+        {
+            return false;
+        }
+
+        const std::string dashed = '-' + triplet;
+        for (size_t pos = file_name.find(dashed); pos != std::string::npos; pos = file_name.find(dashed, pos + 1))
+        {
+            const size_t end = pos + dashed.size();
+            if (end == file_name.size() - LOG_EXTENSION.size() || file_name[end] == '-') return true;
+        }
+        return false;
+    }
+
+    bool is_log_of_triplet(const std::string& file_name,
+                           const std::string& triplet,
+                           const std::vector<std::string>& triplets)
+    {
+        if (!names_triplet(file_name, triplet)) return false;
+        return std::none_of(triplets.cbegin(), triplets.cend(), [&](const std::string& other) {
+            return other.size() > triplet.size() && names_triplet(file_name, other);
+        });
+    }
+
+    void archive_logs(const VcpkgPaths& paths, const PackageSpec& spec, const fs::file_time_type& build_start)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path buildtrees_dir = paths.buildtrees / spec.name();
+        if (!fs.is_directory(buildtrees_dir)) return;
+
+        const std::string triplet = spec.triplet().canonical_name();
+        const std::vector<std::string>& triplets = paths.get_available_triplets();
+        std::vector<fs::path> logs;
+        for (auto&& entry : fs.get_entries_non_recursive(buildtrees_dir))
+        {
+            if (!fs::is_regular_file(entry.status)) continue;
+            if (!is_log_of_triplet(entry.path.filename().u8string(), triplet, triplets)) continue;
+
+            std::error_code ec;
+            const fs::file_time_type last_write_time = fs.last_write_time(entry.path, ec);
+            if (!ec && last_write_time >= build_start) logs.push_back(entry.path);
+        }
+
+        // The logs of the previous build would not match the plain logs anymore
+        const fs::path archive = get_archive_path(paths, spec);
+        std::error_code ec;
+        fs.remove(archive, ec);
+        if (logs.empty()) return;
+
+        std::sort(logs.begin(), logs.end());
+        const fs::path tmp_path = archive.parent_path() / (archive.filename().u8string() + ".tmp");
+        const auto maybe_entries = PackageArchive::create(fs, logs, tmp_path);
+        if (!maybe_entries.has_value())
+        {
+            System::println(System::Color::warning, "Failed to archive the logs: %s", maybe_entries.error());
+            fs.remove(tmp_path, ec);
+            return;
+        }
+        fs.rename(tmp_path, archive, ec);
+    }
+
+    void remove_archived_logs(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        auto& fs = paths.get_filesystem();
+        const auto maybe_entries = PackageArchive::read_table(get_archive_path(paths, spec));
+        const auto entries = maybe_entries.get();
+        if (!entries) return;
+
+        const fs::path buildtrees_dir = paths.buildtrees / spec.name();
+        for (auto&& entry : *entries)
+        {
+            const fs::path log = buildtrees_dir / Strings::to_utf16(entry.path);
+            std::error_code ec;
+            if (fs.file_size(log, ec) == entry.size && !ec) fs.remove(log, ec);
+        }
+    }
+}
@@ -0,0 +1,256 @@
+#include "pch.h"
+
+#include "Paragraphs.h"
+#include "vcpkg_BinaryCaching.h"
+#include "vcpkg_BuildQueue.h"
+#include "vcpkg_Chrono.h"
+#include "vcpkg_GlobalState.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Util.h"
+
+#include <thread>
+
+namespace vcpkg::BuildQueue
+{
+    using namespace std::chrono_literals;
+
+    static constexpr auto POLL_INTERVAL = 1s;
+
+    /// <summary>
+    /// How long a build may wait for a worker before the coordinator takes it back and builds it itself
+    /// </summary>
+    static constexpr auto UNCLAIMED_TIMEOUT = 10min;
+
+    static fs::path pending_path(const fs::path& queue_dir, const std::string& abi_tag)
+    {
+        return queue_dir / "pending" / (abi_tag + ".job");
+    }
+
+    static fs::path claimed_path(const fs::path& queue_dir, const std::string& abi_tag)
+    {
+        return queue_dir / "claimed" / (abi_tag + ".job");
+    }
+
+    static fs::path lock_path(const fs::path& queue_dir, const std::string& abi_tag)
+    {
+        return queue_dir / "claimed" / (abi_tag + ".lock");
+    }
+
+    static fs::path result_path(const fs::path& queue_dir, const std::string& abi_tag)
+    {
+        return queue_dir / "done" / (abi_tag + ".result");
+    }
+
+    /// <summary>
+    /// Writes a temporary file and renames it into place, so that the other side never reads half of it
+    /// </summary>
+    static void write_atomically(Files::Filesystem& fs, const fs::path& path, const std::string& contents)
+    {
+        std::error_code ec;
+        fs.create_directories(path.parent_path(), ec);
+        fs::path tmp = path;
+        tmp += Strings::format(".%d.tmp", static_cast<int>(GetCurrentProcessId()));
+        fs.write_contents(tmp, contents);
+        fs.rename(tmp, path);
+    }
+
+    std::string serialize_job(const Job& job)
+    {
+        std::string text = Strings::format("Package: %s\nTriplet: %s\nAbi: %s\n",
+                                           job.spec.name(),
+                                           job.spec.triplet().canonical_name(),
+                                           job.abi_tag);
+        if (!job.features.empty()) text += Strings::format("Features: %s\n", Strings::join(";", job.features));
+        return text;
+    }
+
+    Optional<Job> parse_job(const std::string& text)
+    {
+        const Expected<Paragraphs::RawParagraph> maybe_paragraph = Paragraphs::parse_single_paragraph(text);
+        const auto paragraph = maybe_paragraph.get();
+        if (!paragraph) return nullopt;
+
+        const auto field = [&](const std::string& name) {
+            const auto it = paragraph->find(name);
+            return it == paragraph->cend() ? std::string() : it->second;
+        };
+
+        const std::string name = field("Package");
+        const std::string triplet = field("Triplet");
+        const std::string abi_tag = field("Abi");
+        if (name.empty() || triplet.empty() || abi_tag.empty()) return nullopt;
+
+        const auto maybe_spec = PackageSpec::from_name_and_triplet(name, Triplet::from_canonical_name(triplet));
+        const auto spec = maybe_spec.get();
+        if (!spec) return nullopt;
+
+        const std::string features = field("Features");
+        return Job{*spec, abi_tag, features.empty() ? std::vector<std::string>() : Strings::split(features, ";")};
+    }
+
+    Optional<fs::path> get_queue_dir()
+    {
+        const Optional<std::wstring> queue_dir = System::get_environment_variable(L"VCPKG_BUILD_QUEUE");
+        if (const auto p = queue_dir.get())
+        {
+            return fs::path(*p);
+        }
+        return nullopt;
+    }
+
+    /// <summary>
+    /// Reads and removes the result of the job; nullopt for ABI_MISMATCH and anything else which is not a result
+    /// </summary>
+    static Optional<Build::BuildResult> take_result(Files::Filesystem& fs, const fs::path& queue_dir, const Job& job)
+    {
+        const fs::path path = result_path(queue_dir, job.abi_tag);
+        const Expected<std::string> contents = fs.read_contents(path);
+        const Expected<Paragraphs::RawParagraph> maybe_paragraph =
+            Paragraphs::parse_single_paragraph(contents.get() ? *contents.get() : Strings::EMPTY);
+        std::error_code ec;
+        fs.remove(path, ec);
+        fs.remove(claimed_path(queue_dir, job.abi_tag), ec);
+        fs.remove(lock_path(queue_dir, job.abi_tag), ec);
+
+        const auto paragraph = maybe_paragraph.get();
+        if (!paragraph) return nullopt;
+        const auto result = paragraph->find("Result");
+        const auto worker = paragraph->find("Worker");
+        const std::string worker_name = worker == paragraph->cend() ? "a worker" : worker->second;
+        if (result == paragraph->cend()) return nullopt;
+
+        for (const Build::BuildResult code : Build::BUILD_RESULT_VALUES)
+        {
+            if (Build::to_string(code) != result->second) continue;
+
+            System::println("Package %s was built by %s: %s", job.spec, worker_name, Build::to_string(code));
+            return code;
+        }
+
+        System::println(System::Color::warning,
+                        "Package %s could not be built by %s (%s); building it here",
+                        job.spec,
+                        worker_name,
+                        result->second);
+        return nullopt;
+    }
+
+    Optional<Build::BuildResult> try_build_remotely(const VcpkgPaths& paths,
+                                                    const Build::BuildPackageConfig& config,
+                                                    const std::vector<Build::AbiEntry>& dependency_abis)
+    {
+        const Optional<fs::path> maybe_queue_dir = get_queue_dir();
+        const auto queue_dir = maybe_queue_dir.get();
+        if (!queue_dir) return nullopt;
+
+        const Optional<std::string> maybe_abi_tag = Build::compute_abi_tag(paths, config, dependency_abis);
+        const auto abi_tag = maybe_abi_tag.get();
+        if (!abi_tag) return nullopt;
+
+        Job job{PackageSpec::from_name_and_triplet(config.src.name, config.triplet).value_or_exit(VCPKG_LINE_INFO),
+                *abi_tag,
+                {}};
+        if (GlobalState::feature_packages && config.feature_list)
+        {
+            job.features.assign(config.feature_list->cbegin(), config.feature_list->cend());
+            std::sort(job.features.begin(), job.features.end());
+        }
+
+        // Nothing to hand out when another build already published the package
+        auto& fs = paths.get_filesystem();
+        const fs::path archive = Build::get_archive_path(paths, *abi_tag);
+        if (fs.exists(archive) || BinaryCaching::try_restore_from_sources(paths, job.spec, *abi_tag, archive))
+        {
+            return Build::BuildResult::SUCCEEDED;
+        }
+
+        System::println("Queueing package %s for a worker", job.spec);
+        const fs::path pending = pending_path(*queue_dir, *abi_tag);
+        write_atomically(fs, pending, serialize_job(job));
+
+        const ElapsedTime waiting = ElapsedTime::create_started();
+        for (;;)
+        {
+            std::this_thread::sleep_for(POLL_INTERVAL);
+
+            if (fs.exists(result_path(*queue_dir, *abi_tag))) return take_result(fs, *queue_dir, job);
+
+            std::error_code ec;
+            if (fs.exists(pending))
+            {
+                // Removing the job fails when a worker is claiming it meanwhile
+                if (waiting.elapsed<std::chrono::minutes>() >= UNCLAIMED_TIMEOUT && fs.remove(pending, ec))
+                {
+                    System::println(
+                        System::Color::warning, "No worker took package %s; building it here", job.spec);
+                    return nullopt;
+                }
+                continue;
+            }
+
+            if (!fs.exists(claimed_path(*queue_dir, *abi_tag))) return nullopt;
+
+            // The worker writes the result before it releases the lock, so only a worker which died leaves neither
+            const Files::FileLock lock = fs.try_lock_file(lock_path(*queue_dir, *abi_tag), Files::LockMode::EXCLUSIVE);
+            if (lock.is_held() && !fs.exists(result_path(*queue_dir, *abi_tag)))
+            {
+                fs.remove(claimed_path(*queue_dir, *abi_tag), ec);
+                System::println(System::Color::warning,
+                                "The worker which took package %s stopped without a result; building it here",
+                                job.spec);
+                return nullopt;
+            }
+        }
+    }
+
+    Optional<ClaimedJob> try_claim(Files::Filesystem& fs, const fs::path& queue_dir)
+    {
+        std::vector<Files::DirectoryEntry> pending = fs.get_entries_non_recursive(queue_dir / "pending");
+        std::sort(pending.begin(),
+                  pending.end(),
+                  [](const Files::DirectoryEntry& left, const Files::DirectoryEntry& right) {
+                      return left.last_write_time < right.last_write_time;
+                  });
+
+        std::error_code ec;
+        fs.create_directories(queue_dir / "claimed", ec);
+        for (auto&& entry : pending)
+        {
+            if (entry.path.extension() != ".job") continue;
+
+            // The lock comes first, so that a claimed job is never seen without it
+            const std::string abi_tag = entry.path.stem().u8string();
+            Files::FileLock lock = fs.try_lock_file(lock_path(queue_dir, abi_tag), Files::LockMode::EXCLUSIVE);
+            if (!lock.is_held()) continue;
+
+            // Only one worker can move the job, and not after the coordinator took it back
+            const fs::path claimed = claimed_path(queue_dir, abi_tag);
+            fs.rename(entry.path, claimed, ec);
+            if (ec) continue;
+
+            const Expected<std::string> contents = fs.read_contents(claimed);
+            const Optional<Job> job = contents.get() ? parse_job(*contents.get()) : nullopt;
+            if (const auto p = job.get())
+            {
+                return ClaimedJob{*p, std::move(lock)};
+            }
+
+            System::println(System::Color::warning, "Ignoring the malformed job %s", claimed.u8string());
+            fs.remove(claimed, ec);
+        }
+        return nullopt;
+    }
+
+    void complete(Files::Filesystem& fs,
+                  const fs::path& queue_dir,
+                  const ClaimedJob& claimed,
+                  const std::string& result)
+    {
+        const std::string worker =
+            Strings::to_utf8(System::get_environment_variable(L"COMPUTERNAME").value_or(L"a worker"));
+        write_atomically(fs,
+                         result_path(queue_dir, claimed.job.abi_tag),
+                         Strings::format("Result: %s\nWorker: %s\n", result, worker));
+    }
+}
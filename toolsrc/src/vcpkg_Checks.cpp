@@ -4,6 +4,7 @@
 #include "vcpkg_Checks.h"
 #include "vcpkg_GlobalState.h"
 #include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
 #include "vcpkglib.h"
 
 namespace vcpkg::Checks
@@ -12,11 +13,14 @@ namespace vcpkg::Checks
     {
         const auto elapsed_us = GlobalState::timer.lock()->microseconds();
 
+        Timings::g_timings.lock()->flush();
+
         auto metrics = Metrics::g_metrics.lock();
         metrics->track_metric("elapsed_us", elapsed_us);
         GlobalState::debugging = false;
         metrics->flush();
 
+        System::flush_all_output();
         SetConsoleCP(GlobalState::g_init_console_cp);
         SetConsoleOutputCP(GlobalState::g_init_console_output_cp);
 
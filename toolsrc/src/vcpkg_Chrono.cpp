@@ -5,7 +5,7 @@
 
 namespace vcpkg
 {
-    static std::string format_time_userfriendly(const std::chrono::nanoseconds& nanos)
+    std::string format_time_userfriendly(const std::chrono::nanoseconds& nanos)
     {
         using std::chrono::duration_cast;
         using std::chrono::hours;
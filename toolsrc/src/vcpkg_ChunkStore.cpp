@@ -0,0 +1,290 @@
+#include "pch.h"
+
+#include "vcpkg_ChunkStore.h"
+#include "vcpkg_Commands.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+
+// An index is a text file:
+//     vcpkg chunks 1
+// followed by a line per chunk, in the order of the archive:
+//     <sha256> <size>
+namespace vcpkg::ChunkStore
+{
+    static constexpr auto INDEX_HEADER = "vcpkg chunks 1";
+
+    // The cuts of every machine must agree for the chunks to be shared, so these and the table must never change
+    static constexpr size_t NORMAL_CHUNK_SIZE = 512 * 1024;
+    // Before the normal size a cut needs more bits of the hash to be zero than after it, which keeps most chunks
+    // close to the normal size
+    static constexpr uint64_t HARD_MASK = ~uint64_t(0) << (64 - 21);
+    static constexpr uint64_t EASY_MASK = ~uint64_t(0) << (64 - 17);
+
+    /// <summary>
+    /// A random number for each byte value, from splitmix64 seeded with 0; the hash shifts one bit a byte, so only
+    /// the last 64 bytes take part in it
+    /// </summary>
+    static const std::array<uint64_t, 256>& get_gear_table()
+    {
+        static const std::array<uint64_t, 256> TABLE = []() {
+            std::array<uint64_t, 256> table;
+            uint64_t state = 0;
+            for (auto&& entry : table)
+            {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                entry = z ^ (z >> 31);
+            }
+            return table;
+        }();
+        return TABLE;
+    }
+
+    size_t find_cut(const char* data, const size_t size)
+    {
+        if (size <= MIN_CHUNK_SIZE) return size;
+
+        const std::array<uint64_t, 256>& gear = get_gear_table();
+        const size_t end = std::min(size, MAX_CHUNK_SIZE);
+        const size_t normal_end = std::min(end, NORMAL_CHUNK_SIZE);
+        const unsigned char* const bytes = reinterpret_cast<const unsigned char*>(data);
+
+        // The bytes before the minimum only matter as far as they are still in the hash
+        uint64_t hash = 0;
+        size_t i = MIN_CHUNK_SIZE - 64;
+        for (; i < MIN_CHUNK_SIZE; ++i)
+            hash = (hash << 1) + gear[bytes[i]];
+        for (; i < normal_end; ++i)
+        {
+            hash = (hash << 1) + gear[bytes[i]];
+            if ((hash & HARD_MASK) == 0) return i + 1;
+        }
+        for (; i < end; ++i)
+        {
+            hash = (hash << 1) + gear[bytes[i]];
+            if ((hash & EASY_MASK) == 0) return i + 1;
+        }
+        return end;
+    }
+
+    static std::string hash_chunk(const char* data, const size_t size)
+    {
+        Commands::Hash::Hasher hasher("SHA256");
+        hasher.add(data, size);
+        return hasher.finish();
+    }
+
+    ExpectedT<std::vector<Chunk>, std::string> split_file(const fs::path& file)
+    {
+        std::ifstream input(file, std::ios::binary);
+        if (!input) return Strings::format("Error: could not open %s", file.u8string());
+
+        std::vector<Chunk> chunks;
+        std::vector<char> buffer(MAX_CHUNK_SIZE);
+        size_t filled = 0;
+        uint64_t offset = 0;
+        for (;;)
+        {
+            // A cut is only final once the buffer holds the largest chunk, or the rest of the file
+            input.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+            filled += static_cast<size_t>(input.gcount());
+            if (input.bad()) return Strings::format("Error: could not read %s", file.u8string());
+            if (filled == 0) return std::move(chunks);
+
+            const size_t cut = find_cut(buffer.data(), filled);
+            chunks.push_back({hash_chunk(buffer.data(), cut), offset, cut});
+            offset += cut;
+            std::memmove(buffer.data(), buffer.data() + cut, filled - cut);
+            filled -= cut;
+        }
+    }
+
+    fs::path get_index_path(const fs::path& archive)
+    {
+        fs::path index = archive;
+        index.replace_extension(".vpkgi");
+        return index;
+    }
+
+    std::string format_index(const std::vector<Chunk>& chunks)
+    {
+        std::string text = INDEX_HEADER;
+        text.push_back('\n');
+        for (auto&& chunk : chunks)
+            text.append(Strings::format("%s %s\n", chunk.sha256, std::to_string(chunk.size)));
+        return text;
+    }
+
+    ExpectedT<std::vector<Chunk>, std::string> parse_index(const std::string& text)
+    {
+        const std::vector<std::string> lines = Strings::split(text, "\n");
+        if (lines.empty() || Strings::trimmed(lines.front()) != INDEX_HEADER)
+        {
+            return std::string("Error: not an index of chunks");
+        }
+
+        std::vector<Chunk> chunks;
+        uint64_t offset = 0;
+        for (auto it = lines.cbegin() + 1; it != lines.cend(); ++it)
+        {
+            const std::string line = Strings::trimmed(*it);
+            if (line.empty()) continue;
+
+            const size_t space = line.find(' ');
+            const std::string size_text = space == std::string::npos ? std::string() : line.substr(space + 1);
+            const bool is_valid = space == 64 && !size_text.empty() && size_text.size() <= 10 &&
+                                  std::all_of(size_text.cbegin(), size_text.cend(), [](const char c) {
+                                      return isdigit(static_cast<unsigned char>(c)) != 0;
+                                  });
+            if (!is_valid) return Strings::format("Error: '%s' is not a chunk", line);
+
+            const uint64_t size = std::stoull(size_text);
+            if (size == 0 || size > MAX_CHUNK_SIZE) return Strings::format("Error: '%s' is not a chunk", line);
+            chunks.push_back({line.substr(0, space), offset, size});
+            offset += size;
+        }
+        return std::move(chunks);
+    }
+
+    bool read_chunk(const fs::path& archive, const Chunk& chunk, std::string& data)
+    {
+        std::ifstream input(archive, std::ios::binary);
+        if (!input) return false;
+        input.seekg(static_cast<std::streamoff>(chunk.offset));
+        data.resize(static_cast<size_t>(chunk.size));
+        input.read(&data[0], static_cast<std::streamsize>(data.size()));
+        return input.good() && hash_chunk(data.data(), data.size()) == chunk.sha256;
+    }
+
+    struct LocalChunk
+    {
+        fs::path archive;
+        Chunk chunk;
+    };
+
+    /// <summary>
+    /// Where each chunk of the indexed archives of the local binary cache is, loaded once per process
+    /// </summary>
+    struct LocalChunks
+    {
+        std::mutex mutex;
+        fs::path cache_dir;
+        bool is_loaded = false;
+        std::unordered_map<std::string, LocalChunk> chunks;
+
+        // Called with the mutex held
+        void add(const fs::path& archive, const std::vector<Chunk>& archive_chunks)
+        {
+            for (auto&& chunk : archive_chunks)
+                chunks.emplace(chunk.sha256, LocalChunk{archive, chunk});
+        }
+
+        // Called with the mutex held
+        void load(const Files::Filesystem& fs, const fs::path& dir)
+        {
+            if (is_loaded && cache_dir == dir) return;
+            chunks.clear();
+            cache_dir = dir;
+            is_loaded = true;
+            if (!fs.exists(dir)) return;
+
+            for (auto&& prefix_dir : fs.get_files_non_recursive(dir))
+            {
+                if (!fs.is_directory(prefix_dir)) continue;
+                for (auto&& index : fs.get_files_non_recursive(prefix_dir))
+                {
+                    if (index.extension() != ".vpkgi") continue;
+
+                    fs::path archive = index;
+                    archive.replace_extension(".vpkg");
+                    if (!fs.exists(archive)) continue;
+
+                    const Expected<std::string> text = fs.read_contents(index);
+                    if (!text.has_value()) continue;
+                    const auto maybe_chunks = parse_index(*text.get());
+                    if (const auto archive_chunks = maybe_chunks.get()) add(archive, *archive_chunks);
+                }
+            }
+        }
+    };
+
+    static LocalChunks g_local_chunks;
+
+    ExpectedT<std::vector<Chunk>, std::string> index_archive(Files::Filesystem& fs, const fs::path& archive)
+    {
+        auto maybe_chunks = split_file(archive);
+        const auto chunks = maybe_chunks.get();
+        if (!chunks) return maybe_chunks.error();
+
+        fs.write_contents(get_index_path(archive), format_index(*chunks));
+        std::lock_guard<std::mutex> lock(g_local_chunks.mutex);
+        if (g_local_chunks.is_loaded) g_local_chunks.add(archive, *chunks);
+        return std::move(*chunks);
+    }
+
+    ExpectedT<uint64_t, std::string> assemble(Files::Filesystem& fs,
+                                              const fs::path& cache_dir,
+                                              const std::vector<Chunk>& chunks,
+                                              const fs::path& output,
+                                              const FetchChunk& fetch)
+    {
+        // Found under the lock, and read without it
+        std::vector<Optional<LocalChunk>> local(chunks.size());
+        {
+            std::lock_guard<std::mutex> lock(g_local_chunks.mutex);
+            g_local_chunks.load(fs, cache_dir);
+            for (size_t i = 0; i < chunks.size(); ++i)
+            {
+                const auto it = g_local_chunks.chunks.find(chunks[i].sha256);
+                if (it != g_local_chunks.chunks.end()) local[i] = it->second;
+            }
+        }
+
+        std::ofstream stream(output, std::ios::binary | std::ios::trunc);
+        if (!stream) return Strings::format("Error: could not write %s", output.u8string());
+
+        // The chunks which are not found locally are fetched concurrently, a batch at a time, which bounds the memory
+        static constexpr size_t BATCH_SIZE = 16;
+        std::atomic<uint64_t> fetched_bytes{0};
+        std::vector<std::string> batch(BATCH_SIZE);
+        std::vector<std::string> errors(BATCH_SIZE);
+        for (size_t begin = 0; begin < chunks.size(); begin += BATCH_SIZE)
+        {
+            const size_t count = std::min(BATCH_SIZE, chunks.size() - begin);
+            Util::parallel_for_each_index(count, [&](const size_t k) {
+                const Chunk& chunk = chunks[begin + k];
+                std::string& data = batch[k];
+                errors[k].clear();
+
+                // An archive of the cache may have been replaced since it was indexed, so its chunks are checked too
+                const auto p_local = local[begin + k].get();
+                if (p_local && read_chunk(p_local->archive, p_local->chunk, data)) return;
+
+                if (!fetch(chunk, data))
+                {
+                    errors[k] = Strings::format("Error: could not fetch the chunk %s", chunk.sha256);
+                }
+                else if (data.size() != chunk.size || hash_chunk(data.data(), data.size()) != chunk.sha256)
+                {
+                    errors[k] = Strings::format("Error: the chunk %s does not have the expected contents", chunk.sha256);
+                }
+                else
+                {
+                    fetched_bytes += data.size();
+                }
+            });
+
+            for (size_t k = 0; k < count; ++k)
+            {
+                if (!errors[k].empty()) return errors[k];
+                stream.write(batch[k].data(), static_cast<std::streamsize>(batch[k].size()));
+            }
+            if (!stream) return Strings::format("Error: could not write %s", output.u8string());
+        }
+
+        stream.close();
+        if (!stream) return Strings::format("Error: could not write %s", output.u8string());
+        return fetched_bytes.load();
+    }
+}
@@ -0,0 +1,125 @@
+#include "pch.h"
+
+#include "vcpkg_Commands.h"
+#include "vcpkg_ContentStore.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+
+namespace vcpkg::ContentStore
+{
+    fs::path store_dir(const fs::path& installed_dir) { return installed_dir / "vcpkg" / "store"; }
+
+    fs::path links_path(const fs::path& listfile_path)
+    {
+        fs::path path = listfile_path;
+        path += ".links";
+        return path;
+    }
+
+    std::vector<Link> read_links(const Files::Filesystem& fs, const fs::path& listfile_path)
+    {
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(links_path(listfile_path));
+        const auto lines = maybe_lines.get();
+        if (!lines) return {};
+
+        std::vector<Link> links;
+        for (auto&& line : *lines)
+        {
+            // Keys have no semicolons, so the path is everything after the first one
+            const size_t separator = line.find(';');
+            if (separator == std::string::npos) continue;
+            links.push_back({line.substr(0, separator), line.substr(separator + 1)});
+        }
+        return links;
+    }
+
+    void write_links(Files::Filesystem& fs, const fs::path& listfile_path, const std::vector<Link>& links)
+    {
+        const fs::path path = links_path(listfile_path);
+        if (links.empty())
+        {
+            std::error_code ec;
+            fs.remove(path, ec);
+            return;
+        }
+
+        fs.write_lines(path, Util::fmap(links, [](const Link& link) { return link.key + ';' + link.path; }));
+    }
+
+    static fs::path entry_path(const fs::path& store_dir, const std::string& key)
+    {
+        // Spread over subdirectories so that none of them grows too large to enumerate
+        return store_dir / key.substr(0, 2) / key;
+    }
+
+    static Optional<std::string> hash_file(const Files::Filesystem& fs, const fs::path& file)
+    {
+        const Expected<Files::MappedFile> maybe_file = fs.map_contents(file);
+        const auto mapped = maybe_file.get();
+        if (!mapped) return nullopt;
+
+        Commands::Hash::Hasher hasher("SHA256");
+        hasher.add(mapped->data.get(), mapped->size);
+        return hasher.finish();
+    }
+
+    Optional<std::string> link(Files::Filesystem& fs,
+                               const fs::path& store_dir,
+                               const fs::path& source,
+                               const fs::path& target,
+                               const std::uintmax_t size)
+    {
+        const Optional<std::string> maybe_key = hash_file(fs, source);
+        const auto key = maybe_key.get();
+        if (!key) return nullopt;
+
+        const fs::path entry = entry_path(store_dir, *key);
+        std::error_code ec;
+        const std::uintmax_t stored_size = fs.file_size(entry, ec);
+        if (ec)
+        {
+            // Files are installed in parallel, so the entry is copied under a name of its own and renamed into place
+            fs.create_directories(entry.parent_path(), ec);
+            fs::path tmp_path = entry;
+            tmp_path += Strings::format(
+                ".%d.%d.tmp", static_cast<int>(GetCurrentProcessId()), static_cast<int>(GetCurrentThreadId()));
+            fs.copy_file(source, tmp_path, fs::copy_options::overwrite_existing, ec);
+            if (!ec) fs.rename(tmp_path, entry, ec);
+            if (ec)
+            {
+                fs.remove(tmp_path, ec);
+                return nullopt;
+            }
+        }
+        else if (stored_size != size)
+        {
+            // The hashes say the contents are the same; an entry of another size was damaged
+            return nullopt;
+        }
+
+        fs.create_hard_link(entry, target, ec);
+        if (ec) return nullopt;
+        return *key;
+    }
+
+    Optional<std::string> find(const Files::Filesystem& fs, const fs::path& store_dir, const fs::path& file)
+    {
+        Optional<std::string> maybe_key = hash_file(fs, file);
+        const auto key = maybe_key.get();
+        if (!key || !fs.exists(entry_path(store_dir, *key))) return nullopt;
+        return maybe_key;
+    }
+
+    void release(Files::Filesystem& fs, const fs::path& store_dir, const std::vector<std::string>& keys)
+    {
+        std::unordered_set<std::string> released;
+        for (auto&& key : keys)
+        {
+            if (!released.insert(key).second) continue;
+
+            const fs::path entry = entry_path(store_dir, key);
+            std::error_code ec;
+            if (fs.hard_link_count(entry, ec) == 1) fs.remove(entry, ec);
+        }
+    }
+}
@@ -8,6 +8,7 @@
 #include "vcpkg_Files.h"
 #include "vcpkg_Graphs.h"
 #include "vcpkg_Strings.h"
+#include "vcpkg_Timings.h"
 #include "vcpkg_Util.h"
 #include "vcpkglib.h"
 
@@ -18,6 +19,7 @@ namespace vcpkg::Dependencies
         std::vector<FeatureSpec> remove_edges;
         std::vector<FeatureSpec> build_edges;
         bool plus = false;
+        bool changes_abi = false;
     };
 
     struct Cluster : Util::MoveOnlyBase
@@ -29,6 +31,12 @@ namespace vcpkg::Dependencies
         std::unordered_set<std::string> to_install_features;
         std::unordered_set<std::string> original_features;
         bool will_remove = false;
+
+        /// <summary>
+        /// Whether the installed packages which depend on this one are removed along with it, to be rebuilt against it
+        /// </summary>
+        bool will_remove_dependents = false;
+        Optional<PackageSpec> cascaded_from;
         bool transient_uninstalled = true;
         RequestType request_type = RequestType::AUTO_SELECTED;
     };
@@ -38,6 +46,8 @@ namespace vcpkg::Dependencies
         Cluster* ptr;
 
         Cluster* operator->() const { return ptr; }
+
+        std::string to_string() const { return ptr->spec.to_string(); }
     };
 
     bool operator==(const ClusterPtr& l, const ClusterPtr& r) { return l.ptr == r.ptr; }
@@ -62,26 +72,21 @@ namespace vcpkg::Dependencies
 
     struct ClusterGraph : Util::MoveOnlyBase
     {
-        explicit ClusterGraph(std::unordered_map<std::string, const SourceControlFile*>&& ports)
-            : m_ports(std::move(ports))
-        {
-        }
+        explicit ClusterGraph(const PortFileProvider& port_file_provider) : m_port_file_provider(port_file_provider) {}
 
         Cluster& get(const PackageSpec& spec)
         {
             auto it = m_graph.find(spec);
             if (it == m_graph.end())
             {
-                // Load on-demand from m_ports
-                auto it_ports = m_ports.find(spec.name());
-                if (it_ports != m_ports.end())
+                // Load on-demand from m_port_file_provider
+                auto& clust = m_graph[spec];
+                if (auto scf = m_port_file_provider.try_get_control_file(spec.name()).get())
                 {
-                    auto& clust = m_graph[spec];
                     clust.spec = spec;
-                    cluster_from_scf(*it_ports->second, clust);
-                    return clust;
+                    cluster_from_scf(**scf, clust);
                 }
-                return m_graph[spec];
+                return clust;
             }
             return it->second;
         }
@@ -89,28 +94,30 @@ namespace vcpkg::Dependencies
     private:
         void cluster_from_scf(const SourceControlFile& scf, Cluster& out_cluster) const
         {
+            const ResolvedDependencies& resolved = scf.resolve_dependencies(out_cluster.spec.triplet());
+
             FeatureNodeEdges core_dependencies;
-            core_dependencies.build_edges =
-                filter_dependencies_to_specs(scf.core_paragraph->depends, out_cluster.spec.triplet());
+            core_dependencies.build_edges = resolved.core;
             out_cluster.edges.emplace("core", std::move(core_dependencies));
 
             for (const auto& feature : scf.feature_paragraphs)
             {
                 FeatureNodeEdges added_edges;
-                added_edges.build_edges = filter_dependencies_to_specs(feature->depends, out_cluster.spec.triplet());
+                added_edges.build_edges = resolved.features.at(feature->name);
+                added_edges.changes_abi = feature->changes_abi;
                 out_cluster.edges.emplace(feature->name, std::move(added_edges));
             }
             out_cluster.source_control_file = &scf;
         }
 
         std::unordered_map<PackageSpec, Cluster> m_graph;
-        std::unordered_map<std::string, const SourceControlFile*> m_ports;
+        const PortFileProvider& m_port_file_provider;
     };
 
     std::vector<PackageSpec> AnyParagraph::dependencies(const Triplet& triplet) const
     {
         auto to_package_specs = [&](const std::vector<std::string>& dependencies_as_string) {
-            return Util::fmap(dependencies_as_string, [&](const std::string s) {
+            return Util::fmap(dependencies_as_string, [&](const std::string& s) {
                 return PackageSpec::from_name_and_triplet(s, triplet).value_or_exit(VCPKG_LINE_INFO);
             });
         };
@@ -129,7 +136,10 @@ namespace vcpkg::Dependencies
 
         if (auto p = this->source_paragraph.get())
         {
-            return to_package_specs(filter_dependencies(p->depends, triplet));
+            std::vector<PackageSpec> specs = to_package_specs(filter_dependencies((*p)->depends, triplet));
+            for (auto&& host_spec : filter_host_dependencies((*p)->depends))
+                specs.push_back(std::move(host_spec));
+            return specs;
         }
 
         Checks::exit_with_message(VCPKG_LINE_INFO,
@@ -270,31 +280,99 @@ namespace vcpkg::Dependencies
         return scf->second;
     }
 
+    Optional<const SourceControlFile*> MapPortFile::try_get_control_file(const std::string& spec) const
+    {
+        auto scf = ports.find(spec);
+        if (scf == ports.end())
+        {
+            return nullopt;
+        }
+        return &scf->second;
+    }
+
     PathsPortFile::PathsPortFile(const VcpkgPaths& paths) : ports(paths) {}
 
-    const SourceControlFile& PathsPortFile::get_control_file(const std::string& spec) const
+    /// <summary>
+    /// Loads the port, or returns nullptr after printing why its CONTROL file could not be parsed. The error of a port
+    /// is printed only the first time it is loaded.
+    /// </summary>
+    static const SourceControlFile* load_control_file(const PathsPortFile& provider, const std::string& spec)
     {
-        auto cache_it = cache.find(spec);
-        if (cache_it != cache.end())
         {
-            return cache_it->second;
+            std::lock_guard<std::mutex> lock(provider.cache_mutex);
+            auto cache_it = provider.cache.find(spec);
+            if (cache_it != provider.cache.end())
+            {
+                return &cache_it->second;
+            }
+            if (provider.unparsable.find(spec) != provider.unparsable.end())
+            {
+                return nullptr;
+            }
         }
+
+        // Loaded outside the lock, so threads loading different ports do not wait for each other. When two threads
+        // load the same port, the first one to finish wins.
+        const Timings::ScopedTimer timer("port loading", spec);
+        auto& fs = provider.ports.get_filesystem();
+        const fs::path port_dir = provider.ports.port_dir(spec);
+        const PortIndex::Table& table = provider.index.get_lazy(
+            [&]() { return PortIndex::Table::load(fs, PortIndex::get_index_path(provider.ports)); });
+        const Optional<PortIndex::Table::Entry> cached = table.find(spec);
+        const auto entry = cached.get();
         Parse::ParseExpected<SourceControlFile> source_control_file =
-            Paragraphs::try_load_port(ports.get_filesystem(), ports.port_dir(spec));
+            entry && entry->stamp == PortIndex::get_control_file_stamp(fs, port_dir / "CONTROL")
+                ? Paragraphs::parse_port(entry->paragraphs)
+                : Paragraphs::try_load_port(fs, port_dir);
 
+        std::lock_guard<std::mutex> lock(provider.cache_mutex);
         if (auto scf = source_control_file.get())
         {
-            auto it = cache.emplace(spec, std::move(*scf->get()));
-            return it.first->second;
+            auto it = provider.cache.emplace(spec, std::move(*scf->get()));
+            return &it.first->second;
+        }
+        if (provider.unparsable.insert(spec).second)
+        {
+            print_error_message(source_control_file.error());
+        }
+        return nullptr;
+    }
+
+    const SourceControlFile& PathsPortFile::get_control_file(const std::string& spec) const
+    {
+        const SourceControlFile* const scf = load_control_file(*this, spec);
+        if (scf == nullptr)
+        {
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+        return *scf;
+    }
+
+    Optional<const SourceControlFile*> PathsPortFile::try_get_control_file(const std::string& spec) const
+    {
+        bool is_cached;
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            is_cached = cache.find(spec) != cache.end();
+        }
+        if (!is_cached && !ports.get_filesystem().exists(ports.port_dir(spec)))
+        {
+            return nullopt;
         }
-        print_error_message(source_control_file.error());
-        Checks::exit_fail(VCPKG_LINE_INFO);
+
+        // A port which cannot be parsed is skipped like a missing one, so that it only fails the commands which need it
+        if (const SourceControlFile* scf = load_control_file(*this, spec))
+        {
+            return scf;
+        }
+        return nullopt;
     }
 
     std::vector<InstallPlanAction> create_install_plan(const PortFileProvider& port_file_provider,
                                                        const std::vector<PackageSpec>& specs,
                                                        const StatusParagraphs& status_db)
     {
+        const Timings::ScopedTimer timer("planning", "install");
         struct InstallAdjacencyProvider final : Graphs::AdjacencyProvider<PackageSpec, InstallPlanAction>
         {
             const PortFileProvider& port_file_provider;
@@ -320,10 +398,10 @@ namespace vcpkg::Dependencies
                                                      ? RequestType::USER_REQUESTED
                                                      : RequestType::AUTO_SELECTED;
                 auto it = status_db.find_installed(spec);
-                if (it != status_db.end()) return InstallPlanAction{spec, {*it->get(), nullopt, nullopt}, request_type};
+                if (it != status_db.end()) return InstallPlanAction{spec, {**it, nullopt, nullopt}, request_type};
                 return InstallPlanAction{
                     spec,
-                    {nullopt, nullopt, *port_file_provider.get_control_file(spec.name()).core_paragraph},
+                    {nullopt, nullopt, port_file_provider.get_control_file(spec.name()).core_paragraph.get()},
                     request_type};
             }
         };
@@ -342,16 +420,17 @@ namespace vcpkg::Dependencies
     std::vector<RemovePlanAction> create_remove_plan(const std::vector<PackageSpec>& specs,
                                                      const StatusParagraphs& status_db)
     {
+        const Timings::ScopedTimer timer("planning", "remove");
         struct RemoveAdjacencyProvider final : Graphs::AdjacencyProvider<PackageSpec, RemovePlanAction>
         {
             const StatusParagraphs& status_db;
-            const std::vector<StatusParagraph*>& installed_ports;
+            const std::unordered_map<PackageSpec, std::vector<PackageSpec>>& dependents;
             const std::unordered_set<PackageSpec>& specs_as_set;
 
             RemoveAdjacencyProvider(const StatusParagraphs& status_db,
-                                    const std::vector<StatusParagraph*>& installed_ports,
+                                    const std::unordered_map<PackageSpec, std::vector<PackageSpec>>& dependents,
                                     const std::unordered_set<PackageSpec>& specs_as_set)
-                : status_db(status_db), installed_ports(installed_ports), specs_as_set(specs_as_set)
+                : status_db(status_db), dependents(dependents), specs_as_set(specs_as_set)
             {
             }
 
@@ -362,19 +441,9 @@ namespace vcpkg::Dependencies
                     return {};
                 }
 
-                const PackageSpec& spec = plan.spec;
-                std::vector<PackageSpec> dependents;
-                for (const StatusParagraph* an_installed_package : installed_ports)
-                {
-                    if (an_installed_package->package.spec.triplet() != spec.triplet()) continue;
-
-                    const std::vector<std::string>& deps = an_installed_package->package.depends;
-                    if (std::find(deps.begin(), deps.end(), spec.name()) == deps.end()) continue;
-
-                    dependents.push_back(an_installed_package->package.spec);
-                }
-
-                return dependents;
+                const auto it = dependents.find(plan.spec);
+                if (it == dependents.cend()) return {};
+                return it->second;
             }
 
             RemovePlanAction load_vertex_data(const PackageSpec& spec) const override
@@ -391,25 +460,67 @@ namespace vcpkg::Dependencies
             }
         };
 
-        const std::vector<StatusParagraph*>& installed_ports = get_installed_ports(status_db);
+        // The installed packages which depend on each package of the same triplet. It is built once, so that finding
+        // the dependents of every package in the plan does not scan all installed packages.
+        std::unordered_map<PackageSpec, std::vector<PackageSpec>> dependents;
+        for (const StatusParagraph* an_installed_package : get_installed_ports(status_db))
+        {
+            const PackageSpec& dependent = an_installed_package->package.spec;
+            for (const std::string& dependency : an_installed_package->package.depends)
+            {
+                const auto maybe_spec = PackageSpec::from_name_and_triplet(dependency, dependent.triplet());
+                if (const auto spec = maybe_spec.get()) dependents[*spec].push_back(dependent);
+            }
+        }
+
         const std::unordered_set<PackageSpec> specs_as_set(specs.cbegin(), specs.cend());
-        return Graphs::topological_sort(specs, RemoveAdjacencyProvider{status_db, installed_ports, specs_as_set});
+        return Graphs::topological_sort(specs, RemoveAdjacencyProvider{status_db, dependents, specs_as_set});
+    }
+
+    Graphs::Graph<std::string> create_port_graph(const std::vector<std::unique_ptr<SourceControlFile>>& ports,
+                                                 const Optional<Triplet>& triplet)
+    {
+        Graphs::Graph<std::string> graph;
+        const auto add_edges = [&](const std::string& name, const std::vector<Dependency>& depends) {
+            for (auto&& dependency : depends)
+            {
+                const auto t = triplet.get();
+                if (t && !dependency.applies_to(*t)) continue;
+                graph.add_edge(name, dependency.depend.name);
+            }
+        };
+
+        for (auto&& port : ports)
+        {
+            const std::string& name = port->core_paragraph->name;
+            graph.add_vertex(name);
+            add_edges(name, port->core_paragraph->depends);
+            for (auto&& feature : port->feature_paragraphs)
+            {
+                add_edges(name, feature->depends);
+            }
+        }
+        return graph;
     }
 
     std::vector<ExportPlanAction> create_export_plan(const VcpkgPaths& paths,
+                                                     const PortFileProvider& port_file_provider,
                                                      const std::vector<PackageSpec>& specs,
                                                      const StatusParagraphs& status_db)
     {
+        const Timings::ScopedTimer timer("planning", "export");
         struct ExportAdjacencyProvider final : Graphs::AdjacencyProvider<PackageSpec, ExportPlanAction>
         {
             const VcpkgPaths& paths;
+            const PortFileProvider& port_file_provider;
             const StatusParagraphs& status_db;
             const std::unordered_set<PackageSpec>& specs_as_set;
 
             ExportAdjacencyProvider(const VcpkgPaths& p,
+                                    const PortFileProvider& port_file_provider,
                                     const StatusParagraphs& s,
                                     const std::unordered_set<PackageSpec>& specs_as_set)
-                : paths(p), status_db(s), specs_as_set(specs_as_set)
+                : paths(p), port_file_provider(port_file_provider), status_db(s), specs_as_set(specs_as_set)
             {
             }
 
@@ -428,19 +539,18 @@ namespace vcpkg::Dependencies
                 if (auto bcf = maybe_bpgh.get())
                     return ExportPlanAction{spec, AnyParagraph{nullopt, std::move(*bcf), nullopt}, request_type};
 
-                auto maybe_scf = Paragraphs::try_load_port(paths.get_filesystem(), paths.port_dir(spec));
+                const Optional<const SourceControlFile*> maybe_scf =
+                    port_file_provider.try_get_control_file(spec.name());
                 if (auto scf = maybe_scf.get())
-                    return ExportPlanAction{spec, {nullopt, nullopt, *scf->get()->core_paragraph}, request_type};
-                else
-                    print_error_message(maybe_scf.error());
+                    return ExportPlanAction{spec, {nullopt, nullopt, (*scf)->core_paragraph.get()}, request_type};
 
                 Checks::exit_with_message(VCPKG_LINE_INFO, "Could not find package %s", spec);
             }
         };
 
         const std::unordered_set<PackageSpec> specs_as_set(specs.cbegin(), specs.cend());
-        std::vector<ExportPlanAction> toposort =
-            Graphs::topological_sort(specs, ExportAdjacencyProvider{paths, status_db, specs_as_set});
+        std::vector<ExportPlanAction> toposort = Graphs::topological_sort(
+            specs, ExportAdjacencyProvider{paths, port_file_provider, status_db, specs_as_set});
         return toposort;
     }
 
@@ -454,7 +564,7 @@ namespace vcpkg::Dependencies
                              Cluster& cluster,
                              ClusterGraph& pkg_to_cluster,
                              GraphPlan& graph_plan);
-    void mark_minus(Cluster& cluster, ClusterGraph& pkg_to_cluster, GraphPlan& graph_plan);
+    void mark_minus(Cluster& cluster, ClusterGraph& pkg_to_cluster, GraphPlan& graph_plan, bool remove_dependents);
 
     MarkPlusResult mark_plus(const std::string& feature, Cluster& cluster, ClusterGraph& graph, GraphPlan& graph_plan)
     {
@@ -482,7 +592,9 @@ namespace vcpkg::Dependencies
 
         if (!cluster.original_features.empty())
         {
-            mark_minus(cluster, graph, graph_plan);
+            // A feature which only adds to the package leaves what its dependents were built against as it was
+            const bool is_added = cluster.original_features.find(feature) == cluster.original_features.end();
+            mark_minus(cluster, graph, graph_plan, is_added && cluster.edges[feature].changes_abi);
         }
 
         graph_plan.install_graph.add_vertex({&cluster});
@@ -516,23 +628,36 @@ namespace vcpkg::Dependencies
         return MarkPlusResult::SUCCESS;
     }
 
-    void mark_minus(Cluster& cluster, ClusterGraph& graph, GraphPlan& graph_plan)
+    void mark_minus(Cluster& cluster, ClusterGraph& graph, GraphPlan& graph_plan, const bool remove_dependents)
     {
-        if (cluster.will_remove) return;
+        const bool newly_removed = !cluster.will_remove;
         cluster.will_remove = true;
-
         graph_plan.remove_graph.add_vertex({&cluster});
+
+        const bool newly_removes_dependents = remove_dependents && !cluster.will_remove_dependents;
+        cluster.will_remove_dependents |= remove_dependents;
         for (auto&& pair : cluster.edges)
         {
             auto& remove_edges_edges = pair.second.remove_edges;
             for (auto&& depend : remove_edges_edges)
             {
                 auto& depend_cluster = graph.get(depend.spec());
-                graph_plan.remove_graph.add_edge({&cluster}, {&depend_cluster});
-                mark_minus(depend_cluster, graph, graph_plan);
+                if (newly_removes_dependents)
+                {
+                    if (!depend_cluster.will_remove) depend_cluster.cascaded_from = cluster.spec;
+                    graph_plan.remove_graph.add_edge({&cluster}, {&depend_cluster});
+                    mark_minus(depend_cluster, graph, graph_plan, true);
+                }
+                else if (depend_cluster.will_remove)
+                {
+                    // The dependent is removed for its own sake, and still goes before this package
+                    graph_plan.remove_graph.add_edge({&cluster}, {&depend_cluster});
+                }
             }
         }
 
+        if (!newly_removed) return;
+
         cluster.transient_uninstalled = true;
         for (auto&& original_feature : cluster.original_features)
         {
@@ -546,13 +671,10 @@ namespace vcpkg::Dependencies
         }
     }
 
-    static ClusterGraph create_feature_install_graph(const std::unordered_map<std::string, SourceControlFile>& map,
+    static ClusterGraph create_feature_install_graph(const PortFileProvider& port_file_provider,
                                                      const StatusParagraphs& status_db)
     {
-        std::unordered_map<std::string, const SourceControlFile*> ptr_map;
-        for (auto&& p : map)
-            ptr_map.emplace(p.first, &p.second);
-        ClusterGraph graph(std::move(ptr_map));
+        ClusterGraph graph(port_file_provider);
 
         auto installed_ports = get_installed_ports(status_db);
 
@@ -597,32 +719,90 @@ namespace vcpkg::Dependencies
         return graph;
     }
 
-    std::vector<AnyAction> create_feature_install_plan(const std::unordered_map<std::string, SourceControlFile>& map,
-                                                       const std::vector<FeatureSpec>& specs,
-                                                       const StatusParagraphs& status_db)
+    /// <summary>
+    /// Restores the state a cluster has before any request has been planned
+    /// </summary>
+    static void reset_marks(Cluster& cluster)
+    {
+        for (auto&& pair : cluster.edges)
+        {
+            pair.second.plus = false;
+        }
+        cluster.to_install_features.clear();
+        cluster.will_remove = false;
+        cluster.will_remove_dependents = false;
+        cluster.cascaded_from = nullopt;
+        cluster.transient_uninstalled = cluster.status_paragraphs.empty();
+        cluster.request_type = RequestType::AUTO_SELECTED;
+    }
+
+    struct FeatureInstallPlannerState
     {
-        ClusterGraph graph = create_feature_install_graph(map, status_db);
+        explicit FeatureInstallPlannerState(ClusterGraph&& graph) : graph(std::move(graph)) {}
 
+        ClusterGraph graph;
         GraphPlan graph_plan;
-        for (auto&& spec : specs)
-        {
-            Cluster& spec_cluster = graph.get(spec.spec());
-            spec_cluster.request_type = RequestType::USER_REQUESTED;
-            auto res = mark_plus(spec.feature(), spec_cluster, graph, graph_plan);
+        std::vector<FeatureSpec> requests;
+    };
+
+    FeatureInstallPlanner::FeatureInstallPlanner(const PortFileProvider& port_file_provider,
+                                                 const StatusParagraphs& status_db)
+        : m_state(std::make_unique<FeatureInstallPlannerState>(
+              create_feature_install_graph(port_file_provider, status_db)))
+    {
+    }
+
+    FeatureInstallPlanner::~FeatureInstallPlanner() = default;
+
+    void FeatureInstallPlanner::add(const FeatureSpec& spec)
+    {
+        FeatureInstallPlannerState& state = *m_state;
+
+        Cluster& spec_cluster = state.graph.get(spec.spec());
+        spec_cluster.request_type = RequestType::USER_REQUESTED;
+        auto res = mark_plus(spec.feature(), spec_cluster, state.graph, state.graph_plan);
+
+        Checks::check_exit(VCPKG_LINE_INFO, res == MarkPlusResult::SUCCESS, "Error: Unable to locate feature %s", spec);
+
+        state.graph_plan.install_graph.add_vertex(ClusterPtr{&spec_cluster});
+        state.requests.push_back(spec);
+    }
+
+    void FeatureInstallPlanner::remove(const FeatureSpec& spec)
+    {
+        FeatureInstallPlannerState& state = *m_state;
 
-            Checks::check_exit(
-                VCPKG_LINE_INFO, res == MarkPlusResult::SUCCESS, "Error: Unable to locate feature %s", spec);
+        const auto is_removed = [&](const FeatureSpec& request) {
+            return request.spec() == spec.spec() && request.feature() == spec.feature();
+        };
+        if (Util::find_if(state.requests, is_removed) == state.requests.cend()) return;
 
-            graph_plan.install_graph.add_vertex(ClusterPtr{&spec_cluster});
+        // Marking only changes the clusters it adds to the plan graphs
+        for (auto&& p_cluster : state.graph_plan.install_graph.vertex_list())
+        {
+            reset_marks(*p_cluster.ptr);
+        }
+        for (auto&& p_cluster : state.graph_plan.remove_graph.vertex_list())
+        {
+            reset_marks(*p_cluster.ptr);
         }
+        state.graph_plan = GraphPlan();
 
-        Graphs::GraphAdjacencyProvider<ClusterPtr> adjacency_remove_graph(graph_plan.remove_graph.adjacency_list());
-        auto remove_vertex_list = graph_plan.remove_graph.vertex_list();
-        auto remove_toposort = Graphs::topological_sort(remove_vertex_list, adjacency_remove_graph);
+        std::vector<FeatureSpec> remaining_requests = std::move(state.requests);
+        state.requests.clear();
+        Util::erase_remove_if(remaining_requests, is_removed);
+        for (auto&& request : remaining_requests)
+        {
+            this->add(request);
+        }
+    }
 
-        Graphs::GraphAdjacencyProvider<ClusterPtr> adjacency_install_graph(graph_plan.install_graph.adjacency_list());
-        auto insert_vertex_list = graph_plan.install_graph.vertex_list();
-        auto insert_toposort = Graphs::topological_sort(insert_vertex_list, adjacency_install_graph);
+    std::vector<AnyAction> FeatureInstallPlanner::plan() const
+    {
+        const GraphPlan& graph_plan = m_state->graph_plan;
+
+        auto remove_toposort = graph_plan.remove_graph.topological_sort();
+        auto insert_toposort = graph_plan.install_graph.topological_sort();
 
         std::vector<AnyAction> plan;
 
@@ -631,11 +811,26 @@ namespace vcpkg::Dependencies
             auto scf = *p_cluster->source_control_file.get();
             auto spec = PackageSpec::from_name_and_triplet(scf->core_paragraph->name, p_cluster->spec.triplet())
                             .value_or_exit(VCPKG_LINE_INFO);
-            plan.emplace_back(RemovePlanAction{
+            RemovePlanAction remove_action{
                 std::move(spec),
                 RemovePlanType::REMOVE,
                 p_cluster->request_type,
-            });
+            };
+            remove_action.cascaded_from = p_cluster->cascaded_from;
+
+            if (!p_cluster->will_remove_dependents)
+            {
+                for (auto&& pair : p_cluster->edges)
+                {
+                    for (auto&& depend : pair.second.remove_edges)
+                    {
+                        auto& kept = remove_action.kept_dependents;
+                        if (m_state->graph.get(depend.spec()).will_remove) continue;
+                        if (Util::find(kept, depend.spec()) == kept.cend()) kept.push_back(depend.spec());
+                    }
+                }
+            }
+            plan.emplace_back(std::move(remove_action));
         }
 
         for (auto&& p_cluster : insert_toposort)
@@ -666,4 +861,25 @@ namespace vcpkg::Dependencies
 
         return plan;
     }
+
+    std::vector<AnyAction> create_feature_install_plan(const PortFileProvider& port_file_provider,
+                                                       const std::vector<FeatureSpec>& specs,
+                                                       const StatusParagraphs& status_db)
+    {
+        const Timings::ScopedTimer timer("planning", "install");
+        FeatureInstallPlanner planner(port_file_provider, status_db);
+        for (auto&& spec : specs)
+        {
+            planner.add(spec);
+        }
+        return planner.plan();
+    }
+
+    std::vector<AnyAction> create_feature_install_plan(const std::unordered_map<std::string, SourceControlFile>& map,
+                                                       const std::vector<FeatureSpec>& specs,
+                                                       const StatusParagraphs& status_db)
+    {
+        MapPortFile map_port(map);
+        return create_feature_install_plan(map_port, specs, status_db);
+    }
 }
@@ -7,7 +7,7 @@
 
 namespace vcpkg::Files
 {
-    static const std::regex FILESYSTEM_INVALID_CHARACTERS_REGEX = std::regex(R"([\/:*?"<>|])");
+    static const char* FILESYSTEM_INVALID_CHARACTERS = R"(/:*?"<>|)";
 
     struct RealFilesystem final : Filesystem
     {
@@ -35,21 +35,84 @@ namespace vcpkg::Files
 
             return std::move(output);
         }
-        virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
+        virtual Expected<MappedFile> map_contents(const fs::path& file_path) const override
         {
-            std::fstream file_stream(file_path, std::ios_base::in | std::ios_base::binary);
-            if (file_stream.fail())
+            const HANDLE file = CreateFileW(file_path.native().c_str(),
+                                            GENERIC_READ,
+                                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                            nullptr,
+                                            OPEN_EXISTING,
+                                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                            nullptr);
+            if (file == INVALID_HANDLE_VALUE)
             {
                 return std::make_error_code(std::errc::no_such_file_or_directory);
             }
 
+            LARGE_INTEGER length;
+            if (!GetFileSizeEx(file, &length))
+            {
+                const std::error_code ec(GetLastError(), std::system_category());
+                CloseHandle(file);
+                return ec;
+            }
+
+            if (static_cast<unsigned long long>(length.QuadPart) > SIZE_MAX)
+            {
+                CloseHandle(file);
+                return std::make_error_code(std::errc::file_too_large);
+            }
+
+            MappedFile mapped;
+            if (length.QuadPart == 0)
+            {
+                // Empty files cannot be mapped
+                CloseHandle(file);
+                return std::move(mapped);
+            }
+
+            // The view keeps the mapping and the file open, so both handles can be closed right away
+            const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            const std::error_code mapping_ec(GetLastError(), std::system_category());
+            CloseHandle(file);
+            if (mapping == nullptr)
+            {
+                return mapping_ec;
+            }
+
+            const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            const std::error_code view_ec(GetLastError(), std::system_category());
+            CloseHandle(mapping);
+            if (view == nullptr)
+            {
+                return view_ec;
+            }
+
+            mapped.data = std::shared_ptr<const char>(static_cast<const char*>(view),
+                                                      [](const char* p) { UnmapViewOfFile(p); });
+            mapped.size = static_cast<size_t>(length.QuadPart);
+            return std::move(mapped);
+        }
+        virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
+        {
+            const Expected<MappedFile> maybe_mapped = map_contents(file_path);
+            const auto mapped = maybe_mapped.get();
+            if (!mapped)
+            {
+                return maybe_mapped.error();
+            }
+
+            // Split on '\n' like std::getline: a trailing newline does not produce an empty last line
             std::vector<std::string> output;
-            std::string line;
-            while (std::getline(file_stream, line))
+            const char* line_begin = mapped->contents().begin();
+            const char* const end = mapped->contents().end();
+            while (line_begin != end)
             {
-                output.push_back(line);
+                const char* const line_end = std::find(line_begin, end, '\n');
+                output.emplace_back(line_begin, line_end);
+                if (line_end == end) break;
+                line_begin = line_end + 1;
             }
-            file_stream.close();
 
             return std::move(output);
         }
@@ -95,6 +158,20 @@ namespace vcpkg::Files
             return ret;
         }
 
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const override
+        {
+            std::vector<DirectoryEntry> entries;
+            find_entries(dir, true, entries);
+            return entries;
+        }
+
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const override
+        {
+            std::vector<DirectoryEntry> entries;
+            find_entries(dir, false, entries);
+            return entries;
+        }
+
         virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) override
         {
             std::fstream output(file_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
@@ -109,6 +186,10 @@ namespace vcpkg::Files
         {
             fs::stdfs::rename(oldpath, newpath);
         }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            fs::stdfs::rename(oldpath, newpath, ec);
+        }
         virtual bool remove(const fs::path& path) override { return fs::stdfs::remove(path); }
         virtual bool remove(const fs::path& path, std::error_code& ec) override { return fs::stdfs::remove(path, ec); }
         virtual std::uintmax_t remove_all(const fs::path& path, std::error_code& ec) override
@@ -137,6 +218,18 @@ namespace vcpkg::Files
         virtual bool is_directory(const fs::path& path) const override { return fs::stdfs::is_directory(path); }
         virtual bool is_regular_file(const fs::path& path) const override { return fs::stdfs::is_regular_file(path); }
         virtual bool is_empty(const fs::path& path) const override { return fs::stdfs::is_empty(path); }
+        virtual std::uintmax_t file_size(const fs::path& path, std::error_code& ec) const override
+        {
+            return fs::stdfs::file_size(path, ec);
+        }
+        virtual fs::file_time_type last_write_time(const fs::path& path, std::error_code& ec) const override
+        {
+            return fs::stdfs::last_write_time(path, ec);
+        }
+        virtual std::uintmax_t hard_link_count(const fs::path& path, std::error_code& ec) const override
+        {
+            return fs::stdfs::hard_link_count(path, ec);
+        }
         virtual bool create_directory(const fs::path& path, std::error_code& ec) override
         {
             return fs::stdfs::create_directory(path, ec);
@@ -157,6 +250,11 @@ namespace vcpkg::Files
             return fs::stdfs::copy_file(oldpath, newpath, opts, ec);
         }
 
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) override
+        {
+            fs::stdfs::create_hard_link(target, link, ec);
+        }
+
         virtual fs::file_status status(const fs::path& path, std::error_code& ec) const override
         {
             return fs::stdfs::status(path, ec);
@@ -172,6 +270,685 @@ namespace vcpkg::Files
 
             Checks::check_exit(VCPKG_LINE_INFO, count == data.size());
         }
+        virtual void append_contents(const fs::path& file_path, const std::string& data) override
+        {
+            FILE* f = nullptr;
+            auto ec = _wfopen_s(&f, file_path.native().c_str(), L"ab");
+            Checks::check_exit(
+                VCPKG_LINE_INFO, ec == 0, "Error: Could not open file for appending: %s", file_path.u8string().c_str());
+            auto count = fwrite(data.data(), sizeof(data[0]), data.size(), f);
+            fclose(f);
+
+            Checks::check_exit(VCPKG_LINE_INFO, count == data.size());
+        }
+        virtual FileLock try_lock_file(const fs::path& path, LockMode mode) override
+        {
+            const HANDLE file = CreateFileW(path.native().c_str(),
+                                            GENERIC_READ | GENERIC_WRITE,
+                                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                            nullptr,
+                                            OPEN_ALWAYS,
+                                            FILE_ATTRIBUTE_NORMAL,
+                                            nullptr);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               file != INVALID_HANDLE_VALUE,
+                               "Error: Could not open lock file %s: %d",
+                               path.u8string(),
+                               static_cast<int>(GetLastError()));
+
+            // Windows releases the lock when the handle is closed, including when the process dies
+            DWORD flags = LOCKFILE_FAIL_IMMEDIATELY;
+            if (mode == LockMode::EXCLUSIVE) flags |= LOCKFILE_EXCLUSIVE_LOCK;
+            OVERLAPPED overlapped{};
+            if (!LockFileEx(file, flags, 0, MAXDWORD, MAXDWORD, &overlapped))
+            {
+                const DWORD error = GetLastError();
+                CloseHandle(file);
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   error == ERROR_LOCK_VIOLATION,
+                                   "Error: Could not lock %s: %d",
+                                   path.u8string(),
+                                   static_cast<int>(error));
+                return FileLock();
+            }
+
+            return FileLock(std::shared_ptr<void>(file, CloseHandle));
+        }
+
+    private:
+        static fs::file_time_type to_file_time(const FILETIME& time)
+        {
+            // FILETIME counts 100ns intervals since 1601 and the clock of file_time_type counts them since 1970
+            static constexpr long long EPOCH_DIFFERENCE = 116444736000000000LL;
+            const long long ticks =
+                (static_cast<long long>(time.dwHighDateTime) << 32 | time.dwLowDateTime) - EPOCH_DIFFERENCE;
+            return fs::file_time_type(std::chrono::duration_cast<fs::file_time_type::duration>(
+                std::chrono::duration<long long, std::ratio<1, 10000000>>(ticks)));
+        }
+
+        /// <summary>
+        /// Lists dir with FindFirstFileExW, which returns the attributes along with the names and fetches them in
+        /// large batches. Like recursive_directory_iterator, directories come before their contents and links to
+        /// directories are not followed.
+        /// </summary>
+        static void find_entries(const fs::path& dir, const bool recursive, std::vector<DirectoryEntry>& entries)
+        {
+            WIN32_FIND_DATAW data;
+            const HANDLE find = FindFirstFileExW((dir / L"*").native().c_str(),
+                                                 FindExInfoBasic,
+                                                 &data,
+                                                 FindExSearchNameMatch,
+                                                 nullptr,
+                                                 FIND_FIRST_EX_LARGE_FETCH);
+            if (find == INVALID_HANDLE_VALUE) return;
+
+            do
+            {
+                if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0) continue;
+
+                const bool is_link = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+                const bool is_directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+                DirectoryEntry entry;
+                entry.path = dir / data.cFileName;
+                if (is_link)
+                {
+                    // Only status() can tell what a link points to
+                    std::error_code ec;
+                    entry.status = fs::stdfs::status(entry.path, ec);
+                }
+                else
+                {
+                    entry.status = fs::file_status(is_directory ? fs::stdfs::file_type::directory
+                                                                : fs::stdfs::file_type::regular);
+                }
+                entry.size =
+                    is_directory ? 0 : static_cast<std::uintmax_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+                entry.last_write_time = to_file_time(data.ftLastWriteTime);
+
+                const fs::path subdirectory = entry.path;
+                entries.push_back(std::move(entry));
+                if (recursive && is_directory && !is_link) find_entries(subdirectory, true, entries);
+            } while (FindNextFileW(find, &data));
+
+            FindClose(find);
+        }
+    };
+
+    /// <summary>
+    /// Keeps every change in memory. Paths which were never written are read from the lower filesystem, if there is
+    /// one, until they are removed; a removed path hides everything below it in the lower filesystem.
+    /// </summary>
+    struct MemoryFilesystem final : Filesystem
+    {
+        explicit MemoryFilesystem(const Filesystem* lower) : m_lower(lower) {}
+
+        struct Entry
+        {
+            fs::path path;
+            bool is_directory;
+            /// Null for directories and for files copied from the lower filesystem
+            std::shared_ptr<const std::string> contents;
+            fs::path lower_file;
+            fs::file_time_type last_write_time;
+            /// Shared by the names of a file which were hard linked to each other; null for a file with one name
+            std::shared_ptr<const int> inode;
+        };
+
+        /// <summary>
+        /// Lowercase, with forward slashes and without a trailing slash; a drive like "c:" is a root
+        /// </summary>
+        static std::string to_key(const fs::path& path)
+        {
+            std::string key = Strings::ascii_to_lowercase(path.generic_u8string());
+            while (!key.empty() && key.back() == '/')
+                key.pop_back();
+            return key;
+        }
+
+        static bool is_root(const std::string& key) { return key.find('/') == std::string::npos; }
+
+        static std::string parent_key(const std::string& key)
+        {
+            const size_t slash = key.rfind('/');
+            return slash == std::string::npos ? std::string() : key.substr(0, slash);
+        }
+
+        virtual Expected<std::string> read_contents(const fs::path& file_path) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            const std::string key = to_key(file_path);
+            const Entry* entry = find_entry(key);
+            if (entry == nullptr)
+            {
+                if (lower_visible(key)) return m_lower->read_contents(file_path);
+                return std::make_error_code(std::errc::no_such_file_or_directory);
+            }
+            if (entry->is_directory) return std::make_error_code(std::errc::is_a_directory);
+            if (!entry->contents) return m_lower->read_contents(entry->lower_file);
+            return *entry->contents;
+        }
+        virtual Expected<MappedFile> map_contents(const fs::path& file_path) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            const std::string key = to_key(file_path);
+            const Entry* entry = find_entry(key);
+            if (entry == nullptr)
+            {
+                if (lower_visible(key)) return m_lower->map_contents(file_path);
+                return std::make_error_code(std::errc::no_such_file_or_directory);
+            }
+            if (entry->is_directory) return std::make_error_code(std::errc::is_a_directory);
+            if (!entry->contents) return m_lower->map_contents(entry->lower_file);
+
+            // The view shares ownership of the contents, which writes replace rather than modify
+            MappedFile mapped;
+            mapped.data = std::shared_ptr<const char>(entry->contents, entry->contents->data());
+            mapped.size = entry->contents->size();
+            return std::move(mapped);
+        }
+        virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
+        {
+            const Expected<std::string> maybe_contents = read_contents(file_path);
+            const auto contents = maybe_contents.get();
+            if (!contents) return maybe_contents.error();
+
+            // Splits like std::getline does, so a trailing newline does not add an empty line
+            std::vector<std::string> output;
+            size_t begin = 0;
+            while (begin < contents->size())
+            {
+                size_t end = contents->find('\n', begin);
+                if (end == std::string::npos) end = contents->size();
+                output.emplace_back(*contents, begin, end - begin);
+                begin = end + 1;
+            }
+            return std::move(output);
+        }
+        virtual fs::path find_file_recursively_up(const fs::path& starting_dir,
+                                                  const std::string& filename) const override
+        {
+            fs::path current_dir = starting_dir;
+            for (; !current_dir.empty(); current_dir = current_dir.parent_path())
+            {
+                if (exists(current_dir / filename)) break;
+                if (current_dir == current_dir.root_path()) return fs::path();
+            }
+
+            return current_dir;
+        }
+
+        virtual std::vector<fs::path> get_files_recursive(const fs::path& dir) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            return Util::fmap(get_descendants(dir, true), [](auto&& descendant) { return descendant.second; });
+        }
+
+        virtual std::vector<fs::path> get_files_non_recursive(const fs::path& dir) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            return Util::fmap(get_descendants(dir, false), [](auto&& descendant) { return descendant.second; });
+        }
+
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            return get_directory_entries(dir, true);
+        }
+
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            return get_directory_entries(dir, false);
+        }
+
+        virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) override
+        {
+            std::string contents;
+            for (const std::string& line : lines)
+            {
+                contents.append(line).push_back('\n');
+            }
+            write_contents(file_path, contents);
+        }
+
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath) override
+        {
+            std::error_code ec;
+            rename(oldpath, newpath, ec);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               !ec,
+                               "Could not rename %s to %s: %s",
+                               oldpath.u8string(),
+                               newpath.u8string(),
+                               ec.message());
+        }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string old_key = to_key(oldpath);
+            const std::string new_key = to_key(newpath);
+            const Optional<Entry> source = get_entry(oldpath, old_key);
+            if (!source.has_value() || !directory_exists(newpath.parent_path(), parent_key(new_key)))
+            {
+                return ec.assign(ENOENT, std::generic_category());
+            }
+            if (old_key == new_key) return;
+
+            const Optional<Entry> target = get_entry(newpath, new_key);
+            if (target.has_value())
+            {
+                if (target.value_or_exit(VCPKG_LINE_INFO).is_directory !=
+                        source.value_or_exit(VCPKG_LINE_INFO).is_directory ||
+                    !get_descendants(newpath, false).empty())
+                {
+                    return ec.assign(EEXIST, std::generic_category());
+                }
+            }
+
+            // A directory moves with everything below it; files of the lower filesystem are moved by reference
+            std::vector<std::pair<std::string, Entry>> moved;
+            moved.emplace_back(new_key, source.value_or_exit(VCPKG_LINE_INFO));
+            moved.back().second.path = newpath;
+            const size_t old_prefix_length = oldpath.generic_u8string().size() + 1;
+            for (auto&& descendant : get_descendants(oldpath, true))
+            {
+                Entry entry = get_entry(descendant.second, descendant.first).value_or_exit(VCPKG_LINE_INFO);
+                const std::string relative = entry.path.generic_u8string().substr(old_prefix_length);
+                entry.path = newpath / Strings::to_utf16(relative);
+                moved.emplace_back(new_key + descendant.first.substr(old_key.size()), std::move(entry));
+            }
+            erase_with_descendants(oldpath, old_key);
+            for (auto&& entry : moved)
+            {
+                m_entries[entry.first] = std::move(entry.second);
+            }
+        }
+        virtual bool remove(const fs::path& path) override
+        {
+            std::error_code ec;
+            const bool removed = remove(path, ec);
+            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not remove %s: %s", path.u8string(), ec.message());
+            return removed;
+        }
+        virtual bool remove(const fs::path& path, std::error_code& ec) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = to_key(path);
+            if (!get_entry(path, key).has_value()) return false;
+            if (!get_descendants(path, false).empty())
+            {
+                ec.assign(ENOTEMPTY, std::generic_category());
+                return false;
+            }
+
+            erase_with_descendants(path, key);
+            return true;
+        }
+        virtual std::uintmax_t remove_all(const fs::path& path, std::error_code& ec) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            return erase_with_descendants(path, to_key(path));
+        }
+        virtual bool exists(const fs::path& path) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            const std::string key = to_key(path);
+            return is_root(key) || get_entry(path, key).has_value();
+        }
+        virtual bool is_directory(const fs::path& path) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            return directory_exists(path, to_key(path));
+        }
+        virtual bool is_regular_file(const fs::path& path) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            const Optional<Entry> entry = get_entry(path, to_key(path));
+            return entry.has_value() && !entry.value_or_exit(VCPKG_LINE_INFO).is_directory;
+        }
+        virtual bool is_empty(const fs::path& path) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            if (directory_exists(path, to_key(path))) return get_descendants(path, false).empty();
+
+            std::error_code ec;
+            return file_size(path, ec) == 0;
+        }
+        virtual std::uintmax_t file_size(const fs::path& path, std::error_code& ec) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = to_key(path);
+            const Entry* entry = find_entry(key);
+            if (entry == nullptr)
+            {
+                if (lower_visible(key)) return m_lower->file_size(path, ec);
+                ec.assign(ENOENT, std::generic_category());
+                return static_cast<std::uintmax_t>(-1);
+            }
+            if (entry->is_directory)
+            {
+                ec.assign(EISDIR, std::generic_category());
+                return static_cast<std::uintmax_t>(-1);
+            }
+            if (!entry->contents) return m_lower->file_size(entry->lower_file, ec);
+            return entry->contents->size();
+        }
+        virtual fs::file_time_type last_write_time(const fs::path& path, std::error_code& ec) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = to_key(path);
+            const Entry* entry = find_entry(key);
+            if (entry != nullptr) return entry->last_write_time;
+            if (lower_visible(key)) return m_lower->last_write_time(path, ec);
+
+            ec.assign(ENOENT, std::generic_category());
+            return fs::file_time_type::min();
+        }
+        virtual std::uintmax_t hard_link_count(const fs::path& path, std::error_code& ec) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = to_key(path);
+            const Entry* entry = find_entry(key);
+            if (entry == nullptr)
+            {
+                if (lower_visible(key)) return m_lower->hard_link_count(path, ec);
+                ec.assign(ENOENT, std::generic_category());
+                return static_cast<std::uintmax_t>(-1);
+            }
+            if (!entry->inode) return 1;
+
+            const auto links = std::count_if(m_entries.cbegin(), m_entries.cend(), [&](const auto& other) {
+                return other.second.inode == entry->inode;
+            });
+            return static_cast<std::uintmax_t>(links);
+        }
+        virtual bool create_directory(const fs::path& path, std::error_code& ec) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = to_key(path);
+            if (directory_exists(path, key)) return false;
+            if (get_entry(path, key).has_value())
+            {
+                ec.assign(EEXIST, std::generic_category());
+                return false;
+            }
+            if (!directory_exists(path.parent_path(), parent_key(key)))
+            {
+                ec.assign(ENOENT, std::generic_category());
+                return false;
+            }
+
+            m_entries[key] = Entry{path, true, nullptr, fs::path(), fs::file_time_type::clock::now()};
+            return true;
+        }
+        virtual bool create_directories(const fs::path& path, std::error_code& ec) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            std::vector<fs::path> missing;
+            for (fs::path current = path; !directory_exists(current, to_key(current)); current = current.parent_path())
+            {
+                missing.push_back(current);
+            }
+
+            for (auto it = missing.crbegin(); it != missing.crend(); ++it)
+            {
+                if (!create_directory(*it, ec)) return false;
+            }
+            return !missing.empty();
+        }
+        virtual void copy(const fs::path& oldpath, const fs::path& newpath, fs::copy_options opts) override
+        {
+            std::error_code ec;
+            if (is_regular_file(oldpath))
+            {
+                copy_file(oldpath, newpath, opts, ec);
+            }
+            else
+            {
+                create_directory(newpath, ec);
+                if (!ec && (opts & fs::copy_options::recursive) != fs::copy_options::none)
+                {
+                    for (auto&& child : get_files_non_recursive(oldpath))
+                    {
+                        copy(child, newpath / child.filename(), opts);
+                    }
+                }
+            }
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               !ec,
+                               "Could not copy %s to %s: %s",
+                               oldpath.u8string(),
+                               newpath.u8string(),
+                               ec.message());
+        }
+        virtual bool copy_file(const fs::path& oldpath,
+                               const fs::path& newpath,
+                               fs::copy_options opts,
+                               std::error_code& ec) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string new_key = to_key(newpath);
+            const Optional<Entry> maybe_source = get_entry(oldpath, to_key(oldpath));
+            const Entry* source = maybe_source.get();
+            if (source == nullptr || source->is_directory ||
+                !directory_exists(newpath.parent_path(), parent_key(new_key)))
+            {
+                ec.assign(ENOENT, std::generic_category());
+                return false;
+            }
+
+            const Optional<Entry> maybe_target = get_entry(newpath, new_key);
+            if (const auto target = maybe_target.get())
+            {
+                const bool overwrite =
+                    (opts & fs::copy_options::overwrite_existing) != fs::copy_options::none ||
+                    ((opts & fs::copy_options::update_existing) != fs::copy_options::none &&
+                     source->last_write_time > target->last_write_time);
+                if (target->is_directory ||
+                    (!overwrite && (opts & fs::copy_options::skip_existing) == fs::copy_options::none &&
+                     (opts & fs::copy_options::update_existing) == fs::copy_options::none))
+                {
+                    ec.assign(EEXIST, std::generic_category());
+                    return false;
+                }
+                if (!overwrite) return false;
+            }
+
+            // Copying keeps the modification time, like CopyFile does
+            Entry copied = *source;
+            copied.path = newpath;
+            copied.inode = nullptr;
+            m_entries[new_key] = std::move(copied);
+            return true;
+        }
+
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string target_key = to_key(target);
+            const std::string link_key = to_key(link);
+            const Optional<Entry> maybe_source = get_entry(target, target_key);
+            const Entry* source = maybe_source.get();
+            if (source == nullptr || source->is_directory ||
+                !directory_exists(link.parent_path(), parent_key(link_key)))
+            {
+                return ec.assign(ENOENT, std::generic_category());
+            }
+            if (get_entry(link, link_key).has_value()) return ec.assign(EEXIST, std::generic_category());
+
+            // Files of the lower filesystem get an entry here, which the link shares
+            if (find_entry(target_key) == nullptr) m_entries[target_key] = *source;
+            Entry& linked = m_entries[target_key];
+            if (!linked.inode) linked.inode = std::make_shared<const int>(0);
+
+            Entry link_entry = linked;
+            link_entry.path = link;
+            m_entries[link_key] = std::move(link_entry);
+        }
+
+        virtual fs::file_status status(const fs::path& path, std::error_code& ec) const override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = to_key(path);
+            if (directory_exists(path, key)) return fs::file_status(fs::stdfs::file_type::directory);
+            if (get_entry(path, key).has_value()) return fs::file_status(fs::stdfs::file_type::regular);
+
+            ec.assign(ENOENT, std::generic_category());
+            return fs::file_status(fs::stdfs::file_type::not_found);
+        }
+        virtual FileLock try_lock_file(const fs::path& path, LockMode mode) override
+        {
+            // No other process can see this filesystem, so every lock is granted
+            if (!is_regular_file(path)) write_contents(path, Strings::EMPTY);
+            return FileLock(std::make_shared<LockMode>(mode));
+        }
+        virtual void write_contents(const fs::path& file_path, const std::string& data) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            write_contents_locked(file_path, std::make_shared<const std::string>(data));
+        }
+        virtual void append_contents(const fs::path& file_path, const std::string& data) override
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_mutex);
+            const Expected<std::string> existing = read_contents(file_path);
+            std::string contents = existing.has_value() ? existing.value_or_exit(VCPKG_LINE_INFO) : std::string();
+            contents.append(data);
+            write_contents_locked(file_path, std::make_shared<const std::string>(std::move(contents)));
+        }
+
+    private:
+        const Entry* find_entry(const std::string& key) const
+        {
+            const auto it = m_entries.find(key);
+            return it == m_entries.end() ? nullptr : &it->second;
+        }
+
+        /// <summary>
+        /// Whether a path which was never written here can still be read from the lower filesystem
+        /// </summary>
+        bool lower_visible(const std::string& key) const
+        {
+            if (m_lower == nullptr) return false;
+            for (std::string current = key; !current.empty(); current = parent_key(current))
+            {
+                if (m_hidden.find(current) != m_hidden.end()) return false;
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// The entry for a path, describing files of the lower filesystem by reference
+        /// </summary>
+        Optional<Entry> get_entry(const fs::path& path, const std::string& key) const
+        {
+            const Entry* entry = find_entry(key);
+            if (entry != nullptr) return *entry;
+            if (is_root(key) || !lower_visible(key)) return nullopt;
+
+            std::error_code ec;
+            const fs::file_status status = m_lower->status(path, ec);
+            if (ec || !fs::status_known(status) || status.type() == fs::stdfs::file_type::not_found) return nullopt;
+
+            const bool is_directory = fs::is_directory(status);
+            const fs::file_time_type time = m_lower->last_write_time(path, ec);
+            return Entry{path, is_directory, nullptr, is_directory ? fs::path() : path, time};
+        }
+
+        bool directory_exists(const fs::path& path, const std::string& key) const
+        {
+            if (is_root(key)) return true;
+            const Optional<Entry> entry = get_entry(path, key);
+            return entry.has_value() && entry.value_or_exit(VCPKG_LINE_INFO).is_directory;
+        }
+
+        /// <summary>
+        /// The keys and paths below dir, sorted by key so that directories come before their contents
+        /// </summary>
+        std::vector<std::pair<std::string, fs::path>> get_descendants(const fs::path& dir, const bool recursive) const
+        {
+            const std::string dir_key = to_key(dir);
+            const std::string prefix = dir_key + '/';
+            std::map<std::string, fs::path> descendants;
+            for (auto it = m_entries.lower_bound(prefix);
+                 it != m_entries.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+                 ++it)
+            {
+                if (recursive || parent_key(it->first) == dir_key) descendants.emplace(it->first, it->second.path);
+            }
+
+            if (lower_visible(dir_key) && m_lower->is_directory(dir))
+            {
+                const std::vector<fs::path> lower_files =
+                    recursive ? m_lower->get_files_recursive(dir) : m_lower->get_files_non_recursive(dir);
+                for (auto&& file : lower_files)
+                {
+                    std::string key = to_key(file);
+                    if (lower_visible(key)) descendants.emplace(std::move(key), file);
+                }
+            }
+
+            return std::vector<std::pair<std::string, fs::path>>(descendants.begin(), descendants.end());
+        }
+
+        /// <summary>
+        /// Looks up the attributes one path at a time, which costs no system calls here
+        /// </summary>
+        std::vector<DirectoryEntry> get_directory_entries(const fs::path& dir, const bool recursive) const
+        {
+            return Util::fmap(get_descendants(dir, recursive), [&](auto&& descendant) {
+                std::error_code ec;
+                DirectoryEntry entry;
+                entry.path = descendant.second;
+                entry.status = status(entry.path, ec);
+                entry.size = fs::is_directory(entry.status) ? 0 : file_size(entry.path, ec);
+                entry.last_write_time = last_write_time(entry.path, ec);
+                return entry;
+            });
+        }
+
+        std::uintmax_t erase_with_descendants(const fs::path& path, const std::string& key)
+        {
+            std::uintmax_t count = get_entry(path, key).has_value() ? 1 : 0;
+            count += get_descendants(path, true).size();
+
+            m_entries.erase(key);
+            const std::string prefix = key + '/';
+            const auto first = m_entries.lower_bound(prefix);
+            auto last = first;
+            while (last != m_entries.end() && last->first.compare(0, prefix.size(), prefix) == 0)
+                ++last;
+            m_entries.erase(first, last);
+
+            if (m_lower != nullptr && count != 0) m_hidden.insert(key);
+            return count;
+        }
+
+        void write_contents_locked(const fs::path& file_path, std::shared_ptr<const std::string> contents)
+        {
+            const std::string key = to_key(file_path);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               directory_exists(file_path.parent_path(), parent_key(key)) &&
+                                   !directory_exists(file_path, key),
+                               "Error: Could not open file for writing: %s",
+                               file_path.u8string());
+            m_entries[key] = Entry{file_path, false, std::move(contents), fs::path(), fs::file_time_type::clock::now()};
+        }
+
+        const Filesystem* m_lower;
+        mutable std::recursive_mutex m_mutex;
+        std::map<std::string, Entry> m_entries;
+        std::set<std::string> m_hidden;
     };
 
     Filesystem& get_real_filesystem()
@@ -180,9 +957,59 @@ namespace vcpkg::Files
         return real_fs;
     }
 
+    std::shared_ptr<Filesystem> make_memory_filesystem() { return std::make_shared<MemoryFilesystem>(nullptr); }
+
+    std::shared_ptr<Filesystem> make_overlay_filesystem(const Filesystem& lower)
+    {
+        return std::make_shared<MemoryFilesystem>(&lower);
+    }
+
+    FileLock wait_for_lock(Filesystem& fs, const fs::path& path, LockMode mode)
+    {
+        FileLock lock = fs.try_lock_file(path, mode);
+        if (lock.is_held()) return lock;
+
+        System::println("Waiting for another vcpkg process to release %s...", path.u8string());
+        using namespace std::chrono_literals;
+        for (;;)
+        {
+            std::this_thread::sleep_for(250ms);
+            lock = fs.try_lock_file(path, mode);
+            if (lock.is_held()) return lock;
+        }
+    }
+
     bool has_invalid_chars_for_filesystem(const std::string& s)
     {
-        return std::regex_search(s, FILESYSTEM_INVALID_CHARACTERS_REGEX);
+        return s.find_first_of(FILESYSTEM_INVALID_CHARACTERS) != std::string::npos;
+    }
+
+    std::string generic_u8_suffix(const fs::path& path, const size_t prefix_length)
+    {
+        const auto& native = path.native();
+        if (native.size() <= prefix_length + 1) return std::string();
+
+        std::string suffix = Strings::to_utf8(native.c_str() + prefix_length + 1);
+        std::replace(suffix.begin(), suffix.end(), '\\', '/');
+        return suffix;
+    }
+
+    static bool ascii_iequals(const std::wstring& s, const size_t start, const char* upper)
+    {
+        for (size_t i = start; i < s.size(); ++i, ++upper)
+        {
+            const wchar_t c = s[i] >= L'a' && s[i] <= L'z' ? static_cast<wchar_t>(s[i] - L'a' + L'A') : s[i];
+            if (*upper == '\0' || c != static_cast<wchar_t>(*upper)) return false;
+        }
+        return *upper == '\0';
+    }
+
+    bool is_package_metadata_file(const fs::path& path)
+    {
+        const auto& native = path.native();
+        const size_t separator = native.find_last_of(L"\\/");
+        const size_t start = separator == std::wstring::npos ? 0 : separator + 1;
+        return ascii_iequals(native, start, "CONTROL") || ascii_iequals(native, start, "BUILD_INFO");
     }
 
     void print_paths(const std::vector<fs::path>& paths)
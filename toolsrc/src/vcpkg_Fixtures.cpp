@@ -0,0 +1,204 @@
+#include "pch.h"
+
+#include "Paragraphs.h"
+#include "vcpkg_Fixtures.h"
+#include "vcpkg_Strings.h"
+
+namespace vcpkg::Fixtures
+{
+    std::string port_name(const size_t i) { return Strings::format("port-%d", static_cast<int>(i)); }
+
+    std::string feature_name(const size_t i) { return Strings::format("feature-%d", static_cast<int>(i)); }
+
+    std::vector<std::string> get_dependencies(const Parameters& parameters, const size_t i)
+    {
+        const size_t layer_size = std::max<size_t>(1, parameters.port_count / parameters.dependency_depth);
+        if (i < layer_size) return {};
+
+        const size_t layer_begin = (i / layer_size - 1) * layer_size;
+        return {port_name(layer_begin + i % layer_size), port_name(layer_begin + (i * 7 + 3) % layer_size)};
+    }
+
+    std::string generate_control_file(const Parameters& parameters, const size_t i)
+    {
+        const std::vector<std::string> dependencies = get_dependencies(parameters, i);
+        std::string control = Strings::format("Source: %s\n"
+                                              "Version: 1.0.%d\n"
+                                              "Description: A synthetic port\n"
+                                              "Build-Depends: %s\n",
+                                              port_name(i),
+                                              static_cast<int>(i),
+                                              Strings::join(", ", dependencies));
+        for (size_t f = 0; f < parameters.feature_count; ++f)
+        {
+            control += Strings::format("\nFeature: %s\nDescription: A synthetic feature\n", feature_name(f));
+            if (!dependencies.empty())
+            {
+                control += Strings::format("Build-Depends: %s[%s]\n", dependencies.front(), feature_name(f));
+            }
+        }
+        return control;
+    }
+
+    /// <summary>
+    /// The paragraphs of the built package, each with the extra line at its end
+    /// </summary>
+    static std::string generate_package_paragraphs(const Parameters& parameters,
+                                                   const size_t i,
+                                                   const Triplet& triplet,
+                                                   const std::string& extra_line)
+    {
+        std::string paragraphs = Strings::format("Package: %s\n"
+                                                 "Version: 1.0.%d\n"
+                                                 "Depends: %s\n"
+                                                 "Architecture: %s\n"
+                                                 "Multi-Arch: same\n"
+                                                 "Description: A synthetic port\n"
+                                                 "%s\n",
+                                                 port_name(i),
+                                                 static_cast<int>(i),
+                                                 Strings::join(", ", get_dependencies(parameters, i)),
+                                                 triplet.canonical_name(),
+                                                 extra_line);
+        for (size_t f = 0; f < parameters.feature_count; ++f)
+        {
+            paragraphs += Strings::format("Package: %s\n"
+                                          "Feature: %s\n"
+                                          "Architecture: %s\n"
+                                          "Multi-Arch: same\n"
+                                          "Description: A synthetic feature\n"
+                                          "%s\n",
+                                          port_name(i),
+                                          feature_name(f),
+                                          triplet.canonical_name(),
+                                          extra_line);
+        }
+        return paragraphs;
+    }
+
+    std::string generate_status_file(const Parameters& parameters)
+    {
+        std::string status;
+        for (auto&& triplet : parameters.triplets)
+        {
+            for (size_t i = 0; i < parameters.port_count; ++i)
+            {
+                status += generate_package_paragraphs(parameters, i, triplet, "Status: install ok installed\n");
+            }
+        }
+        return status;
+    }
+
+    std::string generate_package_control_file(const Parameters& parameters, const size_t i, const Triplet& triplet)
+    {
+        return generate_package_paragraphs(parameters, i, triplet, Strings::EMPTY);
+    }
+
+    std::vector<std::string> generate_listfile(const Parameters& parameters, const size_t i, const Triplet& triplet)
+    {
+        const std::string& triplet_dir = triplet.canonical_name();
+        const std::string include_dir = triplet_dir + "/include/" + port_name(i) + "/";
+        std::vector<std::string> lines = {triplet_dir + "/", triplet_dir + "/include/", include_dir};
+        for (size_t file = 0; file < parameters.installed_file_count; ++file)
+        {
+            lines.push_back(Strings::format("%sheader-%d.h", include_dir, static_cast<int>(file)));
+        }
+        return lines;
+    }
+
+    static VcpkgPaths create_root_with_ports(Files::Filesystem& fs, const fs::path& root, const Parameters& parameters)
+    {
+        std::error_code ec;
+        fs.remove_all(root, ec);
+        fs.create_directories(root, ec);
+        fs.write_contents(root / ".vcpkg-root", Strings::EMPTY);
+
+        VcpkgPaths paths = VcpkgPaths::create(root, fs).value_or_exit(VCPKG_LINE_INFO);
+        for (size_t i = 0; i < parameters.port_count; ++i)
+        {
+            const fs::path port_dir = paths.port_dir(port_name(i));
+            fs.create_directories(port_dir, ec);
+            fs.write_contents(port_dir / "CONTROL", generate_control_file(parameters, i));
+        }
+
+        fs.create_directories(paths.vcpkg_dir_info, ec);
+        fs.create_directories(paths.vcpkg_dir_updates, ec);
+        return paths;
+    }
+
+    VcpkgPaths create_root(Files::Filesystem& fs, const fs::path& root, const Parameters& parameters)
+    {
+        VcpkgPaths paths = create_root_with_ports(fs, root, parameters);
+        fs.write_contents(paths.vcpkg_dir_status_file, generate_status_file(parameters));
+        for (auto&& triplet : parameters.triplets)
+        {
+            for (size_t i = 0; i < parameters.port_count; ++i)
+            {
+                BinaryParagraph pgh;
+                pgh.spec = PackageSpec::from_name_and_triplet(port_name(i), triplet).value_or_exit(VCPKG_LINE_INFO);
+                pgh.version = Strings::format("1.0.%d", static_cast<int>(i));
+                fs.write_lines(paths.listfile_path(pgh), generate_listfile(parameters, i, triplet));
+            }
+        }
+        return paths;
+    }
+
+    VcpkgPaths create_prebuilt_root(Files::Filesystem& fs, const fs::path& root, const Parameters& parameters)
+    {
+        VcpkgPaths paths = create_root_with_ports(fs, root, parameters);
+        fs.write_contents(paths.vcpkg_dir_status_file, Strings::EMPTY);
+
+        std::error_code ec;
+        for (auto&& triplet : parameters.triplets)
+        {
+            for (size_t i = 0; i < parameters.port_count; ++i)
+            {
+                const PackageSpec spec =
+                    PackageSpec::from_name_and_triplet(port_name(i), triplet).value_or_exit(VCPKG_LINE_INFO);
+                const fs::path package_dir = paths.package_dir(spec);
+                const fs::path include_dir = package_dir / "include" / port_name(i);
+                fs.create_directories(include_dir, ec);
+                fs.write_contents(package_dir / "CONTROL", generate_package_control_file(parameters, i, triplet));
+                for (size_t file = 0; file < parameters.installed_file_count; ++file)
+                {
+                    const std::string header = Strings::format("header-%d.h", static_cast<int>(file));
+                    fs.write_contents(include_dir / header, Strings::format("// %s of %s\n", header, port_name(i)));
+                }
+            }
+        }
+        return paths;
+    }
+
+    VcpkgPaths create_small_root(Files::Filesystem& fs, const fs::path& root)
+    {
+        Parameters parameters;
+        parameters.port_count = 1;
+        parameters.feature_count = 0;
+        parameters.dependency_depth = 1;
+        parameters.installed_file_count = 1;
+        parameters.triplets = {Triplet::X86_WINDOWS};
+        return create_root(fs, root, parameters);
+    }
+
+    BinaryControlFile write_built_package(const VcpkgPaths& paths,
+                                          const PackageSpec& spec,
+                                          const std::string& abi,
+                                          const std::map<std::string, std::string>& headers)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path package_dir = paths.package_dir(spec);
+        std::error_code ec;
+        fs.create_directories(package_dir / "include", ec);
+
+        std::string control_file = Strings::format("Package: %s\nVersion: 1\nArchitecture: %s\nMulti-Arch: same\n",
+                                                   spec.name(),
+                                                   spec.triplet().canonical_name());
+        if (!abi.empty()) control_file += Strings::format("Abi: %s\n", abi);
+        fs.write_contents(package_dir / "CONTROL", control_file);
+        for (auto&& header : headers)
+        {
+            fs.write_contents(package_dir / "include" / header.first, header.second);
+        }
+        return Paragraphs::try_load_cached_control_package(paths, spec).value_or_exit(VCPKG_LINE_INFO);
+    }
+}
@@ -7,6 +7,13 @@ namespace vcpkg
     Util::LockGuarded<ElapsedTime> GlobalState::timer;
     std::atomic<bool> GlobalState::debugging = false;
     std::atomic<bool> GlobalState::feature_packages = false;
+    std::atomic<bool> GlobalState::binary_caching = false;
+    std::atomic<bool> GlobalState::deduplicate = false;
+    std::atomic<bool> GlobalState::timings = false;
+    std::atomic<bool> GlobalState::trace_processes = false;
+    std::atomic<bool> GlobalState::memstats = false;
+    std::atomic<bool> GlobalState::background = false;
+    std::atomic<uint64_t> GlobalState::background_affinity = 0;
 
     std::atomic<int> GlobalState::g_init_console_cp = 0;
     std::atomic<int> GlobalState::g_init_console_output_cp = 0;
@@ -0,0 +1,163 @@
+#include "pch.h"
+
+#include "vcpkg_Http.h"
+#include "vcpkg_Strings.h"
+
+#pragma comment(lib, "winhttp")
+
+namespace vcpkg::Http
+{
+    Optional<ParsedUrl> parse_url(const std::string& url)
+    {
+        const std::wstring wide_url = Strings::to_utf16(url);
+        URL_COMPONENTS components = {sizeof(URL_COMPONENTS)};
+        components.dwHostNameLength = static_cast<DWORD>(-1);
+        components.dwUrlPathLength = static_cast<DWORD>(-1);
+        components.dwExtraInfoLength = static_cast<DWORD>(-1);
+        if (!WinHttpCrackUrl(wide_url.c_str(), 0, 0, &components)) return nullopt;
+        if (components.nScheme != INTERNET_SCHEME_HTTP && components.nScheme != INTERNET_SCHEME_HTTPS) return nullopt;
+
+        return ParsedUrl{std::wstring(components.lpszHostName, components.dwHostNameLength),
+                         components.nPort,
+                         std::wstring(components.lpszUrlPath, components.dwUrlPathLength) +
+                             std::wstring(components.lpszExtraInfo, components.dwExtraInfoLength),
+                         components.nScheme == INTERNET_SCHEME_HTTPS};
+    }
+
+    Request::~Request()
+    {
+        if (request) WinHttpCloseHandle(request);
+        if (connect) WinHttpCloseHandle(connect);
+    }
+
+    static std::unique_ptr<Request> open_request(const HINTERNET session, const ParsedUrl& url, const wchar_t* verb)
+    {
+        auto r = std::make_unique<Request>();
+        r->connect = WinHttpConnect(session, url.host.c_str(), url.port, 0);
+        if (!r->connect) return nullptr;
+
+        r->request = WinHttpOpenRequest(r->connect,
+                                        verb,
+                                        url.path.c_str(),
+                                        nullptr,
+                                        WINHTTP_NO_REFERER,
+                                        WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                        url.secure ? WINHTTP_FLAG_SECURE : 0);
+        if (!r->request) return nullptr;
+        return r;
+    }
+
+    static std::unique_ptr<Request> receive_response(std::unique_ptr<Request> r)
+    {
+        if (!WinHttpReceiveResponse(r->request, nullptr)) return nullptr;
+
+        DWORD size = sizeof(r->status_code);
+        if (!WinHttpQueryHeaders(r->request,
+                                 WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                                 nullptr,
+                                 &r->status_code,
+                                 &size,
+                                 WINHTTP_NO_HEADER_INDEX))
+        {
+            return nullptr;
+        }
+        return r;
+    }
+
+    std::unique_ptr<Request> send_request(const HINTERNET session,
+                                          const ParsedUrl& url,
+                                          const wchar_t* verb,
+                                          const std::wstring& headers)
+    {
+        auto r = open_request(session, url, verb);
+        if (!r) return nullptr;
+
+        const BOOL sent = WinHttpSendRequest(r->request,
+                                             headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
+                                             headers.empty() ? 0 : static_cast<DWORD>(-1),
+                                             WINHTTP_NO_REQUEST_DATA,
+                                             0,
+                                             0,
+                                             0);
+        if (!sent) return nullptr;
+        return receive_response(std::move(r));
+    }
+
+    std::unique_ptr<Request> send_data(const HINTERNET session,
+                                       const ParsedUrl& url,
+                                       const wchar_t* verb,
+                                       const std::wstring& headers,
+                                       const std::string& body)
+    {
+        if (body.size() > MAXDWORD) return nullptr;
+
+        auto r = open_request(session, url, verb);
+        if (!r) return nullptr;
+
+        const BOOL sent = WinHttpSendRequest(r->request,
+                                             headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
+                                             headers.empty() ? 0 : static_cast<DWORD>(-1),
+                                             const_cast<char*>(body.data()),
+                                             static_cast<DWORD>(body.size()),
+                                             static_cast<DWORD>(body.size()),
+                                             0);
+        if (!sent) return nullptr;
+        return receive_response(std::move(r));
+    }
+
+    std::unique_ptr<Request> send_file(const HINTERNET session,
+                                       const ParsedUrl& url,
+                                       const wchar_t* verb,
+                                       const std::wstring& headers,
+                                       const fs::path& file)
+    {
+        std::error_code ec;
+        const uintmax_t size = fs::stdfs::file_size(file, ec);
+        // WinHTTP sends the length as a DWORD
+        if (ec || size > MAXDWORD) return nullptr;
+
+        std::ifstream input(file, std::ios::binary);
+        if (!input) return nullptr;
+
+        auto r = open_request(session, url, verb);
+        if (!r) return nullptr;
+
+        const BOOL sent = WinHttpSendRequest(r->request,
+                                             headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
+                                             headers.empty() ? 0 : static_cast<DWORD>(-1),
+                                             WINHTTP_NO_REQUEST_DATA,
+                                             0,
+                                             static_cast<DWORD>(size),
+                                             0);
+        if (!sent) return nullptr;
+
+        std::vector<char> buffer(64 * 1024);
+        uintmax_t remaining = size;
+        while (remaining != 0)
+        {
+            input.read(buffer.data(), static_cast<std::streamsize>(std::min<uintmax_t>(buffer.size(), remaining)));
+            const DWORD count = static_cast<DWORD>(input.gcount());
+            if (count == 0) return nullptr;
+
+            DWORD written = 0;
+            if (!WinHttpWriteData(r->request, buffer.data(), count, &written) || written != count) return nullptr;
+            remaining -= count;
+        }
+        return receive_response(std::move(r));
+    }
+
+    Optional<std::wstring> query_header(const HINTERNET request, const DWORD info_level)
+    {
+        DWORD size = 0;
+        WinHttpQueryHeaders(request, info_level, nullptr, WINHTTP_NO_OUTPUT_BUFFER, &size, WINHTTP_NO_HEADER_INDEX);
+        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) return nullopt;
+
+        std::wstring value(size / sizeof(wchar_t), L'\0');
+        if (!WinHttpQueryHeaders(request, info_level, nullptr, &value[0], &size, WINHTTP_NO_HEADER_INDEX))
+        {
+            return nullopt;
+        }
+        value.resize(size / sizeof(wchar_t));
+        return value;
+    }
+}
@@ -0,0 +1,289 @@
+#include "pch.h"
+
+#include "vcpkg_Listfile.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+
+// The layout of a binary listfile, with integers in little endian:
+//     char[8]   "VCPKGLST"
+//     uint32    format version, 1
+//     uint32    number of entries
+//     uint32    number of restart points, one per RESTART_INTERVAL entries
+//     uint32    length of the stamp, followed by the stamp
+//     uint32[]  offset of each restart point from the start of the entries
+// then for each entry, sorted by its line in the text listfile:
+//     varint    length of the prefix shared with the previous path, 0 at a restart point
+//     varint    length of the rest of the path, followed by it
+//     uint8     flags: 1 for a directory, 2 if the size follows
+//     varint    size of the file
+// where a varint stores 7 bits per byte, lowest first, with the high bit set on all but the last byte.
+namespace vcpkg::Listfile
+{
+    static constexpr char MAGIC[] = "VCPKGLST";
+    static constexpr size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr size_t HEADER_SIZE = MAGIC_SIZE + 4 * sizeof(uint32_t);
+
+    static constexpr size_t RESTART_INTERVAL = 16;
+
+    static constexpr uint8_t DIRECTORY_FLAG = 1;
+    static constexpr uint8_t SIZE_FLAG = 2;
+
+    static void append_uint32(std::string& out, const uint32_t value)
+    {
+        // x86, x64 and ARM are all little endian, so integers are written as they are in memory
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static uint32_t read_uint32(const char* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static void append_varint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    static bool read_varint(const char*& p, const char* const end, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && p != end; shift += 7)
+        {
+            const uint8_t byte = static_cast<uint8_t>(*p++);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Decodes the entries which follow a restart point, stopping at the first malformed one
+    /// </summary>
+    struct Decoder
+    {
+        const char* p;
+        const char* end;
+        Entry entry;
+
+        bool next()
+        {
+            uint64_t shared;
+            uint64_t suffix;
+            if (!read_varint(p, end, shared) || !read_varint(p, end, suffix)) return false;
+            if (shared > entry.path.size() || suffix >= static_cast<uint64_t>(end - p)) return false;
+
+            entry.path.resize(static_cast<size_t>(shared));
+            entry.path.append(p, static_cast<size_t>(suffix));
+            p += suffix;
+
+            const uint8_t flags = static_cast<uint8_t>(*p++);
+            if ((flags & ~(DIRECTORY_FLAG | SIZE_FLAG)) != 0) return false;
+            entry.is_directory = (flags & DIRECTORY_FLAG) != 0;
+            entry.size = nullopt;
+            if ((flags & SIZE_FLAG) != 0)
+            {
+                uint64_t size;
+                if (!read_varint(p, end, size)) return false;
+                entry.size = size;
+            }
+            return true;
+        }
+    };
+
+    Optional<BinaryListfile> BinaryListfile::parse(Files::MappedFile file)
+    {
+        const char* const begin = file.contents().begin();
+        const char* const end = file.contents().end();
+        if (file.size < HEADER_SIZE || std::memcmp(begin, MAGIC, MAGIC_SIZE) != 0) return nullopt;
+
+        const char* p = begin + MAGIC_SIZE;
+        const uint32_t version = read_uint32(p);
+        const uint32_t entry_count = read_uint32(p + 4);
+        const uint32_t restart_count = read_uint32(p + 8);
+        const uint32_t stamp_size = read_uint32(p + 12);
+        p += 16;
+        if (version != FORMAT_VERSION) return nullopt;
+        if (restart_count != (entry_count + RESTART_INTERVAL - 1) / RESTART_INTERVAL) return nullopt;
+        if (stamp_size > static_cast<size_t>(end - p)) return nullopt;
+
+        BinaryListfile listfile;
+        listfile.m_stamp.assign(p, stamp_size);
+        p += stamp_size;
+        if (static_cast<uint64_t>(restart_count) * sizeof(uint32_t) > static_cast<uint64_t>(end - p)) return nullopt;
+
+        listfile.m_entry_count = entry_count;
+        listfile.m_restart_count = restart_count;
+        listfile.m_restarts = p;
+        listfile.m_data = p + restart_count * sizeof(uint32_t);
+        listfile.m_file = std::move(file);
+        return std::move(listfile);
+    }
+
+    std::string BinaryListfile::serialize(const std::vector<Entry>& sorted_entries, const std::string& stamp)
+    {
+        std::string entries;
+        std::vector<uint32_t> restarts;
+        for (size_t i = 0; i < sorted_entries.size(); ++i)
+        {
+            const Entry& entry = sorted_entries[i];
+            size_t shared = 0;
+            if (i % RESTART_INTERVAL == 0)
+            {
+                restarts.push_back(static_cast<uint32_t>(entries.size()));
+            }
+            else
+            {
+                const std::string& previous = sorted_entries[i - 1].path;
+                const size_t limit = std::min(previous.size(), entry.path.size());
+                while (shared < limit && previous[shared] == entry.path[shared])
+                    ++shared;
+            }
+
+            append_varint(entries, shared);
+            append_varint(entries, entry.path.size() - shared);
+            entries.append(entry.path, shared, std::string::npos);
+
+            const auto size = entry.size.get();
+            entries.push_back(static_cast<char>((entry.is_directory ? DIRECTORY_FLAG : 0) | (size ? SIZE_FLAG : 0)));
+            if (size) append_varint(entries, *size);
+        }
+
+        std::string out(MAGIC, MAGIC_SIZE);
+        append_uint32(out, FORMAT_VERSION);
+        append_uint32(out, static_cast<uint32_t>(sorted_entries.size()));
+        append_uint32(out, static_cast<uint32_t>(restarts.size()));
+        append_uint32(out, static_cast<uint32_t>(stamp.size()));
+        out.append(stamp);
+        for (const uint32_t restart : restarts)
+        {
+            append_uint32(out, restart);
+        }
+        out.append(entries);
+        return out;
+    }
+
+    Optional<std::vector<Entry>> BinaryListfile::entries() const
+    {
+        Decoder decoder{m_data, m_file.contents().end(), Entry()};
+        std::vector<Entry> entries;
+        entries.reserve(m_entry_count);
+        for (size_t i = 0; i < m_entry_count; ++i)
+        {
+            if (!decoder.next()) return nullopt;
+            entries.push_back(decoder.entry);
+        }
+        return std::move(entries);
+    }
+
+    bool BinaryListfile::contains(const std::string& line) const
+    {
+        const char* const end = m_file.contents().end();
+        const auto decoder_at = [&](const size_t restart) {
+            const uint32_t offset = read_uint32(m_restarts + restart * sizeof(uint32_t));
+            const char* const p = offset < static_cast<size_t>(end - m_data) ? m_data + offset : end;
+            return Decoder{p, end, Entry()};
+        };
+
+        // The last restart point whose entry is not after the line
+        size_t low = 0;
+        size_t high = m_restart_count;
+        while (low < high)
+        {
+            const size_t middle = low + (high - low) / 2;
+            Decoder decoder = decoder_at(middle);
+            if (!decoder.next()) return false;
+            if (decoder.entry.to_line() <= line)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low == 0) return false;
+
+        const size_t restart = low - 1;
+        Decoder decoder = decoder_at(restart);
+        const size_t count = std::min(RESTART_INTERVAL, m_entry_count - restart * RESTART_INTERVAL);
+        for (size_t i = 0; i < count && decoder.next(); ++i)
+        {
+            const std::string current = decoder.entry.to_line();
+            if (current == line) return true;
+            if (current > line) return false;
+        }
+        return false;
+    }
+
+    std::string get_stamp(const Files::Filesystem& fs, const fs::path& path)
+    {
+        std::error_code ec;
+        const std::uintmax_t size = fs.file_size(path, ec);
+        if (ec) return Strings::EMPTY;
+
+        const fs::file_time_type time = fs.last_write_time(path, ec);
+        if (ec) return Strings::EMPTY;
+
+        return std::to_string(size) + ':' + std::to_string(time.time_since_epoch().count());
+    }
+
+    fs::path binary_listfile_path(const fs::path& listfile_path)
+    {
+        fs::path binary_path = listfile_path;
+        binary_path += ".bin";
+        return binary_path;
+    }
+
+    static bool line_less(const Entry& left, const Entry& right) { return left.to_line() < right.to_line(); }
+
+    void write(Files::Filesystem& fs, const fs::path& listfile_path, std::vector<Entry> entries)
+    {
+        std::sort(entries.begin(), entries.end(), line_less);
+        fs.write_lines(listfile_path, Util::fmap(entries, [](const Entry& entry) { return entry.to_line(); }));
+        write_binary(fs, listfile_path, std::move(entries));
+    }
+
+    Optional<std::vector<Entry>> try_read_binary(const Files::Filesystem& fs, const fs::path& listfile_path)
+    {
+        const Expected<Files::MappedFile> maybe_file = fs.map_contents(binary_listfile_path(listfile_path));
+        const auto file = maybe_file.get();
+        if (!file) return nullopt;
+
+        const Optional<BinaryListfile> maybe_listfile = BinaryListfile::parse(*file);
+        const auto listfile = maybe_listfile.get();
+        if (!listfile || listfile->stamp().empty() || listfile->stamp() != get_stamp(fs, listfile_path))
+        {
+            return nullopt;
+        }
+        return listfile->entries();
+    }
+
+    void write_binary(Files::Filesystem& fs, const fs::path& listfile_path, std::vector<Entry> entries)
+    {
+        const std::string stamp = get_stamp(fs, listfile_path);
+        if (stamp.empty()) return;
+
+        // Listfiles from older versions are not always sorted
+        if (!std::is_sorted(entries.cbegin(), entries.cend(), line_less))
+        {
+            std::sort(entries.begin(), entries.end(), line_less);
+        }
+
+        // Processes which only read the installed tree convert listfiles too, so each writes its own temporary file
+        const fs::path binary_path = binary_listfile_path(listfile_path);
+        fs::path tmp_path = binary_path;
+        tmp_path += Strings::format(".%d.tmp", static_cast<int>(GetCurrentProcessId()));
+        fs.write_contents(tmp_path, BinaryListfile::serialize(entries, stamp));
+
+        std::error_code ec;
+        fs.rename(tmp_path, binary_path, ec);
+        if (ec)
+        {
+            fs.remove(tmp_path, ec);
+        }
+    }
+}
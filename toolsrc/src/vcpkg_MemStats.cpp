@@ -0,0 +1,66 @@
+#include "pch.h"
+
+#include "vcpkg_MemStats.h"
+
+#include <Psapi.h>
+#include <malloc.h>
+
+#pragma comment(lib, "psapi")
+
+namespace vcpkg::MemStats
+{
+    // Relaxed, because nothing is ordered by them; they are only ever summed up and read at once
+    static std::atomic<uint64_t> g_allocations{0};
+    static std::atomic<uint64_t> g_allocated_bytes{0};
+    static std::atomic<uint64_t> g_heap_bytes{0};
+    static std::atomic<uint64_t> g_peak_heap_bytes{0};
+
+    static void count_allocation(void* p)
+    {
+        // The block may be larger than was asked for, and freeing it subtracts the whole block
+        const uint64_t size = _msize(p);
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+        const uint64_t heap_bytes = g_heap_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        uint64_t peak = g_peak_heap_bytes.load(std::memory_order_relaxed);
+        while (heap_bytes > peak && !g_peak_heap_bytes.compare_exchange_weak(peak, heap_bytes))
+        {
+        }
+    }
+
+    static void count_free(void* p) { g_heap_bytes.fetch_sub(_msize(p), std::memory_order_relaxed); }
+
+    Counters get_counters()
+    {
+        Counters counters;
+        counters.allocations = g_allocations.load(std::memory_order_relaxed);
+        counters.allocated_bytes = g_allocated_bytes.load(std::memory_order_relaxed);
+        return counters;
+    }
+
+    uint64_t get_peak_heap_bytes() { return g_peak_heap_bytes.load(std::memory_order_relaxed); }
+
+    uint64_t get_peak_working_set_bytes()
+    {
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize;
+    }
+}
+
+// The other forms of operator new and delete, such as the array and nothrow ones, end up in these
+void* operator new(const size_t size)
+{
+    void* const p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    vcpkg::MemStats::count_allocation(p);
+    return p;
+}
+
+void operator delete(void* const p) noexcept
+{
+    if (p == nullptr) return;
+    vcpkg::MemStats::count_free(p);
+    free(p);
+}
@@ -0,0 +1,172 @@
+#include "pch.h"
+
+#include "vcpkg_Commands.h"
+#include "vcpkg_Nupkg.h"
+#include "vcpkg_Strings.h"
+
+namespace vcpkg::Nupkg
+{
+    static constexpr auto FILE_CONTENT_TYPE = "application/octet";
+
+    static std::string escape_xml(const std::string& s)
+    {
+        std::string ret;
+        ret.reserve(s.size());
+        for (const char c : s)
+        {
+            switch (c)
+            {
+                case '&': ret.append("&amp;"); break;
+                case '<': ret.append("&lt;"); break;
+                case '>': ret.append("&gt;"); break;
+                case '"': ret.append("&quot;"); break;
+                case '\'': ret.append("&apos;"); break;
+                default: ret.push_back(c); break;
+            }
+        }
+        return ret;
+    }
+
+    std::string encode_part_name(const std::string& name)
+    {
+        // The characters which a URI path keeps as they are; everything else, '%' included, is a UTF-8 byte escape
+        static constexpr auto KEPT = "-._~!$&'()*+,;=:@/";
+        static constexpr auto HEX = "0123456789ABCDEF";
+
+        std::string ret;
+        ret.reserve(name.size());
+        for (const char c : name)
+        {
+            const unsigned char byte = static_cast<unsigned char>(c);
+            if (byte < 0x80 && (isalnum(byte) || std::strchr(KEPT, c) != nullptr))
+            {
+                ret.push_back(c);
+                continue;
+            }
+            ret.push_back('%');
+            ret.push_back(HEX[byte >> 4]);
+            ret.push_back(HEX[byte & 0xF]);
+        }
+        return ret;
+    }
+
+    static std::string create_nuspec(const Metadata& metadata)
+    {
+        return Strings::format(R"(<?xml version="1.0" encoding="utf-8"?>
+<package xmlns="http://schemas.microsoft.com/packaging/2010/07/nuspec.xsd">
+  <metadata>
+    <id>%s</id>
+    <version>%s</version>
+    <authors>vcpkg</authors>
+    <description>%s</description>
+  </metadata>
+</package>
+)",
+                               escape_xml(metadata.id),
+                               escape_xml(metadata.version),
+                               escape_xml(metadata.description));
+    }
+
+    static std::string create_core_properties(const Metadata& metadata)
+    {
+        return Strings::format(
+            R"(<?xml version="1.0" encoding="utf-8"?>
+<coreProperties xmlns:dc="http://purl.org/dc/elements/1.1/" xmlns:dcterms="http://purl.org/dc/terms/" xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance" xmlns="http://schemas.openxmlformats.org/package/2006/metadata/core-properties">
+  <dc:creator>vcpkg</dc:creator>
+  <dc:description>%s</dc:description>
+  <dc:identifier>%s</dc:identifier>
+  <version>%s</version>
+  <keywords></keywords>
+  <lastModifiedBy>vcpkg</lastModifiedBy>
+</coreProperties>
+)",
+            escape_xml(metadata.description),
+            escape_xml(metadata.id),
+            escape_xml(metadata.version));
+    }
+
+    static std::string create_relationships(const std::string& nuspec_name, const std::string& core_properties_name)
+    {
+        return Strings::format(
+            R"(<?xml version="1.0" encoding="utf-8"?>
+<Relationships xmlns="http://schemas.openxmlformats.org/package/2006/relationships">
+  <Relationship Type="http://schemas.microsoft.com/packaging/2010/07/manifest" Target="/%s" Id="R0" />
+  <Relationship Type="http://schemas.openxmlformats.org/package/2006/relationships/metadata/core-properties" Target="/%s" Id="R1" />
+</Relationships>
+)",
+            escape_xml(nuspec_name),
+            escape_xml(core_properties_name));
+    }
+
+    /// <summary>
+    /// Every part needs a content type: files with an extension get the default of their extension, which is
+    /// compared without case, and files without one an override of their own
+    /// </summary>
+    static std::string create_content_types(const std::vector<Zip::Entry>& files)
+    {
+        std::string defaults;
+        std::string overrides;
+        std::set<std::string> extensions = {"rels", "psmdcp"};
+        for (auto&& file : files)
+        {
+            const size_t name_begin = file.name.find_last_of('/') + 1;
+            const size_t dot = file.name.find_last_of('.');
+            if (dot == std::string::npos || dot < name_begin || dot + 1 == file.name.size())
+            {
+                overrides.append(Strings::format(R"(  <Override PartName="/%s" ContentType="%s" />)" "\n",
+                                                 escape_xml(file.name),
+                                                 FILE_CONTENT_TYPE));
+                continue;
+            }
+
+            std::string extension = Strings::ascii_to_lowercase(file.name.substr(dot + 1));
+            if (!extensions.insert(extension).second) continue;
+            defaults.append(Strings::format(
+                R"(  <Default Extension="%s" ContentType="%s" />)" "\n", escape_xml(extension), FILE_CONTENT_TYPE));
+        }
+
+        return Strings::format(R"(<?xml version="1.0" encoding="utf-8"?>
+<Types xmlns="http://schemas.openxmlformats.org/package/2006/content-types">
+  <Default Extension="rels" ContentType="application/vnd.openxmlformats-package.relationships+xml" />
+  <Default Extension="psmdcp" ContentType="application/vnd.openxmlformats-package.core-properties+xml" />
+%s%s</Types>
+)",
+                               defaults,
+                               overrides);
+    }
+
+    ExpectedT<uint64_t, std::string> write(const Files::Filesystem& fs,
+                                           const fs::path& nupkg,
+                                           const Metadata& metadata,
+                                           std::vector<Zip::Entry> files)
+    {
+        for (auto&& file : files)
+            file.name = encode_part_name(file.name);
+
+        Zip::Entry nuspec;
+        nuspec.name = encode_part_name(metadata.id + ".nuspec");
+        nuspec.contents = create_nuspec(metadata);
+        files.insert(files.begin(), std::move(nuspec));
+
+        // The name only has to be unique in the package; deriving it from the package keeps the output the same
+        Commands::Hash::Hasher hasher("SHA256");
+        const std::string stamp = metadata.id + '\n' + metadata.version;
+        hasher.add(stamp.data(), stamp.size());
+        Zip::Entry core_properties;
+        core_properties.name = "package/services/metadata/core-properties/" + hasher.finish().substr(0, 32) + ".psmdcp";
+        core_properties.contents = create_core_properties(metadata);
+
+        Zip::Entry relationships;
+        relationships.name = "_rels/.rels";
+        relationships.contents = create_relationships(files.front().name, core_properties.name);
+
+        Zip::Entry content_types;
+        content_types.name = "[Content_Types].xml";
+        content_types.contents = create_content_types(files);
+
+        files.push_back(std::move(relationships));
+        files.push_back(std::move(core_properties));
+        files.push_back(std::move(content_types));
+        return Zip::write(fs, nupkg, files);
+    }
+}
@@ -0,0 +1,504 @@
+#include "pch.h"
+
+#include "vcpkg_Commands.h"
+#include "vcpkg_PackageArchive.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+#include "vcpkg_optional.h"
+
+// The layout of an archive, with integers in little endian:
+//     char[8]   "VCPKGPKG"
+//     uint32    format version, 1
+//     uint32    compression of the blocks, 0 for none or 1 for XPRESS with Huffman coding
+//     uint32    number of entries
+// then for each entry, directories before what they contain:
+//     uint32    length of the path, followed by the UTF-8 path
+//     uint8     1 for a directory, 0 for a file
+//     uint64    size of the file
+//     char[64]  SHA256 of the file as lowercase hexadecimal; zeros for a directory
+// then for each file, in the order of the table, the blocks of its contents:
+//     uint32    stored size, which equals the size if the block could not be compressed
+//     uint32    size, at most BLOCK_SIZE
+//     the stored bytes
+namespace vcpkg::PackageArchive
+{
+    static constexpr char MAGIC[] = "VCPKGPKG";
+    static constexpr size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr uint32_t STORED = 0;
+    static constexpr uint32_t XPRESS_HUFF = 1;
+    static constexpr size_t HASH_SIZE = 64;
+    static constexpr size_t MAX_PATH_SIZE = 32 * 1024;
+
+    /// <summary>
+    /// Blocks are compressed separately, which bounds the memory needed for files of any size
+    /// </summary>
+    static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+    /// <summary>
+    /// The Compression API of cabinet.dll, which is loaded at run time since Windows 7 does not have it. Archives
+    /// created there are not compressed.
+    /// </summary>
+    struct CompressionApi
+    {
+        // COMPRESS_ALGORITHM_XPRESS_HUFF from compressapi.h
+        static constexpr DWORD ALGORITHM = 4;
+
+        using Create = BOOL(WINAPI*)(DWORD algorithm, void* allocation_routines, void** handle);
+        using Process = BOOL(WINAPI*)(
+            void* handle, const void* input, SIZE_T input_size, void* output, SIZE_T output_size, SIZE_T* result_size);
+        using Close = BOOL(WINAPI*)(void* handle);
+
+        Create create_compressor;
+        Process compress;
+        Close close_compressor;
+        Create create_decompressor;
+        Process decompress;
+        Close close_decompressor;
+    };
+
+    static const CompressionApi* get_compression_api()
+    {
+        static const Optional<CompressionApi> API = []() -> Optional<CompressionApi> {
+            const HMODULE cabinet = LoadLibraryW(L"cabinet.dll");
+            if (cabinet == nullptr) return nullopt;
+
+            CompressionApi api;
+            api.create_compressor =
+                reinterpret_cast<CompressionApi::Create>(GetProcAddress(cabinet, "CreateCompressor"));
+            api.compress = reinterpret_cast<CompressionApi::Process>(GetProcAddress(cabinet, "Compress"));
+            api.close_compressor = reinterpret_cast<CompressionApi::Close>(GetProcAddress(cabinet, "CloseCompressor"));
+            api.create_decompressor =
+                reinterpret_cast<CompressionApi::Create>(GetProcAddress(cabinet, "CreateDecompressor"));
+            api.decompress = reinterpret_cast<CompressionApi::Process>(GetProcAddress(cabinet, "Decompress"));
+            api.close_decompressor =
+                reinterpret_cast<CompressionApi::Close>(GetProcAddress(cabinet, "CloseDecompressor"));
+            if (!api.create_compressor || !api.compress || !api.close_compressor || !api.create_decompressor ||
+                !api.decompress || !api.close_decompressor)
+            {
+                return nullopt;
+            }
+            return api;
+        }();
+        return API.get();
+    }
+
+    /// <summary>
+    /// A compressor or decompressor of the Compression API; holds nothing if the API is missing or it could not be
+    /// created
+    /// </summary>
+    struct CompressionHandle : Util::ResourceBase
+    {
+        CompressionHandle(const CompressionApi::Create create, const CompressionApi::Close close) : m_close(close)
+        {
+            if (create == nullptr || !create(CompressionApi::ALGORITHM, nullptr, &handle)) handle = nullptr;
+        }
+
+        ~CompressionHandle()
+        {
+            if (handle != nullptr) m_close(handle);
+        }
+
+        void* handle = nullptr;
+
+    private:
+        CompressionApi::Close m_close;
+    };
+
+    // x86, x64 and ARM are all little endian, so integers are written as they are in memory
+    template<class T>
+    static void write_int(std::ostream& output, const T value)
+    {
+        output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template<class T>
+    static bool read_int(std::istream& input, T& value)
+    {
+        input.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return input.good();
+    }
+
+    /// <summary>
+    /// Whether the path stays inside the directory it is extracted to; archives are downloaded from shared caches
+    /// </summary>
+    static bool is_safe_relative_path(const std::string& path)
+    {
+        if (path.empty() || path.front() == '/' || path.find_first_of(":\\") != std::string::npos) return false;
+        for (auto&& component : Strings::split(path, "/"))
+        {
+            if (component.empty() || component == "." || component == "..") return false;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Reads the blocks of the files of an archive, one file after the other from the position of the input
+    /// </summary>
+    struct BlockReader
+    {
+        std::istream& input;
+        /// <summary>
+        /// Null if the archive is not compressed
+        /// </summary>
+        const CompressionApi* api;
+        void* decompressor;
+        std::vector<char> block = std::vector<char>(BLOCK_SIZE);
+        std::vector<char> stored = std::vector<char>(BLOCK_SIZE);
+
+        /// <summary>
+        /// Passes the contents of a file of the given size to consume, a block at a time; false if a block is corrupt
+        /// </summary>
+        template<class Consume>
+        bool read(const uint64_t file_size, Consume consume)
+        {
+            for (uint64_t remaining = file_size; remaining > 0;)
+            {
+                uint32_t stored_size;
+                uint32_t size;
+                if (!read_int(input, stored_size) || !read_int(input, size) || size == 0 || size > BLOCK_SIZE ||
+                    size > remaining || stored_size > size)
+                {
+                    return false;
+                }
+
+                input.read(stored.data(), stored_size);
+                if (!input) return false;
+
+                const char* data = stored.data();
+                if (stored_size != size)
+                {
+                    SIZE_T decompressed_size = 0;
+                    if (api == nullptr ||
+                        !api->decompress(
+                            decompressor, stored.data(), stored_size, block.data(), size, &decompressed_size) ||
+                        decompressed_size != size)
+                    {
+                        return false;
+                    }
+                    data = block.data();
+                }
+
+                consume(data, static_cast<size_t>(size));
+                remaining -= size;
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Moves past the contents of a file of the given size without decompressing them
+        /// </summary>
+        bool skip(const uint64_t file_size)
+        {
+            for (uint64_t remaining = file_size; remaining > 0;)
+            {
+                uint32_t stored_size;
+                uint32_t size;
+                if (!read_int(input, stored_size) || !read_int(input, size) || size == 0 || size > BLOCK_SIZE ||
+                    size > remaining || stored_size > size)
+                {
+                    return false;
+                }
+
+                input.seekg(stored_size, std::ios::cur);
+                if (!input) return false;
+                remaining -= size;
+            }
+            return true;
+        }
+    };
+
+    static ExpectedT<std::vector<Entry>, std::string> read_header(std::istream& input,
+                                                                  const fs::path& archive,
+                                                                  uint32_t& compression)
+    {
+        const std::string not_an_archive = Strings::format("%s is not a package archive", archive.u8string());
+        const std::string truncated = Strings::format("The package archive %s is truncated", archive.u8string());
+
+        char magic[MAGIC_SIZE];
+        input.read(magic, MAGIC_SIZE);
+        if (!input || std::memcmp(magic, MAGIC, MAGIC_SIZE) != 0) return not_an_archive;
+
+        uint32_t version;
+        uint32_t entry_count;
+        if (!read_int(input, version) || !read_int(input, compression) || !read_int(input, entry_count))
+        {
+            return truncated;
+        }
+        if (version != FORMAT_VERSION)
+        {
+            return Strings::format("The package archive %s has format version %d, which this vcpkg cannot read",
+                                   archive.u8string(),
+                                   static_cast<int>(version));
+        }
+        if (compression != STORED && compression != XPRESS_HUFF) return not_an_archive;
+
+        std::vector<Entry> entries;
+        for (uint32_t i = 0; i < entry_count; ++i)
+        {
+            uint32_t path_size;
+            if (!read_int(input, path_size)) return truncated;
+            if (path_size > MAX_PATH_SIZE) return not_an_archive;
+
+            Entry entry;
+            entry.path.resize(path_size);
+            input.read(&entry.path[0], path_size);
+
+            uint8_t is_directory;
+            char hash[HASH_SIZE];
+            if (!input || !read_int(input, is_directory) || !read_int(input, entry.size)) return truncated;
+            input.read(hash, HASH_SIZE);
+            if (!input) return truncated;
+
+            if (!is_safe_relative_path(entry.path) || is_directory > 1) return not_an_archive;
+            entry.is_directory = is_directory != 0;
+            if (!entry.is_directory) entry.sha256.assign(hash, HASH_SIZE);
+            entries.push_back(std::move(entry));
+        }
+        return std::move(entries);
+    }
+
+    /// <summary>
+    /// Writes the archive of the entries, whose contents are read from the sources
+    /// </summary>
+    static ExpectedT<std::vector<Entry>, std::string> write_archive(std::vector<Entry>&& entries,
+                                                                    const std::vector<fs::path>& sources,
+                                                                    const fs::path& archive)
+    {
+        const CompressionApi* const api = get_compression_api();
+        const CompressionHandle compressor(api ? api->create_compressor : nullptr,
+                                           api ? api->close_compressor : nullptr);
+        const bool compressed = compressor.handle != nullptr;
+
+        std::ofstream output(archive, std::ios::binary | std::ios::trunc);
+        output.write(MAGIC, MAGIC_SIZE);
+        write_int<uint32_t>(output, FORMAT_VERSION);
+        write_int<uint32_t>(output, compressed ? XPRESS_HUFF : STORED);
+        write_int<uint32_t>(output, static_cast<uint32_t>(entries.size()));
+
+        // The hashes are only known once the contents have been read, so they are filled in at the end
+        const std::string no_hash(HASH_SIZE, '\0');
+        std::vector<std::streamoff> hash_offsets;
+        for (auto&& entry : entries)
+        {
+            write_int<uint32_t>(output, static_cast<uint32_t>(entry.path.size()));
+            output.write(entry.path.data(), entry.path.size());
+            write_int<uint8_t>(output, entry.is_directory ? 1 : 0);
+            write_int<uint64_t>(output, entry.size);
+            hash_offsets.push_back(output.tellp());
+            output.write(no_hash.data(), HASH_SIZE);
+        }
+
+        std::vector<char> block(BLOCK_SIZE);
+        std::vector<char> stored(BLOCK_SIZE);
+        for (size_t i = 0; i < entries.size() && output; ++i)
+        {
+            Entry& entry = entries[i];
+            if (entry.is_directory) continue;
+
+            std::ifstream input(sources[i], std::ios::binary);
+            Commands::Hash::Hasher hasher("SHA256");
+            for (uint64_t remaining = entry.size; remaining > 0;)
+            {
+                const size_t size = static_cast<size_t>(std::min<uint64_t>(remaining, BLOCK_SIZE));
+                input.read(block.data(), size);
+                if (static_cast<size_t>(input.gcount()) != size)
+                {
+                    return Strings::format("Failed to archive %s: it changed while it was read", sources[i].u8string());
+                }
+                hasher.add(block.data(), size);
+
+                // A block which does not get smaller is stored as it is
+                SIZE_T stored_size = 0;
+                if (!compressed ||
+                    !api->compress(compressor.handle, block.data(), size, stored.data(), size, &stored_size) ||
+                    stored_size >= size)
+                {
+                    write_int<uint32_t>(output, static_cast<uint32_t>(size));
+                    write_int<uint32_t>(output, static_cast<uint32_t>(size));
+                    output.write(block.data(), size);
+                }
+                else
+                {
+                    write_int<uint32_t>(output, static_cast<uint32_t>(stored_size));
+                    write_int<uint32_t>(output, static_cast<uint32_t>(size));
+                    output.write(stored.data(), stored_size);
+                }
+                remaining -= size;
+            }
+            entry.sha256 = hasher.finish();
+        }
+
+        for (size_t i = 0; i < entries.size() && output; ++i)
+        {
+            if (entries[i].is_directory) continue;
+
+            output.seekp(hash_offsets[i]);
+            output.write(entries[i].sha256.data(), HASH_SIZE);
+        }
+
+        output.close();
+        if (!output) return Strings::format("Failed to write the package archive %s", archive.u8string());
+        return std::move(entries);
+    }
+
+    ExpectedT<std::vector<Entry>, std::string> create(Files::Filesystem& fs,
+                                                      const fs::path& dir,
+                                                      const fs::path& archive)
+    {
+        std::vector<Entry> entries;
+        std::vector<fs::path> sources;
+        const size_t prefix_length = dir.generic_u8string().size() + 1;
+        for (auto&& file : fs.get_entries_recursive(dir))
+        {
+            if (!fs::is_directory(file.status) && !fs::is_regular_file(file.status))
+            {
+                return Strings::format("Failed to archive %s: cannot handle file type", file.path.u8string());
+            }
+
+            Entry entry;
+            entry.path = file.path.generic_u8string().substr(prefix_length);
+            entry.is_directory = fs::is_directory(file.status);
+            entry.size = file.size;
+            entries.push_back(std::move(entry));
+            sources.push_back(file.path);
+        }
+
+        return write_archive(std::move(entries), sources, archive);
+    }
+
+    ExpectedT<std::vector<Entry>, std::string> create(Files::Filesystem& fs,
+                                                      const std::vector<fs::path>& files,
+                                                      const fs::path& archive)
+    {
+        std::vector<Entry> entries;
+        for (auto&& file : files)
+        {
+            std::error_code ec;
+            Entry entry;
+            entry.path = file.filename().u8string();
+            entry.is_directory = false;
+            entry.size = fs.file_size(file, ec);
+            if (ec) return Strings::format("Failed to archive %s: %s", file.u8string(), ec.message());
+            entries.push_back(std::move(entry));
+        }
+
+        return write_archive(std::move(entries), files, archive);
+    }
+
+    ExpectedT<std::vector<Entry>, std::string> read_table(const fs::path& archive)
+    {
+        std::ifstream input(archive, std::ios::binary);
+        if (!input) return Strings::format("Failed to open the package archive %s", archive.u8string());
+
+        uint32_t compression;
+        return read_header(input, archive, compression);
+    }
+
+    ExpectedT<std::vector<Entry>, std::string> extract(Files::Filesystem& fs,
+                                                       const fs::path& archive,
+                                                       const fs::path& dir)
+    {
+        std::ifstream input(archive, std::ios::binary);
+        if (!input) return Strings::format("Failed to open the package archive %s", archive.u8string());
+
+        uint32_t compression;
+        auto maybe_entries = read_header(input, archive, compression);
+        const auto entries = maybe_entries.get();
+        if (!entries) return maybe_entries;
+
+        const CompressionApi* const api = get_compression_api();
+        if (compression == XPRESS_HUFF && api == nullptr)
+        {
+            return Strings::format(
+                "The package archive %s is compressed, which needs Windows 8 or later to extract", archive.u8string());
+        }
+        const bool compressed = compression == XPRESS_HUFF;
+        const CompressionHandle decompressor(compressed ? api->create_decompressor : nullptr,
+                                             compressed ? api->close_decompressor : nullptr);
+        if (compressed && decompressor.handle == nullptr)
+        {
+            return Strings::format("Failed to create a decompressor for %s", archive.u8string());
+        }
+
+        const std::string corrupt = Strings::format("The package archive %s is corrupt", archive.u8string());
+        BlockReader reader{input, compressed ? api : nullptr, decompressor.handle};
+        std::error_code ec;
+        fs.create_directories(dir, ec);
+        if (ec) return Strings::format("Failed to create %s: %s", dir.u8string(), ec.message());
+
+        for (auto&& entry : *entries)
+        {
+            const fs::path target = dir / Strings::to_utf16(entry.path);
+            if (entry.is_directory)
+            {
+                fs.create_directory(target, ec);
+                if (ec) return Strings::format("Failed to create %s: %s", target.u8string(), ec.message());
+                continue;
+            }
+
+            std::ofstream output(target, std::ios::binary | std::ios::trunc);
+            if (!output) return Strings::format("Failed to create %s", target.u8string());
+
+            Commands::Hash::Hasher hasher("SHA256");
+            const bool is_complete = reader.read(entry.size, [&](const char* data, const size_t size) {
+                hasher.add(data, size);
+                output.write(data, size);
+            });
+            if (!is_complete) return corrupt;
+
+            output.close();
+            if (!output) return Strings::format("Failed to write %s", target.u8string());
+            if (hasher.finish() != entry.sha256) return corrupt;
+        }
+        return maybe_entries;
+    }
+
+    ExpectedT<std::string, std::string> read_file(const fs::path& archive, const std::string& path)
+    {
+        std::ifstream input(archive, std::ios::binary);
+        if (!input) return Strings::format("Failed to open the package archive %s", archive.u8string());
+
+        uint32_t compression;
+        auto maybe_entries = read_header(input, archive, compression);
+        const auto entries = maybe_entries.get();
+        if (!entries) return maybe_entries.error();
+
+        const CompressionApi* const api = get_compression_api();
+        if (compression == XPRESS_HUFF && api == nullptr)
+        {
+            return Strings::format(
+                "The package archive %s is compressed, which needs Windows 8 or later to read", archive.u8string());
+        }
+        const bool compressed = compression == XPRESS_HUFF;
+        const CompressionHandle decompressor(compressed ? api->create_decompressor : nullptr,
+                                             compressed ? api->close_decompressor : nullptr);
+        if (compressed && decompressor.handle == nullptr)
+        {
+            return Strings::format("Failed to create a decompressor for %s", archive.u8string());
+        }
+
+        const std::string corrupt = Strings::format("The package archive %s is corrupt", archive.u8string());
+        BlockReader reader{input, compressed ? api : nullptr, decompressor.handle};
+        for (auto&& entry : *entries)
+        {
+            if (entry.is_directory) continue;
+            if (entry.path != path)
+            {
+                if (!reader.skip(entry.size)) return corrupt;
+                continue;
+            }
+
+            std::string contents;
+            Commands::Hash::Hasher hasher("SHA256");
+            const bool is_complete = reader.read(entry.size, [&](const char* data, const size_t size) {
+                hasher.add(data, size);
+                contents.append(data, size);
+            });
+            if (!is_complete || hasher.finish() != entry.sha256) return corrupt;
+            return std::move(contents);
+        }
+
+        return Strings::format("The package archive %s has no file %s", archive.u8string(), path);
+    }
+}
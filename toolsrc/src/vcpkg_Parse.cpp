@@ -1,45 +1,123 @@
 #include "pch.h"
 
 #include "vcpkg_Checks.h"
-#include "vcpkg_Maps.h"
 #include "vcpkg_Parse.h"
+#include "vcpkg_Util.h"
 
 namespace vcpkg::Parse
 {
-    static Optional<std::string> remove_field(std::unordered_map<std::string, std::string>* fields,
-                                              const std::string& fieldname)
+    std::string normalize_field_value(const std::string_view raw_value)
     {
-        auto it = fields->find(fieldname);
-        if (it == fields->end())
+        // Continuation lines may end in "\r\n", "\n" or a lone "\r"; each becomes a single '\n'
+        std::string value;
+        value.reserve(raw_value.size());
+        for (size_t i = 0; i < raw_value.size(); ++i)
+        {
+            if (raw_value[i] != '\r')
+            {
+                value.push_back(raw_value[i]);
+                continue;
+            }
+
+            if (i + 1 < raw_value.size() && raw_value[i + 1] == '\n') ++i;
+            value.push_back('\n');
+        }
+        return value;
+    }
+
+    ParagraphView to_paragraph_view(const RawParagraph& fields)
+    {
+        ParagraphView view;
+        view.fields.reserve(fields.size());
+        for (auto&& field : fields)
+        {
+            view.fields.push_back({field.first, field.second});
+        }
+        return view;
+    }
+
+    RawParagraph to_raw_paragraph(const ParagraphView& view)
+    {
+        RawParagraph fields;
+        fields.reserve(view.fields.size());
+        for (auto&& field : view.fields)
+        {
+            fields.emplace(std::string(field.name), normalize_field_value(field.value));
+        }
+        return fields;
+    }
+
+    ParagraphParser::ParagraphParser(const ParagraphView& view, const FieldTable& table) : table(&table)
+    {
+        for (auto&& field : view.fields)
+        {
+            const size_t slot = table.find(field.name);
+
+            // A field which is given twice stays behind, so that it is reported
+            if (slot != FieldTable::NOT_FOUND && slots[slot] == nullptr)
+                slots[slot] = &field;
+            else
+                fields.push_back(field);
+        }
+    }
+
+    Optional<std::string> ParagraphParser::remove_field(const std::string_view fieldname)
+    {
+        if (table)
+        {
+            const size_t slot = table->find(fieldname);
+            if (slot != FieldTable::NOT_FOUND)
+            {
+                const ParagraphView::Field* const field = slots[slot];
+                if (!field) return nullopt;
+                slots[slot] = nullptr;
+                return normalize_field_value(field->value);
+            }
+        }
+
+        auto it = std::find_if(
+            fields.begin(), fields.end(), [&](const ParagraphView::Field& field) { return field.name == fieldname; });
+        if (it == fields.end())
         {
             return nullopt;
         }
 
-        const std::string value = std::move(it->second);
-        fields->erase(it);
-        return value;
+        std::string value = normalize_field_value(it->value);
+        fields.erase(it);
+        return std::move(value);
     }
 
-    void ParagraphParser::required_field(const std::string& fieldname, std::string& out)
+    void ParagraphParser::required_field(const std::string_view fieldname, std::string& out)
     {
-        auto maybe_field = remove_field(&fields, fieldname);
+        auto maybe_field = remove_field(fieldname);
         if (const auto field = maybe_field.get())
             out = std::move(*field);
         else
-            missing_fields.push_back(fieldname);
+            missing_fields.emplace_back(fieldname);
     }
-    std::string ParagraphParser::optional_field(const std::string& fieldname) const
+    std::string ParagraphParser::optional_field(const std::string_view fieldname)
     {
-        return remove_field(&fields, fieldname).value_or(Strings::EMPTY);
+        return remove_field(fieldname).value_or(Strings::EMPTY);
     }
     std::unique_ptr<ParseControlErrorInfo> ParagraphParser::error_info(const std::string& name) const
     {
-        if (!fields.empty() || !missing_fields.empty())
+        // The fields of the table which were not asked for are as unexpected as the ones it does not have
+        std::vector<std::string> extra_fields;
+        for (auto&& field : slots)
+        {
+            if (field) extra_fields.emplace_back(field->name);
+        }
+        for (auto&& field : fields)
+        {
+            extra_fields.emplace_back(field.name);
+        }
+
+        if (!extra_fields.empty() || !missing_fields.empty())
         {
             auto err = std::make_unique<ParseControlErrorInfo>();
             err->name = name;
-            err->extra_fields = Maps::extract_keys(fields);
-            err->missing_fields = std::move(missing_fields);
+            err->extra_fields = std::move(extra_fields);
+            err->missing_fields = missing_fields;
             return err;
         }
         return nullptr;
@@ -53,6 +131,7 @@ namespace vcpkg::Parse
         }
 
         std::vector<std::string> out;
+        out.reserve(std::count(str.cbegin(), str.cend(), ',') + 1);
 
         size_t cur = 0;
         do
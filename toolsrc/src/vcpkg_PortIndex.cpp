@@ -0,0 +1,314 @@
+#include "pch.h"
+
+#include "vcpkg_Checks.h"
+#include "vcpkg_PortIndex.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_Util.h"
+
+namespace vcpkg::PortIndex
+{
+    static constexpr char MAGIC[8] = {'V', 'C', 'P', 'K', 'G', 'I', 'D', 'X'};
+
+    // Bump whenever the layout of the index changes; an index of another version is discarded and rebuilt.
+    // Version 1 was a text file of paragraphs.
+    static constexpr uint32_t VERSION = 2;
+
+    static constexpr size_t WORD_SIZE = 4;
+    static constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 6 * WORD_SIZE;
+    static constexpr size_t STRING_REF_SIZE = 2 * WORD_SIZE;
+    static constexpr size_t PORT_RECORD_SIZE = 2 * STRING_REF_SIZE + 2 * WORD_SIZE;
+    static constexpr size_t PARAGRAPH_RECORD_SIZE = 2 * WORD_SIZE;
+    static constexpr size_t FIELD_RECORD_SIZE = 2 * STRING_REF_SIZE;
+
+    // The average number of names per bucket; the largest buckets are placed first, while most slots are free
+    static constexpr uint32_t NAMES_PER_BUCKET = 4;
+    static constexpr uint32_t MAX_SEED = 1 << 20;
+
+    static uint32_t hash(const std::string_view name, const uint32_t seed)
+    {
+        // FNV-1a, finished like MurmurHash3 so that each seed gives an independent hash
+        uint32_t h = 2166136261u ^ seed;
+        for (const char c : name)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 16777619u;
+        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    static void append_u32(std::string& out, const uint32_t value)
+    {
+        out.push_back(static_cast<char>(value & 0xff));
+        out.push_back(static_cast<char>((value >> 8) & 0xff));
+        out.push_back(static_cast<char>((value >> 16) & 0xff));
+        out.push_back(static_cast<char>((value >> 24) & 0xff));
+    }
+
+    static uint32_t read_u32(const char* p)
+    {
+        const auto bytes = reinterpret_cast<const unsigned char*>(p);
+        return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+               static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+    }
+
+    fs::path get_index_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "port_index"; }
+
+    std::string get_control_file_stamp(const Files::Filesystem& fs, const fs::path& control_path)
+    {
+        std::error_code ec;
+        const std::uintmax_t size = fs.file_size(control_path, ec);
+        if (ec) return Strings::EMPTY;
+
+        const fs::file_time_type time = fs.last_write_time(control_path, ec);
+        if (ec) return Strings::EMPTY;
+
+        return std::to_string(size) + ':' + std::to_string(time.time_since_epoch().count());
+    }
+
+    /// <summary>
+    /// Hash and displace: the names are put in buckets by one hash, and each bucket gets the first seed for which the
+    /// hash of all its names falls in free slots. There are as many slots as names, so the hash is minimal.
+    /// </summary>
+    static void build_perfect_hash(const std::vector<std::string_view>& names,
+                                   std::vector<uint32_t>& seeds,
+                                   std::vector<uint32_t>& slots)
+    {
+        const uint32_t port_count = static_cast<uint32_t>(names.size());
+        const uint32_t bucket_count = port_count / NAMES_PER_BUCKET + 1;
+
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (uint32_t port = 0; port < port_count; ++port)
+        {
+            buckets[hash(names[port], 0) % bucket_count].push_back(port);
+        }
+
+        std::vector<uint32_t> order(bucket_count);
+        for (uint32_t bucket = 0; bucket < bucket_count; ++bucket)
+            order[bucket] = bucket;
+        std::stable_sort(order.begin(), order.end(), [&](const uint32_t left, const uint32_t right) {
+            return buckets[left].size() > buckets[right].size();
+        });
+
+        seeds.assign(bucket_count, 0);
+        slots.assign(port_count, 0);
+        std::vector<bool> is_taken(port_count);
+        std::vector<uint32_t> candidates;
+        for (const uint32_t bucket : order)
+        {
+            if (buckets[bucket].empty()) break;
+
+            uint32_t seed = 1;
+            for (;; ++seed)
+            {
+                // Unique names are found in free slots by some seed long before this
+                Checks::check_exit(VCPKG_LINE_INFO, seed < MAX_SEED, "Failed to hash the names of the ports");
+
+                candidates.clear();
+                for (const uint32_t port : buckets[bucket])
+                {
+                    const uint32_t slot = hash(names[port], seed) % port_count;
+                    if (is_taken[slot] || Util::find(candidates, slot) != candidates.cend()) break;
+                    candidates.push_back(slot);
+                }
+                if (candidates.size() == buckets[bucket].size()) break;
+            }
+
+            seeds[bucket] = seed;
+            for (size_t i = 0; i < candidates.size(); ++i)
+            {
+                is_taken[candidates[i]] = true;
+                slots[candidates[i]] = buckets[bucket][i];
+            }
+        }
+    }
+
+    Optional<std::string> serialize(const std::vector<PortEntry>& ports)
+    {
+        const std::vector<std::string_view> names =
+            Util::fmap(ports, [](const PortEntry& port) { return std::string_view(port.name); });
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           std::unordered_set<std::string_view>(names.cbegin(), names.cend()).size() == names.size(),
+                           "The names in the port index must be unique");
+
+        std::vector<uint32_t> seeds;
+        std::vector<uint32_t> slots;
+        build_perfect_hash(names, seeds, slots);
+
+        // Names of fields recur in every port, so each distinct string is pooled once
+        std::string strings;
+        std::unordered_map<std::string_view, uint32_t> pooled;
+        const auto append_string = [&](std::string& out, const std::string_view s) {
+            auto it = pooled.find(s);
+            if (it == pooled.end())
+            {
+                it = pooled.emplace(s, static_cast<uint32_t>(strings.size())).first;
+                strings.append(s.data(), s.size());
+            }
+            append_u32(out, it->second);
+            append_u32(out, static_cast<uint32_t>(s.size()));
+        };
+
+        std::string port_records;
+        std::string paragraph_records;
+        std::string field_records;
+        uint32_t paragraph_count = 0;
+        uint32_t field_count = 0;
+        for (auto&& port : ports)
+        {
+            const std::vector<Parse::ParagraphView>& pghs = port.paragraphs.paragraphs;
+            append_string(port_records, port.name);
+            append_string(port_records, port.stamp);
+            append_u32(port_records, paragraph_count);
+            append_u32(port_records, static_cast<uint32_t>(pghs.size()));
+            paragraph_count += static_cast<uint32_t>(pghs.size());
+
+            for (auto&& pgh : pghs)
+            {
+                append_u32(paragraph_records, field_count);
+                append_u32(paragraph_records, static_cast<uint32_t>(pgh.fields.size()));
+                field_count += static_cast<uint32_t>(pgh.fields.size());
+
+                for (auto&& field : pgh.fields)
+                {
+                    append_string(field_records, field.name);
+                    append_string(field_records, field.value);
+                }
+            }
+
+            if (strings.size() > UINT32_MAX) return nullopt;
+        }
+
+        std::string bytes(MAGIC, sizeof(MAGIC));
+        append_u32(bytes, VERSION);
+        append_u32(bytes, static_cast<uint32_t>(ports.size()));
+        append_u32(bytes, static_cast<uint32_t>(seeds.size()));
+        append_u32(bytes, paragraph_count);
+        append_u32(bytes, field_count);
+        append_u32(bytes, static_cast<uint32_t>(strings.size()));
+        for (const uint32_t seed : seeds)
+            append_u32(bytes, seed);
+        for (const uint32_t slot : slots)
+            append_u32(bytes, slot);
+        bytes += port_records;
+        bytes += paragraph_records;
+        bytes += field_records;
+        bytes += strings;
+        if (bytes.size() > UINT32_MAX) return nullopt;
+        return std::move(bytes);
+    }
+
+    void write(Files::Filesystem& fs, const fs::path& index_path, const std::string& bytes)
+    {
+        std::error_code ec;
+        fs.create_directories(index_path.parent_path(), ec);
+
+        fs::path tmp_path = index_path;
+        tmp_path += ".tmp";
+        fs.write_contents(tmp_path, bytes);
+        fs.rename(tmp_path, index_path, ec);
+        if (ec)
+        {
+            fs.remove(tmp_path, ec);
+        }
+    }
+
+    Table Table::load(const Files::Filesystem& fs, const fs::path& index_path)
+    {
+        Expected<Files::MappedFile> maybe_file = fs.map_contents(index_path);
+        if (const auto file = maybe_file.get())
+        {
+            return from_file(std::move(*file));
+        }
+        return Table();
+    }
+
+    Table Table::from_file(Files::MappedFile file)
+    {
+        if (file.size < HEADER_SIZE || !std::equal(MAGIC, MAGIC + sizeof(MAGIC), file.data.get())) return Table();
+
+        const char* header = file.data.get() + sizeof(MAGIC);
+        if (read_u32(header) != VERSION) return Table();
+
+        Table table;
+        table.m_port_count = read_u32(header + WORD_SIZE);
+        table.m_bucket_count = read_u32(header + 2 * WORD_SIZE);
+        table.m_paragraph_count = read_u32(header + 3 * WORD_SIZE);
+        table.m_field_count = read_u32(header + 4 * WORD_SIZE);
+        table.m_strings_size = read_u32(header + 5 * WORD_SIZE);
+        if (table.m_port_count != 0 && table.m_bucket_count == 0) return Table();
+
+        // The counts are below 2^32, so none of the offsets overflows 64 bits
+        const uint64_t slots = HEADER_SIZE + uint64_t(table.m_bucket_count) * WORD_SIZE;
+        const uint64_t ports = slots + uint64_t(table.m_port_count) * WORD_SIZE;
+        const uint64_t paragraphs = ports + uint64_t(table.m_port_count) * PORT_RECORD_SIZE;
+        const uint64_t fields = paragraphs + uint64_t(table.m_paragraph_count) * PARAGRAPH_RECORD_SIZE;
+        const uint64_t strings = fields + uint64_t(table.m_field_count) * FIELD_RECORD_SIZE;
+        if (strings + table.m_strings_size != file.size) return Table();
+
+        table.m_seeds = HEADER_SIZE;
+        table.m_slots = static_cast<size_t>(slots);
+        table.m_ports = static_cast<size_t>(ports);
+        table.m_paragraphs = static_cast<size_t>(paragraphs);
+        table.m_fields = static_cast<size_t>(fields);
+        table.m_strings = static_cast<size_t>(strings);
+        table.m_file = std::move(file);
+        return table;
+    }
+
+    bool Table::string_at(const char* ref, std::string_view& out) const
+    {
+        const uint32_t offset = read_u32(ref);
+        const uint32_t size = read_u32(ref + WORD_SIZE);
+        if (uint64_t(offset) + size > m_strings_size) return false;
+
+        out = std::string_view(at(m_strings + offset), size);
+        return true;
+    }
+
+    Optional<Table::Entry> Table::find(const std::string_view name) const
+    {
+        if (m_port_count == 0) return nullopt;
+
+        // Every name hashes to some port, so the name of the record tells whether it is the one asked for
+        const uint32_t seed = read_u32(at(m_seeds + size_t(hash(name, 0) % m_bucket_count) * WORD_SIZE));
+        const uint32_t port = read_u32(at(m_slots + size_t(hash(name, seed) % m_port_count) * WORD_SIZE));
+        if (port >= m_port_count) return nullopt;
+
+        const char* record = at(m_ports + size_t(port) * PORT_RECORD_SIZE);
+        std::string_view port_name;
+        if (!string_at(record, port_name) || port_name != name) return nullopt;
+
+        Entry entry;
+        if (!string_at(record + STRING_REF_SIZE, entry.stamp)) return nullopt;
+
+        const uint32_t first_paragraph = read_u32(record + 2 * STRING_REF_SIZE);
+        const uint32_t paragraph_count = read_u32(record + 2 * STRING_REF_SIZE + WORD_SIZE);
+        if (paragraph_count == 0 || uint64_t(first_paragraph) + paragraph_count > m_paragraph_count) return nullopt;
+
+        entry.paragraphs.buffer = m_file.data;
+        entry.paragraphs.paragraphs.resize(paragraph_count);
+        for (uint32_t i = 0; i < paragraph_count; ++i)
+        {
+            const char* paragraph = at(m_paragraphs + size_t(first_paragraph + i) * PARAGRAPH_RECORD_SIZE);
+            const uint32_t first_field = read_u32(paragraph);
+            const uint32_t field_count = read_u32(paragraph + WORD_SIZE);
+            if (uint64_t(first_field) + field_count > m_field_count) return nullopt;
+
+            std::vector<Parse::ParagraphView::Field>& fields = entry.paragraphs.paragraphs[i].fields;
+            fields.resize(field_count);
+            for (uint32_t j = 0; j < field_count; ++j)
+            {
+                const char* field = at(m_fields + size_t(first_field + j) * FIELD_RECORD_SIZE);
+                if (!string_at(field, fields[j].name) || !string_at(field + STRING_REF_SIZE, fields[j].value))
+                    return nullopt;
+            }
+        }
+
+        return std::move(entry);
+    }
+}
@@ -0,0 +1,94 @@
+#include "pch.h"
+
+#include "vcpkg_Checks.h"
+#include "vcpkg_RecordWriter.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+
+namespace vcpkg
+{
+    static constexpr size_t FLUSH_SIZE = 64 * 1024;
+
+    Optional<RecordWriter::Format> RecordWriter::get_format(const ParsedArguments& parsed_arguments)
+    {
+        const auto it = parsed_arguments.settings.find(OPTION_FORMAT);
+        if (it == parsed_arguments.settings.cend()) return nullopt;
+
+        if (it->second == "json") return Format::JSON;
+        if (it->second == "tsv") return Format::TSV;
+        Checks::exit_with_message(
+            VCPKG_LINE_INFO, "Error: %s must be json or tsv, but was '%s'", OPTION_FORMAT, it->second);
+    }
+
+    static void append_tsv_value(std::string& output, const CStringView value)
+    {
+        for (const char* p = value.c_str(); *p != '\0'; ++p)
+        {
+            output.push_back(*p == '\t' || *p == '\r' || *p == '\n' ? ' ' : *p);
+        }
+    }
+
+    RecordWriter::RecordWriter(const Format format, std::vector<std::string> columns)
+        : m_format(format), m_columns(std::move(columns))
+    {
+        m_buffer.reserve(FLUSH_SIZE + 4096);
+        if (m_format == Format::JSON)
+        {
+            m_buffer.append("[");
+            return;
+        }
+
+        for (size_t i = 0; i < m_columns.size(); ++i)
+        {
+            if (i != 0) m_buffer.push_back('\t');
+            append_tsv_value(m_buffer, m_columns[i]);
+        }
+        m_buffer.push_back('\n');
+    }
+
+    void RecordWriter::write(std::initializer_list<CStringView> values)
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, values.size() == m_columns.size());
+
+        size_t i = 0;
+        if (m_format == Format::JSON)
+        {
+            m_buffer.append(m_record_count == 0 ? "\n  {" : ",\n  {");
+            for (const CStringView value : values)
+            {
+                if (i != 0) m_buffer.push_back(',');
+                Strings::append_json_string(m_buffer, m_columns[i++]);
+                m_buffer.push_back(':');
+                Strings::append_json_string(m_buffer, value);
+            }
+            m_buffer.push_back('}');
+        }
+        else
+        {
+            for (const CStringView value : values)
+            {
+                if (i++ != 0) m_buffer.push_back('\t');
+                append_tsv_value(m_buffer, value);
+            }
+            m_buffer.push_back('\n');
+        }
+
+        ++m_record_count;
+        flush_if_full();
+    }
+
+    void RecordWriter::flush_if_full()
+    {
+        if (m_buffer.size() < FLUSH_SIZE) return;
+
+        System::print(m_buffer);
+        m_buffer.clear();
+    }
+
+    void RecordWriter::finish()
+    {
+        if (m_format == Format::JSON) m_buffer.append(m_record_count == 0 ? "]\n" : "\n]\n");
+        System::print(m_buffer);
+        m_buffer.clear();
+    }
+}
@@ -4,6 +4,14 @@
 #include "vcpkg_Strings.h"
 #include "vcpkg_Util.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VCPKG_STRINGS_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 namespace vcpkg::Strings::details
 {
     // To disambiguate between two overloads
@@ -20,52 +28,57 @@ namespace vcpkg::Strings::details
     }
 #endif
 
-    std::string format_internal(const char* fmtstr, ...)
+    void append_format_internal(std::string& output, const char* fmtstr, ...)
     {
         va_list args;
         va_start(args, fmtstr);
+        va_list measured_args;
+        va_copy(measured_args, args);
 
 #if defined(_WIN32)
-        const int sz = _vscprintf_l(fmtstr, c_locale(), args);
+        const int sz = _vscprintf_l(fmtstr, c_locale(), measured_args);
 #else
-        const int sz = vsnprintf(nullptr, 0, fmtstr, args);
+        const int sz = vsnprintf(nullptr, 0, fmtstr, measured_args);
 #endif
-        Checks::check_exit(VCPKG_LINE_INFO, sz > 0);
+        va_end(measured_args);
+        Checks::check_exit(VCPKG_LINE_INFO, sz >= 0);
 
-        std::string output(sz, '\0');
+        // Formats over the terminator which the resized string keeps after its new end
+        const size_t start = output.size();
+        output.resize(start + sz);
 
 #if defined(_WIN32)
-        _vsnprintf_s_l(&output.at(0), output.size() + 1, output.size(), fmtstr, c_locale(), args);
+        _vsnprintf_s_l(&output[start], static_cast<size_t>(sz) + 1, sz, fmtstr, c_locale(), args);
 #else
-        vsnprintf(&output.at(0), output.size() + 1, fmtstr, args);
+        vsnprintf(&output[start], static_cast<size_t>(sz) + 1, fmtstr, args);
 #endif
         va_end(args);
-
-        return output;
     }
 
-    std::wstring wformat_internal(const wchar_t* fmtstr, ...)
+    void append_wformat_internal(std::wstring& output, const wchar_t* fmtstr, ...)
     {
         va_list args;
         va_start(args, fmtstr);
+        va_list measured_args;
+        va_copy(measured_args, args);
 
 #if defined(_WIN32)
-        const int sz = _vscwprintf_l(fmtstr, c_locale(), args);
+        const int sz = _vscwprintf_l(fmtstr, c_locale(), measured_args);
 #else
-        const int sz = vswprintf(nullptr, 0, fmtstr, args);
+        const int sz = vswprintf(nullptr, 0, fmtstr, measured_args);
 #endif
-        Checks::check_exit(VCPKG_LINE_INFO, sz > 0);
+        va_end(measured_args);
+        Checks::check_exit(VCPKG_LINE_INFO, sz >= 0);
 
-        std::wstring output(sz, L'\0');
+        const size_t start = output.size();
+        output.resize(start + sz);
 
 #if defined(_WIN32)
-        _vsnwprintf_s_l(&output.at(0), output.size() + 1, output.size(), fmtstr, c_locale(), args);
+        _vsnwprintf_s_l(&output[start], static_cast<size_t>(sz) + 1, sz, fmtstr, c_locale(), args);
 #else
-        vswprintf(&output.at(0), output.size() + 1, fmtstr, args);
+        vswprintf(&output[start], static_cast<size_t>(sz) + 1, fmtstr, args);
 #endif
         va_end(args);
-
-        return output;
     }
 }
 
@@ -83,14 +96,76 @@ namespace vcpkg::Strings
         return conversion.to_bytes(w);
     }
 
+    static char ascii_tolower(const char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+    CaseInsensitiveAsciiSearcher::CaseInsensitiveAsciiSearcher(const std::string& pattern)
+        : m_lowercase_pattern(pattern)
+    {
+        std::transform(
+            m_lowercase_pattern.begin(), m_lowercase_pattern.end(), m_lowercase_pattern.begin(), &ascii_tolower);
+    }
+
+    bool CaseInsensitiveAsciiSearcher::matches_at(const char* s) const
+    {
+        for (size_t i = 0; i < m_lowercase_pattern.size(); ++i)
+        {
+            if (ascii_tolower(s[i]) != m_lowercase_pattern[i]) return false;
+        }
+        return true;
+    }
+
+#if defined(VCPKG_STRINGS_SSE2)
+    static unsigned long lowest_set_bit(const unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<unsigned long>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+
+    size_t CaseInsensitiveAsciiSearcher::find(const char* s, const size_t size) const
+    {
+        const size_t pattern_size = m_lowercase_pattern.size();
+        if (pattern_size == 0) return 0;
+        if (size < pattern_size) return std::string::npos;
+
+        size_t i = 0;
+#if defined(VCPKG_STRINGS_SSE2)
+        // Setting 0x20 turns the uppercase ASCII letters into lowercase ones. It also merges some pairs of other
+        // characters, but those candidates are only a filter and every one of them is compared in full.
+        const __m128i case_bit = _mm_set1_epi8(0x20);
+        const __m128i first = _mm_set1_epi8(static_cast<char>(m_lowercase_pattern.front() | 0x20));
+        const __m128i last = _mm_set1_epi8(static_cast<char>(m_lowercase_pattern.back() | 0x20));
+        for (; i + pattern_size - 1 + 16 <= size; i += 16)
+        {
+            const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + pattern_size - 1));
+            const __m128i matches = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(block_first, case_bit), first),
+                                                  _mm_cmpeq_epi8(_mm_or_si128(block_last, case_bit), last));
+            for (unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(matches)); mask != 0;
+                 mask &= mask - 1)
+            {
+                const size_t candidate = i + lowest_set_bit(mask);
+                if (matches_at(s + candidate)) return candidate;
+            }
+        }
+#endif
+
+        for (; i + pattern_size <= size; ++i)
+        {
+            if (matches_at(s + i)) return i;
+        }
+        return std::string::npos;
+    }
+
     std::string::const_iterator case_insensitive_ascii_find(const std::string& s, const std::string& pattern)
     {
-        const std::string pattern_as_lower_case(ascii_to_lowercase(pattern));
-        return search(s.begin(),
-                      s.end(),
-                      pattern_as_lower_case.begin(),
-                      pattern_as_lower_case.end(),
-                      [](const char a, const char b) { return details::tolower_char(a) == b; });
+        const size_t position = CaseInsensitiveAsciiSearcher(pattern).find(s);
+        return position == std::string::npos ? s.end() : s.begin() + position;
     }
 
     bool case_insensitive_ascii_contains(const std::string& s, const std::string& pattern)
@@ -110,6 +185,45 @@ namespace vcpkg::Strings
         return output;
     }
 
+    std::string to_json_string(const std::string& s)
+    {
+        std::string encoded;
+        encoded.reserve(s.size() + 2);
+        append_json_string(encoded, s);
+        return encoded;
+    }
+
+    void append_json_string(std::string& output, const CStringView s)
+    {
+        output.push_back('"');
+        for (const char* p = s.c_str(); *p != '\0'; ++p)
+        {
+            const unsigned char ch = static_cast<unsigned char>(*p);
+            if (ch == '\\')
+            {
+                output.append("\\\\");
+            }
+            else if (ch == '"')
+            {
+                output.append("\\\"");
+            }
+            else if (ch < 0x20 || ch >= 0x80)
+            {
+                // Note: this treats incoming Strings as Latin-1
+                static constexpr const char HEX[16] = {
+                    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+                output.append("\\u00");
+                output.push_back(HEX[ch / 16]);
+                output.push_back(HEX[ch % 16]);
+            }
+            else
+            {
+                output.push_back(ch);
+            }
+        }
+        output.push_back('"');
+    }
+
     void trim(std::string* s)
     {
         s->erase(std::find_if_not(s->rbegin(), s->rend(), details::isspace).base(), s->end());
@@ -133,6 +247,41 @@ namespace vcpkg::Strings
         Util::erase_remove_if(*strings, [](const std::string& s) { return s.empty(); });
     }
 
+    std::string collapse_whitespace(const std::string& s)
+    {
+        std::string output;
+        output.reserve(s.size());
+
+        bool in_whitespace = false;
+        for (const char c : s)
+        {
+            if (std::isspace(static_cast<unsigned char>(c)))
+            {
+                if (!in_whitespace) output.push_back(' ');
+                in_whitespace = true;
+            }
+            else
+            {
+                output.push_back(c);
+                in_whitespace = false;
+            }
+        }
+
+        return output;
+    }
+
+    std::string replace_all(std::string&& s, const std::string& search, const std::string& rep)
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, !search.empty());
+
+        for (size_t pos = s.find(search); pos != std::string::npos; pos = s.find(search, pos + rep.size()))
+        {
+            s.replace(pos, search.size(), rep);
+        }
+
+        return std::move(s);
+    }
+
     std::vector<std::string> split(const std::string& s, const std::string& delimiter)
     {
         std::vector<std::string> output;
@@ -1,8 +1,10 @@
 #include "pch.h"
 
+#include "metrics.h"
 #include "vcpkg_Checks.h"
 #include "vcpkg_GlobalState.h"
 #include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
 #include "vcpkglib.h"
 
 namespace vcpkg::System
@@ -43,6 +45,46 @@ namespace vcpkg::System
         return to_cpu_architecture(Strings::to_utf8(procarch)).value_or_exit(VCPKG_LINE_INFO);
     }
 
+    size_t get_physical_memory_mib()
+    {
+        MEMORYSTATUSEX status{};
+        status.dwLength = sizeof(status);
+        if (!GlobalMemoryStatusEx(&status)) return 0;
+        return static_cast<size_t>(status.ullTotalPhys / (1024 * 1024));
+    }
+
+    static size_t count_cores(uint64_t mask)
+    {
+        size_t count = 0;
+        for (; mask != 0; mask &= mask - 1)
+            ++count;
+        return count;
+    }
+
+    uint64_t get_background_affinity(const uint64_t mask, const size_t free_cores)
+    {
+        // A job's affinity only spans the processor group, whose width is that of a pointer
+        const size_t max_cores = std::min<size_t>(std::thread::hardware_concurrency(), sizeof(ULONG_PTR) * 8);
+        const uint64_t all_cores = max_cores == 64 ? ~uint64_t() : (uint64_t(1) << std::max<size_t>(1, max_cores)) - 1;
+
+        uint64_t affinity = mask == 0 ? all_cores : mask & all_cores;
+        if (affinity == 0) affinity = all_cores;
+        for (size_t i = 0; i < free_cores && count_cores(affinity) > 1; ++i)
+        {
+            uint64_t highest = uint64_t(1) << 63;
+            while ((affinity & highest) == 0)
+                highest >>= 1;
+            affinity &= ~highest;
+        }
+        return affinity;
+    }
+
+    size_t get_build_core_count()
+    {
+        if (GlobalState::background) return count_cores(GlobalState::background_affinity);
+        return std::thread::hardware_concurrency();
+    }
+
     std::vector<CPUArchitecture> get_supported_host_architectures()
     {
         std::vector<CPUArchitecture> supported_architectures;
@@ -57,7 +99,7 @@ namespace vcpkg::System
         return supported_architectures;
     }
 
-    int cmd_execute_clean(const CWStringView cmd_line)
+    std::wstring get_clean_environment()
     {
         static const std::wstring SYSTEM_ROOT = get_environment_variable(L"SystemRoot").value_or_exit(VCPKG_LINE_INFO);
         static const std::wstring SYSTEM_32 = SYSTEM_ROOT + LR"(\system32)";
@@ -108,9 +150,6 @@ namespace vcpkg::System
             L"CUDA_PATH",
         };
 
-        // Flush stdout before launching external process
-        fflush(nullptr);
-
         std::wstring env_cstr;
 
         for (auto&& env_wstring : env_wstrings)
@@ -128,93 +167,601 @@ namespace vcpkg::System
         env_cstr.append(NEW_PATH);
         env_cstr.push_back(L'\0');
 
+        return env_cstr;
+    }
+
+    std::string to_string(const ResourceUsage& usage)
+    {
+        const auto to_mib = [](const uint64_t bytes) { return static_cast<long long>(bytes >> 20); };
+        return Strings::format("cpu %.1f s, peak memory %lld MiB, read %lld MiB, written %lld MiB, %d processes",
+                               usage.cpu_microseconds / 1000000,
+                               to_mib(usage.peak_memory_bytes),
+                               to_mib(usage.read_bytes),
+                               to_mib(usage.write_bytes),
+                               static_cast<int>(usage.process_count));
+    }
+
+    Expected<JobObject> JobObject::create()
+    {
+        JobObject job;
+        job.m_job = CreateJobObjectW(nullptr, nullptr);
+        if (job.m_job == nullptr) return std::error_code(GetLastError(), std::system_category());
+        return std::move(job);
+    }
+
+    JobObject::JobObject(JobObject&& other) noexcept : m_job(other.m_job) { other.m_job = nullptr; }
+
+    JobObject& JobObject::operator=(JobObject&& other) noexcept
+    {
+        std::swap(m_job, other.m_job);
+        return *this;
+    }
+
+    JobObject::~JobObject()
+    {
+        if (m_job != nullptr) CloseHandle(m_job);
+    }
+
+    ResourceUsage JobObject::query() const
+    {
+        ResourceUsage usage;
+        if (m_job == nullptr) return usage;
+
+        JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting{};
+        if (QueryInformationJobObject(
+                m_job, JobObjectBasicAndIoAccountingInformation, &accounting, sizeof(accounting), nullptr))
+        {
+            // The times are in units of 100 ns
+            const LONGLONG cpu_time =
+                accounting.BasicInfo.TotalUserTime.QuadPart + accounting.BasicInfo.TotalKernelTime.QuadPart;
+            usage.cpu_microseconds = static_cast<double>(cpu_time) / 10;
+            usage.read_bytes = accounting.IoInfo.ReadTransferCount;
+            usage.write_bytes = accounting.IoInfo.WriteTransferCount;
+            usage.process_count = accounting.BasicInfo.TotalProcesses;
+        }
+
+        // The peak is tracked whether or not the job has a memory limit
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+        if (QueryInformationJobObject(m_job, JobObjectExtendedLimitInformation, &limits, sizeof(limits), nullptr))
+        {
+            usage.peak_memory_bytes = limits.PeakJobMemoryUsed;
+        }
+        return usage;
+    }
+
+    bool JobObject::set_background(const uint64_t affinity_mask)
+    {
+        if (m_job == nullptr) return false;
+
+        JOBOBJECT_BASIC_LIMIT_INFORMATION limits{};
+        limits.LimitFlags = JOB_OBJECT_LIMIT_PRIORITY_CLASS | JOB_OBJECT_LIMIT_AFFINITY;
+        limits.PriorityClass = IDLE_PRIORITY_CLASS;
+        limits.Affinity = static_cast<ULONG_PTR>(affinity_mask);
+        return TRUE == SetInformationJobObject(m_job, JobObjectBasicLimitInformation, &limits, sizeof(limits));
+    }
+
+    Expected<Process> Process::start(const CWStringView cmd_line,
+                                     const std::wstring& environment_block,
+                                     OutputCallback on_output,
+                                     const JobObject* job)
+    {
+        // Handles are inherited by every process created while they are inheritable, so the write end of the pipe
+        // must only be inheritable while its own process is being created
+        static std::mutex creation_mutex;
+        std::lock_guard<std::mutex> lock(creation_mutex);
+
+        HANDLE read_pipe = nullptr;
+        HANDLE write_pipe = nullptr;
+        if (on_output)
+        {
+            SECURITY_ATTRIBUTES security_attributes{sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+            if (CreatePipe(&read_pipe, &write_pipe, &security_attributes, 0) != TRUE)
+            {
+                return std::error_code(GetLastError(), std::system_category());
+            }
+            SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+        }
+
         STARTUPINFOW startup_info;
         memset(&startup_info, 0, sizeof(STARTUPINFOW));
         startup_info.cb = sizeof(STARTUPINFOW);
+        if (on_output)
+        {
+            startup_info.dwFlags = STARTF_USESTDHANDLES;
+            startup_info.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+            startup_info.hStdOutput = write_pipe;
+            startup_info.hStdError = write_pipe;
+        }
 
         PROCESS_INFORMATION process_info;
         memset(&process_info, 0, sizeof(PROCESS_INFORMATION));
 
-        // Basically we are wrapping it in quotes
-        std::wstring actual_cmd_line = Strings::wformat(LR"###(cmd.exe /c "%s")###", cmd_line);
-        Debug::println("CreateProcessW(%s)", Strings::to_utf8(actual_cmd_line));
-        bool succeeded = TRUE == CreateProcessW(nullptr,
-                                                actual_cmd_line.data(),
-                                                nullptr,
-                                                nullptr,
-                                                FALSE,
-                                                BELOW_NORMAL_PRIORITY_CLASS | CREATE_UNICODE_ENVIRONMENT,
-                                                env_cstr.data(),
-                                                nullptr,
-                                                &startup_info,
-                                                &process_info);
-
-        Checks::check_exit(VCPKG_LINE_INFO, succeeded, "Process creation failed with error code: %lu", GetLastError());
+        std::wstring mutable_cmd_line = cmd_line.c_str();
+        std::wstring mutable_environment_block = environment_block;
+
+        Debug::println("CreateProcessW(%s)", Strings::to_utf8(mutable_cmd_line));
+        const bool succeeded =
+            TRUE == CreateProcessW(nullptr,
+                                   mutable_cmd_line.data(),
+                                   nullptr,
+                                   nullptr,
+                                   on_output ? TRUE : FALSE,
+                                   BELOW_NORMAL_PRIORITY_CLASS | CREATE_UNICODE_ENVIRONMENT |
+                                       (job != nullptr ? CREATE_SUSPENDED : 0),
+                                   environment_block.empty() ? nullptr : mutable_environment_block.data(),
+                                   nullptr,
+                                   &startup_info,
+                                   &process_info);
+        const std::error_code ec(GetLastError(), std::system_category());
+
+        // Only the process needs the write end. Once every copy is closed, the reader sees the end of the output.
+        if (write_pipe != nullptr) CloseHandle(write_pipe);
+
+        if (!succeeded)
+        {
+            Debug::println("CreateProcessW() failed with error code %d", ec.value());
+            if (read_pipe != nullptr) CloseHandle(read_pipe);
+            return ec;
+        }
 
+        if (job != nullptr)
+        {
+            // A process which cannot join the job, such as one in a job which forbids it, runs unaccounted
+            if (!AssignProcessToJobObject(job->m_job, process_info.hProcess))
+            {
+                Debug::println("AssignProcessToJobObject() failed with error code %d", GetLastError());
+            }
+            ResumeThread(process_info.hThread);
+        }
         CloseHandle(process_info.hThread);
+        Metrics::g_metrics.lock()->track_counter("processes_spawned", 1);
+
+        Process process;
+        process.m_process = process_info.hProcess;
+        if (GlobalState::trace_processes)
+        {
+            process.m_traced_cmd_line = Strings::to_utf8(cmd_line);
+            process.m_start_us = Timings::microseconds_since_start();
+            if (on_output) process.m_output_bytes = std::make_shared<size_t>(0);
+        }
+        if (on_output)
+        {
+            process.m_output_reader =
+                std::thread([read_pipe, on_output = std::move(on_output), output_bytes = process.m_output_bytes]() {
+                    char buf[4096];
+                    DWORD bytes_read = 0;
+                    while (ReadFile(read_pipe, buf, sizeof(buf), &bytes_read, nullptr) && bytes_read != 0)
+                    {
+                        if (output_bytes) *output_bytes += bytes_read;
+                        on_output(buf, bytes_read);
+                    }
+                    CloseHandle(read_pipe);
+                });
+        }
 
-        const DWORD result = WaitForSingleObject(process_info.hProcess, INFINITE);
+        return std::move(process);
+    }
+
+    Process::Process(Process&& other) noexcept
+        : m_process(other.m_process)
+        , m_output_reader(std::move(other.m_output_reader))
+        , m_exit_code(other.m_exit_code)
+        , m_traced_cmd_line(std::move(other.m_traced_cmd_line))
+        , m_start_us(other.m_start_us)
+        , m_output_bytes(std::move(other.m_output_bytes))
+    {
+        other.m_process = nullptr;
+    }
+
+    Process& Process::operator=(Process&& other) noexcept
+    {
+        if (this != &other)
+        {
+            this->wait();
+            m_process = other.m_process;
+            m_output_reader = std::move(other.m_output_reader);
+            m_exit_code = other.m_exit_code;
+            m_traced_cmd_line = std::move(other.m_traced_cmd_line);
+            m_start_us = other.m_start_us;
+            m_output_bytes = std::move(other.m_output_bytes);
+            other.m_process = nullptr;
+        }
+        return *this;
+    }
+
+    Process::~Process() { this->wait(); }
+
+    int Process::wait()
+    {
+        if (m_process == nullptr)
+        {
+            return m_exit_code;
+        }
+
+        const DWORD result = WaitForSingleObject(m_process, INFINITE);
         Checks::check_exit(VCPKG_LINE_INFO, result != WAIT_FAILED, "WaitForSingleObject failed");
 
         DWORD exit_code = 0;
-        GetExitCodeProcess(process_info.hProcess, &exit_code);
+        GetExitCodeProcess(m_process, &exit_code);
+        CloseHandle(m_process);
+        m_process = nullptr;
+        m_exit_code = static_cast<int>(exit_code);
+
+        // The output may still be in the pipe after the process has exited
+        if (m_output_reader.joinable()) m_output_reader.join();
 
-        Debug::println("CreateProcessW() returned %lu", exit_code);
-        return static_cast<int>(exit_code);
+        Debug::println("CreateProcessW() returned %d", m_exit_code);
+        if (!m_traced_cmd_line.empty())
+        {
+            Timings::track_process_if_enabled(std::move(m_traced_cmd_line),
+                                              m_start_us,
+                                              m_exit_code,
+                                              m_output_bytes ? Optional<size_t>(*m_output_bytes) : nullopt);
+            m_traced_cmd_line.clear();
+        }
+        return m_exit_code;
     }
 
-    int cmd_execute(const CWStringView cmd_line)
+    Optional<int> Process::try_wait()
+    {
+        if (m_process != nullptr && WaitForSingleObject(m_process, 0) == WAIT_TIMEOUT)
+        {
+            return nullopt;
+        }
+
+        return this->wait();
+    }
+
+    // Everything which reaches the console goes through g_console_mutex, so that lines printed by different threads
+    // never mix and the status line can be moved out of the way of the output
+    static std::mutex g_console_mutex;
+    static std::string g_status_line;
+    static bool g_status_line_shown = false;
+    static bool g_at_line_start = true;
+
+    // In the order they were created, so that nested outputs are flushed into the ones around them first
+    static std::mutex g_buffered_outputs_mutex;
+    static std::vector<BufferedOutput*> g_buffered_outputs;
+    static thread_local BufferedOutput* t_current_output = nullptr;
+
+    bool is_stdout_console()
+    {
+        static const bool is_console = []() {
+            DWORD mode;
+            return GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &mode) != 0;
+        }();
+        return is_console;
+    }
+
+    struct ConsoleInfo
+    {
+        HANDLE handle;
+        WORD original_attributes;
+        size_t width;
+    };
+
+    static const ConsoleInfo& get_console_info()
+    {
+        static const ConsoleInfo info = []() {
+            ConsoleInfo ret;
+            ret.handle = GetStdHandle(STD_OUTPUT_HANDLE);
+            CONSOLE_SCREEN_BUFFER_INFO console_screen_buffer_info{};
+            GetConsoleScreenBufferInfo(ret.handle, &console_screen_buffer_info);
+            ret.original_attributes = console_screen_buffer_info.wAttributes;
+            ret.width = static_cast<size_t>(std::max<SHORT>(console_screen_buffer_info.dwSize.X, 0));
+            return ret;
+        }();
+        return info;
+    }
+
+    static void write_to_console_locked(const Optional<Color>& color, const char* data, const size_t size)
+    {
+        if (size == 0) return;
+        g_at_line_start = data[size - 1] == '\n';
+
+        // Redirected output is written in large blocks, which keeps commands such as list fast when piped
+        static std::once_flag stdout_buffering_initialized;
+        std::call_once(stdout_buffering_initialized, []() {
+            if (!is_stdout_console()) setvbuf(stdout, nullptr, _IOFBF, 64 * 1024);
+        });
+
+        if (!is_stdout_console())
+        {
+            fwrite(data, 1, size, stdout);
+            return;
+        }
+
+        const ConsoleInfo& console = get_console_info();
+        const auto c = color.get();
+        if (c) SetConsoleTextAttribute(console.handle, static_cast<WORD>(*c) | (console.original_attributes & 0xF0));
+        fwrite(data, 1, size, stdout);
+        fflush(stdout);
+        if (c) SetConsoleTextAttribute(console.handle, console.original_attributes);
+    }
+
+    static void hide_status_line_locked()
+    {
+        if (!g_status_line_shown) return;
+
+        // Return to the start of the line and blank it, so that the output which follows overwrites it
+        const std::string blank = "\r" + std::string(g_status_line.size(), ' ') + "\r";
+        fwrite(blank.data(), 1, blank.size(), stdout);
+        fflush(stdout);
+        g_status_line_shown = false;
+    }
+
+    static void show_status_line_locked()
+    {
+        // A partial line stays where it is until it is finished
+        if (g_status_line_shown || g_status_line.empty() || !g_at_line_start) return;
+
+        fwrite(g_status_line.data(), 1, g_status_line.size(), stdout);
+        fflush(stdout);
+        g_status_line_shown = true;
+    }
+
+    static void write_to_console(const Optional<Color>& color, const char* data, const size_t size)
+    {
+        std::lock_guard<std::mutex> lock(g_console_mutex);
+        hide_status_line_locked();
+        write_to_console_locked(color, data, size);
+        show_status_line_locked();
+    }
+
+    // A process which is not captured writes straight to the console, after anything vcpkg has printed
+    static void prepare_console_for_process()
+    {
+        std::lock_guard<std::mutex> lock(g_console_mutex);
+        hide_status_line_locked();
+        fflush(nullptr);
+    }
+
+    BufferedOutput::BufferedOutput() : m_previous(t_current_output)
+    {
+        t_current_output = this;
+        std::lock_guard<std::mutex> lock(g_buffered_outputs_mutex);
+        g_buffered_outputs.push_back(this);
+    }
+
+    BufferedOutput::~BufferedOutput()
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_buffered_outputs_mutex);
+            g_buffered_outputs.erase(std::find(g_buffered_outputs.begin(), g_buffered_outputs.end(), this));
+        }
+        this->flush();
+        t_current_output = m_previous;
+    }
+
+    void BufferedOutput::flush()
+    {
+        std::vector<Segment> segments;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            segments.swap(m_segments);
+        }
+        if (segments.empty()) return;
+
+        if (m_previous != nullptr)
+        {
+            for (auto&& segment : segments)
+            {
+                if (const auto c = segment.color.get())
+                    m_previous->append(*c, segment.text);
+                else
+                    m_previous->append(segment.text.data(), segment.text.size());
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(g_console_mutex);
+        hide_status_line_locked();
+        for (auto&& segment : segments)
+        {
+            write_to_console_locked(segment.color, segment.text.data(), segment.text.size());
+        }
+        show_status_line_locked();
+    }
+
+    void BufferedOutput::append(const char* data, const size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_segments.empty() || m_segments.back().color.has_value()) m_segments.push_back({nullopt, std::string()});
+        m_segments.back().text.append(data, size);
+    }
+
+    void BufferedOutput::append(const Color c, const CStringView text)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_segments.push_back({c, text.c_str()});
+    }
+
+    BufferedOutput* BufferedOutput::current() { return t_current_output; }
+
+    void set_status_line(const std::string& status)
+    {
+        if (!is_stdout_console()) return;
+
+        std::lock_guard<std::mutex> lock(g_console_mutex);
+        hide_status_line_locked();
+        // Filling the last column would wrap the console onto a new line
+        const size_t width = get_console_info().width;
+        g_status_line = width > 1 && status.size() >= width ? status.substr(0, width - 1) : status;
+        show_status_line_locked();
+    }
+
+    void flush_all_output()
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_buffered_outputs_mutex);
+            for (auto it = g_buffered_outputs.rbegin(); it != g_buffered_outputs.rend(); ++it)
+            {
+                (*it)->flush();
+            }
+        }
+        set_status_line(std::string());
+    }
+
+    static int execute_to_completion(const CWStringView cmd_line,
+                                     const std::wstring& environment_block,
+                                     const JobObject* job)
+    {
+        // While the output of this thread is buffered, so is the output of the process
+        Process::OutputCallback on_output;
+        if (const auto output = BufferedOutput::current())
+        {
+            on_output = [output](const char* data, const size_t size) { output->append(data, size); };
+        }
+        prepare_console_for_process();
+
+        auto maybe_process = Process::start(cmd_line, environment_block, std::move(on_output), job);
+        const auto process = maybe_process.get();
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           process != nullptr,
+                           "Process creation failed with error code: %d",
+                           maybe_process.error().value());
+        return process->wait();
+    }
+
+    int cmd_execute_clean(const CWStringView cmd_line, const JobObject* job)
+    {
+        // Basically we are wrapping it in quotes
+        const std::wstring actual_cmd_line = Strings::wformat(LR"###(cmd.exe /c "%s")###", cmd_line);
+        return execute_to_completion(actual_cmd_line, get_clean_environment(), job);
+    }
+
+    int execute_with_environment(const CWStringView cmd_line,
+                                 const std::wstring& environment_block,
+                                 const JobObject* job)
+    {
+        return execute_to_completion(cmd_line, environment_block, job);
+    }
+
+    bool start_detached(const CWStringView cmd_line)
+    {
+        STARTUPINFOW startup_info;
+        memset(&startup_info, 0, sizeof(STARTUPINFOW));
+        startup_info.cb = sizeof(STARTUPINFOW);
+
+        PROCESS_INFORMATION process_info;
+        memset(&process_info, 0, sizeof(PROCESS_INFORMATION));
+
+        std::wstring mutable_cmd_line = cmd_line.c_str();
+        Debug::println("CreateProcessW(%s) detached", Strings::to_utf8(mutable_cmd_line));
+        const bool succeeded =
+            TRUE == CreateProcessW(nullptr,
+                                   mutable_cmd_line.data(),
+                                   nullptr,
+                                   nullptr,
+                                   FALSE,
+                                   BELOW_NORMAL_PRIORITY_CLASS | DETACHED_PROCESS | CREATE_NEW_PROCESS_GROUP,
+                                   nullptr,
+                                   nullptr,
+                                   &startup_info,
+                                   &process_info);
+        if (!succeeded) return false;
+
+        CloseHandle(process_info.hThread);
+        CloseHandle(process_info.hProcess);
+        return true;
+    }
+
+    Optional<std::wstring> get_environment_after(const CWStringView cmd_line)
     {
         // Flush stdout before launching external process
         fflush(nullptr);
 
+        // /u makes cmd.exe write the output of set as UTF-16
+        const std::wstring actual_cmd_line = Strings::wformat(LR"###(cmd.exe /u /c "%s && set")###", cmd_line);
+
+        std::string bytes;
+        auto maybe_process = Process::start(
+            actual_cmd_line, get_clean_environment(), [&](const char* data, size_t size) { bytes.append(data, size); });
+        const auto process = maybe_process.get();
+        if (process == nullptr || process->wait() != 0) return nullopt;
+
+        std::wstring output(bytes.size() / sizeof(wchar_t), L'\0');
+        memcpy(&output[0], bytes.data(), output.size() * sizeof(wchar_t));
+
+        std::wstring environment_block;
+        size_t line_begin = 0;
+        while (line_begin < output.size())
+        {
+            size_t line_end = output.find(L'\n', line_begin);
+            if (line_end == std::wstring::npos) line_end = output.size();
+
+            std::wstring line = output.substr(line_begin, line_end - line_begin);
+            if (!line.empty() && line.back() == L'\r') line.pop_back();
+            if (line.find(L'=') != std::wstring::npos)
+            {
+                environment_block.append(line);
+                environment_block.push_back(L'\0');
+            }
+
+            line_begin = line_end + 1;
+        }
+
+        if (environment_block.empty()) return nullopt;
+
+        environment_block.push_back(L'\0');
+        return environment_block;
+    }
+
+    int cmd_execute(const CWStringView cmd_line)
+    {
+        prepare_console_for_process();
+
         // Basically we are wrapping it in quotes
         const std::wstring& actual_cmd_line = Strings::wformat(LR"###("%s")###", cmd_line);
         Debug::println("_wsystem(%s)", Strings::to_utf8(actual_cmd_line));
+        const double start_us = Timings::microseconds_since_start();
         const int exit_code = _wsystem(actual_cmd_line.c_str());
         Debug::println("_wsystem() returned %d", exit_code);
+        Timings::track_process_if_enabled(Strings::to_utf8(cmd_line), start_us, exit_code, nullopt);
+        Metrics::g_metrics.lock()->track_counter("processes_spawned", 1);
         return exit_code;
     }
 
     // On Win7, output from powershell calls contain a byte order mark, so we strip it out if it is present
-    static void remove_byte_order_mark(std::wstring* s)
+    static void remove_byte_order_mark(std::string* s)
     {
-        const wchar_t* a = s->c_str();
         // This is the UTF-8 byte-order mark
-        if (a[0] == 0xEF && a[1] == 0xBB && a[2] == 0xBF)
+        if (s->size() >= 3 && s->compare(0, 3, "\xEF\xBB\xBF") == 0)
         {
             s->erase(0, 3);
         }
     }
 
+    // Callers expect the "\n" line endings of a text mode pipe
+    static void normalize_line_endings(std::string* s)
+    {
+        size_t out = 0;
+        for (size_t i = 0; i < s->size(); ++i)
+        {
+            if ((*s)[i] == '\r' && i + 1 < s->size() && (*s)[i + 1] == '\n') continue;
+            (*s)[out++] = (*s)[i];
+        }
+        s->resize(out);
+    }
+
     ExitCodeAndOutput cmd_execute_and_capture_output(const CWStringView cmd_line)
     {
         // Flush stdout before launching external process
         fflush(stdout);
 
-        const std::wstring& actual_cmd_line = Strings::wformat(LR"###("%s 2>&1")###", cmd_line);
-
-        Debug::println("_wpopen(%s)", Strings::to_utf8(actual_cmd_line));
-        std::wstring output;
-        wchar_t buf[1024];
-        const auto pipe = _wpopen(actual_cmd_line.c_str(), L"r");
-        if (pipe == nullptr)
-        {
-            return {1, Strings::to_utf8(output)};
-        }
-        while (fgetws(buf, 1024, pipe))
+        std::string output;
+        auto maybe_process =
+            Process::start(cmd_line, std::wstring(), [&](const char* data, size_t size) { output.append(data, size); });
+        const auto process = maybe_process.get();
+        if (process == nullptr)
         {
-            output.append(buf);
-        }
-        if (!feof(pipe))
-        {
-            return {1, Strings::to_utf8(output)};
+            return {1, std::move(output)};
         }
 
-        const auto ec = _pclose(pipe);
-        Debug::println("_pclose() returned %d", ec);
+        const int exit_code = process->wait();
         remove_byte_order_mark(&output);
-        return {ec, Strings::to_utf8(output)};
+        normalize_line_endings(&output);
+        return {exit_code, std::move(output)};
     }
 
     std::wstring create_powershell_script_cmd(const fs::path& script_path, const CWStringView args)
@@ -224,33 +771,46 @@ namespace vcpkg::System
             LR"(powershell -NoProfile -ExecutionPolicy Bypass -Command "& {& '%s' %s}")", script_path.native(), args);
     }
 
-    void println() { println(Strings::EMPTY); }
+    void println() { print("\n"); }
 
-    void print(const CStringView message) { fputs(message, stdout); }
+    std::string& details::message_buffer()
+    {
+        static thread_local std::string buffer;
+        return buffer;
+    }
+
+    void print(const CStringView message)
+    {
+        if (const auto output = BufferedOutput::current())
+        {
+            return output->append(message.c_str(), strlen(message.c_str()));
+        }
+        write_to_console(nullopt, message.c_str(), strlen(message.c_str()));
+    }
 
     void println(const CStringView message)
     {
-        print(message);
-        putchar('\n');
+        std::string& buffer = details::message_buffer();
+        buffer.assign(message.c_str());
+        buffer.push_back('\n');
+        print(buffer);
     }
 
     void print(const Color c, const CStringView message)
     {
-        const HANDLE console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
-
-        CONSOLE_SCREEN_BUFFER_INFO console_screen_buffer_info{};
-        GetConsoleScreenBufferInfo(console_handle, &console_screen_buffer_info);
-        const auto original_color = console_screen_buffer_info.wAttributes;
-
-        SetConsoleTextAttribute(console_handle, static_cast<WORD>(c) | (original_color & 0xF0));
-        print(message);
-        SetConsoleTextAttribute(console_handle, original_color);
+        if (const auto output = BufferedOutput::current())
+        {
+            return output->append(c, message);
+        }
+        write_to_console(c, message.c_str(), strlen(message.c_str()));
     }
 
     void println(const Color c, const CStringView message)
     {
-        print(c, message);
-        putchar('\n');
+        std::string& buffer = details::message_buffer();
+        buffer.assign(message.c_str());
+        buffer.push_back('\n');
+        print(c, buffer);
     }
 
     Optional<std::wstring> get_environment_variable(const CWStringView varname) noexcept
@@ -330,6 +890,8 @@ namespace vcpkg::System
 
 namespace vcpkg::Debug
 {
+    bool is_enabled() { return GlobalState::debugging; }
+
     void println(const CStringView message)
     {
         if (GlobalState::debugging)
@@ -0,0 +1,132 @@
+#include "pch.h"
+
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_ThreadPool.h"
+
+#include <condition_variable>
+#include <deque>
+
+namespace vcpkg::ThreadPool
+{
+    /// <summary>
+    /// A loop which is running. Its indices are handed out one by one from next, so a slow index does not hold up the
+    /// others behind it.
+    /// </summary>
+    struct Loop
+    {
+        Loop(const size_t count, const std::function<void(size_t)>& f, const size_t max_helpers)
+            : count(count), f(f), max_helpers(max_helpers)
+        {
+        }
+
+        const size_t count;
+        const std::function<void(size_t)>& f;
+        const size_t max_helpers;
+        size_t helpers = 0;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+    };
+
+    static size_t get_default_thread_count()
+    {
+        const Optional<std::wstring> processors = System::get_environment_variable(L"NUMBER_OF_PROCESSORS");
+        if (const auto p = processors.get())
+        {
+            const int parsed = atoi(Strings::to_utf8(*p).c_str());
+            if (parsed > 0) return static_cast<size_t>(parsed);
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    static std::atomic<size_t> g_max_threads{0};
+
+    // Never destroyed, because the threads which wait on them are never joined
+    static std::mutex& g_mutex = *new std::mutex();
+    static std::condition_variable& g_cv = *new std::condition_variable();
+    static std::deque<std::shared_ptr<Loop>>& g_loops = *new std::deque<std::shared_ptr<Loop>>();
+    static size_t g_started_threads = 0;
+
+    size_t get_thread_count()
+    {
+        size_t max_threads = g_max_threads.load();
+        if (max_threads == 0)
+        {
+            size_t expected = 0;
+            g_max_threads.compare_exchange_strong(expected, get_default_thread_count());
+            max_threads = g_max_threads.load();
+        }
+        return max_threads;
+    }
+
+    void set_max_threads(const size_t max_threads)
+    {
+        const size_t capped = std::max<size_t>(1, std::min(get_thread_count(), max_threads));
+        g_max_threads.store(capped);
+    }
+
+    static void run_indices(Loop& loop)
+    {
+        for (size_t i = loop.next++; i < loop.count; i = loop.next++)
+        {
+            loop.f(i);
+            if (++loop.done == loop.count)
+            {
+                std::lock_guard<std::mutex> lock(loop.done_mutex);
+                loop.done_cv.notify_all();
+            }
+        }
+    }
+
+    static void run_worker()
+    {
+        for (;;)
+        {
+            std::shared_ptr<Loop> loop;
+            {
+                std::unique_lock<std::mutex> lock(g_mutex);
+                g_cv.wait(lock, []() { return !g_loops.empty(); });
+                loop = g_loops.front();
+
+                // A loop needs no more helpers once it has as many as its cap, or nothing is left to hand out
+                if (++loop->helpers >= loop->max_helpers || loop->next.load() >= loop->count) g_loops.pop_front();
+            }
+            run_indices(*loop);
+        }
+    }
+
+    void for_each_index(const size_t count, const std::function<void(size_t)>& f)
+    {
+        const size_t thread_count = std::min(count, get_thread_count());
+        if (thread_count <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                f(i);
+            return;
+        }
+
+        const auto loop = std::make_shared<Loop>(count, f, thread_count - 1);
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            for (; g_started_threads < thread_count - 1; ++g_started_threads)
+            {
+                std::thread(run_worker).detach();
+            }
+            g_loops.push_back(loop);
+        }
+        g_cv.notify_all();
+
+        run_indices(*loop);
+        {
+            std::unique_lock<std::mutex> lock(loop->done_mutex);
+            loop->done_cv.wait(lock, [&]() { return loop->done.load() == count; });
+        }
+
+        // The loop is still queued when the calling thread took the last indices before enough helpers came
+        std::lock_guard<std::mutex> lock(g_mutex);
+        const auto it = std::find(g_loops.cbegin(), g_loops.cend(), loop);
+        if (it != g_loops.cend()) g_loops.erase(it);
+    }
+}
@@ -0,0 +1,320 @@
+#include "pch.h"
+
+#include "vcpkg_Files.h"
+#include "vcpkg_GlobalState.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
+
+namespace vcpkg::Timings
+{
+    Util::LockGuarded<Timings> g_timings;
+
+    // Events are placed relative to the start of the process; the wall clock time of the start maps CMake's
+    // timestamps onto the same scale
+    static const ElapsedTime g_process_timer = ElapsedTime::create_started();
+    static const std::chrono::system_clock::time_point g_process_start_time = std::chrono::system_clock::now();
+
+    double microseconds_since_start() { return g_process_timer.microseconds(); }
+
+    double microseconds_since_start(const std::time_t wall_clock_time)
+    {
+        const auto since_start = std::chrono::system_clock::from_time_t(wall_clock_time) - g_process_start_time;
+        return std::chrono::duration<double, std::micro>(since_start).count();
+    }
+
+    void Timings::set_print_timings(bool should_print_timings) { m_print_timings = should_print_timings; }
+
+    void Timings::set_trace_file(const fs::path& trace_file) { m_trace_file = trace_file; }
+
+    void Timings::set_trace_processes(bool should_trace_processes) { m_trace_processes = should_trace_processes; }
+
+    void Timings::set_print_memstats(bool should_print_memstats) { m_print_memstats = should_print_memstats; }
+
+    void Timings::track_event(TimingEvent&& event) { m_events.push_back(std::move(event)); }
+
+    void Timings::track_process(ProcessEvent&& event) { m_processes.push_back(std::move(event)); }
+
+    void track_event_if_enabled(const std::string& phase,
+                                const std::string& subject,
+                                const double start_us,
+                                const double duration_us,
+                                std::string details)
+    {
+        if (!GlobalState::timings) return;
+
+        g_timings.lock()->track_event(
+            {phase, subject, start_us, duration_us, GetCurrentThreadId(), std::move(details)});
+    }
+
+    void track_process_if_enabled(std::string cmd_line,
+                                  const double start_us,
+                                  const int exit_code,
+                                  const Optional<size_t> output_bytes)
+    {
+        if (!GlobalState::trace_processes) return;
+
+        const double duration_us = microseconds_since_start() - start_us;
+        g_timings.lock()->track_process({std::move(cmd_line), start_us, duration_us, exit_code, output_bytes});
+    }
+
+    /// <summary>
+    /// The word of the command line at pos, without its quotes; moves pos past it
+    /// </summary>
+    static std::string next_word(const std::string& text, size_t& pos)
+    {
+        while (pos < text.size() && text[pos] == ' ')
+            ++pos;
+        if (pos == text.size()) return std::string();
+
+        const char end = text[pos] == '"' ? '"' : ' ';
+        if (end == '"') ++pos;
+        const size_t token_end = std::min(text.find(end, pos), text.size());
+        std::string token = text.substr(pos, token_end - pos);
+        pos = std::min(token_end + 1, text.size());
+        return token;
+    }
+
+    static std::string file_name(std::string path)
+    {
+        const size_t slash = path.find_last_of("/\\");
+        if (slash != std::string::npos) path.erase(0, slash + 1);
+        return path;
+    }
+
+    std::string get_program_name(const std::string& cmd_line)
+    {
+        size_t pos = 0;
+        const std::string program = file_name(next_word(cmd_line, pos));
+        if (Strings::case_insensitive_ascii_compare(program, "cmd.exe") != 0 &&
+            Strings::case_insensitive_ascii_compare(program, "cmd") != 0)
+        {
+            return program;
+        }
+
+        // cmd.exe [/u] /c "<program> <arguments>" runs the program in the first word of the command
+        for (std::string option = next_word(cmd_line, pos); !option.empty(); option = next_word(cmd_line, pos))
+        {
+            if (Strings::case_insensitive_ascii_compare(option, "/c") != 0) continue;
+
+            std::string command = cmd_line.substr(pos);
+            if (!command.empty() && command.front() == '"') command.erase(0, 1);
+            size_t command_pos = 0;
+            const std::string inner = next_word(command, command_pos);
+            return inner.empty() ? program : file_name(inner);
+        }
+        return program;
+    }
+
+    template<class T>
+    static T& find_or_add(std::vector<std::pair<std::string, T>>& entries, const std::string& key)
+    {
+        const auto it = Util::find_if(entries, [&](auto&& entry) { return entry.first == key; });
+        if (it != entries.cend()) return entries[it - entries.cbegin()].second;
+
+        entries.emplace_back(key, T());
+        return entries.back().second;
+    }
+
+    struct PhaseTotal
+    {
+        double microseconds = 0;
+        std::string details;
+    };
+
+    static void print_timings(const std::vector<TimingEvent>& events)
+    {
+        // Subjects and their phases are listed in the order they first started
+        std::vector<std::pair<std::string, std::vector<std::pair<std::string, PhaseTotal>>>> by_subject;
+        std::vector<std::pair<std::string, double>> by_phase;
+        for (auto&& event : events)
+        {
+            PhaseTotal& total = find_or_add(find_or_add(by_subject, event.subject), event.phase);
+            total.microseconds += event.duration_us;
+            if (!event.details.empty()) total.details = event.details;
+            find_or_add(by_phase, event.phase) += event.duration_us;
+        }
+
+        const auto to_seconds = [](const double microseconds) {
+            return Strings::format("%.3f s", microseconds / 1000000);
+        };
+
+        System::println("\nTIMINGS");
+        for (auto&& subject : by_subject)
+        {
+            System::println("    %s", subject.first);
+            for (auto&& phase : subject.second)
+            {
+                const PhaseTotal& total = phase.second;
+                if (total.details.empty())
+                {
+                    System::println("        %s: %s", phase.first, to_seconds(total.microseconds));
+                }
+                else
+                {
+                    System::println("        %s: %s (%s)", phase.first, to_seconds(total.microseconds), total.details);
+                }
+            }
+        }
+
+        System::println("    Total");
+        for (auto&& phase : by_phase)
+        {
+            System::println("        %s: %s", phase.first, to_seconds(phase.second));
+        }
+    }
+
+    struct ProgramTotal
+    {
+        size_t count = 0;
+        double microseconds = 0;
+        size_t output_bytes = 0;
+    };
+
+    static void print_processes(const std::vector<ProcessEvent>& processes)
+    {
+        const auto to_seconds = [](const double microseconds) {
+            return Strings::format("%.3f s", microseconds / 1000000);
+        };
+
+        System::println("\nPROCESSES");
+        std::vector<std::pair<std::string, ProgramTotal>> by_program;
+        double total_microseconds = 0;
+        for (auto&& process : processes)
+        {
+            const auto output_bytes = process.output_bytes.get();
+            System::println("    %10s  exit %-4d %10s  %s",
+                            to_seconds(process.duration_us),
+                            process.exit_code,
+                            output_bytes ? Strings::format("%d bytes", *output_bytes) : std::string("console"),
+                            process.cmd_line);
+
+            ProgramTotal& total = find_or_add(by_program, get_program_name(process.cmd_line));
+            ++total.count;
+            total.microseconds += process.duration_us;
+            if (output_bytes) total.output_bytes += *output_bytes;
+            total_microseconds += process.duration_us;
+        }
+
+        // The programs which took the longest together come first, since they are the ones worth avoiding
+        std::stable_sort(by_program.begin(), by_program.end(), [](auto&& left, auto&& right) {
+            return left.second.microseconds > right.second.microseconds;
+        });
+
+        System::println("    Total: %d processes, %s", processes.size(), to_seconds(total_microseconds));
+        for (auto&& program : by_program)
+        {
+            System::println("        %s: %d processes, %s, %d bytes of output",
+                            program.first,
+                            program.second.count,
+                            to_seconds(program.second.microseconds),
+                            program.second.output_bytes);
+        }
+    }
+
+    struct PhaseAllocations
+    {
+        uint64_t allocations = 0;
+        uint64_t allocated_bytes = 0;
+    };
+
+    static void print_memstats(const std::vector<TimingEvent>& events)
+    {
+        const auto to_mib = [](const uint64_t bytes) {
+            return Strings::format("%.1f MiB", static_cast<double>(bytes) / (1 << 20));
+        };
+
+        // Phases nest, so the allocations of a phase include those of the phases within it
+        std::vector<std::pair<std::string, PhaseAllocations>> by_phase;
+        for (auto&& event : events)
+        {
+            if (event.allocations == 0) continue;
+            PhaseAllocations& phase = find_or_add(by_phase, event.phase);
+            phase.allocations += event.allocations;
+            phase.allocated_bytes += event.allocated_bytes;
+        }
+
+        const MemStats::Counters total = MemStats::get_counters();
+        System::println("\nMEMORY");
+        System::println("    Peak working set: %s", to_mib(MemStats::get_peak_working_set_bytes()));
+        System::println("    Peak heap: %s", to_mib(MemStats::get_peak_heap_bytes()));
+        System::println("    Total: %s allocations, %s",
+                        std::to_string(total.allocations),
+                        to_mib(total.allocated_bytes));
+        for (auto&& phase : by_phase)
+        {
+            System::println("        %s: %s allocations, %s",
+                            phase.first,
+                            std::to_string(phase.second.allocations),
+                            to_mib(phase.second.allocated_bytes));
+        }
+    }
+
+    static std::string to_chrome_trace(const std::vector<TimingEvent>& events)
+    {
+        const unsigned long process_id = GetCurrentProcessId();
+        const std::string trace_events = Strings::join(",\n", events, [&](const TimingEvent& event) {
+            return Strings::format(
+                R"(  {"name":%s,"cat":"vcpkg","ph":"X","ts":%s,"dur":%s,"pid":%s,"tid":%s,"args":{"subject":%s%s}})",
+                Strings::to_json_string(event.phase),
+                std::to_string(static_cast<long long>(event.start_us)),
+                std::to_string(static_cast<long long>(event.duration_us)),
+                std::to_string(process_id),
+                std::to_string(event.thread_id),
+                Strings::to_json_string(event.subject),
+                event.details.empty() ? std::string() : ",\"details\":" + Strings::to_json_string(event.details));
+        });
+
+        return Strings::format("{\"traceEvents\":[\n%s\n]}", trace_events);
+    }
+
+    void Timings::flush()
+    {
+        if (m_print_timings)
+        {
+            print_timings(m_events);
+        }
+
+        if (m_trace_processes)
+        {
+            print_processes(m_processes);
+        }
+
+        if (m_print_memstats)
+        {
+            print_memstats(m_events);
+        }
+
+        if (!m_trace_file.empty())
+        {
+            // This runs while exiting, so it must not exit again on failure like write_contents() does
+            Files::get_real_filesystem().write_lines(m_trace_file, {to_chrome_trace(m_events)});
+            System::println("Wrote the timing trace to %s", m_trace_file.u8string());
+        }
+    }
+
+    ScopedTimer::ScopedTimer(std::string phase, std::string subject)
+        : m_enabled(GlobalState::timings || GlobalState::memstats)
+        , m_phase(std::move(phase))
+        , m_subject(std::move(subject))
+        , m_start_us(m_enabled ? microseconds_since_start() : 0)
+        , m_start_counters(m_enabled ? MemStats::get_counters() : MemStats::Counters())
+    {
+    }
+
+    ScopedTimer::~ScopedTimer()
+    {
+        if (!m_enabled) return;
+
+        const double end_us = microseconds_since_start();
+        const MemStats::Counters end_counters = MemStats::get_counters();
+        g_timings.lock()->track_event({std::move(m_phase),
+                                       std::move(m_subject),
+                                       m_start_us,
+                                       end_us - m_start_us,
+                                       GetCurrentThreadId(),
+                                       {},
+                                       end_counters.allocations - m_start_counters.allocations,
+                                       end_counters.allocated_bytes - m_start_counters.allocated_bytes});
+    }
+}
@@ -0,0 +1,158 @@
+#include "pch.h"
+
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_VisualStudio.h"
+
+#include <wrl/client.h>
+
+#pragma comment(lib, "ole32")
+#pragma comment(lib, "oleaut32")
+
+namespace vcpkg::VisualStudio
+{
+    // The part of the Setup Configuration API, declared in Setup.Configuration.h of the NuGet package
+    // Microsoft.VisualStudio.Setup.Configuration.Native, which enumerates the instances
+
+    struct DECLSPEC_UUID("B41463C3-8866-43B5-BC33-2B0676F7F42E") DECLSPEC_NOVTABLE ISetupInstance : public IUnknown
+    {
+        STDMETHOD(GetInstanceId)(_Out_ BSTR* pbstrInstanceId) = 0;
+        STDMETHOD(GetInstallDate)(_Out_ LPFILETIME pInstallDate) = 0;
+        STDMETHOD(GetInstallationName)(_Out_ BSTR* pbstrInstallationName) = 0;
+        STDMETHOD(GetInstallationPath)(_Out_ BSTR* pbstrInstallationPath) = 0;
+        STDMETHOD(GetInstallationVersion)(_Out_ BSTR* pbstrInstallationVersion) = 0;
+        STDMETHOD(GetDisplayName)(_In_ LCID lcid, _Out_ BSTR* pbstrDisplayName) = 0;
+        STDMETHOD(GetDescription)(_In_ LCID lcid, _Out_ BSTR* pbstrDescription) = 0;
+        STDMETHOD(ResolvePath)(_In_opt_z_ LPCOLESTR pwszRelativePath, _Out_ BSTR* pbstrAbsolutePath) = 0;
+    };
+
+    struct DECLSPEC_UUID("6380BCFF-41D3-4B2E-8B2E-BF8A6810C848") DECLSPEC_NOVTABLE IEnumSetupInstances
+        : public IUnknown
+    {
+        STDMETHOD(Next)(_In_ ULONG celt, _Out_ ISetupInstance** rgelt, _Out_opt_ ULONG* pceltFetched) = 0;
+        STDMETHOD(Skip)(_In_ ULONG celt) = 0;
+        STDMETHOD(Reset)(void) = 0;
+        STDMETHOD(Clone)(_Out_ IEnumSetupInstances** ppenum) = 0;
+    };
+
+    struct DECLSPEC_UUID("42843719-DB4C-46C2-8E7C-64F1816EFD5B") DECLSPEC_NOVTABLE ISetupConfiguration
+        : public IUnknown
+    {
+        STDMETHOD(EnumInstances)(_Out_ IEnumSetupInstances** ppEnumInstances) = 0;
+        STDMETHOD(GetInstanceForCurrentProcess)(_Out_ ISetupInstance** ppInstance) = 0;
+        STDMETHOD(GetInstanceForPath)(_In_z_ LPCWSTR wzPath, _Out_ ISetupInstance** ppInstance) = 0;
+    };
+
+    struct DECLSPEC_UUID("26AAB78C-4A60-49D6-AF3B-3C35BC93365D") DECLSPEC_NOVTABLE ISetupConfiguration2
+        : public ISetupConfiguration
+    {
+        STDMETHOD(EnumAllInstances)(_Out_ IEnumSetupInstances** ppEnumInstances) = 0;
+    };
+
+    class DECLSPEC_UUID("177F0C4A-1CD3-4DE7-A32C-71DBBB9FA36D") SetupConfiguration;
+
+    using Microsoft::WRL::ComPtr;
+
+    /// <summary>
+    /// Needs COM to be initialized on the calling thread
+    /// </summary>
+    static Optional<std::vector<fs::path>> enumerate_instances()
+    {
+        ComPtr<ISetupConfiguration2> configuration;
+        const HRESULT created = CoCreateInstance(__uuidof(SetupConfiguration),
+                                                 nullptr,
+                                                 CLSCTX_INPROC_SERVER,
+                                                 __uuidof(ISetupConfiguration2),
+                                                 reinterpret_cast<void**>(configuration.GetAddressOf()));
+        if (created == REGDB_E_CLASSNOTREG) return std::vector<fs::path>();
+        if (FAILED(created)) return nullopt;
+
+        // Incomplete instances are listed too; the toolset discovery skips those which lack vcvarsall.bat
+        ComPtr<IEnumSetupInstances> instances;
+        if (FAILED(configuration->EnumAllInstances(instances.GetAddressOf()))) return nullopt;
+
+        std::vector<fs::path> paths;
+        for (;;)
+        {
+            ComPtr<ISetupInstance> instance;
+            ULONG fetched = 0;
+            if (instances->Next(1, instance.GetAddressOf(), &fetched) != S_OK || fetched == 0) break;
+
+            BSTR installation_path = nullptr;
+            if (SUCCEEDED(instance->GetInstallationPath(&installation_path)) && installation_path != nullptr)
+            {
+                paths.push_back(std::wstring(installation_path, SysStringLen(installation_path)));
+            }
+            SysFreeString(installation_path);
+        }
+        return paths;
+    }
+
+    Optional<std::vector<fs::path>> find_vs2017_instances()
+    {
+        // COM may already be initialized for this thread in another mode, which an in-process server does not mind
+        const HRESULT initialized = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        Optional<std::vector<fs::path>> instances = enumerate_instances();
+        if (SUCCEEDED(initialized)) CoUninitialize();
+        return instances;
+    }
+
+    static std::vector<fs::path> get_windows_kits_roots(const wchar_t* registry_value, const char* directory)
+    {
+        std::vector<fs::path> roots;
+        for (const wchar_t* key : {LR"(SOFTWARE\Microsoft\Windows Kits\Installed Roots)",
+                                   LR"(SOFTWARE\WOW6432Node\Microsoft\Windows Kits\Installed Roots)"})
+        {
+            const Optional<std::wstring> root = System::get_registry_string(HKEY_LOCAL_MACHINE, key, registry_value);
+            if (const auto p = root.get()) roots.push_back(*p);
+        }
+        for (const wchar_t* variable : {L"ProgramFiles", L"ProgramFiles(x86)"})
+        {
+            const Optional<std::wstring> program_files = System::get_environment_variable(variable);
+            if (const auto p = program_files.get()) roots.push_back(fs::path(*p) / "Windows Kits" / directory);
+        }
+        return roots;
+    }
+
+    std::vector<fs::path> get_windows_sdk_include_dirs()
+    {
+        std::vector<fs::path> include_dirs;
+        for (auto&& root : get_windows_kits_roots(L"KitsRoot10", "10"))
+            include_dirs.push_back(root / "Include");
+        for (auto&& root : get_windows_kits_roots(L"KitsRoot81", "8.1"))
+            include_dirs.push_back(root / "Include");
+        return include_dirs;
+    }
+
+    Optional<std::string> find_windows_sdk_version(const Files::Filesystem& fs)
+    {
+        for (auto&& root : get_windows_kits_roots(L"KitsRoot10", "10"))
+        {
+            const fs::path include_dir = root / "Include";
+            if (!fs.is_directory(include_dir)) continue;
+
+            std::vector<std::string> versions;
+            for (auto&& dir : fs.get_files_non_recursive(include_dir))
+            {
+                const std::string version = dir.filename().u8string();
+                if (version.compare(0, 2, "10") == 0) versions.push_back(version);
+            }
+            std::sort(versions.begin(), versions.end(), std::greater<std::string>());
+
+            // Like the script, an incomplete SDK hides the older ones beside it
+            for (auto&& version : versions)
+            {
+                if (!fs.exists(include_dir / version / "um" / "windows.h")) break;
+                if (!fs.exists(include_dir / version / "shared" / "sdkddkver.h")) break;
+                return version;
+            }
+        }
+
+        for (auto&& root : get_windows_kits_roots(L"KitsRoot81", "8.1"))
+        {
+            if (fs.is_directory(root / "Include")) return std::string("8.1");
+        }
+
+        return nullopt;
+    }
+}
@@ -0,0 +1,891 @@
+#include "pch.h"
+
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_ThreadPool.h"
+#include "vcpkg_Util.h"
+#include "vcpkg_Zip.h"
+
+// The compressor is greedy LZ77 over a 32 KiB window, followed by a block of whichever of stored, fixed Huffman or
+// dynamic Huffman codes is the smallest. Files are split into pieces of PIECE_SIZE which do not refer to each other,
+// so that one large file keeps every thread busy; each piece costs a few bytes of compression ratio.
+namespace vcpkg::Zip
+{
+    static constexpr size_t PIECE_SIZE = 1024 * 1024;
+
+    /// <summary>
+    /// How much input is compressed at once, per thread; the compressed pieces are held until they are written
+    /// </summary>
+    static constexpr size_t BATCH_SIZE_PER_THREAD = 4 * PIECE_SIZE;
+
+    static constexpr size_t WINDOW_SIZE = 32768;
+    static constexpr size_t MIN_MATCH = 3;
+    static constexpr size_t MAX_MATCH = 258;
+    static constexpr size_t MAX_CHAIN = 32;
+    static constexpr size_t NICE_MATCH = 128;
+    static constexpr unsigned HASH_BITS = 15;
+    static constexpr size_t MAX_BLOCK_SYMBOLS = 16384;
+    static constexpr size_t MAX_STORED_SIZE = 65535;
+
+    static constexpr size_t LITLEN_CODES = 288;
+    static constexpr size_t DIST_CODES = 32;
+    static constexpr size_t CODELEN_CODES = 19;
+    static constexpr size_t END_OF_BLOCK = 256;
+
+    static constexpr uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr uint16_t DIST_BASE[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,
+                                               33,  49,  65,  97,  129, 193,  257,  385,  513,  769,
+                                               1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    static constexpr uint8_t CODELEN_ORDER[CODELEN_CODES] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    static const uint32_t (&get_crc_tables())[8][256]
+    {
+        static const auto TABLES = [] {
+            std::array<std::array<uint32_t, 256>, 8> tables;
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t crc = n;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+                tables[0][n] = crc;
+            }
+            for (size_t k = 1; k < 8; ++k)
+            {
+                for (size_t n = 0; n < 256; ++n)
+                    tables[k][n] = (tables[k - 1][n] >> 8) ^ tables[0][tables[k - 1][n] & 0xFF];
+            }
+            return tables;
+        }();
+        return reinterpret_cast<const uint32_t(&)[8][256]>(TABLES);
+    }
+
+    uint32_t crc32(uint32_t crc, const char* data, size_t size)
+    {
+        const auto& tables = get_crc_tables();
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        crc = ~crc;
+
+        // Eight bytes at a time; x86, x64 and ARM are all little endian
+        for (; size >= 8; size -= 8, p += 8)
+        {
+            uint32_t low;
+            uint32_t high;
+            std::memcpy(&low, p, sizeof(low));
+            std::memcpy(&high, p + 4, sizeof(high));
+            low ^= crc;
+            crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^
+                  tables[4][low >> 24] ^ tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^
+                  tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+        }
+        for (; size > 0; --size, ++p)
+            crc = tables[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+
+        return ~crc;
+    }
+
+    static uint32_t gf2_matrix_times(const uint32_t* matrix, uint32_t vector)
+    {
+        uint32_t sum = 0;
+        for (; vector != 0; vector >>= 1, ++matrix)
+        {
+            if (vector & 1) sum ^= *matrix;
+        }
+        return sum;
+    }
+
+    static void gf2_matrix_square(uint32_t* square, const uint32_t* matrix)
+    {
+        for (size_t n = 0; n < 32; ++n)
+            square[n] = gf2_matrix_times(matrix, matrix[n]);
+    }
+
+    uint32_t crc32_combine(uint32_t first_crc, uint32_t second_crc, uint64_t second_size)
+    {
+        if (second_size == 0) return first_crc;
+
+        // Appending n zero bits to the first piece is multiplying its CRC by a matrix, which is squared for each bit
+        // of the size; see crc32_combine() in zlib
+        uint32_t even[32];
+        uint32_t odd[32];
+        odd[0] = 0xEDB88320;
+        for (size_t n = 1; n < 32; ++n)
+            odd[n] = uint32_t(1) << (n - 1);
+        gf2_matrix_square(even, odd);
+        gf2_matrix_square(odd, even);
+
+        for (;;)
+        {
+            gf2_matrix_square(even, odd);
+            if (second_size & 1) first_crc = gf2_matrix_times(even, first_crc);
+            second_size >>= 1;
+            if (second_size == 0) break;
+
+            gf2_matrix_square(odd, even);
+            if (second_size & 1) first_crc = gf2_matrix_times(odd, first_crc);
+            second_size >>= 1;
+            if (second_size == 0) break;
+        }
+        return first_crc ^ second_crc;
+    }
+
+    /// <summary>
+    /// Writes bits from the least significant end, as DEFLATE packs them
+    /// </summary>
+    struct BitWriter
+    {
+        explicit BitWriter(std::string& out) : out(out) {}
+
+        void write(const uint32_t value, const unsigned count)
+        {
+            m_bits |= static_cast<uint64_t>(value) << m_count;
+            m_count += count;
+            while (m_count >= 8)
+            {
+                out.push_back(static_cast<char>(m_bits & 0xFF));
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        void align()
+        {
+            if (m_count > 0) out.push_back(static_cast<char>(m_bits & 0xFF));
+            m_bits = 0;
+            m_count = 0;
+        }
+
+        std::string& out;
+
+    private:
+        uint64_t m_bits = 0;
+        unsigned m_count = 0;
+    };
+
+    /// <summary>
+    /// A literal when distance is 0, otherwise a match of length bytes
+    /// </summary>
+    struct Symbol
+    {
+        uint16_t literal_or_length;
+        uint16_t distance;
+    };
+
+    static const uint8_t (&get_length_codes())[MAX_MATCH + 1]
+    {
+        static const auto CODES = [] {
+            std::array<uint8_t, MAX_MATCH + 1> codes{};
+            for (uint8_t code = 0; code < 28; ++code)
+            {
+                const size_t end = LENGTH_BASE[code] + (size_t(1) << LENGTH_EXTRA[code]);
+                for (size_t length = LENGTH_BASE[code]; length < end; ++length)
+                    codes[length] = code;
+            }
+            codes[MAX_MATCH] = 28;
+            return codes;
+        }();
+        return reinterpret_cast<const uint8_t(&)[MAX_MATCH + 1]>(CODES);
+    }
+
+    static size_t get_distance_code(const uint16_t distance)
+    {
+        return static_cast<size_t>(std::upper_bound(std::begin(DIST_BASE), std::end(DIST_BASE), distance) -
+                                   std::begin(DIST_BASE)) -
+               1;
+    }
+
+    static uint16_t reverse_bits(uint16_t code, unsigned length)
+    {
+        uint16_t reversed = 0;
+        for (; length > 0; --length, code >>= 1)
+            reversed = static_cast<uint16_t>((reversed << 1) | (code & 1));
+        return reversed;
+    }
+
+    /// <summary>
+    /// The lengths of a Huffman code for the frequencies which are no longer than max_length. The lengths of a
+    /// Huffman tree which is too deep are shortened the way miniz does, keeping the code complete.
+    /// </summary>
+    static void build_lengths(const uint32_t* frequencies,
+                              const size_t count,
+                              const unsigned max_length,
+                              uint8_t* lengths)
+    {
+        std::fill(lengths, lengths + count, uint8_t(0));
+
+        std::vector<std::pair<uint32_t, uint16_t>> leaves;
+        for (uint16_t symbol = 0; symbol < count; ++symbol)
+        {
+            if (frequencies[symbol] != 0) leaves.emplace_back(frequencies[symbol], symbol);
+        }
+        if (leaves.empty()) return;
+        if (leaves.size() == 1)
+        {
+            lengths[leaves.front().second] = 1;
+            return;
+        }
+        std::sort(leaves.begin(), leaves.end());
+
+        // The two-queue construction: the internal nodes are made in order of weight, after the leaves they join
+        const size_t leaf_count = leaves.size();
+        std::vector<uint64_t> weights(2 * leaf_count - 1);
+        std::vector<size_t> parents(2 * leaf_count - 1);
+        for (size_t i = 0; i < leaf_count; ++i)
+            weights[i] = leaves[i].first;
+
+        size_t next_leaf = 0;
+        size_t next_internal = leaf_count;
+        for (size_t node = leaf_count; node < weights.size(); ++node)
+        {
+            for (int child = 0; child < 2; ++child)
+            {
+                const bool take_leaf =
+                    next_leaf < leaf_count && (next_internal >= node || weights[next_leaf] <= weights[next_internal]);
+                const size_t taken = take_leaf ? next_leaf++ : next_internal++;
+                weights[node] += weights[taken];
+                parents[taken] = node;
+            }
+        }
+
+        std::vector<unsigned> depths(weights.size());
+        unsigned length_counts[32] = {};
+        for (size_t node = weights.size() - 1; node-- > 0;)
+        {
+            depths[node] = depths[parents[node]] + 1;
+            if (node < leaf_count) ++length_counts[std::min(depths[node], max_length)];
+        }
+
+        uint32_t total = 0;
+        for (unsigned length = 1; length <= max_length; ++length)
+            total += length_counts[length] << (max_length - length);
+        while (total != (1u << max_length))
+        {
+            --length_counts[max_length];
+            for (unsigned length = max_length - 1; length > 0; --length)
+            {
+                if (length_counts[length] == 0) continue;
+
+                --length_counts[length];
+                length_counts[length + 1] += 2;
+                break;
+            }
+            --total;
+        }
+
+        // The least frequent symbols get the longest codes
+        size_t leaf = 0;
+        for (unsigned length = max_length; length > 0; --length)
+        {
+            for (unsigned i = 0; i < length_counts[length]; ++i)
+                lengths[leaves[leaf++].second] = static_cast<uint8_t>(length);
+        }
+    }
+
+    /// <summary>
+    /// The canonical codes of the lengths, bit reversed for BitWriter
+    /// </summary>
+    static void build_codes(const uint8_t* lengths, const size_t count, uint16_t* codes)
+    {
+        uint16_t length_counts[16] = {};
+        for (size_t symbol = 0; symbol < count; ++symbol)
+            ++length_counts[lengths[symbol]];
+        length_counts[0] = 0;
+
+        uint16_t next_codes[16] = {};
+        uint16_t code = 0;
+        for (size_t length = 1; length < 16; ++length)
+        {
+            code = static_cast<uint16_t>((code + length_counts[length - 1]) << 1);
+            next_codes[length] = code;
+        }
+
+        for (size_t symbol = 0; symbol < count; ++symbol)
+        {
+            const uint8_t length = lengths[symbol];
+            codes[symbol] = length == 0 ? 0 : reverse_bits(next_codes[length]++, length);
+        }
+    }
+
+    struct HuffmanCodes
+    {
+        uint8_t litlen_lengths[LITLEN_CODES];
+        uint16_t litlen_codes[LITLEN_CODES];
+        uint8_t dist_lengths[DIST_CODES];
+        uint16_t dist_codes[DIST_CODES];
+    };
+
+    static const HuffmanCodes& get_fixed_codes()
+    {
+        static const HuffmanCodes FIXED = [] {
+            HuffmanCodes codes;
+            for (size_t symbol = 0; symbol < LITLEN_CODES; ++symbol)
+                codes.litlen_lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+            std::fill(std::begin(codes.dist_lengths), std::end(codes.dist_lengths), uint8_t(5));
+            build_codes(codes.litlen_lengths, LITLEN_CODES, codes.litlen_codes);
+            build_codes(codes.dist_lengths, DIST_CODES, codes.dist_codes);
+            return codes;
+        }();
+        return FIXED;
+    }
+
+    /// <summary>
+    /// The code length symbols which describe the lengths of a dynamic block, with the value of their extra bits
+    /// </summary>
+    static std::vector<std::pair<uint8_t, uint8_t>> run_length_encode(const std::vector<uint8_t>& lengths)
+    {
+        std::vector<std::pair<uint8_t, uint8_t>> symbols;
+        for (size_t i = 0; i < lengths.size();)
+        {
+            const uint8_t length = lengths[i];
+            size_t run = 1;
+            while (i + run < lengths.size() && lengths[i + run] == length)
+                ++run;
+            i += run;
+
+            if (length == 0)
+            {
+                for (; run >= 11; run -= std::min<size_t>(run, 138))
+                    symbols.emplace_back(uint8_t(18), static_cast<uint8_t>(std::min<size_t>(run, 138) - 11));
+                if (run >= 3)
+                {
+                    symbols.emplace_back(uint8_t(17), static_cast<uint8_t>(run - 3));
+                    run = 0;
+                }
+            }
+            else
+            {
+                symbols.emplace_back(length, uint8_t(0));
+                --run;
+                for (; run >= 3; run -= std::min<size_t>(run, 6))
+                    symbols.emplace_back(uint8_t(16), static_cast<uint8_t>(std::min<size_t>(run, 6) - 3));
+            }
+            for (; run > 0; --run)
+                symbols.emplace_back(length, uint8_t(0));
+        }
+        return symbols;
+    }
+
+    static void use_two_symbols(uint32_t* frequencies, const size_t count)
+    {
+        size_t used = static_cast<size_t>(
+            std::count_if(frequencies, frequencies + count, [](const uint32_t frequency) { return frequency != 0; }));
+        for (size_t symbol = 0; used < 2; ++symbol)
+        {
+            if (frequencies[symbol] != 0) continue;
+            frequencies[symbol] = 1;
+            ++used;
+        }
+    }
+
+    static unsigned get_codelen_extra_bits(const uint8_t symbol)
+    {
+        return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+    }
+
+    /// <summary>
+    /// The bits which the symbols take with the lengths, without the header of the block
+    /// </summary>
+    static uint64_t get_data_bits(const uint32_t* litlen_frequencies,
+                                  const uint32_t* dist_frequencies,
+                                  const uint8_t* litlen_lengths,
+                                  const uint8_t* dist_lengths)
+    {
+        uint64_t bits = 0;
+        for (size_t symbol = 0; symbol < LITLEN_CODES; ++symbol)
+        {
+            const unsigned extra = symbol > END_OF_BLOCK && symbol < 286 ? LENGTH_EXTRA[symbol - 257] : 0;
+            bits += static_cast<uint64_t>(litlen_frequencies[symbol]) * (litlen_lengths[symbol] + extra);
+        }
+        for (size_t symbol = 0; symbol < 30; ++symbol)
+            bits += static_cast<uint64_t>(dist_frequencies[symbol]) * (dist_lengths[symbol] + DIST_EXTRA[symbol]);
+        return bits;
+    }
+
+    static void write_symbols(BitWriter& writer, const std::vector<Symbol>& symbols, const HuffmanCodes& codes)
+    {
+        const auto& length_codes = get_length_codes();
+        for (const Symbol& symbol : symbols)
+        {
+            if (symbol.distance == 0)
+            {
+                const uint16_t literal = symbol.literal_or_length;
+                writer.write(codes.litlen_codes[literal], codes.litlen_lengths[literal]);
+                continue;
+            }
+
+            const size_t length_code = length_codes[symbol.literal_or_length];
+            writer.write(codes.litlen_codes[257 + length_code], codes.litlen_lengths[257 + length_code]);
+            writer.write(symbol.literal_or_length - LENGTH_BASE[length_code], LENGTH_EXTRA[length_code]);
+
+            const size_t dist_code = get_distance_code(symbol.distance);
+            writer.write(codes.dist_codes[dist_code], codes.dist_lengths[dist_code]);
+            writer.write(symbol.distance - DIST_BASE[dist_code], DIST_EXTRA[dist_code]);
+        }
+        writer.write(codes.litlen_codes[END_OF_BLOCK], codes.litlen_lengths[END_OF_BLOCK]);
+    }
+
+    static void write_stored(BitWriter& writer, const char* data, size_t size, const bool is_final)
+    {
+        do
+        {
+            const size_t piece = std::min(size, MAX_STORED_SIZE);
+            writer.write(is_final && piece == size ? 1 : 0, 1);
+            writer.write(0, 2);
+            writer.align();
+            writer.write(static_cast<uint32_t>(piece), 16);
+            writer.write(static_cast<uint32_t>(~piece & 0xFFFF), 16);
+            writer.out.append(data, piece);
+            data += piece;
+            size -= piece;
+        } while (size > 0);
+    }
+
+    /// <summary>
+    /// Writes the symbols, which encode data, as the smallest of the three kinds of block
+    /// </summary>
+    static void write_block(BitWriter& writer,
+                            const std::vector<Symbol>& symbols,
+                            const char* data,
+                            const size_t size,
+                            const bool is_final)
+    {
+        const auto& length_codes = get_length_codes();
+        uint32_t litlen_frequencies[LITLEN_CODES] = {};
+        uint32_t dist_frequencies[DIST_CODES] = {};
+        for (const Symbol& symbol : symbols)
+        {
+            if (symbol.distance == 0)
+            {
+                ++litlen_frequencies[symbol.literal_or_length];
+                continue;
+            }
+            ++litlen_frequencies[257 + length_codes[symbol.literal_or_length]];
+            ++dist_frequencies[get_distance_code(symbol.distance)];
+        }
+        litlen_frequencies[END_OF_BLOCK] = 1;
+
+        const HuffmanCodes& fixed = get_fixed_codes();
+        const uint64_t fixed_bits =
+            get_data_bits(litlen_frequencies, dist_frequencies, fixed.litlen_lengths, fixed.dist_lengths);
+
+        // Two codes of each kind at least, so that no code has a single symbol of zero bits
+        use_two_symbols(litlen_frequencies, LITLEN_CODES);
+        use_two_symbols(dist_frequencies, DIST_CODES);
+
+        HuffmanCodes dynamic;
+        build_lengths(litlen_frequencies, 286, 15, dynamic.litlen_lengths);
+        build_lengths(dist_frequencies, 30, 15, dynamic.dist_lengths);
+        std::fill(dynamic.litlen_lengths + 286, dynamic.litlen_lengths + LITLEN_CODES, uint8_t(0));
+        std::fill(dynamic.dist_lengths + 30, dynamic.dist_lengths + DIST_CODES, uint8_t(0));
+
+        size_t litlen_count = 286;
+        while (litlen_count > 257 && dynamic.litlen_lengths[litlen_count - 1] == 0)
+            --litlen_count;
+        size_t dist_count = 30;
+        while (dist_count > 1 && dynamic.dist_lengths[dist_count - 1] == 0)
+            --dist_count;
+
+        std::vector<uint8_t> all_lengths(dynamic.litlen_lengths, dynamic.litlen_lengths + litlen_count);
+        all_lengths.insert(all_lengths.end(), dynamic.dist_lengths, dynamic.dist_lengths + dist_count);
+        const std::vector<std::pair<uint8_t, uint8_t>> codelen_symbols = run_length_encode(all_lengths);
+
+        uint32_t codelen_frequencies[CODELEN_CODES] = {};
+        for (auto&& symbol : codelen_symbols)
+            ++codelen_frequencies[symbol.first];
+        uint8_t codelen_lengths[CODELEN_CODES];
+        uint16_t codelen_codes[CODELEN_CODES];
+        build_lengths(codelen_frequencies, CODELEN_CODES, 7, codelen_lengths);
+        build_codes(codelen_lengths, CODELEN_CODES, codelen_codes);
+
+        size_t codelen_count = CODELEN_CODES;
+        while (codelen_count > 4 && codelen_lengths[CODELEN_ORDER[codelen_count - 1]] == 0)
+            --codelen_count;
+
+        uint64_t dynamic_bits = 5 + 5 + 4 + 3 * codelen_count;
+        for (auto&& symbol : codelen_symbols)
+            dynamic_bits += codelen_lengths[symbol.first] + get_codelen_extra_bits(symbol.first);
+        dynamic_bits +=
+            get_data_bits(litlen_frequencies, dist_frequencies, dynamic.litlen_lengths, dynamic.dist_lengths);
+
+        const uint64_t stored_bits = (size / MAX_STORED_SIZE + 1) * (3 + 7 + 32) + 8 * static_cast<uint64_t>(size);
+        if (stored_bits <= fixed_bits && stored_bits <= dynamic_bits)
+        {
+            write_stored(writer, data, size, is_final);
+            return;
+        }
+
+        writer.write(is_final ? 1 : 0, 1);
+        if (fixed_bits <= dynamic_bits)
+        {
+            writer.write(1, 2);
+            write_symbols(writer, symbols, fixed);
+            return;
+        }
+
+        writer.write(2, 2);
+        writer.write(static_cast<uint32_t>(litlen_count - 257), 5);
+        writer.write(static_cast<uint32_t>(dist_count - 1), 5);
+        writer.write(static_cast<uint32_t>(codelen_count - 4), 4);
+        for (size_t i = 0; i < codelen_count; ++i)
+            writer.write(codelen_lengths[CODELEN_ORDER[i]], 3);
+        for (auto&& symbol : codelen_symbols)
+        {
+            writer.write(codelen_codes[symbol.first], codelen_lengths[symbol.first]);
+            writer.write(symbol.second, get_codelen_extra_bits(symbol.first));
+        }
+
+        build_codes(dynamic.litlen_lengths, LITLEN_CODES, dynamic.litlen_codes);
+        build_codes(dynamic.dist_lengths, DIST_CODES, dynamic.dist_codes);
+        write_symbols(writer, symbols, dynamic);
+    }
+
+    static uint32_t hash_at(const unsigned char* p)
+    {
+        const uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void deflate(const char* data, size_t size, bool is_last, std::string& out)
+    {
+        const unsigned char* const input = reinterpret_cast<const unsigned char*>(data);
+        std::vector<int32_t> heads(size_t(1) << HASH_BITS, -1);
+        std::vector<int32_t> previous(WINDOW_SIZE, -1);
+        const auto insert = [&](const size_t position) {
+            const uint32_t hash = hash_at(input + position);
+            previous[position % WINDOW_SIZE] = heads[hash];
+            heads[hash] = static_cast<int32_t>(position);
+        };
+
+        BitWriter writer(out);
+        std::vector<Symbol> symbols;
+        symbols.reserve(MAX_BLOCK_SYMBOLS);
+        size_t block_start = 0;
+        size_t position = 0;
+        while (position < size)
+        {
+            size_t best_length = 0;
+            size_t best_distance = 0;
+            if (position + MIN_MATCH <= size)
+            {
+                const size_t max_length = std::min(MAX_MATCH, size - position);
+                int32_t candidate = heads[hash_at(input + position)];
+                for (size_t chain = 0; chain < MAX_CHAIN && candidate >= 0; ++chain)
+                {
+                    const size_t distance = position - static_cast<size_t>(candidate);
+                    if (distance > WINDOW_SIZE) break;
+
+                    const unsigned char* const match = input + candidate;
+                    if (match[best_length] == input[position + best_length] && match[0] == input[position])
+                    {
+                        size_t length = 0;
+                        while (length < max_length && match[length] == input[position + length])
+                            ++length;
+                        if (length > best_length)
+                        {
+                            best_length = length;
+                            best_distance = distance;
+                            if (length >= NICE_MATCH || length == max_length) break;
+                        }
+                    }
+                    candidate = previous[static_cast<size_t>(candidate) % WINDOW_SIZE];
+                }
+                insert(position);
+            }
+
+            if (best_length >= MIN_MATCH)
+            {
+                symbols.push_back({static_cast<uint16_t>(best_length), static_cast<uint16_t>(best_distance)});
+                for (size_t skipped = position + 1; skipped < position + best_length; ++skipped)
+                {
+                    if (skipped + MIN_MATCH <= size) insert(skipped);
+                }
+                position += best_length;
+            }
+            else
+            {
+                symbols.push_back({input[position], 0});
+                ++position;
+            }
+
+            if (symbols.size() == MAX_BLOCK_SYMBOLS && position < size)
+            {
+                write_block(writer, symbols, data + block_start, position - block_start, false);
+                symbols.clear();
+                block_start = position;
+            }
+        }
+
+        write_block(writer, symbols, data + block_start, size - block_start, is_last);
+        if (!is_last) write_stored(writer, data, 0, false);
+        writer.align();
+    }
+
+    static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+    static constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+    static constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+    static constexpr uint32_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50;
+    static constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+    static constexpr uint16_t VERSION_DEFLATE = 20;
+    static constexpr uint16_t VERSION_ZIP64 = 45;
+    static constexpr uint16_t FLAG_UTF8_NAME = 0x0800;
+    static constexpr uint16_t METHOD_DEFLATE = 8;
+    static constexpr uint16_t ZIP64_EXTRA_ID = 0x0001;
+    static constexpr uint32_t MAX_32 = 0xFFFFFFFF;
+    static constexpr uint16_t MAX_16 = 0xFFFF;
+
+    /// <summary>
+    /// Files from this size on get Zip64 sizes in their local header. Those are written before the file is
+    /// compressed, and a file which does not compress grows by a few bytes in every 64 KiB.
+    /// </summary>
+    static constexpr uint64_t ZIP64_LOCAL_THRESHOLD = 0xF0000000;
+
+    template<class T>
+    static void write_int(std::ostream& output, const T value)
+    {
+        output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    struct Record
+    {
+        uint32_t crc = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        uint64_t offset = 0;
+        bool has_zip64_local = false;
+    };
+
+    struct Piece
+    {
+        size_t entry;
+        std::shared_ptr<const char> keep_alive;
+        const char* data;
+        size_t size;
+        bool is_first;
+        bool is_last;
+        uint32_t crc;
+        std::string compressed;
+    };
+
+    ExpectedT<uint64_t, std::string> write(const Files::Filesystem& fs,
+                                           const fs::path& archive,
+                                           const std::vector<Entry>& entries)
+    {
+        std::ofstream output(archive, std::ios::binary | std::ios::trunc);
+        if (!output) return Strings::format("Failed to create %s", archive.u8string());
+
+        const tm now = System::get_current_date_time();
+        const uint16_t dos_time = static_cast<uint16_t>((now.tm_hour << 11) | (now.tm_min << 5) | (now.tm_sec / 2));
+        const uint16_t dos_date =
+            static_cast<uint16_t>((std::max(now.tm_year - 80, 0) << 9) | ((now.tm_mon + 1) << 5) | now.tm_mday);
+
+        const auto write_local_header = [&](const Entry& entry, Record& record) {
+            record.offset = static_cast<uint64_t>(output.tellp());
+            record.has_zip64_local = record.size >= ZIP64_LOCAL_THRESHOLD;
+            write_int<uint32_t>(output, LOCAL_HEADER_SIGNATURE);
+            write_int<uint16_t>(output, record.has_zip64_local ? VERSION_ZIP64 : VERSION_DEFLATE);
+            write_int<uint16_t>(output, FLAG_UTF8_NAME);
+            write_int<uint16_t>(output, METHOD_DEFLATE);
+            write_int<uint16_t>(output, dos_time);
+            write_int<uint16_t>(output, dos_date);
+            // The CRC and the compressed size are filled in once the file has been written
+            write_int<uint32_t>(output, 0);
+            write_int<uint32_t>(output, record.has_zip64_local ? MAX_32 : 0);
+            write_int<uint32_t>(output, record.has_zip64_local ? MAX_32 : static_cast<uint32_t>(record.size));
+            write_int<uint16_t>(output, static_cast<uint16_t>(entry.name.size()));
+            write_int<uint16_t>(output, static_cast<uint16_t>(record.has_zip64_local ? 20 : 0));
+            output.write(entry.name.data(), entry.name.size());
+            if (record.has_zip64_local)
+            {
+                write_int<uint16_t>(output, ZIP64_EXTRA_ID);
+                write_int<uint16_t>(output, 16);
+                write_int<uint64_t>(output, record.size);
+                write_int<uint64_t>(output, 0);
+            }
+        };
+
+        const auto patch_local_header = [&](const Entry& entry, const Record& record) {
+            const std::streamoff end = output.tellp();
+            output.seekp(static_cast<std::streamoff>(record.offset + 14));
+            write_int<uint32_t>(output, record.crc);
+            if (record.has_zip64_local)
+            {
+                output.seekp(static_cast<std::streamoff>(record.offset + 30 + entry.name.size() + 12));
+                write_int<uint64_t>(output, record.compressed_size);
+            }
+            else
+            {
+                write_int<uint32_t>(output, static_cast<uint32_t>(record.compressed_size));
+            }
+            output.seekp(end);
+        };
+
+        for (auto&& entry : entries)
+        {
+            if (entry.name.size() > MAX_16)
+            {
+                return Strings::format("Failed to archive %s: the name is too long", entry.name);
+            }
+        }
+
+        // The files are read a batch at a time, so that the pieces waiting to be written stay bounded
+        const size_t batch_size = BATCH_SIZE_PER_THREAD * std::max<size_t>(ThreadPool::get_thread_count(), 1);
+        std::vector<Record> records(entries.size());
+        std::vector<Piece> pieces;
+        Files::MappedFile mapped;
+        const char* contents = nullptr;
+        size_t position = 0;
+        size_t next_entry = 0;
+        while (next_entry < entries.size() && output)
+        {
+            pieces.clear();
+            size_t pending = 0;
+            while (next_entry < entries.size() && pending < batch_size)
+            {
+                const Entry& entry = entries[next_entry];
+                Record& record = records[next_entry];
+                if (position == 0)
+                {
+                    if (entry.source.empty())
+                    {
+                        mapped = Files::MappedFile();
+                        contents = entry.contents.data();
+                        record.size = entry.contents.size();
+                    }
+                    else
+                    {
+                        auto maybe_mapped = fs.map_contents(entry.source);
+                        const auto file = maybe_mapped.get();
+                        if (!file)
+                        {
+                            return Strings::format("Failed to read %s: %s",
+                                                   entry.source.u8string(),
+                                                   maybe_mapped.error().message());
+                        }
+                        mapped = std::move(*file);
+                        contents = mapped.data.get();
+                        record.size = mapped.size;
+                    }
+                }
+
+                const size_t size = static_cast<size_t>(std::min<uint64_t>(record.size - position, PIECE_SIZE));
+                const bool is_last = position + size == record.size;
+                pieces.push_back({next_entry, mapped.data, contents + position, size, position == 0, is_last, 0, {}});
+                pending += size;
+                position += size;
+                if (is_last)
+                {
+                    ++next_entry;
+                    position = 0;
+                }
+            }
+
+            Util::parallel_for_each_index(pieces.size(), [&](const size_t i) {
+                Piece& piece = pieces[i];
+                piece.compressed.reserve(piece.size + piece.size / 1024 + 16);
+                deflate(piece.data, piece.size, piece.is_last, piece.compressed);
+                piece.crc = crc32(0, piece.data, piece.size);
+            });
+
+            for (Piece& piece : pieces)
+            {
+                const Entry& entry = entries[piece.entry];
+                Record& record = records[piece.entry];
+                if (piece.is_first) write_local_header(entry, record);
+
+                output.write(piece.compressed.data(), piece.compressed.size());
+                record.crc = crc32_combine(record.crc, piece.crc, piece.size);
+                record.compressed_size += piece.compressed.size();
+                if (!piece.is_last) continue;
+
+                if (!record.has_zip64_local && record.compressed_size >= MAX_32)
+                {
+                    return Strings::format("Failed to archive %s: it grew too much when it was compressed", entry.name);
+                }
+                patch_local_header(entry, record);
+            }
+        }
+        pieces.clear();
+        mapped = Files::MappedFile();
+
+        const uint64_t central_directory_offset = static_cast<uint64_t>(output.tellp());
+        for (size_t i = 0; i < entries.size() && output; ++i)
+        {
+            const Entry& entry = entries[i];
+            const Record& record = records[i];
+
+            // The Zip64 field holds, in this order, only the values which do not fit into their 32-bit field
+            std::vector<uint64_t> zip64_values;
+            if (record.size >= MAX_32) zip64_values.push_back(record.size);
+            if (record.compressed_size >= MAX_32) zip64_values.push_back(record.compressed_size);
+            if (record.offset >= MAX_32) zip64_values.push_back(record.offset);
+            const bool needs_zip64 = !zip64_values.empty() || record.has_zip64_local;
+
+            write_int<uint32_t>(output, CENTRAL_HEADER_SIGNATURE);
+            write_int<uint16_t>(output, needs_zip64 ? VERSION_ZIP64 : VERSION_DEFLATE);
+            write_int<uint16_t>(output, needs_zip64 ? VERSION_ZIP64 : VERSION_DEFLATE);
+            write_int<uint16_t>(output, FLAG_UTF8_NAME);
+            write_int<uint16_t>(output, METHOD_DEFLATE);
+            write_int<uint16_t>(output, dos_time);
+            write_int<uint16_t>(output, dos_date);
+            write_int<uint32_t>(output, record.crc);
+            write_int<uint32_t>(output, static_cast<uint32_t>(std::min<uint64_t>(record.compressed_size, MAX_32)));
+            write_int<uint32_t>(output, static_cast<uint32_t>(std::min<uint64_t>(record.size, MAX_32)));
+            write_int<uint16_t>(output, static_cast<uint16_t>(entry.name.size()));
+            write_int<uint16_t>(output, static_cast<uint16_t>(zip64_values.empty() ? 0 : 4 + 8 * zip64_values.size()));
+            write_int<uint16_t>(output, 0); // comment
+            write_int<uint16_t>(output, 0); // disk
+            write_int<uint16_t>(output, 0); // internal attributes
+            write_int<uint32_t>(output, 0); // external attributes
+            write_int<uint32_t>(output, static_cast<uint32_t>(std::min<uint64_t>(record.offset, MAX_32)));
+            output.write(entry.name.data(), entry.name.size());
+            if (!zip64_values.empty())
+            {
+                write_int<uint16_t>(output, ZIP64_EXTRA_ID);
+                write_int<uint16_t>(output, static_cast<uint16_t>(8 * zip64_values.size()));
+                for (const uint64_t value : zip64_values)
+                    write_int<uint64_t>(output, value);
+            }
+        }
+
+        const uint64_t central_directory_end = static_cast<uint64_t>(output.tellp());
+        const uint64_t central_directory_size = central_directory_end - central_directory_offset;
+        const uint64_t entry_count = entries.size();
+        if (entry_count >= MAX_16 || central_directory_size >= MAX_32 || central_directory_offset >= MAX_32)
+        {
+            write_int<uint32_t>(output, ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+            write_int<uint64_t>(output, 44); // the size of the rest of the record
+            write_int<uint16_t>(output, VERSION_ZIP64);
+            write_int<uint16_t>(output, VERSION_ZIP64);
+            write_int<uint32_t>(output, 0); // this disk
+            write_int<uint32_t>(output, 0); // the disk of the central directory
+            write_int<uint64_t>(output, entry_count);
+            write_int<uint64_t>(output, entry_count);
+            write_int<uint64_t>(output, central_directory_size);
+            write_int<uint64_t>(output, central_directory_offset);
+
+            write_int<uint32_t>(output, ZIP64_LOCATOR_SIGNATURE);
+            write_int<uint32_t>(output, 0); // the disk of the Zip64 record
+            write_int<uint64_t>(output, central_directory_end);
+            write_int<uint32_t>(output, 1); // disks
+        }
+
+        write_int<uint32_t>(output, END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+        write_int<uint16_t>(output, 0); // this disk
+        write_int<uint16_t>(output, 0); // the disk of the central directory
+        write_int<uint16_t>(output, static_cast<uint16_t>(std::min<uint64_t>(entry_count, MAX_16)));
+        write_int<uint16_t>(output, static_cast<uint16_t>(std::min<uint64_t>(entry_count, MAX_16)));
+        write_int<uint32_t>(output, static_cast<uint32_t>(std::min<uint64_t>(central_directory_size, MAX_32)));
+        write_int<uint32_t>(output, static_cast<uint32_t>(std::min<uint64_t>(central_directory_offset, MAX_32)));
+        write_int<uint16_t>(output, 0); // comment
+
+        const uint64_t archive_size = static_cast<uint64_t>(output.tellp());
+        output.close();
+        if (!output) return Strings::format("Failed to write %s", archive.u8string());
+        return archive_size;
+    }
+}
@@ -0,0 +1,231 @@
+#include "pch.h"
+
+#include "Paragraphs.h"
+#include "SourceParagraph.h"
+#include "StatusParagraphs.h"
+#include "VcpkgPaths.h"
+#include "vcpkg_Dependencies.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Fixtures.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkglib.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace vcpkg;
+
+// Every allocation of the process goes through these, so a benchmark can report how much it allocated
+static std::atomic<uint64_t> g_allocation_count{0};
+static std::atomic<uint64_t> g_allocated_bytes{0};
+
+void* operator new(const size_t size)
+{
+    ++g_allocation_count;
+    g_allocated_bytes += size;
+    void* const p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](const size_t size) { return operator new(size); }
+
+void operator delete(void* const p) noexcept { std::free(p); }
+
+void operator delete[](void* const p) noexcept { std::free(p); }
+
+namespace vcpkg::Benchmark
+{
+    using Fixtures::feature_name;
+    using Fixtures::port_name;
+
+    struct Parameters
+    {
+        Fixtures::Parameters fixture;
+        size_t iterations;
+        bool on_disk;
+    };
+
+    static const Triplet& benchmark_triplet() { return Triplet::X86_WINDOWS; }
+
+    struct Result
+    {
+        double seconds_per_iteration;
+        double items_per_second;
+        uint64_t allocations_per_iteration;
+        uint64_t bytes_per_iteration;
+    };
+
+    /// <summary>
+    /// Runs f once to warm up, then the given number of times. f returns how many items it processed.
+    /// </summary>
+    template<class Func>
+    static Result measure(const size_t iterations, Func&& f)
+    {
+        f();
+
+        const uint64_t allocations_before = g_allocation_count;
+        const uint64_t bytes_before = g_allocated_bytes;
+        const auto start = std::chrono::high_resolution_clock::now();
+        size_t items = 0;
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            items += f();
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        Result result;
+        result.seconds_per_iteration = elapsed.count() / iterations;
+        result.items_per_second = elapsed.count() > 0 ? items / elapsed.count() : 0;
+        result.allocations_per_iteration = (g_allocation_count - allocations_before) / iterations;
+        result.bytes_per_iteration = (g_allocated_bytes - bytes_before) / iterations;
+        return result;
+    }
+
+    static void print_result(const std::string& name, const std::string& unit, const Result& result)
+    {
+        System::println("%-28s %12.3f ms %14.0f %-12s %12s allocs %14s bytes",
+                        name,
+                        result.seconds_per_iteration * 1000,
+                        result.items_per_second,
+                        unit + "/s",
+                        std::to_string(result.allocations_per_iteration),
+                        std::to_string(result.bytes_per_iteration));
+    }
+
+    static void run(const Parameters& parameters)
+    {
+        const Fixtures::Parameters& fixture = parameters.fixture;
+        System::println("%d ports, %d features each, dependency depth %d, %d installed files each, %d iterations, %s\n",
+                        static_cast<int>(fixture.port_count),
+                        static_cast<int>(fixture.feature_count),
+                        static_cast<int>(fixture.dependency_depth),
+                        static_cast<int>(fixture.installed_file_count),
+                        static_cast<int>(parameters.iterations),
+                        parameters.on_disk ? "on disk" : "in memory");
+
+        std::vector<std::string> control_files;
+        for (size_t i = 0; i < fixture.port_count; ++i)
+        {
+            control_files.push_back(Fixtures::generate_control_file(fixture, i));
+        }
+
+        print_result("parse_paragraphs", "ports", measure(parameters.iterations, [&]() {
+                         for (auto&& control : control_files)
+                         {
+                             Paragraphs::parse_paragraphs(control).value_or_exit(VCPKG_LINE_INFO);
+                         }
+                         return control_files.size();
+                     }));
+
+        std::unordered_map<std::string, SourceControlFile> ports;
+        for (size_t i = 0; i < fixture.port_count; ++i)
+        {
+            auto pghs = Paragraphs::parse_paragraphs(control_files[i]).value_or_exit(VCPKG_LINE_INFO);
+            auto scf = SourceControlFile::parse_control_file(std::move(pghs)).value_or_exit(VCPKG_LINE_INFO);
+            ports.emplace(port_name(i), std::move(*scf));
+        }
+
+        // Requesting every feature of the top layer pulls in the whole tree
+        const size_t layer_size = std::max<size_t>(1, fixture.port_count / fixture.dependency_depth);
+        std::vector<std::string> features;
+        for (size_t f = 0; f < fixture.feature_count; ++f)
+        {
+            features.push_back(feature_name(f));
+        }
+        std::vector<FullPackageSpec> requests;
+        for (size_t i = fixture.port_count - std::min(layer_size, fixture.port_count); i < fixture.port_count; ++i)
+        {
+            requests.push_back(
+                {PackageSpec::from_name_and_triplet(port_name(i), benchmark_triplet()).value_or_exit(VCPKG_LINE_INFO),
+                 features});
+        }
+        const std::vector<FeatureSpec> feature_specs = FullPackageSpec::to_feature_specs(requests);
+
+        const StatusParagraphs empty_status_db;
+        print_result("create_feature_install_plan", "actions", measure(parameters.iterations, [&]() {
+                         return Dependencies::create_feature_install_plan(ports, feature_specs, empty_status_db).size();
+                     }));
+
+        // The memory filesystem leaves out the disk, so that runs on different machines can be compared
+        const std::shared_ptr<Files::Filesystem> memory_fs = Files::make_memory_filesystem();
+        Files::Filesystem& fs = parameters.on_disk ? Files::get_real_filesystem() : *memory_fs;
+        const fs::path root = fs::stdfs::temp_directory_path() / "vcpkg-benchmark";
+        const VcpkgPaths paths = Fixtures::create_root(fs, root, fixture);
+
+        print_result("database_load_check", "paragraphs", measure(parameters.iterations, [&]() {
+                         const StatusParagraphs db = database_load_check(paths);
+                         return static_cast<size_t>(std::distance(db.begin(), db.end()));
+                     }));
+
+        const StatusParagraphs status_db = database_load_check(paths);
+        std::vector<std::string> names;
+        for (size_t i = 0; i < fixture.port_count; ++i)
+        {
+            names.push_back(port_name(i));
+        }
+        print_result("StatusParagraphs::find", "lookups", measure(parameters.iterations, [&]() {
+                         size_t found = 0;
+                         for (auto&& name : names)
+                         {
+                             if (status_db.find(name, benchmark_triplet()) != status_db.end()) ++found;
+                         }
+                         return found;
+                     }));
+
+        print_result("get_installed_files", "ports", measure(parameters.iterations, [&]() {
+                         return get_installed_files(paths, status_db).size();
+                     }));
+
+        std::error_code ec;
+        fs.remove_all(root, ec);
+    }
+
+    static size_t parse_parameter(const std::string& argument,
+                                  const std::string& name,
+                                  const size_t minimum,
+                                  const size_t current)
+    {
+        const std::string prefix = "--" + name + "=";
+        if (argument.compare(0, prefix.size(), prefix) != 0) return current;
+
+        char* end;
+        const size_t value = std::strtoul(argument.c_str() + prefix.size(), &end, 10);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           *end == '\0' && value >= minimum,
+                           "--%s must be a number of at least %d",
+                           name,
+                           static_cast<int>(minimum));
+        return value;
+    }
+}
+
+int wmain(const int argc, const wchar_t* const* const argv)
+{
+    using namespace vcpkg::Benchmark;
+
+    Parameters parameters;
+    parameters.fixture.port_count = 1000;
+    parameters.fixture.feature_count = 2;
+    parameters.fixture.dependency_depth = 10;
+    parameters.fixture.installed_file_count = 100;
+    parameters.fixture.triplets = {benchmark_triplet()};
+    parameters.iterations = 5;
+    parameters.on_disk = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = Strings::to_utf8(argv[i]);
+        Fixtures::Parameters& fixture = parameters.fixture;
+        fixture.port_count = parse_parameter(argument, "ports", 1, fixture.port_count);
+        fixture.feature_count = parse_parameter(argument, "features", 0, fixture.feature_count);
+        fixture.dependency_depth = parse_parameter(argument, "depth", 1, fixture.dependency_depth);
+        fixture.installed_file_count = parse_parameter(argument, "files", 0, fixture.installed_file_count);
+        parameters.iterations = parse_parameter(argument, "iterations", 1, parameters.iterations);
+        if (argument == "--disk") parameters.on_disk = true;
+    }
+
+    run(parameters);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "pch.h"
+
+#include "vcpkg_Files.h"
+#include "vcpkg_Fixtures.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace vcpkg;
+
+static size_t parse_parameter(const std::string& argument,
+                              const std::string& name,
+                              const size_t minimum,
+                              const size_t current)
+{
+    const std::string prefix = "--" + name + "=";
+    if (argument.compare(0, prefix.size(), prefix) != 0) return current;
+
+    char* end;
+    const size_t value = std::strtoul(argument.c_str() + prefix.size(), &end, 10);
+    Checks::check_exit(VCPKG_LINE_INFO,
+                       *end == '\0' && value >= minimum,
+                       "--%s must be a number of at least %d",
+                       name,
+                       static_cast<int>(minimum));
+    return value;
+}
+
+// Writes a synthetic vcpkg root to disk, so that commands can be timed end to end against a large tree:
+//   vcpkgfixtures <root> [--ports=N] [--features=N] [--depth=N] [--files=N] [--triplets=x86-windows,x64-windows]
+int wmain(const int argc, const wchar_t* const* const argv)
+{
+    Checks::check_exit(VCPKG_LINE_INFO,
+                       argc >= 2,
+                       "Usage: vcpkgfixtures <root> [--ports=N] [--features=N] [--depth=N] [--files=N] "
+                       "[--triplets=<triplet>,...]");
+    const fs::path root = fs::stdfs::absolute(argv[1]);
+
+    Fixtures::Parameters parameters;
+    parameters.port_count = 1000;
+    parameters.feature_count = 2;
+    parameters.dependency_depth = 10;
+    parameters.installed_file_count = 100;
+    parameters.triplets = {Triplet::X86_WINDOWS};
+
+    static const std::string TRIPLETS_PREFIX = "--triplets=";
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string argument = Strings::to_utf8(argv[i]);
+        parameters.port_count = parse_parameter(argument, "ports", 1, parameters.port_count);
+        parameters.feature_count = parse_parameter(argument, "features", 0, parameters.feature_count);
+        parameters.dependency_depth = parse_parameter(argument, "depth", 1, parameters.dependency_depth);
+        parameters.installed_file_count = parse_parameter(argument, "files", 0, parameters.installed_file_count);
+        if (argument.compare(0, TRIPLETS_PREFIX.size(), TRIPLETS_PREFIX) == 0)
+        {
+            parameters.triplets.clear();
+            for (auto&& name : Strings::split(argument.substr(TRIPLETS_PREFIX.size()), ","))
+            {
+                parameters.triplets.push_back(Triplet::from_canonical_name(name));
+            }
+        }
+    }
+
+    Fixtures::create_root(Files::get_real_filesystem(), root, parameters);
+
+    System::println("Wrote %d ports with %d features each and %d installed files for %d triplets to %s",
+                    static_cast<int>(parameters.port_count),
+                    static_cast<int>(parameters.feature_count),
+                    static_cast<int>(parameters.installed_file_count),
+                    static_cast<int>(parameters.triplets.size()),
+                    root.u8string());
+    return 0;
+}
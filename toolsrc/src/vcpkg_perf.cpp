@@ -0,0 +1,320 @@
+#include "pch.h"
+
+#include "vcpkg_Chrono.h"
+#include "vcpkg_Files.h"
+#include "vcpkg_Fixtures.h"
+#include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+
+#pragma comment(lib, "version")
+#pragma comment(lib, "winhttp")
+
+using namespace vcpkg;
+
+namespace vcpkg::Perf
+{
+    struct Parameters
+    {
+        fs::path vcpkg_exe;
+        std::vector<size_t> scales;
+        size_t file_count;
+        size_t iterations;
+        fs::path output;
+        Optional<fs::path> baseline;
+        double tolerance_percent;
+    };
+
+    struct Command
+    {
+        std::string name;
+        std::string arguments;
+    };
+
+    struct Measurement
+    {
+        size_t scale;
+        std::string command;
+        double seconds;
+    };
+
+    static const Triplet& perf_triplet() { return Triplet::X86_WINDOWS; }
+
+    /// <summary>
+    /// The cycle each iteration runs: everything is installed from packages/, queried, exported and removed again.
+    /// The specs are passed in a response file, since at scale they do not fit on the command line.
+    /// </summary>
+    static std::vector<Command> get_commands(const fs::path& specs_file)
+    {
+        const std::string specs = "@\"" + specs_file.u8string() + '"';
+        return {
+            {"install", "install --x-use-packages " + specs},
+            {"list", "list"},
+            {"owns", "owns header-0.h"},
+            {"update", "update"},
+            {"export-raw", "export --raw " + specs},
+            {"export-zip", "export --zip " + specs},
+            {"remove", "remove --no-purge --recurse " + specs},
+        };
+    }
+
+    /// <summary>
+    /// Runs vcpkg.exe against the root and returns the wall time it took, from the start of the process to its exit.
+    /// The phases it went through are written to the trace file.
+    /// </summary>
+    static double run_command(const Parameters& parameters,
+                              const fs::path& root,
+                              const Command& command,
+                              const fs::path& trace_file)
+    {
+        // The fixture shares the downloads of the real root, so that the tools are not fetched again for every root
+        const fs::path downloads = parameters.vcpkg_exe.parent_path() / "downloads";
+        const std::wstring cmd_line = Strings::wformat(LR"("%s" --vcpkg-root "%s" --downloads-root "%s" )"
+                                                       LR"(--timings-trace "%s" %s)",
+                                                       parameters.vcpkg_exe.native(),
+                                                       root.native(),
+                                                       downloads.native(),
+                                                       trace_file.native(),
+                                                       Strings::to_utf16(command.arguments));
+
+        std::string output;
+        const ElapsedTime timer = ElapsedTime::create_started();
+        Expected<System::Process> maybe_process = System::Process::start(
+            cmd_line, std::wstring(), [&](const char* data, const size_t size) { output.append(data, size); });
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           maybe_process.get() != nullptr,
+                           "Could not start %s",
+                           parameters.vcpkg_exe.u8string());
+        const int exit_code = maybe_process.get()->wait();
+        const double seconds = timer.microseconds() / 1000000;
+
+        if (exit_code != 0)
+        {
+            System::print(output);
+            Checks::exit_with_message(
+                VCPKG_LINE_INFO, "`vcpkg %s` failed with exit code %d", command.arguments, exit_code);
+        }
+        return seconds;
+    }
+
+    /// <summary>
+    /// vcpkg.exe needs the helper scripts and the triplet files of its own root to run against the fixture
+    /// </summary>
+    static void copy_support_files(const fs::path& vcpkg_root, const fs::path& root)
+    {
+        for (auto&& dir : {"scripts", "triplets"})
+        {
+            std::error_code ec;
+            fs::stdfs::copy(vcpkg_root / dir, root / dir, fs::stdfs::copy_options::recursive, ec);
+            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not copy %s: %s", dir, ec.message());
+        }
+    }
+
+    static std::vector<Measurement> run_scale(const Parameters& parameters, const size_t scale)
+    {
+        Fixtures::Parameters fixture;
+        fixture.port_count = scale;
+        fixture.feature_count = 0;
+        fixture.dependency_depth = std::min<size_t>(10, scale);
+        fixture.installed_file_count = parameters.file_count;
+        fixture.triplets = {perf_triplet()};
+
+        auto& fs = Files::get_real_filesystem();
+        const fs::path root = fs::stdfs::temp_directory_path() / "vcpkg-perf";
+        Fixtures::create_prebuilt_root(fs, root, fixture);
+        copy_support_files(parameters.vcpkg_exe.parent_path(), root);
+
+        std::vector<std::string> specs;
+        for (size_t i = 0; i < scale; ++i)
+        {
+            specs.push_back(Fixtures::port_name(i) + ':' + perf_triplet().canonical_name());
+        }
+        const fs::path specs_file = root / "specs.txt";
+        fs.write_lines(specs_file, specs);
+
+        const fs::path traces_dir = parameters.output.parent_path() / "traces";
+        std::error_code ec;
+        fs.create_directories(traces_dir, ec);
+
+        // The fastest of the iterations is kept, since noise only ever adds time
+        const std::vector<Command> commands = get_commands(specs_file);
+        std::vector<double> fastest(commands.size(), std::numeric_limits<double>::max());
+        for (size_t iteration = 0; iteration < parameters.iterations; ++iteration)
+        {
+            for (size_t i = 0; i < commands.size(); ++i)
+            {
+                const fs::path trace_file =
+                    traces_dir / Strings::format("%d-%s.json", static_cast<int>(scale), commands[i].name);
+                fastest[i] = std::min(fastest[i], run_command(parameters, root, commands[i], trace_file));
+            }
+        }
+
+        fs.remove_all(root, ec);
+
+        std::vector<Measurement> measurements;
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            measurements.push_back({scale, commands[i].name, fastest[i]});
+        }
+        return measurements;
+    }
+
+    static std::string to_json(const std::vector<Measurement>& measurements)
+    {
+        // One measurement per line, which is what read_baseline() expects
+        std::vector<std::string> lines;
+        for (auto&& m : measurements)
+        {
+            lines.push_back(Strings::format(R"(    {"scale": %d, "command": "%s", "seconds": %.6f})",
+                                            static_cast<int>(m.scale),
+                                            m.command,
+                                            m.seconds));
+        }
+        return "{\n  \"measurements\": [\n" + Strings::join(",\n", lines) + "\n  ]\n}\n";
+    }
+
+    /// <summary>
+    /// Reads the measurements back from the output of an earlier run
+    /// </summary>
+    static std::vector<Measurement> read_baseline(const fs::path& baseline)
+    {
+        const Expected<std::vector<std::string>> maybe_lines = Files::get_real_filesystem().read_lines(baseline);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, maybe_lines.get() != nullptr, "Could not read the baseline %s", baseline.u8string());
+
+        static const std::regex MEASUREMENT(R"###("scale": (\d+), "command": "([^"]+)", "seconds": ([0-9.]+))###");
+        std::vector<Measurement> measurements;
+        for (auto&& line : *maybe_lines.get())
+        {
+            std::smatch match;
+            if (!std::regex_search(line, match, MEASUREMENT)) continue;
+            measurements.push_back({std::stoul(match[1].str()), match[2].str(), std::stod(match[3].str())});
+        }
+        return measurements;
+    }
+
+    /// <summary>
+    /// Prints each measurement next to its baseline and returns how many are slower than the baseline allows
+    /// </summary>
+    static size_t compare_to_baseline(const std::vector<Measurement>& measurements,
+                                      const std::vector<Measurement>& baseline,
+                                      const double tolerance_percent)
+    {
+        size_t regressions = 0;
+        System::println("%-12s %8s %12s %12s %9s", "command", "scale", "baseline", "current", "change");
+        for (auto&& m : measurements)
+        {
+            const auto it = Util::find_if(
+                baseline, [&](const Measurement& b) { return b.scale == m.scale && b.command == m.command; });
+            if (it == baseline.cend())
+            {
+                System::println(
+                    "%-12s %8d %12s %11.3fs %9s", m.command, static_cast<int>(m.scale), "-", m.seconds, "new");
+                continue;
+            }
+
+            const double change_percent = it->seconds > 0 ? (m.seconds / it->seconds - 1) * 100 : 0;
+            const bool regressed = change_percent > tolerance_percent;
+            if (regressed) ++regressions;
+            System::println(regressed ? System::Color::error : System::Color::success,
+                            "%-12s %8d %11.3fs %11.3fs %+8.1f%%",
+                            m.command,
+                            static_cast<int>(m.scale),
+                            it->seconds,
+                            m.seconds,
+                            change_percent);
+        }
+        return regressions;
+    }
+
+    static size_t parse_number(const std::string& text, const std::string& name, const size_t minimum)
+    {
+        char* end;
+        const size_t value = std::strtoul(text.c_str(), &end, 10);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !text.empty() && *end == '\0' && value >= minimum,
+                           "--%s must be a number of at least %d",
+                           name,
+                           static_cast<int>(minimum));
+        return value;
+    }
+
+    static Optional<std::string> get_setting(const std::string& argument, const std::string& name)
+    {
+        const std::string prefix = "--" + name + "=";
+        if (argument.compare(0, prefix.size(), prefix) != 0) return nullopt;
+        return argument.substr(prefix.size());
+    }
+}
+
+// Times install, remove, export, owns, list and update end to end against synthetic roots of each scale, whose
+// packages are already built, and compares the times with those of an earlier run:
+//   vcpkgperf <vcpkg.exe> [--scales=100,1000] [--files=N] [--iterations=N] [--output=<file>] [--baseline=<file>]
+//             [--tolerance=<percent>]
+int wmain(const int argc, const wchar_t* const* const argv)
+{
+    using namespace vcpkg::Perf;
+
+    Checks::check_exit(VCPKG_LINE_INFO,
+                       argc >= 2,
+                       "Usage: vcpkgperf <vcpkg.exe> [--scales=N,...] [--files=N] [--iterations=N] [--output=<file>] "
+                       "[--baseline=<file>] [--tolerance=<percent>]");
+
+    Parameters parameters;
+    parameters.vcpkg_exe = fs::stdfs::absolute(argv[1]);
+    parameters.scales = {100, 1000};
+    parameters.file_count = 20;
+    parameters.iterations = 3;
+    parameters.output = fs::stdfs::absolute("vcpkg-perf.json");
+    parameters.tolerance_percent = 10;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string argument = Strings::to_utf8(argv[i]);
+        if (const auto scales = get_setting(argument, "scales").get())
+        {
+            parameters.scales = Util::fmap(Strings::split(*scales, ","),
+                                           [](const std::string& scale) { return parse_number(scale, "scales", 1); });
+        }
+        if (const auto files = get_setting(argument, "files").get())
+            parameters.file_count = parse_number(*files, "files", 1);
+        if (const auto iterations = get_setting(argument, "iterations").get())
+            parameters.iterations = parse_number(*iterations, "iterations", 1);
+        if (const auto output = get_setting(argument, "output").get())
+            parameters.output = fs::stdfs::absolute(fs::stdfs::u8path(*output));
+        if (const auto baseline = get_setting(argument, "baseline").get())
+            parameters.baseline = fs::stdfs::absolute(fs::stdfs::u8path(*baseline));
+        if (const auto tolerance = get_setting(argument, "tolerance").get())
+            parameters.tolerance_percent = static_cast<double>(parse_number(*tolerance, "tolerance", 0));
+    }
+
+    std::vector<Measurement> measurements;
+    for (const size_t scale : parameters.scales)
+    {
+        System::println("Timing %d ports with %d files each",
+                        static_cast<int>(scale),
+                        static_cast<int>(parameters.file_count));
+        for (auto&& m : run_scale(parameters, scale))
+        {
+            measurements.push_back(std::move(m));
+        }
+    }
+
+    Files::get_real_filesystem().write_contents(parameters.output, to_json(measurements));
+    System::println("Wrote the measurements to %s", parameters.output.u8string());
+
+    // The baseline is read only now, so that a run can replace its own baseline
+    if (const auto baseline = parameters.baseline.get())
+    {
+        const size_t regressions =
+            compare_to_baseline(measurements, read_baseline(*baseline), parameters.tolerance_percent);
+        if (regressions != 0)
+        {
+            System::println(System::Color::error,
+                            "%d measurements are more than %.0f%% slower than the baseline",
+                            static_cast<int>(regressions),
+                            parameters.tolerance_percent);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -3,16 +3,139 @@
 #include "Paragraphs.h"
 #include "metrics.h"
 #include "vcpkg_Files.h"
+#include "vcpkg_Listfile.h"
 #include "vcpkg_Strings.h"
+#include "vcpkg_System.h"
+#include "vcpkg_Timings.h"
 #include "vcpkg_Util.h"
 #include "vcpkglib.h"
 
 namespace vcpkg
 {
+    // A second lock on the same file would wait for the first, so nested InstalledTreeLocks share one
+    static std::mutex g_installed_tree_lock_mutex;
+    static int g_installed_tree_lock_count = 0;
+    static Files::FileLock g_installed_tree_lock;
+
+    static fs::path get_installed_tree_lock_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "lock"; }
+
+    InstalledTreeLock::InstalledTreeLock(const VcpkgPaths& paths)
+    {
+        std::lock_guard<std::mutex> lock(g_installed_tree_lock_mutex);
+        if (g_installed_tree_lock_count++ != 0) return;
+
+        auto& fs = paths.get_filesystem();
+        std::error_code ec;
+        fs.create_directories(paths.vcpkg_dir, ec);
+        g_installed_tree_lock =
+            Files::wait_for_lock(fs, get_installed_tree_lock_path(paths), Files::LockMode::EXCLUSIVE);
+    }
+
+    InstalledTreeLock::~InstalledTreeLock()
+    {
+        std::lock_guard<std::mutex> lock(g_installed_tree_lock_mutex);
+        if (--g_installed_tree_lock_count == 0) g_installed_tree_lock = Files::FileLock();
+    }
+
+    bool InstalledTreeLock::is_held()
+    {
+        std::lock_guard<std::mutex> lock(g_installed_tree_lock_mutex);
+        return g_installed_tree_lock_count != 0;
+    }
+
+    Files::FileLock lock_package_build(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path locks_dir = paths.vcpkg_dir / "locks";
+        std::error_code ec;
+        fs.create_directories(locks_dir, ec);
+        return Files::wait_for_lock(fs, locks_dir / (spec.dir() + ".lock"), Files::LockMode::EXCLUSIVE);
+    }
+
+    static fs::path get_trash_dir(const VcpkgPaths& paths) { return paths.vcpkg_dir / "trash"; }
+
+    // Stays below the limit of cmd.exe on the length of a command line
+    static constexpr size_t MAX_TRASH_COMMAND_LINE_LENGTH = 8000;
+
+    static void empty_trash(const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+        const std::vector<fs::path> entries = fs.get_files_non_recursive(get_trash_dir(paths));
+        std::error_code ec;
+
+        // A process which keeps running after vcpkg exits deletes the trash; what it does not get to, for instance
+        // because it was killed, is picked up by the next call. Every entry of the trash is finished, since an entry
+        // only appears once its rename is done.
+        if (&fs != &Files::get_real_filesystem())
+        {
+            for (auto&& entry : entries)
+                fs.remove_all(entry, ec);
+            return;
+        }
+
+        static const std::wstring COMMAND_PREFIX = L"cmd.exe /d /c rmdir /s /q";
+        static const std::wstring COMMAND_SUFFIX = L" 2>nul";
+        std::wstring cmd_line = COMMAND_PREFIX;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            cmd_line += Strings::wformat(LR"( "%s")", entries[i].native());
+            const bool is_last = i + 1 == entries.size();
+            if (is_last || cmd_line.size() + entries[i + 1].native().size() + 3 > MAX_TRASH_COMMAND_LINE_LENGTH)
+            {
+                System::start_detached(cmd_line + COMMAND_SUFFIX);
+                cmd_line = COMMAND_PREFIX;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Paths on different drives or shares; a volume mounted into a directory of another is not noticed
+    /// </summary>
+    static bool is_on_other_volume(const fs::path& a, const fs::path& b)
+    {
+        return Strings::case_insensitive_ascii_compare(a.root_name().u8string(), b.root_name().u8string()) != 0;
+    }
+
+    void move_to_trash(const VcpkgPaths& paths, const fs::path& dir)
+    {
+        auto& fs = paths.get_filesystem();
+        if (!fs.exists(dir)) return;
+
+        // The buildtrees and packages may be on another volume than the root, where renaming would have to copy
+        const fs::path trash_dir = get_trash_dir(paths);
+        std::error_code ec;
+        if (is_on_other_volume(dir, trash_dir))
+        {
+            fs.remove_all(dir, ec);
+            return;
+        }
+        fs.create_directories(trash_dir, ec);
+
+        // Named after the process so that several processes can move directories with the same name at once
+        static std::atomic<int> s_trash_counter{0};
+        const int pid = static_cast<int>(GetCurrentProcessId());
+        for (int attempt = 0; attempt < 16; ++attempt)
+        {
+            const fs::path target = trash_dir / Strings::format("%d.%d", pid, s_trash_counter++);
+            if (fs.exists(target)) continue;
+
+            fs.rename(dir, target, ec);
+            if (ec) break;
+
+            empty_trash(paths);
+            return;
+        }
+
+        // Directories with files open in them cannot be renamed
+        fs.remove_all(dir, ec);
+    }
+
     static StatusParagraphs load_current_database(Files::Filesystem& fs,
                                                   const fs::path& vcpkg_dir_status_file,
-                                                  const fs::path& vcpkg_dir_status_file_old)
+                                                  const fs::path& vcpkg_dir_status_file_old,
+                                                  const bool may_write)
     {
+        fs::path status_file = vcpkg_dir_status_file;
         if (!fs.exists(vcpkg_dir_status_file))
         {
             if (!fs.exists(vcpkg_dir_status_file_old))
@@ -21,22 +144,51 @@ namespace vcpkg
                 return StatusParagraphs();
             }
 
-            fs.rename(vcpkg_dir_status_file_old, vcpkg_dir_status_file);
+            if (may_write)
+                fs.rename(vcpkg_dir_status_file_old, vcpkg_dir_status_file);
+            else
+                status_file = vcpkg_dir_status_file_old;
         }
 
-        auto pghs = Paragraphs::get_paragraphs(fs, vcpkg_dir_status_file).value_or_exit(VCPKG_LINE_INFO);
+        auto pghs = Paragraphs::get_paragraph_views(fs, status_file).value_or_exit(VCPKG_LINE_INFO);
+        return StatusParagraphs(std::move(pghs));
+    }
+
+    // Number of journal records after which the journal is folded into the status file
+    static constexpr size_t STATUS_JOURNAL_COMPACTION_THRESHOLD = 64;
 
-        std::vector<std::unique_ptr<StatusParagraph>> status_pghs;
+    static size_t apply_status_journal(Files::Filesystem& fs,
+                                       const fs::path& journal_file,
+                                       StatusParagraphs& current_status_db,
+                                       const bool may_write)
+    {
+        const Expected<std::string> maybe_contents = fs.read_contents(journal_file);
+        const auto contents = maybe_contents.get();
+        if (!contents) return 0;
+
+        // Every record ends with a blank line. Anything after the last blank line is the remainder of an interrupted
+        // write_update(), or one which another process is still writing, and is dropped.
+        const auto end_of_records = contents->rfind("\n\n");
+        const std::string records =
+            end_of_records == std::string::npos ? std::string() : contents->substr(0, end_of_records + 2);
+
+        auto pghs = Paragraphs::parse_paragraphs(records).value_or_exit(VCPKG_LINE_INFO);
         for (auto&& p : pghs)
         {
-            status_pghs.push_back(std::make_unique<StatusParagraph>(std::move(p)));
+            current_status_db.insert(StatusParagraph(std::move(p)));
+        }
+
+        if (may_write && records.size() != contents->size())
+        {
+            fs.write_contents(journal_file, records);
         }
 
-        return StatusParagraphs(std::move(status_pghs));
+        return pghs.size();
     }
 
     StatusParagraphs database_load_check(const VcpkgPaths& paths)
     {
+        const Timings::ScopedTimer timer("status database load", "installed");
         auto& fs = paths.get_filesystem();
 
         const auto updates_dir = paths.vcpkg_dir_updates;
@@ -50,35 +202,56 @@ namespace vcpkg
         const fs::path& status_file = paths.vcpkg_dir_status_file;
         const fs::path status_file_old = status_file.parent_path() / "status-old";
         const fs::path status_file_new = status_file.parent_path() / "status-new";
-
-        StatusParagraphs current_status_db = load_current_database(fs, status_file, status_file_old);
-
-        auto update_files = fs.get_files_non_recursive(updates_dir);
-        if (update_files.empty())
+        const fs::path& journal_file = paths.vcpkg_dir_status_journal;
+
+        // Repairing and compacting the database rewrites files other processes read, so it is only done while no
+        // other process uses the database. Otherwise the database is read under a shared lock, which waits for
+        // processes which are changing it.
+        Files::FileLock lock;
+        bool may_write = InstalledTreeLock::is_held();
+        if (!may_write)
         {
-            // updates directory is empty, control file is up-to-date.
-            return current_status_db;
+            const fs::path lock_path = get_installed_tree_lock_path(paths);
+            lock = fs.try_lock_file(lock_path, Files::LockMode::EXCLUSIVE);
+            may_write = lock.is_held();
+            if (!may_write) lock = Files::wait_for_lock(fs, lock_path, Files::LockMode::SHARED);
         }
-        for (auto&& file : update_files)
+
+        StatusParagraphs current_status_db = load_current_database(fs, status_file, status_file_old, may_write);
+
+        // Update files written one per state transition by earlier versions of vcpkg
+        std::vector<fs::path> update_files;
+        for (auto&& file : fs.get_files_non_recursive(updates_dir))
         {
             if (!fs.is_regular_file(file)) continue;
+            if (file == journal_file) continue;
+
+            update_files.push_back(file);
             if (file.filename() == "incomplete") continue;
 
             auto pghs = Paragraphs::get_paragraphs(fs, file).value_or_exit(VCPKG_LINE_INFO);
             for (auto&& p : pghs)
             {
-                current_status_db.insert(std::make_unique<StatusParagraph>(std::move(p)));
+                current_status_db.insert(StatusParagraph(std::move(p)));
             }
         }
 
+        // The journal is applied after the legacy updates because it is only written by this version of vcpkg
+        const size_t journal_records = apply_status_journal(fs, journal_file, current_status_db, may_write);
+
+        if (!may_write || (update_files.empty() && journal_records < STATUS_JOURNAL_COMPACTION_THRESHOLD))
+        {
+            return current_status_db;
+        }
+
         fs.write_contents(status_file_new, Strings::serialize(current_status_db));
 
         fs.rename(status_file_new, status_file);
 
+        // Records are whole paragraphs, so replaying them after a crash at this point is harmless
+        fs.remove(journal_file, ec);
         for (auto&& file : update_files)
         {
-            if (!fs.is_regular_file(file)) continue;
-
             fs.remove(file);
         }
 
@@ -87,22 +260,23 @@ namespace vcpkg
 
     void write_update(const VcpkgPaths& paths, const StatusParagraph& p)
     {
-        static int update_id = 0;
+        Checks::check_exit(VCPKG_LINE_INFO, InstalledTreeLock::is_held());
         auto& fs = paths.get_filesystem();
-
-        const auto my_update_id = update_id++;
-        const auto tmp_update_filename = paths.vcpkg_dir_updates / "incomplete";
-        const auto update_filename = paths.vcpkg_dir_updates / std::to_string(my_update_id);
-
-        fs.write_contents(tmp_update_filename, Strings::serialize(p));
-        fs.rename(tmp_update_filename, update_filename);
+        const Timings::ScopedTimer timer("status database write", p.package.spec.to_string());
+
+        // A single append keeps each record contiguous; the trailing blank line marks the record as complete
+        std::string record;
+        record.reserve(serialized_size(p) + 1);
+        serialize(p, record);
+        record.push_back('\n');
+        fs.append_contents(paths.vcpkg_dir_status_journal, record);
     }
 
     static void upgrade_to_slash_terminated_sorted_format(Files::Filesystem& fs,
                                                           std::vector<std::string>* lines,
                                                           const fs::path& listfile_path)
     {
-        static bool was_tracked = false;
+        static std::atomic<bool> was_tracked = false;
 
         if (lines->empty())
         {
@@ -114,9 +288,8 @@ namespace vcpkg
             return; // File already in the new format
         }
 
-        if (!was_tracked)
+        if (!was_tracked.exchange(true))
         {
-            was_tracked = true;
             Metrics::g_metrics.lock()->track_property("listfile", "update to new format");
         }
 
@@ -174,42 +347,243 @@ namespace vcpkg
         for (auto&& pgh : status_db)
         {
             if (pgh->state != InstallState::INSTALLED || pgh->want != Want::INSTALL) continue;
-            installed_packages.push_back(pgh.get());
+            installed_packages.push_back(pgh);
         }
 
         return installed_packages;
     }
 
+    std::vector<Listfile::Entry> read_listfile_entries(Files::Filesystem& fs, const fs::path& listfile_path)
+    {
+        Optional<std::vector<Listfile::Entry>> maybe_entries = Listfile::try_read_binary(fs, listfile_path);
+        if (const auto entries = maybe_entries.get()) return std::move(*entries);
+
+        std::vector<std::string> lines = fs.read_lines(listfile_path).value_or_exit(VCPKG_LINE_INFO);
+        Strings::trim_all_and_remove_whitespace_strings(&lines);
+        upgrade_to_slash_terminated_sorted_format(fs, &lines, listfile_path);
+
+        // Converted once, so that the following reads decode the binary form instead of parsing the text
+        std::vector<Listfile::Entry> entries = Util::fmap(lines, [](std::string& line) {
+            const bool is_directory = line.back() == '/';
+            if (is_directory) line.pop_back();
+            return Listfile::Entry{std::move(line), is_directory, nullopt};
+        });
+        Listfile::write_binary(fs, listfile_path, entries);
+        return entries;
+    }
+
+    static std::vector<std::string> read_installed_files_from_listfile(Files::Filesystem& fs,
+                                                                       const fs::path& listfile_path)
+    {
+        std::vector<std::string> installed_files;
+        for (auto&& entry : read_listfile_entries(fs, listfile_path))
+        {
+            // Remove the directories
+            if (!entry.is_directory) installed_files.push_back(std::move(entry.path));
+        }
+        return installed_files;
+    }
+
     std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
                                                                        const StatusParagraphs& status_db)
     {
+        const Timings::ScopedTimer timer("listfile load", "installed");
         auto& fs = paths.get_filesystem();
 
-        std::vector<StatusParagraphAndAssociatedFiles> installed_files;
-
-        for (const std::unique_ptr<StatusParagraph>& pgh : status_db)
+        std::vector<const StatusParagraph*> installed;
+        for (const StatusParagraph* pgh : status_db)
         {
             if (pgh->state != InstallState::INSTALLED || !pgh->package.feature.empty())
             {
                 continue;
             }
+            installed.push_back(pgh);
+        }
 
-            const fs::path listfile_path = paths.listfile_path(pgh->package);
-            std::vector<std::string> installed_files_of_current_pgh =
-                fs.read_lines(listfile_path).value_or_exit(VCPKG_LINE_INFO);
-            Strings::trim_all_and_remove_whitespace_strings(&installed_files_of_current_pgh);
-            upgrade_to_slash_terminated_sorted_format(fs, &installed_files_of_current_pgh, listfile_path);
+        std::vector<SortedVector<std::string>> files = Util::parallel_fmap(installed, [&](const StatusParagraph* pgh) {
+            return SortedVector<std::string>(read_installed_files_from_listfile(fs, paths.listfile_path(pgh->package)));
+        });
 
-            // Remove the directories
-            Util::erase_remove_if(installed_files_of_current_pgh,
-                                  [](const std::string& file) { return file.back() == '/'; });
+        std::vector<StatusParagraphAndAssociatedFiles> installed_files;
+        installed_files.reserve(installed.size());
+        for (size_t i = 0; i < installed.size(); ++i)
+        {
+            installed_files.push_back({*installed[i], std::move(files[i])});
+        }
+        return installed_files;
+    }
+
+    // The file starts with the number of packages, followed by one "<package>\t<listfile stamp>" line per package
+    // and one "<file>\t<package>" line per file, sorted by file.
+    static bool try_read_file_owners(const Files::Filesystem& fs,
+                                     const fs::path& owners_path,
+                                     std::map<std::string, std::string>& listfile_stamps,
+                                     std::vector<InstalledFileOwners::Entry>& entries)
+    {
+        const Expected<std::vector<std::string>> maybe_lines = fs.read_lines(owners_path);
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->empty()) return false;
+
+        const int package_count = atoi(lines->front().c_str());
+        if (package_count < 0 || static_cast<size_t>(package_count) >= lines->size()) return false;
+
+        for (size_t i = 1; i < lines->size(); ++i)
+        {
+            const std::string& line = lines->at(i);
+            const auto tab = line.find('\t');
+            if (tab == std::string::npos) return false;
+
+            if (i <= static_cast<size_t>(package_count))
+                listfile_stamps.emplace(line.substr(0, tab), line.substr(tab + 1));
+            else
+                entries.push_back({line.substr(0, tab), line.substr(tab + 1)});
+        }
+
+        return true;
+    }
+
+    InstalledFileOwners InstalledFileOwners::load(const VcpkgPaths& paths,
+                                                  const StatusParagraphs& status_db,
+                                                  const Triplet& triplet)
+    {
+        auto& fs = paths.get_filesystem();
 
-            StatusParagraphAndAssociatedFiles pgh_and_files = {
-                *pgh, SortedVector<std::string>(std::move(installed_files_of_current_pgh))};
-            installed_files.push_back(std::move(pgh_and_files));
+        std::vector<const BinaryParagraph*> installed_packages;
+        std::map<std::string, std::string> expected_stamps;
+        for (const StatusParagraph* pgh : status_db)
+        {
+            if (pgh->state != InstallState::INSTALLED || !pgh->package.feature.empty()) continue;
+            if (pgh->package.spec.triplet() != triplet) continue;
+
+            installed_packages.push_back(&pgh->package);
+            expected_stamps.emplace(pgh->package.spec.name(),
+                                    Listfile::get_stamp(fs, paths.listfile_path(pgh->package)));
         }
 
-        return installed_files;
+        InstalledFileOwners owners;
+        owners.m_triplet = triplet;
+        if (try_read_file_owners(fs, paths.file_owners_path(triplet), owners.m_listfile_stamps, owners.m_entries) &&
+            owners.m_listfile_stamps == expected_stamps)
+        {
+            return owners;
+        }
+
+        // The index is missing or out of date; rebuild it from the listfiles, whose sorted entries are merged
+        owners.m_listfile_stamps.clear();
+        std::vector<std::vector<Entry>> runs;
+        runs.reserve(installed_packages.size());
+        for (const BinaryParagraph* pgh : installed_packages)
+        {
+            runs.push_back(owners.read_package(paths, *pgh));
+        }
+        owners.m_entries = merge_sorted_runs(std::move(runs), [](const Entry& left, const Entry& right) {
+            return left.file < right.file;
+        });
+        owners.save(paths);
+
+        return owners;
+    }
+
+    const std::string* InstalledFileOwners::find_owner(const std::string& file) const
+    {
+        const auto it = std::lower_bound(
+            m_entries.cbegin(), m_entries.cend(), file, [](const Entry& entry, const std::string& f) {
+                return entry.file < f;
+            });
+        if (it == m_entries.cend() || it->file != file) return nullptr;
+        return &it->owner;
+    }
+
+    std::vector<const std::string*> InstalledFileOwners::find_owners(const SortedVector<std::string>& files) const
+    {
+        std::vector<const std::string*> owners;
+        owners.reserve(files.size());
+        auto it = m_entries.cbegin();
+        for (const std::string& file : files)
+        {
+            it = gallop_lower_bound(it, m_entries.cend(), file, [](const Entry& entry, const std::string& f) {
+                return entry.file < f;
+            });
+            owners.push_back(it != m_entries.cend() && it->file == file ? &it->owner : nullptr);
+        }
+        return owners;
+    }
+
+    std::vector<InstalledFileOwners::Entry> InstalledFileOwners::read_package(const VcpkgPaths& paths,
+                                                                              const BinaryParagraph& pgh)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path listfile_path = paths.listfile_path(pgh);
+        const std::string& name = pgh.spec.name();
+
+        // Listfile entries are prefixed with "<triplet>/"
+        const size_t remove_char_count = m_triplet.canonical_name().size() + 1;
+        std::vector<Entry> entries;
+        for (auto&& file : read_installed_files_from_listfile(fs, listfile_path))
+        {
+            entries.push_back({file.substr(std::min(remove_char_count, file.size())), name});
+        }
+
+        // Listfiles are written sorted, so this only checks that this one was
+        const auto by_file = [](const Entry& left, const Entry& right) { return left.file < right.file; };
+        if (!std::is_sorted(entries.cbegin(), entries.cend(), by_file))
+        {
+            std::sort(entries.begin(), entries.end(), by_file);
+        }
+
+        // Reading the listfile can rewrite it in the current format, so it is stamped afterwards
+        m_listfile_stamps[name] = Listfile::get_stamp(fs, listfile_path);
+        return entries;
+    }
+
+    void InstalledFileOwners::add_package(const VcpkgPaths& paths, const BinaryParagraph& pgh)
+    {
+        remove_package(pgh.spec.name());
+
+        std::vector<Entry> entries = read_package(paths, pgh);
+        const size_t previous_size = m_entries.size();
+        m_entries.insert(
+            m_entries.end(), std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+        std::inplace_merge(m_entries.begin(),
+                           m_entries.begin() + previous_size,
+                           m_entries.end(),
+                           [](const Entry& left, const Entry& right) { return left.file < right.file; });
+    }
+
+    void InstalledFileOwners::remove_package(const std::string& name)
+    {
+        m_listfile_stamps.erase(name);
+        Util::erase_remove_if(m_entries, [&](const Entry& entry) { return entry.owner == name; });
+    }
+
+    void InstalledFileOwners::save(const VcpkgPaths& paths) const
+    {
+        auto& fs = paths.get_filesystem();
+
+        std::vector<std::string> lines;
+        lines.reserve(1 + m_listfile_stamps.size() + m_entries.size());
+        lines.push_back(std::to_string(m_listfile_stamps.size()));
+        for (auto&& stamp : m_listfile_stamps)
+        {
+            lines.push_back(stamp.first + '\t' + stamp.second);
+        }
+        for (auto&& entry : m_entries)
+        {
+            lines.push_back(entry.file + '\t' + entry.owner);
+        }
+
+        // Processes which only read the installed tree save rebuilt indexes too, so each writes its own temporary file
+        const fs::path owners_path = paths.file_owners_path(m_triplet);
+        fs::path tmp_path = owners_path;
+        tmp_path += Strings::format(".%d.tmp", static_cast<int>(GetCurrentProcessId()));
+        fs.write_lines(tmp_path, lines);
+
+        std::error_code ec;
+        fs.rename(tmp_path, owners_path, ec);
+        if (ec)
+        {
+            fs.remove(tmp_path, ec);
+        }
     }
 
     CMakeVariable::CMakeVariable(const CWStringView varname, const wchar_t* varvalue)
@@ -233,15 +607,28 @@ namespace vcpkg
                                 const fs::path& cmake_script,
                                 const std::vector<CMakeVariable>& pass_variables)
     {
-        const std::wstring cmd_cmake_pass_variables = Strings::join(L" ", pass_variables, [](auto&& v) { return v.s; });
-        return Strings::wformat(
-            LR"("%s" %s -P "%s")", cmake_exe.native(), cmd_cmake_pass_variables, cmake_script.generic_wstring());
+        std::wstring cmd_line = Strings::wformat(LR"("%s")", cmake_exe.native());
+        for (auto&& variable : pass_variables)
+        {
+            cmd_line.push_back(L' ');
+            cmd_line.append(variable.s);
+        }
+        Strings::append_wformat(cmd_line, LR"( -P "%s")", cmake_script.generic_wstring());
+        return cmd_line;
+    }
+
+    std::wstring make_ports_cmake_cmd(const VcpkgPaths& paths, std::vector<CMakeVariable> pass_variables)
+    {
+        pass_variables.push_back({L"DOWNLOADS", paths.downloads});
+        pass_variables.push_back({L"BUILDTREES_DIR", paths.buildtrees});
+        pass_variables.push_back({L"PACKAGES_DIR", paths.packages});
+        return make_cmake_cmd(paths.get_cmake_exe(), paths.ports_cmake, pass_variables);
     }
 
     std::string shorten_text(const std::string& desc, size_t length)
     {
         Checks::check_exit(VCPKG_LINE_INFO, length >= 3);
-        auto simple_desc = std::regex_replace(desc, std::regex("\\s+"), " ");
+        auto simple_desc = Strings::collapse_whitespace(desc);
         return simple_desc.size() <= length ? simple_desc : simple_desc.substr(0, length - 3) + "...";
     }
 }